@@ -138,8 +138,15 @@ typedef struct INTNETBUF
     STAMCOUNTER     cStatLost;
     /** Number of bad frames (both rings). */
     STAMCOUNTER     cStatBadFrames;
+    /** Number of receiver wakeups avoided because the receiver was busy
+     * draining the receive ring (see u32RecvState). */
+    STAMCOUNTER     cStatWakeupsAvoided;
+    /** The receiver wakeup moderation state, INTNETBUF_RECV_STATE_XXX.
+     * Written by the receiver, read by the switch after committing frames to
+     * the receive ring. */
+    uint32_t volatile u32RecvState;
     /** Reserved for future use. */
-    STAMCOUNTER     aStatReserved[2];
+    uint32_t        u32Reserved;
     /** Reserved for future send profiling. */
     STAMPROFILE     StatSend1;
     /** Reserved for future send profiling. */
@@ -163,6 +170,18 @@ typedef INTNETBUF const *PCINTNETBUF;
 /** Magic number for INTNETBUF::u32Magic (Sir William Gerald Golding). */
 #define INTNETBUF_MAGIC             UINT32_C(0x19110919)
 
+/** @name INTNETBUF::u32RecvState values.
+ * @{ */
+/** The receiver does not do wakeup moderation and must be signalled whenever
+ * frames are added to the receive ring. */
+#define INTNETBUF_RECV_STATE_LEGACY UINT32_C(0)
+/** The receiver is busy draining the receive ring and will check it again
+ * before going to sleep, so there is no need to signal it. */
+#define INTNETBUF_RECV_STATE_BUSY   UINT32_C(1)
+/** The receiver found the receive ring empty and is going to sleep. */
+#define INTNETBUF_RECV_STATE_IDLE   UINT32_C(2)
+/** @} */
+
 /**
  * Asserts the sanity of the specified INTNETBUF structure.
  */
@@ -1058,6 +1077,9 @@ typedef enum INTNETTRUNKTYPE
 /** The maximum length of a trunk name. */
 #define INTNET_MAX_TRUNK_NAME       64
 
+/** The maximum size of the send or receive ring of an interface buffer. */
+#define INTNET_MAX_RING_SIZE        _32M
+
 
 /**
  * Request buffer for IntNetR0OpenReq / VMMR0_DO_INTNET_OPEN.
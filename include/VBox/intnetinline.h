@@ -779,6 +779,40 @@ DECLINLINE(uint32_t) IntNetRingReadAndSkipFrame(PINTNETRINGBUF pRingBuf, void *p
 }
 
 
+/**
+ * Tells the switch that the receiver is busy draining the receive ring and
+ * needn't be signalled when frames are added to it.
+ *
+ * @param   pIntBuf             The internal networking interface buffer.
+ */
+DECLINLINE(void) IntNetBufRecvSetBusy(PINTNETBUF pIntBuf)
+{
+    ASMAtomicWriteU32(&pIntBuf->u32RecvState, INTNETBUF_RECV_STATE_BUSY);
+}
+
+
+/**
+ * Tells the switch that the receiver is about to go to sleep waiting for
+ * frames, checking the receive ring one final time.
+ *
+ * The switch reads the state after committing frames to the ring while we
+ * check the ring after changing the state, so one of us will always notice
+ * the other.
+ *
+ * @returns true if the receiver should go to sleep, false if frames arrived
+ *          in the meantime (the receiver is marked busy again).
+ * @param   pIntBuf             The internal networking interface buffer.
+ */
+DECLINLINE(bool) IntNetBufRecvPrepareWait(PINTNETBUF pIntBuf)
+{
+    ASMAtomicWriteU32(&pIntBuf->u32RecvState, INTNETBUF_RECV_STATE_IDLE);
+    if (!IntNetRingHasMoreToRead(&pIntBuf->Recv))
+        return true;
+    IntNetBufRecvSetBusy(pIntBuf);
+    return false;
+}
+
+
 /**
  * Initializes a buffer structure.
  *
@@ -151,6 +151,8 @@
 #define VMM_MIN_CPU_COUNT           1
 /** Max number of Virtual CPUs. */
 #define VMM_MAX_CPU_COUNT           64
+/** Max number of virtual NUMA nodes. */
+#define VMM_MAX_NUMA_NODES          16
 
 /** @} */
 
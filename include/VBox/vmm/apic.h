@@ -202,6 +202,11 @@ VMM_INT_DECL(uint64_t)      APICHvGetIcr(PVMCPU pVCpu);
 VMM_INT_DECL(VBOXSTRICTRC)  APICHvSetEoi(PVMCPU pVCpu, uint32_t uEoi);
 /** @} */
 
+/** @name KVM interface (All-context API).
+ * @{ */
+VMM_INT_DECL(void)          APICKvmSetPvEoi(PVMCPU pVCpu, RTGCPHYS GCPhysPvEoi);
+/** @} */
+
 RT_C_DECLS_END
 
 /** @} */
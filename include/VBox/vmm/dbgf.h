@@ -709,6 +709,112 @@ VMMR3DECL(int) DBGFR3InterruptSoftwareIsEnabled(PUVM pUVM, uint8_t iInterrupt);
         ASMBitTest(&(a_pVM)->dbgf.ro.bmSoftIntBreakpoints, (uint8_t)(a_iInterrupt))
 
 
+/** @defgroup grp_dbgf_evttrace     The DBGF Per-VCPU Event Tracer
+ *
+ * A binary event tracer with one single-producer ring buffer of fixed size
+ * records per virtual CPU.  Only the EMT owning a ring writes to it, so no
+ * locking is required on the hot path.  The content can be exported in the
+ * Chrome trace event (JSON) format which is understood by chrome://tracing and
+ * the Perfetto UI.
+ *
+ * @{ */
+
+/** @name DBGFEVTTRACE_F_XXX - Event tracer event classes.
+ * @{ */
+/** VM exits (as recorded by EMHistoryAddExit). */
+#define DBGFEVTTRACE_F_EXIT         RT_BIT_32(0)
+/** I/O port accesses. */
+#define DBGFEVTTRACE_F_IOPORT       RT_BIT_32(1)
+/** MMIO accesses. */
+#define DBGFEVTTRACE_F_MMIO         RT_BIT_32(2)
+/** Interrupts delivered to the guest. */
+#define DBGFEVTTRACE_F_INTERRUPT    RT_BIT_32(3)
+/** Timer callbacks. */
+#define DBGFEVTTRACE_F_TIMER        RT_BIT_32(4)
+/** Contended PDM critical section waits. */
+#define DBGFEVTTRACE_F_CRITSECT     RT_BIT_32(5)
+/** All the event classes. */
+#define DBGFEVTTRACE_F_ALL          UINT32_C(0x0000003f)
+/** @} */
+
+/**
+ * Event tracer record type.
+ */
+typedef enum DBGFEVTTRACETYPE
+{
+    /** Invalid zero value. */
+    DBGFEVTTRACETYPE_INVALID = 0,
+    /** VM exit: u32Arg=EM flags and type, u64Arg0=flat PC. */
+    DBGFEVTTRACETYPE_EXIT,
+    /** I/O port read: u16Arg=port, u32Arg=value, u64Arg0=access size. */
+    DBGFEVTTRACETYPE_IOPORT_READ,
+    /** I/O port write: u16Arg=port, u32Arg=value, u64Arg0=access size. */
+    DBGFEVTTRACETYPE_IOPORT_WRITE,
+    /** MMIO read: u16Arg=access size, u64Arg0=physical address, u64Arg1=value. */
+    DBGFEVTTRACETYPE_MMIO_READ,
+    /** MMIO write: u16Arg=access size, u64Arg0=physical address, u64Arg1=value. */
+    DBGFEVTTRACETYPE_MMIO_WRITE,
+    /** Interrupt delivered: u16Arg=vector. */
+    DBGFEVTTRACETYPE_INTERRUPT,
+    /** Timer callback completed: u16Arg=clock, u64Arg0=timer (ring-3 address),
+     * u64Arg1=callback duration in nanoseconds. */
+    DBGFEVTTRACETYPE_TIMER,
+    /** Contended critical section acquired: u64Arg0=critical section (ring-3
+     * address), u64Arg1=wait duration in nanoseconds. */
+    DBGFEVTTRACETYPE_CRITSECT_WAIT,
+    /** End of valid types. */
+    DBGFEVTTRACETYPE_END,
+    /** The usual 32-bit hack. */
+    DBGFEVTTRACETYPE_32BIT_HACK = 0x7fffffff
+} DBGFEVTTRACETYPE;
+
+/**
+ * Event tracer record.
+ *
+ * For events with a duration the timestamp marks the end of the event.
+ */
+typedef struct DBGFEVTTRACEREC
+{
+    /** The timestamp (RTTimeNanoTS). */
+    uint64_t            u64NanoTS;
+    /** The record type (DBGFEVTTRACETYPE). */
+    uint16_t            enmType;
+    /** Type specific 16-bit argument. */
+    uint16_t            u16Arg;
+    /** Type specific 32-bit argument. */
+    uint32_t            u32Arg;
+    /** Type specific 64-bit argument \#0. */
+    uint64_t            u64Arg0;
+    /** Type specific 64-bit argument \#1. */
+    uint64_t            u64Arg1;
+} DBGFEVTTRACEREC;
+AssertCompileSize(DBGFEVTTRACEREC, 32);
+/** Pointer to an event tracer record. */
+typedef DBGFEVTTRACEREC *PDBGFEVTTRACEREC;
+/** Pointer to a const event tracer record. */
+typedef DBGFEVTTRACEREC const *PCDBGFEVTTRACEREC;
+
+/** @def DBGF_IS_EVT_TRACE_ENABLED
+ * Checks if the event tracer is recording the given event class (fast).
+ *
+ * @returns true/false.
+ * @param   a_pVM           Pointer to the cross context VM structure.
+ * @param   a_fEvtClass     The event class, DBGFEVTTRACE_F_XXX.
+ * @remarks Only for use internally in the VMM.
+ */
+#define DBGF_IS_EVT_TRACE_ENABLED(a_pVM, a_fEvtClass) \
+        RT_BOOL((a_pVM)->dbgf.ro.fEvtTraceMask & (a_fEvtClass))
+
+VMM_INT_DECL(void)  DBGFEvtTraceAdd(PVMCPU pVCpu, DBGFEVTTRACETYPE enmType, uint16_t u16Arg, uint32_t u32Arg,
+                                    uint64_t u64Arg0, uint64_t u64Arg1);
+#ifdef IN_RING3
+VMMR3DECL(int)      DBGFR3EvtTraceSetEvents(PUVM pUVM, uint32_t fEvtClasses);
+VMMR3DECL(uint32_t) DBGFR3EvtTraceGetEvents(PUVM pUVM);
+VMMR3DECL(int)      DBGFR3EvtTraceExportChromeJson(PUVM pUVM, const char *pszFilename);
+#endif
+/** @} */
+
+
 
 /** Breakpoint type. */
 typedef enum DBGFBPTYPE
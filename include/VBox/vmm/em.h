@@ -282,7 +282,9 @@ typedef struct EMEXITREC
     uint32_t            uFlagsAndType;
     /** The action to take (EMEXITACTION). */
     uint8_t             enmAction;
-    uint8_t             bUnused;
+    /** Number of consecutive EMEXITACTION_EXEC_WITH_MAX runs that didn't save
+     * any exits.  Used to demote records which stopped paying off. */
+    uint8_t             cFruitlessExecs;
     /** Maximum number of instructions to execute without hitting an exit. */
     uint16_t            cMaxInstructionsWithoutExit;
     /** The exit number (EMCPU::iNextExit) at which it was last updated. */
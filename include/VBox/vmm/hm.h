@@ -174,6 +174,7 @@ VMM_INT_DECL(TRPMEVENT)         HMSvmEventToTrpmEventType(PCSVMEVENT pSvmEvent,
  * @{ */
 VMM_INT_DECL(int)               HMFlushTlb(PVMCPU pVCpu);
 VMM_INT_DECL(int)               HMFlushTlbOnAllVCpus(PVM pVM);
+VMM_INT_DECL(int)               HMFlushTlbOnVCpus(PVM pVM, PCVMCPUSET pCpuSet);
 VMM_INT_DECL(int)               HMInvalidatePageOnAllVCpus(PVM pVM, RTGCPTR GCVirt);
 VMM_INT_DECL(int)               HMInvalidatePhysPage(PVM pVM, RTGCPHYS GCPhys);
 VMM_INT_DECL(bool)              HMAreNestedPagingAndFullGuestExecEnabled(PVM pVM);
@@ -199,6 +200,7 @@ VMM_INT_DECL(int)               HMHCMaybeMovTprSvmHypercall(PVMCPU pVCpu);
  * @{ */
 # define HMFlushTlb(pVCpu)                                            do { } while (0)
 # define HMFlushTlbOnAllVCpus(pVM)                                    do { } while (0)
+# define HMFlushTlbOnVCpus(pVM, pCpuSet)                              do { } while (0)
 # define HMInvalidatePageOnAllVCpus(pVM, GCVirt)                      do { } while (0)
 # define HMInvalidatePhysPage(pVM,  GCVirt)                           do { } while (0)
 # define HMAreNestedPagingAndFullGuestExecEnabled(pVM)                false
@@ -1889,7 +1889,7 @@ typedef const PDMRTCHLP *PCPDMRTCHLP;
 /** @}   */
 
 /** Current PDMDEVHLPR3 version number. */
-#define PDM_DEVHLPR3_VERSION                    PDM_VERSION_MAKE_PP(0xffe7, 22, 2)
+#define PDM_DEVHLPR3_VERSION                    PDM_VERSION_MAKE_PP(0xffe7, 22, 3)
 
 /**
  * PDM Device API.
@@ -3397,10 +3397,52 @@ typedef struct PDMDEVHLPR3
     DECLR3CALLBACKMEMBER(int, pfnMMIOExChangeRegionNo,(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, uint32_t iRegion,
                                                        uint32_t iNewRegion));
 
+    /**
+     * Sets the critical section serializing the callbacks of I/O port ranges.
+     *
+     * By default all I/O port and MMIO callbacks of a device are called while
+     * owning the device critical section (see pfnSetDeviceCritSect).  Devices
+     * with independent register blocks, like per-port or per-queue registers,
+     * can give each block its own critical section so accesses to different
+     * blocks don't serialize.  The device is then responsible for protecting
+     * any state shared between the blocks itself.
+     *
+     * This affects the R3, R0 and RC handlers of all ranges within the given
+     * interval, which must completely cover them.
+     *
+     * @returns VBox status code.
+     * @param   pDevIns             The device instance owning the ports.
+     * @param   Port                First port number in the interval.
+     * @param   cPorts              Number of ports in the interval.
+     * @param   pCritSect           The critical section.  This must be part of
+     *                              the instance data and initialized using
+     *                              pfnCritSectInit.  NULL to revert to the
+     *                              device critical section.
+     * @remarks Only call this during construction or from the PCI region map
+     *          callback right after registering the ranges.
+     * @sa      pfnMMIOSetCritSect
+     */
+    DECLR3CALLBACKMEMBER(int, pfnIOPortSetCritSect,(PPDMDEVINS pDevIns, RTIOPORT Port, RTIOPORT cPorts, PPDMCRITSECT pCritSect));
+
+    /**
+     * Sets the critical section serializing the callbacks of MMIO ranges.
+     *
+     * The MMIO counterpart to pfnIOPortSetCritSect.
+     *
+     * @returns VBox status code.
+     * @param   pDevIns             The device instance owning the MMIO region(s).
+     * @param   GCPhysStart         First physical address in the interval.
+     * @param   cbRange             The size of the interval (in bytes).
+     * @param   pCritSect           The critical section, NULL to revert to the
+     *                              device critical section.
+     * @remarks Only call this during construction or from the PCI region map
+     *          callback right after registering the ranges.
+     */
+    DECLR3CALLBACKMEMBER(int, pfnMMIOSetCritSect,(PPDMDEVINS pDevIns, RTGCPHYS GCPhysStart, RTGCPHYS cbRange,
+                                                  PPDMCRITSECT pCritSect));
+
     /** Space reserved for future members.
      * @{ */
-    DECLR3CALLBACKMEMBER(void, pfnReserved1,(void));
-    DECLR3CALLBACKMEMBER(void, pfnReserved2,(void));
     DECLR3CALLBACKMEMBER(void, pfnReserved3,(void));
     DECLR3CALLBACKMEMBER(void, pfnReserved4,(void));
     DECLR3CALLBACKMEMBER(void, pfnReserved5,(void));
@@ -4384,6 +4426,14 @@ DECLINLINE(int) PDMDevHlpIOPortDeregister(PPDMDEVINS pDevIns, RTIOPORT Port, RTI
     return pDevIns->pHlpR3->pfnIOPortDeregister(pDevIns, Port, cPorts);
 }
 
+/**
+ * @copydoc PDMDEVHLPR3::pfnIOPortSetCritSect
+ */
+DECLINLINE(int) PDMDevHlpIOPortSetCritSect(PPDMDEVINS pDevIns, RTIOPORT Port, RTIOPORT cPorts, PPDMCRITSECT pCritSect)
+{
+    return pDevIns->pHlpR3->pfnIOPortSetCritSect(pDevIns, Port, cPorts, pCritSect);
+}
+
 /**
  * Register a Memory Mapped I/O (MMIO) region.
  *
@@ -4489,6 +4539,14 @@ DECLINLINE(int) PDMDevHlpMMIODeregister(PPDMDEVINS pDevIns, RTGCPHYS GCPhysStart
     return pDevIns->pHlpR3->pfnMMIODeregister(pDevIns, GCPhysStart, cbRange);
 }
 
+/**
+ * @copydoc PDMDEVHLPR3::pfnMMIOSetCritSect
+ */
+DECLINLINE(int) PDMDevHlpMMIOSetCritSect(PPDMDEVINS pDevIns, RTGCPHYS GCPhysStart, RTGCPHYS cbRange, PPDMCRITSECT pCritSect)
+{
+    return pDevIns->pHlpR3->pfnMMIOSetCritSect(pDevIns, GCPhysStart, cbRange, pCritSect);
+}
+
 /**
  * @copydoc PDMDEVHLPR3::pfnMMIO2Register
  */
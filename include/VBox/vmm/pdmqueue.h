@@ -55,9 +55,9 @@ typedef struct PDMQUEUEITEMCORE
     R0PTRTYPE(PPDMQUEUEITEMCORE)    pNextR0;
     /** Pointer to the next item in the pending list - RC Pointer. */
     RCPTRTYPE(PPDMQUEUEITEMCORE)    pNextRC;
-#if HC_ARCH_BITS == 64
-    RTRCPTR                         Alignment0;
-#endif
+    /** Insertion sequence number, used to flush the items in the order they
+     * were inserted in across all contexts and CPUs. */
+    uint32_t                        u32Seq;
 } PDMQUEUEITEMCORE;
 
 
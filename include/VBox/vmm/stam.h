@@ -31,6 +31,7 @@
 
 #include <VBox/types.h>
 #include <iprt/stdarg.h>
+#include <iprt/assertcompile.h>
 #ifdef _MSC_VER
 # if _MSC_VER >= 1400
 #  pragma warning(push)
@@ -1119,6 +1120,7 @@ typedef const STAMRATIOU32 *PCSTAMRATIOU32;
 
 VMMR3DECL(int)  STAMR3InitUVM(PUVM pUVM);
 VMMR3DECL(void) STAMR3TermUVM(PUVM pUVM);
+VMMR3_INT_DECL(int) STAMR3InitFinalize(PVM pVM);
 VMMR3DECL(int)  STAMR3RegisterU(PUVM pUVM, void *pvSample, STAMTYPE enmType, STAMVISIBILITY enmVisibility,
                                 const char *pszName, STAMUNIT enmUnit, const char *pszDesc);
 VMMR3DECL(int)  STAMR3Register(PVM pVM, void *pvSample, STAMTYPE enmType, STAMVISIBILITY enmVisibility,
@@ -1232,6 +1234,156 @@ VMMR3DECL(int)  STAMR3DeregisterByAddr(PUVM pUVM, void *pvSample);
 VMMR3DECL(int)  STAMR3Reset(PUVM pUVM, const char *pszPat);
 VMMR3DECL(int)  STAMR3Snapshot(PUVM pUVM, const char *pszPat, char **ppszSnapshot, size_t *pcchSnapshot, bool fWithDesc);
 VMMR3DECL(int)  STAMR3SnapshotFree(PUVM pUVM, char *pszSnapshot);
+
+/** @name Binary snapshot format (STAMR3SnapshotBin).
+ *
+ * The snapshot starts with a STAMBINSNAPSHOTHDR followed by cSamples
+ * STAMBINSAMPLE records and, if requested or if the registrations changed
+ * since the generation the caller knows about, the name table.  The name
+ * table is a sequence of zero terminated sample names, one per sample index,
+ * in index order.  Sample indexes are only valid for the generation given
+ * in the header.
+ * @{ */
+/** The snapshot magic ('STAB'). */
+#define STAMBINSNAPSHOT_MAGIC       UINT32_C(0x42415453)
+/** The current snapshot version. */
+#define STAMBINSNAPSHOT_VERSION     UINT16_C(1)
+
+/**
+ * Binary snapshot header.
+ */
+typedef struct STAMBINSNAPSHOTHDR
+{
+    /** STAMBINSNAPSHOT_MAGIC. */
+    uint32_t    u32Magic;
+    /** STAMBINSNAPSHOT_VERSION. */
+    uint16_t    uVersion;
+    /** The size of this header. */
+    uint16_t    cbHdr;
+    /** The registration generation the sample indexes belong to. */
+    uint32_t    uGeneration;
+    /** The number of STAMBINSAMPLE records following the header. */
+    uint32_t    cSamples;
+    /** RTTimeNanoTS() taken when the values were copied. */
+    uint64_t    uNanoTS;
+    /** Offset of the name table relative to the start of the header, 0 if not included. */
+    uint32_t    offNames;
+    /** The size of the name table in bytes. */
+    uint32_t    cbNames;
+} STAMBINSNAPSHOTHDR;
+AssertCompileSize(STAMBINSNAPSHOTHDR, 32);
+/** Pointer to a binary snapshot header. */
+typedef STAMBINSNAPSHOTHDR *PSTAMBINSNAPSHOTHDR;
+/** Pointer to a const binary snapshot header. */
+typedef STAMBINSNAPSHOTHDR const *PCSTAMBINSNAPSHOTHDR;
+
+/**
+ * Binary snapshot sample record.
+ *
+ * The value layout depends on the type: counters and integer types use
+ * au64[0], ratios au64[0] (A) and au64[1] (B), profiles au64[0..3] for
+ * cPeriods, cTicks, cTicksMax and cTicksMin.
+ */
+typedef struct STAMBINSAMPLE
+{
+    /** The sample index (within the generation). */
+    uint32_t    iSample;
+    /** The sample type (STAMTYPE). */
+    uint8_t     enmType;
+    /** The sample unit (STAMUNIT). */
+    uint8_t     enmUnit;
+    /** Reserved, MBZ. */
+    uint16_t    u16Reserved;
+    /** The values. */
+    uint64_t    au64[4];
+} STAMBINSAMPLE;
+AssertCompileSize(STAMBINSAMPLE, 40);
+/** Pointer to a binary snapshot sample record. */
+typedef STAMBINSAMPLE *PSTAMBINSAMPLE;
+/** Pointer to a const binary snapshot sample record. */
+typedef STAMBINSAMPLE const *PCSTAMBINSAMPLE;
+/** @} */
+
+VMMR3DECL(int)  STAMR3SnapshotBin(PUVM pUVM, const char *pszPat, uint32_t uGenKnown, void **ppvSnapshot, size_t *pcbSnapshot);
+VMMR3DECL(int)  STAMR3SnapshotBinFree(PUVM pUVM, void *pvSnapshot);
+VMMR3DECL(uint32_t) STAMR3GetGeneration(PUVM pUVM);
+
+/** @name Binary telemetry stream format (STAMR3ExportStart).
+ *
+ * The stream starts with a STAMEXPORTHDR and is followed by records, each
+ * starting with a STAMEXPORTREC.  A schema record is written before the
+ * first data record and whenever the sample registrations change.  Its
+ * payload is the name table as described for STAMR3SnapshotBin, with
+ * cEntries names.  Data records carry cEntries STAMBINSAMPLE entries for the
+ * samples which changed since the previous data record (all of them in the
+ * first data record following a schema record).  The values are absolute,
+ * so a reader computes deltas against the last value it has seen and does
+ * not drift if it misses a record.
+ * @{ */
+/** The stream magic ('STAX'). */
+#define STAMEXPORT_MAGIC            UINT32_C(0x58415453)
+/** The current stream version. */
+#define STAMEXPORT_VERSION          UINT16_C(1)
+
+/**
+ * Binary telemetry stream header.
+ */
+typedef struct STAMEXPORTHDR
+{
+    /** STAMEXPORT_MAGIC. */
+    uint32_t    u32Magic;
+    /** STAMEXPORT_VERSION. */
+    uint16_t    uVersion;
+    /** The size of this header. */
+    uint16_t    cbHdr;
+    /** The sampling interval in milliseconds. */
+    uint32_t    cMsInterval;
+    /** Reserved, MBZ. */
+    uint32_t    u32Reserved;
+    /** RTTimeNanoTS() when the stream was started. */
+    uint64_t    uStartNanoTS;
+    /** The wall clock time (nanoseconds since the unix epoch) corresponding
+     *  to uStartNanoTS. */
+    int64_t     i64StartUnixNanoTS;
+} STAMEXPORTHDR;
+AssertCompileSize(STAMEXPORTHDR, 32);
+/** Pointer to a binary telemetry stream header. */
+typedef STAMEXPORTHDR *PSTAMEXPORTHDR;
+/** Pointer to a const binary telemetry stream header. */
+typedef STAMEXPORTHDR const *PCSTAMEXPORTHDR;
+
+/** Schema record: the payload is the name table. */
+#define STAMEXPORTREC_SCHEMA        UINT16_C(1)
+/** Data record: the payload is an array of STAMBINSAMPLE. */
+#define STAMEXPORTREC_DATA          UINT16_C(2)
+
+/**
+ * Binary telemetry stream record header.
+ */
+typedef struct STAMEXPORTREC
+{
+    /** The record type, STAMEXPORTREC_XXX. */
+    uint16_t    uType;
+    /** Reserved, MBZ. */
+    uint16_t    u16Reserved;
+    /** The size of the record including this header. */
+    uint32_t    cbRecord;
+    /** The registration generation the record belongs to. */
+    uint32_t    uGeneration;
+    /** The number of names (schema) or STAMBINSAMPLE entries (data). */
+    uint32_t    cEntries;
+    /** RTTimeNanoTS() when the samples were taken. */
+    uint64_t    uNanoTS;
+} STAMEXPORTREC;
+AssertCompileSize(STAMEXPORTREC, 24);
+/** Pointer to a binary telemetry stream record header. */
+typedef STAMEXPORTREC *PSTAMEXPORTREC;
+/** Pointer to a const binary telemetry stream record header. */
+typedef STAMEXPORTREC const *PCSTAMEXPORTREC;
+/** @} */
+
+VMMR3DECL(int)  STAMR3ExportStart(PUVM pUVM, const char *pszFilename, const char *pszPat, uint32_t cMsInterval);
+VMMR3DECL(int)  STAMR3ExportStop(PUVM pUVM);
 VMMR3DECL(int)  STAMR3Dump(PUVM pUVM, const char *pszPat);
 VMMR3DECL(int)  STAMR3DumpToReleaseLog(PUVM pUVM, const char *pszPat);
 VMMR3DECL(int)  STAMR3Print(PUVM pUVM, const char *pszPat);
@@ -1477,6 +1477,8 @@ typedef struct VM
             /** The number of enabled INT3 breakpoints. */
             uint8_t                     cEnabledInt3Breakpoints;
             uint8_t                     abPadding[1]; /**< Unused padding space up for grabs. */
+            /** The event classes the event tracer is recording, DBGFEVTTRACE_F_XXX. */
+            uint32_t                    fEvtTraceMask;
         } const     ro;
 #endif
         uint8_t     padding[2432];      /* multiple of 64 */
@@ -296,6 +296,9 @@ typedef struct VMREQ
     RTSEMEVENT              EventSem;
     /** Set if the event semaphore is clear. */
     volatile bool           fEventSemClear;
+    /** Completion handshake between the waiter and the EMT, only signalling
+     * EventSem when the waiter has actually gone to sleep (internal). */
+    volatile uint32_t       fWaitState;
     /** Flags, VMR3REQ_FLAGS_*. */
     unsigned                fFlags;
     /** Request type. */
@@ -486,6 +489,7 @@ VMMR3DECL(int)          VMR3ReqPriorityCallVoidWaitU(PUVM pUVM, VMCPUID idDstCpu
 VMMR3DECL(int)          VMR3ReqAlloc(PUVM pUVM, PVMREQ *ppReq, VMREQTYPE enmType, VMCPUID idDstCpu);
 VMMR3DECL(int)          VMR3ReqFree(PVMREQ pReq);
 VMMR3DECL(int)          VMR3ReqQueue(PVMREQ pReq, RTMSINTERVAL cMillies);
+VMMR3DECL(int)          VMR3ReqQueueBatch(PVMREQ *papReqs, uint32_t cReqs, RTMSINTERVAL cMillies);
 VMMR3DECL(int)          VMR3ReqWait(PVMREQ pReq, RTMSINTERVAL cMillies);
 VMMR3_INT_DECL(int)     VMR3ReqProcessU(PUVM pUVM, VMCPUID idDstCpu, bool fPriorityOnly);
 
@@ -1499,6 +1499,7 @@
 # define RTMpGetMaxCpuGroupCount                        RT_MANGLER(RTMpGetMaxCpuGroupCount)
 # define RTMpGetMaxCpuId                                RT_MANGLER(RTMpGetMaxCpuId)
 # define RTMpGetMaxFrequency                            RT_MANGLER(RTMpGetMaxFrequency)
+# define RTMpGetNodeOnlineSet                           RT_MANGLER(RTMpGetNodeOnlineSet)
 # define RTMpGetOnlineCount                             RT_MANGLER(RTMpGetOnlineCount)
 # define RTMpGetOnlineCoreCount                         RT_MANGLER(RTMpGetOnlineCoreCount)
 # define RTMpGetOnlineSet                               RT_MANGLER(RTMpGetOnlineSet)
@@ -208,6 +208,16 @@ RTDECL(RTCPUID) RTMpGetOnlineCoreCount(void);
  */
 RTDECL(bool) RTMpIsCpuOnline(RTCPUID idCpu);
 
+/**
+ * Gets the set of online CPUs belonging to a host NUMA node.
+ *
+ * @returns pSet on success, NULL if the host doesn't provide NUMA information
+ *          or the node doesn't have any online CPUs.
+ * @param   idNode  The host NUMA node number.
+ * @param   pSet    Where to put the set.
+ */
+RTDECL(PRTCPUSET) RTMpGetNodeOnlineSet(uint32_t idNode, PRTCPUSET pSet);
+
 
 /**
  * Gets set of the CPUs present in the system.
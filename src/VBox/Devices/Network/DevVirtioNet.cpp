@@ -50,9 +50,17 @@
 #ifdef IN_RING3
 
 #define VNET_PCI_CLASS               0x0200
+/** Number of queues of the single queue pair layout, used by old saved states. */
 #define VNET_N_QUEUES                3
 #define VNET_NAME_FMT                "VNet%d"
 
+/** The RX queue of a queue pair. */
+#define VNET_QUEUE_RX(a_iPair)       ((a_iPair) * 2)
+/** The TX queue of a queue pair. */
+#define VNET_QUEUE_TX(a_iPair)       ((a_iPair) * 2 + 1)
+/** The control queue comes after the last queue pair. */
+#define VNET_QUEUE_CTL(a_cPairs)     ((a_cPairs) * 2)
+
 #if 0
 /* Virtio Block Device */
 #define VNET_PCI_CLASS               0x0180
@@ -70,13 +78,31 @@
  */
 //#define VNET_TX_DELAY           150   /**< 150 microseconds */
 #define VNET_MAX_FRAME_SIZE     65535 + 18  /**< Max IP packet size + Ethernet header with VLAN tag */
+/** Largest non-GSO frame: standard MTU + Ethernet header with VLAN tag. */
+#define VNET_MAX_MTU_FRAME_SIZE (1500 + 18)
 #define VNET_MAC_FILTER_LEN     32
 #define VNET_MAX_VID            (1 << 12)
+/** Maximum number of RX/TX queue pairs. */
+#define VNET_MAX_QUEUE_PAIRS    16
+AssertCompile(VNET_MAX_QUEUE_PAIRS * 2 + 1 <= VIRTIO_MAX_NQUEUES);
+/** The size of the RSS hash key (Toeplitz, as used by most NICs). */
+#define VNET_RSS_MAX_KEY_SIZE   40
+/** Maximum length of the RSS indirection table. */
+#define VNET_RSS_MAX_INDIRECTION_TABLE 128
+
+/** The saved state version. */
+#define VNET_SAVEDSTATE_VERSION             5
+/** The saved state version before the guest could switch receive offloads. */
+#define VNET_SAVEDSTATE_VERSION_PRE_OFFLOADS 4
+/** The saved state version before multiqueue support, the versions up to this
+ * one are shared with the virtio core (VIRTIO_SAVEDSTATE_VERSION at the time). */
+#define VNET_SAVEDSTATE_VERSION_PRE_MQ      3
 
 /** @name Virtio net features
  * @{  */
 #define VNET_F_CSUM       0x00000001  /**< Host handles pkts w/ partial csum */
 #define VNET_F_GUEST_CSUM 0x00000002  /**< Guest handles pkts w/ partial csum */
+#define VNET_F_CTRL_GUEST_OFFLOADS 0x00000004  /**< Control channel offloads reconfiguration support */
 #define VNET_F_MAC        0x00000020  /**< Host has given MAC address. */
 #define VNET_F_GSO        0x00000040  /**< Host handles pkts w/ any GSO type */
 #define VNET_F_GUEST_TSO4 0x00000080  /**< Guest can handle TSOv4 in. */
@@ -92,6 +118,28 @@
 #define VNET_F_CTRL_VQ    0x00020000  /**< Control channel available */
 #define VNET_F_CTRL_RX    0x00040000  /**< Control channel RX mode support */
 #define VNET_F_CTRL_VLAN  0x00080000  /**< Control channel VLAN filtering */
+#define VNET_F_MQ         0x00400000  /**< Device supports multiple queue pairs */
+/** @} */
+
+/** The receive offloads the guest can switch with VNET_CTRL_CMD_GUEST_OFFLOADS_SET. */
+#define VNET_GUEST_OFFLOADS (VNET_F_GUEST_CSUM | VNET_F_GUEST_TSO4 | VNET_F_GUEST_TSO6 | VNET_F_GUEST_ECN | VNET_F_GUEST_UFO)
+
+/** @name Virtio net features 32 thru 63 (modern transport only)
+ * @{  */
+#define VNET_F_HI_RSS     0x10000000  /**< VIRTIO_NET_F_RSS (bit 60): Guest controlled receive steering */
+/** @} */
+
+/** @name RSS hash types
+ * @{  */
+#define VNET_RSS_HASH_TYPE_IPV4   RT_BIT_32(0)
+#define VNET_RSS_HASH_TYPE_TCPV4  RT_BIT_32(1)
+#define VNET_RSS_HASH_TYPE_UDPV4  RT_BIT_32(2)
+#define VNET_RSS_HASH_TYPE_IPV6   RT_BIT_32(3)
+#define VNET_RSS_HASH_TYPE_TCPV6  RT_BIT_32(4)
+#define VNET_RSS_HASH_TYPE_UDPV6  RT_BIT_32(5)
+#define VNET_RSS_HASH_TYPES_SUPPORTED \
+    (  VNET_RSS_HASH_TYPE_IPV4 | VNET_RSS_HASH_TYPE_TCPV4 | VNET_RSS_HASH_TYPE_UDPV4 \
+     | VNET_RSS_HASH_TYPE_IPV6 | VNET_RSS_HASH_TYPE_TCPV6 | VNET_RSS_HASH_TYPE_UDPV6)
 /** @} */
 
 #define VNET_S_LINK_UP    1
@@ -108,8 +156,79 @@ struct __attribute__ ((__packed__)) VNetPCIConfig /** @todo r=bird: Use #pragma
 {
     RTMAC    mac;
     uint16_t uStatus;
+    uint16_t uMaxVirtqueuePairs;      /**< Valid with VNET_F_MQ. */
+    uint16_t uMtu;                    /**< Unused, we do not offer VIRTIO_NET_F_MTU. */
+    uint32_t uSpeed;                  /**< Unused, we do not offer VIRTIO_NET_F_SPEED_DUPLEX. */
+    uint8_t  uDuplex;
+    uint8_t  cbRssMaxKey;             /**< Valid with VNET_F_HI_RSS. */
+    uint16_t cRssMaxIndirectionTable; /**< Valid with VNET_F_HI_RSS. */
+    uint32_t fRssSupportedHashTypes;  /**< Valid with VNET_F_HI_RSS. */
 };
 AssertCompileMemberOffset(struct VNetPCIConfig, uStatus, 6);
+AssertCompileMemberOffset(struct VNetPCIConfig, uMaxVirtqueuePairs, 8);
+AssertCompileMemberOffset(struct VNetPCIConfig, cbRssMaxKey, 17);
+AssertCompileSize(struct VNetPCIConfig, 24);
+
+/**
+ * Receive side scaling configuration, set by the guest through the control
+ * queue or defaulted when the number of queue pairs changes.
+ */
+typedef struct VNETRSS
+{
+    /** Hash types to steer by, VNET_RSS_HASH_TYPE_XXX. */
+    uint32_t                fHashTypes;
+    /** Applied to the hash to get the indirection table index. */
+    uint16_t                uIndirectionTableMask;
+    /** The queue pair receiving packets which cannot be hashed. */
+    uint16_t                uUnclassifiedQueue;
+    /** Maps hash values to queue pairs. */
+    uint16_t                au16IndirectionTable[VNET_RSS_MAX_INDIRECTION_TABLE];
+    /** The Toeplitz hash key. */
+    uint8_t                 abKey[VNET_RSS_MAX_KEY_SIZE];
+} VNETRSS;
+
+/**
+ * An RX/TX queue pair.
+ *
+ * Every pair has its own TX thread and RX lock. Pair N can have its own
+ * network connector attached to LUN \#N, pairs without one go through the
+ * connector on LUN \#0.
+ */
+typedef struct VNETQUEUEPAIR
+{
+    /** Serializes the receive paths storing into the RX queue. */
+    PDMCRITSECT                     CritSectRx;
+    /** Pointer to the device state. */
+    R3PTRTYPE(struct VNetState_st *) pThisR3;
+    R3PTRTYPE(PVQUEUE)              pRxQueue;
+    R3PTRTYPE(PVQUEUE)              pTxQueue;
+    /** LUN \#N: Base interface, unused by pair 0 which sits on the device LUN. */
+    PDMIBASE                        IBase;
+    /** The network down interface handed to the connector. */
+    PDMINETWORKDOWN                 INetworkDown;
+    /** LUN \#N: The attached driver, NULL for pair 0 (see VNETSTATE::pDrvBase). */
+    R3PTRTYPE(PPDMIBASE)            pDrvBase;
+    /** LUN \#N: The connector of the attached driver, NULL if sharing LUN \#0. */
+    R3PTRTYPE(PPDMINETWORKUP)       pDrv;
+#ifndef VNET_TX_DELAY
+    /** The event semaphore the TX thread waits on. */
+    SUPSEMEVENT                     hTxEvent;
+    R3PTRTYPE(PPDMTHREAD)           pTxThread;
+#endif
+    /** Gets signalled when more RX descriptors become available. */
+    RTSEMEVENT                      hEventMoreRxDescAvail;
+    /** Indicates transmission in progress -- only one thread is allowed. */
+    uint32_t volatile               uIsTransmitting;
+    /** The index of this pair. */
+    uint16_t                        iPair;
+    /** Set while the connector waits for RX descriptors. */
+    bool volatile                   fMaybeOutOfSpace;
+    bool                            afPadding[1];
+    STAMCOUNTER                     StatReceivePackets;
+    STAMCOUNTER                     StatTransmitPackets;
+} VNETQUEUEPAIR;
+/** Pointer to a queue pair. */
+typedef VNETQUEUEPAIR *PVNETQUEUEPAIR;
 
 /**
  * Device state structure. Holds the current state of device.
@@ -123,12 +242,9 @@ typedef struct VNetState_st
     /* VPCISTATE must be the first member! */
     VPCISTATE               VPCI;
 
-//    PDMCRITSECT             csRx;                           /**< Protects RX queue. */
-
-    PDMINETWORKDOWN         INetworkDown;
     PDMINETWORKCONFIG       INetworkConfig;
-    R3PTRTYPE(PPDMIBASE)    pDrvBase;                 /**< Attached network driver. */
-    R3PTRTYPE(PPDMINETWORKUP) pDrv;    /**< Connector of attached network driver. */
+    R3PTRTYPE(PPDMIBASE)    pDrvBase;                 /**< Attached network driver (LUN \#0). */
+    R3PTRTYPE(PPDMINETWORKUP) pDrv;    /**< Connector of attached network driver (LUN \#0). */
 
     R3PTRTYPE(PPDMQUEUE)    pCanRxQueueR3;           /**< Rx wakeup signaller - R3. */
     R0PTRTYPE(PPDMQUEUE)    pCanRxQueueR0;           /**< Rx wakeup signaller - R0. */
@@ -160,13 +276,12 @@ typedef struct VNetState_st
 #else /* !VNET_TX_DELAY */
     /** The support driver session handle. */
     R3R0PTRTYPE(PSUPDRVSESSION)     pSupDrvSession;
-    /** The event semaphore TX thread waits on. */
-    SUPSEMEVENT                     hTxEvent;
-    R3PTRTYPE(PPDMTHREAD)           pTxThread;
 #endif /* !VNET_TX_DELAY */
 
-    /** Indicates transmission in progress -- only one thread is allowed. */
-    uint32_t                uIsTransmitting;
+    /** Number of configured queue pairs. */
+    uint16_t                cPairs;
+    /** Number of queue pairs the guest uses, 1 until it negotiates VNET_F_MQ. */
+    uint16_t                cActivePairs;
 
     /** PCI config area holding MAC address as well as TBD. */
     struct VNetPCIConfig    config;
@@ -177,14 +292,12 @@ typedef struct VNetState_st
     /** Link up delay (in milliseconds). */
     uint32_t                cMsLinkUpDelay;
 
-    uint32_t                alignment;
+    /** The receive offloads currently enabled by the guest, VNET_GUEST_OFFLOADS bits. */
+    uint32_t                fGuestOffloads;
 
     /** Number of packet being sent/received to show in debug log. */
     uint32_t                u32PktNo;
 
-    /** N/A: */
-    bool volatile           fMaybeOutOfSpace;
-
     /** Promiscuous mode -- RX filter accepts all packets. */
     bool                    fPromiscuous;
     /** AllMulti mode -- RX filter accepts all multicast packets. */
@@ -196,19 +309,19 @@ typedef struct VNetState_st
     /** Bit array of VLAN filter, one bit per VLAN ID. */
     uint8_t                 aVlanFilter[VNET_MAX_VID / sizeof(uint8_t)];
 
-    R3PTRTYPE(PVQUEUE)      pRxQueue;
-    R3PTRTYPE(PVQUEUE)      pTxQueue;
     R3PTRTYPE(PVQUEUE)      pCtlQueue;
-    /* Receive-blocking-related fields ***************************************/
 
-    /** EMT: Gets signalled when more RX descriptors become available. */
-    RTSEMEVENT              hEventMoreRxDescAvail;
+    /** Receive steering configuration. */
+    VNETRSS                 Rss;
+    /** The queue pairs. */
+    VNETQUEUEPAIR           aPairs[VNET_MAX_QUEUE_PAIRS];
 
     /** @name Statistic
      * @{ */
     STAMCOUNTER             StatReceiveBytes;
     STAMCOUNTER             StatTransmitBytes;
     STAMCOUNTER             StatReceiveGSO;
+    STAMCOUNTER             StatReceiveNoBufs;
     STAMCOUNTER             StatTransmitPackets;
     STAMCOUNTER             StatTransmitGSO;
     STAMCOUNTER             StatTransmitCSum;
@@ -276,6 +389,13 @@ typedef uint8_t VNETCTLACK;
 #define VNET_CTRL_CMD_VLAN_ADD         0
 #define VNET_CTRL_CMD_VLAN_DEL         1
 
+#define VNET_CTRL_CLS_MQ               4
+#define VNET_CTRL_CMD_MQ_VQ_PAIRS_SET  0
+#define VNET_CTRL_CMD_MQ_RSS_CONFIG    1
+
+#define VNET_CTRL_CLS_GUEST_OFFLOADS     5
+#define VNET_CTRL_CMD_GUEST_OFFLOADS_SET 0
+
 
 struct VNetCtlHdr
 {
@@ -294,6 +414,19 @@ DECLINLINE(bool) vnetMergeableRxBuffers(PVNETSTATE pThis)
     return !!(pThis->VPCI.uGuestFeatures & VNET_F_MRG_RXBUF);
 }
 
+/**
+ * Returns the size of the header preceding every frame. Virtio 1.0 drivers
+ * always use the one with the buffer count, legacy ones only together with
+ * mergeable RX buffers.
+ */
+DECLINLINE(uint32_t) vnetHdrSize(PVNETSTATE pThis)
+{
+    if (   vnetMergeableRxBuffers(pThis)
+        || (pThis->VPCI.uGuestFeaturesHi & VPCI_F_HI_VERSION_1))
+        return sizeof(VNETHDRMRX);
+    return sizeof(VNETHDR);
+}
+
 DECLINLINE(int) vnetCsEnter(PVNETSTATE pThis, int rcBusy)
 {
     return vpciCsEnter(&pThis->VPCI, rcBusy);
@@ -304,25 +437,89 @@ DECLINLINE(void) vnetCsLeave(PVNETSTATE pThis)
     vpciCsLeave(&pThis->VPCI);
 }
 
-#endif /* IN_RING3 */
+DECLINLINE(int) vnetCsRxEnter(PVNETQUEUEPAIR pPair, int rcBusy)
+{
+    return PDMCritSectEnter(&pPair->CritSectRx, rcBusy);
+}
 
-DECLINLINE(int) vnetCsRxEnter(PVNETSTATE pThis, int rcBusy)
+DECLINLINE(void) vnetCsRxLeave(PVNETQUEUEPAIR pPair)
 {
-    RT_NOREF_PV(pThis);
-    RT_NOREF_PV(rcBusy);
-    // STAM_PROFILE_START(&pThis->CTXSUFF(StatCsRx), a);
-    // int rc = PDMCritSectEnter(&pThis->csRx, rcBusy);
-    // STAM_PROFILE_STOP(&pThis->CTXSUFF(StatCsRx), a);
-    // return rc;
-    return VINF_SUCCESS;
+    PDMCritSectLeave(&pPair->CritSectRx);
+}
+
+/**
+ * Enters the RX locks of all queue pairs, keeping the receive paths out.
+ */
+static void vnetCsRxEnterAll(PVNETSTATE pThis)
+{
+    for (unsigned i = 0; i < pThis->cPairs; i++)
+        vnetCsRxEnter(&pThis->aPairs[i], VERR_IGNORED);
+}
+
+static void vnetCsRxLeaveAll(PVNETSTATE pThis)
+{
+    for (unsigned i = pThis->cPairs; i > 0; i--)
+        vnetCsRxLeave(&pThis->aPairs[i - 1]);
+}
+
+/**
+ * Returns the connector a queue pair sends through.
+ */
+DECLINLINE(PPDMINETWORKUP) vnetPairDrv(PVNETSTATE pThis, PVNETQUEUEPAIR pPair)
+{
+    return pPair->pDrv ? pPair->pDrv : pThis->pDrv;
+}
+
+/**
+ * Sets the promiscuous mode on all attached connectors.
+ */
+static void vnetSetPromiscuousMode(PVNETSTATE pThis, bool fPromiscuous)
+{
+    if (pThis->pDrv)
+        pThis->pDrv->pfnSetPromiscuousMode(pThis->pDrv, fPromiscuous);
+    for (unsigned i = 1; i < pThis->cPairs; i++)
+        if (pThis->aPairs[i].pDrv)
+            pThis->aPairs[i].pDrv->pfnSetPromiscuousMode(pThis->aPairs[i].pDrv, fPromiscuous);
 }
 
-DECLINLINE(void) vnetCsRxLeave(PVNETSTATE pThis)
+/**
+ * Tells all attached connectors about a link state change.
+ */
+static void vnetNotifyLinkChanged(PVNETSTATE pThis, PDMNETWORKLINKSTATE enmState)
 {
-    RT_NOREF_PV(pThis);
-    // PDMCritSectLeave(&pThis->csRx);
+    if (pThis->pDrv)
+        pThis->pDrv->pfnNotifyLinkChanged(pThis->pDrv, enmState);
+    for (unsigned i = 1; i < pThis->cPairs; i++)
+        if (pThis->aPairs[i].pDrv)
+            pThis->aPairs[i].pDrv->pfnNotifyLinkChanged(pThis->aPairs[i].pDrv, enmState);
+}
+
+/**
+ * Spreads the flows evenly over the active queue pairs, used until the guest
+ * configures receive steering itself.
+ *
+ * @param   pThis       The device state structure.
+ */
+static void vnetRssSetDefault(PVNETSTATE pThis)
+{
+    /* The key most NICs and guests default to. */
+    static const uint8_t s_abDefaultKey[VNET_RSS_MAX_KEY_SIZE] =
+    {
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3,
+        0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3,
+        0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+    };
+
+    pThis->Rss.fHashTypes            = VNET_RSS_HASH_TYPES_SUPPORTED;
+    pThis->Rss.uIndirectionTableMask = VNET_RSS_MAX_INDIRECTION_TABLE - 1;
+    pThis->Rss.uUnclassifiedQueue    = 0;
+    for (unsigned i = 0; i < VNET_RSS_MAX_INDIRECTION_TABLE; i++)
+        pThis->Rss.au16IndirectionTable[i] = (uint16_t)(i % pThis->cActivePairs);
+    memcpy(pThis->Rss.abKey, s_abDefaultKey, sizeof(pThis->Rss.abKey));
 }
 
+#endif /* IN_RING3 */
+
 #ifdef IN_RING3
 /**
  * Dump a packet to debug log.
@@ -366,6 +563,7 @@ DECLINLINE(void) vnetPrintFeatures(PVNETSTATE pThis, uint32_t fFeatures, const c
     {
         { VNET_F_CSUM,       "host handles pkts w/ partial csum" },
         { VNET_F_GUEST_CSUM, "guest handles pkts w/ partial csum" },
+        { VNET_F_CTRL_GUEST_OFFLOADS, "control channel offloads reconfiguration support" },
         { VNET_F_MAC,        "host has given MAC address" },
         { VNET_F_GSO,        "host handles pkts w/ any GSO type" },
         { VNET_F_GUEST_TSO4, "guest can handle TSOv4 in" },
@@ -380,7 +578,8 @@ DECLINLINE(void) vnetPrintFeatures(PVNETSTATE pThis, uint32_t fFeatures, const c
         { VNET_F_STATUS,     "virtio_net_config.status available" },
         { VNET_F_CTRL_VQ,    "control channel available" },
         { VNET_F_CTRL_RX,    "control channel RX mode support" },
-        { VNET_F_CTRL_VLAN,  "control channel VLAN filtering" }
+        { VNET_F_CTRL_VLAN,  "control channel VLAN filtering" },
+        { VNET_F_MQ,         "multiple queue pairs" }
     };
 
     Log3(("%s %s:\n", INSTANCE(pThis), pcszText));
@@ -396,7 +595,7 @@ DECLINLINE(void) vnetPrintFeatures(PVNETSTATE pThis, uint32_t fFeatures, const c
 
 static DECLCALLBACK(uint32_t) vnetIoCb_GetHostFeatures(void *pvState)
 {
-    RT_NOREF_PV(pvState);
+    PVNETSTATE pThis = (PVNETSTATE)pvState;
 
     /* We support:
      * - Host-provided MAC address
@@ -405,8 +604,10 @@ static DECLCALLBACK(uint32_t) vnetIoCb_GetHostFeatures(void *pvState)
      * - RX mode setting
      * - MAC filter table
      * - VLAN filter
+     * - Multiple queue pairs, if configured
      */
-    return VNET_F_MAC
+    return (pThis->cPairs > 1 ? VNET_F_MQ : 0)
+        | VNET_F_MAC
         | VNET_F_STATUS
         | VNET_F_CTRL_VQ
         | VNET_F_CTRL_RX
@@ -420,6 +621,7 @@ static DECLCALLBACK(uint32_t) vnetIoCb_GetHostFeatures(void *pvState)
         | VNET_F_GUEST_TSO4
         | VNET_F_GUEST_TSO6
         | VNET_F_GUEST_UFO
+        | VNET_F_CTRL_GUEST_OFFLOADS
 #endif
 #ifdef VNET_WITH_MERGEABLE_RX_BUFS
         | VNET_F_MRG_RXBUF
@@ -435,10 +637,11 @@ static DECLCALLBACK(uint32_t) vnetIoCb_GetHostMinimalFeatures(void *pvState)
 
 static DECLCALLBACK(void) vnetIoCb_SetHostFeatures(void *pvState, uint32_t fFeatures)
 {
-    /** @todo Nothing to do here yet */
     PVNETSTATE pThis = (PVNETSTATE)pvState;
     LogFlow(("%s vnetIoCb_SetHostFeatures: uFeatures=%x\n", INSTANCE(pThis), fFeatures));
     vnetPrintFeatures(pThis, fFeatures, "The guest negotiated the following features");
+    /* All negotiated receive offloads start out enabled. */
+    pThis->fGuestOffloads = fFeatures & VNET_GUEST_OFFLOADS;
 }
 
 static DECLCALLBACK(int) vnetIoCb_GetConfig(void *pvState, uint32_t offCfg, uint32_t cb, void *data)
@@ -475,17 +678,20 @@ static DECLCALLBACK(int) vnetIoCb_SetConfig(void *pvState, uint32_t offCfg, uint
  */
 static DECLCALLBACK(int) vnetIoCb_Reset(void *pvState)
 {
+#ifndef IN_RING3
+    /* The receive paths are serialized by ring-3 only locks. */
+    RT_NOREF(pvState);
+    return VINF_IOM_R3_IOPORT_WRITE;
+#else
     PVNETSTATE pThis = (PVNETSTATE)pvState;
     Log(("%s Reset triggered\n", INSTANCE(pThis)));
 
-    int rc = vnetCsRxEnter(pThis, VERR_SEM_BUSY);
-    if (RT_UNLIKELY(rc != VINF_SUCCESS))
-    {
-        LogRel(("vnetIoCb_Reset failed to enter RX critical section!\n"));
-        return rc;
-    }
+    vnetCsRxEnterAll(pThis);
     vpciReset(&pThis->VPCI);
-    vnetCsRxLeave(pThis);
+    pThis->cActivePairs   = 1;
+    pThis->fGuestOffloads = 0;
+    vnetRssSetDefault(pThis);
+    vnetCsRxLeaveAll(pThis);
 
     /// @todo Implement reset
     if (pThis->fCableConnected)
@@ -503,12 +709,9 @@ static DECLCALLBACK(int) vnetIoCb_Reset(void *pvState)
     pThis->nMacFilterEntries = 0;
     memset(pThis->aMacFilter,  0, VNET_MAC_FILTER_LEN * sizeof(RTMAC));
     memset(pThis->aVlanFilter, 0, sizeof(pThis->aVlanFilter));
-    pThis->uIsTransmitting   = 0;
-#ifndef IN_RING3
-    return VINF_IOM_R3_IOPORT_WRITE;
-#else
-    if (pThis->pDrv)
-        pThis->pDrv->pfnSetPromiscuousMode(pThis->pDrv, true);
+    for (unsigned i = 0; i < pThis->cPairs; i++)
+        pThis->aPairs[i].uIsTransmitting = 0;
+    vnetSetPromiscuousMode(pThis, true);
     return VINF_SUCCESS;
 #endif
 }
@@ -521,11 +724,15 @@ static DECLCALLBACK(int) vnetIoCb_Reset(void *pvState)
 static void vnetWakeupReceive(PPDMDEVINS pDevIns)
 {
     PVNETSTATE pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
-    if (    pThis->fMaybeOutOfSpace
-        &&  pThis->hEventMoreRxDescAvail != NIL_RTSEMEVENT)
+    /* Packets get steered to any RX queue, so every waiting connector is woken up. */
+    for (unsigned i = 0; i < pThis->cPairs; i++)
     {
-        STAM_COUNTER_INC(&pThis->StatRxOverflowWakeup);
-        Log(("%s Waking up Out-of-RX-space semaphore\n",  INSTANCE(pThis)));
+        PVNETQUEUEPAIR pPair = &pThis->aPairs[i];
+        if (    pPair->fMaybeOutOfSpace
+            &&  pPair->hEventMoreRxDescAvail != NIL_RTSEMEVENT)
+        {
+            STAM_COUNTER_INC(&pThis->StatRxOverflowWakeup);
+            Log(("%s Waking up Out-of-RX-space semaphore of LUN#%u\n",  INSTANCE(pThis), i));
 /**
  * @todo r=bird: We can wake stuff up from ring-0 too, see vmsvga, nvme,
  *        buslogic, lsilogic, ata, ahci, xhci.  Also, please address similar
@@ -533,7 +740,8 @@ static void vnetWakeupReceive(PPDMDEVINS pDevIns)
  *
  *        The API Is SUPSem*, btw.
  */
-        RTSemEventSignal(pThis->hEventMoreRxDescAvail);
+            RTSemEventSignal(pPair->hEventMoreRxDescAvail);
+        }
     }
 }
 
@@ -590,8 +798,7 @@ static DECLCALLBACK(void) vnetLinkUpTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, v
     vnetWakeupReceive(pDevIns);
     vnetCsLeave(pThis);
     Log(("%s vnetLinkUpTimer: Link is up\n", INSTANCE(pThis)));
-    if (pThis->pDrv)
-        pThis->pDrv->pfnNotifyLinkChanged(pThis->pDrv, PDMNETWORKLINKSTATE_UP);
+    vnetNotifyLinkChanged(pThis, PDMNETWORKLINKSTATE_UP);
 }
 
 
@@ -669,76 +876,114 @@ PDMBOTHCBDECL(int) vnetIOPortOut(PPDMDEVINS pDevIns, void *pvUser, RTIOPORT port
 #ifdef IN_RING3
 
 /**
- * Check if the device can receive data now.
- * This must be called before the pfnRecieve() method is called.
+ * Check if a queue pair can receive data now.
  *
  * @remarks As a side effect this function enables queue notification
  *          if it cannot receive because the queue is empty.
  *          It disables notification if it can receive.
  *
  * @returns VERR_NET_NO_BUFFER_SPACE if it cannot.
- * @param   pInterface      Pointer to the interface structure containing the called function pointer.
+ * @param   pThis           The device state structure.
+ * @param   pPair           The queue pair, the caller owns its RX lock.
  * @thread  RX
  */
-static int vnetCanReceive(PVNETSTATE pThis)
+static int vnetCanReceive(PVNETSTATE pThis, PVNETQUEUEPAIR pPair)
 {
-    int rc = vnetCsRxEnter(pThis, VERR_SEM_BUSY);
-    AssertRCReturn(rc, rc);
+    int rc;
 
-    LogFlow(("%s vnetCanReceive\n", INSTANCE(pThis)));
+    LogFlow(("%s vnetCanReceive: pair %u\n", INSTANCE(pThis), pPair->iPair));
     if (!(pThis->VPCI.uStatus & VPCI_STATUS_DRV_OK))
         rc = VERR_NET_NO_BUFFER_SPACE;
-    else if (!vqueueIsReady(&pThis->VPCI, pThis->pRxQueue))
+    else if (pPair->iPair >= pThis->cActivePairs)
+        rc = VERR_NET_NO_BUFFER_SPACE;
+    else if (!vqueueIsReady(&pThis->VPCI, pPair->pRxQueue))
+        rc = VERR_NET_NO_BUFFER_SPACE;
+    else if (vqueueIsEmpty(&pThis->VPCI, pPair->pRxQueue))
+    {
+        vringSetNotification(&pThis->VPCI, &pPair->pRxQueue->VRing, true);
         rc = VERR_NET_NO_BUFFER_SPACE;
-    else if (vqueueIsEmpty(&pThis->VPCI, pThis->pRxQueue))
+    }
+    else if (   vnetMergeableRxBuffers(pThis)
+             && !vqueueCountAvailIn(&pThis->VPCI, pPair->pRxQueue, vnetHdrSize(pThis) + VNET_MAX_MTU_FRAME_SIZE))
     {
-        vringSetNotification(&pThis->VPCI, &pThis->pRxQueue->VRing, true);
+        /* Small mergeable buffers: wait until a full sized frame fits, vnetHandleRxPacket takes all or nothing. */
+        vringSetNotification(&pThis->VPCI, &pPair->pRxQueue->VRing, true);
         rc = VERR_NET_NO_BUFFER_SPACE;
     }
     else
     {
-        vringSetNotification(&pThis->VPCI, &pThis->pRxQueue->VRing, false);
+        vringSetNotification(&pThis->VPCI, &pPair->pRxQueue->VRing, false);
         rc = VINF_SUCCESS;
     }
 
     LogFlow(("%s vnetCanReceive -> %Rrc\n", INSTANCE(pThis), rc));
-    vnetCsRxLeave(pThis);
     return rc;
 }
 
+/**
+ * Finds a queue pair which can receive a packet, entering its RX lock.
+ *
+ * The steering decision is only a preference, a packet goes to another queue
+ * pair rather than being dropped when the preferred RX queue is full.
+ *
+ * @returns The queue pair, NULL if no RX queue has space.
+ * @param   pThis           The device state structure.
+ * @param   iPreferred      The queue pair the packet was steered to.
+ * @thread  RX
+ */
+static PVNETQUEUEPAIR vnetRxPairEnter(PVNETSTATE pThis, unsigned iPreferred)
+{
+    unsigned const cPairs = pThis->cActivePairs;
+    for (unsigned i = 0; i < cPairs; i++)
+    {
+        PVNETQUEUEPAIR pPair = &pThis->aPairs[(iPreferred + i) % cPairs];
+        int rc = vnetCsRxEnter(pPair, VERR_SEM_BUSY);
+        AssertRCReturn(rc, NULL);
+        if (RT_SUCCESS(vnetCanReceive(pThis, pPair)))
+            return pPair;
+        vnetCsRxLeave(pPair);
+    }
+    return NULL;
+}
+
 /**
  * @interface_method_impl{PDMINETWORKDOWN,pfnWaitReceiveAvail}
  */
 static DECLCALLBACK(int) vnetNetworkDown_WaitReceiveAvail(PPDMINETWORKDOWN pInterface, RTMSINTERVAL cMillies)
 {
-    PVNETSTATE pThis = RT_FROM_MEMBER(pInterface, VNETSTATE, INetworkDown);
-    LogFlow(("%s vnetNetworkDown_WaitReceiveAvail(cMillies=%u)\n", INSTANCE(pThis), cMillies));
-    int rc = vnetCanReceive(pThis);
+    PVNETQUEUEPAIR pPair = RT_FROM_MEMBER(pInterface, VNETQUEUEPAIR, INetworkDown);
+    PVNETSTATE     pThis = pPair->pThisR3;
+    LogFlow(("%s vnetNetworkDown_WaitReceiveAvail(cMillies=%u) LUN#%u\n", INSTANCE(pThis), cMillies, pPair->iPair));
 
-    if (RT_SUCCESS(rc))
+    PVNETQUEUEPAIR pRxPair = vnetRxPairEnter(pThis, pPair->iPair);
+    if (pRxPair)
+    {
+        vnetCsRxLeave(pRxPair);
         return VINF_SUCCESS;
+    }
     if (RT_UNLIKELY(cMillies == 0))
         return VERR_NET_NO_BUFFER_SPACE;
 
-    rc = VERR_INTERRUPTED;
-    ASMAtomicXchgBool(&pThis->fMaybeOutOfSpace, true);
+    int rc = VERR_INTERRUPTED;
+    ASMAtomicXchgBool(&pPair->fMaybeOutOfSpace, true);
     STAM_PROFILE_START(&pThis->StatRxOverflow, a);
 
     VMSTATE enmVMState;
     while (RT_LIKELY(   (enmVMState = PDMDevHlpVMState(pThis->VPCI.CTX_SUFF(pDevIns))) == VMSTATE_RUNNING
                      ||  enmVMState == VMSTATE_RUNNING_LS))
     {
-        int rc2 = vnetCanReceive(pThis);
-        if (RT_SUCCESS(rc2))
+        pRxPair = vnetRxPairEnter(pThis, pPair->iPair);
+        if (pRxPair)
         {
+            vnetCsRxLeave(pRxPair);
             rc = VINF_SUCCESS;
             break;
         }
         Log(("%s vnetNetworkDown_WaitReceiveAvail: waiting cMillies=%u...\n", INSTANCE(pThis), cMillies));
-        RTSemEventWait(pThis->hEventMoreRxDescAvail, cMillies);
+        RTSemEventWait(pPair->hEventMoreRxDescAvail, cMillies);
     }
     STAM_PROFILE_STOP(&pThis->StatRxOverflow, a);
-    ASMAtomicXchgBool(&pThis->fMaybeOutOfSpace, false);
+    ASMAtomicXchgBool(&pPair->fMaybeOutOfSpace, false);
 
     LogFlow(("%s vnetNetworkDown_WaitReceiveAvail -> %d\n", INSTANCE(pThis), rc));
     return rc;
@@ -753,11 +998,25 @@ static DECLCALLBACK(void *) vnetQueryInterface(struct PDMIBASE *pInterface, cons
     PVNETSTATE pThis = RT_FROM_MEMBER(pInterface, VNETSTATE, VPCI.IBase);
     Assert(&pThis->VPCI.IBase == pInterface);
 
-    PDMIBASE_RETURN_INTERFACE(pszIID, PDMINETWORKDOWN, &pThis->INetworkDown);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMINETWORKDOWN, &pThis->aPairs[0].INetworkDown);
     PDMIBASE_RETURN_INTERFACE(pszIID, PDMINETWORKCONFIG, &pThis->INetworkConfig);
     return vpciQueryInterface(pInterface, pszIID);
 }
 
+/**
+ * @interface_method_impl{PDMIBASE,pfnQueryInterface, For the LUNs of the
+ *                       queue pairs other than the first.}
+ */
+static DECLCALLBACK(void *) vnetPairQueryInterface(struct PDMIBASE *pInterface, const char *pszIID)
+{
+    PVNETQUEUEPAIR pPair = RT_FROM_MEMBER(pInterface, VNETQUEUEPAIR, IBase);
+
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIBASE, &pPair->IBase);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMINETWORKDOWN, &pPair->INetworkDown);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMINETWORKCONFIG, &pPair->pThisR3->INetworkConfig);
+    return NULL;
+}
+
 /**
  * Returns true if it is a broadcast packet.
  *
@@ -825,6 +1084,109 @@ static bool vnetAddressFilter(PVNETSTATE pThis, const void *pvBuf, size_t cb)
     return false;
 }
 
+/**
+ * Calculates the Toeplitz hash of the input.
+ *
+ * @returns The hash value.
+ * @param   pbKey           The key, VNET_RSS_MAX_KEY_SIZE bytes.
+ * @param   pbInput         The input, at most VNET_RSS_MAX_KEY_SIZE - 4 bytes.
+ * @param   cbInput         The size of the input.
+ */
+static uint32_t vnetToeplitzHash(const uint8_t *pbKey, const uint8_t *pbInput, size_t cbInput)
+{
+    Assert(cbInput + sizeof(uint32_t) <= VNET_RSS_MAX_KEY_SIZE);
+    uint32_t uHash   = 0;
+    uint32_t uWindow = RT_MAKE_U32_FROM_U8(pbKey[3], pbKey[2], pbKey[1], pbKey[0]);
+    for (size_t i = 0; i < cbInput; i++)
+    {
+        uint8_t const bKey = pbKey[i + sizeof(uint32_t)];
+        for (int iBit = 7; iBit >= 0; iBit--)
+        {
+            if (pbInput[i] & RT_BIT_32(iBit))
+                uHash ^= uWindow;
+            uWindow = (uWindow << 1) | ((bKey >> iBit) & 1);
+        }
+    }
+    return uHash;
+}
+
+/**
+ * Picks the queue pair a received packet is steered to.
+ *
+ * The hash covers the IP addresses and, unless the packet is a fragment, the
+ * TCP or UDP ports, as configured by the guest.
+ *
+ * @returns The queue pair index.
+ * @param   pThis           The device state structure.
+ * @param   pbFrame         The ethernet frame.
+ * @param   cbFrame         The size of the frame.
+ */
+static unsigned vnetRssSteer(PVNETSTATE pThis, const uint8_t *pbFrame, size_t cbFrame)
+{
+    if (pThis->cActivePairs <= 1)
+        return 0;
+
+    uint32_t const fHashTypes = pThis->Rss.fHashTypes;
+    uint8_t        abInput[2 * sizeof(RTNETADDRIPV6) + 2 * sizeof(uint16_t)];
+    size_t         cbInput = 0;
+    size_t         off     = sizeof(RTNETETHERHDR);
+    size_t         offL4   = 0;
+    bool           fL4     = false;
+    uint16_t       uEtherType;
+
+    if (cbFrame < off)
+        return pThis->Rss.uUnclassifiedQueue;
+    uEtherType = RT_BE2H_U16(((PCRTNETETHERHDR)pbFrame)->EtherType);
+    if (uEtherType == RTNET_ETHERTYPE_VLAN && cbFrame >= off + sizeof(uint32_t))
+    {
+        uEtherType = RT_MAKE_U16(pbFrame[off + 3], pbFrame[off + 2]);
+        off += sizeof(uint32_t);
+    }
+
+    if (   uEtherType == RTNET_ETHERTYPE_IPV4
+        && (fHashTypes & (VNET_RSS_HASH_TYPE_IPV4 | VNET_RSS_HASH_TYPE_TCPV4 | VNET_RSS_HASH_TYPE_UDPV4))
+        && cbFrame >= off + RTNETIPV4_MIN_LEN)
+    {
+        PCRTNETIPV4 pIpHdr = (PCRTNETIPV4)&pbFrame[off];
+        memcpy(&abInput[0], &pIpHdr->ip_src, sizeof(pIpHdr->ip_src));
+        memcpy(&abInput[4], &pIpHdr->ip_dst, sizeof(pIpHdr->ip_dst));
+        cbInput = 8;
+        offL4   = off + pIpHdr->ip_hl * 4;
+        if (!(RT_BE2H_U16(pIpHdr->ip_off) & (RTNETIPV4_FLAGS_MF | 0x1fff)))
+            fL4 =    (pIpHdr->ip_p == RTNETIPV4_PROT_TCP && (fHashTypes & VNET_RSS_HASH_TYPE_TCPV4))
+                  || (pIpHdr->ip_p == RTNETIPV4_PROT_UDP && (fHashTypes & VNET_RSS_HASH_TYPE_UDPV4));
+        if (!fL4 && !(fHashTypes & VNET_RSS_HASH_TYPE_IPV4))
+            return pThis->Rss.uUnclassifiedQueue;
+    }
+    else if (   uEtherType == RTNET_ETHERTYPE_IPV6
+             && (fHashTypes & (VNET_RSS_HASH_TYPE_IPV6 | VNET_RSS_HASH_TYPE_TCPV6 | VNET_RSS_HASH_TYPE_UDPV6))
+             && cbFrame >= off + sizeof(RTNETIPV6))
+    {
+        PCRTNETIPV6 pIpHdr = (PCRTNETIPV6)&pbFrame[off];
+        memcpy(&abInput[0],  &pIpHdr->ip6_src, sizeof(pIpHdr->ip6_src));
+        memcpy(&abInput[16], &pIpHdr->ip6_dst, sizeof(pIpHdr->ip6_dst));
+        cbInput = 32;
+        /* Extension headers are not parsed, such packets are hashed by address only. */
+        offL4   = off + sizeof(RTNETIPV6);
+        fL4     =    (pIpHdr->ip6_nxt == RTNETIPV4_PROT_TCP && (fHashTypes & VNET_RSS_HASH_TYPE_TCPV6))
+                  || (pIpHdr->ip6_nxt == RTNETIPV4_PROT_UDP && (fHashTypes & VNET_RSS_HASH_TYPE_UDPV6));
+        if (!fL4 && !(fHashTypes & VNET_RSS_HASH_TYPE_IPV6))
+            return pThis->Rss.uUnclassifiedQueue;
+    }
+    else
+        return pThis->Rss.uUnclassifiedQueue;
+
+    /* The source and destination ports lead both the TCP and UDP headers. */
+    if (fL4 && cbFrame >= offL4 + 2 * sizeof(uint16_t))
+    {
+        memcpy(&abInput[cbInput], &pbFrame[offL4], 2 * sizeof(uint16_t));
+        cbInput += 2 * sizeof(uint16_t);
+    }
+
+    uint32_t const uHash = vnetToeplitzHash(pThis->Rss.abKey, abInput, cbInput);
+    return pThis->Rss.au16IndirectionTable[uHash & pThis->Rss.uIndirectionTableMask];
+}
+
 /**
  * Pad and store received packet.
  *
@@ -837,12 +1199,11 @@ static bool vnetAddressFilter(PVNETSTATE pThis, const void *pvBuf, size_t cb)
  * @param   cb              Number of bytes available in the buffer.
  * @thread  RX
  */
-static int vnetHandleRxPacket(PVNETSTATE pThis, const void *pvBuf, size_t cb,
+static int vnetHandleRxPacket(PVNETSTATE pThis, PVQUEUE pRxQueue, const void *pvBuf, size_t cb,
                               PCPDMNETWORKGSO pGso)
 {
     VNETHDRMRX   Hdr;
-    unsigned    uHdrLen;
-    RTGCPHYS     addrHdrMrx = 0;
+    uint32_t     uHdrLen = vnetHdrSize(pThis);
 
     if (pGso)
     {
@@ -875,12 +1236,29 @@ static int vnetHandleRxPacket(PVNETSTATE pThis, const void *pvBuf, size_t cb,
     {
         Hdr.Hdr.u8Flags   = 0;
         Hdr.Hdr.u8GSOType = VNETHDR_GSO_NONE;
+        Hdr.Hdr.u16HdrLen     = 0;
+        Hdr.Hdr.u16GSOSize    = 0;
+        Hdr.Hdr.u16CSumStart  = 0;
+        Hdr.Hdr.u16CSumOffset = 0;
     }
 
+    /*
+     * With mergeable buffers make sure the whole frame fits before taking
+     * anything off the ring, the guest must never see a partial frame. The
+     * buffer count also has to be in the header before the first buffer is
+     * handed back, with packed rings that makes it visible right away.
+     */
+    Hdr.u16NumBufs = 1;
     if (vnetMergeableRxBuffers(pThis))
-        uHdrLen = sizeof(VNETHDRMRX);
-    else
-        uHdrLen = sizeof(VNETHDR);
+    {
+        Hdr.u16NumBufs = vqueueCountAvailIn(&pThis->VPCI, pRxQueue, uHdrLen + (uint32_t)cb);
+        if (!Hdr.u16NumBufs)
+        {
+            Log(("%s vnetHandleRxPacket: Not enough RX buffers for %u bytes\n", INSTANCE(pThis), cb));
+            STAM_REL_COUNTER_INC(&pThis->StatReceiveNoBufs);
+            return VERR_NET_NO_BUFFER_SPACE;
+        }
+    }
 
     vnetPacketDump(pThis, (const uint8_t *)pvBuf, cb, "<-- Incoming");
 
@@ -891,68 +1269,62 @@ static int vnetHandleRxPacket(PVNETSTATE pThis, const void *pvBuf, size_t cb,
         VQUEUEELEM elem;
         unsigned int nSeg = 0, uElemSize = 0, cbReserved = 0;
 
-        if (!vqueueGet(&pThis->VPCI, pThis->pRxQueue, &elem))
+        if (!vqueueGet(&pThis->VPCI, pRxQueue, &elem))
         {
-            /*
-             * @todo: It is possible to run out of RX buffers if only a few
-             * were added and we received a big packet.
-             */
+            /* vqueueCountAvailIn says this cannot happen, unless the guest plays games. */
             Log(("%s vnetHandleRxPacket: Suddenly there is no space in receive queue!\n", INSTANCE(pThis)));
+            vqueueSync(&pThis->VPCI, pRxQueue);
             return VERR_INTERNAL_ERROR;
         }
 
         if (elem.nIn < 1)
         {
             Log(("%s vnetHandleRxPacket: No writable descriptors in receive queue!\n", INSTANCE(pThis)));
+            vqueueSync(&pThis->VPCI, pRxQueue);
             return VERR_INTERNAL_ERROR;
         }
 
         if (nElem == 0)
         {
-            if (vnetMergeableRxBuffers(pThis))
+            /*
+             * The very first segment of the very first element gets the header,
+             * the frame may follow in the same segment.
+             */
+            if (elem.aSegsIn[0].cb < uHdrLen)
             {
-                addrHdrMrx = elem.aSegsIn[nSeg].addr;
-                cbReserved = uHdrLen;
+                Log(("%s vnetHandleRxPacket: The first descriptor cannot hold the header (%u < %u)!\n",
+                     INSTANCE(pThis), elem.aSegsIn[0].cb, uHdrLen));
+                vqueueSync(&pThis->VPCI, pRxQueue);
+                return VERR_INTERNAL_ERROR;
             }
-            else
+            int rc = PDMDevHlpPCIPhysWrite(pThis->VPCI.CTX_SUFF(pDevIns), elem.aSegsIn[0].addr, &Hdr, uHdrLen);
+            if (RT_FAILURE(rc))
             {
-                /* The very first segment of the very first element gets the header. */
-                if (elem.aSegsIn[nSeg].cb != sizeof(VNETHDR))
-                {
-                    Log(("%s vnetHandleRxPacket: The first descriptor does match the header size!\n", INSTANCE(pThis)));
-                    return VERR_INTERNAL_ERROR;
-                }
-                elem.aSegsIn[nSeg++].pv = &Hdr;
+                Log(("%s vnetHandleRxPacket: Failed to write the RX header: %Rrc\n", INSTANCE(pThis), rc));
+                vqueueSync(&pThis->VPCI, pRxQueue);
+                return rc;
             }
+            cbReserved = uHdrLen;
             uElemSize += uHdrLen;
+            if (elem.aSegsIn[0].cb == uHdrLen)
+                nSeg++;
         }
         while (nSeg < elem.nIn && uOffset < cb)
         {
-            unsigned int uSize = (unsigned int)RT_MIN(elem.aSegsIn[nSeg].cb - (nSeg?0:cbReserved),
+            unsigned int uSize = (unsigned int)RT_MIN(elem.aSegsIn[nSeg].cb - (nSeg ? 0 : cbReserved),
                                                       cb - uOffset);
             elem.aSegsIn[nSeg++].pv = (uint8_t*)pvBuf + uOffset;
             uOffset += uSize;
             uElemSize += uSize;
         }
         STAM_PROFILE_START(&pThis->StatReceiveStore, a);
-        vqueuePut(&pThis->VPCI, pThis->pRxQueue, &elem, uElemSize, cbReserved);
+        vqueuePut(&pThis->VPCI, pRxQueue, &elem, uElemSize, cbReserved);
         STAM_PROFILE_STOP(&pThis->StatReceiveStore, a);
         if (!vnetMergeableRxBuffers(pThis))
             break;
-        cbReserved = 0;
     }
-    if (vnetMergeableRxBuffers(pThis))
-    {
-        Hdr.u16NumBufs = nElem;
-        int rc = PDMDevHlpPCIPhysWrite(pThis->VPCI.CTX_SUFF(pDevIns), addrHdrMrx,
-                                       &Hdr, sizeof(Hdr));
-        if (RT_FAILURE(rc))
-        {
-            Log(("%s vnetHandleRxPacket: Failed to write merged RX buf header: %Rrc\n", INSTANCE(pThis), rc));
-            return rc;
-        }
-    }
-    vqueueSync(&pThis->VPCI, pThis->pRxQueue);
+    Assert(uOffset < cb || !vnetMergeableRxBuffers(pThis) || nElem == Hdr.u16NumBufs);
+    vqueueSync(&pThis->VPCI, pRxQueue);
     if (uOffset < cb)
     {
         Log(("%s vnetHandleRxPacket: Packet did not fit into RX queue (packet size=%u)!\n", INSTANCE(pThis), cb));
@@ -969,11 +1341,13 @@ static DECLCALLBACK(int) vnetNetworkDown_ReceiveGso(PPDMINETWORKDOWN pInterface,
                                                     const void *pvBuf, size_t cb,
                                                     PCPDMNETWORKGSO pGso)
 {
-    PVNETSTATE pThis = RT_FROM_MEMBER(pInterface, VNETSTATE, INetworkDown);
+    PVNETQUEUEPAIR pPair = RT_FROM_MEMBER(pInterface, VNETQUEUEPAIR, INetworkDown);
+    PVNETSTATE     pThis = pPair->pThisR3;
 
     if (pGso)
     {
-        uint32_t uFeatures = pThis->VPCI.uGuestFeatures;
+        /* Segmentation offloads are useless to the guest without checksum offloading. */
+        uint32_t uFeatures = pThis->fGuestOffloads & VNET_F_GUEST_CSUM ? pThis->fGuestOffloads : 0;
 
         switch (pGso->u8Type)
         {
@@ -984,9 +1358,10 @@ static DECLCALLBACK(int) vnetNetworkDown_ReceiveGso(PPDMINETWORKDOWN pInterface,
                 uFeatures &= VNET_F_GUEST_TSO6;
                 break;
             case PDMNETWORKGSOTYPE_IPV4_UDP:
-            case PDMNETWORKGSOTYPE_IPV6_UDP:
                 uFeatures &= VNET_F_GUEST_UFO;
                 break;
+            /* PDM segments IPv6 UDP into datagrams while virtio UFO means IP
+               fragmentation, so those are left to the connector. */
             default:
                 uFeatures = 0;
                 break;
@@ -998,10 +1373,7 @@ static DECLCALLBACK(int) vnetNetworkDown_ReceiveGso(PPDMINETWORKDOWN pInterface,
         }
     }
 
-    Log2(("%s vnetNetworkDown_ReceiveGso: pvBuf=%p cb=%u pGso=%p\n", INSTANCE(pThis), pvBuf, cb, pGso));
-    int rc = vnetCanReceive(pThis);
-    if (RT_FAILURE(rc))
-        return rc;
+    Log2(("%s vnetNetworkDown_ReceiveGso: pvBuf=%p cb=%u pGso=%p LUN#%u\n", INSTANCE(pThis), pvBuf, cb, pGso, pPair->iPair));
 
     /* Drop packets if VM is not running or cable is disconnected. */
     VMSTATE enmVMState = PDMDevHlpVMState(pThis->VPCI.CTX_SUFF(pDevIns));
@@ -1010,17 +1382,28 @@ static DECLCALLBACK(int) vnetNetworkDown_ReceiveGso(PPDMINETWORKDOWN pInterface,
         || !(STATUS & VNET_S_LINK_UP))
         return VINF_SUCCESS;
 
+    int rc = VINF_SUCCESS;
     STAM_PROFILE_START(&pThis->StatReceive, a);
     vpciSetReadLed(&pThis->VPCI, true);
     if (vnetAddressFilter(pThis, pvBuf, cb))
     {
-        rc = vnetCsRxEnter(pThis, VERR_SEM_BUSY);
-        if (RT_SUCCESS(rc))
+        PVNETQUEUEPAIR pRxPair = vnetRxPairEnter(pThis, vnetRssSteer(pThis, (const uint8_t *)pvBuf, cb));
+        if (pRxPair)
         {
-            rc = vnetHandleRxPacket(pThis, pvBuf, cb, pGso);
-            STAM_REL_COUNTER_ADD(&pThis->StatReceiveBytes, cb);
-            vnetCsRxLeave(pThis);
+            /*
+             * A GSO frame not fitting the mergeable buffers is refused, the
+             * connector then segments it and hands us the pieces instead.
+             */
+            rc = vnetHandleRxPacket(pThis, pRxPair->pRxQueue, pvBuf, cb, pGso);
+            if (RT_SUCCESS(rc))
+            {
+                STAM_REL_COUNTER_ADD(&pThis->StatReceiveBytes, cb);
+                STAM_REL_COUNTER_INC(&pRxPair->StatReceivePackets);
+            }
+            vnetCsRxLeave(pRxPair);
         }
+        else
+            rc = VERR_NET_NO_BUFFER_SPACE;
     }
     vpciSetReadLed(&pThis->VPCI, false);
     STAM_PROFILE_STOP(&pThis->StatReceive, a);
@@ -1089,8 +1472,7 @@ static DECLCALLBACK(int) vnetSetLinkState(PPDMINETWORKCONFIG pInterface, PDMNETW
              * notification will be sent when the link actually goes up in vnetLinkUpTimer().
              */
             vnetTempLinkDown(pThis);
-            if (pThis->pDrv)
-                pThis->pDrv->pfnNotifyLinkChanged(pThis->pDrv, enmState);
+            vnetNotifyLinkChanged(pThis, enmState);
         }
     }
     else if (fNewUp != fOldUp)
@@ -1111,8 +1493,7 @@ static DECLCALLBACK(int) vnetSetLinkState(PPDMINETWORKCONFIG pInterface, PDMNETW
             STATUS &= ~VNET_S_LINK_UP;
             vnetRaiseInterrupt(pThis, VERR_SEM_BUSY, VPCI_ISR_CONFIG);
         }
-        if (pThis->pDrv)
-            pThis->pDrv->pfnNotifyLinkChanged(pThis->pDrv, enmState);
+        vnetNotifyLinkChanged(pThis, enmState);
     }
     return VINF_SUCCESS;
 }
@@ -1237,7 +1618,8 @@ static bool vnetReadHeader(PVNETSTATE pThis, RTGCPHYS GCPhys, PVNETHDR pHdr, uin
     return true;
 }
 
-static int vnetTransmitFrame(PVNETSTATE pThis, PPDMSCATTERGATHER pSgBuf, PPDMNETWORKGSO pGso, PVNETHDR pHdr)
+static int vnetTransmitFrame(PVNETSTATE pThis, PPDMINETWORKUP pDrv, PPDMSCATTERGATHER pSgBuf, PPDMNETWORKGSO pGso,
+                             PVNETHDR pHdr)
 {
     vnetPacketDump(pThis, (uint8_t *)pSgBuf->aSegs[0].pvSeg, pSgBuf->cbUsed, "--> Outgoing");
     if (pGso)
@@ -1284,51 +1666,51 @@ static int vnetTransmitFrame(PVNETSTATE pThis, PPDMSCATTERGATHER pSgBuf, PPDMNET
                              pHdr->u16CSumStart, pHdr->u16CSumOffset);
     }
 
-    return pThis->pDrv->pfnSendBuf(pThis->pDrv, pSgBuf, false);
+    return pDrv->pfnSendBuf(pDrv, pSgBuf, false);
 }
 
-static void vnetTransmitPendingPackets(PVNETSTATE pThis, PVQUEUE pQueue, bool fOnWorkerThread)
+static void vnetTransmitPendingPackets(PVNETSTATE pThis, PVNETQUEUEPAIR pPair, bool fOnWorkerThread)
 {
+    PVQUEUE pQueue = pPair->pTxQueue;
+
     /*
-     * Only one thread is allowed to transmit at a time, others should skip
-     * transmission as the packets will be picked up by the transmitting
-     * thread.
+     * Only one thread is allowed to transmit from a queue at a time, others
+     * should skip transmission as the packets will be picked up by the
+     * transmitting thread.
      */
-    if (!ASMAtomicCmpXchgU32(&pThis->uIsTransmitting, 1, 0))
+    if (!ASMAtomicCmpXchgU32(&pPair->uIsTransmitting, 1, 0))
         return;
 
     if ((pThis->VPCI.uStatus & VPCI_STATUS_DRV_OK) == 0)
     {
         Log(("%s Ignoring transmit requests from non-existent driver (status=0x%x).\n", INSTANCE(pThis), pThis->VPCI.uStatus));
+        ASMAtomicWriteU32(&pPair->uIsTransmitting, 0);
         return;
     }
 
     if (!pThis->fCableConnected)
     {
         Log(("%s Ignoring transmit requests while cable is disconnected.\n", INSTANCE(pThis)));
+        ASMAtomicWriteU32(&pPair->uIsTransmitting, 0);
         return;
     }
 
-    PPDMINETWORKUP pDrv = pThis->pDrv;
+    PPDMINETWORKUP pDrv = vnetPairDrv(pThis, pPair);
     if (pDrv)
     {
         int rc = pDrv->pfnBeginXmit(pDrv, fOnWorkerThread);
         Assert(rc == VINF_SUCCESS || rc == VERR_TRY_AGAIN);
         if (rc == VERR_TRY_AGAIN)
         {
-            ASMAtomicWriteU32(&pThis->uIsTransmitting, 0);
+            ASMAtomicWriteU32(&pPair->uIsTransmitting, 0);
             return;
         }
     }
 
-    unsigned int uHdrLen;
-    if (vnetMergeableRxBuffers(pThis))
-        uHdrLen = sizeof(VNETHDRMRX);
-    else
-        uHdrLen = sizeof(VNETHDR);
+    uint32_t const uHdrLen = vnetHdrSize(pThis);
 
-    Log3(("%s vnetTransmitPendingPackets: About to transmit %d pending packets\n",
-          INSTANCE(pThis), vringReadAvailIndex(&pThis->VPCI, &pThis->pTxQueue->VRing) - pThis->pTxQueue->uNextAvailIndex));
+    Log3(("%s vnetTransmitPendingPackets: About to transmit pending packets of pair %u\n",
+          INSTANCE(pThis), pPair->iPair));
 
     vpciSetWriteLed(&pThis->VPCI, true);
 
@@ -1340,16 +1722,20 @@ static void vnetTransmitPendingPackets(PVNETSTATE pThis, PVQUEUE pQueue, bool fO
     while (vqueuePeek(&pThis->VPCI, pQueue, &elem))
     {
         unsigned int uOffset = 0;
-        if (elem.nOut < 2 || elem.aSegsOut[0].cb != uHdrLen)
+        /*
+         * The header usually has a descriptor of its own, but the frame may
+         * follow it in the same one (VIRTIO_F_ANY_LAYOUT, implied by 1.0).
+         */
+        if (elem.nOut < 1 || elem.aSegsOut[0].cb < uHdrLen)
         {
-            Log(("%s vnetQueueTransmit: The first segment is not the header! (%u < 2 || %u != %u).\n",
-                 INSTANCE(pThis), elem.nOut, elem.aSegsOut[0].cb, uHdrLen));
+            Log(("%s vnetQueueTransmit: The first segment cannot hold the header! (%u < 1 || %u < %u).\n",
+                 INSTANCE(pThis), elem.nOut, elem.nOut ? elem.aSegsOut[0].cb : 0, uHdrLen));
             break; /* For now we simply ignore the header, but it must be there anyway! */
         }
         RT_UNTRUSTED_VALIDATED_FENCE();
 
         VNETHDR Hdr;
-        unsigned int uSize = 0;
+        unsigned int uSize = elem.aSegsOut[0].cb - uHdrLen;
         STAM_PROFILE_ADV_START(&pThis->StatTransmit, a);
 
         /* Compute total frame size. */
@@ -1361,10 +1747,11 @@ static void vnetTransmitPendingPackets(PVNETSTATE pThis, PVQUEUE pQueue, bool fO
         /* Truncate oversized frames. */
         if (uSize > VNET_MAX_FRAME_SIZE)
             uSize = VNET_MAX_FRAME_SIZE;
-        if (pThis->pDrv && vnetReadHeader(pThis, elem.aSegsOut[0].addr, &Hdr, uSize))
+        if (pDrv && uSize && vnetReadHeader(pThis, elem.aSegsOut[0].addr, &Hdr, uSize))
         {
             RT_UNTRUSTED_VALIDATED_FENCE();
             STAM_REL_COUNTER_INC(&pThis->StatTransmitPackets);
+            STAM_REL_COUNTER_INC(&pPair->StatTransmitPackets);
             STAM_PROFILE_START(&pThis->StatTransmitSend, a);
 
             PDMNETWORKGSO Gso;
@@ -1372,23 +1759,26 @@ static void vnetTransmitPendingPackets(PVNETSTATE pThis, PVQUEUE pQueue, bool fO
 
             /** @todo Optimize away the extra copying! (lazy bird) */
             PPDMSCATTERGATHER pSgBuf;
-            int rc = pThis->pDrv->pfnAllocBuf(pThis->pDrv, uSize, pGso, &pSgBuf);
+            int rc = pDrv->pfnAllocBuf(pDrv, uSize, pGso, &pSgBuf);
             if (RT_SUCCESS(rc))
             {
                 Assert(pSgBuf->cSegs == 1);
                 pSgBuf->cbUsed = uSize;
 
-                /* Assemble a complete frame. */
-                for (unsigned int i = 1; i < elem.nOut && uSize > 0; i++)
+                /* Assemble a complete frame, skipping the header. */
+                for (unsigned int i = 0; i < elem.nOut && uSize > 0; i++)
                 {
-                    unsigned int cbSegment = RT_MIN(uSize, elem.aSegsOut[i].cb);
-                    PDMDevHlpPhysRead(pThis->VPCI.CTX_SUFF(pDevIns), elem.aSegsOut[i].addr,
+                    uint32_t const offSeg    = i ? 0 : uHdrLen;
+                    unsigned int   cbSegment = RT_MIN(uSize, elem.aSegsOut[i].cb - offSeg);
+                    if (!cbSegment)
+                        continue;
+                    PDMDevHlpPhysRead(pThis->VPCI.CTX_SUFF(pDevIns), elem.aSegsOut[i].addr + offSeg,
                                       ((uint8_t*)pSgBuf->aSegs[0].pvSeg) + uOffset,
                                       cbSegment);
                     uOffset += cbSegment;
                     uSize -= cbSegment;
                 }
-                rc = vnetTransmitFrame(pThis, pSgBuf, pGso, &Hdr);
+                rc = vnetTransmitFrame(pThis, pDrv, pSgBuf, pGso, &Hdr);
             }
             else
             {
@@ -1413,7 +1803,17 @@ static void vnetTransmitPendingPackets(PVNETSTATE pThis, PVQUEUE pQueue, bool fO
 
     if (pDrv)
         pDrv->pfnEndXmit(pDrv);
-    ASMAtomicWriteU32(&pThis->uIsTransmitting, 0);
+    ASMAtomicWriteU32(&pPair->uIsTransmitting, 0);
+}
+
+/**
+ * Returns the queue pair of a TX queue.
+ */
+DECLINLINE(PVNETQUEUEPAIR) vnetTxQueueToPair(PVNETSTATE pThis, PVQUEUE pQueue)
+{
+    unsigned const iPair = (unsigned)(pQueue - &pThis->VPCI.Queues[0]) / 2;
+    Assert(iPair < pThis->cPairs && pThis->aPairs[iPair].pTxQueue == pQueue);
+    return &pThis->aPairs[iPair];
 }
 
 /**
@@ -1421,15 +1821,38 @@ static void vnetTransmitPendingPackets(PVNETSTATE pThis, PVQUEUE pQueue, bool fO
  */
 static DECLCALLBACK(void) vnetNetworkDown_XmitPending(PPDMINETWORKDOWN pInterface)
 {
-    PVNETSTATE pThis = RT_FROM_MEMBER(pInterface, VNETSTATE, INetworkDown);
+    PVNETQUEUEPAIR pPair = RT_FROM_MEMBER(pInterface, VNETQUEUEPAIR, INetworkDown);
+    PVNETSTATE     pThis = pPair->pThisR3;
 #if defined(VBOX_WITH_STATISTICS)
     STAM_REL_COUNTER_INC(&pThis->StatTransmitByNetwork);
 #endif /* VBOX_WITH_STATISTICS */
-    vnetTransmitPendingPackets(pThis, pThis->pTxQueue, false /*fOnWorkerThread*/);
+    /* The connector on LUN #0 also serves the queue pairs without their own. */
+    for (unsigned i = 0; i < pThis->cActivePairs; i++)
+        if (   &pThis->aPairs[i] == pPair
+            || (pPair->iPair == 0 && !pThis->aPairs[i].pDrv))
+            vnetTransmitPendingPackets(pThis, &pThis->aPairs[i], false /*fOnWorkerThread*/);
 }
 
 #ifdef VNET_TX_DELAY
 
+/**
+ * Transmits from all active queue pairs and re-enables their TX kicks, the
+ * delay timer is shared by the pairs.
+ */
+static void vnetTransmitAllPairs(PVNETSTATE pThis)
+{
+    for (unsigned i = 0; i < pThis->cActivePairs; i++)
+        vnetTransmitPendingPackets(pThis, &pThis->aPairs[i], false /*fOnWorkerThread*/);
+    if (RT_FAILURE(vnetCsEnter(pThis, VERR_SEM_BUSY)))
+        LogRel(("vnetTransmitAllPairs: Failed to enter critical section!/n"));
+    else
+    {
+        for (unsigned i = 0; i < pThis->cActivePairs; i++)
+            vringSetNotification(&pThis->VPCI, &pThis->aPairs[i].pTxQueue->VRing, true);
+        vnetCsLeave(pThis);
+    }
+}
+
 static DECLCALLBACK(void) vnetQueueTransmit(void *pvState, PVQUEUE pQueue)
 {
     PVNETSTATE pThis = (PVNETSTATE)pvState;
@@ -1438,14 +1861,7 @@ static DECLCALLBACK(void) vnetQueueTransmit(void *pvState, PVQUEUE pQueue)
     {
         TMTimerStop(pThis->CTX_SUFF(pTxTimer));
         Log3(("%s vnetQueueTransmit: Got kicked with notification disabled, re-enable notification and flush TX queue\n", INSTANCE(pThis)));
-        vnetTransmitPendingPackets(pThis, pQueue, false /*fOnWorkerThread*/);
-        if (RT_FAILURE(vnetCsEnter(pThis, VERR_SEM_BUSY)))
-            LogRel(("vnetQueueTransmit: Failed to enter critical section!/n"));
-        else
-        {
-            vringSetNotification(&pThis->VPCI, &pThis->pTxQueue->VRing, true);
-            vnetCsLeave(pThis);
-        }
+        vnetTransmitAllPairs(pThis);
     }
     else
     {
@@ -1453,7 +1869,7 @@ static DECLCALLBACK(void) vnetQueueTransmit(void *pvState, PVQUEUE pQueue)
             LogRel(("vnetQueueTransmit: Failed to enter critical section!/n"));
         else
         {
-            vringSetNotification(&pThis->VPCI, &pThis->pTxQueue->VRing, false);
+            vringSetNotification(&pThis->VPCI, &pQueue->VRing, false);
             TMTimerSetMicro(pThis->CTX_SUFF(pTxTimer), VNET_TX_DELAY);
             pThis->u64NanoTS = RTTimeNanoTS();
             vnetCsLeave(pThis);
@@ -1480,14 +1896,7 @@ static DECLCALLBACK(void) vnetTxTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void
           u32MicroDiff, pThis->u32AvgDiff, pThis->u32MinDiff, pThis->u32MaxDiff));
 
 //    Log3(("%s vnetTxTimer: Expired\n", INSTANCE(pThis)));
-    vnetTransmitPendingPackets(pThis, pThis->pTxQueue, false /*fOnWorkerThread*/);
-    if (RT_FAILURE(vnetCsEnter(pThis, VERR_SEM_BUSY)))
-    {
-        LogRel(("vnetTxTimer: Failed to enter critical section!/n"));
-        return;
-    }
-    vringSetNotification(&pThis->VPCI, &pThis->pTxQueue->VRing, true);
-    vnetCsLeave(pThis);
+    vnetTransmitAllPairs(pThis);
 }
 
 inline int vnetCreateTxThreadAndEvent(PPDMDEVINS pDevIns, PVNETSTATE pThis)
@@ -1504,8 +1913,8 @@ inline void vnetDestroyTxThreadAndEvent(PVNETSTATE pThis)
 
 static DECLCALLBACK(int) vnetTxThread(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
 {
-    RT_NOREF(pDevIns);
-    PVNETSTATE pThis = (PVNETSTATE)pThread->pvUser;
+    PVNETSTATE     pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
+    PVNETQUEUEPAIR pPair = (PVNETQUEUEPAIR)pThread->pvUser;
     int rc = VINF_SUCCESS;
 
     if (pThread->enmState == PDMTHREADSTATE_INITIALIZING)
@@ -1513,7 +1922,7 @@ static DECLCALLBACK(int) vnetTxThread(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
 
     while (pThread->enmState == PDMTHREADSTATE_RUNNING)
     {
-        rc = SUPSemEventWaitNoResume(pThis->pSupDrvSession, pThis->hTxEvent, RT_INDEFINITE_WAIT);
+        rc = SUPSemEventWaitNoResume(pThis->pSupDrvSession, pPair->hTxEvent, RT_INDEFINITE_WAIT);
         if (RT_UNLIKELY(pThread->enmState != PDMTHREADSTATE_RUNNING))
             break;
 #if defined(VBOX_WITH_STATISTICS)
@@ -1521,12 +1930,12 @@ static DECLCALLBACK(int) vnetTxThread(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
 #endif /* VBOX_WITH_STATISTICS */
         while (true)
         {
-            vnetTransmitPendingPackets(pThis, pThis->pTxQueue, false /*fOnWorkerThread*/); /// @todo shouldn't it be true instead?
+            vnetTransmitPendingPackets(pThis, pPair, false /*fOnWorkerThread*/); /// @todo shouldn't it be true instead?
             Log(("vnetTxThread: enable kicking and get to sleep\n"));
-            vringSetNotification(&pThis->VPCI, &pThis->pTxQueue->VRing, true);
-            if (vqueueIsEmpty(&pThis->VPCI, pThis->pTxQueue))
+            vringSetNotification(&pThis->VPCI, &pPair->pTxQueue->VRing, true);
+            if (vqueueIsEmpty(&pThis->VPCI, pPair->pTxQueue))
                 break;
-            vringSetNotification(&pThis->VPCI, &pThis->pTxQueue->VRing, false);
+            vringSetNotification(&pThis->VPCI, &pPair->pTxQueue->VRing, false);
         }
     }
 
@@ -1542,50 +1951,68 @@ static DECLCALLBACK(int) vnetTxThread(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
  */
 static DECLCALLBACK(int) vnetTxThreadWakeUp(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
 {
-    RT_NOREF(pDevIns);
-    PVNETSTATE pThis = (PVNETSTATE)pThread->pvUser;
-    return SUPSemEventSignal(pThis->pSupDrvSession, pThis->hTxEvent);
+    PVNETSTATE     pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
+    PVNETQUEUEPAIR pPair = (PVNETQUEUEPAIR)pThread->pvUser;
+    return SUPSemEventSignal(pThis->pSupDrvSession, pPair->hTxEvent);
 }
 
+/**
+ * Creates the TX threads, one for each queue pair.
+ */
 static int vnetCreateTxThreadAndEvent(PPDMDEVINS pDevIns, PVNETSTATE pThis)
 {
-    int rc = SUPSemEventCreate(pThis->pSupDrvSession, &pThis->hTxEvent);
-    if (RT_FAILURE(rc))
-        return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS,
-                                   N_("VNET: Failed to create SUP event semaphore"));
-    rc = PDMDevHlpThreadCreate(pDevIns, &pThis->pTxThread, pThis, vnetTxThread,
-                               vnetTxThreadWakeUp, 0, RTTHREADTYPE_IO, INSTANCE(pThis));
-    if (RT_FAILURE(rc))
-        return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS,
-                                   N_("VNET: Failed to create worker thread %s"), INSTANCE(pThis));
+    for (unsigned i = 0; i < pThis->cPairs; i++)
+    {
+        PVNETQUEUEPAIR pPair = &pThis->aPairs[i];
+        int rc = SUPSemEventCreate(pThis->pSupDrvSession, &pPair->hTxEvent);
+        if (RT_FAILURE(rc))
+            return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS,
+                                       N_("VNET: Failed to create SUP event semaphore"));
+        /* The thread name is copied by the runtime. */
+        char szName[16];
+        if (pThis->cPairs > 1)
+            RTStrPrintf(szName, sizeof(szName), "%s-TX%u", INSTANCE(pThis), i);
+        else
+            RTStrCopy(szName, sizeof(szName), INSTANCE(pThis));
+        rc = PDMDevHlpThreadCreate(pDevIns, &pPair->pTxThread, pPair, vnetTxThread,
+                                   vnetTxThreadWakeUp, 0, RTTHREADTYPE_IO, szName);
+        if (RT_FAILURE(rc))
+            return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS,
+                                       N_("VNET: Failed to create worker thread %s"), szName);
+    }
     return VINF_SUCCESS;
 }
 
 static void vnetDestroyTxThreadAndEvent(PVNETSTATE pThis)
 {
-    if (pThis->pTxThread)
+    for (unsigned i = 0; i < pThis->cPairs; i++)
     {
-        int rcThread;
-        /* Destroy the thread. */
-        int rc = PDMR3ThreadDestroy(pThis->pTxThread, &rcThread);
-        if (RT_FAILURE(rc) || RT_FAILURE(rcThread))
-            AssertMsgFailed(("%s Failed to destroy async IO thread rc=%Rrc rcThread=%Rrc\n", __FUNCTION__, rc, rcThread));
-        pThis->pTxThread = NULL;
-    }
-    if (pThis->hTxEvent != NIL_SUPSEMEVENT)
-    {
-        SUPSemEventClose(pThis->pSupDrvSession, pThis->hTxEvent);
-        pThis->hTxEvent = NIL_SUPSEMEVENT;
+        PVNETQUEUEPAIR pPair = &pThis->aPairs[i];
+        if (pPair->pTxThread)
+        {
+            int rcThread;
+            /* Destroy the thread. */
+            int rc = PDMR3ThreadDestroy(pPair->pTxThread, &rcThread);
+            if (RT_FAILURE(rc) || RT_FAILURE(rcThread))
+                AssertMsgFailed(("%s Failed to destroy async IO thread rc=%Rrc rcThread=%Rrc\n", __FUNCTION__, rc, rcThread));
+            pPair->pTxThread = NULL;
+        }
+        if (pPair->hTxEvent != NIL_SUPSEMEVENT)
+        {
+            SUPSemEventClose(pThis->pSupDrvSession, pPair->hTxEvent);
+            pPair->hTxEvent = NIL_SUPSEMEVENT;
+        }
     }
 }
 
 static DECLCALLBACK(void) vnetQueueTransmit(void *pvState, PVQUEUE pQueue)
 {
-    PVNETSTATE pThis = (PVNETSTATE)pvState;
+    PVNETSTATE     pThis = (PVNETSTATE)pvState;
+    PVNETQUEUEPAIR pPair = vnetTxQueueToPair(pThis, pQueue);
 
-    Log(("vnetQueueTransmit: disable kicking and wake up TX thread\n"));
+    Log(("vnetQueueTransmit: disable kicking and wake up TX thread %u\n", pPair->iPair));
     vringSetNotification(&pThis->VPCI, &pQueue->VRing, false);
-    SUPSemEventSignal(pThis->pSupDrvSession, pThis->hTxEvent);
+    SUPSemEventSignal(pThis->pSupDrvSession, pPair->hTxEvent);
 }
 
 #endif /* !VNET_TX_DELAY */
@@ -1609,9 +2036,8 @@ static uint8_t vnetControlRx(PVNETSTATE pThis, PVNETCTLHDR pCtlHdr, PVQUEUEELEM
         default:
             u8Ack = VNET_ERROR;
     }
-    if (fDrvWasPromisc != (pThis->fPromiscuous | pThis->fAllMulti) && pThis->pDrv)
-        pThis->pDrv->pfnSetPromiscuousMode(pThis->pDrv,
-            (pThis->fPromiscuous | pThis->fAllMulti));
+    if (fDrvWasPromisc != (pThis->fPromiscuous | pThis->fAllMulti))
+        vnetSetPromiscuousMode(pThis, pThis->fPromiscuous | pThis->fAllMulti);
 
     return u8Ack;
 }
@@ -1736,6 +2162,159 @@ static uint8_t vnetControlVlan(PVNETSTATE pThis, PVNETCTLHDR pCtlHdr, PVQUEUEELE
     return u8Ack;
 }
 
+/**
+ * Reads command data following the control header, the guest may scatter it
+ * over several 'out' segments.
+ *
+ * @returns true if the segments hold enough data, false if not.
+ * @param   pThis       The device state structure.
+ * @param   pElem       The control queue element.
+ * @param   off         Offset into the command data (excluding the header).
+ * @param   pv          Where to store the data.
+ * @param   cb          How much to read.
+ */
+static bool vnetControlRead(PVNETSTATE pThis, PVQUEUEELEM pElem, uint32_t off, void *pv, uint32_t cb)
+{
+    uint8_t *pb = (uint8_t *)pv;
+    for (unsigned i = 1; i < pElem->nOut && cb; i++)
+    {
+        if (off >= pElem->aSegsOut[i].cb)
+        {
+            off -= pElem->aSegsOut[i].cb;
+            continue;
+        }
+        uint32_t cbChunk = RT_MIN(cb, pElem->aSegsOut[i].cb - off);
+        PDMDevHlpPhysRead(pThis->VPCI.CTX_SUFF(pDevIns), pElem->aSegsOut[i].addr + off, pb, cbChunk);
+        pb  += cbChunk;
+        cb  -= cbChunk;
+        off  = 0;
+    }
+    return cb == 0;
+}
+
+static uint8_t vnetControlMq(PVNETSTATE pThis, PVNETCTLHDR pCtlHdr, PVQUEUEELEM pElem)
+{
+    switch (pCtlHdr->u8Command)
+    {
+        case VNET_CTRL_CMD_MQ_VQ_PAIRS_SET:
+        {
+            uint16_t cPairs;
+            if (   !(pThis->VPCI.uGuestFeatures & VNET_F_MQ)
+                || !vnetControlRead(pThis, pElem, 0, &cPairs, sizeof(cPairs))
+                || cPairs < 1
+                || cPairs > pThis->cPairs)
+            {
+                Log(("%s vnetControlMq: Invalid queue pair count\n", INSTANCE(pThis)));
+                return VNET_ERROR;
+            }
+            Log(("%s vnetControlMq: Using %u queue pairs\n", INSTANCE(pThis), cPairs));
+            vnetCsRxEnterAll(pThis);
+            pThis->cActivePairs = cPairs;
+            vnetRssSetDefault(pThis);
+            vnetCsRxLeaveAll(pThis);
+            return VNET_OK;
+        }
+
+        case VNET_CTRL_CMD_MQ_RSS_CONFIG:
+        {
+            if (!(pThis->VPCI.uGuestFeaturesHi & VNET_F_HI_RSS))
+                return VNET_ERROR;
+
+            /*
+             * struct virtio_net_rss_config: le32 hash_types, le16 indirection_table_mask,
+             * le16 unclassified_queue, le16 indirection_table[mask + 1], le16 max_tx_vq,
+             * u8 hash_key_length, u8 hash_key_data[hash_key_length].
+             */
+            VNETRSS  Rss;
+            uint32_t off = 0;
+            RT_ZERO(Rss);
+            if (!vnetControlRead(pThis, pElem, off, &Rss.fHashTypes, sizeof(Rss.fHashTypes)))
+                return VNET_ERROR;
+            off += sizeof(Rss.fHashTypes);
+            if (!vnetControlRead(pThis, pElem, off, &Rss.uIndirectionTableMask, sizeof(Rss.uIndirectionTableMask)))
+                return VNET_ERROR;
+            off += sizeof(Rss.uIndirectionTableMask);
+            uint32_t const cEntries = (uint32_t)Rss.uIndirectionTableMask + 1;
+            if (   cEntries > VNET_RSS_MAX_INDIRECTION_TABLE
+                || (cEntries & Rss.uIndirectionTableMask))
+            {
+                Log(("%s vnetControlMq: Bad indirection table mask %#x\n", INSTANCE(pThis), Rss.uIndirectionTableMask));
+                return VNET_ERROR;
+            }
+            if (!vnetControlRead(pThis, pElem, off, &Rss.uUnclassifiedQueue, sizeof(Rss.uUnclassifiedQueue)))
+                return VNET_ERROR;
+            off += sizeof(Rss.uUnclassifiedQueue);
+            if (!vnetControlRead(pThis, pElem, off, Rss.au16IndirectionTable, cEntries * sizeof(uint16_t)))
+                return VNET_ERROR;
+            off += cEntries * sizeof(uint16_t);
+
+            uint16_t cTxPairs;
+            uint8_t  cbKey;
+            if (   !vnetControlRead(pThis, pElem, off, &cTxPairs, sizeof(cTxPairs))
+                || !vnetControlRead(pThis, pElem, off + sizeof(cTxPairs), &cbKey, sizeof(cbKey))
+                || cTxPairs < 1
+                || cTxPairs > pThis->cPairs
+                || cbKey > VNET_RSS_MAX_KEY_SIZE
+                || !vnetControlRead(pThis, pElem, off + sizeof(cTxPairs) + sizeof(cbKey), Rss.abKey, cbKey))
+            {
+                Log(("%s vnetControlMq: Bad RSS configuration tail\n", INSTANCE(pThis)));
+                return VNET_ERROR;
+            }
+
+            /* The queue numbers are virtqueue indexes of RX queues, convert them to pair indexes. */
+            if (   (Rss.uUnclassifiedQueue & 1)
+                || Rss.uUnclassifiedQueue / 2 >= pThis->cPairs)
+                return VNET_ERROR;
+            Rss.uUnclassifiedQueue /= 2;
+            for (unsigned i = 0; i < cEntries; i++)
+            {
+                if (   (Rss.au16IndirectionTable[i] & 1)
+                    || Rss.au16IndirectionTable[i] / 2 >= pThis->cPairs)
+                    return VNET_ERROR;
+                Rss.au16IndirectionTable[i] /= 2;
+            }
+            Rss.fHashTypes &= VNET_RSS_HASH_TYPES_SUPPORTED;
+
+            Log(("%s vnetControlMq: RSS hash types %#x, %u table entries, %u queue pairs\n",
+                 INSTANCE(pThis), Rss.fHashTypes, cEntries, cTxPairs));
+            vnetCsRxEnterAll(pThis);
+            pThis->Rss          = Rss;
+            pThis->cActivePairs = cTxPairs;
+            vnetCsRxLeaveAll(pThis);
+            return VNET_OK;
+        }
+
+        default:
+            return VNET_ERROR;
+    }
+}
+
+static uint8_t vnetControlOffloads(PVNETSTATE pThis, PVNETCTLHDR pCtlHdr, PVQUEUEELEM pElem)
+{
+    uint64_t fOffloads;
+    if (   pCtlHdr->u8Command != VNET_CTRL_CMD_GUEST_OFFLOADS_SET
+        || !(pThis->VPCI.uGuestFeatures & VNET_F_CTRL_GUEST_OFFLOADS)
+        || !vnetControlRead(pThis, pElem, 0, &fOffloads, sizeof(fOffloads)))
+    {
+        Log(("%s vnetControlOffloads: Invalid command (u8Command=%u nOut=%u)\n",
+             INSTANCE(pThis), pCtlHdr->u8Command, pElem->nOut));
+        return VNET_ERROR;
+    }
+
+    /* Only offloads negotiated at feature negotiation time can be enabled. */
+    if (fOffloads & ~(uint64_t)(pThis->VPCI.uGuestFeatures & VNET_GUEST_OFFLOADS))
+    {
+        Log(("%s vnetControlOffloads: Offloads %#RX64 were not negotiated\n", INSTANCE(pThis), fOffloads));
+        return VNET_ERROR;
+    }
+
+    Log(("%s vnetControlOffloads: Receive offloads %#x -> %#x\n", INSTANCE(pThis), pThis->fGuestOffloads, (uint32_t)fOffloads));
+    vnetCsRxEnterAll(pThis);
+    pThis->fGuestOffloads = (uint32_t)fOffloads;
+    vnetCsRxLeaveAll(pThis);
+    return VNET_OK;
+}
+
 
 static DECLCALLBACK(void) vnetQueueControl(void *pvState, PVQUEUE pQueue)
 {
@@ -1774,6 +2353,12 @@ static DECLCALLBACK(void) vnetQueueControl(void *pvState, PVQUEUE pQueue)
                 case VNET_CTRL_CLS_VLAN:
                     u8Ack = vnetControlVlan(pThis, &CtlHdr, &elem);
                     break;
+                case VNET_CTRL_CLS_MQ:
+                    u8Ack = vnetControlMq(pThis, &CtlHdr, &elem);
+                    break;
+                case VNET_CTRL_CLS_GUEST_OFFLOADS:
+                    u8Ack = vnetControlOffloads(pThis, &CtlHdr, &elem);
+                    break;
                 default:
                     u8Ack = VNET_ERROR;
             }
@@ -1799,6 +2384,7 @@ static DECLCALLBACK(void) vnetQueueControl(void *pvState, PVQUEUE pQueue)
 static void vnetSaveConfig(PVNETSTATE pThis, PSSMHANDLE pSSM)
 {
     SSMR3PutMem(pSSM, &pThis->macConfigured, sizeof(pThis->macConfigured));
+    SSMR3PutU16(pSSM, pThis->cPairs);
 }
 
 
@@ -1822,10 +2408,8 @@ static DECLCALLBACK(int) vnetSavePrep(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
     RT_NOREF(pSSM);
     PVNETSTATE pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
 
-    int rc = vnetCsRxEnter(pThis, VERR_SEM_BUSY);
-    if (RT_UNLIKELY(rc != VINF_SUCCESS))
-        return rc;
-    vnetCsRxLeave(pThis);
+    vnetCsRxEnterAll(pThis);
+    vnetCsRxLeaveAll(pThis);
     return VINF_SUCCESS;
 }
 
@@ -1857,6 +2441,13 @@ static DECLCALLBACK(int) vnetSaveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
     AssertRCReturn(rc, rc);
     rc = SSMR3PutMem( pSSM, pThis->aVlanFilter, sizeof(pThis->aVlanFilter));
     AssertRCReturn(rc, rc);
+    /* Multiqueue, since VNET_SAVEDSTATE_VERSION_PRE_MQ + 1. */
+    rc = SSMR3PutU16( pSSM, pThis->cActivePairs);
+    AssertRCReturn(rc, rc);
+    rc = SSMR3PutMem( pSSM, &pThis->Rss, sizeof(pThis->Rss));
+    AssertRCReturn(rc, rc);
+    rc = SSMR3PutU32( pSSM, pThis->fGuestOffloads);
+    AssertRCReturn(rc, rc);
     Log(("%s State has been saved\n", INSTANCE(pThis)));
     return VINF_SUCCESS;
 }
@@ -1871,10 +2462,8 @@ static DECLCALLBACK(int) vnetLoadPrep(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
     RT_NOREF(pSSM);
     PVNETSTATE pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
 
-    int rc = vnetCsRxEnter(pThis, VERR_SEM_BUSY);
-    if (RT_UNLIKELY(rc != VINF_SUCCESS))
-        return rc;
-    vnetCsRxLeave(pThis);
+    vnetCsRxEnterAll(pThis);
+    vnetCsRxLeaveAll(pThis);
     return VINF_SUCCESS;
 }
 
@@ -1894,8 +2483,17 @@ static DECLCALLBACK(int) vnetLoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint3
     if (memcmp(&macConfigured, &pThis->macConfigured, sizeof(macConfigured))
         && (uPass == 0 || !PDMDevHlpVMTeleportedAndNotFullyResumedYet(pDevIns)))
         LogRel(("%s: The mac address differs: config=%RTmac saved=%RTmac\n", INSTANCE(pThis), &pThis->macConfigured, &macConfigured));
+    uint16_t cPairs = 1;
+    if (uVersion > VNET_SAVEDSTATE_VERSION_PRE_MQ)
+    {
+        rc = SSMR3GetU16(pSSM, &cPairs);
+        AssertRCReturn(rc, rc);
+    }
+    if (cPairs != pThis->cPairs)
+        return SSMR3SetCfgError(pSSM, RT_SRC_POS, N_("Config mismatch - saved NumQueues=%u configured NumQueues=%u"),
+                                cPairs, pThis->cPairs);
 
-    rc = vpciLoadExec(&pThis->VPCI, pSSM, uVersion, uPass, VNET_N_QUEUES);
+    rc = vpciLoadExec(&pThis->VPCI, pSSM, RT_MIN(uVersion, VIRTIO_SAVEDSTATE_VERSION), uPass, VNET_N_QUEUES);
     AssertRCReturn(rc, rc);
 
     if (uPass == SSM_PASS_FINAL)
@@ -1932,9 +2530,40 @@ static DECLCALLBACK(int) vnetLoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint3
             pThis->nMacFilterEntries = 0;
             memset(pThis->aMacFilter, 0, VNET_MAC_FILTER_LEN * sizeof(RTMAC));
             memset(pThis->aVlanFilter, 0, sizeof(pThis->aVlanFilter));
-            if (pThis->pDrv)
-                pThis->pDrv->pfnSetPromiscuousMode(pThis->pDrv, true);
+            vnetSetPromiscuousMode(pThis, true);
+        }
+
+        if (uVersion > VNET_SAVEDSTATE_VERSION_PRE_MQ)
+        {
+            rc = SSMR3GetU16(pSSM, &pThis->cActivePairs);
+            AssertRCReturn(rc, rc);
+            AssertLogRelMsgReturn(pThis->cActivePairs >= 1 && pThis->cActivePairs <= pThis->cPairs,
+                                  ("cActivePairs=%u\n", pThis->cActivePairs), VERR_SSM_LOAD_CONFIG_MISMATCH);
+            rc = SSMR3GetMem(pSSM, &pThis->Rss, sizeof(pThis->Rss));
+            AssertRCReturn(rc, rc);
+            AssertLogRelMsgReturn(   pThis->Rss.uIndirectionTableMask < VNET_RSS_MAX_INDIRECTION_TABLE
+                                  && pThis->Rss.uUnclassifiedQueue < pThis->cPairs,
+                                  ("uIndirectionTableMask=%#x uUnclassifiedQueue=%u\n",
+                                   pThis->Rss.uIndirectionTableMask, pThis->Rss.uUnclassifiedQueue),
+                                  VERR_SSM_LOAD_CONFIG_MISMATCH);
+            for (unsigned i = 0; i < VNET_RSS_MAX_INDIRECTION_TABLE; i++)
+                AssertLogRelMsgReturn(pThis->Rss.au16IndirectionTable[i] < pThis->cPairs,
+                                      ("au16IndirectionTable[%u]=%u\n", i, pThis->Rss.au16IndirectionTable[i]),
+                                      VERR_SSM_LOAD_CONFIG_MISMATCH);
         }
+        else
+        {
+            pThis->cActivePairs = 1;
+            vnetRssSetDefault(pThis);
+        }
+
+        if (uVersion > VNET_SAVEDSTATE_VERSION_PRE_OFFLOADS)
+        {
+            rc = SSMR3GetU32(pSSM, &pThis->fGuestOffloads);
+            AssertRCReturn(rc, rc);
+        }
+        else
+            pThis->fGuestOffloads = pThis->VPCI.uGuestFeatures & VNET_GUEST_OFFLOADS;
     }
 
     return rc;
@@ -1950,9 +2579,7 @@ static DECLCALLBACK(int) vnetLoadDone(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
     RT_NOREF(pSSM);
     PVNETSTATE pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
 
-    if (pThis->pDrv)
-        pThis->pDrv->pfnSetPromiscuousMode(pThis->pDrv,
-            (pThis->fPromiscuous | pThis->fAllMulti));
+    vnetSetPromiscuousMode(pThis, pThis->fPromiscuous | pThis->fAllMulti);
     /*
      * Indicate link down to the guest OS that all network connections have
      * been lost, unless we've been teleported here.
@@ -2004,6 +2631,38 @@ static DECLCALLBACK(int) vnetMap(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, uint32_
 
 /* -=-=-=-=- PDMDEVREG -=-=-=-=- */
 
+/**
+ * Attaches the dedicated connector of a queue pair, LUN #N for pair N.
+ *
+ * @returns VBox status code, no attached driver is not an error as the
+ *          queue pair then shares the connector on LUN #0.
+ * @param   pThis       The device state structure.
+ * @param   pPair       The queue pair, not the first one.
+ */
+static int vnetAttachPairDriver(PVNETSTATE pThis, PVNETQUEUEPAIR pPair)
+{
+    Assert(pPair->iPair > 0);
+    int rc = PDMDevHlpDriverAttach(pThis->VPCI.CTX_SUFF(pDevIns), pPair->iPair, &pPair->IBase,
+                                   &pPair->pDrvBase, "Network Port");
+    if (RT_SUCCESS(rc))
+    {
+        pPair->pDrv = PDMIBASE_QUERY_INTERFACE(pPair->pDrvBase, PDMINETWORKUP);
+        AssertMsgReturn(pPair->pDrv, ("Failed to obtain the PDMINETWORKUP interface!\n"),
+                        VERR_PDM_MISSING_INTERFACE_BELOW);
+        pPair->pDrv->pfnSetPromiscuousMode(pPair->pDrv, pThis->fPromiscuous | pThis->fAllMulti);
+    }
+    else if (   rc == VERR_PDM_NO_ATTACHED_DRIVER
+             || rc == VERR_PDM_CFG_MISSING_DRIVER_NAME)
+    {
+        Log(("%s Queue pair %u shares the connector on LUN #0\n", INSTANCE(pThis), pPair->iPair));
+        pPair->pDrvBase = NULL;
+        pPair->pDrv     = NULL;
+        rc = VINF_SUCCESS;
+    }
+    return rc;
+}
+
+
 /**
  * @interface_method_impl{PDMDEVREG,pfnDetach}
  */
@@ -2011,9 +2670,9 @@ static DECLCALLBACK(void) vnetDetach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t
 {
     RT_NOREF(fFlags);
     PVNETSTATE pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
-    Log(("%s vnetDetach:\n", INSTANCE(pThis)));
+    Log(("%s vnetDetach: iLUN=%u\n", INSTANCE(pThis), iLUN));
 
-    AssertLogRelReturnVoid(iLUN == 0);
+    AssertLogRelReturnVoid(iLUN < pThis->cPairs);
 
     int rc = vnetCsEnter(pThis, VERR_SEM_BUSY);
     if (RT_FAILURE(rc))
@@ -2022,12 +2681,21 @@ static DECLCALLBACK(void) vnetDetach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t
         return;
     }
 
-    vnetDestroyTxThreadAndEvent(pThis);
-    /*
-     * Zero some important members.
-     */
-    pThis->pDrvBase = NULL;
-    pThis->pDrv = NULL;
+    if (iLUN == 0)
+    {
+        vnetDestroyTxThreadAndEvent(pThis);
+        /*
+         * Zero some important members.
+         */
+        pThis->pDrvBase = NULL;
+        pThis->pDrv = NULL;
+    }
+    else
+    {
+        /* The queue pair falls back to the connector on LUN #0. */
+        pThis->aPairs[iLUN].pDrvBase = NULL;
+        pThis->aPairs[iLUN].pDrv     = NULL;
+    }
 
     vnetCsLeave(pThis);
 }
@@ -2040,9 +2708,9 @@ static DECLCALLBACK(int) vnetAttach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t
 {
     RT_NOREF(fFlags);
     PVNETSTATE pThis = PDMINS_2_DATA(pDevIns, PVNETSTATE);
-    LogFlow(("%s vnetAttach:\n",  INSTANCE(pThis)));
+    LogFlow(("%s vnetAttach: iLUN=%u\n",  INSTANCE(pThis), iLUN));
 
-    AssertLogRelReturn(iLUN == 0, VERR_PDM_NO_SUCH_LUN);
+    AssertLogRelReturn(iLUN < pThis->cPairs, VERR_PDM_NO_SUCH_LUN);
 
     int rc = vnetCsEnter(pThis, VERR_SEM_BUSY);
     if (RT_FAILURE(rc))
@@ -2051,6 +2719,13 @@ static DECLCALLBACK(int) vnetAttach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t
         return rc;
     }
 
+    if (iLUN != 0)
+    {
+        rc = vnetAttachPairDriver(pThis, &pThis->aPairs[iLUN]);
+        vnetCsLeave(pThis);
+        return rc;
+    }
+
     /*
      * Attach the driver.
      */
@@ -2143,16 +2818,19 @@ static DECLCALLBACK(int) vnetDestruct(PPDMDEVINS pDevIns)
             pThis->u32AvgDiff, pThis->u32MinDiff, pThis->u32MaxDiff));
 #endif /* VNET_TX_DELAY */
     Log(("%s Destroying instance\n", INSTANCE(pThis)));
-    if (pThis->hEventMoreRxDescAvail != NIL_RTSEMEVENT)
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->aPairs); i++)
     {
-        RTSemEventSignal(pThis->hEventMoreRxDescAvail);
-        RTSemEventDestroy(pThis->hEventMoreRxDescAvail);
-        pThis->hEventMoreRxDescAvail = NIL_RTSEMEVENT;
+        PVNETQUEUEPAIR pPair = &pThis->aPairs[i];
+        if (pPair->hEventMoreRxDescAvail != NIL_RTSEMEVENT)
+        {
+            RTSemEventSignal(pPair->hEventMoreRxDescAvail);
+            RTSemEventDestroy(pPair->hEventMoreRxDescAvail);
+            pPair->hEventMoreRxDescAvail = NIL_RTSEMEVENT;
+        }
+        if (PDMCritSectIsInitialized(&pPair->CritSectRx))
+            PDMR3CritSectDelete(&pPair->CritSectRx);
     }
 
-    // if (PDMCritSectIsInitialized(&pThis->csRx))
-    //     PDMR3CritSectDelete(&pThis->csRx);
-
     return vpciDestruct(&pThis->VPCI);
 }
 
@@ -2167,29 +2845,46 @@ static DECLCALLBACK(int) vnetConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMN
     int        rc;
 
     /* Initialize the instance data suffiencently for the destructor not to blow up. */
-    pThis->hEventMoreRxDescAvail = NIL_RTSEMEVENT;
+    for (unsigned i = 0; i < RT_ELEMENTS(pThis->aPairs); i++)
+        pThis->aPairs[i].hEventMoreRxDescAvail = NIL_RTSEMEVENT;
 
     /* Do our own locking. */
     rc = PDMDevHlpSetDeviceCritSect(pDevIns, PDMDevHlpCritSectGetNop(pDevIns));
     AssertRCReturn(rc, rc);
 
+    /*
+     * Validate configuration.
+     */
+    if (!CFGMR3AreValuesValid(pCfg, "MAC\0" "CableConnected\0" "LineSpeed\0" "LinkUpDelay\0" "NumQueues\0"))
+        return PDMDEV_SET_ERROR(pDevIns, VERR_PDM_DEVINS_UNKNOWN_CFG_VALUES, N_("Invalid configuration for VirtioNet device"));
+
+    /** @cfgm{NumQueues, uint16_t, 1}
+     * The number of RX/TX queue pairs offered to the guest (1..16).  Each pair
+     * gets its own RX lock and TX thread; a pair can be given a connector of
+     * its own on LUN #N, otherwise it shares the one on LUN #0. */
+    rc = CFGMR3QueryU16Def(pCfg, "NumQueues", &pThis->cPairs, 1);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc,
+                                N_("Configuration error: Failed to get the value of 'NumQueues'"));
+    if (pThis->cPairs < 1 || pThis->cPairs > VNET_MAX_QUEUE_PAIRS)
+        return PDMDevHlpVMSetError(pDevIns, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                                   N_("Configuration error: 'NumQueues' must be between 1 and %u"), VNET_MAX_QUEUE_PAIRS);
+    pThis->cActivePairs = 1;
+
     /* Initialize PCI part. */
     pThis->VPCI.IBase.pfnQueryInterface    = vnetQueryInterface;
     rc = vpciConstruct(pDevIns, &pThis->VPCI, iInstance,
                        VNET_NAME_FMT, VIRTIO_NET_ID,
-                       VNET_PCI_CLASS, VNET_N_QUEUES);
-    pThis->pRxQueue  = vpciAddQueue(&pThis->VPCI, 256, vnetQueueReceive,  "RX ");
-    pThis->pTxQueue  = vpciAddQueue(&pThis->VPCI, 256, vnetQueueTransmit, "TX ");
+                       VNET_PCI_CLASS, VNET_QUEUE_CTL(pThis->cPairs) + 1);
+    for (unsigned i = 0; i < pThis->cPairs; i++)
+    {
+        pThis->aPairs[i].pRxQueue = vpciAddQueue(&pThis->VPCI, 256, vnetQueueReceive,  "RX ");
+        pThis->aPairs[i].pTxQueue = vpciAddQueue(&pThis->VPCI, 256, vnetQueueTransmit, "TX ");
+    }
     pThis->pCtlQueue = vpciAddQueue(&pThis->VPCI, 16,  vnetQueueControl,  "CTL");
 
     Log(("%s Constructing new instance\n", INSTANCE(pThis)));
 
-    /*
-     * Validate configuration.
-     */
-    if (!CFGMR3AreValuesValid(pCfg, "MAC\0" "CableConnected\0" "LineSpeed\0" "LinkUpDelay\0"))
-        return PDMDEV_SET_ERROR(pDevIns, VERR_PDM_DEVINS_UNKNOWN_CFG_VALUES, N_("Invalid configuration for VirtioNet device"));
-
     /* Get config params */
     rc = CFGMR3QueryBytes(pCfg, "MAC", pThis->macConfigured.au8,
                           sizeof(pThis->macConfigured));
@@ -2219,37 +2914,58 @@ static DECLCALLBACK(int) vnetConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMN
     /* Initialize PCI config space */
     memcpy(pThis->config.mac.au8, pThis->macConfigured.au8, sizeof(pThis->config.mac.au8));
     pThis->config.uStatus = 0;
+    pThis->config.uMaxVirtqueuePairs      = pThis->cPairs;
+    pThis->config.cbRssMaxKey             = VNET_RSS_MAX_KEY_SIZE;
+    pThis->config.cRssMaxIndirectionTable = VNET_RSS_MAX_INDIRECTION_TABLE;
+    pThis->config.fRssSupportedHashTypes  = VNET_RSS_HASH_TYPES_SUPPORTED;
+    /* Receive steering is a virtio 1.0 feature, legacy drivers only get VNET_F_MQ. */
+    if (pThis->cPairs > 1)
+        pThis->VPCI.uHostFeaturesHi = VNET_F_HI_RSS;
 
     /* Initialize state structure */
     pThis->u32PktNo     = 1;
 
     /* Interfaces */
-    pThis->INetworkDown.pfnWaitReceiveAvail = vnetNetworkDown_WaitReceiveAvail;
-    pThis->INetworkDown.pfnReceive          = vnetNetworkDown_Receive;
-    pThis->INetworkDown.pfnReceiveGso       = vnetNetworkDown_ReceiveGso;
-    pThis->INetworkDown.pfnXmitPending      = vnetNetworkDown_XmitPending;
+    for (unsigned i = 0; i < pThis->cPairs; i++)
+    {
+        PVNETQUEUEPAIR pPair = &pThis->aPairs[i];
+        pPair->pThisR3                          = pThis;
+        pPair->iPair                            = (uint16_t)i;
+        pPair->IBase.pfnQueryInterface          = vnetPairQueryInterface;
+        pPair->INetworkDown.pfnWaitReceiveAvail = vnetNetworkDown_WaitReceiveAvail;
+        pPair->INetworkDown.pfnReceive          = vnetNetworkDown_Receive;
+        pPair->INetworkDown.pfnReceiveGso       = vnetNetworkDown_ReceiveGso;
+        pPair->INetworkDown.pfnXmitPending      = vnetNetworkDown_XmitPending;
+#ifndef VNET_TX_DELAY
+        pPair->hTxEvent                         = NIL_SUPSEMEVENT;
+        pPair->pTxThread                        = NULL;
+#endif
+
+        /* Initialize the RX critical section of the pair. */
+        rc = PDMDevHlpCritSectInit(pDevIns, &pPair->CritSectRx, RT_SRC_POS, "%sRX%u", INSTANCE(pThis), i);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
 
     pThis->INetworkConfig.pfnGetMac         = vnetGetMac;
     pThis->INetworkConfig.pfnGetLinkState   = vnetGetLinkState;
     pThis->INetworkConfig.pfnSetLinkState   = vnetSetLinkState;
 
-    /* Initialize critical section. */
-    // char szTmp[sizeof(pThis->VPCI.szInstance) + 2];
-    // RTStrPrintf(szTmp, sizeof(szTmp), "%sRX", pThis->VPCI.szInstance);
-    // rc = PDMDevHlpCritSectInit(pDevIns, &pThis->csRx, szTmp);
-    // if (RT_FAILURE(rc))
-    //     return rc;
+    /* Only the net device uses the vqueue API exclusively and can therefore offer packed rings. */
+    rc = vpciConstructModern(pDevIns, &pThis->VPCI, &g_IOCallbacks, sizeof(VNetPCIConfig), VPCI_MODERN_F_RING_PACKED);
+    if (RT_FAILURE(rc))
+        return rc;
 
     /* Map our ports to IO space. */
     rc = PDMDevHlpPCIIORegionRegister(pDevIns, 0,
-                                      VPCI_CONFIG + sizeof(VNetPCIConfig),
+                                      VPCI_CONFIG_MSIX + sizeof(VNetPCIConfig),
                                       PCI_ADDRESS_SPACE_IO, vnetMap);
     if (RT_FAILURE(rc))
         return rc;
 
 
     /* Register save/restore state handlers. */
-    rc = PDMDevHlpSSMRegisterEx(pDevIns, VIRTIO_SAVEDSTATE_VERSION, sizeof(VNETSTATE), NULL,
+    rc = PDMDevHlpSSMRegisterEx(pDevIns, VNET_SAVEDSTATE_VERSION, sizeof(VNETSTATE), NULL,
                                 NULL,         vnetLiveExec, NULL,
                                 vnetSavePrep, vnetSaveExec, NULL,
                                 vnetLoadPrep, vnetLoadExec, vnetLoadDone);
@@ -2273,8 +2989,6 @@ static DECLCALLBACK(int) vnetConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMN
 
 #ifndef VNET_TX_DELAY
     pThis->pSupDrvSession = PDMDevHlpGetSupDrvSession(pDevIns);
-    pThis->hTxEvent       = NIL_SUPSEMEVENT;
-    pThis->pTxThread      = NULL;
 #else /* VNET_TX_DELAY */
     /* Create Transmit Delay Timer */
     rc = PDMDevHlpTMTimerCreate(pDevIns, TMCLOCK_VIRTUAL, vnetTxTimer, pThis,
@@ -2312,9 +3026,19 @@ static DECLCALLBACK(int) vnetConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMN
     else
         return PDMDEV_SET_ERROR(pDevIns, rc, N_("Failed to attach the network LUN"));
 
-    rc = RTSemEventCreate(&pThis->hEventMoreRxDescAvail);
-    if (RT_FAILURE(rc))
-        return rc;
+    for (unsigned i = 1; i < pThis->cPairs; i++)
+    {
+        rc = vnetAttachPairDriver(pThis, &pThis->aPairs[i]);
+        if (RT_FAILURE(rc))
+            return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS, N_("Failed to attach the network LUN #%u"), i);
+    }
+
+    for (unsigned i = 0; i < pThis->cPairs; i++)
+    {
+        rc = RTSemEventCreate(&pThis->aPairs[i].hEventMoreRxDescAvail);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
 
     rc = vnetIoCb_Reset(pThis);
     AssertRC(rc);
@@ -2325,9 +3049,15 @@ static DECLCALLBACK(int) vnetConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMN
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReceiveBytes,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,          "Amount of data received",            "/Devices/VNet%d/ReceiveBytes", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatTransmitBytes,      STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,          "Amount of data transmitted",         "/Devices/VNet%d/TransmitBytes", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReceiveGSO,         STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,          "Number of received GSO packets",     "/Devices/VNet%d/Packets/ReceiveGSO", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReceiveNoBufs,      STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,          "Frames not fitting the mergeable RX buffers", "/Devices/VNet%d/Packets/ReceiveNoBufs", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatTransmitPackets,    STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,          "Number of sent packets",             "/Devices/VNet%d/Packets/Transmit", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatTransmitGSO,        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,          "Number of sent GSO packets",         "/Devices/VNet%d/Packets/Transmit-Gso", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatTransmitCSum,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,          "Number of completed TX checksums",   "/Devices/VNet%d/Packets/Transmit-Csum", iInstance);
+    for (unsigned i = 0; i < pThis->cPairs; i++)
+    {
+        PDMDevHlpSTAMRegisterF(pDevIns, &pThis->aPairs[i].StatReceivePackets,  STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT, "Number of packets received by the queue pair", "/Devices/VNet%d/Queue%u/ReceivePackets", iInstance, i);
+        PDMDevHlpSTAMRegisterF(pDevIns, &pThis->aPairs[i].StatTransmitPackets, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT, "Number of packets sent by the queue pair",     "/Devices/VNet%d/Queue%u/TransmitPackets", iInstance, i);
+    }
 #if defined(VBOX_WITH_STATISTICS)
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReceive,            STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_CALL, "Profiling receive",                  "/Devices/VNet%d/Receive/Total", iInstance);
     PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReceiveStore,       STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_CALL, "Profiling receive storing",          "/Devices/VNet%d/Receive/Store", iInstance);
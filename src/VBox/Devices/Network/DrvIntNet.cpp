@@ -141,8 +141,11 @@ typedef struct DRVINTNET
     /** Set if data transmission should start immediately and deactivate
      * as late as possible. */
     bool                            fActivateEarlyDeactivateLate;
+    /** Set if the receive thread tells the switch when it's busy draining the
+     * receive ring so it can skip signalling us (INTNETBUF::u32RecvState). */
+    bool                            fWakeupModeration;
     /** Padding. */
-    bool                            afReserved[HC_ARCH_BITS == 64 ? 3 : 3];
+    bool                            afReserved[HC_ARCH_BITS == 64 ? 2 : 2];
     /** Scratch space for holding the ring-0 scatter / gather descriptor.
      * The PDMSCATTERGATHER::fFlags member is used to indicate whether it is in
      * use or not.  Always accessed while owning the XmitLock. */
@@ -689,6 +692,8 @@ static int drvR3IntNetRecvRun(PDRVINTNET pThis)
     STAM_PROFILE_ADV_START(&pThis->StatReceive, a);
     PINTNETBUF      pBuf     = pThis->CTX_SUFF(pBuf);
     PINTNETRINGBUF  pRingBuf = &pBuf->Recv;
+    if (pThis->fWakeupModeration)
+        IntNetBufRecvSetBusy(pBuf);
     for (;;)
     {
         /*
@@ -851,6 +856,9 @@ static int drvR3IntNetRecvRun(PDRVINTNET pThis)
             LogFlow(("drvR3IntNetRecvRun: returns VINF_SUCCESS (state changed - #1)\n"));
             return VERR_STATE_CHANGED;
         }
+        if (   pThis->fWakeupModeration
+            && !IntNetBufRecvPrepareWait(pBuf))
+            continue;
         INTNETIFWAITREQ WaitReq;
         WaitReq.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
         WaitReq.Hdr.cbReq    = sizeof(WaitReq);
@@ -859,6 +867,8 @@ static int drvR3IntNetRecvRun(PDRVINTNET pThis)
         WaitReq.cMillies     = 30000; /* 30s - don't wait forever, timeout now and then. */
         STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
         int rc = PDMDrvHlpSUPCallVMMR0Ex(pDrvIns, VMMR0_DO_INTNET_IF_WAIT, &WaitReq, sizeof(WaitReq));
+        if (pThis->fWakeupModeration)
+            IntNetBufRecvSetBusy(pBuf);
         if (    RT_FAILURE(rc)
             &&  rc != VERR_TIMEOUT
             &&  rc != VERR_INTERRUPTED)
@@ -1229,6 +1239,7 @@ static DECLCALLBACK(void) drvR3IntNetDestruct(PPDMDRVINS pDrvIns)
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->pBufR3->cStatYieldsNok);
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->pBufR3->cStatLost);
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->pBufR3->cStatBadFrames);
+        PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->pBufR3->cStatWakeupsAvoided);
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->pBufR3->StatSend1);
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->pBufR3->StatSend2);
         PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->pBufR3->StatRecv1);
@@ -1398,6 +1409,7 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
                                   "|TrunkType"
                                   "|ReceiveBufferSize"
                                   "|SendBufferSize"
+                                  "|WakeupModeration"
                                   "|SharedMacOnWire"
                                   "|RestrictAccess"
                                   "|RequireExactPolicyMatch"
@@ -1627,8 +1639,9 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
     AssertRCReturn(rc, rc);
 
 
-    /** @cfgm{ReceiveBufferSize, uint32_t, 318 KB}
-     * The size of the receive buffer.
+    /** @cfgm{ReceiveBufferSize, uint32_t, 318 KB, , 32 MB}
+     * The size of the receive buffer.  Traffic between VMs on the same host can
+     * benefit from making this a lot larger than the default.
      */
     rc = CFGMR3QueryU32(pCfg, "ReceiveBufferSize", &OpenReq.cbRecv);
     if (rc == VERR_CFGM_VALUE_NOT_FOUND)
@@ -1636,8 +1649,12 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
     else if (RT_FAILURE(rc))
         return PDMDRV_SET_ERROR(pDrvIns, rc,
                                 N_("Configuration error: Failed to get the \"ReceiveBufferSize\" value"));
+    if (OpenReq.cbRecv > INTNET_MAX_RING_SIZE)
+        return PDMDrvHlpVMSetError(pDrvIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("Configuration error: The \"ReceiveBufferSize\" value %u is too large (max %u)"),
+                                   OpenReq.cbRecv, INTNET_MAX_RING_SIZE);
 
-    /** @cfgm{SendBufferSize, uint32_t, 196 KB}
+    /** @cfgm{SendBufferSize, uint32_t, 196 KB, 128, 32 MB}
      * The size of the send (transmit) buffer.
      * This should be more than twice the size of the larges frame size because
      * the ring buffer is very simple and doesn't support splitting up frames
@@ -1654,6 +1671,10 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
     if (OpenReq.cbSend < 128)
         return PDMDRV_SET_ERROR(pDrvIns, rc,
                                 N_("Configuration error: The \"SendBufferSize\" value is too small"));
+    if (OpenReq.cbSend > INTNET_MAX_RING_SIZE)
+        return PDMDrvHlpVMSetError(pDrvIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("Configuration error: The \"SendBufferSize\" value %u is too large (max %u)"),
+                                   OpenReq.cbSend, INTNET_MAX_RING_SIZE);
     if (OpenReq.cbSend < VBOX_MAX_GSO_SIZE * 3)
         LogRel(("DrvIntNet: Warning! SendBufferSize=%u, Recommended minimum size %u butes.\n", OpenReq.cbSend, VBOX_MAX_GSO_SIZE * 4));
 
@@ -1669,6 +1690,15 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
                                 N_("Configuration error: Failed to get the \"IsService\" value"));
 
 
+    /** @cfgm{WakeupModeration, boolean, true}
+     * Whether to let the switch skip waking up the receive thread while it is
+     * busy draining the receive ring.
+     */
+    rc = CFGMR3QueryBoolDef(pCfg, "WakeupModeration", &pThis->fWakeupModeration, true);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc,
+                                N_("Configuration error: Failed to get the \"WakeupModeration\" value"));
+
     /** @cfgm{IgnoreConnectFailure, boolean, false}
      * When set only raise a runtime error if we cannot connect to the internal
      * network. */
@@ -1808,6 +1838,7 @@ static DECLCALLBACK(int) drvR3IntNetConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->pBufR3->cStatYieldsNok,     "YieldOk",              "Number of times yielding helped fix an overflow.");
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->pBufR3->cStatYieldsOk,      "YieldNok",             "Number of times yielding didn't help fix an overflow.");
     PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->pBufR3->cStatBadFrames,     "BadFrames",            "Number of bad frames seed by the consumers.");
+    PDMDrvHlpSTAMRegCounter(pDrvIns, &pThis->pBufR3->cStatWakeupsAvoided, "WakeupsAvoided",      "Number of receive thread wakeups avoided by the wakeup moderation.");
     PDMDrvHlpSTAMRegProfile(pDrvIns, &pThis->pBufR3->StatSend1,          "Send1",                "Profiling IntNetR0IfSend.");
     PDMDrvHlpSTAMRegProfile(pDrvIns, &pThis->pBufR3->StatSend2,          "Send2",                "Profiling sending to the trunk.");
     PDMDrvHlpSTAMRegProfile(pDrvIns, &pThis->pBufR3->StatRecv1,          "Recv1",                "Reserved for future receive profiling.");
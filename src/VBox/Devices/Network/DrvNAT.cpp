@@ -788,6 +788,9 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
     unsigned int cBreak = 0;
 #else /* RT_OS_WINDOWS */
     unsigned int cPollNegRet = 0;
+    /* The poll array is kept across iterations and only grown when needed. */
+    struct pollfd *polls = NULL;
+    int cPollsAlloc = 0;
 #endif /* !RT_OS_WINDOWS */
 
     LogFlow(("drvNATAsyncIoThread: pThis=%p\n", pThis));
@@ -809,9 +812,18 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
 #ifndef RT_OS_WINDOWS
         nFDs = slirp_get_nsock(pThis->pNATState);
         /* allocation for all sockets + Management pipe */
-        struct pollfd *polls = (struct pollfd *)RTMemAlloc((1 + nFDs) * sizeof(struct pollfd) + sizeof(uint32_t));
-        if (polls == NULL)
-            return VERR_NO_MEMORY;
+        if (1 + nFDs > cPollsAlloc)
+        {
+            int cNew = RT_ALIGN_32(1 + nFDs, 64);
+            struct pollfd *paNew = (struct pollfd *)RTMemRealloc(polls, cNew * sizeof(struct pollfd) + sizeof(uint32_t));
+            if (paNew == NULL)
+            {
+                RTMemFree(polls);
+                return VERR_NO_MEMORY;
+            }
+            polls = paNew;
+            cPollsAlloc = cNew;
+        }
 
         /* don't pass the management pipe */
         slirp_select_fill(pThis->pNATState, &nFDs, &polls[1]);
@@ -861,7 +873,6 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
         }
         /* process _all_ outstanding requests but don't wait */
         RTReqQueueProcess(pThis->hSlirpReqQueue, 0);
-        RTMemFree(polls);
 
 #else /* RT_OS_WINDOWS */
         nFDs = -1;
@@ -899,6 +910,9 @@ static DECLCALLBACK(int) drvNATAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
 #endif /* RT_OS_WINDOWS */
     }
 
+#ifndef RT_OS_WINDOWS
+    RTMemFree(polls);
+#endif
     return VINF_SUCCESS;
 }
 
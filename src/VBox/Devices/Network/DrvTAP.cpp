@@ -28,8 +28,10 @@
 #include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/ctype.h>
+#include <iprt/err.h>
 #include <iprt/file.h>
 #include <iprt/mem.h>
+#include <iprt/net.h>
 #include <iprt/path.h>
 #include <iprt/pipe.h>
 #include <iprt/semaphore.h>
@@ -43,6 +45,7 @@
 
 #include <sys/ioctl.h>
 #include <sys/poll.h>
+#include <sys/uio.h>
 #ifdef RT_OS_SOLARIS
 # include <sys/stat.h>
 # include <sys/ethernet.h>
@@ -61,15 +64,75 @@
 #else
 # include <sys/fcntl.h>
 #endif
+#ifdef RT_OS_LINUX
+# include <net/if.h>
+# include <linux/if_tun.h>
+#endif
 #include <errno.h>
 #include <unistd.h>
 
 #include "VBoxDD.h"
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** Size of the receive buffer without receive offloads. */
+#define DRVTAP_RECV_BUF_SIZE                _16K
+/** Size of the receive buffer when the host may hand us GSO frames (max IP
+ * packet plus ethernet and VLAN headers). */
+#define DRVTAP_RECV_BUF_SIZE_GSO            (_64K + 64)
+/** Maximum number of frames read per poll() wakeup before checking the
+ * control pipe again. */
+#define DRVTAP_RECV_BATCH_MAX               64
+
+/** @name DRVTAPVNETHDR::fFlags
+ * @{ */
+/** The checksum at offCsumStart + offCsum needs completing. */
+#define DRVTAP_VNETHDR_F_NEEDS_CSUM         1
+/** @} */
+
+/** @name DRVTAPVNETHDR::u8GsoType
+ * @{ */
+#define DRVTAP_VNETHDR_GSO_NONE             0
+#define DRVTAP_VNETHDR_GSO_TCPV4            1
+#define DRVTAP_VNETHDR_GSO_UDP              3
+#define DRVTAP_VNETHDR_GSO_TCPV6            4
+#define DRVTAP_VNETHDR_GSO_ECN              0x80
+/** @} */
+
+
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
 *********************************************************************************************************************************/
+/**
+ * The virtio-net header the Linux TAP driver puts in front of each frame when
+ * the device was set up with IFF_VNET_HDR (struct virtio_net_hdr).
+ *
+ * All fields are in host byte order.
+ */
+typedef struct DRVTAPVNETHDR
+{
+    /** Flags, DRVTAP_VNETHDR_F_XXX. */
+    uint8_t                 fFlags;
+    /** The segmentation type, DRVTAP_VNETHDR_GSO_XXX. */
+    uint8_t                 u8GsoType;
+    /** Size of the headers (ethernet, IP and TCP/UDP). */
+    uint16_t                cbHdrs;
+    /** The maximum segment size. */
+    uint16_t                cbGsoSize;
+    /** Where to start checksumming. */
+    uint16_t                offCsumStart;
+    /** Offset of the checksum field relative to offCsumStart. */
+    uint16_t                offCsum;
+} DRVTAPVNETHDR;
+AssertCompileSize(DRVTAPVNETHDR, 10);
+/** Pointer to a virtio-net header. */
+typedef DRVTAPVNETHDR *PDRVTAPVNETHDR;
+/** Pointer to a const virtio-net header. */
+typedef DRVTAPVNETHDR const *PCDRVTAPVNETHDR;
+
+
 /**
  * TAP driver instance data.
  *
@@ -85,6 +148,13 @@ typedef struct DRVTAP
     PPDMDRVINS              pDrvIns;
     /** TAP device file handle. */
     RTFILE                  hFileDevice;
+    /** Whether we opened hFileDevice ourselves (additional queue) and must
+     * close it. */
+    bool                    fOwnFileDevice;
+    /** Whether every frame is prefixed by a DRVTAPVNETHDR (IFF_VNET_HDR). */
+    bool                    fVnetHdr;
+    /** Whether the host may pass us GSO and partially checksummed frames. */
+    bool                    fRecvOffloads;
     /** The configured TAP device name. */
     char                   *pszDeviceName;
 #ifdef RT_OS_SOLARIS
@@ -103,6 +173,10 @@ typedef struct DRVTAP
     RTPIPE                  hPipeRead;
     /** Reader thread. */
     PPDMTHREAD              pThread;
+    /** The receive buffer. */
+    uint8_t                *pbRecvBuf;
+    /** Size of the receive buffer. */
+    size_t                  cbRecvBuf;
 
     /** @todo The transmit thread. */
     /** Transmit lock used by drvTAPNetworkUp_BeginXmit. */
@@ -117,6 +191,14 @@ typedef struct DRVTAP
     STAMCOUNTER             StatPktRecv;
     /** Number of received bytes. */
     STAMCOUNTER             StatPktRecvBytes;
+    /** Number of GSO frames passed to the host unsegmented. */
+    STAMCOUNTER             StatPktSentGso;
+    /** Number of GSO frames received from the host. */
+    STAMCOUNTER             StatPktRecvGso;
+    /** Number of received GSO frames we had to segment. */
+    STAMCOUNTER             StatPktRecvGsoSegmented;
+    /** Number of received frames dropped (malformed or no room in the guest). */
+    STAMCOUNTER             StatPktRecvDropped;
     /** Profiling packet transmit runs. */
     STAMPROFILE             StatTransmit;
     /** Profiling packet receive runs. */
@@ -232,6 +314,66 @@ static DECLCALLBACK(int) drvTAPNetworkUp_FreeBuf(PPDMINETWORKUP pInterface, PPDM
 }
 
 
+/**
+ * Writes a frame to the TAP device, prefixed by the virtio-net header when
+ * the device wants one.
+ *
+ * @returns VBox status code.
+ * @param   pThis           The instance data.
+ * @param   pHdr            The virtio-net header, ignored without IFF_VNET_HDR.
+ * @param   pvFrame         The frame.
+ * @param   cbFrame         The frame size.
+ */
+static int drvTAPWriteFrame(PDRVTAP pThis, PCDRVTAPVNETHDR pHdr, const void *pvFrame, size_t cbFrame)
+{
+    struct iovec aSegs[2];
+    int          cSegs = 0;
+    if (pThis->fVnetHdr)
+    {
+        aSegs[cSegs].iov_base = (void *)pHdr;
+        aSegs[cSegs].iov_len  = sizeof(*pHdr);
+        cSegs++;
+    }
+    aSegs[cSegs].iov_base = (void *)pvFrame;
+    aSegs[cSegs].iov_len  = cbFrame;
+    cSegs++;
+
+    if (writev(RTFileToNative(pThis->hFileDevice), &aSegs[0], cSegs) >= 0)
+        return VINF_SUCCESS;
+    return RTErrConvertFromErrno(errno);
+}
+
+
+/**
+ * Sets up the virtio-net header for passing a GSO frame to the host as is.
+ *
+ * @returns true if the host can segment the frame, false if we have to do it.
+ * @param   pGso            The GSO context.
+ * @param   pHdr            Where to return the header.
+ */
+static bool drvTAPGsoToVnetHdr(PCPDMNETWORKGSO pGso, PDRVTAPVNETHDR pHdr)
+{
+    switch (pGso->u8Type)
+    {
+        case PDMNETWORKGSOTYPE_IPV4_TCP:
+            pHdr->u8GsoType = DRVTAP_VNETHDR_GSO_TCPV4;
+            break;
+        case PDMNETWORKGSOTYPE_IPV6_TCP:
+            pHdr->u8GsoType = DRVTAP_VNETHDR_GSO_TCPV6;
+            break;
+        default:
+            /* UFO is not reliably available and the tunnel types cannot be expressed. */
+            return false;
+    }
+    pHdr->fFlags       = DRVTAP_VNETHDR_F_NEEDS_CSUM;
+    pHdr->cbHdrs       = pGso->cbHdrsTotal;
+    pHdr->cbGsoSize    = pGso->cbMaxSeg;
+    pHdr->offCsumStart = pGso->offHdr2;
+    pHdr->offCsum      = RT_UOFFSETOF(RTNETTCP, th_sum);
+    return true;
+}
+
+
 /**
  * @interface_method_impl{PDMINETWORKUP,pfnSendBuf}
  */
@@ -250,6 +392,8 @@ static DECLCALLBACK(int) drvTAPNetworkUp_SendBuf(PPDMINETWORKUP pInterface, PPDM
     /* Set an FTM checkpoint as this operation changes the state permanently. */
     PDMDrvHlpFTSetCheckpoint(pThis->pDrvIns, FTMCHECKPOINTTYPE_NETWORK);
 
+    DRVTAPVNETHDR Hdr;
+    RT_ZERO(Hdr);
     int rc;
     if (!pSgBuf->pvUser)
     {
@@ -263,7 +407,19 @@ static DECLCALLBACK(int) drvTAPNetworkUp_SendBuf(PPDMINETWORKUP pInterface, PPDM
               "%.*Rhxd\n",
               pSgBuf->aSegs[0].pvSeg, pSgBuf->cbUsed, pSgBuf->cbUsed, pSgBuf->aSegs[0].pvSeg));
 
-        rc = RTFileWrite(pThis->hFileDevice, pSgBuf->aSegs[0].pvSeg, pSgBuf->cbUsed, NULL);
+        rc = drvTAPWriteFrame(pThis, &Hdr, pSgBuf->aSegs[0].pvSeg, pSgBuf->cbUsed);
+    }
+    else if (   pThis->fVnetHdr
+             && drvTAPGsoToVnetHdr((PCPDMNETWORKGSO)pSgBuf->pvUser, &Hdr))
+    {
+        /*
+         * The host kernel does the segmentation, it only needs the pseudo
+         * header checksum and the length fields for the whole frame.
+         */
+        PDMNetGsoPrepForDirectUse((PCPDMNETWORKGSO)pSgBuf->pvUser, pSgBuf->aSegs[0].pvSeg, pSgBuf->cbUsed,
+                                  PDMNETCSUMTYPE_PSEUDO);
+        STAM_COUNTER_INC(&pThis->StatPktSentGso);
+        rc = drvTAPWriteFrame(pThis, &Hdr, pSgBuf->aSegs[0].pvSeg, pSgBuf->cbUsed);
     }
     else
     {
@@ -277,7 +433,7 @@ static DECLCALLBACK(int) drvTAPNetworkUp_SendBuf(PPDMINETWORKUP pInterface, PPDM
             uint32_t cbSegFrame;
             void *pvSegFrame = PDMNetGsoCarveSegmentQD(pGso, (uint8_t *)pbFrame, pSgBuf->cbUsed, abHdrScratch,
                                                        iSeg, cSegs, &cbSegFrame);
-            rc = RTFileWrite(pThis->hFileDevice, pvSegFrame, cbSegFrame, NULL);
+            rc = drvTAPWriteFrame(pThis, &Hdr, pvSegFrame, cbSegFrame);
             if (RT_FAILURE(rc))
                 break;
         }
@@ -330,6 +486,225 @@ static DECLCALLBACK(void) drvTAPNetworkUp_NotifyLinkChanged(PPDMINETWORKUP pInte
 }
 
 
+/**
+ * Reads one frame from the TAP device into the receive buffer.
+ *
+ * @returns VBox status code, VERR_TRY_AGAIN if nothing is pending.
+ * @param   pThis           The instance data.
+ * @param   pHdr            Where to return the virtio-net header.  Zeroed
+ *                          if the device does not provide one.
+ * @param   pcbFrame        Where to return the frame size.  Zero for runt
+ *                          reads which are to be ignored.
+ */
+static int drvTAPReadFrame(PDRVTAP pThis, PDRVTAPVNETHDR pHdr, size_t *pcbFrame)
+{
+    struct iovec aSegs[2];
+    int          cSegs = 0;
+    if (pThis->fVnetHdr)
+    {
+        aSegs[cSegs].iov_base = pHdr;
+        aSegs[cSegs].iov_len  = sizeof(*pHdr);
+        cSegs++;
+    }
+    else
+        RT_ZERO(*pHdr);
+    aSegs[cSegs].iov_base = pThis->pbRecvBuf;
+    aSegs[cSegs].iov_len  = pThis->cbRecvBuf;
+    cSegs++;
+
+    ssize_t cbRead = readv(RTFileToNative(pThis->hFileDevice), &aSegs[0], cSegs);
+    if (cbRead < 0)
+        return RTErrConvertFromErrno(errno);
+    if (pThis->fVnetHdr)
+    {
+        if ((size_t)cbRead <= sizeof(*pHdr))
+            cbRead = sizeof(*pHdr);
+        cbRead -= sizeof(*pHdr);
+    }
+    *pcbFrame = (size_t)cbRead;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Translates the virtio-net header of a GSO frame from the host.
+ *
+ * @returns true if valid, false if the frame must be dropped.
+ * @param   pHdr            The virtio-net header.
+ * @param   pbFrame         The frame.
+ * @param   cbFrame         The frame size.
+ * @param   pGso            Where to return the GSO context.
+ */
+static bool drvTAPVnetHdrToGso(PCDRVTAPVNETHDR pHdr, const uint8_t *pbFrame, size_t cbFrame, PPDMNETWORKGSO pGso)
+{
+    switch (pHdr->u8GsoType)
+    {
+        case DRVTAP_VNETHDR_GSO_TCPV4:
+            pGso->u8Type = PDMNETWORKGSOTYPE_IPV4_TCP;
+            break;
+        case DRVTAP_VNETHDR_GSO_TCPV6:
+            pGso->u8Type = PDMNETWORKGSOTYPE_IPV6_TCP;
+            break;
+        default:
+            return false;
+    }
+    if (   !(pHdr->fFlags & DRVTAP_VNETHDR_F_NEEDS_CSUM)
+        || pHdr->offCsumStart + sizeof(RTNETTCP) > cbFrame
+        || cbFrame < sizeof(RTNETETHERHDR))
+        return false;
+
+    /* The kernel reports the linear part of its buffer as header size, so work it out ourselves. */
+    PCRTNETTCP pTcpHdr  = (PCRTNETTCP)&pbFrame[pHdr->offCsumStart];
+    size_t     cbHdrs   = pHdr->offCsumStart + pTcpHdr->th_off * 4;
+    if (cbHdrs > UINT8_MAX)
+        return false;
+
+    PCRTNETETHERHDR pEthHdr = (PCRTNETETHERHDR)pbFrame;
+    pGso->offHdr1     = pEthHdr->EtherType == RT_H2N_U16_C(RTNET_ETHERTYPE_VLAN)
+                      ? sizeof(RTNETETHERHDR) + 4 : sizeof(RTNETETHERHDR);
+    pGso->offHdr2     = (uint8_t)pHdr->offCsumStart;
+    pGso->cbHdrsTotal = (uint8_t)cbHdrs;
+    pGso->cbHdrsSeg   = (uint8_t)cbHdrs;
+    pGso->cbMaxSeg    = pHdr->cbGsoSize;
+    pGso->u8Unused    = 0;
+    return PDMNetGsoIsValid(pGso, sizeof(*pGso), cbFrame);
+}
+
+
+/**
+ * Waits for the device to have receive space and passes a frame up.
+ *
+ * @returns VBox status code, failure if the device is not ready to receive.
+ * @param   pThis           The instance data.
+ * @param   pvFrame         The frame.
+ * @param   cbFrame         The frame size.
+ */
+static int drvTAPRecvPassUp(PDRVTAP pThis, const void *pvFrame, size_t cbFrame)
+{
+    /*
+     * Wait for the device to have space for this frame.
+     * Most guests use frame-sized receive buffers, hence non-zero cbMax
+     * automatically means there is enough room for entire frame. Some
+     * guests (eg. Solaris) use large chains of small receive buffers
+     * (each 128 or so bytes large). We will still start receiving as soon
+     * as cbMax is non-zero because:
+     *  - it would be quite expensive for pfnCanReceive to accurately
+     *    determine free receive buffer space
+     *  - if we were waiting for enough free buffers, there is a risk
+     *    of deadlocking because the guest could be waiting for a receive
+     *    overflow error to allocate more receive buffers
+     */
+    STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
+    int rc = pThis->pIAboveNet->pfnWaitReceiveAvail(pThis->pIAboveNet, RT_INDEFINITE_WAIT);
+    STAM_PROFILE_ADV_START(&pThis->StatReceive, a);
+
+    /*
+     * A return code != VINF_SUCCESS means that we were woken up during a VM
+     * state transition. Drop the packet and wait for the next one.
+     */
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /*
+     * Pass the data up.
+     */
+#ifdef LOG_ENABLED
+    uint64_t u64Now = RTTimeProgramNanoTS();
+    LogFlow(("drvTAPAsyncIoThread: %-4d bytes at %llu ns  deltas: r=%llu t=%llu\n",
+             cbFrame, u64Now, u64Now - pThis->u64LastReceiveTS, u64Now - pThis->u64LastTransferTS));
+    pThis->u64LastReceiveTS = u64Now;
+#endif
+    Log2(("drvTAPAsyncIoThread: cbRead=%#x\n" "%.*Rhxd\n", cbFrame, cbFrame, pvFrame));
+    STAM_COUNTER_INC(&pThis->StatPktRecv);
+    STAM_COUNTER_ADD(&pThis->StatPktRecvBytes, cbFrame);
+    rc = pThis->pIAboveNet->pfnReceive(pThis->pIAboveNet, pvFrame, cbFrame);
+    if (rc == VERR_NET_NO_BUFFER_SPACE)
+    {
+        /* The guest receive buffers can't take the frame, drop it. */
+        Log(("TAP#%d: Dropping frame of %#zx bytes, no buffer space\n", pThis->pDrvIns->iInstance, cbFrame));
+        STAM_COUNTER_INC(&pThis->StatPktRecvDropped);
+    }
+    else
+        AssertRC(rc);
+    return rc;
+}
+
+
+/**
+ * Handles a frame read from the TAP device, completing the checksum or
+ * segmenting it as requested by the virtio-net header.
+ *
+ * @param   pThis           The instance data.
+ * @param   pHdr            The virtio-net header (zero without IFF_VNET_HDR).
+ * @param   pbFrame         The frame, modified.
+ * @param   cbFrame         The frame size.
+ */
+static void drvTAPRecvFrame(PDRVTAP pThis, PCDRVTAPVNETHDR pHdr, uint8_t *pbFrame, size_t cbFrame)
+{
+    if (pHdr->u8GsoType == DRVTAP_VNETHDR_GSO_NONE)
+    {
+        if (pHdr->fFlags & DRVTAP_VNETHDR_F_NEEDS_CSUM)
+        {
+            /* The host left the checksum to us, the field holds the pseudo header sum. */
+            if (   pHdr->offCsumStart >= cbFrame
+                || (size_t)pHdr->offCsumStart + pHdr->offCsum + sizeof(uint16_t) > cbFrame)
+            {
+                LogRelMax(16, ("TAP#%d: Dropping frame with bogus checksum offsets %#x/%#x (cb=%#zx)\n",
+                               pThis->pDrvIns->iInstance, pHdr->offCsumStart, pHdr->offCsum, cbFrame));
+                STAM_COUNTER_INC(&pThis->StatPktRecvDropped);
+                return;
+            }
+            bool     fOdd  = false;
+            uint32_t u32Sum = RTNetIPv4AddDataChecksum(&pbFrame[pHdr->offCsumStart], cbFrame - pHdr->offCsumStart, 0, &fOdd);
+            uint16_t u16Sum = RTNetIPv4FinalizeChecksum(u32Sum);
+            *(uint16_t *)&pbFrame[pHdr->offCsumStart + pHdr->offCsum] = u16Sum ? u16Sum : 0xffff;
+        }
+        drvTAPRecvPassUp(pThis, pbFrame, cbFrame);
+        return;
+    }
+
+    PDMNETWORKGSO Gso;
+    if (!drvTAPVnetHdrToGso(pHdr, pbFrame, cbFrame, &Gso))
+    {
+        LogRelMax(16, ("TAP#%d: Dropping GSO frame with unsupported header: type=%#x flags=%#x csum=%#x/%#x\n",
+                       pThis->pDrvIns->iInstance, pHdr->u8GsoType, pHdr->fFlags, pHdr->offCsumStart, pHdr->offCsum));
+        STAM_COUNTER_INC(&pThis->StatPktRecvDropped);
+        return;
+    }
+    STAM_COUNTER_INC(&pThis->StatPktRecvGso);
+
+    if (pThis->pIAboveNet->pfnReceiveGso)
+    {
+        STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
+        int rc = pThis->pIAboveNet->pfnWaitReceiveAvail(pThis->pIAboveNet, RT_INDEFINITE_WAIT);
+        STAM_PROFILE_ADV_START(&pThis->StatReceive, a);
+        if (RT_FAILURE(rc))
+            return;
+        if (RT_SUCCESS(pThis->pIAboveNet->pfnReceiveGso(pThis->pIAboveNet, pbFrame, cbFrame, &Gso)))
+        {
+            STAM_COUNTER_INC(&pThis->StatPktRecv);
+            STAM_COUNTER_ADD(&pThis->StatPktRecvBytes, cbFrame);
+            return;
+        }
+    }
+
+    /*
+     * The device (or rather the guest) cannot take large frames, so we do
+     * the segmenting here.
+     */
+    STAM_COUNTER_INC(&pThis->StatPktRecvGsoSegmented);
+    uint8_t         abHdrScratch[256];
+    uint32_t const  cSegs = PDMNetGsoCalcSegmentCount(&Gso, cbFrame);
+    for (uint32_t iSeg = 0; iSeg < cSegs; iSeg++)
+    {
+        uint32_t cbSegFrame;
+        void    *pvSegFrame = PDMNetGsoCarveSegmentQD(&Gso, pbFrame, cbFrame, abHdrScratch, iSeg, cSegs, &cbSegFrame);
+        if (RT_FAILURE(drvTAPRecvPassUp(pThis, pvSegFrame, cbSegFrame)))
+            break;
+    }
+}
+
+
 /**
  * Asynchronous I/O thread for handling receive.
  *
@@ -376,58 +751,25 @@ static DECLCALLBACK(int) drvTAPAsyncIoThread(PPDMDRVINS pDrvIns, PPDMTHREAD pThr
             &&  !aFDs[1].revents)
         {
             /*
-             * Read the frame.
+             * Read and pass up everything that is pending.  The TAP device returns
+             * one frame per read, so keep reading until it runs dry, checking for
+             * state changes in between.
              */
-            char achBuf[16384];
-            size_t cbRead = 0;
-            /** @note At least on Linux we will never receive more than one network packet
-             *        after poll() returned successfully. I don't know why but a second
-             *        RTFileRead() operation will return with VERR_TRY_AGAIN in any case. */
-            rc = RTFileRead(pThis->hFileDevice, achBuf, sizeof(achBuf), &cbRead);
-            if (RT_SUCCESS(rc))
+            for (uint32_t cFrames = 0; cFrames < DRVTAP_RECV_BATCH_MAX; cFrames++)
             {
-                /*
-                 * Wait for the device to have space for this frame.
-                 * Most guests use frame-sized receive buffers, hence non-zero cbMax
-                 * automatically means there is enough room for entire frame. Some
-                 * guests (eg. Solaris) use large chains of small receive buffers
-                 * (each 128 or so bytes large). We will still start receiving as soon
-                 * as cbMax is non-zero because:
-                 *  - it would be quite expensive for pfnCanReceive to accurately
-                 *    determine free receive buffer space
-                 *  - if we were waiting for enough free buffers, there is a risk
-                 *    of deadlocking because the guest could be waiting for a receive
-                 *    overflow error to allocate more receive buffers
-                 */
-                STAM_PROFILE_ADV_STOP(&pThis->StatReceive, a);
-                int rc1 = pThis->pIAboveNet->pfnWaitReceiveAvail(pThis->pIAboveNet, RT_INDEFINITE_WAIT);
-                STAM_PROFILE_ADV_START(&pThis->StatReceive, a);
-
-                /*
-                 * A return code != VINF_SUCCESS means that we were woken up during a VM
-                 * state transition. Drop the packet and wait for the next one.
-                 */
-                if (RT_FAILURE(rc1))
-                    continue;
-
-                /*
-                 * Pass the data up.
-                 */
-#ifdef LOG_ENABLED
-                uint64_t u64Now = RTTimeProgramNanoTS();
-                LogFlow(("drvTAPAsyncIoThread: %-4d bytes at %llu ns  deltas: r=%llu t=%llu\n",
-                         cbRead, u64Now, u64Now - pThis->u64LastReceiveTS, u64Now - pThis->u64LastTransferTS));
-                pThis->u64LastReceiveTS = u64Now;
-#endif
-                Log2(("drvTAPAsyncIoThread: cbRead=%#x\n" "%.*Rhxd\n", cbRead, cbRead, achBuf));
-                STAM_COUNTER_INC(&pThis->StatPktRecv);
-                STAM_COUNTER_ADD(&pThis->StatPktRecvBytes, cbRead);
-                rc1 = pThis->pIAboveNet->pfnReceive(pThis->pIAboveNet, achBuf, cbRead);
-                AssertRC(rc1);
+                DRVTAPVNETHDR Hdr;
+                size_t        cbRead = 0;
+                rc = drvTAPReadFrame(pThis, &Hdr, &cbRead);
+                if (RT_FAILURE(rc))
+                    break;
+                if (cbRead)
+                    drvTAPRecvFrame(pThis, &Hdr, pThis->pbRecvBuf, cbRead);
+                if (pThread->enmState != PDMTHREADSTATE_RUNNING)
+                    break;
             }
-            else
+            if (RT_FAILURE(rc) && rc != VERR_TRY_AGAIN)
             {
-                LogFlow(("drvTAPAsyncIoThread: RTFileRead -> %Rrc\n", rc));
+                LogFlow(("drvTAPAsyncIoThread: drvTAPReadFrame -> %Rrc\n", rc));
                 if (rc == VERR_INVALID_HANDLE)
                     break;
                 RTThreadYield();
@@ -750,6 +1092,100 @@ static DECLCALLBACK(int) SolarisTAPAttach(PDRVTAP pThis)
 
 #endif  /* RT_OS_SOLARIS */
 
+
+#ifdef RT_OS_LINUX
+/**
+ * Opens an additional queue of a multiqueue TAP device, used when the driver
+ * serves one of the extra queue pairs of a network adapter.
+ *
+ * @returns VBox status code.
+ * @param   pThis           The instance data.
+ * @param   pszDevice       The TAP interface name.
+ */
+static int drvTAPLinuxOpenQueue(PDRVTAP pThis, const char *pszDevice)
+{
+# ifdef IFF_MULTI_QUEUE
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, "/dev/net/tun", RTFILE_O_READWRITE | RTFILE_O_OPEN | RTFILE_O_DENY_NONE);
+    if (RT_FAILURE(rc))
+        return PDMDrvHlpVMSetError(pThis->pDrvIns, rc, RT_SRC_POS,
+                                   N_("Failed to open /dev/net/tun for TAP device '%s'"), pszDevice);
+
+    struct ifreq IfReq;
+    RT_ZERO(IfReq);
+    RTStrCopy(IfReq.ifr_name, sizeof(IfReq.ifr_name), pszDevice);
+    IfReq.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR | IFF_MULTI_QUEUE;
+    if (ioctl(RTFileToNative(hFile), TUNSETIFF, &IfReq) != 0)
+    {
+        int iErr = errno;
+        RTFileClose(hFile);
+        return PDMDrvHlpVMSetError(pThis->pDrvIns, VERR_HOSTIF_INIT_FAILED, RT_SRC_POS,
+                                   N_("Failed to open another queue of TAP device '%s', the device must be created with "
+                                      "multiqueue support. errno=%d"), pszDevice, iErr);
+    }
+
+    pThis->hFileDevice    = hFile;
+    pThis->fOwnFileDevice = true;
+    return VINF_SUCCESS;
+# else
+    return PDMDrvHlpVMSetError(pThis->pDrvIns, VERR_NOT_SUPPORTED, RT_SRC_POS,
+                               N_("Multiqueue TAP devices are not supported by this build (device '%s')"), pszDevice);
+# endif
+}
+
+
+/**
+ * Checks whether the TAP device prefixes frames with a virtio-net header and
+ * tells the kernel which offloads we take on receive.
+ *
+ * @returns VBox status code.
+ * @param   pThis           The instance data.
+ */
+static int drvTAPLinuxSetupOffloads(PDRVTAP pThis)
+{
+    int fd = RTFileToNative(pThis->hFileDevice);
+
+    struct ifreq IfReq;
+    RT_ZERO(IfReq);
+    if (ioctl(fd, TUNGETIFF, &IfReq) != 0)
+    {
+        LogRel(("TAP#%d: TUNGETIFF failed (errno=%d), no offloads\n", pThis->pDrvIns->iInstance, errno));
+        return VINF_SUCCESS;
+    }
+    if (!(IfReq.ifr_flags & IFF_VNET_HDR))
+    {
+        LogRel(("TAP#%d: %s has no virtio-net header, no offloads\n", pThis->pDrvIns->iInstance, IfReq.ifr_name));
+        return VINF_SUCCESS;
+    }
+
+    /* The header size is a device property, make sure nobody changed it. */
+    int cbHdr = sizeof(DRVTAPVNETHDR);
+    if (ioctl(fd, TUNSETVNETHDRSZ, &cbHdr) != 0)
+        return PDMDrvHlpVMSetError(pThis->pDrvIns, VERR_HOSTIF_IOCTL, RT_SRC_POS,
+                                   N_("Failed to set the virtio-net header size of TAP device '%s'. errno=%d"),
+                                   IfReq.ifr_name, errno);
+    pThis->fVnetHdr = true;
+
+    unsigned fOffloads = pThis->fRecvOffloads ? TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 : 0;
+    if (ioctl(fd, TUNSETOFFLOAD, fOffloads) != 0)
+    {
+        LogRel(("TAP#%d: TUNSETOFFLOAD(%#x) failed (errno=%d), no receive offloads\n",
+                pThis->pDrvIns->iInstance, fOffloads, errno));
+        pThis->fRecvOffloads = false;
+        ioctl(fd, TUNSETOFFLOAD, 0);
+    }
+    LogRel(("TAP#%d: %s: virtio-net header, GSO transmit, receive offloads %s%s\n", pThis->pDrvIns->iInstance,
+            IfReq.ifr_name, pThis->fRecvOffloads ? "enabled" : "disabled",
+# ifdef IFF_MULTI_QUEUE
+            IfReq.ifr_flags & IFF_MULTI_QUEUE ? ", multiqueue" : ""
+# else
+            ""
+# endif
+            ));
+    return VINF_SUCCESS;
+}
+#endif /* RT_OS_LINUX */
+
 /* -=-=-=-=- PDMIBASE -=-=-=-=- */
 
 /**
@@ -811,7 +1247,20 @@ static DECLCALLBACK(void) drvTAPDestruct(PPDMDRVINS pDrvIns)
     if (pThis->pszTerminateApplication)
         drvTAPTerminateApplication(pThis);
 
-#endif  /* RT_OS_SOLARIS */
+#else  /* !RT_OS_SOLARIS */
+    /* The handle normally belongs to Main, except for additional queues. */
+    if (pThis->fOwnFileDevice && pThis->hFileDevice != NIL_RTFILE)
+    {
+        rc = RTFileClose(pThis->hFileDevice); AssertRC(rc);
+        pThis->hFileDevice = NIL_RTFILE;
+    }
+#endif /* !RT_OS_SOLARIS */
+
+    if (pThis->pbRecvBuf)
+    {
+        RTMemFree(pThis->pbRecvBuf);
+        pThis->pbRecvBuf = NULL;
+    }
 
 #ifdef RT_OS_SOLARIS
     if (!pThis->fStatic)
@@ -841,6 +1290,10 @@ static DECLCALLBACK(void) drvTAPDestruct(PPDMDRVINS pDrvIns)
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatPktSentBytes);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatPktRecv);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatPktRecvBytes);
+    PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatPktSentGso);
+    PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatPktRecvGso);
+    PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatPktRecvGsoSegmented);
+    PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatPktRecvDropped);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatTransmit);
     PDMDrvHlpSTAMDeregister(pDrvIns, &pThis->StatReceive);
 #endif /* VBOX_WITH_STATISTICS */
@@ -863,6 +1316,10 @@ static DECLCALLBACK(int) drvTAPConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
      */
     pThis->pDrvIns                      = pDrvIns;
     pThis->hFileDevice                  = NIL_RTFILE;
+    pThis->fOwnFileDevice               = false;
+    pThis->fVnetHdr                     = false;
+    pThis->fRecvOffloads                = false;
+    pThis->pbRecvBuf                    = NULL;
     pThis->hPipeWrite                   = NIL_RTPIPE;
     pThis->hPipeRead                    = NIL_RTPIPE;
     pThis->pszDeviceName                = NULL;
@@ -892,6 +1349,10 @@ static DECLCALLBACK(int) drvTAPConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatPktSentBytes,  STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,             "Number of sent bytes.",            "/Drivers/TAP%d/Bytes/Sent", pDrvIns->iInstance);
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatPktRecv,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,        "Number of received packets.",      "/Drivers/TAP%d/Packets/Received", pDrvIns->iInstance);
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatPktRecvBytes,  STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,             "Number of received bytes.",        "/Drivers/TAP%d/Bytes/Received", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatPktSentGso,    STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,        "GSO frames passed to the host.",   "/Drivers/TAP%d/Packets/SentGso", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatPktRecvGso,    STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,        "GSO frames from the host.",        "/Drivers/TAP%d/Packets/ReceivedGso", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatPktRecvGsoSegmented, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,  "GSO frames from the host we segmented.", "/Drivers/TAP%d/Packets/ReceivedGsoSegmented", pDrvIns->iInstance);
+    PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatPktRecvDropped, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,   "Received frames dropped.",         "/Drivers/TAP%d/Packets/ReceivedDropped", pDrvIns->iInstance);
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatTransmit,      STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_CALL,    "Profiling packet transmit runs.",  "/Drivers/TAP%d/Transmit", pDrvIns->iInstance);
     PDMDrvHlpSTAMRegisterF(pDrvIns, &pThis->StatReceive,       STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_CALL,    "Profiling packet receive runs.",   "/Drivers/TAP%d/Receive", pDrvIns->iInstance);
 #endif /* VBOX_WITH_STATISTICS */
@@ -899,7 +1360,8 @@ static DECLCALLBACK(int) drvTAPConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
     /*
      * Validate the config.
      */
-    if (!CFGMR3AreValuesValid(pCfg, "Device\0InitProg\0TermProg\0FileHandle\0TAPSetupApplication\0TAPTerminateApplication\0MAC"))
+    if (!CFGMR3AreValuesValid(pCfg, "Device\0InitProg\0TermProg\0FileHandle\0TAPSetupApplication\0TAPTerminateApplication\0MAC\0"
+                                    "ReceiveOffloads\0"))
         return PDMDRV_SET_ERROR(pDrvIns, VERR_PDM_DRVINS_UNKNOWN_CFG_VALUES, "");
 
     /*
@@ -966,15 +1428,40 @@ static DECLCALLBACK(int) drvTAPConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
 
     uint64_t u64File;
     rc = CFGMR3QueryU64(pCfg, "FileHandle", &u64File);
-    if (RT_FAILURE(rc))
-        return PDMDRV_SET_ERROR(pDrvIns, rc,
-                                N_("Configuration error: Query for \"FileHandle\" 32-bit signed integer failed"));
-    pThis->hFileDevice = (RTFILE)(uintptr_t)u64File;
-    if (!RTFileIsValid(pThis->hFileDevice))
-        return PDMDrvHlpVMSetError(pDrvIns, VERR_INVALID_HANDLE, RT_SRC_POS,
-                                   N_("The TAP file handle %RTfile is not valid"), pThis->hFileDevice);
+# ifdef RT_OS_LINUX
+    if (rc == VERR_CFGM_VALUE_NOT_FOUND)
+    {
+        /*
+         * No handle from Main, we're serving an additional queue pair of the
+         * adapter and open our own queue of the (multiqueue) TAP device.
+         */
+        char szDevice[IFNAMSIZ];
+        rc = CFGMR3QueryString(pCfg, "Device", szDevice, sizeof(szDevice));
+        if (RT_FAILURE(rc))
+            return PDMDRV_SET_ERROR(pDrvIns, rc,
+                                    N_("Configuration error: Neither \"FileHandle\" nor \"Device\" is configured"));
+        rc = drvTAPLinuxOpenQueue(pThis, szDevice);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+    else
+# endif
+    {
+        if (RT_FAILURE(rc))
+            return PDMDRV_SET_ERROR(pDrvIns, rc,
+                                    N_("Configuration error: Query for \"FileHandle\" 32-bit signed integer failed"));
+        pThis->hFileDevice = (RTFILE)(uintptr_t)u64File;
+        if (!RTFileIsValid(pThis->hFileDevice))
+            return PDMDrvHlpVMSetError(pDrvIns, VERR_INVALID_HANDLE, RT_SRC_POS,
+                                       N_("The TAP file handle %RTfile is not valid"), pThis->hFileDevice);
+    }
 #endif /* !RT_OS_SOLARIS */
 
+    /* Whether to let the host kernel pass us GSO and partially checksummed frames (Linux only). */
+    rc = CFGMR3QueryBoolDef(pCfg, "ReceiveOffloads", &pThis->fRecvOffloads, true);
+    if (RT_FAILURE(rc))
+        return PDMDRV_SET_ERROR(pDrvIns, rc, N_("Configuration error: failed to query \"ReceiveOffloads\""));
+
     /*
      * Create the transmit lock.
      */
@@ -992,7 +1479,22 @@ static DECLCALLBACK(int) drvTAPConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, uin
                                    N_("Configuration error: Failed to configure /dev/net/tun. errno=%d"), errno);
     /** @todo determine device name. This can be done by reading the link /proc/<pid>/fd/<fd> */
     Log(("drvTAPContruct: %d (from fd)\n", (intptr_t)pThis->hFileDevice));
-    rc = VINF_SUCCESS;
+
+#ifdef RT_OS_LINUX
+    rc = drvTAPLinuxSetupOffloads(pThis);
+    if (RT_FAILURE(rc))
+        return rc;
+#endif
+    if (!pThis->fVnetHdr)
+        pThis->fRecvOffloads = false;
+
+    /*
+     * Allocate the receive buffer, large enough for a GSO frame when the host may send us those.
+     */
+    pThis->cbRecvBuf = pThis->fRecvOffloads ? DRVTAP_RECV_BUF_SIZE_GSO : DRVTAP_RECV_BUF_SIZE;
+    pThis->pbRecvBuf = (uint8_t *)RTMemAlloc(pThis->cbRecvBuf);
+    if (!pThis->pbRecvBuf)
+        return VERR_NO_MEMORY;
 
     /*
      * Create the control pipe.
@@ -65,6 +65,19 @@
 /** The wakeup bit in the INTNETIF::cBusy and INTNETRUNKIF::cBusy counters. */
 #define INTNET_BUSY_WAKEUP_MASK     RT_BIT_32(30)
 
+/** The number of hash buckets in the MAC address table (power of two).
+ * An extra bucket following these is used for the dummy addresses. */
+#define INTNET_MACTAB_HASH_SIZE     256
+/** The index of the MAC address table hash bucket holding the dummy addresses. */
+#define INTNET_MACTAB_HASH_DUMMY    INTNET_MACTAB_HASH_SIZE
+/** NIL index for the MAC address table hash chains. */
+#define INTNET_MACTAB_HASH_NIL      UINT32_MAX
+
+/** The max number of destination interfaces which wakeup can be deferred for
+ * while processing the send ring of an interface.  When exceeded, the
+ * destination is signalled right away. */
+#define INTNET_SIGNAL_BATCH_MAX     32
+
 
 /*********************************************************************************************************************************
 *   Structures and Typedefs                                                                                                      *
@@ -85,6 +98,9 @@ typedef struct INTNETMACTABENTRY
      * to this interface onto the trunk.  The reasoning for this is that this could
      * be the interface of a VM that just has been teleported to a different host. */
     bool                    fActive;
+    /** Index of the next entry in the same hash bucket,
+     * INTNET_MACTAB_HASH_NIL if last. */
+    uint32_t                iHashNext;
     /** Pointer to the network interface. */
     struct INTNETIF        *pIf;
 } INTNETMACTABENTRY;
@@ -105,6 +121,10 @@ typedef struct INTNETMACTAB
     uint32_t                cEntriesAllocated;
     /** Table entries. */
     PINTNETMACTABENTRY      paEntries;
+    /** Hash bucket heads indexing paEntries by MAC address, see
+     * intnetR0MacTabHash.  The entries are chained via
+     * INTNETMACTABENTRY::iHashNext. */
+    uint32_t                aiHashHeads[INTNET_MACTAB_HASH_SIZE + 1];
 
     /** The number of interface entries currently in promicuous mode. */
     uint32_t                cPromiscuousEntries;
@@ -270,6 +290,15 @@ typedef struct INTNETIF
     PINTNETDSTTAB volatile  pDstTab;
     /** Pointer to the trunk's per interface data.  Can be NULL. */
     void                   *pvIfData;
+    /** Set while IntNetR0IfSend is processing the send ring and the wakeup of
+     * the destination interfaces is being deferred till the end of the batch.
+     * Only accessed by the sending thread. */
+    bool                    fBatchSignals;
+    /** The number of entries in apSignalPending. */
+    uint32_t                cSignalPending;
+    /** Destination interfaces (busy referenced) which have received frames from
+     * this interface during the current batch and needs waking up. */
+    struct INTNETIF        *apSignalPending[INTNET_SIGNAL_BATCH_MAX];
     /** Header buffer for when we're carving GSO frames. */
     uint8_t                 abGsoHdrs[256];
 } INTNETIF;
@@ -855,27 +884,6 @@ DECL_FORCE_INLINE(bool) intnetR0IfHasMacAddr(PINTNETIF pIf)
 }
 
 
-/**
- * Locates the MAC address table entry for the given interface.
- *
- * The caller holds the MAC address table spinlock, obviously.
- *
- * @returns Pointer to the entry on if found, NULL if not.
- * @param   pNetwork        The network.
- * @param   pIf             The interface.
- */
-DECLINLINE(PINTNETMACTABENTRY) intnetR0NetworkFindMacAddrEntry(PINTNETNETWORK pNetwork, PINTNETIF pIf)
-{
-    uint32_t iIf = pNetwork->MacTab.cEntries;
-    while (iIf-- > 0)
-    {
-        if (pNetwork->MacTab.paEntries[iIf].pIf == pIf)
-            return &pNetwork->MacTab.paEntries[iIf];
-    }
-    return NULL;
-}
-
-
 /**
  * Checks if the IPv6 address is a good interface address.
  * @returns true/false.
@@ -1662,6 +1670,112 @@ DECL_FORCE_INLINE(bool) intnetR0AreMacAddrsEqual(PCRTMAC pDstAddr1, PCRTMAC pDst
 }
 
 
+/**
+ * Calculates the MAC address table hash bucket for a MAC address.
+ *
+ * @returns Bucket index.  INTNET_MACTAB_HASH_DUMMY for dummy addresses.
+ * @param   pMacAddr            The address.
+ */
+DECL_FORCE_INLINE(uint32_t) intnetR0MacTabHash(PCRTMAC pMacAddr)
+{
+    if (intnetR0IsMacAddrDummy(pMacAddr))
+        return INTNET_MACTAB_HASH_DUMMY;
+
+    /* The OUI is usually the same for all the interfaces on a network, so the
+       last three bytes does most of the work here. */
+    uint32_t uHash = pMacAddr->au8[5]
+                   ^ ((uint32_t)pMacAddr->au8[4] << 3)
+                   ^ ((uint32_t)pMacAddr->au8[3] << 6)
+                   ^ pMacAddr->au8[2];
+    return (uHash ^ (uHash >> 8)) & (INTNET_MACTAB_HASH_SIZE - 1);
+}
+
+
+/**
+ * Rebuilds the hash chains of the MAC address table.
+ *
+ * This is done whenever entries are added, removed or change their address,
+ * which is rare compared to the lookups done when switching frames.
+ *
+ * The caller holds the MAC address table spinlock.
+ *
+ * @param   pTab            The MAC address table.
+ */
+static void intnetR0MacTabRehash(PINTNETMACTAB pTab)
+{
+    for (uint32_t iBucket = 0; iBucket < RT_ELEMENTS(pTab->aiHashHeads); iBucket++)
+        pTab->aiHashHeads[iBucket] = INTNET_MACTAB_HASH_NIL;
+
+    /* Pushing onto the chain heads makes the chains list the most recently
+       added entries first, same as the linear scans. */
+    for (uint32_t iEntry = 0; iEntry < pTab->cEntries; iEntry++)
+    {
+        uint32_t const iBucket = intnetR0MacTabHash(&pTab->paEntries[iEntry].MacAddr);
+        pTab->paEntries[iEntry].iHashNext = pTab->aiHashHeads[iBucket];
+        pTab->aiHashHeads[iBucket]        = iEntry;
+    }
+}
+
+
+/**
+ * Checks if the MAC address table has an active entry with the given address.
+ *
+ * The caller holds the MAC address table spinlock.
+ *
+ * @returns true if found, false if not.
+ * @param   pTab            The MAC address table.
+ * @param   pMacAddr        The address to look for.  Pass NULL to look for
+ *                          any dummy address.
+ */
+DECLINLINE(bool) intnetR0MacTabHasActiveEntry(PINTNETMACTAB pTab, PCRTMAC pMacAddr)
+{
+    uint32_t iEntry = pTab->aiHashHeads[pMacAddr ? intnetR0MacTabHash(pMacAddr) : INTNET_MACTAB_HASH_DUMMY];
+    while (iEntry != INTNET_MACTAB_HASH_NIL)
+    {
+        Assert(iEntry < pTab->cEntries);
+        if (   pTab->paEntries[iEntry].fActive
+            && (   !pMacAddr
+                || intnetR0AreMacAddrsEqual(&pTab->paEntries[iEntry].MacAddr, pMacAddr)))
+            return true;
+        iEntry = pTab->paEntries[iEntry].iHashNext;
+    }
+    return false;
+}
+
+
+/**
+ * Locates the MAC address table entry for the given interface.
+ *
+ * The caller holds the MAC address table spinlock, obviously.
+ *
+ * @returns Pointer to the entry on if found, NULL if not.
+ * @param   pNetwork        The network.
+ * @param   pIf             The interface.
+ */
+DECLINLINE(PINTNETMACTABENTRY) intnetR0NetworkFindMacAddrEntry(PINTNETNETWORK pNetwork, PINTNETIF pIf)
+{
+    /* The entry shadows the interface address, so it's normally found on the
+       hash chain of that. */
+    PINTNETMACTAB pTab = &pNetwork->MacTab;
+    uint32_t iIf = pTab->aiHashHeads[intnetR0MacTabHash(&pIf->MacAddr)];
+    while (iIf != INTNET_MACTAB_HASH_NIL)
+    {
+        Assert(iIf < pTab->cEntries);
+        if (pTab->paEntries[iIf].pIf == pIf)
+            return &pTab->paEntries[iIf];
+        iIf = pTab->paEntries[iIf].iHashNext;
+    }
+
+    iIf = pTab->cEntries;
+    while (iIf-- > 0)
+    {
+        if (pTab->paEntries[iIf].pIf == pIf)
+            return &pTab->paEntries[iIf];
+    }
+    return NULL;
+}
+
+
 /**
  * Switch a unicast frame based on the network layer address (OSI level 3) and
  * return a destination table.
@@ -1794,35 +1908,61 @@ static INTNETSWDECISION intnetR0NetworkPreSwitchUnicast(PINTNETNETWORK pNetwork,
     PINTNETMACTAB       pTab            = &pNetwork->MacTab;
     RTSpinlockAcquire(pNetwork->hAddrSpinlock);
 
-    /* Iterate the internal network interfaces and look for matching source and
-       destination addresses. */
-    uint32_t iIfMac = pTab->cEntries;
-    while (iIfMac-- > 0)
+    /* Look up the source and destination addresses in the hash table.  Active
+       interfaces with unknown addresses or the source address (paranoia - this
+       shouldn't happen, right?) means we cannot tell. */
+    if (    !intnetR0MacTabHasActiveEntry(pTab, NULL /*dummy*/)
+        &&  (   !pSrcAddr
+             || !intnetR0MacTabHasActiveEntry(pTab, pSrcAddr))
+        &&  intnetR0MacTabHasActiveEntry(pTab, pDstAddr))
+        enmSwDecision = pTab->fHostPromiscuousEff && fSrc == INTNETTRUNKDIR_WIRE
+                      ? INTNETSWDECISION_BROADCAST
+                      : INTNETSWDECISION_INTNET;
+
+    RTSpinlockRelease(pNetwork->hAddrSpinlock);
+    return enmSwDecision;
+}
+
+
+/**
+ * Worker for intnetR0NetworkSwitchUnicast that adds the active interfaces on a
+ * MAC address table hash chain having either the destination address or a
+ * dummy address to the destination table.
+ *
+ * @returns Number of exact hits.
+ * @param   pTab                The MAC address table.
+ * @param   iIfMac              The head of the hash chain.
+ * @param   pIfSender           The sender interface, NULL if trunk.
+ * @param   pDstAddr            The destination address of the frame.
+ * @param   pDstTab             The destination output table.
+ */
+DECL_FORCE_INLINE(uint32_t) intnetR0NetworkSwitchUnicastChain(PINTNETMACTAB pTab, uint32_t iIfMac, PINTNETIF pIfSender,
+                                                              PCRTMAC pDstAddr, PINTNETDSTTAB pDstTab)
+{
+    uint32_t cExactHits = 0;
+    for (; iIfMac != INTNET_MACTAB_HASH_NIL; iIfMac = pTab->paEntries[iIfMac].iHashNext)
     {
+        Assert(iIfMac < pTab->cEntries);
         if (pTab->paEntries[iIfMac].fActive)
         {
-            /* Unknown interface address? */
-            if (intnetR0IsMacAddrDummy(&pTab->paEntries[iIfMac].MacAddr))
-                break;
-
-            /* Paranoia - this shouldn't happen, right? */
-            if (    pSrcAddr
-                &&  intnetR0AreMacAddrsEqual(&pTab->paEntries[iIfMac].MacAddr, pSrcAddr))
-                break;
-
-            /* Exact match? */
-            if (intnetR0AreMacAddrsEqual(&pTab->paEntries[iIfMac].MacAddr, pDstAddr))
+            bool fExact = intnetR0AreMacAddrsEqual(&pTab->paEntries[iIfMac].MacAddr, pDstAddr);
+            if (   fExact
+                || intnetR0IsMacAddrDummy(&pTab->paEntries[iIfMac].MacAddr))
             {
-                enmSwDecision = pTab->fHostPromiscuousEff && fSrc == INTNETTRUNKDIR_WIRE
-                              ? INTNETSWDECISION_BROADCAST
-                              : INTNETSWDECISION_INTNET;
-                break;
+                cExactHits += fExact;
+
+                PINTNETIF pIf = pTab->paEntries[iIfMac].pIf;        AssertPtr(pIf);
+                if (RT_LIKELY(pIf != pIfSender)) /* paranoia */
+                {
+                    uint32_t iIfDst = pDstTab->cIfs++;
+                    pDstTab->aIfs[iIfDst].pIf            = pIf;
+                    pDstTab->aIfs[iIfDst].fReplaceDstMac = false;
+                    intnetR0BusyIncIf(pIf);
+                }
             }
         }
     }
-
-    RTSpinlockRelease(pNetwork->hAddrSpinlock);
-    return enmSwDecision;
+    return cExactHits;
 }
 
 
@@ -1854,9 +1994,19 @@ static INTNETSWDECISION intnetR0NetworkSwitchUnicast(PINTNETNETWORK pNetwork, ui
     pDstTab->pTrunk     = 0;
     pDstTab->cIfs       = 0;
 
-    /* Find exactly matching or promiscuous interfaces. */
+    /* Find exactly matching or promiscuous interfaces.  Without any
+       promiscuous interfaces, only the hash chains of the destination address
+       and the dummy addresses can contain hits. */
     uint32_t cExactHits = 0;
     uint32_t iIfMac     = pTab->cEntries;
+    if (RT_LIKELY(!pTab->cPromiscuousEntries))
+    {
+        cExactHits  = intnetR0NetworkSwitchUnicastChain(pTab, pTab->aiHashHeads[intnetR0MacTabHash(pDstAddr)],
+                                                        pIfSender, pDstAddr, pDstTab);
+        cExactHits += intnetR0NetworkSwitchUnicastChain(pTab, pTab->aiHashHeads[INTNET_MACTAB_HASH_DUMMY],
+                                                        pIfSender, pDstAddr, pDstTab);
+        iIfMac = 0;
+    }
     while (iIfMac-- > 0)
     {
         if (pTab->paEntries[iIfMac].fActive)
@@ -2823,6 +2973,70 @@ static int intnetR0RingWriteFrame(PINTNETRINGBUF pRingBuf, PCINTNETSG pSG, PCRTM
 }
 
 
+/**
+ * Wakes up the receiver of an interface after frames have been committed to
+ * its receive ring, unless it has told us that it's busy draining it.
+ *
+ * @param   pIf             The interface.
+ */
+DECLINLINE(void) intnetR0IfSignalRecv(PINTNETIF pIf)
+{
+    PINTNETBUF pIntBuf = pIf->pIntBuf;
+    if (ASMAtomicReadU32(&pIntBuf->u32RecvState) != INTNETBUF_RECV_STATE_BUSY)
+        RTSemEventSignal(pIf->hRecvEvent);
+    else
+        STAM_REL_COUNTER_INC(&pIntBuf->cStatWakeupsAvoided);
+}
+
+
+/**
+ * Defers waking up a destination interface till the sender is done with the
+ * current batch of frames.
+ *
+ * @returns true if deferred, false if the caller must signal it right away.
+ * @param   pIfSender       The interface sending the frames.
+ * @param   pIf             The destination interface.  The caller holds a busy
+ *                          reference to it.
+ */
+static bool intnetR0IfDeferSignal(PINTNETIF pIfSender, PINTNETIF pIf)
+{
+    uint32_t i = pIfSender->cSignalPending;
+    while (i-- > 0)
+        if (pIfSender->apSignalPending[i] == pIf)
+            return true;
+
+    i = pIfSender->cSignalPending;
+    if (i < RT_ELEMENTS(pIfSender->apSignalPending))
+    {
+        intnetR0BusyIncIf(pIf);
+        pIfSender->apSignalPending[i] = pIf;
+        pIfSender->cSignalPending     = i + 1;
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * Wakes up the destination interfaces which signalling was deferred by
+ * intnetR0IfDeferSignal.
+ *
+ * @param   pIfSender       The interface sending the frames.
+ */
+static void intnetR0IfFlushSignals(PINTNETIF pIfSender)
+{
+    uint32_t const cSignalPending = pIfSender->cSignalPending;
+    for (uint32_t i = 0; i < cSignalPending; i++)
+    {
+        PINTNETIF pIf = pIfSender->apSignalPending[i];
+        pIfSender->apSignalPending[i] = NULL;
+        intnetR0IfSignalRecv(pIf);
+        intnetR0BusyDecIf(pIf);
+    }
+    pIfSender->cSignalPending = 0;
+}
+
+
 /**
  * Sends a frame to a specific interface.
  *
@@ -2842,7 +3056,10 @@ static void intnetR0IfSend(PINTNETIF pIf, PINTNETIF pIfSender, PINTNETSG pSG, PC
     if (RT_SUCCESS(rc))
     {
         pIf->cYields = 0;
-        RTSemEventSignal(pIf->hRecvEvent);
+        if (   !pIfSender
+            || !pIfSender->fBatchSignals
+            || !intnetR0IfDeferSignal(pIfSender, pIf))
+            intnetR0IfSignalRecv(pIf);
         return;
     }
 
@@ -3980,6 +4197,7 @@ static INTNETSWDECISION intnetR0NetworkSend(PINTNETNETWORK pNetwork, PINTNETIF p
         if (pIfEntry)
             pIfEntry->MacAddr = EthHdr.SrcMac;
         pIfSender->MacAddr    = EthHdr.SrcMac;
+        intnetR0MacTabRehash(&pNetwork->MacTab);
 
         RTSpinlockRelease(pNetwork->hAddrSpinlock);
     }
@@ -4072,8 +4290,10 @@ INTNETR0DECL(int) IntNetR0IfSend(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession)
         if (RT_LIKELY(pDstTab))
         {
             /*
-             * Process the send buffer.
+             * Process the send buffer, waking up each of the destination
+             * interfaces once for the whole batch rather than for each frame.
              */
+            pIf->fBatchSignals = true;
             INTNETSWDECISION    enmSwDecision = INTNETSWDECISION_BROADCAST;
             INTNETSG            Sg; /** @todo this will have to be changed if we're going to use async sending
                                      * with buffer sharing for some OS or service. Darwin copies everything so
@@ -4127,6 +4347,9 @@ INTNETR0DECL(int) IntNetR0IfSend(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession)
                 IntNetRingSkipFrame(&pIf->pIntBuf->Send);
             }
 
+            pIf->fBatchSignals = false;
+            intnetR0IfFlushSignals(pIf);
+
             /*
              * Put back the destination table.
              */
@@ -4429,6 +4652,7 @@ INTNETR0DECL(int) IntNetR0IfSetMacAddress(INTNETIFHANDLE hIf, PSUPDRVSESSION pSe
                 pEntry->MacAddr = *pMac;
             pIf->MacAddr        = *pMac;
             pIf->fMacSet        = true;
+            intnetR0MacTabRehash(&pNetwork->MacTab);
 
             /* Grab a busy reference to the trunk so we release the lock before notifying it. */
             pTrunk = pNetwork->MacTab.pTrunk;
@@ -4951,6 +5175,7 @@ static DECLCALLBACK(void) intnetR0IfDestruct(void *pvObj, void *pvUser1, void *p
                             &pNetwork->MacTab.paEntries[iIf + 1],
                             (pNetwork->MacTab.cEntries - iIf - 1) * sizeof(pNetwork->MacTab.paEntries[0]));
                 pNetwork->MacTab.cEntries--;
+                intnetR0MacTabRehash(&pNetwork->MacTab);
                 break;
             }
 
@@ -5138,6 +5363,8 @@ static int intnetR0NetworkCreateIf(PINTNETNETWORK pNetwork, PSUPDRVSESSION pSess
     pIf->cBusy              = 0;
     //pIf->pDstTab          = NULL;
     //pIf->pvIfData         = NULL;
+    //pIf->fBatchSignals    = false;
+    //pIf->cSignalPending   = 0;
 
     for (int i = kIntNetAddrType_Invalid + 1; i < kIntNetAddrType_End && RT_SUCCESS(rc); i++)
         rc = intnetR0IfAddrCacheInit(&pIf->aAddrCache[i], (INTNETADDRTYPE)i,
@@ -5192,6 +5419,7 @@ static int intnetR0NetworkCreateIf(PINTNETNETWORK pNetwork, PSUPDRVSESSION pSess
                     pNetwork->MacTab.paEntries[iIf].pIf                  = pIf;
 
                     pNetwork->MacTab.cEntries = iIf + 1;
+                    intnetR0MacTabRehash(&pNetwork->MacTab);
                     pIf->pNetwork = pNetwork;
 
                     /*
@@ -6089,6 +6317,7 @@ static DECLCALLBACK(void) intnetR0NetworkDestruct(void *pvObj, void *pvUser1, vo
         {
             pIf->pNetwork = NULL;
             pNetwork->MacTab.cEntries--;
+            intnetR0MacTabRehash(&pNetwork->MacTab);
         }
     }
 
@@ -6512,7 +6741,9 @@ static int intnetR0CreateNetwork(PINTNET pIntNet, PSUPDRVSESSION pSession, const
     if (RT_SUCCESS(rc))
     {
         pNetwork->MacTab.paEntries = (PINTNETMACTABENTRY)RTMemAlloc(sizeof(INTNETMACTABENTRY) * pNetwork->MacTab.cEntriesAllocated);
-        if (!pNetwork->MacTab.paEntries)
+        if (pNetwork->MacTab.paEntries)
+            intnetR0MacTabRehash(&pNetwork->MacTab);
+        else
             rc = VERR_NO_MEMORY;
     }
     if (RT_SUCCESS(rc))
@@ -6642,6 +6873,8 @@ INTNETR0DECL(int) IntNetR0Open(PSUPDRVSESSION pSession, const char *pszNetwork,
     }
 
     AssertMsgReturn(!(fFlags & ~INTNET_OPEN_FLAGS_MASK), ("%#x\n", fFlags), VERR_INVALID_PARAMETER);
+    AssertMsgReturn(cbSend <= INTNET_MAX_RING_SIZE, ("%#x\n", cbSend), VERR_OUT_OF_RANGE);
+    AssertMsgReturn(cbRecv <= INTNET_MAX_RING_SIZE, ("%#x\n", cbRecv), VERR_OUT_OF_RANGE);
     for (uint32_t i = 0; i < RT_ELEMENTS(g_afIntNetOpenNetworkNetFlags); i++)
         AssertMsgReturn((fFlags & g_afIntNetOpenNetworkNetFlags[i].fPair) != g_afIntNetOpenNetworkNetFlags[i].fPair,
                         ("%#x (%#x)\n", fFlags, g_afIntNetOpenNetworkNetFlags[i].fPair), VERR_INVALID_PARAMETER);
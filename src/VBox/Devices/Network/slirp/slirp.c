@@ -1984,16 +1984,18 @@ void slirp_info(PNATState pData, const void *pvArg, const char *pszArgs)
     NOREF(pszArgs);
 
     pHlp->pfnPrintf(pHlp, "NAT parameters: MTU=%d\n", if_mtu);
-    pHlp->pfnPrintf(pHlp, "NAT TCP ports:\n");
+    pHlp->pfnPrintf(pHlp, "NAT TCP ports (rx/tx are bytes/calls):\n");
     QSOCKET_FOREACH(so, so_next, tcp)
     /* { */
-        pHlp->pfnPrintf(pHlp, " %R[natsock]\n", so);
+        pHlp->pfnPrintf(pHlp, " %R[natsock] rx=%RU64/%u tx=%RU64/%u\n", so,
+                        so->so_cbRx, so->so_cRx, so->so_cbTx, so->so_cTx);
     }
 
-    pHlp->pfnPrintf(pHlp, "NAT UDP ports:\n");
+    pHlp->pfnPrintf(pHlp, "NAT UDP ports (rx/tx are bytes/datagrams):\n");
     QSOCKET_FOREACH(so, so_next, udp)
     /* { */
-        pHlp->pfnPrintf(pHlp, " %R[natsock]\n", so);
+        pHlp->pfnPrintf(pHlp, " %R[natsock] rx=%RU64/%u tx=%RU64/%u\n", so,
+                        so->so_cbRx, so->so_cRx, so->so_cbTx, so->so_cTx);
     }
 
     pHlp->pfnPrintf(pHlp, "NAT ARP cache:\n");
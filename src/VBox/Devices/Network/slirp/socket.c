@@ -346,7 +346,11 @@ soread(PNATState pData, struct socket *so)
     if (nn < 0)
         sockerr = errno; /* save it, as it may be clobbered by logging */
     else
+    {
         sockerr = 0;
+        so->so_cbRx += nn;
+        so->so_cRx++;
+    }
 
     Log2(("%s: read(1) nn = %d bytes\n", RT_GCC_EXTENSION __PRETTY_FUNCTION__, nn));
     Log2(("%s: so = %R[natsock] so->so_snd = %R[sbuf]\n", RT_GCC_EXTENSION __PRETTY_FUNCTION__, so, sb));
@@ -662,6 +666,11 @@ sowrite(PNATState pData, struct socket *so)
     nn = send(so->s, iov[0].iov_base, iov[0].iov_len, 0);
 #endif
     Log2(("%s: wrote(1) nn = %d bytes\n", RT_GCC_EXTENSION __PRETTY_FUNCTION__, nn));
+    if (nn > 0)
+    {
+        so->so_cbTx += nn;
+        so->so_cTx++;
+    }
     /* This should never happen, but people tell me it does *shrug* */
     if (   nn < 0
         && soIgnorableErrorCode(errno))
@@ -751,122 +760,138 @@ sorecvfrom(PNATState pData, struct socket *so)
         struct iovec iov[2];
         ssize_t nread;
         struct mbuf *m;
+        int cDatagrams;
+        bool fDnsProxy;
 
         QSOCKET_LOCK(udb);
         SOCKET_LOCK(so);
         QSOCKET_UNLOCK(udb);
 
-        m = m_getjcl(pData, M_NOWAIT, MT_HEADER, M_PKTHDR, slirp_size(pData));
-        if (m == NULL)
+        /*
+         * The socket is non-blocking, so keep reading datagrams until it
+         * runs dry (or the batch limit is hit) instead of going back to
+         * poll() for each of them.  DNS proxy sockets carry a single
+         * answer and are left alone.
+         */
+        fDnsProxy =    pData->fUseDnsProxy
+                    && so->so_fport == RT_H2N_U16_C(53)
+                    && CTL_CHECK(so->so_faddr.s_addr, CTL_DNS);
+        for (cDatagrams = 0; cDatagrams < SO_UDP_RECV_BATCH && so->s != -1; cDatagrams++)
         {
-            SOCKET_UNLOCK(so);
-            return;
-        }
+            addrlen = sizeof(struct sockaddr_in);
+            m = m_getjcl(pData, M_NOWAIT, MT_HEADER, M_PKTHDR, slirp_size(pData));
+            if (m == NULL)
+                break;
 
-        m->m_data += ETH_HLEN;
-        m->m_pkthdr.header = mtod(m, void *);
+            m->m_data += ETH_HLEN;
+            m->m_pkthdr.header = mtod(m, void *);
 
-        m->m_data += sizeof(struct udpiphdr);
+            m->m_data += sizeof(struct udpiphdr);
 
-        /* small packets will fit without copying */
-        iov[0].iov_base = mtod(m, char *);
-        iov[0].iov_len = M_TRAILINGSPACE(m);
+            /* small packets will fit without copying */
+            iov[0].iov_base = mtod(m, char *);
+            iov[0].iov_len = M_TRAILINGSPACE(m);
 
-        /* large packets will spill into a temp buffer */
-        iov[1].iov_base = achBuf;
-        iov[1].iov_len = sizeof(achBuf);
+            /* large packets will spill into a temp buffer */
+            iov[1].iov_base = achBuf;
+            iov[1].iov_len = sizeof(achBuf);
 
 #if !defined(RT_OS_WINDOWS)
-        {
-            struct msghdr mh;
-            memset(&mh, 0, sizeof(mh));
+            {
+                struct msghdr mh;
+                memset(&mh, 0, sizeof(mh));
 
-            mh.msg_iov = iov;
-            mh.msg_iovlen = 2;
-            mh.msg_name = &addr;
-            mh.msg_namelen = addrlen;
+                mh.msg_iov = iov;
+                mh.msg_iovlen = 2;
+                mh.msg_name = &addr;
+                mh.msg_namelen = addrlen;
 
-            nread = recvmsg(so->s, &mh, 0);
-        }
+                nread = recvmsg(so->s, &mh, 0);
+            }
 #else  /* RT_OS_WINDOWS */
-        {
-            DWORD nbytes; /* NB: can't use nread b/c of different size */
-            DWORD flags = 0;
-            int status;
-            AssertCompile(sizeof(WSABUF) == sizeof(struct iovec));
-            AssertCompileMembersSameSizeAndOffset(WSABUF, len, struct iovec, iov_len);
-            AssertCompileMembersSameSizeAndOffset(WSABUF, buf, struct iovec, iov_base);
-            status = WSARecvFrom(so->s, (WSABUF *)&iov[0], 2, &nbytes, &flags,
-                                 (struct sockaddr *)&addr, &addrlen,
-                                 NULL, NULL);
-            if (status != SOCKET_ERROR)
-                nread = nbytes;
-            else
-                nread = -1;
-        }
-#endif
-        if (nread >= 0)
-        {
-            if (nread <= iov[0].iov_len)
-                m->m_len = nread;
-            else
             {
-                m->m_len = iov[0].iov_len;
-                m_append(pData, m, nread - iov[0].iov_len, iov[1].iov_base);
+                DWORD nbytes; /* NB: can't use nread b/c of different size */
+                DWORD flags = 0;
+                int status;
+                AssertCompile(sizeof(WSABUF) == sizeof(struct iovec));
+                AssertCompileMembersSameSizeAndOffset(WSABUF, len, struct iovec, iov_len);
+                AssertCompileMembersSameSizeAndOffset(WSABUF, buf, struct iovec, iov_base);
+                status = WSARecvFrom(so->s, (WSABUF *)&iov[0], 2, &nbytes, &flags,
+                                     (struct sockaddr *)&addr, &addrlen,
+                                     NULL, NULL);
+                if (status != SOCKET_ERROR)
+                    nread = nbytes;
+                else
+                    nread = -1;
             }
-            Assert(m_length(m, NULL) == (size_t)nread);
-
-            /*
-             * Hack: domain name lookup will be used the most for UDP,
-             * and since they'll only be used once there's no need
-             * for the 4 minute (or whatever) timeout... So we time them
-             * out much quicker (10 seconds  for now...)
-             */
-            if (so->so_expire)
+#endif
+            if (nread >= 0)
             {
-                if (so->so_fport != RT_H2N_U16_C(53))
-                    so->so_expire = curtime + SO_EXPIRE;
-            }
-
-            /*
-             * DNS proxy requests are forwarded to the real resolver,
-             * but its socket's so_faddr is that of the DNS proxy
-             * itself.
-             *
-             * last argument should be changed if Slirp will inject IP attributes
-             */
-            if (   pData->fUseDnsProxy
-                && so->so_fport == RT_H2N_U16_C(53)
-                && CTL_CHECK(so->so_faddr.s_addr, CTL_DNS))
-                dnsproxy_answer(pData, so, m);
-
-            /* packets definetly will be fragmented, could confuse receiver peer. */
-            if (nread > if_mtu)
-                m->m_flags |= M_SKIP_FIREWALL;
-
-            /*
-             * If this packet was destined for CTL_ADDR,
-             * make it look like that's where it came from, done by udp_output
-             */
-            udp_output(pData, so, m, &addr);
-        }
-        else
-        {
-            m_freem(pData, m);
+                if (nread <= iov[0].iov_len)
+                    m->m_len = nread;
+                else
+                {
+                    m->m_len = iov[0].iov_len;
+                    m_append(pData, m, nread - iov[0].iov_len, iov[1].iov_base);
+                }
+                Assert(m_length(m, NULL) == (size_t)nread);
+                so->so_cbRx += nread;
+                so->so_cRx++;
+
+                /*
+                 * Hack: domain name lookup will be used the most for UDP,
+                 * and since they'll only be used once there's no need
+                 * for the 4 minute (or whatever) timeout... So we time them
+                 * out much quicker (10 seconds  for now...)
+                 */
+                if (so->so_expire)
+                {
+                    if (so->so_fport != RT_H2N_U16_C(53))
+                        so->so_expire = curtime + SO_EXPIRE;
+                }
 
-            if (!soIgnorableErrorCode(errno))
+                /*
+                 * DNS proxy requests are forwarded to the real resolver,
+                 * but its socket's so_faddr is that of the DNS proxy
+                 * itself.
+                 *
+                 * last argument should be changed if Slirp will inject IP attributes
+                 */
+                if (fDnsProxy)
+                    dnsproxy_answer(pData, so, m);
+
+                /* packets definetly will be fragmented, could confuse receiver peer. */
+                if (nread > if_mtu)
+                    m->m_flags |= M_SKIP_FIREWALL;
+
+                /*
+                 * If this packet was destined for CTL_ADDR,
+                 * make it look like that's where it came from, done by udp_output
+                 */
+                udp_output(pData, so, m, &addr);
+                if (fDnsProxy)
+                    break;
+            }
+            else
             {
-                u_char code;
-                if (errno == EHOSTUNREACH)
-                    code = ICMP_UNREACH_HOST;
-                else if (errno == ENETUNREACH)
-                    code = ICMP_UNREACH_NET;
-                else
-                    code = ICMP_UNREACH_PORT;
+                m_freem(pData, m);
 
-                Log2((" rx error, tx icmp ICMP_UNREACH:%i\n", code));
-                icmp_error(pData, so->so_m, ICMP_UNREACH, code, 0, strerror(errno));
-                so->so_m = NULL;
+                /* Running dry after the first datagram is the normal way out. */
+                if (!soIgnorableErrorCode(errno))
+                {
+                    u_char code;
+                    if (errno == EHOSTUNREACH)
+                        code = ICMP_UNREACH_HOST;
+                    else if (errno == ENETUNREACH)
+                        code = ICMP_UNREACH_NET;
+                    else
+                        code = ICMP_UNREACH_PORT;
+
+                    Log2((" rx error, tx icmp ICMP_UNREACH:%i\n", code));
+                    icmp_error(pData, so->so_m, ICMP_UNREACH, code, 0, strerror(errno));
+                    so->so_m = NULL;
+                }
+                break;
             }
         }
 
@@ -966,6 +991,8 @@ sosendto(PNATState pData, struct socket *so, struct mbuf *m)
         Log2(("UDP: sendto fails (%s)\n", strerror(errno)));
         return -1;
     }
+    so->so_cbTx += ret;
+    so->so_cTx++;
 
     /*
      * Kill the socket if there's no reply in 4 minutes,
@@ -32,6 +32,10 @@
 #define SO_EXPIRE 240000
 #define SO_EXPIREFAST 10000
 
+/* Maximum number of datagrams sorecvfrom() drains from a UDP socket per
+ * poll readiness notification. */
+#define SO_UDP_RECV_BATCH 32
+
 /*
  * Our socket structure
  */
@@ -119,6 +123,12 @@ struct socket
      *  alter value ''fShouldBeRemoved'' to 1, else we do removal.
      */
     int fShouldBeRemoved;
+
+    /* Per connection traffic counters, shown by the NAT info handler. */
+    uint64_t        so_cbRx;     /* bytes received from the host socket */
+    uint64_t        so_cbTx;     /* bytes sent to the host socket */
+    uint32_t        so_cRx;      /* successful receive calls (datagrams for UDP) */
+    uint32_t        so_cTx;      /* successful send calls (datagrams for UDP) */
 };
 
 # define SOCKET_LOCK(so) do {} while (0)
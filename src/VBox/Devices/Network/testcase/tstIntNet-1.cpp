@@ -596,6 +596,239 @@ static void doPacketSniffing(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession, PINTNE
                  g_cOtherPkts, g_cArpPkts, g_cIpv4Pkts, g_cTcpPkts, g_cUdpPkts, g_cDhcpPkts);
 }
 
+
+/**
+ * Per port data for doManyPortsBenchmark.
+ */
+typedef struct TSTINTNETBENCHPORT
+{
+    /** The interface handle. */
+    INTNETIFHANDLE  hIf;
+    /** The shared interface buffer. */
+    PINTNETBUF      pBuf;
+    /** The MAC address of the port. */
+    RTMAC           Mac;
+    /** Number of frames received. */
+    uint64_t        cFramesRecv;
+} TSTINTNETBENCHPORT;
+
+
+/**
+ * Closes an interface opened by doManyPortsBenchmark.
+ *
+ * @param   hIf             The interface handle.
+ * @param   pSession        The session.
+ */
+static void doBenchClose(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession)
+{
+    INTNETIFCLOSEREQ CloseReq;
+    CloseReq.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
+    CloseReq.Hdr.cbReq = sizeof(CloseReq);
+    CloseReq.pSession = pSession;
+    CloseReq.hIf = hIf;
+    int rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_INTNET_IF_CLOSE, 0, &CloseReq.Hdr);
+    if (RT_FAILURE(rc))
+    {
+        RTPrintf("tstIntNet-1: SUPR3CallVMMR0Ex(,VMMR0_DO_INTNET_IF_CLOSE,) failed, rc=%Rrc\n", rc);
+        g_cErrors++;
+    }
+}
+
+
+/**
+ * Does the many ports throughput benchmark.
+ *
+ * Connects @a cPorts additional interfaces to the network and blasts small
+ * unicast frames at them round-robin from the main interface, filling up the
+ * send ring before each send request.  This exercises the MAC address lookup
+ * and the per batch receiver wakeups of the switch.
+ *
+ * @param   hIf             The interface handle.
+ * @param   pSession        The session.
+ * @param   pBuf            The shared interface buffer.
+ * @param   pSrcMac         The mac address to use as source.
+ * @param   pOpenReq        The open request used for the main interface.
+ * @param   cPorts          The number of ports to connect.
+ * @param   cMillies        How long to run the benchmark.
+ */
+static void doManyPortsBenchmark(INTNETIFHANDLE hIf, PSUPDRVSESSION pSession, PINTNETBUF pBuf, PCRTMAC pSrcMac,
+                                 INTNETOPENREQ const *pOpenReq, uint32_t cPorts, uint32_t cMillies)
+{
+    TSTINTNETBENCHPORT *paPorts = (TSTINTNETBENCHPORT *)RTMemAllocZ(sizeof(paPorts[0]) * cPorts);
+    if (!paPorts)
+    {
+        RTPrintf("tstIntNet-1: Out of memory allocating %u ports\n", cPorts);
+        g_cErrors++;
+        return;
+    }
+
+    /*
+     * Connect the ports, giving each an unique address.
+     */
+    int      rc = VINF_SUCCESS;
+    uint32_t iPort;
+    for (iPort = 0; iPort < cPorts && RT_SUCCESS(rc); iPort++)
+    {
+        INTNETOPENREQ OpenReq = *pOpenReq;
+        OpenReq.hIf = INTNET_HANDLE_INVALID;
+        rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_INTNET_OPEN, 0, &OpenReq.Hdr);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("tstIntNet-1: SUPR3CallVMMR0Ex(,VMMR0_DO_INTNET_OPEN,) failed for port #%u, rc=%Rrc\n", iPort, rc);
+            break;
+        }
+        paPorts[iPort].hIf = OpenReq.hIf;
+
+        INTNETIFGETBUFFERPTRSREQ GetBufferPtrsReq;
+        GetBufferPtrsReq.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
+        GetBufferPtrsReq.Hdr.cbReq = sizeof(GetBufferPtrsReq);
+        GetBufferPtrsReq.pSession = pSession;
+        GetBufferPtrsReq.hIf = OpenReq.hIf;
+        GetBufferPtrsReq.pRing3Buf = NULL;
+        GetBufferPtrsReq.pRing0Buf = NIL_RTR0PTR;
+        rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_INTNET_IF_GET_BUFFER_PTRS, 0, &GetBufferPtrsReq.Hdr);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("tstIntNet-1: SUPR3CallVMMR0Ex(,VMMR0_DO_INTNET_IF_GET_BUFFER_PTRS,) failed for port #%u, rc=%Rrc\n", iPort, rc);
+            iPort++;
+            break;
+        }
+        paPorts[iPort].pBuf = GetBufferPtrsReq.pRing3Buf;
+
+        paPorts[iPort].Mac = *pSrcMac;
+        paPorts[iPort].Mac.au8[3] = 0xbe;
+        paPorts[iPort].Mac.au8[4] = (uint8_t)(iPort >> 8);
+        paPorts[iPort].Mac.au8[5] = (uint8_t)iPort;
+
+        INTNETIFSETMACADDRESSREQ MacReq;
+        MacReq.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
+        MacReq.Hdr.cbReq = sizeof(MacReq);
+        MacReq.pSession = pSession;
+        MacReq.hIf = OpenReq.hIf;
+        MacReq.Mac = paPorts[iPort].Mac;
+        rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_INTNET_IF_SET_MAC_ADDRESS, 0, &MacReq.Hdr);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("tstIntNet-1: SUPR3CallVMMR0Ex(,VMMR0_DO_INTNET_IF_SET_MAC_ADDRESS,) failed for port #%u, rc=%Rrc\n", iPort, rc);
+            iPort++;
+            break;
+        }
+
+        INTNETIFSETACTIVEREQ ActiveReq;
+        ActiveReq.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
+        ActiveReq.Hdr.cbReq = sizeof(ActiveReq);
+        ActiveReq.pSession = pSession;
+        ActiveReq.hIf = OpenReq.hIf;
+        ActiveReq.fActive = true;
+        rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_INTNET_IF_SET_ACTIVE, 0, &ActiveReq.Hdr);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf("tstIntNet-1: SUPR3CallVMMR0Ex(,VMMR0_DO_INTNET_IF_SET_ACTIVE,) failed for port #%u, rc=%Rrc\n", iPort, rc);
+            iPort++;
+            break;
+        }
+    }
+    uint32_t const cPortsOpen = iPort;
+
+    if (RT_SUCCESS(rc))
+    {
+        /*
+         * The frame template, a minimum sized frame with a local experimental
+         * ethertype so nobody will try make sense of it.
+         */
+        uint8_t         abFrame[60];
+        PRTNETETHERHDR  pEthHdr = (PRTNETETHERHDR)&abFrame[0];
+        memset(abFrame, 0, sizeof(abFrame));
+        pEthHdr->SrcMac = *pSrcMac;
+        pEthHdr->EtherType = RT_H2BE_U16(0x88b5);
+
+        INTNETIFSENDREQ SendReq;
+        SendReq.Hdr.u32Magic = SUPVMMR0REQHDR_MAGIC;
+        SendReq.Hdr.cbReq = sizeof(SendReq);
+        SendReq.pSession = pSession;
+        SendReq.hIf = hIf;
+
+        /*
+         * The loop.
+         */
+        uint64_t cFramesSent = 0;
+        uint64_t cSendReqs   = 0;
+        iPort = 0;
+        uint64_t const u64Start = RTTimeNanoTS();
+        uint64_t       cNsElapsed;
+        do
+        {
+            /* Fill the send ring. */
+            for (;;)
+            {
+                pEthHdr->DstMac = paPorts[iPort].Mac;
+                if (RT_FAILURE(IntNetRingWriteFrame(&pBuf->Send, abFrame, sizeof(abFrame))))
+                    break;
+                cFramesSent++;
+                if (++iPort >= cPorts)
+                    iPort = 0;
+            }
+
+            rc = SUPR3CallVMMR0Ex(NIL_RTR0PTR, NIL_VMCPUID, VMMR0_DO_INTNET_IF_SEND, 0, &SendReq.Hdr);
+            if (RT_FAILURE(rc))
+            {
+                RTPrintf("tstIntNet-1: SUPR3CallVMMR0Ex(,VMMR0_DO_INTNET_IF_SEND,) failed, rc=%Rrc\n", rc);
+                g_cErrors++;
+                break;
+            }
+            cSendReqs++;
+
+            /* Drain the receive rings of the ports. */
+            for (uint32_t i = 0; i < cPorts; i++)
+            {
+                PINTNETRINGBUF pRingBuf = &paPorts[i].pBuf->Recv;
+                while (IntNetRingHasMoreToRead(pRingBuf))
+                {
+                    IntNetRingSkipFrame(pRingBuf);
+                    paPorts[i].cFramesRecv++;
+                }
+            }
+
+            /* Drop anything coming our way. */
+            while (IntNetRingHasMoreToRead(&pBuf->Recv))
+                IntNetRingSkipFrame(&pBuf->Recv);
+
+            cNsElapsed = RTTimeNanoTS() - u64Start;
+        } while (cNsElapsed < (uint64_t)cMillies * RT_NS_1MS);
+
+        /*
+         * Report.
+         */
+        uint64_t cFramesRecv = 0;
+        uint64_t cFramesLost = 0;
+        for (uint32_t i = 0; i < cPorts; i++)
+        {
+            cFramesRecv += paPorts[i].cFramesRecv;
+            cFramesLost += paPorts[i].pBuf->cStatLost.c;
+        }
+        RTPrintf("tstIntNet-1: bench: %u ports, %RU64 ms, %RU64 send requests, %RU64 frames sent, %RU64 received, %RU64 lost\n",
+                 cPorts, cNsElapsed / RT_NS_1MS, cSendReqs, cFramesSent, cFramesRecv, cFramesLost);
+        RTPrintf("tstIntNet-1: bench: %RU64 frames/s, %RU64 ns/frame\n",
+                 cNsElapsed ? cFramesSent * RT_NS_1SEC / cNsElapsed : 0,
+                 cFramesSent ? cNsElapsed / cFramesSent : 0);
+        if (cFramesRecv + cFramesLost < cFramesSent)
+        {
+            RTPrintf("tstIntNet-1: Error! Received + lost frames (%RU64) is less than the number sent (%RU64)\n",
+                     cFramesRecv + cFramesLost, cFramesSent);
+            g_cErrors++;
+        }
+    }
+    else
+        g_cErrors++;
+
+    /*
+     * Disconnect the ports.
+     */
+    for (iPort = 0; iPort < cPortsOpen; iPort++)
+        doBenchClose(paPorts[iPort].hIf, pSession);
+    RTMemFree(paPorts);
+}
+
 #ifdef RT_OS_LINUX
 #include <stdio.h>
 #include <net/if.h>
@@ -671,6 +904,7 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
         { "--text-file",    't', RTGETOPT_REQ_STRING },
         { "--xmit-test",    'x', RTGETOPT_REQ_NOTHING },
         { "--ping-test",    'P', RTGETOPT_REQ_NOTHING },
+        { "--bench-ports",  'b', RTGETOPT_REQ_UINT32 },
     };
 
     uint32_t    cMillies = 1000;
@@ -699,6 +933,7 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
     PRTSTREAM   pFileText = g_pStdOut;
     bool        fXmitTest = false;
     bool        fPingTest = false;
+    uint32_t    cBenchPorts = 0;
     RTMAC       SrcMac;
     SrcMac.au8[0] = 0x08;
     SrcMac.au8[1] = 0x03;
@@ -795,6 +1030,15 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                 fPingTest = true;
                 break;
 
+            case 'b':
+                cBenchPorts = Value.u32;
+                if (cBenchPorts > _1K)
+                {
+                    RTPrintf("tstIntNet-1: Too many benchmark ports (max %u): %u\n", _1K, cBenchPorts);
+                    return 1;
+                }
+                break;
+
             case 'h':
                 RTPrintf("syntax: tstIntNet-1 <options>\n"
                          "\n"
@@ -804,7 +1048,8 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                 RTPrintf("\n"
                          "Examples:\n"
                          "    tstIntNet-1 -r 8192 -s 4096 -xS\n"
-                         "    tstIntNet-1 -n VBoxNetDhcp -r 4096 -s 4096 -i \"\" -xS\n");
+                         "    tstIntNet-1 -n VBoxNetDhcp -r 4096 -s 4096 -i \"\" -xS\n"
+                         "    tstIntNet-1 -n tstIntNet-1-bench -i \"\" -b 256 -d 10\n");
                 return 1;
 
             case 'V':
@@ -942,9 +1187,11 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                         doPingTest(OpenReq.hIf, pSession, pBuf, &SrcMac, pFileRaw, pFileText);
 
                     /*
-                     * Either enter sniffing mode or do a timeout thing.
+                     * Either run the benchmark, enter sniffing mode or do a timeout thing.
                      */
-                    if (fSniffer)
+                    if (cBenchPorts)
+                        doManyPortsBenchmark(OpenReq.hIf, pSession, pBuf, &SrcMac, &OpenReq, cBenchPorts, cMillies);
+                    else if (fSniffer)
                     {
                         doPacketSniffing(OpenReq.hIf, pSession, pBuf, cMillies, pFileRaw, pFileText, &SrcMac);
                         if (   fXmitTest
@@ -86,6 +86,9 @@ enum
 /* Maximum supported number of custom ACPI tables */
 #define MAX_CUST_TABLES 4
 
+/* Maximum number of NUMA nodes (proximity domains) described in the SRAT */
+#define MAX_NUMA_NODES  VMM_MAX_NUMA_NODES
+
 /* Undef this to enable 24 bit PM timer (mostly for debugging purposes) */
 #define PM_TMR_32BIT
 
@@ -366,6 +369,8 @@ typedef struct ACPIState
     bool                fUseMcfg;
     /** if the 64-bit prefetchable memory window is shown to the guest */
     bool                fPciPref64Enabled;
+    /** Number of NUMA nodes described by SRAT and SLIT, 0 or 1 if none. */
+    uint8_t             cNumaNodes;
     /** Primary NIC PCI address. */
     uint32_t            u32NicPciAddress;
     /** Primary audio card PCI address. */
@@ -760,6 +765,43 @@ AssertCompileSize(ACPITBLMCFGENTRY, 16);
 
 #define PCAT_COMPAT   0x1                       /**< system has also a dual-8259 setup */
 
+/** System Resource Affinity Table (SRAT).
+ * Followed by processor affinity structures. */
+typedef struct ACPITBLSRAT
+{
+    ACPITBLHEADER aHeader;
+    uint32_t      u32Reserved1;                 /**< must be 1 */
+    uint64_t      u64Reserved2;
+} ACPITBLSRAT;
+AssertCompileSize(ACPITBLSRAT, 48);
+
+/** SRAT Processor Local APIC Affinity Structure */
+typedef struct ACPITBLSRATLAPIC
+{
+    uint8_t       u8Type;                       /**< 0 = processor local APIC affinity */
+    uint8_t       u8Length;                     /**< 16 */
+    uint8_t       u8ProximityDomainLo;          /**< bits 7:0 of the proximity domain */
+    uint8_t       u8ApicId;                     /**< local APIC ID */
+    uint32_t      u32Flags;                     /**< flags */
+#define SRAT_LAPIC_ENABLED  RT_BIT_32(0)
+    uint8_t       u8LocalSapicEid;              /**< local SAPIC EID, 0 */
+    uint8_t       au8ProximityDomainHi[3];      /**< bits 31:8 of the proximity domain */
+    uint32_t      u32ClockDomain;               /**< clock domain, 0 */
+} ACPITBLSRATLAPIC;
+AssertCompileSize(ACPITBLSRATLAPIC, 16);
+
+/** System Locality Information Table (SLIT).
+ * Followed by the u64Localities * u64Localities distance matrix. */
+typedef struct ACPITBLSLIT
+{
+    ACPITBLHEADER aHeader;
+    uint64_t      u64Localities;                /**< number of system localities */
+} ACPITBLSLIT;
+AssertCompileSize(ACPITBLSLIT, 44);
+
+#define SLIT_DISTANCE_LOCAL  10                 /**< distance of a locality to itself */
+#define SLIT_DISTANCE_REMOTE 20                 /**< distance between different localities */
+
 /** Custom Description Table */
 struct ACPITBLCUST
 {
@@ -3089,6 +3131,102 @@ static void acpiR3SetupMcfg(ACPIState *pThis, RTGCPHYS32 GCPhysDst)
     acpiR3PhysCopy(pThis, GCPhysDst, (const uint8_t *)&tbl, sizeof(tbl));
 }
 
+/**
+ * Gets the NUMA node (proximity domain) of a VCPU.
+ *
+ * @note    Must match the distribution used by the VMM when binding the EMTs,
+ *          see vmR3NumaConfig.
+ */
+DECLINLINE(uint32_t) acpiR3NumaNodeOfCpu(ACPIState *pThis, uint32_t idCpu)
+{
+    return idCpu * pThis->cNumaNodes / pThis->cCpus;
+}
+
+/**
+ * Calculates the size of the System Resource Affinity Table (SRAT).
+ */
+DECLINLINE(uint32_t) acpiR3SratSize(ACPIState *pThis)
+{
+    return sizeof(ACPITBLSRAT) + pThis->cCpus * sizeof(ACPITBLSRATLAPIC);
+}
+
+/**
+ * Used by acpiR3PlantTables to plant the System Resource Affinity Table (SRAT)
+ * describing which NUMA node each VCPU belongs to.
+ *
+ * There are no memory affinity structures: nothing places the guest RAM of a
+ * virtual node on a particular host node, so claiming a memory layout would
+ * only mislead the guest.
+ *
+ * @returns VBox status code.
+ * @param   pThis       The ACPI instance.
+ * @param   GCPhysDst   Where to plant it.
+ */
+static int acpiR3SetupSrat(ACPIState *pThis, RTGCPHYS32 GCPhysDst)
+{
+    uint32_t const cbTbl = acpiR3SratSize(pThis);
+    uint8_t *pbTbl = (uint8_t *)RTMemAllocZ(cbTbl);
+    if (!pbTbl)
+        return VERR_NO_MEMORY;
+
+    ACPITBLSRAT *pSrat = (ACPITBLSRAT *)pbTbl;
+    acpiR3PrepareHeader(pThis, &pSrat->aHeader, "SRAT", cbTbl, 3);
+    pSrat->u32Reserved1 = RT_H2LE_U32(1);
+
+    /* One processor affinity entry per VCPU, matching the MADT LAPIC IDs. */
+    ACPITBLSRATLAPIC *pLapic = (ACPITBLSRATLAPIC *)(pSrat + 1);
+    for (uint16_t i = 0; i < pThis->cCpus; i++, pLapic++)
+    {
+        uint32_t const idNode = acpiR3NumaNodeOfCpu(pThis, i);
+        pLapic->u8Type              = 0;
+        pLapic->u8Length            = sizeof(*pLapic);
+        pLapic->u8ProximityDomainLo = (uint8_t)idNode;
+        pLapic->u8ApicId            = (uint8_t)i;
+        pLapic->u32Flags            = RT_H2LE_U32(SRAT_LAPIC_ENABLED);
+    }
+
+    pSrat->aHeader.u8Checksum = acpiR3Checksum(pbTbl, cbTbl);
+    acpiR3PhysCopy(pThis, GCPhysDst, pbTbl, cbTbl);
+    RTMemFree(pbTbl);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Calculates the size of the System Locality Information Table (SLIT).
+ */
+DECLINLINE(uint32_t) acpiR3SlitSize(ACPIState *pThis)
+{
+    return sizeof(ACPITBLSLIT) + pThis->cNumaNodes * pThis->cNumaNodes;
+}
+
+/**
+ * Used by acpiR3PlantTables to plant the System Locality Information Table
+ * (SLIT) with the relative distances between the NUMA nodes.
+ *
+ * @param   pThis       The ACPI instance.
+ * @param   GCPhysDst   Where to plant it.
+ */
+static void acpiR3SetupSlit(ACPIState *pThis, RTGCPHYS32 GCPhysDst)
+{
+    uint8_t abTbl[sizeof(ACPITBLSLIT) + MAX_NUMA_NODES * MAX_NUMA_NODES];
+    uint32_t const cNodes = pThis->cNumaNodes;
+    uint32_t const cbTbl  = acpiR3SlitSize(pThis);
+    Assert(cbTbl <= sizeof(abTbl));
+    RT_ZERO(abTbl);
+
+    ACPITBLSLIT *pSlit = (ACPITBLSLIT *)&abTbl[0];
+    acpiR3PrepareHeader(pThis, &pSlit->aHeader, "SLIT", cbTbl, 1);
+    pSlit->u64Localities = RT_H2LE_U64(cNodes);
+
+    uint8_t *pbMatrix = (uint8_t *)(pSlit + 1);
+    for (uint32_t iFrom = 0; iFrom < cNodes; iFrom++)
+        for (uint32_t iTo = 0; iTo < cNodes; iTo++)
+            pbMatrix[iFrom * cNodes + iTo] = iFrom == iTo ? SLIT_DISTANCE_LOCAL : SLIT_DISTANCE_REMOTE;
+
+    pSlit->aHeader.u8Checksum = acpiR3Checksum(abTbl, cbTbl);
+    acpiR3PhysCopy(pThis, GCPhysDst, abTbl, cbTbl);
+}
+
 /**
  * Used by acpiR3PlantTables and acpiConstruct.
  *
@@ -3160,15 +3298,19 @@ static int acpiR3PlantTables(ACPIState *pThis)
     RTGCPHYS32 GCPhysApic = 0;
     RTGCPHYS32 GCPhysSsdt = 0;
     RTGCPHYS32 GCPhysMcfg = 0;
+    RTGCPHYS32 GCPhysSrat = 0;
+    RTGCPHYS32 GCPhysSlit = 0;
     RTGCPHYS32 aGCPhysCust[MAX_CUST_TABLES] = {0};
     uint32_t   addend = 0;
-    RTGCPHYS32 aGCPhysRsdt[7 + MAX_CUST_TABLES];
-    RTGCPHYS32 aGCPhysXsdt[7 + MAX_CUST_TABLES];
+    RTGCPHYS32 aGCPhysRsdt[9 + MAX_CUST_TABLES];
+    RTGCPHYS32 aGCPhysXsdt[9 + MAX_CUST_TABLES];
     uint32_t   cAddr;
     uint32_t   iMadt  = 0;
     uint32_t   iHpet  = 0;
     uint32_t   iSsdt  = 0;
     uint32_t   iMcfg  = 0;
+    uint32_t   iSrat  = 0;
+    uint32_t   iSlit  = 0;
     uint32_t   iCust  = 0;
     size_t     cbRsdt = sizeof(ACPITBLHEADER);
     size_t     cbXsdt = sizeof(ACPITBLHEADER);
@@ -3183,6 +3325,13 @@ static int acpiR3PlantTables(ACPIState *pThis)
     if (pThis->fUseMcfg)
         iMcfg = cAddr++;        /* MCFG */
 
+    bool const fUseNuma = pThis->cNumaNodes > 1 && pThis->u8UseIOApic;
+    if (fUseNuma)
+    {
+        iSrat = cAddr++;        /* SRAT */
+        iSlit = cAddr++;        /* SLIT */
+    }
+
     if (pThis->cCustTbls > 0)
     {
         iCust = cAddr;          /* CUST */
@@ -3260,6 +3409,13 @@ static int acpiR3PlantTables(ACPIState *pThis)
         /* Assume one entry */
         GCPhysCur = RT_ALIGN_32(GCPhysCur + sizeof(ACPITBLMCFG) + sizeof(ACPITBLMCFGENTRY), 16);
     }
+    if (fUseNuma)
+    {
+        GCPhysSrat = GCPhysCur;
+        GCPhysCur = RT_ALIGN_32(GCPhysCur + acpiR3SratSize(pThis), 16);
+        GCPhysSlit = GCPhysCur;
+        GCPhysCur = RT_ALIGN_32(GCPhysCur + acpiR3SlitSize(pThis), 16);
+    }
 
     for (uint8_t i = 0; i < pThis->cCustTbls; i++)
     {
@@ -3301,6 +3457,8 @@ static int acpiR3PlantTables(ACPIState *pThis)
         Log((" HPET 0x%08X", GCPhysHpet + addend));
     if (pThis->fUseMcfg)
         Log((" MCFG 0x%08X", GCPhysMcfg + addend));
+    if (fUseNuma)
+        Log((" SRAT 0x%08X SLIT 0x%08X", GCPhysSrat + addend, GCPhysSlit + addend));
     for (uint8_t i = 0; i < pThis->cCustTbls; i++)
         Log((" CUST(%d) 0x%08X", i, aGCPhysCust[i] + addend));
     Log((" SSDT 0x%08X", GCPhysSsdt + addend));
@@ -3332,6 +3490,18 @@ static int acpiR3PlantTables(ACPIState *pThis)
         aGCPhysRsdt[iMcfg] = GCPhysMcfg + addend;
         aGCPhysXsdt[iMcfg] = GCPhysMcfg + addend;
     }
+    if (fUseNuma)
+    {
+        rc = acpiR3SetupSrat(pThis, GCPhysSrat + addend);
+        if (RT_FAILURE(rc))
+            return rc;
+        aGCPhysRsdt[iSrat] = GCPhysSrat + addend;
+        aGCPhysXsdt[iSrat] = GCPhysSrat + addend;
+        acpiR3SetupSlit(pThis, GCPhysSlit + addend);
+        aGCPhysRsdt[iSlit] = GCPhysSlit + addend;
+        aGCPhysXsdt[iSlit] = GCPhysSlit + addend;
+        LogRel(("ACPI: Planted SRAT and SLIT for %u NUMA nodes\n", pThis->cNumaNodes));
+    }
     for (uint8_t i = 0; i < pThis->cCustTbls; i++)
     {
         Assert(i < MAX_CUST_TABLES);
@@ -3667,6 +3837,7 @@ static DECLCALLBACK(int) acpiR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
                               "PowerS1Enabled\0"
                               "PowerS4Enabled\0"
                               "CpuHotPlug\0"
+                              "NumaNodes\0"
                               "AmlFilePath\0"
                               "Serial0IoPortBase\0"
                               "Serial1IoPortBase\0"
@@ -3805,6 +3976,19 @@ static DECLCALLBACK(int) acpiR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
         return PDMDEV_SET_ERROR(pDevIns, rc,
                                 N_("Configuration error: Failed to read \"CpuHotPlug\""));
 
+    /* Query the number of NUMA nodes to describe in SRAT/SLIT, Main sets this
+       to the virtual NUMA topology the VMM was configured with. */
+    uint32_t cNumaNodes;
+    rc = CFGMR3QueryU32Def(pCfg, "NumaNodes", &cNumaNodes, 1);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc,
+                                N_("Configuration error: Failed to read \"NumaNodes\""));
+    if (cNumaNodes > RT_MIN(pThis->cCpus, MAX_NUMA_NODES))
+        return PDMDevHlpVMSetError(pDevIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("Configuration error: \"NumaNodes\"=%u exceeds the CPU count or the maximum of %u"),
+                                   cNumaNodes, MAX_NUMA_NODES);
+    pThis->cNumaNodes = (uint8_t)cNumaNodes;
+
     rc = CFGMR3QueryBoolDef(pCfg, "GCEnabled", &pThis->fGCEnabled, true);
     if (RT_FAILURE(rc))
         return PDMDEV_SET_ERROR(pDevIns, rc,
@@ -0,0 +1,3860 @@
+/* $Id: DevNVMe.cpp $ */
+/** @file
+ * DevNVMe - NVM Express controller emulation.
+ */
+
+/*
+ * Copyright (C) 2019 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+/** @page pg_dev_nvme   NVMe - NVM Express Controller Emulation.
+ *
+ * This component implements an NVM Express 1.3 controller with the NVM
+ * command set.  Every LUN is exposed to the guest as a namespace, the
+ * namespace ID being the LUN plus one.
+ *
+ * Unlike the other storage controllers the guest can use many submission and
+ * completion queue pairs in parallel, usually one per virtual CPU, each
+ * completion queue having its own MSI-X vector.  The register interface is
+ * split like this:
+ *
+ *  - Submission queue tail doorbells are handled in ring-0: the new tail is
+ *    recorded and the worker thread the queue is assigned to is woken up
+ *    without leaving ring-0.
+ *  - Completion queue head doorbells are handled in ring-0 too unless there
+ *    are completions waiting for room in the queue or the device is using
+ *    INTx, both need ring-3 to finish the job.
+ *  - All other registers are rarely written and handled in ring-3.
+ *
+ * The submission queues are distributed over a small pool of worker threads
+ * which fetch the commands and submit them to the driver below using the
+ * extended media interface.  Completions are posted from whatever thread the
+ * request completes on.
+ *
+ * The shadow doorbell buffer (Doorbell Buffer Config command) lets the guest
+ * skip most doorbell writes for the I/O queues: the guest updates the tail
+ * and head in a memory buffer and only rings the doorbell if the new value
+ * passes the event index the device maintains in a second buffer.  The device
+ * only updates the event index when a worker caught up with a queue and is
+ * about to go to sleep, so while the device is busy the guest does not cause
+ * any exits.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define LOG_GROUP LOG_GROUP_DEV_NVME
+#include <VBox/vmm/pdmdev.h>
+#include <VBox/vmm/pdmstorageifs.h>
+#include <VBox/vmm/pdmthread.h>
+#include <VBox/vmm/pdmcritsect.h>
+#include <VBox/msi.h>
+#include <VBox/sup.h>
+#include <iprt/assert.h>
+#include <iprt/asm.h>
+#include <iprt/string.h>
+#include <iprt/list.h>
+#ifdef IN_RING3
+# include <iprt/critsect.h>
+# include <iprt/mem.h>
+# include <iprt/mp.h>
+# include <iprt/semaphore.h>
+# include <iprt/sg.h>
+# include <iprt/uuid.h>
+#endif
+#include "VBoxDD.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The current saved state version. */
+#define NVME_SAVED_STATE_VERSION                1
+
+/** Maximum number of I/O queues of each type. */
+#define NVME_QUEUES_IO_MAX                      64
+/** Default number of I/O queues of each type. */
+#define NVME_QUEUES_IO_DEFAULT                  16
+/** Default number of entries per queue (CAP.MQES + 1). */
+#define NVME_QUEUE_ENTRIES_DEFAULT              1024
+/** Maximum number of namespaces. */
+#define NVME_NAMESPACES_MAX                     256
+/** Maximum number of worker threads. */
+#define NVME_WRK_THRDS_MAX                      16
+/** Maximum number of outstanding asynchronous event requests. */
+#define NVME_ASYNC_EVT_REQS_MAX                 4
+/** Number of commands fetched from a submission queue before the worker moves
+ * on to the next queue assigned to it. */
+#define NVME_SQ_CMDS_PER_PASS                   64
+
+/** The memory page size we support (CAP.MPSMIN = CAP.MPSMAX = 0). */
+#define NVME_PAGE_SIZE                          _4K
+/** Maximum data transfer size as a power of two of the page size. */
+#define NVME_MDTS                               8
+/** Maximum number of bytes a single command can transfer. */
+#define NVME_XFER_MAX                           (NVME_PAGE_SIZE << NVME_MDTS)
+/** Maximum number of PRP entries a command can use. */
+#define NVME_PRPS_MAX                           (NVME_XFER_MAX / NVME_PAGE_SIZE + 1)
+/** Maximum number of ranges in a dataset management command. */
+#define NVME_DSM_RANGES_MAX                     256
+
+/** Size of the identification strings without terminator. */
+#define NVME_SERIAL_NUMBER_LENGTH               20
+#define NVME_MODEL_NUMBER_LENGTH                40
+#define NVME_FIRMWARE_REVISION_LENGTH           8
+
+/** @name PCI configuration.
+ * @{ */
+#define NVME_PCI_VENDOR_ID                      0x80ee
+#define NVME_PCI_DEVICE_ID                      0x4e56
+#define NVME_PCI_MSIX_CAP_OFF                   0x80
+#define NVME_PCI_MSIX_BAR                       4
+/** Size of the register BAR, must cover the doorbells of all queues. */
+#define NVME_MMIO_SIZE                          _16K
+/** @} */
+
+/** @name Controller registers.
+ * @{ */
+#define NVME_REG_CAP_LO                         0x00
+#define NVME_REG_CAP_HI                         0x04
+#define NVME_REG_VS                             0x08
+#define NVME_REG_INTMS                          0x0c
+#define NVME_REG_INTMC                          0x10
+#define NVME_REG_CC                             0x14
+#define NVME_REG_CSTS                           0x1c
+#define NVME_REG_NSSR                           0x20
+#define NVME_REG_AQA                            0x24
+#define NVME_REG_ASQ_LO                         0x28
+#define NVME_REG_ASQ_HI                         0x2c
+#define NVME_REG_ACQ_LO                         0x30
+#define NVME_REG_ACQ_HI                         0x34
+/** The first doorbell, the stride is 4 bytes (CAP.DSTRD = 0). */
+#define NVME_REG_DOORBELL_FIRST                 0x1000
+
+#define NVME_CAP_MQES_MASK                      UINT64_C(0x000000000000ffff)
+#define NVME_CAP_CQR                            RT_BIT_64(16)
+#define NVME_CAP_TO_SHIFT                       24
+#define NVME_CAP_CSS_NVM                        RT_BIT_64(37)
+#define NVME_CAP_MPSMIN_SHIFT                   48
+#define NVME_CAP_MPSMAX_SHIFT                   52
+
+/** Version 1.3.0. */
+#define NVME_VS_1_3                             UINT32_C(0x00010300)
+
+#define NVME_CC_EN                              RT_BIT_32(0)
+#define NVME_CC_CSS_MASK                        UINT32_C(0x00000070)
+#define NVME_CC_MPS_MASK                        UINT32_C(0x00000780)
+#define NVME_CC_AMS_MASK                        UINT32_C(0x00003800)
+#define NVME_CC_SHN_MASK                        UINT32_C(0x0000c000)
+#define NVME_CC_IOSQES_SHIFT                    16
+#define NVME_CC_IOCQES_SHIFT                    20
+#define NVME_CC_WRITABLE_MASK                   UINT32_C(0x00fffff1)
+
+#define NVME_CSTS_RDY                           RT_BIT_32(0)
+#define NVME_CSTS_CFS                           RT_BIT_32(1)
+#define NVME_CSTS_SHST_MASK                     UINT32_C(0x0000000c)
+#define NVME_CSTS_SHST_COMPLETE                 UINT32_C(0x00000008)
+
+#define NVME_AQA_ASQS_MASK                      UINT32_C(0x00000fff)
+#define NVME_AQA_ACQS_SHIFT                     16
+#define NVME_AQA_WRITABLE_MASK                  UINT32_C(0x0fff0fff)
+/** @} */
+
+/** Submission and completion queue entry sizes as power of two. */
+#define NVME_SQ_ENTRY_SIZE_LOG2                 6
+#define NVME_CQ_ENTRY_SIZE_LOG2                 4
+
+/** @name Admin command opcodes.
+ * @{ */
+#define NVME_ADM_DELETE_IO_SQ                   0x00
+#define NVME_ADM_CREATE_IO_SQ                   0x01
+#define NVME_ADM_GET_LOG_PAGE                   0x02
+#define NVME_ADM_DELETE_IO_CQ                   0x04
+#define NVME_ADM_CREATE_IO_CQ                   0x05
+#define NVME_ADM_IDENTIFY                       0x06
+#define NVME_ADM_ABORT                          0x08
+#define NVME_ADM_SET_FEATURES                   0x09
+#define NVME_ADM_GET_FEATURES                   0x0a
+#define NVME_ADM_ASYNC_EVT_REQ                  0x0c
+#define NVME_ADM_DOORBELL_BUF_CONFIG            0x7c
+/** @} */
+
+/** @name NVM command set opcodes.
+ * @{ */
+#define NVME_NVM_FLUSH                          0x00
+#define NVME_NVM_WRITE                          0x01
+#define NVME_NVM_READ                           0x02
+#define NVME_NVM_WRITE_ZEROES                   0x08
+#define NVME_NVM_DSM                            0x09
+/** @} */
+
+/** @name Identify CNS values.
+ * @{ */
+#define NVME_IDENTIFY_CNS_NAMESPACE             0x00
+#define NVME_IDENTIFY_CNS_CONTROLLER            0x01
+#define NVME_IDENTIFY_CNS_ACTIVE_NS_LIST        0x02
+#define NVME_IDENTIFY_CNS_NS_ID_DESC_LIST       0x03
+/** @} */
+
+/** @name Feature identifiers.
+ * @{ */
+#define NVME_FEAT_ARBITRATION                   0x01
+#define NVME_FEAT_POWER_MGMT                    0x02
+#define NVME_FEAT_TEMP_THRESHOLD                0x04
+#define NVME_FEAT_ERROR_RECOVERY                0x05
+#define NVME_FEAT_VOLATILE_WC                   0x06
+#define NVME_FEAT_NUM_QUEUES                    0x07
+#define NVME_FEAT_INTR_COALESCING               0x08
+#define NVME_FEAT_INTR_VEC_CONFIG               0x09
+#define NVME_FEAT_WRITE_ATOMICITY               0x0a
+#define NVME_FEAT_ASYNC_EVT_CONFIG              0x0b
+/** @} */
+
+/** @name Log page identifiers.
+ * @{ */
+#define NVME_LOG_ERROR_INFO                     0x01
+#define NVME_LOG_SMART_HEALTH                   0x02
+#define NVME_LOG_FIRMWARE_SLOT                  0x03
+#define NVME_LOG_CHANGED_NS_LIST                0x04
+/** @} */
+
+/** Asynchronous event configuration: namespace attribute notices. */
+#define NVME_ASYNC_EVT_CFG_NS_ATTR              RT_BIT_32(8)
+/** Asynchronous event completion for a namespace attribute change:
+ * type notice (2), information 0, log page 04h. */
+#define NVME_ASYNC_EVT_NS_ATTR_CHANGED          UINT32_C(0x00040002)
+
+/** @name Completion status, the status code type in bits 10:8 and the status
+ * code in bits 7:0 as they appear in the status field shifted right by one.
+ * @{ */
+#define NVME_STATUS(a_Sct, a_Sc)                ((uint16_t)(((a_Sct) << 8) | (a_Sc)))
+#define NVME_STATUS_DNR                         RT_BIT(14)
+#define NVME_STATUS_SUCCESS                     NVME_STATUS(0, 0x00)
+#define NVME_STATUS_INVALID_OPCODE              NVME_STATUS(0, 0x01)
+#define NVME_STATUS_INVALID_FIELD               NVME_STATUS(0, 0x02)
+#define NVME_STATUS_CID_CONFLICT                NVME_STATUS(0, 0x03)
+#define NVME_STATUS_DATA_XFER_ERROR             NVME_STATUS(0, 0x04)
+#define NVME_STATUS_INTERNAL_ERROR              NVME_STATUS(0, 0x06)
+#define NVME_STATUS_ABORT_REQUESTED             NVME_STATUS(0, 0x07)
+#define NVME_STATUS_INVALID_NAMESPACE           NVME_STATUS(0, 0x0b)
+#define NVME_STATUS_INVALID_PRP_OFFSET          NVME_STATUS(0, 0x13)
+#define NVME_STATUS_LBA_OUT_OF_RANGE            NVME_STATUS(0, 0x80)
+#define NVME_STATUS_NS_NOT_READY                NVME_STATUS(0, 0x82)
+#define NVME_STATUS_CQ_INVALID                  NVME_STATUS(1, 0x00)
+#define NVME_STATUS_INVALID_QUEUE_ID            NVME_STATUS(1, 0x01)
+#define NVME_STATUS_INVALID_QUEUE_SIZE          NVME_STATUS(1, 0x02)
+#define NVME_STATUS_ASYNC_EVT_LIMIT_EXCEEDED    NVME_STATUS(1, 0x05)
+#define NVME_STATUS_INVALID_LOG_PAGE            NVME_STATUS(1, 0x09)
+#define NVME_STATUS_INVALID_INTR_VECTOR         NVME_STATUS(1, 0x08)
+#define NVME_STATUS_INVALID_QUEUE_DELETION      NVME_STATUS(1, 0x0c)
+#define NVME_STATUS_FEATURE_NOT_CHANGEABLE      NVME_STATUS(1, 0x0e)
+#define NVME_STATUS_WRITE_TO_RO_RANGE           NVME_STATUS(1, 0x82)
+#define NVME_STATUS_WRITE_FAULT                 NVME_STATUS(2, 0x80)
+#define NVME_STATUS_UNRECOVERED_READ_ERROR      NVME_STATUS(2, 0x81)
+/** @} */
+
+/** Index of the submission queue tail doorbell of the given queue. */
+#define NVME_DB_IDX_SQ(a_idQueue)               ((uint32_t)(a_idQueue) * 2)
+/** Index of the completion queue head doorbell of the given queue. */
+#define NVME_DB_IDX_CQ(a_idQueue)               ((uint32_t)(a_idQueue) * 2 + 1)
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * A submission queue entry.
+ */
+typedef struct NVMECMD
+{
+    uint8_t     u8Opc;
+    uint8_t     u8Flags;
+    uint16_t    u16Cid;
+    uint32_t    u32Nsid;
+    uint64_t    u64Reserved;
+    uint64_t    u64Mptr;
+    uint64_t    u64Prp1;
+    uint64_t    u64Prp2;
+    /** Command dwords 10 to 15. */
+    uint32_t    au32Cdw[6];
+} NVMECMD;
+AssertCompileSize(NVMECMD, RT_BIT_32(NVME_SQ_ENTRY_SIZE_LOG2));
+/** Pointer to a submission queue entry. */
+typedef NVMECMD *PNVMECMD;
+/** Pointer to a const submission queue entry. */
+typedef const NVMECMD *PCNVMECMD;
+
+/** Accessor for command dword 10 to 15. */
+#define NVME_CMD_CDW(a_pCmd, a_iDw)             ((a_pCmd)->au32Cdw[(a_iDw) - 10])
+
+/**
+ * A completion queue entry.
+ */
+typedef struct NVMECQE
+{
+    uint32_t    u32Dw0;
+    uint32_t    u32Reserved;
+    uint16_t    u16SqHead;
+    uint16_t    u16SqId;
+    uint16_t    u16Cid;
+    /** Phase tag in bit 0, the status in bits 15:1. */
+    uint16_t    u16Status;
+} NVMECQE;
+AssertCompileSize(NVMECQE, RT_BIT_32(NVME_CQ_ENTRY_SIZE_LOG2));
+/** Pointer to a completion queue entry. */
+typedef NVMECQE *PNVMECQE;
+
+/**
+ * A dataset management range.
+ */
+typedef struct NVMEDSMRANGE
+{
+    /** Context attributes. */
+    uint32_t    u32CtxAttr;
+    /** Number of logical blocks. */
+    uint32_t    cBlocks;
+    /** Starting LBA. */
+    uint64_t    uLbaStart;
+} NVMEDSMRANGE;
+AssertCompileSize(NVMEDSMRANGE, 16);
+
+/**
+ * Controller state.
+ */
+typedef enum NVMESTATE
+{
+    NVMESTATE_INVALID = 0,
+    /** The controller is disabled (CC.EN = 0). */
+    NVMESTATE_DISABLED,
+    /** The controller is enabled and processes commands. */
+    NVMESTATE_READY,
+    /** The guest requested a shutdown, no commands are processed. */
+    NVMESTATE_SHUTDOWN,
+    /** The controller encountered a fatal error (CSTS.CFS). */
+    NVMESTATE_FATAL,
+    NVMESTATE_32BIT_HACK = 0x7fffffff
+} NVMESTATE;
+
+/**
+ * Queue state.
+ */
+typedef enum NVMEQUEUESTATE
+{
+    NVMEQUEUESTATE_INVALID = 0,
+    /** The queue does not exist. */
+    NVMEQUEUESTATE_FREE,
+    /** The queue was created by the guest. */
+    NVMEQUEUESTATE_CREATED,
+    NVMEQUEUESTATE_32BIT_HACK = 0x7fffffff
+} NVMEQUEUESTATE;
+
+/**
+ * Queue type.
+ */
+typedef enum NVMEQUEUETYPE
+{
+    NVMEQUEUETYPE_INVALID = 0,
+    NVMEQUEUETYPE_SUBMISSION,
+    NVMEQUEUETYPE_COMPLETION,
+    NVMEQUEUETYPE_32BIT_HACK = 0x7fffffff
+} NVMEQUEUETYPE;
+
+/**
+ * Submission queue priority (arbitration is round robin, the priority is only
+ * recorded).
+ */
+typedef enum NVMEQUEUEPRIO
+{
+    NVMEQUEUEPRIO_URGENT = 0,
+    NVMEQUEUEPRIO_HIGH,
+    NVMEQUEUEPRIO_MEDIUM,
+    NVMEQUEUEPRIO_LOW,
+    NVMEQUEUEPRIO_32BIT_HACK = 0x7fffffff
+} NVMEQUEUEPRIO;
+
+/**
+ * The part common to submission and completion queues.
+ */
+typedef struct NVMEQUEUEHDR
+{
+    /** The queue ID. */
+    uint16_t                        u16Id;
+    /** Whether the queue is physically contiguous (always, CAP.CQR is set). */
+    bool                            fPhysCont;
+    bool                            afAlignment0[1];
+    /** Number of entries. */
+    uint32_t                        cEntries;
+    /** The queue state. */
+    volatile NVMEQUEUESTATE         enmState;
+    /** The queue type. */
+    NVMEQUEUETYPE                   enmType;
+    /** Guest physical base address of the queue. */
+    RTGCPHYS                        GCPhysBase;
+    /** Size of an entry in bytes. */
+    uint32_t                        cbEntry;
+    /** The head index, written by the device for submission queues and by the
+     * guest (doorbell) for completion queues. */
+    volatile uint32_t               idxHead;
+    /** The tail index, written by the guest (doorbell) for submission queues
+     * and by the device for completion queues. */
+    volatile uint32_t               idxTail;
+    uint32_t                        u32Alignment1;
+} NVMEQUEUEHDR;
+AssertCompileSizeAlignment(NVMEQUEUEHDR, 8);
+/** Pointer to a queue header. */
+typedef NVMEQUEUEHDR *PNVMEQUEUEHDR;
+
+/**
+ * A submission queue.
+ */
+typedef struct NVMEQUEUESUBM
+{
+    /** The common queue part. */
+    NVMEQUEUEHDR                    Hdr;
+    /** The completion queue the completions are posted to. */
+    uint16_t                        u16CompletionQueueId;
+    uint16_t                        u16Alignment0;
+    /** The priority given at creation. */
+    NVMEQUEUEPRIO                   enmPriority;
+    /** Generation, incremented when the queue is deleted so completions of
+     * requests fetched earlier are dropped. */
+    volatile uint32_t               uGen;
+    /** Number of requests submitted to the driver below and not completed yet. */
+    volatile uint32_t               cReqsActive;
+    /** Event semaphore of the worker thread the queue is assigned to, copied
+     * here so the doorbell can be handled in ring-0. */
+    SUPSEMEVENT                     hEvtProcess;
+    /** The worker thread the queue is assigned to. */
+    R3PTRTYPE(struct NVMEWRKTHRD *) pWrkThrdR3;
+    /** Node in the list of queues assigned to the worker thread. */
+    RTLISTNODER3                    NdLstWrkThrdAssgnd;
+    /** Number of commands fetched from the queue. */
+    STAMCOUNTER                     StatCmds;
+} NVMEQUEUESUBM;
+AssertCompileSizeAlignment(NVMEQUEUESUBM, 8);
+/** Pointer to a submission queue. */
+typedef NVMEQUEUESUBM *PNVMEQUEUESUBM;
+
+/**
+ * A completion queue.
+ */
+typedef struct NVMEQUEUECOMP
+{
+    /** The common queue part. */
+    NVMEQUEUEHDR                    Hdr;
+    /** Whether interrupts are enabled for the queue. */
+    bool                            fIntrEnabled;
+    /** The phase tag to write into the next entry. */
+    bool                            fPhase;
+    /** An interrupt is due once the workers feeding the queue are done. */
+    bool                            fIntrPending;
+    bool                            afAlignment0[1];
+    /** The MSI-X vector. */
+    uint32_t                        u32IntrVec;
+    /** Number of submission queues posting completions to this queue. */
+    uint32_t                        cSubmQueuesRef;
+    /** Number of submission queues feeding this queue currently being
+     * processed by a worker, the interrupt is delayed until the last is done. */
+    uint32_t                        cSubmQueuesProcessing;
+    /** Number of completions waiting for room in the queue. */
+    volatile uint32_t               cWaiters;
+    uint32_t                        u32Alignment1;
+    /** List of completions waiting for room in the queue (NVMECOMPWAITER). */
+    RTLISTANCHORR3                  LstCompletionsWaiting;
+    /** Serializes posting completions. */
+    R3PTRTYPE(RTSEMFASTMUTEX)       hMtx;
+    /** Number of interrupts raised for this queue. */
+    STAMCOUNTER                     StatIntrs;
+} NVMEQUEUECOMP;
+AssertCompileSizeAlignment(NVMEQUEUECOMP, 8);
+/** Pointer to a completion queue. */
+typedef NVMEQUEUECOMP *PNVMEQUEUECOMP;
+
+/**
+ * A completion waiting for room in its completion queue.
+ */
+typedef struct NVMECOMPWAITER
+{
+    /** Node in NVMEQUEUECOMP::LstCompletionsWaiting. */
+    RTLISTNODE                      NdLstWait;
+    /** The completion entry, the phase tag is set when posting. */
+    NVMECQE                         Cqe;
+} NVMECOMPWAITER;
+/** Pointer to a waiting completion. */
+typedef NVMECOMPWAITER *PNVMECOMPWAITER;
+
+/**
+ * A worker thread processing submission queues.
+ */
+typedef struct NVMEWRKTHRD
+{
+    /** The thread handle. */
+    R3PTRTYPE(PPDMTHREAD)           pThrd;
+    /** The event semaphore the thread waits on. */
+    SUPSEMEVENT                     hEvtProcess;
+    /** Protects the list of assigned queues, held while processing them. */
+    RTCRITSECT                      CritSect;
+    /** The submission queues assigned to this thread. */
+    RTLISTANCHOR                    LstSubmQueuesAssgnd;
+    /** Number of assigned queues. */
+    uint32_t                        cSubmQueuesAssgnd;
+    /** The thread index. */
+    uint32_t                        idWrkThrd;
+} NVMEWRKTHRD;
+/** Pointer to a worker thread. */
+typedef NVMEWRKTHRD *PNVMEWRKTHRD;
+
+/**
+ * A namespace, one for every LUN.
+ */
+typedef struct NVMENAMESPACE
+{
+    /** The namespace ID (LUN + 1). */
+    uint32_t                        u32Id;
+    /** The LUN. */
+    uint32_t                        iLUN;
+    /** Pointer to the controller. */
+    R3PTRTYPE(struct NVME *)        pNvmeR3;
+    /** Our base interface. */
+    PDMIBASE                        IBase;
+    /** Media port interface. */
+    PDMIMEDIAPORT                   IMediaPort;
+    /** Extended media port interface. */
+    PDMIMEDIAEXPORT                 IMediaExPort;
+    /** The status LED. */
+    PDMLED                          Led;
+    /** Pointer to the attached driver's base interface. */
+    R3PTRTYPE(PPDMIBASE)            pDrvBase;
+    /** Pointer to the attached driver's media interface. */
+    R3PTRTYPE(PPDMIMEDIA)           pDrvMedia;
+    /** Pointer to the attached driver's extended media interface. */
+    R3PTRTYPE(PPDMIMEDIAEX)         pDrvMediaEx;
+    /** Size of a logical block in bytes. */
+    uint32_t                        cbBlock;
+    /** Log2 of cbBlock. */
+    uint32_t                        cBlockShift;
+    /** Number of logical blocks. */
+    uint64_t                        cBlocks;
+    /** Whether the medium is read only. */
+    bool                            fReadOnly;
+    /** Whether the driver below supports discarding blocks. */
+    bool                            fDiscard;
+    /** The LUN description. */
+    char                            szDesc[32];
+} NVMENAMESPACE;
+/** Pointer to a namespace. */
+typedef NVMENAMESPACE *PNVMENAMESPACE;
+
+/**
+ * The PRP entries of a command, collected from PRP1, PRP2 and the PRP lists.
+ */
+typedef struct NVMEPRPS
+{
+    /** Number of valid entries. */
+    uint32_t                        cPrps;
+    /** Number of bytes in the first entry, it may start at an offset. */
+    uint32_t                        cbFirst;
+    /** Total number of bytes described. */
+    size_t                          cbTotal;
+    /** The entries. */
+    RTGCPHYS                        aGCPhys[NVME_PRPS_MAX];
+} NVMEPRPS;
+/** Pointer to the PRPs of a command. */
+typedef NVMEPRPS *PNVMEPRPS;
+
+/**
+ * An I/O request, allocated by the driver below.
+ */
+typedef struct NVMEREQ
+{
+    /** The I/O request handle. */
+    PDMMEDIAEXIOREQ                 hIoReq;
+    /** The namespace. */
+    PNVMENAMESPACE                  pNamespace;
+    /** The command as fetched, kept for restoring suspended requests. */
+    NVMECMD                         Cmd;
+    /** The submission queue the command was fetched from. */
+    uint16_t                        u16SqId;
+    /** The completion queue to post the completion to. */
+    uint16_t                        u16CqId;
+    /** Generation of the submission queue at fetch time. */
+    uint32_t                        uGen;
+    /** Start offset in bytes. */
+    uint64_t                        offStart;
+    /** Number of bytes to transfer. */
+    size_t                          cbXfer;
+    /** Number of ranges for a dataset management command. */
+    uint32_t                        cRanges;
+    /** The data buffer. */
+    NVMEPRPS                        Prps;
+} NVMEREQ;
+/** Pointer to an I/O request. */
+typedef NVMEREQ *PNVMEREQ;
+
+/**
+ * A command restored from a saved state, resubmitted on resume.
+ */
+typedef struct NVMECMDRESTORED
+{
+    /** The submission queue. */
+    uint16_t                        u16SqId;
+    /** The command. */
+    NVMECMD                         Cmd;
+} NVMECMDRESTORED;
+/** Pointer to a restored command. */
+typedef NVMECMDRESTORED *PNVMECMDRESTORED;
+
+/**
+ * The NVMe controller state.
+ */
+typedef struct NVME
+{
+    /** The PCI device structure. */
+    PDMPCIDEV                       PciDev;
+    /** Pointer to the device instance - R3 ptr. */
+    PPDMDEVINSR3                    pDevInsR3;
+    /** Pointer to the device instance - R0 ptr. */
+    PPDMDEVINSR0                    pDevInsR0;
+    /** Pointer to the device instance - RC ptr. */
+    PPDMDEVINSRC                    pDevInsRC;
+    RTRCPTR                         RCPtrAlignment0;
+
+    /** Status LUN: the base interface. */
+    PDMIBASE                        IBase;
+    /** Status LUN: the LED ports interface. */
+    PDMILEDPORTS                    ILeds;
+    /** Status LUN: the LED connector. */
+    R3PTRTYPE(PPDMILEDCONNECTORS)   pLedsConnector;
+    /** The support driver session handle. */
+    R3R0PTRTYPE(PSUPDRVSESSION)     pSupDrvSession;
+
+    /** Base address of the register BAR. */
+    RTGCPHYS                        GCPhysMMIO;
+    /** Maximum number of I/O submission queues. */
+    uint32_t                        cQueuesSubmMax;
+    /** Maximum number of I/O completion queues. */
+    uint32_t                        cQueuesCompMax;
+    /** Maximum number of entries per queue. */
+    uint32_t                        cQueueEntriesMax;
+    /** Worst case time to become ready in 500ms units (CAP.TO). */
+    uint32_t                        cTimeoutMax;
+    /** Number of worker threads. */
+    uint32_t                        cWrkThrdsMax;
+    /** Number of namespaces (LUNs). */
+    uint32_t                        cNamespaces;
+    /** Number of MSI-X vectors, 0 if the chipset has no MSI-X support. */
+    uint32_t                        cMsixVectors;
+    /** Number of I/O submission queues granted (Number of Queues feature). */
+    uint32_t                        cQueuesSubmGranted;
+    /** Number of I/O completion queues granted (Number of Queues feature). */
+    uint32_t                        cQueuesCompGranted;
+
+    /** Serial number, space padded when reported. */
+    char                            szSerialNumber[NVME_SERIAL_NUMBER_LENGTH + 1];
+    /** Model number, space padded when reported. */
+    char                            szModelNumber[NVME_MODEL_NUMBER_LENGTH + 1];
+    /** Firmware revision, space padded when reported. */
+    char                            szFirmwareRevision[NVME_FIRMWARE_REVISION_LENGTH + 1];
+    /** Whether ring-0 is enabled. */
+    bool                            fR0Enabled;
+    /** Whether PDMDevHlpAsyncNotificationCompleted should be called once idle. */
+    volatile bool                   fSignalIdle;
+
+    /** The controller state. */
+    volatile NVMESTATE              enmState;
+    /** The capabilities register. */
+    uint64_t                        u64RegCap;
+    /** The interrupt mask (INTMS/INTMC). */
+    uint32_t                        u32IntrMask;
+    /** The controller configuration. */
+    uint32_t                        u32RegCc;
+    /** The controller status. */
+    volatile uint32_t               u32RegCsts;
+    /** The admin queue attributes. */
+    uint32_t                        u32RegAqa;
+    /** The admin submission queue base address. */
+    uint64_t                        u64RegAsq;
+    /** The admin completion queue base address. */
+    uint64_t                        u64RegAcq;
+    /** The memory page size selected in CC.MPS. */
+    uint32_t                        cbPage;
+    uint32_t                        u32Alignment1;
+
+    /** Shadow doorbell buffer, NIL_RTGCPHYS if not configured. */
+    RTGCPHYS                        GCPhysDbBufShadow;
+    /** Event index buffer, NIL_RTGCPHYS if not configured. */
+    RTGCPHYS                        GCPhysDbBufEvtIdx;
+
+    /** @name Feature values as set by the guest.
+     * @{ */
+    uint32_t                        u32FeatArbitration;
+    uint32_t                        u32FeatTempThreshold;
+    uint32_t                        u32FeatErrRecovery;
+    uint32_t                        u32FeatVolatileWc;
+    uint32_t                        u32FeatIntrCoalescing;
+    uint32_t                        u32FeatWriteAtomicity;
+    uint32_t                        u32FeatAsyncEvtCfg;
+    /** @} */
+    uint32_t                        u32Alignment2;
+
+    /** The submission queues, index 0 is the admin queue. */
+    NVMEQUEUESUBM                   aQueuesSubm[NVME_QUEUES_IO_MAX + 1];
+    /** The completion queues, index 0 is the admin queue. */
+    NVMEQUEUECOMP                   aQueuesComp[NVME_QUEUES_IO_MAX + 1];
+
+    /** Protects the asynchronous event state. */
+    PDMCRITSECT                     CritSectAsyncEvtReqs;
+    /** Serializes updating the INTx level. */
+    PDMCRITSECT                     CritSectIntx;
+    /** Number of outstanding asynchronous event requests. */
+    uint32_t                        cAsyncEvtReqs;
+    /** Command IDs of the outstanding asynchronous event requests. */
+    uint16_t                        aAsyncEvtReqCids[NVME_ASYNC_EVT_REQS_MAX];
+    /** A namespace attribute changed event is waiting for a request. */
+    bool                            fAsyncEvtNsChangedPending;
+    /** Namespace attribute changed events are masked until the changed
+     * namespace list log page was read. */
+    bool                            fAsyncEvtNsChangedMasked;
+    bool                            afAlignment3[2];
+    /** Bitmap of changed namespaces (bit = namespace ID - 1). */
+    uint32_t                        bmNsChanged[NVME_NAMESPACES_MAX / 32];
+
+    /** The namespaces. */
+    R3PTRTYPE(PNVMENAMESPACE)       paNamespaces;
+    /** The worker threads. */
+    R3PTRTYPE(PNVMEWRKTHRD)         paWrkThrds;
+    /** Number of worker threads currently processing queues. */
+    volatile uint32_t               cWrkThrdsActive;
+    /** Number of commands restored from a saved state. */
+    uint32_t                        cCmdsRestored;
+    /** Commands restored from a saved state. */
+    R3PTRTYPE(PNVMECMDRESTORED)     paCmdsRestored;
+
+    /** @name Statistics.
+     * @{ */
+    STAMCOUNTER                     StatDoorbellWritesSq;
+    STAMCOUNTER                     StatDoorbellWritesCq;
+    STAMCOUNTER                     StatDoorbellWritesCqR3;
+    STAMCOUNTER                     StatCmdsAdmin;
+    STAMCOUNTER                     StatCmdsRead;
+    STAMCOUNTER                     StatCmdsWrite;
+    STAMCOUNTER                     StatCmdsFlush;
+    STAMCOUNTER                     StatCmdsDsm;
+    STAMCOUNTER                     StatCmdsWriteZeroes;
+    STAMCOUNTER                     StatCmdsFailed;
+    STAMCOUNTER                     StatBytesRead;
+    STAMCOUNTER                     StatBytesWritten;
+    STAMCOUNTER                     StatCqFull;
+    STAMCOUNTER                     StatIntrsBatched;
+    /** @} */
+} NVME;
+/** Pointer to the NVMe controller state. */
+typedef NVME *PNVME;
+
+AssertCompileMemberAlignment(NVME, GCPhysMMIO, 8);
+AssertCompileMemberAlignment(NVME, aQueuesSubm, 8);
+AssertCompileMemberAlignment(NVME, aQueuesComp, 8);
+AssertCompileMemberAlignment(NVME, CritSectAsyncEvtReqs, 8);
+AssertCompileMemberAlignment(NVME, CritSectIntx, 8);
+AssertCompileMemberAlignment(NVME, StatDoorbellWritesSq, 8);
+
+
+#ifndef VBOX_DEVICE_STRUCT_TESTCASE
+
+/*********************************************************************************************************************************
+*   Internal Functions                                                                                                           *
+*********************************************************************************************************************************/
+RT_C_DECLS_BEGIN
+PDMBOTHCBDECL(int) nvmeMmioRead(PPDMDEVINS pDevIns, void *pvUser, RTGCPHYS GCPhysAddr, void *pv, unsigned cb);
+PDMBOTHCBDECL(int) nvmeMmioWrite(PPDMDEVINS pDevIns, void *pvUser, RTGCPHYS GCPhysAddr, void const *pv, unsigned cb);
+RT_C_DECLS_END
+#ifdef IN_RING3
+static void nvmeR3CqHeadUpdated(PNVME pThis, PNVMEQUEUECOMP pCq);
+static void nvmeR3IntxUpdate(PNVME pThis);
+static void nvmeR3CtrlWriteCc(PNVME pThis, uint32_t u32);
+#endif
+
+
+/**
+ * Checks whether the guest enabled MSI-X.
+ */
+DECLINLINE(bool) nvmeIsMsixEnabled(PNVME pThis)
+{
+    return    pThis->cMsixVectors
+           && (PDMPciDevGetWord(&pThis->PciDev, NVME_PCI_MSIX_CAP_OFF + VBOX_MSIX_CAP_MESSAGE_CONTROL) & VBOX_PCI_MSIX_FLAGS_ENABLE);
+}
+
+/**
+ * Handles a doorbell write.
+ *
+ * Submission queue doorbells only record the new tail and wake up the worker,
+ * completion queue doorbells need ring-3 if completions are waiting for room
+ * or the INTx level has to be updated.
+ *
+ * @returns VBox status code.
+ * @param   pThis       The NVMe controller instance.
+ * @param   idxDb       The doorbell index.
+ * @param   u32         The value written.
+ */
+static int nvmeDoorbellWrite(PNVME pThis, uint32_t idxDb, uint32_t u32)
+{
+    if (pThis->enmState != NVMESTATE_READY)
+    {
+        Log(("nvmeDoorbellWrite: Controller not ready, ignoring write to doorbell %u\n", idxDb));
+        return VINF_SUCCESS;
+    }
+
+    uint32_t const idQueue = idxDb / 2;
+    if (!(idxDb & 1))
+    {
+        if (RT_UNLIKELY(idQueue >= RT_ELEMENTS(pThis->aQueuesSubm)))
+            return VINF_SUCCESS;
+        PNVMEQUEUESUBM pSq = &pThis->aQueuesSubm[idQueue];
+        if (RT_UNLIKELY(   pSq->Hdr.enmState != NVMEQUEUESTATE_CREATED
+                        || u32 >= pSq->Hdr.cEntries))
+        {
+            Log(("nvmeDoorbellWrite: Invalid write of %#x to the tail of submission queue %u\n", u32, idQueue));
+            return VINF_SUCCESS;
+        }
+
+        STAM_REL_COUNTER_INC(&pThis->StatDoorbellWritesSq);
+        ASMAtomicWriteU32(&pSq->Hdr.idxTail, u32);
+        int rc = SUPSemEventSignal(pThis->pSupDrvSession, pSq->hEvtProcess);
+        AssertRC(rc);
+        return VINF_SUCCESS;
+    }
+
+    if (RT_UNLIKELY(idQueue >= RT_ELEMENTS(pThis->aQueuesComp)))
+        return VINF_SUCCESS;
+    PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[idQueue];
+    if (RT_UNLIKELY(   pCq->Hdr.enmState != NVMEQUEUESTATE_CREATED
+                    || u32 >= pCq->Hdr.cEntries))
+    {
+        Log(("nvmeDoorbellWrite: Invalid write of %#x to the head of completion queue %u\n", u32, idQueue));
+        return VINF_SUCCESS;
+    }
+
+#ifndef IN_RING3
+    if (!nvmeIsMsixEnabled(pThis))
+        return VINF_IOM_R3_MMIO_WRITE;
+#endif
+    STAM_REL_COUNTER_INC(&pThis->StatDoorbellWritesCq);
+    ASMAtomicWriteU32(&pCq->Hdr.idxHead, u32);
+
+    /* Pairs with the increment in nvmeR3CqPost, either we see the waiter or it sees the new head. */
+    if (ASMAtomicReadU32(&pCq->cWaiters))
+    {
+#ifdef IN_RING3
+        nvmeR3CqHeadUpdated(pThis, pCq);
+#else
+        return VINF_IOM_R3_MMIO_WRITE;
+#endif
+    }
+#ifdef IN_RING3
+    else if (!nvmeIsMsixEnabled(pThis))
+        nvmeR3IntxUpdate(pThis);
+#endif
+    return VINF_SUCCESS;
+}
+
+/**
+ * @callback_method_impl{FNIOMMMIOREAD}
+ */
+PDMBOTHCBDECL(int) nvmeMmioRead(PPDMDEVINS pDevIns, void *pvUser, RTGCPHYS GCPhysAddr, void *pv, unsigned cb)
+{
+    RT_NOREF(pvUser);
+    PNVME    pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    uint32_t off   = (uint32_t)(GCPhysAddr - pThis->GCPhysMMIO);
+    uint32_t u32;
+    Assert(cb == sizeof(uint32_t)); Assert(!(off & 3)); NOREF(cb);
+
+    switch (off)
+    {
+        case NVME_REG_CAP_LO:   u32 = RT_LO_U32(pThis->u64RegCap); break;
+        case NVME_REG_CAP_HI:   u32 = RT_HI_U32(pThis->u64RegCap); break;
+        case NVME_REG_VS:       u32 = NVME_VS_1_3; break;
+        case NVME_REG_INTMS:
+        case NVME_REG_INTMC:    u32 = pThis->u32IntrMask; break;
+        case NVME_REG_CC:       u32 = pThis->u32RegCc; break;
+        case NVME_REG_CSTS:     u32 = ASMAtomicReadU32(&pThis->u32RegCsts); break;
+        case NVME_REG_AQA:      u32 = pThis->u32RegAqa; break;
+        case NVME_REG_ASQ_LO:   u32 = RT_LO_U32(pThis->u64RegAsq); break;
+        case NVME_REG_ASQ_HI:   u32 = RT_HI_U32(pThis->u64RegAsq); break;
+        case NVME_REG_ACQ_LO:   u32 = RT_LO_U32(pThis->u64RegAcq); break;
+        case NVME_REG_ACQ_HI:   u32 = RT_HI_U32(pThis->u64RegAcq); break;
+        default:
+            /* Doorbells and reserved registers read as zero. */
+            u32 = 0;
+            break;
+    }
+
+    Log3(("nvmeMmioRead: off=%#x -> %#x\n", off, u32));
+    *(uint32_t *)pv = u32;
+    return VINF_SUCCESS;
+}
+
+/**
+ * @callback_method_impl{FNIOMMMIOWRITE}
+ */
+PDMBOTHCBDECL(int) nvmeMmioWrite(PPDMDEVINS pDevIns, void *pvUser, RTGCPHYS GCPhysAddr, void const *pv, unsigned cb)
+{
+    RT_NOREF(pvUser);
+    PNVME    pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    uint32_t off   = (uint32_t)(GCPhysAddr - pThis->GCPhysMMIO);
+    uint32_t u32   = *(uint32_t const *)pv;
+    Assert(cb == sizeof(uint32_t)); Assert(!(off & 3)); NOREF(cb);
+
+    Log3(("nvmeMmioWrite: off=%#x u32=%#x\n", off, u32));
+    if (off >= NVME_REG_DOORBELL_FIRST)
+        return nvmeDoorbellWrite(pThis, (off - NVME_REG_DOORBELL_FIRST) / sizeof(uint32_t), u32);
+
+#ifndef IN_RING3
+    return VINF_IOM_R3_MMIO_WRITE;
+#else
+    bool const fEnabled = RT_BOOL(pThis->u32RegCc & NVME_CC_EN);
+    switch (off)
+    {
+        case NVME_REG_INTMS:
+            /* Only vector 0 exists without MSI-X, the mask is ignored with MSI-X. */
+            pThis->u32IntrMask |= u32 & RT_BIT_32(0);
+            nvmeR3IntxUpdate(pThis);
+            break;
+        case NVME_REG_INTMC:
+            pThis->u32IntrMask &= ~(u32 & RT_BIT_32(0));
+            nvmeR3IntxUpdate(pThis);
+            break;
+        case NVME_REG_CC:
+            nvmeR3CtrlWriteCc(pThis, u32);
+            break;
+        case NVME_REG_AQA:
+            if (!fEnabled)
+                pThis->u32RegAqa = u32 & NVME_AQA_WRITABLE_MASK;
+            break;
+        case NVME_REG_ASQ_LO:
+            if (!fEnabled)
+                pThis->u64RegAsq = RT_MAKE_U64(u32 & ~(uint32_t)(NVME_PAGE_SIZE - 1), RT_HI_U32(pThis->u64RegAsq));
+            break;
+        case NVME_REG_ASQ_HI:
+            if (!fEnabled)
+                pThis->u64RegAsq = RT_MAKE_U64(RT_LO_U32(pThis->u64RegAsq), u32);
+            break;
+        case NVME_REG_ACQ_LO:
+            if (!fEnabled)
+                pThis->u64RegAcq = RT_MAKE_U64(u32 & ~(uint32_t)(NVME_PAGE_SIZE - 1), RT_HI_U32(pThis->u64RegAcq));
+            break;
+        case NVME_REG_ACQ_HI:
+            if (!fEnabled)
+                pThis->u64RegAcq = RT_MAKE_U64(RT_LO_U32(pThis->u64RegAcq), u32);
+            break;
+        default:
+            /* NSSR (subsystem reset is not supported) and read only registers. */
+            Log(("nvmeMmioWrite: Ignoring write of %#x to %#x\n", u32, off));
+            break;
+    }
+    return VINF_SUCCESS;
+#endif
+}
+
+#ifdef IN_RING3
+
+/* -=-=-=-=- Guest memory helpers -=-=-=-=- */
+
+/**
+ * Reads a value from the shadow doorbell buffer.
+ *
+ * @returns The value.
+ * @param   pThis       The NVMe controller instance.
+ * @param   idxDb       The doorbell index.
+ */
+static uint32_t nvmeR3DbBufShadowRead(PNVME pThis, uint32_t idxDb)
+{
+    uint32_t u32 = 0;
+    PDMDevHlpPhysRead(pThis->pDevInsR3, pThis->GCPhysDbBufShadow + idxDb * sizeof(uint32_t), &u32, sizeof(u32));
+    return u32;
+}
+
+/**
+ * Writes a value into the event index buffer.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   idxDb       The doorbell index.
+ * @param   u32         The value to write.
+ */
+static void nvmeR3DbBufEvtIdxWrite(PNVME pThis, uint32_t idxDb, uint32_t u32)
+{
+    PDMDevHlpPCIPhysWrite(pThis->pDevInsR3, pThis->GCPhysDbBufEvtIdx + idxDb * sizeof(uint32_t), &u32, sizeof(u32));
+}
+
+/**
+ * Checks whether the given queue uses the shadow doorbell buffer, only the
+ * I/O queues do.
+ */
+DECLINLINE(bool) nvmeR3DbBufIsActive(PNVME pThis, uint16_t u16QueueId)
+{
+    return u16QueueId && pThis->GCPhysDbBufShadow != NIL_RTGCPHYS;
+}
+
+/**
+ * Returns the current tail of the given submission queue, taken from the
+ * shadow doorbell if active.
+ */
+static uint32_t nvmeR3SqTailGet(PNVME pThis, PNVMEQUEUESUBM pSq)
+{
+    if (nvmeR3DbBufIsActive(pThis, pSq->Hdr.u16Id))
+    {
+        uint32_t idxTail = nvmeR3DbBufShadowRead(pThis, NVME_DB_IDX_SQ(pSq->Hdr.u16Id));
+        if (RT_LIKELY(idxTail < pSq->Hdr.cEntries))
+            return idxTail;
+        Log(("nvmeR3SqTailGet: Invalid shadow tail %#x for queue %u\n", idxTail, pSq->Hdr.u16Id));
+    }
+    return ASMAtomicReadU32(&pSq->Hdr.idxTail);
+}
+
+/**
+ * Returns the current head of the given completion queue, taken from the
+ * shadow doorbell if active.
+ */
+static uint32_t nvmeR3CqHeadGet(PNVME pThis, PNVMEQUEUECOMP pCq)
+{
+    if (nvmeR3DbBufIsActive(pThis, pCq->Hdr.u16Id))
+    {
+        uint32_t idxHead = nvmeR3DbBufShadowRead(pThis, NVME_DB_IDX_CQ(pCq->Hdr.u16Id));
+        if (RT_LIKELY(idxHead < pCq->Hdr.cEntries))
+            return idxHead;
+        Log(("nvmeR3CqHeadGet: Invalid shadow head %#x for queue %u\n", idxHead, pCq->Hdr.u16Id));
+    }
+    return ASMAtomicReadU32(&pCq->Hdr.idxHead);
+}
+
+/**
+ * Collects the PRP entries describing a data buffer.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_INVALID_POINTER if a PRP entry has an invalid offset.
+ * @param   pThis       The NVMe controller instance.
+ * @param   u64Prp1     The PRP1 field of the command.
+ * @param   u64Prp2     The PRP2 field of the command.
+ * @param   cb          Size of the data buffer, at most NVME_XFER_MAX.
+ * @param   pPrps       Where to store the entries.
+ */
+static int nvmeR3PrpsParse(PNVME pThis, uint64_t u64Prp1, uint64_t u64Prp2, size_t cb, PNVMEPRPS pPrps)
+{
+    uint32_t const cbPage = pThis->cbPage;
+    AssertReturn(cb <= NVME_XFER_MAX, VERR_BUFFER_OVERFLOW);
+
+    pPrps->cPrps   = 0;
+    pPrps->cbTotal = cb;
+    pPrps->cbFirst = 0;
+    if (!cb)
+        return VINF_SUCCESS;
+    if (u64Prp1 & 3)
+        return VERR_INVALID_POINTER;
+
+    pPrps->aGCPhys[0] = u64Prp1;
+    pPrps->cbFirst    = (uint32_t)RT_MIN(cbPage - (u64Prp1 & (cbPage - 1)), cb);
+    pPrps->cPrps      = 1;
+
+    size_t cbLeft = cb - pPrps->cbFirst;
+    if (!cbLeft)
+        return VINF_SUCCESS;
+    if (cbLeft <= cbPage)
+    {
+        /* PRP2 points at the second and last page. */
+        if (u64Prp2 & (cbPage - 1))
+            return VERR_INVALID_POINTER;
+        pPrps->aGCPhys[pPrps->cPrps++] = u64Prp2;
+        return VINF_SUCCESS;
+    }
+
+    /* PRP2 points at a PRP list, the last entry of a list page chains to the next one. */
+    uint32_t cPrpsLeft  = (uint32_t)((cbLeft + cbPage - 1) / cbPage);
+    RTGCPHYS GCPhysList = u64Prp2;
+    if (GCPhysList & 7)
+        return VERR_INVALID_POINTER;
+    while (cPrpsLeft)
+    {
+        uint32_t cEntries = (uint32_t)((cbPage - (GCPhysList & (cbPage - 1))) / sizeof(uint64_t));
+        uint32_t cRead    = RT_MIN(cEntries, cPrpsLeft);
+        bool     fChain   = cPrpsLeft > cEntries;
+        AssertReturn(pPrps->cPrps + cRead <= RT_ELEMENTS(pPrps->aGCPhys), VERR_BUFFER_OVERFLOW);
+
+        PDMDevHlpPhysRead(pThis->pDevInsR3, GCPhysList, &pPrps->aGCPhys[pPrps->cPrps], cRead * sizeof(uint64_t));
+        if (fChain)
+        {
+            /* The last entry read is the pointer to the next list page. */
+            cRead--;
+            GCPhysList = pPrps->aGCPhys[pPrps->cPrps + cRead];
+            if (GCPhysList & (cbPage - 1))
+                return VERR_INVALID_POINTER;
+        }
+        for (uint32_t i = 0; i < cRead; i++)
+            if (pPrps->aGCPhys[pPrps->cPrps + i] & (cbPage - 1))
+                return VERR_INVALID_POINTER;
+        pPrps->cPrps += cRead;
+        cPrpsLeft    -= cRead;
+    }
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * Copies between a data buffer described by PRPs and a host S/G buffer.
+ *
+ * @returns Number of bytes copied.
+ * @param   pThis       The NVMe controller instance.
+ * @param   pPrps       The PRP entries of the data buffer.
+ * @param   offData     Offset into the data buffer.
+ * @param   pSgBuf      The host S/G buffer.
+ * @param   cbCopy      How much to copy.
+ * @param   fToGuest    Direction, true if copying into guest memory.
+ */
+static size_t nvmeR3PrpsCopySgBuf(PNVME pThis, PNVMEPRPS pPrps, size_t offData, PRTSGBUF pSgBuf, size_t cbCopy,
+                                  bool fToGuest)
+{
+    PPDMDEVINS pDevIns = pThis->pDevInsR3;
+    uint32_t   cbPage  = pThis->cbPage;
+    size_t     cbDone  = 0;
+
+    if (offData >= pPrps->cbTotal)
+        return 0;
+    cbCopy = RT_MIN(cbCopy, pPrps->cbTotal - offData);
+
+    /* Locate the entry, all but the first cover a whole page. */
+    uint32_t idxPrp;
+    size_t   offPrp;
+    if (offData < pPrps->cbFirst)
+    {
+        idxPrp = 0;
+        offPrp = offData;
+    }
+    else
+    {
+        idxPrp = 1 + (uint32_t)((offData - pPrps->cbFirst) / cbPage);
+        offPrp = (offData - pPrps->cbFirst) % cbPage;
+    }
+
+    while (cbDone < cbCopy && idxPrp < pPrps->cPrps)
+    {
+        size_t   cbPrp  = idxPrp == 0 ? pPrps->cbFirst : cbPage;
+        RTGCPHYS GCPhys = pPrps->aGCPhys[idxPrp] + offPrp;
+        size_t   cbLeft = RT_MIN(cbPrp - offPrp, cbCopy - cbDone);
+        while (cbLeft)
+        {
+            size_t cbSeg = cbLeft;
+            void *pvSeg = RTSgBufGetNextSegment(pSgBuf, &cbSeg);
+            if (!pvSeg)
+                return cbDone;
+
+            if (fToGuest)
+                PDMDevHlpPCIPhysWrite(pDevIns, GCPhys, pvSeg, cbSeg);
+            else
+                PDMDevHlpPhysRead(pDevIns, GCPhys, pvSeg, cbSeg);
+            GCPhys += cbSeg;
+            cbLeft -= cbSeg;
+            cbDone += cbSeg;
+        }
+        idxPrp++;
+        offPrp = 0;
+    }
+
+    return cbDone;
+}
+
+/**
+ * Copies between a data buffer described by PRPs and a flat host buffer.
+ *
+ * @returns Number of bytes copied.
+ * @param   pThis       The NVMe controller instance.
+ * @param   pPrps       The PRP entries of the data buffer.
+ * @param   offData     Offset into the data buffer.
+ * @param   pvBuf       The host buffer.
+ * @param   cbCopy      How much to copy.
+ * @param   fToGuest    Direction, true if copying into guest memory.
+ */
+static size_t nvmeR3PrpsCopyBuf(PNVME pThis, PNVMEPRPS pPrps, size_t offData, void *pvBuf, size_t cbCopy, bool fToGuest)
+{
+    RTSGSEG Seg;
+    RTSGBUF SgBuf;
+    Seg.pvSeg = pvBuf;
+    Seg.cbSeg = cbCopy;
+    RTSgBufInit(&SgBuf, &Seg, 1);
+    return nvmeR3PrpsCopySgBuf(pThis, pPrps, offData, &SgBuf, cbCopy, fToGuest);
+}
+
+
+/* -=-=-=-=- Interrupts and completions -=-=-=-=- */
+
+/**
+ * Updates the INTx level if MSI-X is not enabled.
+ *
+ * The line is asserted as long as any completion queue with interrupts
+ * enabled has entries the guest did not consume yet.
+ *
+ * @param   pThis       The NVMe controller instance.
+ */
+static void nvmeR3IntxUpdate(PNVME pThis)
+{
+    if (nvmeIsMsixEnabled(pThis))
+        return;
+
+    int rc = PDMCritSectEnter(&pThis->CritSectIntx, VERR_IGNORED);
+    AssertRCReturnVoid(rc);
+
+    bool fAssert = false;
+    if (!(pThis->u32IntrMask & RT_BIT_32(0)))
+    {
+        for (uint32_t i = 0; i <= pThis->cQueuesCompMax && !fAssert; i++)
+        {
+            PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[i];
+            if (   pCq->Hdr.enmState == NVMEQUEUESTATE_CREATED
+                && pCq->fIntrEnabled
+                && nvmeR3CqHeadGet(pThis, pCq) != ASMAtomicReadU32(&pCq->Hdr.idxTail))
+                fAssert = true;
+        }
+    }
+    PDMDevHlpPCISetIrq(pThis->pDevInsR3, 0, fAssert ? PDM_IRQ_LEVEL_HIGH : PDM_IRQ_LEVEL_LOW);
+
+    PDMCritSectLeave(&pThis->CritSectIntx);
+}
+
+/**
+ * Notifies the guest about new entries in the given completion queue.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCq         The completion queue, the mutex must be owned.
+ */
+static void nvmeR3CqIntrRaise(PNVME pThis, PNVMEQUEUECOMP pCq)
+{
+    if (!pCq->fIntrEnabled)
+        return;
+
+    STAM_REL_COUNTER_INC(&pCq->StatIntrs);
+    if (nvmeIsMsixEnabled(pThis))
+        PDMDevHlpPCISetIrq(pThis->pDevInsR3, pCq->u32IntrVec, PDM_IRQ_LEVEL_HIGH);
+    else
+    {
+        /* The level depends on the head, make the guest ring the doorbell when consuming entries. */
+        if (nvmeR3DbBufIsActive(pThis, pCq->Hdr.u16Id))
+            nvmeR3DbBufEvtIdxWrite(pThis, NVME_DB_IDX_CQ(pCq->Hdr.u16Id), nvmeR3CqHeadGet(pThis, pCq));
+        nvmeR3IntxUpdate(pThis);
+    }
+}
+
+/**
+ * Checks whether the given completion queue is full.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCq         The completion queue, the mutex must be owned.
+ */
+DECLINLINE(bool) nvmeR3CqIsFull(PNVME pThis, PNVMEQUEUECOMP pCq)
+{
+    return (pCq->Hdr.idxTail + 1) % pCq->Hdr.cEntries == nvmeR3CqHeadGet(pThis, pCq);
+}
+
+/**
+ * Writes an entry into the given completion queue, there must be room.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCq         The completion queue, the mutex must be owned.
+ * @param   pCqe        The entry, the phase tag is filled in here.
+ */
+static void nvmeR3CqEntryWrite(PNVME pThis, PNVMEQUEUECOMP pCq, PNVMECQE pCqe)
+{
+    RTGCPHYS GCPhys = pCq->Hdr.GCPhysBase + (RTGCPHYS)pCq->Hdr.idxTail * sizeof(NVMECQE);
+
+    pCqe->u16Status = (pCqe->u16Status & ~(uint16_t)1) | (pCq->fPhase ? 1 : 0);
+
+    /* Write the dword containing the phase tag last, the guest polls on it. */
+    PDMDevHlpPCIPhysWrite(pThis->pDevInsR3, GCPhys, pCqe, RT_UOFFSETOF(NVMECQE, u16Cid));
+    PDMDevHlpPCIPhysWrite(pThis->pDevInsR3, GCPhys + RT_UOFFSETOF(NVMECQE, u16Cid), &pCqe->u16Cid,
+                          sizeof(NVMECQE) - RT_UOFFSETOF(NVMECQE, u16Cid));
+
+    uint32_t idxTail = pCq->Hdr.idxTail + 1;
+    if (idxTail == pCq->Hdr.cEntries)
+    {
+        idxTail = 0;
+        pCq->fPhase = !pCq->fPhase;
+    }
+    ASMAtomicWriteU32(&pCq->Hdr.idxTail, idxTail);
+}
+
+/**
+ * Raises the interrupt of the given completion queue or defers it until the
+ * workers feeding it are done.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCq         The completion queue, the mutex must be owned.
+ */
+static void nvmeR3CqNotify(PNVME pThis, PNVMEQUEUECOMP pCq)
+{
+    if (pCq->cSubmQueuesProcessing)
+    {
+        STAM_REL_COUNTER_INC(&pThis->StatIntrsBatched);
+        pCq->fIntrPending = true;
+    }
+    else
+        nvmeR3CqIntrRaise(pThis, pCq);
+}
+
+/**
+ * Posts the completions waiting for room in the given completion queue.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCq         The completion queue, the mutex must be owned.
+ */
+static void nvmeR3CqWaitersFlush(PNVME pThis, PNVMEQUEUECOMP pCq)
+{
+    bool fPosted = false;
+    PNVMECOMPWAITER pWaiter, pWaiterNext;
+    RTListForEachSafe(&pCq->LstCompletionsWaiting, pWaiter, pWaiterNext, NVMECOMPWAITER, NdLstWait)
+    {
+        if (nvmeR3CqIsFull(pThis, pCq))
+            break;
+        nvmeR3CqEntryWrite(pThis, pCq, &pWaiter->Cqe);
+        RTListNodeRemove(&pWaiter->NdLstWait);
+        ASMAtomicDecU32(&pCq->cWaiters);
+        RTMemFree(pWaiter);
+        fPosted = true;
+    }
+
+    /* Make sure the guest rings the doorbell once it consumed entries. */
+    if (   pCq->cWaiters
+        && nvmeR3DbBufIsActive(pThis, pCq->Hdr.u16Id))
+        nvmeR3DbBufEvtIdxWrite(pThis, NVME_DB_IDX_CQ(pCq->Hdr.u16Id), nvmeR3CqHeadGet(pThis, pCq));
+
+    if (fPosted)
+        nvmeR3CqNotify(pThis, pCq);
+}
+
+/**
+ * Called when the guest updated the head of a completion queue.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCq         The completion queue.
+ */
+static void nvmeR3CqHeadUpdated(PNVME pThis, PNVMEQUEUECOMP pCq)
+{
+    STAM_REL_COUNTER_INC(&pThis->StatDoorbellWritesCqR3);
+    RTSemFastMutexRequest(pCq->hMtx);
+    if (pCq->cWaiters)
+        nvmeR3CqWaitersFlush(pThis, pCq);
+    RTSemFastMutexRelease(pCq->hMtx);
+    nvmeR3IntxUpdate(pThis);
+}
+
+/**
+ * Posts the completion of a command.
+ *
+ * The completion is dropped if the submission queue was deleted after the
+ * command was fetched.  If the completion queue is full the entry is queued
+ * until the guest makes room.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   u16SqId     The submission queue the command was fetched from.
+ * @param   u16CqId     The completion queue.
+ * @param   uGen        Generation of the submission queue at fetch time.
+ * @param   u16Cid      The command ID.
+ * @param   u16Status   The status (NVME_STATUS_XXX).
+ * @param   u32Dw0      Command specific dword 0.
+ */
+static void nvmeR3CqPost(PNVME pThis, uint16_t u16SqId, uint16_t u16CqId, uint32_t uGen, uint16_t u16Cid,
+                         uint16_t u16Status, uint32_t u32Dw0)
+{
+    PNVMEQUEUESUBM pSq = &pThis->aQueuesSubm[u16SqId];
+    PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[u16CqId];
+
+    if (u16Status != NVME_STATUS_SUCCESS)
+    {
+        STAM_REL_COUNTER_INC(&pThis->StatCmdsFailed);
+        /* Retrying does not help with anything but internal errors and media errors. */
+        if (   u16Status != NVME_STATUS_INTERNAL_ERROR
+            && u16Status != NVME_STATUS_ABORT_REQUESTED
+            && (u16Status >> 8) != 2)
+            u16Status |= NVME_STATUS_DNR;
+    }
+
+    RTSemFastMutexRequest(pCq->hMtx);
+    if (   uGen == ASMAtomicReadU32(&pSq->uGen)
+        && pSq->Hdr.enmState == NVMEQUEUESTATE_CREATED
+        && pCq->Hdr.enmState == NVMEQUEUESTATE_CREATED)
+    {
+        NVMECQE Cqe;
+        Cqe.u32Dw0      = u32Dw0;
+        Cqe.u32Reserved = 0;
+        Cqe.u16SqHead   = (uint16_t)pSq->Hdr.idxHead;
+        Cqe.u16SqId     = u16SqId;
+        Cqe.u16Cid      = u16Cid;
+        Cqe.u16Status   = (uint16_t)(u16Status << 1);
+
+        if (   !pCq->cWaiters
+            && !nvmeR3CqIsFull(pThis, pCq))
+        {
+            nvmeR3CqEntryWrite(pThis, pCq, &Cqe);
+            nvmeR3CqNotify(pThis, pCq);
+        }
+        else
+        {
+            STAM_REL_COUNTER_INC(&pThis->StatCqFull);
+            PNVMECOMPWAITER pWaiter = (PNVMECOMPWAITER)RTMemAlloc(sizeof(*pWaiter));
+            if (pWaiter)
+            {
+                pWaiter->Cqe = Cqe;
+                RTListAppend(&pCq->LstCompletionsWaiting, &pWaiter->NdLstWait);
+                ASMAtomicIncU32(&pCq->cWaiters);
+                /* Recheck, the guest might have made room before seeing the waiter (see nvmeDoorbellWrite). */
+                nvmeR3CqWaitersFlush(pThis, pCq);
+            }
+            else
+                LogRel(("NVMe#%u: Out of memory, dropping completion of command %#x on queue %u\n",
+                        pThis->pDevInsR3->iInstance, u16Cid, u16SqId));
+        }
+    }
+    else
+        Log(("nvmeR3CqPost: Dropping completion of command %#x from deleted queue %u\n", u16Cid, u16SqId));
+    RTSemFastMutexRelease(pCq->hMtx);
+}
+
+/**
+ * Posts the completion of an admin command.
+ */
+DECLINLINE(void) nvmeR3AdminCmdComplete(PNVME pThis, uint16_t u16Cid, uint16_t u16Status, uint32_t u32Dw0)
+{
+    nvmeR3CqPost(pThis, 0, 0, ASMAtomicReadU32(&pThis->aQueuesSubm[0].uGen), u16Cid, u16Status, u32Dw0);
+}
+
+
+/* -=-=-=-=- I/O commands -=-=-=-=- */
+
+/**
+ * Returns the namespace with the given ID, NULL if the ID is invalid.
+ */
+DECLINLINE(PNVMENAMESPACE) nvmeR3NamespaceGet(PNVME pThis, uint32_t u32Nsid)
+{
+    if (u32Nsid - 1 < pThis->cNamespaces)
+        return &pThis->paNamespaces[u32Nsid - 1];
+    return NULL;
+}
+
+/**
+ * Checks whether the given block range lies within the namespace.
+ */
+DECLINLINE(bool) nvmeR3NamespaceIsRangeValid(PNVMENAMESPACE pNs, uint64_t uLba, uint32_t cBlocks)
+{
+    return    uLba < pNs->cBlocks
+           && cBlocks <= pNs->cBlocks - uLba;
+}
+
+/**
+ * Converts the status code a request completed with to a completion status.
+ *
+ * @returns NVMe status (NVME_STATUS_XXX).
+ * @param   u8Opc       The opcode of the command.
+ * @param   rc          The status code.
+ */
+static uint16_t nvmeR3StatusFromRc(uint8_t u8Opc, int rc)
+{
+    if (RT_SUCCESS(rc))
+        return NVME_STATUS_SUCCESS;
+
+    switch (rc)
+    {
+        case VERR_OUT_OF_RANGE:                 return NVME_STATUS_LBA_OUT_OF_RANGE;
+        case VERR_WRITE_PROTECT:                return NVME_STATUS_WRITE_TO_RO_RANGE;
+        case VERR_NOT_SUPPORTED:                return NVME_STATUS_INVALID_OPCODE;
+        case VERR_INVALID_POINTER:              return NVME_STATUS_INVALID_PRP_OFFSET;
+        case VERR_INVALID_PARAMETER:
+        case VERR_BUFFER_OVERFLOW:              return NVME_STATUS_INVALID_FIELD;
+        case VERR_PDM_MEDIAEX_IOREQ_CANCELED:   return NVME_STATUS_ABORT_REQUESTED;
+        case VERR_PDM_MEDIAEX_IOBUF_OVERFLOW:
+        case VERR_PDM_MEDIAEX_IOBUF_UNDERRUN:   return NVME_STATUS_DATA_XFER_ERROR;
+        default:
+            break;
+    }
+
+    if (u8Opc == NVME_NVM_READ)
+        return NVME_STATUS_UNRECOVERED_READ_ERROR;
+    if (u8Opc == NVME_NVM_WRITE || u8Opc == NVME_NVM_WRITE_ZEROES)
+        return NVME_STATUS_WRITE_FAULT;
+    return NVME_STATUS_INTERNAL_ERROR;
+}
+
+/**
+ * Checks whether the controller is idle, i.e. no worker is processing queues
+ * and no request is active.
+ */
+static bool nvmeR3IsIdle(PNVME pThis)
+{
+    if (ASMAtomicReadU32(&pThis->cWrkThrdsActive))
+        return false;
+    for (uint32_t i = 0; i < RT_ELEMENTS(pThis->aQueuesSubm); i++)
+        if (ASMAtomicReadU32(&pThis->aQueuesSubm[i].cReqsActive))
+            return false;
+    return true;
+}
+
+/**
+ * Completes an I/O request, frees it and posts the completion.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pReq        The request to complete.
+ * @param   rcReq       The status code the request completed with.
+ */
+static void nvmeR3ReqComplete(PNVME pThis, PNVMEREQ pReq, int rcReq)
+{
+    PNVMENAMESPACE pNs       = pReq->pNamespace;
+    uint8_t const  u8Opc     = pReq->Cmd.u8Opc;
+    uint16_t const u16Status = nvmeR3StatusFromRc(u8Opc, rcReq);
+
+    if (RT_SUCCESS(rcReq))
+    {
+        if (u8Opc == NVME_NVM_READ)
+            STAM_REL_COUNTER_ADD(&pThis->StatBytesRead, pReq->cbXfer);
+        else if (u8Opc == NVME_NVM_WRITE)
+            STAM_REL_COUNTER_ADD(&pThis->StatBytesWritten, pReq->cbXfer);
+    }
+    else if (rcReq != VERR_PDM_MEDIAEX_IOREQ_CANCELED)
+        LogRel(("NVMe#%u: Command %#x at offset %llu (%zu bytes) on namespace %u failed with %Rrc\n",
+                pThis->pDevInsR3->iInstance, u8Opc, pReq->offStart, pReq->cbXfer, pNs->u32Id, rcReq));
+
+    if (u8Opc == NVME_NVM_READ)
+        pNs->Led.Actual.s.fReading = 0;
+    else
+        pNs->Led.Actual.s.fWriting = 0;
+
+    uint16_t const u16SqId  = pReq->u16SqId;
+    uint16_t const u16CqId  = pReq->u16CqId;
+    uint32_t const uGen     = pReq->uGen;
+    uint16_t const u16Cid   = pReq->Cmd.u16Cid;
+    pNs->pDrvMediaEx->pfnIoReqFree(pNs->pDrvMediaEx, pReq->hIoReq);
+
+    nvmeR3CqPost(pThis, u16SqId, u16CqId, uGen, u16Cid, u16Status, 0);
+
+    ASMAtomicDecU32(&pThis->aQueuesSubm[u16SqId].cReqsActive);
+    if (pThis->fSignalIdle && nvmeR3IsIdle(pThis))
+        PDMDevHlpAsyncNotificationCompleted(pThis->pDevInsR3);
+}
+
+/**
+ * Submits an I/O command to the driver below.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pSq         The submission queue the command was fetched from.
+ * @param   pCmd        The command.
+ */
+static void nvmeR3IoCmdSubmit(PNVME pThis, PNVMEQUEUESUBM pSq, PCNVMECMD pCmd)
+{
+    uint16_t const u16SqId = pSq->Hdr.u16Id;
+    uint16_t const u16CqId = pSq->u16CompletionQueueId;
+    uint32_t const uGen    = ASMAtomicReadU32(&pSq->uGen);
+
+    PNVMENAMESPACE pNs = nvmeR3NamespaceGet(pThis, pCmd->u32Nsid);
+    if (!pNs || !pNs->pDrvMediaEx)
+    {
+        nvmeR3CqPost(pThis, u16SqId, u16CqId, uGen, pCmd->u16Cid,
+                     pNs ? NVME_STATUS_NS_NOT_READY : NVME_STATUS_INVALID_NAMESPACE, 0);
+        return;
+    }
+
+    PDMMEDIAEXIOREQ hIoReq = NULL;
+    PNVMEREQ        pReq   = NULL;
+    int rc = pNs->pDrvMediaEx->pfnIoReqAlloc(pNs->pDrvMediaEx, &hIoReq, (void **)&pReq,
+                                             ((PDMMEDIAEXIOREQID)uGen << 32) | ((uint32_t)u16SqId << 16) | pCmd->u16Cid,
+                                             PDMIMEDIAEX_F_SUSPEND_ON_RECOVERABLE_ERR);
+    if (RT_FAILURE(rc))
+    {
+        nvmeR3CqPost(pThis, u16SqId, u16CqId, uGen, pCmd->u16Cid,
+                     rc == VERR_PDM_MEDIAEX_IOREQID_CONFLICT ? NVME_STATUS_CID_CONFLICT : NVME_STATUS_INTERNAL_ERROR, 0);
+        return;
+    }
+
+    ASMAtomicIncU32(&pSq->cReqsActive);
+    pReq->hIoReq     = hIoReq;
+    pReq->pNamespace = pNs;
+    pReq->Cmd        = *pCmd;
+    pReq->u16SqId    = u16SqId;
+    pReq->u16CqId    = u16CqId;
+    pReq->uGen       = uGen;
+    pReq->offStart   = 0;
+    pReq->cbXfer     = 0;
+    pReq->cRanges    = 0;
+    pReq->Prps.cPrps = 0;
+
+    uint64_t const uLba    = RT_MAKE_U64(NVME_CMD_CDW(pCmd, 10), NVME_CMD_CDW(pCmd, 11));
+    uint32_t const cBlocks = (NVME_CMD_CDW(pCmd, 12) & 0xffff) + 1;
+    switch (pCmd->u8Opc)
+    {
+        case NVME_NVM_READ:
+        case NVME_NVM_WRITE:
+        {
+            bool const fWrite = pCmd->u8Opc == NVME_NVM_WRITE;
+            if (fWrite)
+            {
+                STAM_REL_COUNTER_INC(&pThis->StatCmdsWrite);
+                pNs->Led.Asserted.s.fWriting = pNs->Led.Actual.s.fWriting = 1;
+            }
+            else
+            {
+                STAM_REL_COUNTER_INC(&pThis->StatCmdsRead);
+                pNs->Led.Asserted.s.fReading = pNs->Led.Actual.s.fReading = 1;
+            }
+
+            pReq->offStart = uLba << pNs->cBlockShift;
+            pReq->cbXfer   = (size_t)cBlocks << pNs->cBlockShift;
+            if (fWrite && pNs->fReadOnly)
+                rc = VERR_WRITE_PROTECT;
+            else if (!nvmeR3NamespaceIsRangeValid(pNs, uLba, cBlocks))
+                rc = VERR_OUT_OF_RANGE;
+            else if (pReq->cbXfer > NVME_XFER_MAX)
+                rc = VERR_BUFFER_OVERFLOW;
+            else
+            {
+                rc = nvmeR3PrpsParse(pThis, pCmd->u64Prp1, pCmd->u64Prp2, pReq->cbXfer, &pReq->Prps);
+                if (RT_SUCCESS(rc))
+                {
+                    if (fWrite)
+                        rc = pNs->pDrvMediaEx->pfnIoReqWrite(pNs->pDrvMediaEx, hIoReq, pReq->offStart, pReq->cbXfer);
+                    else
+                        rc = pNs->pDrvMediaEx->pfnIoReqRead(pNs->pDrvMediaEx, hIoReq, pReq->offStart, pReq->cbXfer);
+                }
+            }
+            break;
+        }
+
+        case NVME_NVM_FLUSH:
+            STAM_REL_COUNTER_INC(&pThis->StatCmdsFlush);
+            pNs->Led.Asserted.s.fWriting = pNs->Led.Actual.s.fWriting = 1;
+            rc = pNs->pDrvMediaEx->pfnIoReqFlush(pNs->pDrvMediaEx, hIoReq);
+            break;
+
+        case NVME_NVM_WRITE_ZEROES:
+            /* Done as an ordinary write with the buffer filled in nvmeR3IoReqCopyToBuf. */
+            STAM_REL_COUNTER_INC(&pThis->StatCmdsWriteZeroes);
+            pNs->Led.Asserted.s.fWriting = pNs->Led.Actual.s.fWriting = 1;
+            pReq->offStart = uLba << pNs->cBlockShift;
+            pReq->cbXfer   = (size_t)cBlocks << pNs->cBlockShift;
+            if (pNs->fReadOnly)
+                rc = VERR_WRITE_PROTECT;
+            else if (!nvmeR3NamespaceIsRangeValid(pNs, uLba, cBlocks))
+                rc = VERR_OUT_OF_RANGE;
+            else
+                rc = pNs->pDrvMediaEx->pfnIoReqWrite(pNs->pDrvMediaEx, hIoReq, pReq->offStart, pReq->cbXfer);
+            break;
+
+        case NVME_NVM_DSM:
+            STAM_REL_COUNTER_INC(&pThis->StatCmdsDsm);
+            pNs->Led.Asserted.s.fWriting = pNs->Led.Actual.s.fWriting = 1;
+            /* Only deallocate does anything, the other attributes are hints. */
+            rc = VINF_SUCCESS;
+            if (NVME_CMD_CDW(pCmd, 11) & RT_BIT_32(2))
+            {
+                pReq->cRanges = (NVME_CMD_CDW(pCmd, 10) & 0xff) + 1;
+                Assert(pReq->cRanges <= NVME_DSM_RANGES_MAX);
+                rc = nvmeR3PrpsParse(pThis, pCmd->u64Prp1, pCmd->u64Prp2, pReq->cRanges * sizeof(NVMEDSMRANGE), &pReq->Prps);
+                if (RT_SUCCESS(rc) && pNs->fDiscard && !pNs->fReadOnly)
+                    rc = pNs->pDrvMediaEx->pfnIoReqDiscard(pNs->pDrvMediaEx, hIoReq, pReq->cRanges);
+            }
+            break;
+
+        default:
+            Log(("nvmeR3IoCmdSubmit: Unsupported opcode %#x\n", pCmd->u8Opc));
+            rc = VERR_NOT_SUPPORTED;
+            break;
+    }
+
+    if (rc != VINF_PDM_MEDIAEX_IOREQ_IN_PROGRESS)
+        nvmeR3ReqComplete(pThis, pReq, rc);
+}
+
+
+/* -=-=-=-=- Queue management -=-=-=-=- */
+
+/**
+ * Creates a completion queue.
+ *
+ * @param   pThis           The NVMe controller instance.
+ * @param   u16Id           The queue ID.
+ * @param   GCPhysBase      Guest physical base address of the queue.
+ * @param   cEntries        Number of entries.
+ * @param   fIntrEnabled    Whether interrupts are enabled.
+ * @param   u32IntrVec      The MSI-X vector.
+ */
+static void nvmeR3CqCreate(PNVME pThis, uint16_t u16Id, RTGCPHYS GCPhysBase, uint32_t cEntries, bool fIntrEnabled,
+                           uint32_t u32IntrVec)
+{
+    PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[u16Id];
+
+    RTSemFastMutexRequest(pCq->hMtx);
+    Assert(pCq->Hdr.enmState == NVMEQUEUESTATE_FREE);
+    Assert(RTListIsEmpty(&pCq->LstCompletionsWaiting));
+    pCq->Hdr.GCPhysBase         = GCPhysBase;
+    pCq->Hdr.cEntries           = cEntries;
+    pCq->Hdr.cbEntry            = sizeof(NVMECQE);
+    pCq->Hdr.fPhysCont          = true;
+    pCq->Hdr.idxHead            = 0;
+    pCq->Hdr.idxTail            = 0;
+    pCq->fIntrEnabled           = fIntrEnabled;
+    pCq->fPhase                 = true;
+    pCq->fIntrPending           = false;
+    pCq->u32IntrVec             = u32IntrVec;
+    pCq->cSubmQueuesRef         = 0;
+    pCq->cSubmQueuesProcessing  = 0;
+    pCq->cWaiters               = 0;
+    if (nvmeR3DbBufIsActive(pThis, u16Id))
+    {
+        uint32_t const u32Zero = 0;
+        PDMDevHlpPCIPhysWrite(pThis->pDevInsR3, pThis->GCPhysDbBufShadow + NVME_DB_IDX_CQ(u16Id) * sizeof(uint32_t),
+                              &u32Zero, sizeof(u32Zero));
+        nvmeR3DbBufEvtIdxWrite(pThis, NVME_DB_IDX_CQ(u16Id), 0);
+    }
+    ASMAtomicWriteU32((volatile uint32_t *)&pCq->Hdr.enmState, NVMEQUEUESTATE_CREATED);
+    RTSemFastMutexRelease(pCq->hMtx);
+
+    Log(("nvmeR3CqCreate: Created completion queue %u at %RGp with %u entries (vector %u%s)\n",
+         u16Id, GCPhysBase, cEntries, u32IntrVec, fIntrEnabled ? "" : ", interrupts disabled"));
+}
+
+/**
+ * Deletes a completion queue, dropping any completions waiting for room.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCq         The completion queue.
+ */
+static void nvmeR3CqDelete(PNVME pThis, PNVMEQUEUECOMP pCq)
+{
+    RT_NOREF(pThis);
+    RTSemFastMutexRequest(pCq->hMtx);
+    ASMAtomicWriteU32((volatile uint32_t *)&pCq->Hdr.enmState, NVMEQUEUESTATE_FREE);
+
+    PNVMECOMPWAITER pWaiter, pWaiterNext;
+    RTListForEachSafe(&pCq->LstCompletionsWaiting, pWaiter, pWaiterNext, NVMECOMPWAITER, NdLstWait)
+    {
+        RTListNodeRemove(&pWaiter->NdLstWait);
+        RTMemFree(pWaiter);
+    }
+    ASMAtomicWriteU32(&pCq->cWaiters, 0);
+    pCq->fIntrPending = false;
+    RTSemFastMutexRelease(pCq->hMtx);
+
+    Log(("nvmeR3CqDelete: Deleted completion queue %u\n", pCq->Hdr.u16Id));
+}
+
+/**
+ * Creates a submission queue and assigns it to a worker thread.
+ *
+ * @param   pThis           The NVMe controller instance.
+ * @param   u16Id           The queue ID.
+ * @param   GCPhysBase      Guest physical base address of the queue.
+ * @param   cEntries        Number of entries.
+ * @param   u16CqId         The completion queue to post completions to, must exist.
+ * @param   enmPriority     The queue priority.
+ */
+static void nvmeR3SqCreate(PNVME pThis, uint16_t u16Id, RTGCPHYS GCPhysBase, uint32_t cEntries, uint16_t u16CqId,
+                           NVMEQUEUEPRIO enmPriority)
+{
+    PNVMEQUEUESUBM pSq      = &pThis->aQueuesSubm[u16Id];
+    PNVMEQUEUECOMP pCq      = &pThis->aQueuesComp[u16CqId];
+    PNVMEWRKTHRD   pWrkThrd = &pThis->paWrkThrds[u16Id % pThis->cWrkThrdsMax];
+
+    Assert(pSq->Hdr.enmState == NVMEQUEUESTATE_FREE);
+    pSq->Hdr.GCPhysBase         = GCPhysBase;
+    pSq->Hdr.cEntries           = cEntries;
+    pSq->Hdr.cbEntry            = sizeof(NVMECMD);
+    pSq->Hdr.fPhysCont          = true;
+    pSq->Hdr.idxHead            = 0;
+    pSq->Hdr.idxTail            = 0;
+    pSq->u16CompletionQueueId   = u16CqId;
+    pSq->enmPriority            = enmPriority;
+    pSq->hEvtProcess            = pWrkThrd->hEvtProcess;
+    pSq->pWrkThrdR3             = pWrkThrd;
+    if (nvmeR3DbBufIsActive(pThis, u16Id))
+    {
+        uint32_t const u32Zero = 0;
+        PDMDevHlpPCIPhysWrite(pThis->pDevInsR3, pThis->GCPhysDbBufShadow + NVME_DB_IDX_SQ(u16Id) * sizeof(uint32_t),
+                              &u32Zero, sizeof(u32Zero));
+        nvmeR3DbBufEvtIdxWrite(pThis, NVME_DB_IDX_SQ(u16Id), 0);
+    }
+
+    RTSemFastMutexRequest(pCq->hMtx);
+    pCq->cSubmQueuesRef++;
+    RTSemFastMutexRelease(pCq->hMtx);
+
+    RTCritSectEnter(&pWrkThrd->CritSect);
+    RTListAppend(&pWrkThrd->LstSubmQueuesAssgnd, &pSq->NdLstWrkThrdAssgnd);
+    pWrkThrd->cSubmQueuesAssgnd++;
+    ASMAtomicWriteU32((volatile uint32_t *)&pSq->Hdr.enmState, NVMEQUEUESTATE_CREATED);
+    RTCritSectLeave(&pWrkThrd->CritSect);
+
+    Log(("nvmeR3SqCreate: Created submission queue %u at %RGp with %u entries on worker %u (completion queue %u)\n",
+         u16Id, GCPhysBase, cEntries, pWrkThrd->idWrkThrd, u16CqId));
+}
+
+/**
+ * Deletes a submission queue.
+ *
+ * Commands already submitted to the driver below are not waited for, their
+ * completions are dropped because the queue generation changes.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pSq         The submission queue.
+ */
+static void nvmeR3SqDelete(PNVME pThis, PNVMEQUEUESUBM pSq)
+{
+    PNVMEWRKTHRD   pWrkThrd = pSq->pWrkThrdR3;
+    PNVMEQUEUECOMP pCq      = &pThis->aQueuesComp[pSq->u16CompletionQueueId];
+
+    RTCritSectEnter(&pWrkThrd->CritSect);
+    RTListNodeRemove(&pSq->NdLstWrkThrdAssgnd);
+    pWrkThrd->cSubmQueuesAssgnd--;
+    RTCritSectLeave(&pWrkThrd->CritSect);
+
+    RTSemFastMutexRequest(pCq->hMtx);
+    ASMAtomicIncU32(&pSq->uGen);
+    ASMAtomicWriteU32((volatile uint32_t *)&pSq->Hdr.enmState, NVMEQUEUESTATE_FREE);
+    pCq->cSubmQueuesRef--;
+    RTSemFastMutexRelease(pCq->hMtx);
+
+    /* The event semaphore stays valid, a racing doorbell write in ring-0 may still use it. */
+    pSq->pWrkThrdR3 = NULL;
+
+    Log(("nvmeR3SqDelete: Deleted submission queue %u\n", pSq->Hdr.u16Id));
+}
+
+/**
+ * Enters the critical sections of all worker threads, stopping all queue
+ * processing.
+ */
+static void nvmeR3WrkThrdsLock(PNVME pThis)
+{
+    for (uint32_t i = 0; i < pThis->cWrkThrdsMax; i++)
+        RTCritSectEnter(&pThis->paWrkThrds[i].CritSect);
+}
+
+/**
+ * Leaves the critical sections entered by nvmeR3WrkThrdsLock.
+ */
+static void nvmeR3WrkThrdsUnlock(PNVME pThis)
+{
+    for (uint32_t i = pThis->cWrkThrdsMax; i-- > 0;)
+        RTCritSectLeave(&pThis->paWrkThrds[i].CritSect);
+}
+
+/**
+ * Wakes up all worker threads.
+ */
+static void nvmeR3WrkThrdsWakeUp(PNVME pThis)
+{
+    for (uint32_t i = 0; i < pThis->cWrkThrdsMax; i++)
+    {
+        int rc = SUPSemEventSignal(pThis->pSupDrvSession, pThis->paWrkThrds[i].hEvtProcess);
+        AssertRC(rc);
+    }
+}
+
+
+/* -=-=-=-=- Asynchronous events -=-=-=-=- */
+
+/**
+ * Completes an outstanding asynchronous event request if an unmasked event
+ * is pending.
+ *
+ * @param   pThis       The NVMe controller instance, the async event
+ *                      critical section must be owned.
+ */
+static void nvmeR3AsyncEvtDispatch(PNVME pThis)
+{
+    Assert(PDMCritSectIsOwner(&pThis->CritSectAsyncEvtReqs));
+
+    if (   pThis->fAsyncEvtNsChangedPending
+        && !pThis->fAsyncEvtNsChangedMasked
+        && (pThis->u32FeatAsyncEvtCfg & NVME_ASYNC_EVT_CFG_NS_ATTR)
+        && pThis->cAsyncEvtReqs)
+    {
+        uint16_t const u16Cid = pThis->aAsyncEvtReqCids[--pThis->cAsyncEvtReqs];
+        pThis->fAsyncEvtNsChangedPending = false;
+        pThis->fAsyncEvtNsChangedMasked  = true;
+        nvmeR3AdminCmdComplete(pThis, u16Cid, NVME_STATUS_SUCCESS, NVME_ASYNC_EVT_NS_ATTR_CHANGED);
+    }
+}
+
+/**
+ * Records a changed namespace and notifies the guest.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   u32Nsid     The namespace ID.
+ */
+static void nvmeR3AsyncEvtNsChanged(PNVME pThis, uint32_t u32Nsid)
+{
+    if (pThis->enmState != NVMESTATE_READY)
+        return;
+
+    int rc = PDMCritSectEnter(&pThis->CritSectAsyncEvtReqs, VERR_IGNORED);
+    AssertRCReturnVoid(rc);
+    ASMBitSet(&pThis->bmNsChanged[0], u32Nsid - 1);
+    pThis->fAsyncEvtNsChangedPending = true;
+    nvmeR3AsyncEvtDispatch(pThis);
+    PDMCritSectLeave(&pThis->CritSectAsyncEvtReqs);
+}
+
+
+/* -=-=-=-=- Admin commands -=-=-=-=- */
+
+/**
+ * Copies the data of an admin command into the guest buffer given by the PRPs.
+ *
+ * @returns NVMe status.
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCmd        The command.
+ * @param   pvBuf       The data.
+ * @param   cb          Size of the data.
+ */
+static uint16_t nvmeR3AdminDataToGuest(PNVME pThis, PCNVMECMD pCmd, void *pvBuf, size_t cb)
+{
+    NVMEPRPS Prps;
+    int rc = nvmeR3PrpsParse(pThis, pCmd->u64Prp1, pCmd->u64Prp2, cb, &Prps);
+    if (RT_FAILURE(rc))
+        return NVME_STATUS_INVALID_PRP_OFFSET;
+    nvmeR3PrpsCopyBuf(pThis, &Prps, 0, pvBuf, cb, true /*fToGuest*/);
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Copies a string into an identify data field, padding it with spaces.
+ */
+static void nvmeR3IdentifyStrCopy(uint8_t *pbDst, size_t cbDst, const char *pszSrc)
+{
+    size_t cchSrc = strlen(pszSrc);
+    memset(pbDst, ' ', cbDst);
+    memcpy(pbDst, pszSrc, RT_MIN(cchSrc, cbDst));
+}
+
+/**
+ * Processes the identify command.
+ */
+static uint16_t nvmeR3AdminIdentify(PNVME pThis, PCNVMECMD pCmd)
+{
+    uint8_t abBuf[NVME_PAGE_SIZE];
+    RT_ZERO(abBuf);
+
+    switch (NVME_CMD_CDW(pCmd, 10) & 0xff)
+    {
+        case NVME_IDENTIFY_CNS_CONTROLLER:
+        {
+            *(uint16_t *)&abBuf[0]   = NVME_PCI_VENDOR_ID;              /* VID */
+            *(uint16_t *)&abBuf[2]   = NVME_PCI_VENDOR_ID;              /* SSVID */
+            nvmeR3IdentifyStrCopy(&abBuf[4],  NVME_SERIAL_NUMBER_LENGTH,     pThis->szSerialNumber);
+            nvmeR3IdentifyStrCopy(&abBuf[24], NVME_MODEL_NUMBER_LENGTH,      pThis->szModelNumber);
+            nvmeR3IdentifyStrCopy(&abBuf[64], NVME_FIRMWARE_REVISION_LENGTH, pThis->szFirmwareRevision);
+            abBuf[72]                = 6;                               /* RAB */
+            abBuf[73]                = 0x00;                            /* IEEE OUI 08:00:27 (LSB first). */
+            abBuf[74]                = 0x27;
+            abBuf[75]                = 0x08;
+            abBuf[77]                = NVME_MDTS;                       /* MDTS */
+            *(uint32_t *)&abBuf[80]  = NVME_VS_1_3;                     /* VER */
+            *(uint32_t *)&abBuf[92]  = NVME_ASYNC_EVT_CFG_NS_ATTR;      /* OAES */
+            *(uint16_t *)&abBuf[256] = RT_BIT(8);                       /* OACS: Doorbell Buffer Config */
+            abBuf[258]               = 3;                               /* ACL */
+            abBuf[259]               = NVME_ASYNC_EVT_REQS_MAX - 1;     /* AERL */
+            abBuf[260]               = 0x3;                             /* FRMW: one read only slot */
+            abBuf[261]               = RT_BIT(2);                       /* LPA: extended data for Get Log Page */
+            abBuf[512]               = (NVME_SQ_ENTRY_SIZE_LOG2 << 4) | NVME_SQ_ENTRY_SIZE_LOG2; /* SQES */
+            abBuf[513]               = (NVME_CQ_ENTRY_SIZE_LOG2 << 4) | NVME_CQ_ENTRY_SIZE_LOG2; /* CQES */
+            *(uint32_t *)&abBuf[516] = pThis->cNamespaces;              /* NN */
+            *(uint16_t *)&abBuf[520] = RT_BIT(2) | RT_BIT(3);           /* ONCS: DSM and Write Zeroes */
+            abBuf[525]               = 1;                               /* VWC */
+            RTStrPrintf((char *)&abBuf[768], 256, "nqn.2014.08.org.nvmexpress:%04x%04x%-20s%-40s",
+                        NVME_PCI_VENDOR_ID, NVME_PCI_VENDOR_ID, pThis->szSerialNumber, pThis->szModelNumber);
+            *(uint16_t *)&abBuf[2048] = 2500;                           /* PSD0: MP, 25W */
+            break;
+        }
+
+        case NVME_IDENTIFY_CNS_NAMESPACE:
+        {
+            PNVMENAMESPACE pNs = nvmeR3NamespaceGet(pThis, pCmd->u32Nsid);
+            if (!pNs)
+                return NVME_STATUS_INVALID_NAMESPACE;
+            /* Inactive namespaces return all zeros. */
+            if (pNs->pDrvMediaEx)
+            {
+                *(uint64_t *)&abBuf[0]   = pNs->cBlocks;                /* NSZE */
+                *(uint64_t *)&abBuf[8]   = pNs->cBlocks;                /* NCAP */
+                *(uint64_t *)&abBuf[16]  = pNs->cBlocks;                /* NUSE */
+                *(uint32_t *)&abBuf[128] = pNs->cBlockShift << 16;      /* LBAF0: LBADS */
+            }
+            break;
+        }
+
+        case NVME_IDENTIFY_CNS_ACTIVE_NS_LIST:
+        {
+            uint32_t *pau32Ids = (uint32_t *)&abBuf[0];
+            uint32_t  cIds     = 0;
+            for (uint32_t i = 0; i < pThis->cNamespaces && cIds < NVME_PAGE_SIZE / sizeof(uint32_t); i++)
+                if (   pThis->paNamespaces[i].u32Id > pCmd->u32Nsid
+                    && pThis->paNamespaces[i].pDrvMediaEx)
+                    pau32Ids[cIds++] = pThis->paNamespaces[i].u32Id;
+            break;
+        }
+
+        case NVME_IDENTIFY_CNS_NS_ID_DESC_LIST:
+            if (!nvmeR3NamespaceGet(pThis, pCmd->u32Nsid))
+                return NVME_STATUS_INVALID_NAMESPACE;
+            /* No identifiers besides the namespace ID. */
+            break;
+
+        default:
+            return NVME_STATUS_INVALID_FIELD;
+    }
+
+    return nvmeR3AdminDataToGuest(pThis, pCmd, abBuf, sizeof(abBuf));
+}
+
+/**
+ * Processes the Create I/O Completion Queue command.
+ */
+static uint16_t nvmeR3AdminCreateIoCq(PNVME pThis, PCNVMECMD pCmd)
+{
+    uint16_t const u16Id      = (uint16_t)NVME_CMD_CDW(pCmd, 10);
+    uint32_t const cEntries   = (NVME_CMD_CDW(pCmd, 10) >> 16) + 1;
+    bool const     fPhysCont  = RT_BOOL(NVME_CMD_CDW(pCmd, 11) & RT_BIT_32(0));
+    bool const     fIntrEn    = RT_BOOL(NVME_CMD_CDW(pCmd, 11) & RT_BIT_32(1));
+    uint32_t const u32IntrVec = NVME_CMD_CDW(pCmd, 11) >> 16;
+
+    if (   !u16Id
+        || u16Id > pThis->cQueuesCompGranted
+        || pThis->aQueuesComp[u16Id].Hdr.enmState != NVMEQUEUESTATE_FREE)
+        return NVME_STATUS_INVALID_QUEUE_ID;
+    if (cEntries < 2 || cEntries > pThis->cQueueEntriesMax)
+        return NVME_STATUS_INVALID_QUEUE_SIZE;
+    if (u32IntrVec >= RT_MAX(pThis->cMsixVectors, 1))
+        return NVME_STATUS_INVALID_INTR_VECTOR;
+    if (   !fPhysCont
+        || ((pThis->u32RegCc >> NVME_CC_IOCQES_SHIFT) & 0xf) != NVME_CQ_ENTRY_SIZE_LOG2)
+        return NVME_STATUS_INVALID_FIELD;
+    if (pCmd->u64Prp1 & (pThis->cbPage - 1))
+        return NVME_STATUS_INVALID_PRP_OFFSET;
+
+    nvmeR3CqCreate(pThis, u16Id, pCmd->u64Prp1, cEntries, fIntrEn, u32IntrVec);
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Processes the Create I/O Submission Queue command.
+ */
+static uint16_t nvmeR3AdminCreateIoSq(PNVME pThis, PCNVMECMD pCmd)
+{
+    uint16_t const u16Id     = (uint16_t)NVME_CMD_CDW(pCmd, 10);
+    uint32_t const cEntries  = (NVME_CMD_CDW(pCmd, 10) >> 16) + 1;
+    bool const     fPhysCont = RT_BOOL(NVME_CMD_CDW(pCmd, 11) & RT_BIT_32(0));
+    uint32_t const uPrio     = (NVME_CMD_CDW(pCmd, 11) >> 1) & 0x3;
+    uint16_t const u16CqId   = (uint16_t)(NVME_CMD_CDW(pCmd, 11) >> 16);
+
+    if (   !u16Id
+        || u16Id > pThis->cQueuesSubmGranted
+        || pThis->aQueuesSubm[u16Id].Hdr.enmState != NVMEQUEUESTATE_FREE)
+        return NVME_STATUS_INVALID_QUEUE_ID;
+    if (cEntries < 2 || cEntries > pThis->cQueueEntriesMax)
+        return NVME_STATUS_INVALID_QUEUE_SIZE;
+    if (   !u16CqId
+        || u16CqId > pThis->cQueuesCompGranted
+        || pThis->aQueuesComp[u16CqId].Hdr.enmState != NVMEQUEUESTATE_CREATED)
+        return NVME_STATUS_CQ_INVALID;
+    if (   !fPhysCont
+        || ((pThis->u32RegCc >> NVME_CC_IOSQES_SHIFT) & 0xf) != NVME_SQ_ENTRY_SIZE_LOG2)
+        return NVME_STATUS_INVALID_FIELD;
+    if (pCmd->u64Prp1 & (pThis->cbPage - 1))
+        return NVME_STATUS_INVALID_PRP_OFFSET;
+
+    nvmeR3SqCreate(pThis, u16Id, pCmd->u64Prp1, cEntries, u16CqId, (NVMEQUEUEPRIO)uPrio);
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Processes the Delete I/O Submission Queue command.
+ */
+static uint16_t nvmeR3AdminDeleteIoSq(PNVME pThis, PCNVMECMD pCmd)
+{
+    uint16_t const u16Id = (uint16_t)NVME_CMD_CDW(pCmd, 10);
+    if (   !u16Id
+        || u16Id > pThis->cQueuesSubmMax
+        || pThis->aQueuesSubm[u16Id].Hdr.enmState != NVMEQUEUESTATE_CREATED)
+        return NVME_STATUS_INVALID_QUEUE_ID;
+
+    nvmeR3SqDelete(pThis, &pThis->aQueuesSubm[u16Id]);
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Processes the Delete I/O Completion Queue command.
+ */
+static uint16_t nvmeR3AdminDeleteIoCq(PNVME pThis, PCNVMECMD pCmd)
+{
+    uint16_t const u16Id = (uint16_t)NVME_CMD_CDW(pCmd, 10);
+    if (   !u16Id
+        || u16Id > pThis->cQueuesCompMax
+        || pThis->aQueuesComp[u16Id].Hdr.enmState != NVMEQUEUESTATE_CREATED)
+        return NVME_STATUS_INVALID_QUEUE_ID;
+    if (pThis->aQueuesComp[u16Id].cSubmQueuesRef)
+        return NVME_STATUS_INVALID_QUEUE_DELETION;
+
+    nvmeR3CqDelete(pThis, &pThis->aQueuesComp[u16Id]);
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Processes the Get Log Page command.
+ */
+static uint16_t nvmeR3AdminGetLogPage(PNVME pThis, PCNVMECMD pCmd)
+{
+    uint8_t const  uLid  = (uint8_t)NVME_CMD_CDW(pCmd, 10);
+    bool const     fRae  = RT_BOOL(NVME_CMD_CDW(pCmd, 10) & RT_BIT_32(15));
+    uint32_t const cDw   = ((NVME_CMD_CDW(pCmd, 10) >> 16) | ((NVME_CMD_CDW(pCmd, 11) & 0xffff) << 16)) + 1;
+    uint64_t const off   = RT_MAKE_U64(NVME_CMD_CDW(pCmd, 12), NVME_CMD_CDW(pCmd, 13));
+
+    /* All pages we have fit into a memory page. */
+    if (   cDw > NVME_PAGE_SIZE / sizeof(uint32_t)
+        || off >= NVME_PAGE_SIZE
+        || (off & 3))
+        return NVME_STATUS_INVALID_FIELD;
+
+    uint8_t abBuf[2 * NVME_PAGE_SIZE];
+    RT_ZERO(abBuf);
+    switch (uLid)
+    {
+        case NVME_LOG_ERROR_INFO:
+            /* No errors are recorded. */
+            break;
+
+        case NVME_LOG_SMART_HEALTH:
+        {
+            uint64_t const cbRead    = pThis->StatBytesRead.c;
+            uint64_t const cbWritten = pThis->StatBytesWritten.c;
+            abBuf[3]                  = 100;                                        /* Available spare. */
+            abBuf[4]                  = 10;                                         /* Available spare threshold. */
+            *(uint16_t *)&abBuf[1]    = 273 + 30;                                   /* Composite temperature (K). */
+            *(uint64_t *)&abBuf[32]   = (cbRead / 512 + 999) / 1000;               /* Data units read. */
+            *(uint64_t *)&abBuf[48]   = (cbWritten / 512 + 999) / 1000;            /* Data units written. */
+            *(uint64_t *)&abBuf[64]   = pThis->StatCmdsRead.c;                      /* Host read commands. */
+            *(uint64_t *)&abBuf[80]   = pThis->StatCmdsWrite.c;                     /* Host write commands. */
+            break;
+        }
+
+        case NVME_LOG_FIRMWARE_SLOT:
+            abBuf[0] = 1;   /* Slot 1 is active. */
+            nvmeR3IdentifyStrCopy(&abBuf[8], NVME_FIRMWARE_REVISION_LENGTH, pThis->szFirmwareRevision);
+            break;
+
+        case NVME_LOG_CHANGED_NS_LIST:
+        {
+            int rc = PDMCritSectEnter(&pThis->CritSectAsyncEvtReqs, VERR_IGNORED);
+            AssertRC(rc);
+            uint32_t *pau32Ids = (uint32_t *)&abBuf[0];
+            uint32_t  cIds     = 0;
+            for (uint32_t i = 0; i < pThis->cNamespaces; i++)
+                if (ASMBitTest(&pThis->bmNsChanged[0], i))
+                    pau32Ids[cIds++] = i + 1;
+            if (!fRae)
+            {
+                RT_ZERO(pThis->bmNsChanged);
+                pThis->fAsyncEvtNsChangedMasked = false;
+                nvmeR3AsyncEvtDispatch(pThis);
+            }
+            PDMCritSectLeave(&pThis->CritSectAsyncEvtReqs);
+            break;
+        }
+
+        default:
+            return NVME_STATUS_INVALID_LOG_PAGE;
+    }
+
+    return nvmeR3AdminDataToGuest(pThis, pCmd, &abBuf[off], cDw * sizeof(uint32_t));
+}
+
+/**
+ * Processes the Get Features command.
+ */
+static uint16_t nvmeR3AdminGetFeatures(PNVME pThis, PCNVMECMD pCmd, uint32_t *pu32Dw0)
+{
+    switch (NVME_CMD_CDW(pCmd, 10) & 0xff)
+    {
+        case NVME_FEAT_ARBITRATION:         *pu32Dw0 = pThis->u32FeatArbitration; break;
+        case NVME_FEAT_POWER_MGMT:          *pu32Dw0 = 0; break;
+        case NVME_FEAT_TEMP_THRESHOLD:
+            /* Only the over temperature threshold of the composite temperature is kept. */
+            *pu32Dw0 = NVME_CMD_CDW(pCmd, 11) & UINT32_C(0x003f0000) ? 0 : pThis->u32FeatTempThreshold;
+            break;
+        case NVME_FEAT_ERROR_RECOVERY:      *pu32Dw0 = pThis->u32FeatErrRecovery; break;
+        case NVME_FEAT_VOLATILE_WC:         *pu32Dw0 = pThis->u32FeatVolatileWc; break;
+        case NVME_FEAT_NUM_QUEUES:
+            *pu32Dw0 = ((pThis->cQueuesCompGranted - 1) << 16) | (pThis->cQueuesSubmGranted - 1);
+            break;
+        case NVME_FEAT_INTR_COALESCING:     *pu32Dw0 = pThis->u32FeatIntrCoalescing; break;
+        case NVME_FEAT_INTR_VEC_CONFIG:     *pu32Dw0 = NVME_CMD_CDW(pCmd, 11) & 0xffff; break;
+        case NVME_FEAT_WRITE_ATOMICITY:     *pu32Dw0 = pThis->u32FeatWriteAtomicity; break;
+        case NVME_FEAT_ASYNC_EVT_CONFIG:    *pu32Dw0 = pThis->u32FeatAsyncEvtCfg; break;
+        default:
+            return NVME_STATUS_INVALID_FIELD;
+    }
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Processes the Set Features command.
+ */
+static uint16_t nvmeR3AdminSetFeatures(PNVME pThis, PCNVMECMD pCmd, uint32_t *pu32Dw0)
+{
+    uint32_t const u32Val = NVME_CMD_CDW(pCmd, 11);
+    switch (NVME_CMD_CDW(pCmd, 10) & 0xff)
+    {
+        case NVME_FEAT_ARBITRATION:         pThis->u32FeatArbitration = u32Val; break;
+        case NVME_FEAT_POWER_MGMT:
+            /* Only power state 0 exists. */
+            if (u32Val & 0x1f)
+                return NVME_STATUS_INVALID_FIELD;
+            break;
+        case NVME_FEAT_TEMP_THRESHOLD:
+            if (!(u32Val & UINT32_C(0x003f0000)))
+                pThis->u32FeatTempThreshold = u32Val & 0xffff;
+            break;
+        case NVME_FEAT_ERROR_RECOVERY:      pThis->u32FeatErrRecovery = u32Val; break;
+        case NVME_FEAT_VOLATILE_WC:         pThis->u32FeatVolatileWc = u32Val & RT_BIT_32(0); break;
+        case NVME_FEAT_NUM_QUEUES:
+        {
+            uint32_t const cSqs = (u32Val & 0xffff) + 1;
+            uint32_t const cCqs = (u32Val >> 16) + 1;
+            if (cSqs > UINT16_MAX || cCqs > UINT16_MAX)
+                return NVME_STATUS_INVALID_FIELD;
+            /* Changing the number after creating I/O queues is not allowed, keep what was granted. */
+            bool fIoQueues = false;
+            for (uint32_t i = 1; i <= pThis->cQueuesCompMax && !fIoQueues; i++)
+                fIoQueues = pThis->aQueuesComp[i].Hdr.enmState == NVMEQUEUESTATE_CREATED;
+            if (!fIoQueues)
+            {
+                pThis->cQueuesSubmGranted = RT_MIN(cSqs, pThis->cQueuesSubmMax);
+                pThis->cQueuesCompGranted = RT_MIN(cCqs, pThis->cQueuesCompMax);
+            }
+            *pu32Dw0 = ((pThis->cQueuesCompGranted - 1) << 16) | (pThis->cQueuesSubmGranted - 1);
+            break;
+        }
+        case NVME_FEAT_INTR_COALESCING:     pThis->u32FeatIntrCoalescing = u32Val & 0xffff; break;
+        case NVME_FEAT_INTR_VEC_CONFIG:
+            if ((u32Val & 0xffff) >= RT_MAX(pThis->cMsixVectors, 1))
+                return NVME_STATUS_INVALID_FIELD;
+            break;
+        case NVME_FEAT_WRITE_ATOMICITY:     pThis->u32FeatWriteAtomicity = u32Val & RT_BIT_32(0); break;
+        case NVME_FEAT_ASYNC_EVT_CONFIG:
+        {
+            int rc = PDMCritSectEnter(&pThis->CritSectAsyncEvtReqs, VERR_IGNORED);
+            AssertRC(rc);
+            pThis->u32FeatAsyncEvtCfg = u32Val & NVME_ASYNC_EVT_CFG_NS_ATTR;
+            nvmeR3AsyncEvtDispatch(pThis);
+            PDMCritSectLeave(&pThis->CritSectAsyncEvtReqs);
+            break;
+        }
+        default:
+            return NVME_STATUS_INVALID_FIELD;
+    }
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Processes the Asynchronous Event Request command, the completion is posted
+ * once an event occurs.
+ *
+ * @returns true if the command completed right away.
+ */
+static bool nvmeR3AdminAsyncEvtReq(PNVME pThis, PCNVMECMD pCmd, uint16_t *pu16Status)
+{
+    bool fCompleted = false;
+    int rc = PDMCritSectEnter(&pThis->CritSectAsyncEvtReqs, VERR_IGNORED);
+    AssertRC(rc);
+    if (pThis->cAsyncEvtReqs < RT_ELEMENTS(pThis->aAsyncEvtReqCids))
+    {
+        pThis->aAsyncEvtReqCids[pThis->cAsyncEvtReqs++] = pCmd->u16Cid;
+        nvmeR3AsyncEvtDispatch(pThis);
+    }
+    else
+    {
+        *pu16Status = NVME_STATUS_ASYNC_EVT_LIMIT_EXCEEDED;
+        fCompleted = true;
+    }
+    PDMCritSectLeave(&pThis->CritSectAsyncEvtReqs);
+    return fCompleted;
+}
+
+/**
+ * Processes the Doorbell Buffer Config command.
+ */
+static uint16_t nvmeR3AdminDoorbellBufConfig(PNVME pThis, PCNVMECMD pCmd)
+{
+    RTGCPHYS const GCPhysShadow = pCmd->u64Prp1;
+    RTGCPHYS const GCPhysEvtIdx = pCmd->u64Prp2;
+    if (   !GCPhysShadow
+        || !GCPhysEvtIdx
+        || (GCPhysShadow & (pThis->cbPage - 1))
+        || (GCPhysEvtIdx & (pThis->cbPage - 1)))
+        return NVME_STATUS_INVALID_FIELD;
+
+    /* Stop the workers so no queue is processed with half of the state. */
+    nvmeR3WrkThrdsLock(pThis);
+    pThis->GCPhysDbBufShadow = GCPhysShadow;
+    pThis->GCPhysDbBufEvtIdx = GCPhysEvtIdx;
+
+    /* Seed the buffers with the current doorbell values of the existing I/O queues. */
+    for (uint16_t i = 1; i < RT_ELEMENTS(pThis->aQueuesSubm); i++)
+    {
+        PNVMEQUEUESUBM pSq = &pThis->aQueuesSubm[i];
+        if (pSq->Hdr.enmState == NVMEQUEUESTATE_CREATED)
+        {
+            uint32_t const idxTail = ASMAtomicReadU32(&pSq->Hdr.idxTail);
+            PDMDevHlpPCIPhysWrite(pThis->pDevInsR3, GCPhysShadow + NVME_DB_IDX_SQ(i) * sizeof(uint32_t),
+                                  &idxTail, sizeof(idxTail));
+            nvmeR3DbBufEvtIdxWrite(pThis, NVME_DB_IDX_SQ(i), idxTail);
+        }
+
+        PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[i];
+        RTSemFastMutexRequest(pCq->hMtx);
+        if (pCq->Hdr.enmState == NVMEQUEUESTATE_CREATED)
+        {
+            uint32_t const idxHead = ASMAtomicReadU32(&pCq->Hdr.idxHead);
+            PDMDevHlpPCIPhysWrite(pThis->pDevInsR3, GCPhysShadow + NVME_DB_IDX_CQ(i) * sizeof(uint32_t),
+                                  &idxHead, sizeof(idxHead));
+            nvmeR3DbBufEvtIdxWrite(pThis, NVME_DB_IDX_CQ(i), idxHead);
+        }
+        RTSemFastMutexRelease(pCq->hMtx);
+    }
+    nvmeR3WrkThrdsUnlock(pThis);
+
+    LogRel(("NVMe#%u: Shadow doorbell buffer at %RGp, event index buffer at %RGp\n",
+            pThis->pDevInsR3->iInstance, GCPhysShadow, GCPhysEvtIdx));
+    return NVME_STATUS_SUCCESS;
+}
+
+/**
+ * Processes an admin command.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pCmd        The command.
+ */
+static void nvmeR3AdminCmdProcess(PNVME pThis, PCNVMECMD pCmd)
+{
+    uint16_t u16Status  = NVME_STATUS_SUCCESS;
+    uint32_t u32Dw0     = 0;
+    bool     fComplete  = true;
+
+    Log(("nvmeR3AdminCmdProcess: Opcode %#x CID %#x NSID %#x\n", pCmd->u8Opc, pCmd->u16Cid, pCmd->u32Nsid));
+    STAM_REL_COUNTER_INC(&pThis->StatCmdsAdmin);
+
+    switch (pCmd->u8Opc)
+    {
+        case NVME_ADM_IDENTIFY:             u16Status = nvmeR3AdminIdentify(pThis, pCmd); break;
+        case NVME_ADM_CREATE_IO_CQ:         u16Status = nvmeR3AdminCreateIoCq(pThis, pCmd); break;
+        case NVME_ADM_CREATE_IO_SQ:         u16Status = nvmeR3AdminCreateIoSq(pThis, pCmd); break;
+        case NVME_ADM_DELETE_IO_SQ:         u16Status = nvmeR3AdminDeleteIoSq(pThis, pCmd); break;
+        case NVME_ADM_DELETE_IO_CQ:         u16Status = nvmeR3AdminDeleteIoCq(pThis, pCmd); break;
+        case NVME_ADM_GET_LOG_PAGE:         u16Status = nvmeR3AdminGetLogPage(pThis, pCmd); break;
+        case NVME_ADM_GET_FEATURES:         u16Status = nvmeR3AdminGetFeatures(pThis, pCmd, &u32Dw0); break;
+        case NVME_ADM_SET_FEATURES:         u16Status = nvmeR3AdminSetFeatures(pThis, pCmd, &u32Dw0); break;
+        case NVME_ADM_ASYNC_EVT_REQ:        fComplete = nvmeR3AdminAsyncEvtReq(pThis, pCmd, &u16Status); break;
+        case NVME_ADM_DOORBELL_BUF_CONFIG:  u16Status = nvmeR3AdminDoorbellBufConfig(pThis, pCmd); break;
+        case NVME_ADM_ABORT:
+            /* Commands are handed to the driver below right away, nothing is aborted. */
+            u32Dw0 = 1;
+            break;
+        default:
+            Log(("nvmeR3AdminCmdProcess: Unsupported opcode %#x\n", pCmd->u8Opc));
+            u16Status = NVME_STATUS_INVALID_OPCODE;
+            break;
+    }
+
+    if (fComplete)
+        nvmeR3AdminCmdComplete(pThis, pCmd->u16Cid, u16Status, u32Dw0);
+}
+
+
+/* -=-=-=-=- Controller state -=-=-=-=- */
+
+/**
+ * Sets the features to their default values.
+ */
+static void nvmeR3FeaturesReset(PNVME pThis)
+{
+    pThis->u32FeatArbitration    = 0;
+    pThis->u32FeatTempThreshold  = 0x157; /* 70 degrees Celsius. */
+    pThis->u32FeatErrRecovery    = 0;
+    pThis->u32FeatVolatileWc     = 1;
+    pThis->u32FeatIntrCoalescing = 0;
+    pThis->u32FeatWriteAtomicity = 0;
+    pThis->u32FeatAsyncEvtCfg    = 0;
+    pThis->cQueuesSubmGranted    = pThis->cQueuesSubmMax;
+    pThis->cQueuesCompGranted    = pThis->cQueuesCompMax;
+}
+
+/**
+ * Resets the controller, deleting all queues (CC.EN 1 -> 0).
+ *
+ * The admin queue registers keep their values.
+ *
+ * @param   pThis       The NVMe controller instance.
+ */
+static void nvmeR3CtrlReset(PNVME pThis)
+{
+    ASMAtomicWriteU32((volatile uint32_t *)&pThis->enmState, NVMESTATE_DISABLED);
+
+    nvmeR3WrkThrdsLock(pThis);
+
+    /* Delete the queues first so completions of canceled requests are dropped. */
+    for (uint32_t i = 0; i < RT_ELEMENTS(pThis->aQueuesSubm); i++)
+        if (pThis->aQueuesSubm[i].Hdr.enmState == NVMEQUEUESTATE_CREATED)
+            nvmeR3SqDelete(pThis, &pThis->aQueuesSubm[i]);
+    for (uint32_t i = 0; i < RT_ELEMENTS(pThis->aQueuesComp); i++)
+        if (pThis->aQueuesComp[i].Hdr.enmState == NVMEQUEUESTATE_CREATED)
+            nvmeR3CqDelete(pThis, &pThis->aQueuesComp[i]);
+
+    for (uint32_t i = 0; i < pThis->cNamespaces; i++)
+    {
+        PNVMENAMESPACE pNs = &pThis->paNamespaces[i];
+        if (pNs->pDrvMediaEx)
+            pNs->pDrvMediaEx->pfnIoReqCancelAll(pNs->pDrvMediaEx);
+    }
+
+    int rc = PDMCritSectEnter(&pThis->CritSectAsyncEvtReqs, VERR_IGNORED);
+    AssertRC(rc);
+    pThis->cAsyncEvtReqs             = 0;
+    pThis->fAsyncEvtNsChangedPending = false;
+    pThis->fAsyncEvtNsChangedMasked  = false;
+    RT_ZERO(pThis->bmNsChanged);
+    PDMCritSectLeave(&pThis->CritSectAsyncEvtReqs);
+
+    pThis->GCPhysDbBufShadow = NIL_RTGCPHYS;
+    pThis->GCPhysDbBufEvtIdx = NIL_RTGCPHYS;
+    if (pThis->paCmdsRestored)
+    {
+        RTMemFree(pThis->paCmdsRestored);
+        pThis->paCmdsRestored = NULL;
+        pThis->cCmdsRestored  = 0;
+    }
+
+    nvmeR3FeaturesReset(pThis);
+    pThis->u32IntrMask = 0;
+    pThis->cbPage      = NVME_PAGE_SIZE;
+    ASMAtomicWriteU32(&pThis->u32RegCsts, 0);
+
+    nvmeR3WrkThrdsUnlock(pThis);
+    nvmeR3IntxUpdate(pThis);
+}
+
+/**
+ * Enables the controller, creating the admin queues (CC.EN 0 -> 1).
+ *
+ * @param   pThis       The NVMe controller instance.
+ */
+static void nvmeR3CtrlEnable(PNVME pThis)
+{
+    uint32_t const cSqEntries = (pThis->u32RegAqa & NVME_AQA_ASQS_MASK) + 1;
+    uint32_t const cCqEntries = ((pThis->u32RegAqa >> NVME_AQA_ACQS_SHIFT) & NVME_AQA_ASQS_MASK) + 1;
+
+    if (   (pThis->u32RegCc & (NVME_CC_CSS_MASK | NVME_CC_MPS_MASK | NVME_CC_AMS_MASK))
+        || cSqEntries < 2
+        || cCqEntries < 2
+        || !pThis->u64RegAsq
+        || !pThis->u64RegAcq)
+    {
+        LogRel(("NVMe#%u: Invalid configuration on enable (CC=%#x AQA=%#x ASQ=%#RX64 ACQ=%#RX64)\n",
+                pThis->pDevInsR3->iInstance, pThis->u32RegCc, pThis->u32RegAqa, pThis->u64RegAsq, pThis->u64RegAcq));
+        ASMAtomicWriteU32((volatile uint32_t *)&pThis->enmState, NVMESTATE_FATAL);
+        ASMAtomicOrU32(&pThis->u32RegCsts, NVME_CSTS_CFS);
+        return;
+    }
+
+    pThis->cbPage = NVME_PAGE_SIZE;
+    nvmeR3CqCreate(pThis, 0, pThis->u64RegAcq, cCqEntries, true /*fIntrEnabled*/, 0 /*u32IntrVec*/);
+    nvmeR3SqCreate(pThis, 0, pThis->u64RegAsq, cSqEntries, 0 /*u16CqId*/, NVMEQUEUEPRIO_URGENT);
+
+    ASMAtomicWriteU32((volatile uint32_t *)&pThis->enmState, NVMESTATE_READY);
+    ASMAtomicOrU32(&pThis->u32RegCsts, NVME_CSTS_RDY);
+    LogRel(("NVMe#%u: Controller enabled\n", pThis->pDevInsR3->iInstance));
+}
+
+/**
+ * Shuts the controller down on guest request (CC.SHN != 0), flushing all
+ * namespaces.
+ *
+ * @param   pThis       The NVMe controller instance.
+ */
+static void nvmeR3CtrlShutdown(PNVME pThis)
+{
+    ASMAtomicWriteU32((volatile uint32_t *)&pThis->enmState, NVMESTATE_SHUTDOWN);
+    for (uint32_t i = 0; i < pThis->cNamespaces; i++)
+    {
+        PNVMENAMESPACE pNs = &pThis->paNamespaces[i];
+        if (pNs->pDrvMedia)
+        {
+            int rc = pNs->pDrvMedia->pfnFlush(pNs->pDrvMedia);
+            if (RT_FAILURE(rc))
+                LogRel(("NVMe#%u: Flushing namespace %u on shutdown failed with %Rrc\n",
+                        pThis->pDevInsR3->iInstance, pNs->u32Id, rc));
+        }
+    }
+    ASMAtomicAndU32(&pThis->u32RegCsts, ~NVME_CSTS_SHST_MASK);
+    ASMAtomicOrU32(&pThis->u32RegCsts, NVME_CSTS_SHST_COMPLETE);
+    LogRel(("NVMe#%u: Controller shut down\n", pThis->pDevInsR3->iInstance));
+}
+
+/**
+ * Handles a write to the controller configuration register.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   u32         The value written.
+ */
+static void nvmeR3CtrlWriteCc(PNVME pThis, uint32_t u32)
+{
+    uint32_t const u32Old = pThis->u32RegCc;
+    pThis->u32RegCc = u32 & NVME_CC_WRITABLE_MASK;
+
+    if ((u32Old & NVME_CC_EN) && !(u32 & NVME_CC_EN))
+        nvmeR3CtrlReset(pThis);
+    else if (!(u32Old & NVME_CC_EN) && (u32 & NVME_CC_EN))
+        nvmeR3CtrlEnable(pThis);
+
+    if (   (u32 & NVME_CC_SHN_MASK)
+        && !(u32Old & NVME_CC_SHN_MASK)
+        && pThis->enmState == NVMESTATE_READY)
+        nvmeR3CtrlShutdown(pThis);
+}
+
+
+/* -=-=-=-=- Submission queue processing -=-=-=-=- */
+
+/**
+ * Fetches and processes commands from a submission queue.
+ *
+ * @returns true if there are more commands to process.
+ * @param   pThis       The NVMe controller instance.
+ * @param   pSq         The submission queue, the worker critical section is owned.
+ */
+static bool nvmeR3SqProcess(PNVME pThis, PNVMEQUEUESUBM pSq)
+{
+    uint32_t idxTail = nvmeR3SqTailGet(pThis, pSq);
+    if (pSq->Hdr.idxHead == idxTail)
+        return false;
+
+    PNVMEQUEUECOMP pCq     = &pThis->aQueuesComp[pSq->u16CompletionQueueId];
+    bool const     fDbBuf  = nvmeR3DbBufIsActive(pThis, pSq->Hdr.u16Id);
+    uint32_t       cCmds   = 0;
+
+    /* Interrupts for completions posted meanwhile are raised once when done. */
+    RTSemFastMutexRequest(pCq->hMtx);
+    pCq->cSubmQueuesProcessing++;
+    RTSemFastMutexRelease(pCq->hMtx);
+
+    for (;;)
+    {
+        while (   pSq->Hdr.idxHead != idxTail
+               && cCmds < NVME_SQ_CMDS_PER_PASS
+               && pThis->enmState == NVMESTATE_READY)
+        {
+            NVMECMD Cmd;
+            PDMDevHlpPhysRead(pThis->pDevInsR3, pSq->Hdr.GCPhysBase + (RTGCPHYS)pSq->Hdr.idxHead * sizeof(NVMECMD),
+                              &Cmd, sizeof(Cmd));
+            ASMAtomicWriteU32(&pSq->Hdr.idxHead, (pSq->Hdr.idxHead + 1) % pSq->Hdr.cEntries);
+            STAM_REL_COUNTER_INC(&pSq->StatCmds);
+            cCmds++;
+
+            if (pSq->Hdr.u16Id == 0)
+                nvmeR3AdminCmdProcess(pThis, &Cmd);
+            else
+                nvmeR3IoCmdSubmit(pThis, pSq, &Cmd);
+        }
+
+        if (   pSq->Hdr.idxHead != idxTail
+            || !fDbBuf
+            || pThis->enmState != NVMESTATE_READY)
+            break;
+
+        /* Caught up, have the guest ring the doorbell for the next command and recheck the shadow tail. */
+        nvmeR3DbBufEvtIdxWrite(pThis, NVME_DB_IDX_SQ(pSq->Hdr.u16Id), pSq->Hdr.idxHead);
+        ASMMemoryFence();
+        idxTail = nvmeR3SqTailGet(pThis, pSq);
+        if (   pSq->Hdr.idxHead == idxTail
+            || cCmds >= NVME_SQ_CMDS_PER_PASS)
+            break;
+    }
+
+    RTSemFastMutexRequest(pCq->hMtx);
+    if (   !--pCq->cSubmQueuesProcessing
+        && pCq->fIntrPending)
+    {
+        pCq->fIntrPending = false;
+        nvmeR3CqIntrRaise(pThis, pCq);
+    }
+    RTSemFastMutexRelease(pCq->hMtx);
+
+    return    pSq->Hdr.idxHead != idxTail
+           && pThis->enmState == NVMESTATE_READY;
+}
+
+/**
+ * @callback_method_impl{FNPDMTHREADDEV, Worker thread processing the assigned submission queues.}
+ */
+static DECLCALLBACK(int) nvmeR3WrkThrdLoop(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PNVME        pThis    = PDMINS_2_DATA(pDevIns, PNVME);
+    PNVMEWRKTHRD pWrkThrd = (PNVMEWRKTHRD)pThread->pvUser;
+
+    if (pThread->enmState == PDMTHREADSTATE_INITIALIZING)
+        return VINF_SUCCESS;
+
+    while (pThread->enmState == PDMTHREADSTATE_RUNNING)
+    {
+        bool fMore = false;
+
+        ASMAtomicIncU32(&pThis->cWrkThrdsActive);
+        if (   !ASMAtomicReadBool(&pThis->fSignalIdle)
+            && pThis->enmState == NVMESTATE_READY)
+        {
+            RTCritSectEnter(&pWrkThrd->CritSect);
+            PNVMEQUEUESUBM pSq;
+            RTListForEach(&pWrkThrd->LstSubmQueuesAssgnd, pSq, NVMEQUEUESUBM, NdLstWrkThrdAssgnd)
+            {
+                if (nvmeR3SqProcess(pThis, pSq))
+                    fMore = true;
+            }
+            RTCritSectLeave(&pWrkThrd->CritSect);
+        }
+        ASMAtomicDecU32(&pThis->cWrkThrdsActive);
+
+        if (ASMAtomicReadBool(&pThis->fSignalIdle))
+        {
+            if (nvmeR3IsIdle(pThis))
+                PDMDevHlpAsyncNotificationCompleted(pDevIns);
+            fMore = false;
+        }
+
+        if (!fMore)
+        {
+            int rc = SUPSemEventWaitNoResume(pThis->pSupDrvSession, pWrkThrd->hEvtProcess, RT_INDEFINITE_WAIT);
+            AssertLogRelMsgReturn(RT_SUCCESS(rc) || rc == VERR_INTERRUPTED, ("%Rrc\n", rc), rc);
+        }
+    }
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * @callback_method_impl{FNPDMTHREADWAKEUPDEV}
+ */
+static DECLCALLBACK(int) nvmeR3WrkThrdWakeUp(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PNVME        pThis    = PDMINS_2_DATA(pDevIns, PNVME);
+    PNVMEWRKTHRD pWrkThrd = (PNVMEWRKTHRD)pThread->pvUser;
+    return SUPSemEventSignal(pThis->pSupDrvSession, pWrkThrd->hEvtProcess);
+}
+
+
+/* -=-=-=-=- PDMIMEDIAPORT / PDMIMEDIAEXPORT -=-=-=-=- */
+
+/**
+ * @interface_method_impl{PDMIMEDIAPORT,pfnQueryDeviceLocation}
+ */
+static DECLCALLBACK(int) nvmeR3QueryDeviceLocation(PPDMIMEDIAPORT pInterface, const char **ppcszController,
+                                                   uint32_t *piInstance, uint32_t *piLUN)
+{
+    PNVMENAMESPACE pNs     = RT_FROM_MEMBER(pInterface, NVMENAMESPACE, IMediaPort);
+    PPDMDEVINS     pDevIns = pNs->pNvmeR3->pDevInsR3;
+
+    AssertPtrReturn(ppcszController, VERR_INVALID_POINTER);
+    AssertPtrReturn(piInstance, VERR_INVALID_POINTER);
+    AssertPtrReturn(piLUN, VERR_INVALID_POINTER);
+
+    *ppcszController = pDevIns->pReg->szName;
+    *piInstance = pDevIns->iInstance;
+    *piLUN = pNs->iLUN;
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCopyFromBuf}
+ */
+static DECLCALLBACK(int) nvmeR3IoReqCopyFromBuf(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                void *pvIoReqAlloc, uint32_t offDst, PRTSGBUF pSgBuf,
+                                                size_t cbCopy)
+{
+    RT_NOREF1(hIoReq);
+    PNVMENAMESPACE pNs  = RT_FROM_MEMBER(pInterface, NVMENAMESPACE, IMediaExPort);
+    PNVMEREQ       pReq = (PNVMEREQ)pvIoReqAlloc;
+
+    size_t cbCopied = nvmeR3PrpsCopySgBuf(pNs->pNvmeR3, &pReq->Prps, offDst, pSgBuf, cbCopy, true /*fToGuest*/);
+    return cbCopied == cbCopy ? VINF_SUCCESS : VERR_PDM_MEDIAEX_IOBUF_OVERFLOW;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCopyToBuf}
+ */
+static DECLCALLBACK(int) nvmeR3IoReqCopyToBuf(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                              void *pvIoReqAlloc, uint32_t offSrc, PRTSGBUF pSgBuf,
+                                              size_t cbCopy)
+{
+    RT_NOREF1(hIoReq);
+    PNVMENAMESPACE pNs  = RT_FROM_MEMBER(pInterface, NVMENAMESPACE, IMediaExPort);
+    PNVMEREQ       pReq = (PNVMEREQ)pvIoReqAlloc;
+
+    size_t cbCopied;
+    if (pReq->Cmd.u8Opc == NVME_NVM_WRITE_ZEROES)
+        cbCopied = RTSgBufSet(pSgBuf, 0, cbCopy);
+    else
+        cbCopied = nvmeR3PrpsCopySgBuf(pNs->pNvmeR3, &pReq->Prps, offSrc, pSgBuf, cbCopy, false /*fToGuest*/);
+    return cbCopied == cbCopy ? VINF_SUCCESS : VERR_PDM_MEDIAEX_IOBUF_UNDERRUN;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqQueryDiscardRanges}
+ */
+static DECLCALLBACK(int) nvmeR3IoReqQueryDiscardRanges(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                       void *pvIoReqAlloc, uint32_t idxRangeStart,
+                                                       uint32_t cRanges, PRTRANGE paRanges,
+                                                       uint32_t *pcRanges)
+{
+    RT_NOREF1(hIoReq);
+    PNVMENAMESPACE pNs  = RT_FROM_MEMBER(pInterface, NVMENAMESPACE, IMediaExPort);
+    PNVMEREQ       pReq = (PNVMEREQ)pvIoReqAlloc;
+
+    uint32_t idxRange = 0;
+    while (   idxRange < cRanges
+           && idxRangeStart + idxRange < pReq->cRanges)
+    {
+        NVMEDSMRANGE Range;
+        nvmeR3PrpsCopyBuf(pNs->pNvmeR3, &pReq->Prps, (idxRangeStart + idxRange) * sizeof(Range), &Range, sizeof(Range),
+                          false /*fToGuest*/);
+        if (!nvmeR3NamespaceIsRangeValid(pNs, Range.uLbaStart, Range.cBlocks))
+            return VERR_OUT_OF_RANGE;
+
+        paRanges[idxRange].offStart = Range.uLbaStart << pNs->cBlockShift;
+        paRanges[idxRange].cbRange  = (size_t)Range.cBlocks << pNs->cBlockShift;
+        idxRange++;
+    }
+
+    *pcRanges = idxRange;
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCompleteNotify}
+ */
+static DECLCALLBACK(int) nvmeR3IoReqCompleteNotify(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                   void *pvIoReqAlloc, int rcReq)
+{
+    RT_NOREF(hIoReq);
+    PNVMENAMESPACE pNs = RT_FROM_MEMBER(pInterface, NVMENAMESPACE, IMediaExPort);
+    nvmeR3ReqComplete(pNs->pNvmeR3, (PNVMEREQ)pvIoReqAlloc, rcReq);
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqStateChanged}
+ */
+static DECLCALLBACK(void) nvmeR3IoReqStateChanged(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                  void *pvIoReqAlloc, PDMMEDIAEXIOREQSTATE enmState)
+{
+    RT_NOREF(hIoReq);
+    PNVMENAMESPACE pNs   = RT_FROM_MEMBER(pInterface, NVMENAMESPACE, IMediaExPort);
+    PNVME          pThis = pNs->pNvmeR3;
+    PNVMEREQ       pReq  = (PNVMEREQ)pvIoReqAlloc;
+
+    switch (enmState)
+    {
+        case PDMMEDIAEXIOREQSTATE_SUSPENDED:
+            /* Make sure the request is not accounted for so the VM can suspend successfully. */
+            ASMAtomicDecU32(&pThis->aQueuesSubm[pReq->u16SqId].cReqsActive);
+            if (pThis->fSignalIdle && nvmeR3IsIdle(pThis))
+                PDMDevHlpAsyncNotificationCompleted(pThis->pDevInsR3);
+            break;
+        case PDMMEDIAEXIOREQSTATE_ACTIVE:
+            /* Make sure the request is accounted for so the VM suspends only when the request is complete. */
+            ASMAtomicIncU32(&pThis->aQueuesSubm[pReq->u16SqId].cReqsActive);
+            break;
+        default:
+            AssertMsgFailed(("Invalid request state given %u\n", enmState));
+    }
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnMediumEjected}
+ */
+static DECLCALLBACK(void) nvmeR3MediumEjected(PPDMIMEDIAEXPORT pInterface)
+{
+    RT_NOREF(pInterface);
+}
+
+/**
+ * @interface_method_impl{PDMIBASE,pfnQueryInterface, For the namespaces.}
+ */
+static DECLCALLBACK(void *) nvmeR3NamespaceQueryInterface(PPDMIBASE pInterface, const char *pszIID)
+{
+    PNVMENAMESPACE pNs = RT_FROM_MEMBER(pInterface, NVMENAMESPACE, IBase);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIBASE, &pNs->IBase);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIMEDIAPORT, &pNs->IMediaPort);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIMEDIAEXPORT, &pNs->IMediaExPort);
+    return NULL;
+}
+
+
+/* -=-=-=-=- Status LUN -=-=-=-=- */
+
+/**
+ * @interface_method_impl{PDMILEDPORTS,pfnQueryStatusLed}
+ */
+static DECLCALLBACK(int) nvmeR3Status_QueryStatusLed(PPDMILEDPORTS pInterface, unsigned iLUN, PPDMLED *ppLed)
+{
+    PNVME pThis = RT_FROM_MEMBER(pInterface, NVME, ILeds);
+    if (iLUN < pThis->cNamespaces)
+    {
+        *ppLed = &pThis->paNamespaces[iLUN].Led;
+        Assert((*ppLed)->u32Magic == PDMLED_MAGIC);
+        return VINF_SUCCESS;
+    }
+    return VERR_PDM_LUN_NOT_FOUND;
+}
+
+/**
+ * @interface_method_impl{PDMIBASE,pfnQueryInterface, For the status LUN.}
+ */
+static DECLCALLBACK(void *) nvmeR3Status_QueryInterface(PPDMIBASE pInterface, const char *pszIID)
+{
+    PNVME pThis = RT_FROM_MEMBER(pInterface, NVME, IBase);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIBASE, &pThis->IBase);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMILEDPORTS, &pThis->ILeds);
+    return NULL;
+}
+
+
+/* -=-=-=-=- Saved State -=-=-=-=- */
+
+/**
+ * Saves the configuration.
+ *
+ * @param   pThis       The NVMe controller instance.
+ * @param   pSSM        The handle to the saved state.
+ */
+static void nvmeR3SaveConfig(PNVME pThis, PSSMHANDLE pSSM)
+{
+    SSMR3PutU32(pSSM, pThis->cQueuesSubmMax);
+    SSMR3PutU32(pSSM, pThis->cQueuesCompMax);
+    SSMR3PutU32(pSSM, pThis->cQueueEntriesMax);
+    SSMR3PutU32(pSSM, pThis->cNamespaces);
+}
+
+/**
+ * @callback_method_impl{FNSSMDEVLIVEEXEC}
+ */
+static DECLCALLBACK(int) nvmeR3LiveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint32_t uPass)
+{
+    RT_NOREF(uPass);
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    nvmeR3SaveConfig(pThis, pSSM);
+    return VINF_SSM_DONT_CALL_AGAIN;
+}
+
+/**
+ * @callback_method_impl{FNSSMDEVSAVEEXEC}
+ */
+static DECLCALLBACK(int) nvmeR3SaveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
+{
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+
+    nvmeR3SaveConfig(pThis, pSSM);
+
+    /* Registers and features. */
+    SSMR3PutU32(pSSM, pThis->enmState);
+    SSMR3PutU32(pSSM, pThis->u32IntrMask);
+    SSMR3PutU32(pSSM, pThis->u32RegCc);
+    SSMR3PutU32(pSSM, pThis->u32RegCsts);
+    SSMR3PutU32(pSSM, pThis->u32RegAqa);
+    SSMR3PutU64(pSSM, pThis->u64RegAsq);
+    SSMR3PutU64(pSSM, pThis->u64RegAcq);
+    SSMR3PutU32(pSSM, pThis->cbPage);
+    SSMR3PutGCPhys(pSSM, pThis->GCPhysDbBufShadow);
+    SSMR3PutGCPhys(pSSM, pThis->GCPhysDbBufEvtIdx);
+    SSMR3PutU32(pSSM, pThis->u32FeatArbitration);
+    SSMR3PutU32(pSSM, pThis->u32FeatTempThreshold);
+    SSMR3PutU32(pSSM, pThis->u32FeatErrRecovery);
+    SSMR3PutU32(pSSM, pThis->u32FeatVolatileWc);
+    SSMR3PutU32(pSSM, pThis->u32FeatIntrCoalescing);
+    SSMR3PutU32(pSSM, pThis->u32FeatWriteAtomicity);
+    SSMR3PutU32(pSSM, pThis->u32FeatAsyncEvtCfg);
+    SSMR3PutU32(pSSM, pThis->cQueuesSubmGranted);
+    SSMR3PutU32(pSSM, pThis->cQueuesCompGranted);
+
+    /* The completion queues including the completions waiting for room. */
+    for (uint32_t i = 0; i <= pThis->cQueuesCompMax; i++)
+    {
+        PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[i];
+        bool const fCreated = pCq->Hdr.enmState == NVMEQUEUESTATE_CREATED;
+        SSMR3PutBool(pSSM, fCreated);
+        if (!fCreated)
+            continue;
+        SSMR3PutGCPhys(pSSM, pCq->Hdr.GCPhysBase);
+        SSMR3PutU32(pSSM, pCq->Hdr.cEntries);
+        SSMR3PutU32(pSSM, pCq->Hdr.idxHead);
+        SSMR3PutU32(pSSM, pCq->Hdr.idxTail);
+        SSMR3PutBool(pSSM, pCq->fIntrEnabled);
+        SSMR3PutBool(pSSM, pCq->fPhase);
+        SSMR3PutU32(pSSM, pCq->u32IntrVec);
+        SSMR3PutU32(pSSM, pCq->cWaiters);
+        PNVMECOMPWAITER pWaiter;
+        RTListForEach(&pCq->LstCompletionsWaiting, pWaiter, NVMECOMPWAITER, NdLstWait)
+            SSMR3PutMem(pSSM, &pWaiter->Cqe, sizeof(pWaiter->Cqe));
+    }
+
+    /* The submission queues. */
+    for (uint32_t i = 0; i <= pThis->cQueuesSubmMax; i++)
+    {
+        PNVMEQUEUESUBM pSq = &pThis->aQueuesSubm[i];
+        bool const fCreated = pSq->Hdr.enmState == NVMEQUEUESTATE_CREATED;
+        SSMR3PutBool(pSSM, fCreated);
+        if (!fCreated)
+            continue;
+        SSMR3PutGCPhys(pSSM, pSq->Hdr.GCPhysBase);
+        SSMR3PutU32(pSSM, pSq->Hdr.cEntries);
+        SSMR3PutU32(pSSM, pSq->Hdr.idxHead);
+        SSMR3PutU32(pSSM, pSq->Hdr.idxTail);
+        SSMR3PutU16(pSSM, pSq->u16CompletionQueueId);
+        SSMR3PutU32(pSSM, pSq->enmPriority);
+    }
+
+    /* Asynchronous events. */
+    SSMR3PutU32(pSSM, pThis->cAsyncEvtReqs);
+    for (uint32_t i = 0; i < pThis->cAsyncEvtReqs; i++)
+        SSMR3PutU16(pSSM, pThis->aAsyncEvtReqCids[i]);
+    SSMR3PutBool(pSSM, pThis->fAsyncEvtNsChangedPending);
+    SSMR3PutBool(pSSM, pThis->fAsyncEvtNsChangedMasked);
+    SSMR3PutMem(pSSM, &pThis->bmNsChanged[0], sizeof(pThis->bmNsChanged));
+
+    /*
+     * The commands suspended because of a recoverable error, they are
+     * resubmitted on resume.
+     */
+    uint32_t cCmds = pThis->cCmdsRestored;
+    for (uint32_t i = 0; i < pThis->cNamespaces; i++)
+        if (pThis->paNamespaces[i].pDrvMediaEx)
+            cCmds += pThis->paNamespaces[i].pDrvMediaEx->pfnIoReqGetSuspendedCount(pThis->paNamespaces[i].pDrvMediaEx);
+    SSMR3PutU32(pSSM, cCmds);
+    for (uint32_t i = 0; i < pThis->cNamespaces; i++)
+    {
+        PPDMIMEDIAEX pDrvMediaEx = pThis->paNamespaces[i].pDrvMediaEx;
+        uint32_t cReqsSuspended = pDrvMediaEx ? pDrvMediaEx->pfnIoReqGetSuspendedCount(pDrvMediaEx) : 0;
+        if (!cReqsSuspended)
+            continue;
+
+        PDMMEDIAEXIOREQ hIoReq;
+        PNVMEREQ        pReq;
+        int rc = pDrvMediaEx->pfnIoReqQuerySuspendedStart(pDrvMediaEx, &hIoReq, (void **)&pReq);
+        AssertRCReturn(rc, rc);
+        for (;;)
+        {
+            SSMR3PutU16(pSSM, pReq->u16SqId);
+            SSMR3PutMem(pSSM, &pReq->Cmd, sizeof(pReq->Cmd));
+            if (!--cReqsSuspended)
+                break;
+            rc = pDrvMediaEx->pfnIoReqQuerySuspendedNext(pDrvMediaEx, hIoReq, &hIoReq, (void **)&pReq);
+            AssertRCReturn(rc, rc);
+        }
+    }
+    for (uint32_t i = 0; i < pThis->cCmdsRestored; i++)
+    {
+        SSMR3PutU16(pSSM, pThis->paCmdsRestored[i].u16SqId);
+        SSMR3PutMem(pSSM, &pThis->paCmdsRestored[i].Cmd, sizeof(pThis->paCmdsRestored[i].Cmd));
+    }
+
+    return SSMR3PutU32(pSSM, UINT32_MAX); /* terminator */
+}
+
+/**
+ * @callback_method_impl{FNSSMDEVLOADEXEC}
+ */
+static DECLCALLBACK(int) nvmeR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t uPass)
+{
+    PNVME    pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    uint32_t u32;
+    int      rc;
+
+    if (uVersion != NVME_SAVED_STATE_VERSION)
+        return VERR_SSM_UNSUPPORTED_DATA_UNIT_VERSION;
+
+    /* Configuration checks. */
+    uint32_t cQueuesSubmMax, cQueuesCompMax, cQueueEntriesMax, cNamespaces;
+    SSMR3GetU32(pSSM, &cQueuesSubmMax);
+    SSMR3GetU32(pSSM, &cQueuesCompMax);
+    SSMR3GetU32(pSSM, &cQueueEntriesMax);
+    rc = SSMR3GetU32(pSSM, &cNamespaces);
+    AssertRCReturn(rc, rc);
+    if (   cQueuesSubmMax != pThis->cQueuesSubmMax
+        || cQueuesCompMax != pThis->cQueuesCompMax
+        || cQueueEntriesMax != pThis->cQueueEntriesMax)
+        return SSMR3SetCfgError(pSSM, RT_SRC_POS, N_("Config mismatch - saved queues=%u/%u/%u config=%u/%u/%u"),
+                                cQueuesSubmMax, cQueuesCompMax, cQueueEntriesMax,
+                                pThis->cQueuesSubmMax, pThis->cQueuesCompMax, pThis->cQueueEntriesMax);
+    if (cNamespaces != pThis->cNamespaces)
+        return SSMR3SetCfgError(pSSM, RT_SRC_POS, N_("Config mismatch - saved namespaces=%u config=%u"),
+                                cNamespaces, pThis->cNamespaces);
+
+    if (uPass != SSM_PASS_FINAL)
+        return VINF_SUCCESS;
+
+    /* Start from scratch, this drops all queues. */
+    nvmeR3CtrlReset(pThis);
+
+    NVMESTATE enmState;
+    SSMR3GetU32(pSSM, (uint32_t *)&enmState);
+    SSMR3GetU32(pSSM, &pThis->u32IntrMask);
+    SSMR3GetU32(pSSM, &pThis->u32RegCc);
+    SSMR3GetU32(pSSM, &u32);
+    SSMR3GetU32(pSSM, &pThis->u32RegAqa);
+    SSMR3GetU64(pSSM, &pThis->u64RegAsq);
+    SSMR3GetU64(pSSM, &pThis->u64RegAcq);
+    SSMR3GetU32(pSSM, &pThis->cbPage);
+    RTGCPHYS GCPhysDbBufShadow, GCPhysDbBufEvtIdx;
+    SSMR3GetGCPhys(pSSM, &GCPhysDbBufShadow);
+    SSMR3GetGCPhys(pSSM, &GCPhysDbBufEvtIdx);
+    SSMR3GetU32(pSSM, &pThis->u32FeatArbitration);
+    SSMR3GetU32(pSSM, &pThis->u32FeatTempThreshold);
+    SSMR3GetU32(pSSM, &pThis->u32FeatErrRecovery);
+    SSMR3GetU32(pSSM, &pThis->u32FeatVolatileWc);
+    SSMR3GetU32(pSSM, &pThis->u32FeatIntrCoalescing);
+    SSMR3GetU32(pSSM, &pThis->u32FeatWriteAtomicity);
+    SSMR3GetU32(pSSM, &pThis->u32FeatAsyncEvtCfg);
+    SSMR3GetU32(pSSM, &pThis->cQueuesSubmGranted);
+    rc = SSMR3GetU32(pSSM, &pThis->cQueuesCompGranted);
+    AssertRCReturn(rc, rc);
+    AssertLogRelMsgReturn(   enmState > NVMESTATE_INVALID && enmState <= NVMESTATE_FATAL
+                          && pThis->cbPage == NVME_PAGE_SIZE
+                          && pThis->cQueuesSubmGranted <= pThis->cQueuesSubmMax
+                          && pThis->cQueuesCompGranted <= pThis->cQueuesCompMax,
+                          ("enmState=%d cbPage=%#x granted=%u/%u\n", enmState, pThis->cbPage,
+                           pThis->cQueuesSubmGranted, pThis->cQueuesCompGranted),
+                          VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+    ASMAtomicWriteU32(&pThis->u32RegCsts, u32);
+
+    for (uint32_t i = 0; i <= pThis->cQueuesCompMax; i++)
+    {
+        bool fCreated;
+        rc = SSMR3GetBool(pSSM, &fCreated);
+        AssertRCReturn(rc, rc);
+        if (!fCreated)
+            continue;
+
+        PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[i];
+        RTGCPHYS GCPhysBase;
+        uint32_t cEntries, idxHead, idxTail, u32IntrVec, cWaiters;
+        bool     fIntrEnabled, fPhase;
+        SSMR3GetGCPhys(pSSM, &GCPhysBase);
+        SSMR3GetU32(pSSM, &cEntries);
+        SSMR3GetU32(pSSM, &idxHead);
+        SSMR3GetU32(pSSM, &idxTail);
+        SSMR3GetBool(pSSM, &fIntrEnabled);
+        SSMR3GetBool(pSSM, &fPhase);
+        SSMR3GetU32(pSSM, &u32IntrVec);
+        rc = SSMR3GetU32(pSSM, &cWaiters);
+        AssertRCReturn(rc, rc);
+        AssertLogRelMsgReturn(   cEntries >= 2 && cEntries <= pThis->cQueueEntriesMax
+                              && idxHead < cEntries && idxTail < cEntries,
+                              ("CQ%u: cEntries=%u idxHead=%u idxTail=%u\n", i, cEntries, idxHead, idxTail),
+                              VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+
+        nvmeR3CqCreate(pThis, (uint16_t)i, GCPhysBase, cEntries, fIntrEnabled, u32IntrVec);
+        pCq->Hdr.idxHead = idxHead;
+        pCq->Hdr.idxTail = idxTail;
+        pCq->fPhase      = fPhase;
+        for (uint32_t iWaiter = 0; iWaiter < cWaiters; iWaiter++)
+        {
+            PNVMECOMPWAITER pWaiter = (PNVMECOMPWAITER)RTMemAlloc(sizeof(*pWaiter));
+            if (!pWaiter)
+                return VERR_NO_MEMORY;
+            rc = SSMR3GetMem(pSSM, &pWaiter->Cqe, sizeof(pWaiter->Cqe));
+            if (RT_FAILURE(rc))
+            {
+                RTMemFree(pWaiter);
+                return rc;
+            }
+            RTListAppend(&pCq->LstCompletionsWaiting, &pWaiter->NdLstWait);
+            pCq->cWaiters++;
+        }
+    }
+
+    for (uint32_t i = 0; i <= pThis->cQueuesSubmMax; i++)
+    {
+        bool fCreated;
+        rc = SSMR3GetBool(pSSM, &fCreated);
+        AssertRCReturn(rc, rc);
+        if (!fCreated)
+            continue;
+
+        PNVMEQUEUESUBM pSq = &pThis->aQueuesSubm[i];
+        RTGCPHYS GCPhysBase;
+        uint32_t cEntries, idxHead, idxTail, uPrio;
+        uint16_t u16CqId;
+        SSMR3GetGCPhys(pSSM, &GCPhysBase);
+        SSMR3GetU32(pSSM, &cEntries);
+        SSMR3GetU32(pSSM, &idxHead);
+        SSMR3GetU32(pSSM, &idxTail);
+        SSMR3GetU16(pSSM, &u16CqId);
+        rc = SSMR3GetU32(pSSM, &uPrio);
+        AssertRCReturn(rc, rc);
+        AssertLogRelMsgReturn(   cEntries >= 2 && cEntries <= pThis->cQueueEntriesMax
+                              && idxHead < cEntries && idxTail < cEntries
+                              && u16CqId <= pThis->cQueuesCompMax
+                              && pThis->aQueuesComp[u16CqId].Hdr.enmState == NVMEQUEUESTATE_CREATED,
+                              ("SQ%u: cEntries=%u idxHead=%u idxTail=%u u16CqId=%u\n", i, cEntries, idxHead, idxTail, u16CqId),
+                              VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+
+        nvmeR3SqCreate(pThis, (uint16_t)i, GCPhysBase, cEntries, u16CqId, (NVMEQUEUEPRIO)uPrio);
+        pSq->Hdr.idxHead = idxHead;
+        pSq->Hdr.idxTail = idxTail;
+    }
+
+    /* Only now, creating the queues resets their doorbell buffer entries. */
+    pThis->GCPhysDbBufShadow = GCPhysDbBufShadow;
+    pThis->GCPhysDbBufEvtIdx = GCPhysDbBufEvtIdx;
+
+    SSMR3GetU32(pSSM, &pThis->cAsyncEvtReqs);
+    AssertLogRelMsgReturn(pThis->cAsyncEvtReqs <= RT_ELEMENTS(pThis->aAsyncEvtReqCids), ("%u\n", pThis->cAsyncEvtReqs),
+                          VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+    for (uint32_t i = 0; i < pThis->cAsyncEvtReqs; i++)
+        SSMR3GetU16(pSSM, &pThis->aAsyncEvtReqCids[i]);
+    SSMR3GetBool(pSSM, &pThis->fAsyncEvtNsChangedPending);
+    SSMR3GetBool(pSSM, &pThis->fAsyncEvtNsChangedMasked);
+    SSMR3GetMem(pSSM, &pThis->bmNsChanged[0], sizeof(pThis->bmNsChanged));
+
+    uint32_t cCmds;
+    rc = SSMR3GetU32(pSSM, &cCmds);
+    AssertRCReturn(rc, rc);
+    AssertLogRelMsgReturn(cCmds <= (pThis->cQueuesSubmMax + 1) * pThis->cQueueEntriesMax, ("%u\n", cCmds),
+                          VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+    if (cCmds)
+    {
+        pThis->paCmdsRestored = (PNVMECMDRESTORED)RTMemAllocZ(cCmds * sizeof(NVMECMDRESTORED));
+        if (!pThis->paCmdsRestored)
+            return VERR_NO_MEMORY;
+        for (uint32_t i = 0; i < cCmds; i++)
+        {
+            SSMR3GetU16(pSSM, &pThis->paCmdsRestored[i].u16SqId);
+            rc = SSMR3GetMem(pSSM, &pThis->paCmdsRestored[i].Cmd, sizeof(pThis->paCmdsRestored[i].Cmd));
+            AssertRCReturn(rc, rc);
+            AssertLogRelMsgReturn(pThis->paCmdsRestored[i].u16SqId <= pThis->cQueuesSubmMax,
+                                  ("%u\n", pThis->paCmdsRestored[i].u16SqId), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+        }
+        pThis->cCmdsRestored = cCmds;
+    }
+
+    rc = SSMR3GetU32(pSSM, &u32);
+    AssertRCReturn(rc, rc);
+    AssertLogRelMsgReturn(u32 == UINT32_MAX, ("%#x\n", u32), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+
+    ASMAtomicWriteU32((volatile uint32_t *)&pThis->enmState, enmState);
+    nvmeR3IntxUpdate(pThis);
+    return VINF_SUCCESS;
+}
+
+
+/* -=-=-=-=- PCI Device -=-=-=-=- */
+
+/**
+ * @callback_method_impl{FNPCIIOREGIONMAP}
+ */
+static DECLCALLBACK(int) nvmeR3Map(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, uint32_t iRegion,
+                                   RTGCPHYS GCPhysAddress, RTGCPHYS cb, PCIADDRESSSPACE enmType)
+{
+    RT_NOREF(pPciDev, iRegion, enmType);
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+
+    Assert(cb >= NVME_MMIO_SIZE);
+    int rc = PDMDevHlpMMIORegister(pDevIns, GCPhysAddress, cb, NULL /*pvUser*/,
+                                   IOMMMIO_FLAGS_READ_DWORD | IOMMMIO_FLAGS_WRITE_ONLY_DWORD,
+                                   nvmeMmioWrite, nvmeMmioRead, "NVMe");
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* Doorbells are handled in ring-0, everything else goes to ring-3. */
+    if (pThis->fR0Enabled)
+    {
+        rc = PDMDevHlpMMIORegisterR0(pDevIns, GCPhysAddress, cb, NIL_RTR0PTR /*pvUser*/, "nvmeMmioWrite", "nvmeMmioRead");
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
+    pThis->GCPhysMMIO = GCPhysAddress;
+    return VINF_SUCCESS;
+}
+
+
+/* -=-=-=-=- PDMDEVREG -=-=-=-=- */
+
+/**
+ * Callback employed by nvmeR3Suspend and nvmeR3PowerOff.
+ *
+ * @returns true if we've quiesced, false if we're still working.
+ * @param   pDevIns     The device instance.
+ */
+static DECLCALLBACK(bool) nvmeR3IsAsyncSuspendOrPowerOffDone(PPDMDEVINS pDevIns)
+{
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    if (!nvmeR3IsIdle(pThis))
+        return false;
+
+    ASMAtomicWriteBool(&pThis->fSignalIdle, false);
+    return true;
+}
+
+/**
+ * Common worker for nvmeR3Suspend and nvmeR3PowerOff.
+ */
+static void nvmeR3SuspendOrPowerOff(PPDMDEVINS pDevIns)
+{
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+
+    ASMAtomicWriteBool(&pThis->fSignalIdle, true);
+    if (!nvmeR3IsIdle(pThis))
+        PDMDevHlpSetAsyncNotification(pDevIns, nvmeR3IsAsyncSuspendOrPowerOffDone);
+    else
+        ASMAtomicWriteBool(&pThis->fSignalIdle, false);
+
+    for (uint32_t i = 0; i < pThis->cNamespaces; i++)
+    {
+        PNVMENAMESPACE pNs = &pThis->paNamespaces[i];
+        if (pNs->pDrvMediaEx)
+            pNs->pDrvMediaEx->pfnNotifySuspend(pNs->pDrvMediaEx);
+    }
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnSuspend}
+ */
+static DECLCALLBACK(void) nvmeR3Suspend(PPDMDEVINS pDevIns)
+{
+    Log(("nvmeR3Suspend\n"));
+    nvmeR3SuspendOrPowerOff(pDevIns);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnPowerOff}
+ */
+static DECLCALLBACK(void) nvmeR3PowerOff(PPDMDEVINS pDevIns)
+{
+    Log(("nvmeR3PowerOff\n"));
+    nvmeR3SuspendOrPowerOff(pDevIns);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnResume}
+ */
+static DECLCALLBACK(void) nvmeR3Resume(PPDMDEVINS pDevIns)
+{
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+
+    if (pThis->cCmdsRestored)
+    {
+        Log(("nvmeR3Resume: Resubmitting %u restored commands\n", pThis->cCmdsRestored));
+        for (uint32_t i = 0; i < pThis->cCmdsRestored; i++)
+        {
+            PNVMEQUEUESUBM pSq = &pThis->aQueuesSubm[pThis->paCmdsRestored[i].u16SqId];
+            if (pSq->Hdr.enmState == NVMEQUEUESTATE_CREATED)
+                nvmeR3IoCmdSubmit(pThis, pSq, &pThis->paCmdsRestored[i].Cmd);
+        }
+
+        RTMemFree(pThis->paCmdsRestored);
+        pThis->paCmdsRestored = NULL;
+        pThis->cCmdsRestored  = 0;
+    }
+
+    /* Pick up doorbell writes which came in while suspending. */
+    nvmeR3WrkThrdsWakeUp(pThis);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnReset}
+ */
+static DECLCALLBACK(void) nvmeR3Reset(PPDMDEVINS pDevIns)
+{
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+
+    nvmeR3CtrlReset(pThis);
+    pThis->u32RegCc  = 0;
+    pThis->u32RegAqa = 0;
+    pThis->u64RegAsq = 0;
+    pThis->u64RegAcq = 0;
+}
+
+/**
+ * Queries the medium properties of a namespace.
+ *
+ * @param   pNs         The namespace.
+ */
+static void nvmeR3NamespaceUpdateMediumInfo(PNVMENAMESPACE pNs)
+{
+    pNs->cbBlock     = 512;
+    pNs->cBlockShift = 9;
+    pNs->cBlocks     = 0;
+    pNs->fReadOnly   = false;
+    pNs->fDiscard    = false;
+    if (pNs->pDrvMedia)
+    {
+        uint32_t cbBlock = pNs->pDrvMedia->pfnGetSectorSize(pNs->pDrvMedia);
+        if (cbBlock > 512 && cbBlock <= _64K && RT_IS_POWER_OF_TWO(cbBlock))
+        {
+            pNs->cbBlock     = cbBlock;
+            pNs->cBlockShift = ASMBitFirstSetU32(cbBlock) - 1;
+        }
+        pNs->cBlocks   = pNs->pDrvMedia->pfnGetSize(pNs->pDrvMedia) >> pNs->cBlockShift;
+        pNs->fReadOnly = pNs->pDrvMedia->pfnIsReadOnly(pNs->pDrvMedia);
+
+        uint32_t fFeatures = 0;
+        int rc = pNs->pDrvMediaEx->pfnQueryFeatures(pNs->pDrvMediaEx, &fFeatures);
+        if (RT_SUCCESS(rc) && (fFeatures & PDMIMEDIAEX_FEATURE_F_DISCARD))
+            pNs->fDiscard = true;
+    }
+}
+
+/**
+ * Attaches the medium driver of a namespace and queries its interfaces.
+ *
+ * @returns VBox status code.
+ * @param   pDevIns     The device instance.
+ * @param   pNs         The namespace.
+ */
+static int nvmeR3NamespaceAttach(PPDMDEVINS pDevIns, PNVMENAMESPACE pNs)
+{
+    int rc = PDMDevHlpDriverAttach(pDevIns, pNs->iLUN, &pNs->IBase, &pNs->pDrvBase, pNs->szDesc);
+    if (RT_SUCCESS(rc))
+    {
+        pNs->pDrvMedia = PDMIBASE_QUERY_INTERFACE(pNs->pDrvBase, PDMIMEDIA);
+        AssertMsgReturn(VALID_PTR(pNs->pDrvMedia),
+                        ("NVMe configuration error: LUN#%u misses the basic media interface!\n", pNs->iLUN),
+                        VERR_PDM_MISSING_INTERFACE);
+
+        pNs->pDrvMediaEx = PDMIBASE_QUERY_INTERFACE(pNs->pDrvBase, PDMIMEDIAEX);
+        AssertMsgReturn(VALID_PTR(pNs->pDrvMediaEx),
+                        ("NVMe configuration error: LUN#%u misses the extended media interface!\n", pNs->iLUN),
+                        VERR_PDM_MISSING_INTERFACE);
+
+        PDMMEDIATYPE enmType = pNs->pDrvMedia->pfnGetType(pNs->pDrvMedia);
+        AssertMsgReturn(enmType == PDMMEDIATYPE_HARD_DISK,
+                        ("NVMe configuration error: LUN#%u isn't a disk. enmType=%u\n", pNs->iLUN, enmType),
+                        VERR_PDM_UNSUPPORTED_BLOCK_TYPE);
+
+        rc = pNs->pDrvMediaEx->pfnIoReqAllocSizeSet(pNs->pDrvMediaEx, sizeof(NVMEREQ));
+        if (RT_FAILURE(rc))
+            return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS,
+                                       N_("NVMe configuration error: LUN#%u: Failed to set I/O request size!"),
+                                       pNs->iLUN);
+    }
+    else if (   rc == VERR_PDM_NO_ATTACHED_DRIVER
+             || rc == VERR_PDM_CFG_MISSING_DRIVER_NAME)
+    {
+        Log(("NVMe: LUN#%u: No medium attached\n", pNs->iLUN));
+        pNs->pDrvBase    = NULL;
+        pNs->pDrvMedia   = NULL;
+        pNs->pDrvMediaEx = NULL;
+        rc = VINF_SUCCESS;
+    }
+    else
+        return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS, N_("NVMe: Failed to attach drive to %s"), pNs->szDesc);
+
+    nvmeR3NamespaceUpdateMediumInfo(pNs);
+    if (pNs->pDrvBase)
+        LogRel(("NVMe#%u: LUN#%u: %llu blocks of %u bytes%s%s\n", pDevIns->iInstance, pNs->iLUN, pNs->cBlocks,
+                pNs->cbBlock, pNs->fReadOnly ? ", read only" : "", pNs->fDiscard ? ", discard" : ""));
+    return rc;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnDetach}
+ */
+static DECLCALLBACK(void) nvmeR3Detach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t fFlags)
+{
+    RT_NOREF(fFlags);
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    Log(("nvmeR3Detach: iLUN=%u\n", iLUN));
+
+    AssertLogRelReturnVoid(iLUN < pThis->cNamespaces);
+    PNVMENAMESPACE pNs = &pThis->paNamespaces[iLUN];
+
+    /* The workers must not submit anything to the namespace while zapping the interfaces. */
+    nvmeR3WrkThrdsLock(pThis);
+    pNs->pDrvBase    = NULL;
+    pNs->pDrvMedia   = NULL;
+    pNs->pDrvMediaEx = NULL;
+    nvmeR3NamespaceUpdateMediumInfo(pNs);
+    nvmeR3WrkThrdsUnlock(pThis);
+
+    if (!(fFlags & PDM_TACH_FLAGS_NOT_HOT_PLUG))
+        nvmeR3AsyncEvtNsChanged(pThis, pNs->u32Id);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnAttach}
+ */
+static DECLCALLBACK(int) nvmeR3Attach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t fFlags)
+{
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    LogFlow(("nvmeR3Attach: iLUN=%u\n", iLUN));
+
+    AssertLogRelReturn(iLUN < pThis->cNamespaces, VERR_PDM_NO_SUCH_LUN);
+    PNVMENAMESPACE pNs = &pThis->paNamespaces[iLUN];
+
+    /* the usual paranoia */
+    AssertRelease(!pNs->pDrvBase);
+    AssertRelease(!pNs->pDrvMedia);
+    AssertRelease(!pNs->pDrvMediaEx);
+
+    nvmeR3WrkThrdsLock(pThis);
+    int rc = nvmeR3NamespaceAttach(pDevIns, pNs);
+    nvmeR3WrkThrdsUnlock(pThis);
+
+    if (   RT_SUCCESS(rc)
+        && !(fFlags & PDM_TACH_FLAGS_NOT_HOT_PLUG))
+        nvmeR3AsyncEvtNsChanged(pThis, pNs->u32Id);
+    return rc;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnRelocate}
+ */
+static DECLCALLBACK(void) nvmeR3Relocate(PPDMDEVINS pDevIns, RTGCINTPTR offDelta)
+{
+    RT_NOREF(offDelta);
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    pThis->pDevInsRC = PDMDEVINS_2_RCPTR(pDevIns);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnDestruct}
+ */
+static DECLCALLBACK(int) nvmeR3Destruct(PPDMDEVINS pDevIns)
+{
+    PDMDEV_CHECK_VERSIONS_RETURN_QUIET(pDevIns);
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+
+    if (pThis->paWrkThrds)
+    {
+        for (uint32_t i = 0; i < pThis->cWrkThrdsMax; i++)
+        {
+            PNVMEWRKTHRD pWrkThrd = &pThis->paWrkThrds[i];
+            if (pWrkThrd->hEvtProcess != NIL_SUPSEMEVENT)
+            {
+                SUPSemEventClose(pThis->pSupDrvSession, pWrkThrd->hEvtProcess);
+                pWrkThrd->hEvtProcess = NIL_SUPSEMEVENT;
+            }
+            if (RTCritSectIsInitialized(&pWrkThrd->CritSect))
+                RTCritSectDelete(&pWrkThrd->CritSect);
+        }
+    }
+
+    for (uint32_t i = 0; i < RT_ELEMENTS(pThis->aQueuesComp); i++)
+    {
+        PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[i];
+        if (pCq->hMtx != NIL_RTSEMFASTMUTEX)
+        {
+            nvmeR3CqDelete(pThis, pCq);
+            RTSemFastMutexDestroy(pCq->hMtx);
+            pCq->hMtx = NIL_RTSEMFASTMUTEX;
+        }
+    }
+
+    if (PDMCritSectIsInitialized(&pThis->CritSectAsyncEvtReqs))
+        PDMR3CritSectDelete(&pThis->CritSectAsyncEvtReqs);
+    if (PDMCritSectIsInitialized(&pThis->CritSectIntx))
+        PDMR3CritSectDelete(&pThis->CritSectIntx);
+
+    RTMemFree(pThis->paCmdsRestored);
+    pThis->paCmdsRestored = NULL;
+    pThis->cCmdsRestored  = 0;
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnConstruct}
+ */
+static DECLCALLBACK(int) nvmeR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFGMNODE pCfg)
+{
+    PDMDEV_CHECK_VERSIONS_RETURN(pDevIns);
+    PNVME pThis = PDMINS_2_DATA(pDevIns, PNVME);
+    int   rc;
+
+    /*
+     * Initialize the members the destructor looks at.
+     */
+    pThis->pDevInsR3         = pDevIns;
+    pThis->pDevInsR0         = PDMDEVINS_2_R0PTR(pDevIns);
+    pThis->pDevInsRC         = PDMDEVINS_2_RCPTR(pDevIns);
+    pThis->pSupDrvSession    = PDMDevHlpGetSupDrvSession(pDevIns);
+    pThis->enmState          = NVMESTATE_DISABLED;
+    pThis->cbPage            = NVME_PAGE_SIZE;
+    pThis->GCPhysDbBufShadow = NIL_RTGCPHYS;
+    pThis->GCPhysDbBufEvtIdx = NIL_RTGCPHYS;
+    for (uint32_t i = 0; i < RT_ELEMENTS(pThis->aQueuesSubm); i++)
+    {
+        PNVMEQUEUESUBM pSq = &pThis->aQueuesSubm[i];
+        pSq->Hdr.u16Id       = (uint16_t)i;
+        pSq->Hdr.enmState    = NVMEQUEUESTATE_FREE;
+        pSq->Hdr.enmType     = NVMEQUEUETYPE_SUBMISSION;
+        pSq->hEvtProcess     = NIL_SUPSEMEVENT;
+    }
+    for (uint32_t i = 0; i < RT_ELEMENTS(pThis->aQueuesComp); i++)
+    {
+        PNVMEQUEUECOMP pCq = &pThis->aQueuesComp[i];
+        pCq->Hdr.u16Id       = (uint16_t)i;
+        pCq->Hdr.enmState    = NVMEQUEUESTATE_FREE;
+        pCq->Hdr.enmType     = NVMEQUEUETYPE_COMPLETION;
+        pCq->hMtx            = NIL_RTSEMFASTMUTEX;
+        RTListInit(&pCq->LstCompletionsWaiting);
+    }
+
+    /*
+     * Validate and read configuration.
+     */
+    if (!CFGMR3AreValuesValid(pCfg,
+                              "NamespacesMax\0"
+                              "QueuesSubmMax\0"
+                              "QueuesCompMax\0"
+                              "QueueEntriesMax\0"
+                              "WrkThrdsMax\0"
+                              "SerialNumber\0"
+                              "ModelNumber\0"
+                              "FirmwareRevision\0"
+                              "R0Enabled\0"))
+        return PDMDEV_SET_ERROR(pDevIns, VERR_PDM_DEVINS_UNKNOWN_CFG_VALUES,
+                                N_("NVMe configuration error: unknown option specified"));
+
+    /** @cfgm{/Devices/nvme/0/Config/NamespacesMax, uint32_t, 1}
+     * Number of namespaces, one for each LUN. */
+    rc = CFGMR3QueryU32Def(pCfg, "NamespacesMax", &pThis->cNamespaces, 1);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe configuration error: failed to read NamespacesMax as integer"));
+    if (pThis->cNamespaces < 1 || pThis->cNamespaces > NVME_NAMESPACES_MAX)
+        return PDMDevHlpVMSetError(pDevIns, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                                   N_("NVMe configuration error: NamespacesMax=%u should be at least 1 and at most %u"),
+                                   pThis->cNamespaces, NVME_NAMESPACES_MAX);
+
+    /** @cfgm{/Devices/nvme/0/Config/QueuesSubmMax, uint32_t, 16}
+     * Maximum number of I/O submission queues. */
+    rc = CFGMR3QueryU32Def(pCfg, "QueuesSubmMax", &pThis->cQueuesSubmMax, NVME_QUEUES_IO_DEFAULT);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe configuration error: failed to read QueuesSubmMax as integer"));
+    if (pThis->cQueuesSubmMax < 1 || pThis->cQueuesSubmMax > NVME_QUEUES_IO_MAX)
+        return PDMDevHlpVMSetError(pDevIns, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                                   N_("NVMe configuration error: QueuesSubmMax=%u should be at least 1 and at most %u"),
+                                   pThis->cQueuesSubmMax, NVME_QUEUES_IO_MAX);
+
+    /** @cfgm{/Devices/nvme/0/Config/QueuesCompMax, uint32_t, 16}
+     * Maximum number of I/O completion queues, each gets its own MSI-X vector. */
+    rc = CFGMR3QueryU32Def(pCfg, "QueuesCompMax", &pThis->cQueuesCompMax, NVME_QUEUES_IO_DEFAULT);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe configuration error: failed to read QueuesCompMax as integer"));
+    if (pThis->cQueuesCompMax < 1 || pThis->cQueuesCompMax > NVME_QUEUES_IO_MAX)
+        return PDMDevHlpVMSetError(pDevIns, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                                   N_("NVMe configuration error: QueuesCompMax=%u should be at least 1 and at most %u"),
+                                   pThis->cQueuesCompMax, NVME_QUEUES_IO_MAX);
+
+    /** @cfgm{/Devices/nvme/0/Config/QueueEntriesMax, uint32_t, 1024}
+     * Maximum number of entries in a queue (CAP.MQES + 1). */
+    rc = CFGMR3QueryU32Def(pCfg, "QueueEntriesMax", &pThis->cQueueEntriesMax, NVME_QUEUE_ENTRIES_DEFAULT);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe configuration error: failed to read QueueEntriesMax as integer"));
+    if (pThis->cQueueEntriesMax < 2 || pThis->cQueueEntriesMax > _64K)
+        return PDMDevHlpVMSetError(pDevIns, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                                   N_("NVMe configuration error: QueueEntriesMax=%u should be at least 2 and at most 65536"),
+                                   pThis->cQueueEntriesMax);
+
+    /** @cfgm{/Devices/nvme/0/Config/WrkThrdsMax, uint32_t, number of online host CPUs}
+     * Number of worker threads processing the submission queues, at most 16. */
+    rc = CFGMR3QueryU32Def(pCfg, "WrkThrdsMax", &pThis->cWrkThrdsMax,
+                           RT_MIN(RT_MAX(RTMpGetOnlineCount(), 1), NVME_WRK_THRDS_MAX));
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe configuration error: failed to read WrkThrdsMax as integer"));
+    if (pThis->cWrkThrdsMax < 1 || pThis->cWrkThrdsMax > NVME_WRK_THRDS_MAX)
+        return PDMDevHlpVMSetError(pDevIns, VERR_INVALID_PARAMETER, RT_SRC_POS,
+                                   N_("NVMe configuration error: WrkThrdsMax=%u should be at least 1 and at most %u"),
+                                   pThis->cWrkThrdsMax, NVME_WRK_THRDS_MAX);
+
+    /** @cfgm{/Devices/nvme/0/Config/SerialNumber, string, "VB-NVME<instance>"}
+     * The serial number reported by Identify Controller, at most 20 characters. */
+    char szDefSerial[NVME_SERIAL_NUMBER_LENGTH + 1];
+    RTStrPrintf(szDefSerial, sizeof(szDefSerial), "VB-NVME%d", iInstance);
+    rc = CFGMR3QueryStringDef(pCfg, "SerialNumber", pThis->szSerialNumber, sizeof(pThis->szSerialNumber), szDefSerial);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc,
+                                N_("NVMe configuration error: failed to read SerialNumber (at most 20 characters)"));
+
+    /** @cfgm{/Devices/nvme/0/Config/ModelNumber, string, "VBOX NVMe Disk"}
+     * The model number reported by Identify Controller, at most 40 characters. */
+    rc = CFGMR3QueryStringDef(pCfg, "ModelNumber", pThis->szModelNumber, sizeof(pThis->szModelNumber), "VBOX NVMe Disk");
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc,
+                                N_("NVMe configuration error: failed to read ModelNumber (at most 40 characters)"));
+
+    /** @cfgm{/Devices/nvme/0/Config/FirmwareRevision, string, "1.0"}
+     * The firmware revision reported by Identify Controller, at most 8 characters. */
+    rc = CFGMR3QueryStringDef(pCfg, "FirmwareRevision", pThis->szFirmwareRevision, sizeof(pThis->szFirmwareRevision), "1.0");
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc,
+                                N_("NVMe configuration error: failed to read FirmwareRevision (at most 8 characters)"));
+
+    /** @cfgm{/Devices/nvme/0/Config/R0Enabled, bool, true}
+     * Whether the doorbells are handled in ring-0. */
+    rc = CFGMR3QueryBoolDef(pCfg, "R0Enabled", &pThis->fR0Enabled, true);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe configuration error: failed to read R0Enabled as boolean"));
+
+    /* The doorbells of all queues must fit into the register BAR. */
+    AssertCompile(NVME_REG_DOORBELL_FIRST + (NVME_QUEUES_IO_MAX + 1) * 2 * sizeof(uint32_t) <= NVME_MMIO_SIZE);
+
+    pThis->u64RegCap =   (pThis->cQueueEntriesMax - 1)
+                       | NVME_CAP_CQR
+                       | ((uint64_t)15 << NVME_CAP_TO_SHIFT)   /* 7.5 seconds to become ready. */
+                       | NVME_CAP_CSS_NVM;                      /* MPSMIN = MPSMAX = 0 (4KiB), DSTRD = 0. */
+    pThis->cTimeoutMax = 15;
+    nvmeR3FeaturesReset(pThis);
+
+    /*
+     * Interfaces.
+     */
+    pThis->IBase.pfnQueryInterface = nvmeR3Status_QueryInterface;
+    pThis->ILeds.pfnQueryStatusLed = nvmeR3Status_QueryStatusLed;
+
+    /*
+     * We do our own locking, the doorbells must not be serialized.
+     */
+    rc = PDMDevHlpSetDeviceCritSect(pDevIns, PDMDevHlpCritSectGetNop(pDevIns));
+    AssertRCReturn(rc, rc);
+
+    rc = PDMDevHlpCritSectInit(pDevIns, &pThis->CritSectAsyncEvtReqs, RT_SRC_POS, "NVMe#%u-AER", iInstance);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe: Failed to create critical section"));
+    rc = PDMDevHlpCritSectInit(pDevIns, &pThis->CritSectIntx, RT_SRC_POS, "NVMe#%u-Intx", iInstance);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe: Failed to create critical section"));
+
+    for (uint32_t i = 0; i <= pThis->cQueuesCompMax; i++)
+    {
+        rc = RTSemFastMutexCreate(&pThis->aQueuesComp[i].hMtx);
+        if (RT_FAILURE(rc))
+            return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe: Failed to create completion queue mutex"));
+    }
+
+    /*
+     * PCI device setup.
+     */
+    PDMPciDevSetVendorId(&pThis->PciDev,            NVME_PCI_VENDOR_ID);
+    PDMPciDevSetDeviceId(&pThis->PciDev,            NVME_PCI_DEVICE_ID);
+    PDMPciDevSetSubSystemVendorId(&pThis->PciDev,   NVME_PCI_VENDOR_ID);
+    PDMPciDevSetSubSystemId(&pThis->PciDev,         NVME_PCI_DEVICE_ID);
+    PDMPciDevSetClassBase(&pThis->PciDev,           0x01); /* Mass storage controller. */
+    PDMPciDevSetClassSub(&pThis->PciDev,            0x08); /* Non-volatile memory controller. */
+    PDMPciDevSetClassProg(&pThis->PciDev,           0x02); /* NVM Express. */
+    PDMPciDevSetInterruptPin(&pThis->PciDev,        0x01);
+    PDMPciDevSetStatus(&pThis->PciDev,              VBOX_PCI_STATUS_CAP_LIST);
+    PDMPciDevSetCapabilityList(&pThis->PciDev,      NVME_PCI_MSIX_CAP_OFF);
+
+    rc = PDMDevHlpPCIRegister(pDevIns, &pThis->PciDev);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    rc = PDMDevHlpPCIIORegionRegister(pDevIns, 0, NVME_MMIO_SIZE,
+                                      (PCIADDRESSSPACE)(PCI_ADDRESS_SPACE_MEM | PCI_ADDRESS_SPACE_BAR64), nvmeR3Map);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe cannot register PCI memory region for registers"));
+
+#ifdef VBOX_WITH_MSI_DEVICES
+    /* One vector for the admin queue and one for every I/O completion queue. */
+    PDMMSIREG MsiReg;
+    RT_ZERO(MsiReg);
+    MsiReg.cMsixVectors    = (uint16_t)(pThis->cQueuesCompMax + 1);
+    MsiReg.iMsixCapOffset  = NVME_PCI_MSIX_CAP_OFF;
+    MsiReg.iMsixNextOffset = 0;
+    MsiReg.iMsixBar        = NVME_PCI_MSIX_BAR;
+    rc = PDMDevHlpPCIRegisterMsi(pDevIns, &MsiReg);
+    if (RT_SUCCESS(rc))
+        pThis->cMsixVectors = MsiReg.cMsixVectors;
+    else
+#endif
+    {
+        /* The chipset has no MSI-X support, all queues share INTx. */
+        PDMPciDevSetCapabilityList(&pThis->PciDev, 0);
+        PDMPciDevSetStatus(&pThis->PciDev, 0);
+        LogRel(("NVMe#%u: MSI-X not available, using INTx\n", iInstance));
+    }
+
+    /*
+     * Worker threads.
+     */
+    pThis->paWrkThrds = (PNVMEWRKTHRD)PDMDevHlpMMHeapAllocZ(pDevIns, pThis->cWrkThrdsMax * sizeof(NVMEWRKTHRD));
+    if (!pThis->paWrkThrds)
+        return VERR_NO_MEMORY;
+    for (uint32_t i = 0; i < pThis->cWrkThrdsMax; i++)
+    {
+        PNVMEWRKTHRD pWrkThrd = &pThis->paWrkThrds[i];
+        pWrkThrd->idWrkThrd   = i;
+        pWrkThrd->hEvtProcess = NIL_SUPSEMEVENT;
+        RTListInit(&pWrkThrd->LstSubmQueuesAssgnd);
+
+        rc = RTCritSectInit(&pWrkThrd->CritSect);
+        if (RT_FAILURE(rc))
+            return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe: Failed to create worker critical section"));
+
+        rc = SUPSemEventCreate(pThis->pSupDrvSession, &pWrkThrd->hEvtProcess);
+        if (RT_FAILURE(rc))
+            return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS, N_("NVMe: Failed to create SUP event semaphore"));
+
+        char szName[16];
+        RTStrPrintf(szName, sizeof(szName), "NVMe#%u-W%u", iInstance, i);
+        rc = PDMDevHlpThreadCreate(pDevIns, &pWrkThrd->pThrd, pWrkThrd, nvmeR3WrkThrdLoop, nvmeR3WrkThrdWakeUp,
+                                   0, RTTHREADTYPE_IO, szName);
+        if (RT_FAILURE(rc))
+            return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS, N_("NVMe: Failed to create worker thread %u"), i);
+    }
+
+    /*
+     * Namespaces.
+     */
+    pThis->paNamespaces = (PNVMENAMESPACE)PDMDevHlpMMHeapAllocZ(pDevIns, pThis->cNamespaces * sizeof(NVMENAMESPACE));
+    if (!pThis->paNamespaces)
+        return VERR_NO_MEMORY;
+    for (uint32_t i = 0; i < pThis->cNamespaces; i++)
+    {
+        PNVMENAMESPACE pNs = &pThis->paNamespaces[i];
+        pNs->u32Id                                 = i + 1;
+        pNs->iLUN                                  = i;
+        pNs->pNvmeR3                               = pThis;
+        pNs->Led.u32Magic                          = PDMLED_MAGIC;
+        pNs->IBase.pfnQueryInterface               = nvmeR3NamespaceQueryInterface;
+        pNs->IMediaPort.pfnQueryDeviceLocation     = nvmeR3QueryDeviceLocation;
+        pNs->IMediaPort.pfnQueryScsiInqStrings     = NULL;
+        pNs->IMediaExPort.pfnIoReqCompleteNotify   = nvmeR3IoReqCompleteNotify;
+        pNs->IMediaExPort.pfnIoReqCopyFromBuf      = nvmeR3IoReqCopyFromBuf;
+        pNs->IMediaExPort.pfnIoReqCopyToBuf        = nvmeR3IoReqCopyToBuf;
+        pNs->IMediaExPort.pfnIoReqQueryBuf         = NULL;
+        pNs->IMediaExPort.pfnIoReqQueryDiscardRanges = nvmeR3IoReqQueryDiscardRanges;
+        pNs->IMediaExPort.pfnIoReqStateChanged     = nvmeR3IoReqStateChanged;
+        pNs->IMediaExPort.pfnMediumEjected         = nvmeR3MediumEjected;
+        RTStrPrintf(pNs->szDesc, sizeof(pNs->szDesc), "Namespace%u", pNs->u32Id);
+
+        rc = nvmeR3NamespaceAttach(pDevIns, pNs);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
+    /*
+     * Attach status driver (optional).
+     */
+    PPDMIBASE pBase;
+    rc = PDMDevHlpDriverAttach(pDevIns, PDM_STATUS_LUN, &pThis->IBase, &pBase, "Status Port");
+    if (RT_SUCCESS(rc))
+        pThis->pLedsConnector = PDMIBASE_QUERY_INTERFACE(pBase, PDMILEDCONNECTORS);
+    else if (rc != VERR_PDM_NO_ATTACHED_DRIVER)
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe cannot attach to status driver"));
+
+    rc = PDMDevHlpSSMRegisterEx(pDevIns, NVME_SAVED_STATE_VERSION, sizeof(*pThis), NULL,
+                                NULL,           nvmeR3LiveExec, NULL,
+                                NULL,           nvmeR3SaveExec, NULL,
+                                NULL,           nvmeR3LoadExec, NULL);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("NVMe cannot register save state handlers"));
+
+    /*
+     * Statistics.
+     */
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatDoorbellWritesSq,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Submission queue doorbell writes",                   "/Devices/NVMe%d/DoorbellWritesSq", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatDoorbellWritesCq,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Completion queue doorbell writes",                   "/Devices/NVMe%d/DoorbellWritesCq", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatDoorbellWritesCqR3, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Completion queue doorbell writes needing ring-3",    "/Devices/NVMe%d/DoorbellWritesCqR3", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCmdsAdmin,          STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of admin commands",                           "/Devices/NVMe%d/Cmds/Admin", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCmdsRead,           STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of read commands",                            "/Devices/NVMe%d/Cmds/Read", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCmdsWrite,          STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of write commands",                           "/Devices/NVMe%d/Cmds/Write", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCmdsFlush,          STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of flush commands",                           "/Devices/NVMe%d/Cmds/Flush", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCmdsDsm,            STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of dataset management commands",              "/Devices/NVMe%d/Cmds/Dsm", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCmdsWriteZeroes,    STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of write zeroes commands",                    "/Devices/NVMe%d/Cmds/WriteZeroes", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCmdsFailed,         STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of commands completed with an error",         "/Devices/NVMe%d/Cmds/Failed", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatBytesRead,          STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,      "Amount of data read",                                "/Devices/NVMe%d/ReadBytes", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatBytesWritten,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,      "Amount of data written",                             "/Devices/NVMe%d/WrittenBytes", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCqFull,             STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Completions delayed because the queue was full",     "/Devices/NVMe%d/CqFull", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatIntrsBatched,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Completions published with a later interrupt",       "/Devices/NVMe%d/IntrsBatched", iInstance);
+    for (uint32_t i = 0; i <= pThis->cQueuesSubmMax; i++)
+        PDMDevHlpSTAMRegisterF(pDevIns, &pThis->aQueuesSubm[i].StatCmds,  STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "Commands fetched from the submission queue", "/Devices/NVMe%d/Queue%u/Cmds", iInstance, i);
+    for (uint32_t i = 0; i <= pThis->cQueuesCompMax; i++)
+        PDMDevHlpSTAMRegisterF(pDevIns, &pThis->aQueuesComp[i].StatIntrs, STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "Interrupts raised for the completion queue", "/Devices/NVMe%d/Queue%u/Intrs", iInstance, i);
+
+    LogRel(("NVMe#%u: %u namespaces, %u/%u I/O queues with %u entries, %u workers, %u MSI-X vectors%s\n",
+            iInstance, pThis->cNamespaces, pThis->cQueuesSubmMax, pThis->cQueuesCompMax, pThis->cQueueEntriesMax,
+            pThis->cWrkThrdsMax, pThis->cMsixVectors, pThis->fR0Enabled ? ", doorbells in ring-0" : ""));
+    return VINF_SUCCESS;
+}
+
+/**
+ * The device registration structure.
+ */
+const PDMDEVREG g_DeviceNVMe =
+{
+    /* Structure version. PDM_DEVREG_VERSION defines the current version. */
+    PDM_DEVREG_VERSION,
+    /* Device name. */
+    "nvme",
+    /* Name of guest context module (no path).
+     * Only evalutated if PDM_DEVREG_FLAGS_RC is set. */
+    "",
+    /* Name of ring-0 module (no path).
+     * Only evalutated if PDM_DEVREG_FLAGS_R0 is set. */
+    "VBoxDDR0.r0",
+    /* The description of the device. The UTF-8 string pointed to shall, like this structure,
+     * remain unchanged from registration till VM destruction. */
+    "NVM Express Controller.\n",
+
+    /* Flags, combination of the PDM_DEVREG_FLAGS_* \#defines. */
+    PDM_DEVREG_FLAGS_DEFAULT_BITS | PDM_DEVREG_FLAGS_R0,
+    /* Device class(es), combination of the PDM_DEVREG_CLASS_* \#defines. */
+    PDM_DEVREG_CLASS_STORAGE,
+    /* Maximum number of instances (per VM). */
+    ~0U,
+    /* Size of the instance data. */
+    sizeof(NVME),
+
+    /* pfnConstruct */
+    nvmeR3Construct,
+    /* pfnDestruct */
+    nvmeR3Destruct,
+    /* pfnRelocate */
+    nvmeR3Relocate,
+    /* pfnMemSetup. */
+    NULL,
+    /* pfnPowerOn */
+    NULL,
+    /* pfnReset */
+    nvmeR3Reset,
+    /* pfnSuspend */
+    nvmeR3Suspend,
+    /* pfnResume */
+    nvmeR3Resume,
+    /* pfnAttach */
+    nvmeR3Attach,
+    /* pfnDetach */
+    nvmeR3Detach,
+    /* pfnQueryInterface */
+    NULL,
+    /* pfnInitComplete */
+    NULL,
+    /* pfnPowerOff */
+    nvmeR3PowerOff,
+    /* pfnSoftReset */
+    NULL,
+    /* u32VersionEnd */
+    PDM_DEVREG_VERSION
+};
+
+#endif /* IN_RING3 */
+#endif /* !VBOX_DEVICE_STRUCT_TESTCASE */
@@ -0,0 +1,1620 @@
+/* $Id: DevVirtioBlk.cpp $ */
+/** @file
+ * DevVirtioBlk - Virtio Block Device
+ */
+
+/*
+ * Copyright (C) 2009-2019 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define LOG_GROUP LOG_GROUP_DEV_VIRTIO
+
+#include <VBox/vmm/pdmdev.h>
+#include <VBox/vmm/pdmstorageifs.h>
+#include <iprt/asm.h>
+#include <iprt/string.h>
+#ifdef IN_RING3
+# include <iprt/mem.h>
+# include <iprt/sg.h>
+# include <iprt/uuid.h>
+#endif
+#include "VBoxDD.h"
+#include "../VirtIO/Virtio.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+#ifndef VBOX_DEVICE_STRUCT_TESTCASE
+
+#define INSTANCE(pThis) pThis->VPCI.szInstance
+
+#ifdef IN_RING3
+
+#define VBLK_PCI_CLASS               0x0180
+#define VBLK_N_QUEUES                1
+#define VBLK_NAME_FMT                "VBlk%d"
+
+#endif /* IN_RING3 */
+
+#endif /* VBOX_DEVICE_STRUCT_TESTCASE */
+
+/** The size of the request queue. */
+#define VBLK_QUEUE_SIZE              256
+/** Maximum number of data segments in a request (seg_max), the header and
+ *  status descriptors are not counted. */
+#define VBLK_SEG_MAX                 (VBLK_QUEUE_SIZE - 2)
+/** The sector size the virtio-blk protocol addresses the disk in. */
+#define VBLK_SECTOR_SIZE             512
+/** Maximum number of ranges in a single discard request. */
+#define VBLK_MAX_DISCARD_SEG         32
+/** Maximum number of sectors for a single discard range. */
+#define VBLK_MAX_DISCARD_SECTORS     UINT32_C(0x3fffff)
+/** Maximum number of sectors for a single write zeroes request.
+ * The zeroes are written through an ordinary write, keep the buffer sane. */
+#define VBLK_MAX_WRITE_ZEROES_SECTORS _8K
+/** Size of the identification string returned by VBLK_T_GET_ID. */
+#define VBLK_ID_BYTES                20
+
+/** @name Virtio block features
+ * @{  */
+#define VBLK_F_SIZE_MAX       0x00000002  /**< Maximum size of any single segment is in size_max. */
+#define VBLK_F_SEG_MAX        0x00000004  /**< Maximum number of segments in a request is in seg_max. */
+#define VBLK_F_GEOMETRY       0x00000010  /**< Disk-style geometry specified in geometry. */
+#define VBLK_F_RO             0x00000020  /**< Device is read-only. */
+#define VBLK_F_BLK_SIZE       0x00000040  /**< Block size of disk is in blk_size. */
+#define VBLK_F_FLUSH          0x00000200  /**< Cache flush command support. */
+#define VBLK_F_TOPOLOGY       0x00000400  /**< Device exports information on optimal I/O alignment. */
+#define VBLK_F_CONFIG_WCE     0x00000800  /**< Device can toggle its cache between writeback and writethrough modes. */
+#define VBLK_F_DISCARD        0x00002000  /**< Device can support discard command. */
+#define VBLK_F_WRITE_ZEROES   0x00004000  /**< Device can support write zeroes command. */
+/** @} */
+
+/** @name Virtio block request types
+ * @{  */
+#define VBLK_T_IN             0
+#define VBLK_T_OUT            1
+#define VBLK_T_FLUSH          4
+#define VBLK_T_GET_ID         8
+#define VBLK_T_DISCARD        11
+#define VBLK_T_WRITE_ZEROES   13
+/** @} */
+
+/** @name Virtio block request status
+ * @{  */
+#define VBLK_S_OK             0
+#define VBLK_S_IOERR          1
+#define VBLK_S_UNSUPP         2
+/** @} */
+
+/** Discard / write zeroes segment flag: the device may unmap the range. */
+#define VBLK_DWZ_F_UNMAP      0x00000001
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+#pragma pack(1)
+/**
+ * The device specific part of the configuration space.
+ */
+struct VBlkPCIConfig
+{
+    uint64_t uCapacity;             /**< Capacity in 512 byte sectors. */
+    uint32_t cbSizeMax;             /**< Maximum size of a segment (VBLK_F_SIZE_MAX). */
+    uint32_t cSegMax;               /**< Maximum number of segments (VBLK_F_SEG_MAX). */
+    uint16_t cCylinders;            /**< Geometry: cylinders (VBLK_F_GEOMETRY). */
+    uint8_t  cHeads;                /**< Geometry: heads (VBLK_F_GEOMETRY). */
+    uint8_t  cSectors;              /**< Geometry: sectors (VBLK_F_GEOMETRY). */
+    uint32_t cbBlk;                 /**< Block size (VBLK_F_BLK_SIZE). */
+    uint8_t  uPhysBlkExp;           /**< Topology: log2 of logical blocks per physical block. */
+    uint8_t  uAlignmentOffset;      /**< Topology: offset of first aligned logical block. */
+    uint16_t cMinIoSize;            /**< Topology: suggested minimum I/O size in blocks. */
+    uint32_t cOptIoSize;            /**< Topology: optimal (suggested maximum) I/O size in blocks. */
+    uint8_t  fWriteback;            /**< Writeback mode (VBLK_F_CONFIG_WCE). */
+    uint8_t  abUnused0[3];
+    uint32_t cMaxDiscardSectors;    /**< Maximum sectors per discard segment (VBLK_F_DISCARD). */
+    uint32_t cMaxDiscardSeg;        /**< Maximum discard segments per request (VBLK_F_DISCARD). */
+    uint32_t cDiscardSectorAlign;   /**< Discard sector alignment (VBLK_F_DISCARD). */
+    uint32_t cMaxWriteZeroesSectors;/**< Maximum sectors per write zeroes segment (VBLK_F_WRITE_ZEROES). */
+    uint32_t cMaxWriteZeroesSeg;    /**< Maximum write zeroes segments per request (VBLK_F_WRITE_ZEROES). */
+    uint8_t  fWriteZeroesMayUnmap;  /**< Whether write zeroes may deallocate (VBLK_F_WRITE_ZEROES). */
+    uint8_t  abUnused1[3];
+};
+#pragma pack()
+AssertCompileMemberOffset(struct VBlkPCIConfig, cbBlk, 20);
+AssertCompileMemberOffset(struct VBlkPCIConfig, cMaxDiscardSectors, 36);
+AssertCompileSize(struct VBlkPCIConfig, 60);
+
+/**
+ * The request header at the start of every request chain.
+ */
+typedef struct VBlkReqHdr
+{
+    uint32_t u32Type;
+    uint32_t u32IoPrio;
+    uint64_t u64Sector;
+} VBLKREQHDR;
+AssertCompileSize(VBLKREQHDR, 16);
+
+/**
+ * A discard / write zeroes segment.
+ */
+typedef struct VBlkDwzSeg
+{
+    uint64_t u64Sector;
+    uint32_t cSectors;
+    uint32_t fFlags;
+} VBLKDWZSEG;
+AssertCompileSize(VBLKDWZSEG, 16);
+
+/**
+ * A guest memory data segment of a request.
+ */
+typedef struct VBlkSeg
+{
+    /** Guest physical address of the segment. */
+    RTGCPHYS    GCPhys;
+    /** Size of the segment. */
+    uint32_t    cb;
+    /** Set if the segment is device writable. */
+    bool        fWrite;
+} VBLKSEG;
+
+/**
+ * Virtio block request, the I/O request allocator specific memory.
+ *
+ * Only the data segments are kept here, the descriptor chain itself stays
+ * in guest memory until the request is completed.
+ */
+typedef struct VBlkReq
+{
+    /** The I/O request handle. */
+    PDMMEDIAEXIOREQ     hIoReq;
+    /** Head descriptor index of the chain this request came from. */
+    uint16_t            uHeadIdx;
+    /** Reset generation the request was submitted in. */
+    uint16_t            uGen;
+    /** The request type (VBLK_T_XXX). */
+    uint32_t            u32Type;
+    /** Start offset in bytes. */
+    uint64_t            offStart;
+    /** Size of the transfer in bytes. */
+    size_t              cbXfer;
+    /** Guest physical address of the status byte. */
+    RTGCPHYS            GCPhysStatus;
+    /** Total number of bytes in the data segments. */
+    uint32_t            cbData;
+    /** Number of valid data segments. */
+    uint32_t            cSegs;
+    /** The data segments. */
+    VBLKSEG             aSegs[VBLK_SEG_MAX + 2];
+} VBLKREQ;
+/** Pointer to a virtio block request. */
+typedef VBLKREQ *PVBLKREQ;
+
+/**
+ * Device state structure. Holds the current state of device.
+ *
+ * @extends     VPCISTATE
+ * @implements  PDMIMEDIAPORT
+ * @implements  PDMIMEDIAEXPORT
+ */
+typedef struct VBlkState_st
+{
+    /* VPCISTATE must be the first member! */
+    VPCISTATE               VPCI;
+
+    /** LUN#0: Media port interface. */
+    PDMIMEDIAPORT           IMediaPort;
+    /** LUN#0: Extended media port interface. */
+    PDMIMEDIAEXPORT         IMediaExPort;
+    /** LUN#0: Attached driver base interface. */
+    R3PTRTYPE(PPDMIBASE)    pDrvBase;
+    /** LUN#0: Attached media interface. */
+    R3PTRTYPE(PPDMIMEDIA)   pDrvMedia;
+    /** LUN#0: Attached extended media interface. */
+    R3PTRTYPE(PPDMIMEDIAEX) pDrvMediaEx;
+
+    /** The request queue. */
+    R3PTRTYPE(PVQUEUE)      pReqQueue;
+    /** Head indexes of suspended requests restored from a saved state,
+     * resubmitted on resume. */
+    R3PTRTYPE(uint16_t *)   pau16HeadsRestored;
+    /** Number of entries in pau16HeadsRestored. */
+    uint32_t                cHeadsRestored;
+
+    /** PCI config area holding the disk geometry and limits. */
+    struct VBlkPCIConfig    config;
+    /** Features offered to the guest, fixed after construction. */
+    uint32_t                fHostFeatures;
+    /** Size of the medium in bytes. */
+    uint64_t                cbMedium;
+    /** The serial number returned for VBLK_T_GET_ID. */
+    char                    szSerial[VBLK_ID_BYTES + 1];
+    /** Set if the medium is read-only. */
+    bool                    fReadOnly;
+    /** Set while the request queue is processed on EMT, completions
+     * only add used elements and leave the guest notification to the end
+     * of the queue run then. */
+    bool                    fProcessingQueue;
+    /** Indicates that PDMDevHlpAsyncNotificationCompleted should be called
+     * when the last active request completes. */
+    bool volatile           fSignalIdle;
+    /** Number of active requests. */
+    uint32_t volatile       cReqsActive;
+    /** Reset generation, completions of requests from older generations
+     * are dropped. */
+    uint16_t                uGen;
+    /** Number of used elements not yet published to the guest. */
+    uint16_t                cUsedPending;
+
+    /** @name Statistic
+     * @{ */
+    STAMCOUNTER             StatBytesRead;
+    STAMCOUNTER             StatBytesWritten;
+    STAMCOUNTER             StatKicks;
+    STAMCOUNTER             StatReqs;
+    STAMCOUNTER             StatReqsFlush;
+    STAMCOUNTER             StatReqsDiscard;
+    STAMCOUNTER             StatReqsWriteZeroes;
+    STAMCOUNTER             StatReqsFailed;
+    STAMCOUNTER             StatCompletionsBatched;
+#if defined(VBOX_WITH_STATISTICS)
+    STAMPROFILE             StatKick;
+#endif /* VBOX_WITH_STATISTICS */
+    /** @}  */
+} VBLKSTATE;
+/** Pointer to a virtual I/O block device state. */
+typedef VBLKSTATE *PVBLKSTATE;
+
+#ifndef VBOX_DEVICE_STRUCT_TESTCASE
+
+AssertCompileMemberOffset(VBLKSTATE, VPCI, 0);
+
+static DECLCALLBACK(uint32_t) vblkIoCb_GetHostFeatures(void *pvState)
+{
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+    return pThis->fHostFeatures;
+}
+
+static DECLCALLBACK(uint32_t) vblkIoCb_GetHostMinimalFeatures(void *pvState)
+{
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+    return pThis->fHostFeatures & VBLK_F_RO;
+}
+
+static DECLCALLBACK(void) vblkIoCb_SetHostFeatures(void *pvState, uint32_t fFeatures)
+{
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+    LogFlow(("%s vblkIoCb_SetHostFeatures: uFeatures=%x\n", INSTANCE(pThis), fFeatures));
+    RT_NOREF2(pThis, fFeatures);
+}
+
+static DECLCALLBACK(int) vblkIoCb_GetConfig(void *pvState, uint32_t offCfg, uint32_t cb, void *data)
+{
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+    if (offCfg + cb > sizeof(struct VBlkPCIConfig))
+    {
+        Log(("%s vblkIoCb_GetConfig: Read beyond the config structure is attempted (offCfg=%#x cb=%x).\n", INSTANCE(pThis), offCfg, cb));
+        return VERR_IOM_IOPORT_UNUSED;
+    }
+    memcpy(data, (uint8_t *)&pThis->config + offCfg, cb);
+    return VINF_SUCCESS;
+}
+
+static DECLCALLBACK(int) vblkIoCb_SetConfig(void *pvState, uint32_t offCfg, uint32_t cb, void *data)
+{
+    /* The configuration space is read-only for the guest as we don't offer VBLK_F_CONFIG_WCE. */
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+    Log(("%s vblkIoCb_SetConfig: Ignoring write to the config structure (offCfg=%#x cb=%x).\n", INSTANCE(pThis), offCfg, cb));
+    RT_NOREF4(pThis, offCfg, cb, data);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Hardware reset. Revert all registers to initial values.
+ *
+ * Requests still in flight belong to the previous generation and their
+ * completions will not touch the (re-initialized) queue.
+ *
+ * @param   pThis      The device state structure.
+ */
+static DECLCALLBACK(int) vblkIoCb_Reset(void *pvState)
+{
+#ifndef IN_RING3
+    RT_NOREF(pvState);
+    return VINF_IOM_R3_IOPORT_WRITE;
+#else
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+    Log(("%s Reset triggered\n", INSTANCE(pThis)));
+
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    if (RT_UNLIKELY(rc != VINF_SUCCESS))
+    {
+        LogRel(("vblkIoCb_Reset failed to enter critical section!\n"));
+        return rc;
+    }
+    pThis->uGen++;
+    pThis->cUsedPending = 0;
+    vpciReset(&pThis->VPCI);
+    vpciCsLeave(&pThis->VPCI);
+
+    if (pThis->cReqsActive && pThis->pDrvMediaEx)
+        pThis->pDrvMediaEx->pfnIoReqCancelAll(pThis->pDrvMediaEx);
+    return VINF_SUCCESS;
+#endif
+}
+
+/**
+ * This function is called when the driver becomes ready.
+ *
+ * @param   pThis      The device state structure.
+ */
+static DECLCALLBACK(void) vblkIoCb_Ready(void *pvState)
+{
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+    Log(("%s Driver became ready\n", INSTANCE(pThis)));
+    RT_NOREF(pThis);
+}
+
+
+/**
+ * I/O port callbacks.
+ */
+static const VPCIIOCALLBACKS g_IOCallbacks =
+{
+     vblkIoCb_GetHostFeatures,
+     vblkIoCb_GetHostMinimalFeatures,
+     vblkIoCb_SetHostFeatures,
+     vblkIoCb_GetConfig,
+     vblkIoCb_SetConfig,
+     vblkIoCb_Reset,
+     vblkIoCb_Ready,
+};
+
+
+/**
+ * @callback_method_impl{FNIOMIOPORTIN}
+ */
+PDMBOTHCBDECL(int) vblkIOPortIn(PPDMDEVINS pDevIns, void *pvUser, RTIOPORT port, uint32_t *pu32, unsigned cb)
+{
+    return vpciIOPortIn(pDevIns, pvUser, port, pu32, cb, &g_IOCallbacks);
+}
+
+
+/**
+ * @callback_method_impl{FNIOMIOPORTOUT}
+ */
+PDMBOTHCBDECL(int) vblkIOPortOut(PPDMDEVINS pDevIns, void *pvUser, RTIOPORT port, uint32_t u32, unsigned cb)
+{
+    return vpciIOPortOut(pDevIns, pvUser, port, u32, cb, &g_IOCallbacks);
+}
+
+
+#ifdef IN_RING3
+
+/**
+ * Reads from the data segments of the given request.
+ *
+ * @returns Number of bytes read.
+ * @param   pThis       The device state structure.
+ * @param   pReq        The request.
+ * @param   offSrc      Offset into the request data to start reading at.
+ * @param   pvBuf       Where to store the data.
+ * @param   cbRead      How much to read.
+ */
+static size_t vblkR3ReqReadData(PVBLKSTATE pThis, PVBLKREQ pReq, size_t offSrc, void *pvBuf, size_t cbRead)
+{
+    uint8_t *pbBuf  = (uint8_t *)pvBuf;
+    size_t   cbDone = 0;
+
+    for (uint32_t i = 0; i < pReq->cSegs && cbDone < cbRead; i++)
+    {
+        if (offSrc >= pReq->aSegs[i].cb)
+        {
+            offSrc -= pReq->aSegs[i].cb;
+            continue;
+        }
+
+        size_t cbThis = RT_MIN(pReq->aSegs[i].cb - offSrc, cbRead - cbDone);
+        PDMDevHlpPhysRead(pThis->VPCI.CTX_SUFF(pDevIns), pReq->aSegs[i].GCPhys + offSrc, pbBuf + cbDone, cbThis);
+        cbDone += cbThis;
+        offSrc  = 0;
+    }
+
+    return cbDone;
+}
+
+/**
+ * Copies between the data segments of the given request and a host S/G buffer.
+ *
+ * @returns Number of bytes copied.
+ * @param   pThis       The device state structure.
+ * @param   pReq        The request.
+ * @param   pSgBuf      The host S/G buffer.
+ * @param   offData     Offset into the request data.
+ * @param   cbCopy      How much to copy.
+ * @param   fToGuest    Direction, true if copying into guest memory.
+ */
+static size_t vblkR3ReqCopySgBuf(PVBLKSTATE pThis, PVBLKREQ pReq, PRTSGBUF pSgBuf, size_t offData,
+                                 size_t cbCopy, bool fToGuest)
+{
+    PPDMDEVINS pDevIns = pThis->VPCI.CTX_SUFF(pDevIns);
+    size_t     cbDone  = 0;
+
+    for (uint32_t i = 0; i < pReq->cSegs && cbDone < cbCopy; i++)
+    {
+        if (offData >= pReq->aSegs[i].cb)
+        {
+            offData -= pReq->aSegs[i].cb;
+            continue;
+        }
+
+        RTGCPHYS GCPhys = pReq->aSegs[i].GCPhys + offData;
+        size_t   cbLeft = RT_MIN(pReq->aSegs[i].cb - offData, cbCopy - cbDone);
+        offData = 0;
+        while (cbLeft)
+        {
+            size_t cbSeg = cbLeft;
+            void *pvSeg = RTSgBufGetNextSegment(pSgBuf, &cbSeg);
+            if (!pvSeg)
+                return cbDone;
+
+            if (fToGuest)
+                PDMDevHlpPCIPhysWrite(pDevIns, GCPhys, pvSeg, cbSeg);
+            else
+                PDMDevHlpPhysRead(pDevIns, GCPhys, pvSeg, cbSeg);
+            GCPhys += cbSeg;
+            cbLeft -= cbSeg;
+            cbDone += cbSeg;
+        }
+    }
+
+    return cbDone;
+}
+
+/**
+ * Publishes the completion of a descriptor chain to the guest.
+ *
+ * Called from EMT while processing the queue or from an I/O thread when an
+ * asynchronous request completes.  Completions arriving while EMT processes
+ * the queue are only added to the used ring, the guest gets a single
+ * notification at the end of the queue run.
+ *
+ * @param   pThis           The device state structure.
+ * @param   uHeadIdx        Head descriptor index of the chain.
+ * @param   uGen            Reset generation the chain was fetched in.
+ * @param   GCPhysStatus    Where to write the status byte, NIL_RTGCPHYS if
+ *                          no status can be returned.
+ * @param   u8Status        The status (VBLK_S_XXX).
+ * @param   cbUsed          Number of bytes written into the chain.
+ */
+static void vblkR3ChainComplete(PVBLKSTATE pThis, uint16_t uHeadIdx, uint16_t uGen, RTGCPHYS GCPhysStatus,
+                                uint8_t u8Status, uint32_t cbUsed)
+{
+    if (u8Status != VBLK_S_OK)
+        STAM_REL_COUNTER_INC(&pThis->StatReqsFailed);
+
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    AssertRCReturnVoid(rc);
+
+    PVQUEUE pQueue = pThis->pReqQueue;
+    if (   uGen == pThis->uGen
+        && vqueueIsReady(&pThis->VPCI, pQueue))
+    {
+        if (GCPhysStatus != NIL_RTGCPHYS)
+            PDMDevHlpPCIPhysWrite(pThis->VPCI.CTX_SUFF(pDevIns), GCPhysStatus, &u8Status, sizeof(u8Status));
+        vringWriteUsedElem(&pThis->VPCI, &pQueue->VRing, pQueue->uNextUsedIndex++, uHeadIdx, cbUsed);
+        if (pThis->fProcessingQueue)
+        {
+            pThis->cUsedPending++;
+            STAM_REL_COUNTER_INC(&pThis->StatCompletionsBatched);
+        }
+        else
+            vqueueSync(&pThis->VPCI, pQueue);
+    }
+    else
+        Log(("%s vblkR3ChainComplete: Dropping completion of stale chain %u\n", INSTANCE(pThis), uHeadIdx));
+
+    vpciCsLeave(&pThis->VPCI);
+}
+
+/**
+ * Completes a request, frees it and notifies the guest.
+ *
+ * @param   pThis       The device state structure.
+ * @param   pReq        The request to complete.
+ * @param   rcReq       The status code the request completed with.
+ */
+static void vblkR3ReqComplete(PVBLKSTATE pThis, PVBLKREQ pReq, int rcReq)
+{
+    uint8_t  u8Status;
+    uint32_t cbUsed = 1; /* the status byte */
+
+    if (RT_SUCCESS(rcReq))
+    {
+        u8Status = VBLK_S_OK;
+        if (pReq->u32Type == VBLK_T_IN)
+        {
+            cbUsed += pReq->cbData;
+            STAM_REL_COUNTER_ADD(&pThis->StatBytesRead, pReq->cbXfer);
+        }
+        else if (pReq->u32Type == VBLK_T_OUT)
+            STAM_REL_COUNTER_ADD(&pThis->StatBytesWritten, pReq->cbXfer);
+        else if (pReq->u32Type == VBLK_T_GET_ID)
+            cbUsed += (uint32_t)pReq->cbXfer;
+    }
+    else
+    {
+        u8Status = rcReq == VERR_NOT_SUPPORTED ? VBLK_S_UNSUPP : VBLK_S_IOERR;
+        LogRel(("%s: Request type %u at offset %llu (%zu bytes) failed with %Rrc\n",
+                INSTANCE(pThis), pReq->u32Type, pReq->offStart, pReq->cbXfer, rcReq));
+    }
+
+    if (pReq->u32Type == VBLK_T_IN)
+        vpciSetReadLed(&pThis->VPCI, false);
+    else if (pReq->u32Type != VBLK_T_GET_ID)
+        vpciSetWriteLed(&pThis->VPCI, false);
+
+    uint16_t const uHeadIdx     = pReq->uHeadIdx;
+    uint16_t const uGen         = pReq->uGen;
+    RTGCPHYS const GCPhysStatus = pReq->GCPhysStatus;
+    pThis->pDrvMediaEx->pfnIoReqFree(pThis->pDrvMediaEx, pReq->hIoReq);
+
+    vblkR3ChainComplete(pThis, uHeadIdx, uGen, GCPhysStatus, u8Status, cbUsed);
+
+    uint32_t cReqsActive = ASMAtomicDecU32(&pThis->cReqsActive);
+    if (!cReqsActive && pThis->fSignalIdle)
+        PDMDevHlpAsyncNotificationCompleted(pThis->VPCI.pDevInsR3);
+}
+
+/**
+ * Walks the descriptor chain starting at the given head and collects the
+ * request header, the data segments and the status location.
+ *
+ * The header must be located at the start of the first descriptor and the
+ * status byte at the end of the last one, data may share the descriptors with
+ * either of them.
+ *
+ * @returns true if the chain is well formed, false otherwise.
+ * @param   pThis       The device state structure.
+ * @param   uHeadIdx    Head descriptor index of the chain.
+ * @param   pReq        Where to store the parsed request.
+ */
+static bool vblkR3ReqParse(PVBLKSTATE pThis, uint16_t uHeadIdx, PVBLKREQ pReq)
+{
+    PVQUEUE    pQueue  = pThis->pReqQueue;
+    VBLKREQHDR Hdr;
+    VRINGDESC  Desc;
+    RTGCPHYS   GCPhysLast = NIL_RTGCPHYS;
+    uint32_t   cbLast     = 0;
+    bool       fLastWrite = false;
+    bool       fValid     = true;
+    uint32_t   cDescs     = 0;
+    uint32_t   idx        = uHeadIdx;
+
+    RT_ZERO(Hdr);
+    pReq->uHeadIdx     = uHeadIdx;
+    pReq->GCPhysStatus = NIL_RTGCPHYS;
+    pReq->cSegs        = 0;
+    pReq->cbData       = 0;
+    pReq->cbXfer       = 0;
+    pReq->offStart     = 0;
+
+    do
+    {
+        /* Guard against descriptor loops, see vqueueGet. */
+        if (cDescs++ >= pQueue->VRing.uSize)
+        {
+            Log(("%s vblkR3ReqParse: Descriptor chain at %u loops\n", INSTANCE(pThis), uHeadIdx));
+            return false;
+        }
+        RT_UNTRUSTED_VALIDATED_FENCE();
+
+        vringReadDesc(&pThis->VPCI, &pQueue->VRing, idx, &Desc);
+
+        RTGCPHYS GCPhys = Desc.u64Addr;
+        uint32_t cb     = Desc.uLen;
+        bool     fWrite = RT_BOOL(Desc.u16Flags & VRINGDESC_F_WRITE);
+        if (cDescs == 1)
+        {
+            if (fWrite || cb < sizeof(Hdr))
+                fValid = false;
+            else
+            {
+                PDMDevHlpPhysRead(pThis->VPCI.CTX_SUFF(pDevIns), GCPhys, &Hdr, sizeof(Hdr));
+                GCPhys += sizeof(Hdr);
+                cb     -= sizeof(Hdr);
+            }
+        }
+
+        if (cb)
+        {
+            if (pReq->cSegs < RT_ELEMENTS(pReq->aSegs))
+            {
+                pReq->aSegs[pReq->cSegs].GCPhys = GCPhys;
+                pReq->aSegs[pReq->cSegs].cb     = cb;
+                pReq->aSegs[pReq->cSegs].fWrite = fWrite;
+                pReq->cSegs++;
+            }
+            else
+                fValid = false;
+        }
+
+        GCPhysLast = Desc.u64Addr;
+        cbLast     = Desc.uLen;
+        fLastWrite = fWrite;
+        idx        = Desc.u16Next;
+    } while (Desc.u16Flags & VRINGDESC_F_NEXT);
+
+    /* The status byte is the last byte of the chain. */
+    if (!fLastWrite || !cbLast || cDescs < 2)
+        return false;
+    pReq->GCPhysStatus = GCPhysLast + cbLast - 1;
+    if (pReq->cSegs && pReq->aSegs[pReq->cSegs - 1].GCPhys + pReq->aSegs[pReq->cSegs - 1].cb == pReq->GCPhysStatus + 1)
+    {
+        if (!--pReq->aSegs[pReq->cSegs - 1].cb)
+            pReq->cSegs--;
+    }
+    if (!fValid)
+        return false;
+
+    /* Check that the data moves in the direction the request type needs. */
+    pReq->u32Type = Hdr.u32Type;
+    bool const fDataIn = Hdr.u32Type == VBLK_T_IN || Hdr.u32Type == VBLK_T_GET_ID;
+    for (uint32_t i = 0; i < pReq->cSegs; i++)
+    {
+        if (pReq->aSegs[i].fWrite != fDataIn)
+            return false;
+        pReq->cbData += pReq->aSegs[i].cb;
+    }
+
+    /* A sector beyond the end of the medium would overflow the multiplication
+       and could wrap around to a valid offset, make it fail the range checks. */
+    if (Hdr.u64Sector <= pThis->cbMedium / VBLK_SECTOR_SIZE)
+        pReq->offStart = Hdr.u64Sector * VBLK_SECTOR_SIZE;
+    else
+        pReq->offStart = UINT64_MAX;
+    return true;
+}
+
+/**
+ * Checks whether the given byte range lies within the medium.
+ */
+DECLINLINE(bool) vblkR3IsRangeValid(PVBLKSTATE pThis, uint64_t offStart, uint64_t cb)
+{
+    return    offStart <= pThis->cbMedium
+           && cb <= pThis->cbMedium - offStart;
+}
+
+/**
+ * Fetches the descriptor chain with the given head, parses it and submits
+ * the resulting request to the driver below.
+ *
+ * @param   pThis       The device state structure.
+ * @param   uHeadIdx    Head descriptor index of the chain.
+ */
+static void vblkR3ChainSubmit(PVBLKSTATE pThis, uint16_t uHeadIdx)
+{
+    STAM_REL_COUNTER_INC(&pThis->StatReqs);
+
+    PDMMEDIAEXIOREQ hIoReq = NULL;
+    PVBLKREQ        pReq   = NULL;
+    int             rc     = VERR_PDM_NO_ATTACHED_DRIVER;
+    if (pThis->pDrvMediaEx)
+        rc = pThis->pDrvMediaEx->pfnIoReqAlloc(pThis->pDrvMediaEx, &hIoReq, (void **)&pReq,
+                                               ((PDMMEDIAEXIOREQID)pThis->uGen << 16) | uHeadIdx,
+                                               PDMIMEDIAEX_F_SUSPEND_ON_RECOVERABLE_ERR);
+    if (RT_FAILURE(rc))
+    {
+        /* Nothing to do the I/O with, parse into a temporary to find out where to put the status. */
+        PVBLKREQ pReqTmp = (PVBLKREQ)RTMemTmpAlloc(sizeof(*pReqTmp));
+        if (pReqTmp)
+        {
+            vblkR3ReqParse(pThis, uHeadIdx, pReqTmp);
+            vblkR3ChainComplete(pThis, uHeadIdx, pThis->uGen, pReqTmp->GCPhysStatus, VBLK_S_IOERR, 1);
+            RTMemTmpFree(pReqTmp);
+        }
+        else
+            vblkR3ChainComplete(pThis, uHeadIdx, pThis->uGen, NIL_RTGCPHYS, VBLK_S_IOERR, 0);
+        return;
+    }
+
+    ASMAtomicIncU32(&pThis->cReqsActive);
+    pReq->hIoReq = hIoReq;
+    pReq->uGen   = pThis->uGen;
+
+    if (!vblkR3ReqParse(pThis, uHeadIdx, pReq))
+    {
+        Log(("%s vblkR3ChainSubmit: Malformed request at %u\n", INSTANCE(pThis), uHeadIdx));
+        pReq->u32Type = VBLK_T_GET_ID; /* Keep the LEDs alone. */
+        vblkR3ReqComplete(pThis, pReq, VERR_INVALID_PARAMETER);
+        return;
+    }
+
+    switch (pReq->u32Type)
+    {
+        case VBLK_T_IN:
+            pReq->cbXfer = pReq->cbData;
+            vpciSetReadLed(&pThis->VPCI, true);
+            if (   (pReq->cbXfer % VBLK_SECTOR_SIZE)
+                || !vblkR3IsRangeValid(pThis, pReq->offStart, pReq->cbXfer))
+                rc = VERR_OUT_OF_RANGE;
+            else
+                rc = pThis->pDrvMediaEx->pfnIoReqRead(pThis->pDrvMediaEx, hIoReq, pReq->offStart, pReq->cbXfer);
+            break;
+
+        case VBLK_T_OUT:
+            pReq->cbXfer = pReq->cbData;
+            vpciSetWriteLed(&pThis->VPCI, true);
+            if (pThis->fReadOnly)
+                rc = VERR_WRITE_PROTECT;
+            else if (   (pReq->cbXfer % VBLK_SECTOR_SIZE)
+                     || !vblkR3IsRangeValid(pThis, pReq->offStart, pReq->cbXfer))
+                rc = VERR_OUT_OF_RANGE;
+            else
+                rc = pThis->pDrvMediaEx->pfnIoReqWrite(pThis->pDrvMediaEx, hIoReq, pReq->offStart, pReq->cbXfer);
+            break;
+
+        case VBLK_T_FLUSH:
+            STAM_REL_COUNTER_INC(&pThis->StatReqsFlush);
+            vpciSetWriteLed(&pThis->VPCI, true);
+            rc = pThis->pDrvMediaEx->pfnIoReqFlush(pThis->pDrvMediaEx, hIoReq);
+            break;
+
+        case VBLK_T_DISCARD:
+        {
+            STAM_REL_COUNTER_INC(&pThis->StatReqsDiscard);
+            vpciSetWriteLed(&pThis->VPCI, true);
+            uint32_t cRanges = pReq->cbData / sizeof(VBLKDWZSEG);
+            if (pThis->fReadOnly)
+                rc = VERR_WRITE_PROTECT;
+            else if (!(pThis->fHostFeatures & VBLK_F_DISCARD))
+                rc = VERR_NOT_SUPPORTED;
+            else if (   !cRanges
+                     || cRanges > VBLK_MAX_DISCARD_SEG
+                     || pReq->cbData % sizeof(VBLKDWZSEG))
+                rc = VERR_INVALID_PARAMETER;
+            else
+                rc = pThis->pDrvMediaEx->pfnIoReqDiscard(pThis->pDrvMediaEx, hIoReq, cRanges);
+            break;
+        }
+
+        case VBLK_T_WRITE_ZEROES:
+        {
+            /* Done as an ordinary write with the buffer filled in vblkR3IoReqCopyToBuf. */
+            STAM_REL_COUNTER_INC(&pThis->StatReqsWriteZeroes);
+            vpciSetWriteLed(&pThis->VPCI, true);
+            VBLKDWZSEG Seg;
+            if (pThis->fReadOnly)
+                rc = VERR_WRITE_PROTECT;
+            else if (   pReq->cbData != sizeof(Seg)
+                     || vblkR3ReqReadData(pThis, pReq, 0, &Seg, sizeof(Seg)) != sizeof(Seg)
+                     || !Seg.cSectors
+                     || Seg.cSectors > VBLK_MAX_WRITE_ZEROES_SECTORS
+                     || Seg.u64Sector > pThis->cbMedium / VBLK_SECTOR_SIZE)
+                rc = VERR_INVALID_PARAMETER;
+            else
+            {
+                pReq->offStart = Seg.u64Sector * VBLK_SECTOR_SIZE;
+                pReq->cbXfer   = (size_t)Seg.cSectors * VBLK_SECTOR_SIZE;
+                if (!vblkR3IsRangeValid(pThis, pReq->offStart, pReq->cbXfer))
+                    rc = VERR_OUT_OF_RANGE;
+                else
+                    rc = pThis->pDrvMediaEx->pfnIoReqWrite(pThis->pDrvMediaEx, hIoReq, pReq->offStart, pReq->cbXfer);
+            }
+            break;
+        }
+
+        case VBLK_T_GET_ID:
+        {
+            /* The string is not zero terminated if it occupies the whole buffer. */
+            char szId[VBLK_ID_BYTES];
+            RT_ZERO(szId);
+            memcpy(szId, pThis->szSerial, RT_MIN(strlen(pThis->szSerial), sizeof(szId)));
+
+            size_t cbId = RT_MIN(sizeof(szId), pReq->cbData);
+            RTSGSEG Seg;
+            RTSGBUF SgBuf;
+            Seg.pvSeg = szId;
+            Seg.cbSeg = cbId;
+            RTSgBufInit(&SgBuf, &Seg, 1);
+            vblkR3ReqCopySgBuf(pThis, pReq, &SgBuf, 0, cbId, true /*fToGuest*/);
+            pReq->cbXfer = cbId;
+            rc = VINF_SUCCESS;
+            break;
+        }
+
+        default:
+            Log(("%s vblkR3ChainSubmit: Unsupported request type %u\n", INSTANCE(pThis), pReq->u32Type));
+            rc = VERR_NOT_SUPPORTED;
+            break;
+    }
+
+    if (rc != VINF_PDM_MEDIAEX_IOREQ_IN_PROGRESS)
+        vblkR3ReqComplete(pThis, pReq, rc);
+}
+
+/**
+ * @callback_method_impl{FNVPCIQUEUECALLBACK,
+ *      Processes all requests the guest made available.}
+ *
+ * Notifications are disabled while the queue is drained so the guest can keep
+ * adding requests without kicking us again, requests completing synchronously
+ * are published with a single guest notification at the end.
+ */
+static DECLCALLBACK(void) vblkR3QueueNotify(void *pvState, PVQUEUE pQueue)
+{
+    PVBLKSTATE pThis = (PVBLKSTATE)pvState;
+
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    if (RT_UNLIKELY(rc != VINF_SUCCESS))
+        return;
+
+    STAM_REL_COUNTER_INC(&pThis->StatKicks);
+    STAM_PROFILE_START(&pThis->StatKick, a);
+    pThis->fProcessingQueue = true;
+
+    vringSetNotification(&pThis->VPCI, &pQueue->VRing, false);
+    for (;;)
+    {
+        while (!vqueueIsEmpty(&pThis->VPCI, pQueue))
+        {
+            uint16_t uHeadIdx = vringReadAvail(&pThis->VPCI, &pQueue->VRing, pQueue->uNextAvailIndex++);
+            vblkR3ChainSubmit(pThis, uHeadIdx);
+        }
+
+        /* Re-enable notifications and check again to close the race with the guest. */
+        vringSetNotification(&pThis->VPCI, &pQueue->VRing, true);
+        if (vqueueIsEmpty(&pThis->VPCI, pQueue))
+            break;
+        vringSetNotification(&pThis->VPCI, &pQueue->VRing, false);
+    }
+
+    pThis->fProcessingQueue = false;
+    if (pThis->cUsedPending)
+    {
+        pThis->cUsedPending = 0;
+        vqueueSync(&pThis->VPCI, pQueue);
+    }
+
+    STAM_PROFILE_STOP(&pThis->StatKick, a);
+    vpciCsLeave(&pThis->VPCI);
+}
+
+
+/* -=-=-=-=- PDMIMEDIAPORT / PDMIMEDIAEXPORT -=-=-=-=- */
+
+/**
+ * @interface_method_impl{PDMIMEDIAPORT,pfnQueryDeviceLocation}
+ */
+static DECLCALLBACK(int) vblkR3QueryDeviceLocation(PPDMIMEDIAPORT pInterface, const char **ppcszController,
+                                                   uint32_t *piInstance, uint32_t *piLUN)
+{
+    PVBLKSTATE pThis   = RT_FROM_MEMBER(pInterface, VBLKSTATE, IMediaPort);
+    PPDMDEVINS pDevIns = pThis->VPCI.pDevInsR3;
+
+    AssertPtrReturn(ppcszController, VERR_INVALID_POINTER);
+    AssertPtrReturn(piInstance, VERR_INVALID_POINTER);
+    AssertPtrReturn(piLUN, VERR_INVALID_POINTER);
+
+    *ppcszController = pDevIns->pReg->szName;
+    *piInstance = pDevIns->iInstance;
+    *piLUN = 0;
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCopyFromBuf}
+ */
+static DECLCALLBACK(int) vblkR3IoReqCopyFromBuf(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                void *pvIoReqAlloc, uint32_t offDst, PRTSGBUF pSgBuf,
+                                                size_t cbCopy)
+{
+    RT_NOREF1(hIoReq);
+    PVBLKSTATE pThis = RT_FROM_MEMBER(pInterface, VBLKSTATE, IMediaExPort);
+    PVBLKREQ   pReq  = (PVBLKREQ)pvIoReqAlloc;
+
+    size_t cbCopied = vblkR3ReqCopySgBuf(pThis, pReq, pSgBuf, offDst, cbCopy, true /*fToGuest*/);
+    return cbCopied == cbCopy ? VINF_SUCCESS : VERR_PDM_MEDIAEX_IOBUF_OVERFLOW;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCopyToBuf}
+ */
+static DECLCALLBACK(int) vblkR3IoReqCopyToBuf(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                              void *pvIoReqAlloc, uint32_t offSrc, PRTSGBUF pSgBuf,
+                                              size_t cbCopy)
+{
+    RT_NOREF1(hIoReq);
+    PVBLKSTATE pThis = RT_FROM_MEMBER(pInterface, VBLKSTATE, IMediaExPort);
+    PVBLKREQ   pReq  = (PVBLKREQ)pvIoReqAlloc;
+
+    size_t cbCopied;
+    if (pReq->u32Type == VBLK_T_WRITE_ZEROES)
+        cbCopied = RTSgBufSet(pSgBuf, 0, cbCopy);
+    else
+        cbCopied = vblkR3ReqCopySgBuf(pThis, pReq, pSgBuf, offSrc, cbCopy, false /*fToGuest*/);
+    return cbCopied == cbCopy ? VINF_SUCCESS : VERR_PDM_MEDIAEX_IOBUF_UNDERRUN;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqQueryDiscardRanges}
+ */
+static DECLCALLBACK(int) vblkR3IoReqQueryDiscardRanges(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                       void *pvIoReqAlloc, uint32_t idxRangeStart,
+                                                       uint32_t cRanges, PRTRANGE paRanges,
+                                                       uint32_t *pcRanges)
+{
+    RT_NOREF1(hIoReq);
+    PVBLKSTATE pThis = RT_FROM_MEMBER(pInterface, VBLKSTATE, IMediaExPort);
+    PVBLKREQ   pReq  = (PVBLKREQ)pvIoReqAlloc;
+
+    uint32_t const cRangesReq = pReq->cbData / sizeof(VBLKDWZSEG);
+    uint32_t       idxRange   = 0;
+    while (   idxRange < cRanges
+           && idxRangeStart + idxRange < cRangesReq)
+    {
+        VBLKDWZSEG Seg;
+        vblkR3ReqReadData(pThis, pReq, (idxRangeStart + idxRange) * sizeof(Seg), &Seg, sizeof(Seg));
+        if (   Seg.cSectors > VBLK_MAX_DISCARD_SECTORS
+            || Seg.u64Sector > pThis->cbMedium / VBLK_SECTOR_SIZE
+            || !vblkR3IsRangeValid(pThis, Seg.u64Sector * VBLK_SECTOR_SIZE, (uint64_t)Seg.cSectors * VBLK_SECTOR_SIZE))
+            return VERR_OUT_OF_RANGE;
+
+        paRanges[idxRange].offStart = Seg.u64Sector * VBLK_SECTOR_SIZE;
+        paRanges[idxRange].cbRange  = (size_t)Seg.cSectors * VBLK_SECTOR_SIZE;
+        idxRange++;
+    }
+
+    *pcRanges = idxRange;
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCompleteNotify}
+ */
+static DECLCALLBACK(int) vblkR3IoReqCompleteNotify(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                   void *pvIoReqAlloc, int rcReq)
+{
+    RT_NOREF(hIoReq);
+    PVBLKSTATE pThis = RT_FROM_MEMBER(pInterface, VBLKSTATE, IMediaExPort);
+    vblkR3ReqComplete(pThis, (PVBLKREQ)pvIoReqAlloc, rcReq);
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqStateChanged}
+ */
+static DECLCALLBACK(void) vblkR3IoReqStateChanged(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                  void *pvIoReqAlloc, PDMMEDIAEXIOREQSTATE enmState)
+{
+    RT_NOREF2(hIoReq, pvIoReqAlloc);
+    PVBLKSTATE pThis = RT_FROM_MEMBER(pInterface, VBLKSTATE, IMediaExPort);
+
+    switch (enmState)
+    {
+        case PDMMEDIAEXIOREQSTATE_SUSPENDED:
+        {
+            /* Make sure the request is not accounted for so the VM can suspend successfully. */
+            uint32_t cReqsActive = ASMAtomicDecU32(&pThis->cReqsActive);
+            if (!cReqsActive && pThis->fSignalIdle)
+                PDMDevHlpAsyncNotificationCompleted(pThis->VPCI.pDevInsR3);
+            break;
+        }
+        case PDMMEDIAEXIOREQSTATE_ACTIVE:
+            /* Make sure the request is accounted for so the VM suspends only when the request is complete. */
+            ASMAtomicIncU32(&pThis->cReqsActive);
+            break;
+        default:
+            AssertMsgFailed(("Invalid request state given %u\n", enmState));
+    }
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnMediumEjected}
+ */
+static DECLCALLBACK(void) vblkR3MediumEjected(PPDMIMEDIAEXPORT pInterface)
+{
+    RT_NOREF(pInterface);
+}
+
+/**
+ * @interface_method_impl{PDMIBASE,pfnQueryInterface}
+ */
+static DECLCALLBACK(void *) vblkQueryInterface(struct PDMIBASE *pInterface, const char *pszIID)
+{
+    PVBLKSTATE pThis = RT_FROM_MEMBER(pInterface, VBLKSTATE, VPCI.IBase);
+    Assert(&pThis->VPCI.IBase == pInterface);
+
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIMEDIAPORT, &pThis->IMediaPort);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIMEDIAEXPORT, &pThis->IMediaExPort);
+    return vpciQueryInterface(pInterface, pszIID);
+}
+
+
+/* -=-=-=-=- Saved State -=-=-=-=- */
+
+/**
+ * Saves the configuration.
+ *
+ * @param   pThis      The VBLK state.
+ * @param   pSSM        The handle to the saved state.
+ */
+static void vblkSaveConfig(PVBLKSTATE pThis, PSSMHANDLE pSSM)
+{
+    SSMR3PutU64(pSSM, pThis->cbMedium);
+    SSMR3PutU32(pSSM, pThis->fHostFeatures);
+}
+
+
+/**
+ * @callback_method_impl{FNSSMDEVLIVEEXEC}
+ */
+static DECLCALLBACK(int) vblkLiveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint32_t uPass)
+{
+    RT_NOREF(uPass);
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    vblkSaveConfig(pThis, pSSM);
+    return VINF_SSM_DONT_CALL_AGAIN;
+}
+
+
+/**
+ * @callback_method_impl{FNSSMDEVSAVEEXEC}
+ */
+static DECLCALLBACK(int) vblkSaveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
+{
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+
+    /* Save config first */
+    vblkSaveConfig(pThis, pSSM);
+
+    /* Save the common part */
+    int rc = vpciSaveExec(&pThis->VPCI, pSSM);
+    AssertRCReturn(rc, rc);
+
+    /*
+     * Save the heads of the requests suspended because of a recoverable error,
+     * they are resubmitted from the still intact descriptor chains on resume.
+     */
+    uint32_t cReqsSuspended = pThis->pDrvMediaEx ? pThis->pDrvMediaEx->pfnIoReqGetSuspendedCount(pThis->pDrvMediaEx) : 0;
+    rc = SSMR3PutU32(pSSM, cReqsSuspended + pThis->cHeadsRestored);
+    AssertRCReturn(rc, rc);
+    if (cReqsSuspended)
+    {
+        PDMMEDIAEXIOREQ hIoReq;
+        PVBLKREQ        pReq;
+        rc = pThis->pDrvMediaEx->pfnIoReqQuerySuspendedStart(pThis->pDrvMediaEx, &hIoReq, (void **)&pReq);
+        AssertRCReturn(rc, rc);
+        for (;;)
+        {
+            SSMR3PutU16(pSSM, pReq->uHeadIdx);
+            if (!--cReqsSuspended)
+                break;
+            rc = pThis->pDrvMediaEx->pfnIoReqQuerySuspendedNext(pThis->pDrvMediaEx, hIoReq, &hIoReq, (void **)&pReq);
+            AssertRCReturn(rc, rc);
+        }
+    }
+    for (uint32_t i = 0; i < pThis->cHeadsRestored; i++)
+        SSMR3PutU16(pSSM, pThis->pau16HeadsRestored[i]);
+
+    Log(("%s State has been saved\n", INSTANCE(pThis)));
+    return SSMR3PutU32(pSSM, UINT32_MAX); /* terminator */
+}
+
+
+/**
+ * @callback_method_impl{FNSSMDEVLOADEXEC}
+ */
+static DECLCALLBACK(int) vblkLoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t uPass)
+{
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    int        rc;
+
+    /* config checks */
+    uint64_t cbMedium;
+    uint32_t fHostFeatures;
+    rc = SSMR3GetU64(pSSM, &cbMedium);
+    AssertRCReturn(rc, rc);
+    rc = SSMR3GetU32(pSSM, &fHostFeatures);
+    AssertRCReturn(rc, rc);
+    if (cbMedium != pThis->cbMedium)
+        LogRel(("%s: The medium size differs: config=%llu saved=%llu\n", INSTANCE(pThis), pThis->cbMedium, cbMedium));
+    if (fHostFeatures & ~pThis->fHostFeatures)
+        return SSMR3SetCfgError(pSSM, RT_SRC_POS, N_("Saved features %#x not supported by the configured device (%#x)"),
+                                fHostFeatures, pThis->fHostFeatures);
+
+    rc = vpciLoadExec(&pThis->VPCI, pSSM, uVersion, uPass, VBLK_N_QUEUES);
+    AssertRCReturn(rc, rc);
+
+    if (uPass == SSM_PASS_FINAL)
+    {
+        uint32_t cHeads;
+        rc = SSMR3GetU32(pSSM, &cHeads);
+        AssertRCReturn(rc, rc);
+        AssertLogRelMsgReturn(cHeads <= VBLK_QUEUE_SIZE, ("%u\n", cHeads), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+
+        RTMemFree(pThis->pau16HeadsRestored);
+        pThis->pau16HeadsRestored = NULL;
+        pThis->cHeadsRestored     = 0;
+        if (cHeads)
+        {
+            pThis->pau16HeadsRestored = (uint16_t *)RTMemAllocZ(cHeads * sizeof(uint16_t));
+            if (!pThis->pau16HeadsRestored)
+                return VERR_NO_MEMORY;
+            for (uint32_t i = 0; i < cHeads; i++)
+            {
+                rc = SSMR3GetU16(pSSM, &pThis->pau16HeadsRestored[i]);
+                AssertRCReturn(rc, rc);
+            }
+            pThis->cHeadsRestored = cHeads;
+        }
+
+        uint32_t u32;
+        rc = SSMR3GetU32(pSSM, &u32);
+        AssertRCReturn(rc, rc);
+        AssertLogRelMsgReturn(u32 == UINT32_MAX, ("%#x\n", u32), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+    }
+
+    return rc;
+}
+
+
+/* -=-=-=-=- PCI Device -=-=-=-=- */
+
+/**
+ * @callback_method_impl{FNPCIIOREGIONMAP}
+ */
+static DECLCALLBACK(int) vblkMap(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, uint32_t iRegion,
+                                 RTGCPHYS GCPhysAddress, RTGCPHYS cb, PCIADDRESSSPACE enmType)
+{
+    RT_NOREF(pPciDev, iRegion);
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    int        rc;
+
+    if (enmType != PCI_ADDRESS_SPACE_IO)
+    {
+        /* We should never get here */
+        AssertMsgFailed(("Invalid PCI address space param in map callback"));
+        return VERR_INTERNAL_ERROR;
+    }
+
+    pThis->VPCI.IOPortBase = (RTIOPORT)GCPhysAddress;
+    rc = PDMDevHlpIOPortRegister(pDevIns, pThis->VPCI.IOPortBase,
+                                 cb, 0, vblkIOPortOut, vblkIOPortIn,
+                                 NULL, NULL, "VirtioBlk");
+    AssertRCReturn(rc, rc);
+    /* Status and ISR reads are served in ring-0, queue notifications go to ring-3. */
+    rc = PDMDevHlpIOPortRegisterR0(pDevIns, pThis->VPCI.IOPortBase,
+                                   cb, 0, "vblkIOPortOut", "vblkIOPortIn",
+                                   NULL, NULL, "VirtioBlk");
+    AssertRC(rc);
+    return rc;
+}
+
+
+/* -=-=-=-=- PDMDEVREG -=-=-=-=- */
+
+/**
+ * Checks whether all requests have completed.
+ */
+static bool vblkR3AllAsyncIOIsFinished(PPDMDEVINS pDevIns)
+{
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    return pThis->cReqsActive == 0;
+}
+
+/**
+ * Callback employed by vblkR3Suspend and vblkR3PowerOff.
+ *
+ * @returns true if we've quiesced, false if we're still working.
+ * @param   pDevIns     The device instance.
+ */
+static DECLCALLBACK(bool) vblkR3IsAsyncSuspendOrPowerOffDone(PPDMDEVINS pDevIns)
+{
+    if (!vblkR3AllAsyncIOIsFinished(pDevIns))
+        return false;
+
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    ASMAtomicWriteBool(&pThis->fSignalIdle, false);
+    return true;
+}
+
+/**
+ * Common worker for vblkR3Suspend and vblkR3PowerOff.
+ */
+static void vblkR3SuspendOrPowerOff(PPDMDEVINS pDevIns)
+{
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+
+    ASMAtomicWriteBool(&pThis->fSignalIdle, true);
+    if (!vblkR3AllAsyncIOIsFinished(pDevIns))
+        PDMDevHlpSetAsyncNotification(pDevIns, vblkR3IsAsyncSuspendOrPowerOffDone);
+    else
+        ASMAtomicWriteBool(&pThis->fSignalIdle, false);
+
+    if (pThis->pDrvMediaEx)
+        pThis->pDrvMediaEx->pfnNotifySuspend(pThis->pDrvMediaEx);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnSuspend}
+ */
+static DECLCALLBACK(void) vblkR3Suspend(PPDMDEVINS pDevIns)
+{
+    Log(("vblkR3Suspend\n"));
+    vblkR3SuspendOrPowerOff(pDevIns);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnPowerOff}
+ */
+static DECLCALLBACK(void) vblkR3PowerOff(PPDMDEVINS pDevIns)
+{
+    Log(("vblkR3PowerOff\n"));
+    vblkR3SuspendOrPowerOff(pDevIns);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnResume}
+ */
+static DECLCALLBACK(void) vblkR3Resume(PPDMDEVINS pDevIns)
+{
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+
+    if (pThis->cHeadsRestored)
+    {
+        int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+        AssertRCReturnVoid(rc);
+
+        Log(("%s Resubmitting %u restored requests\n", INSTANCE(pThis), pThis->cHeadsRestored));
+        pThis->fProcessingQueue = true;
+        for (uint32_t i = 0; i < pThis->cHeadsRestored; i++)
+            vblkR3ChainSubmit(pThis, pThis->pau16HeadsRestored[i]);
+        pThis->fProcessingQueue = false;
+        if (pThis->cUsedPending)
+        {
+            pThis->cUsedPending = 0;
+            vqueueSync(&pThis->VPCI, pThis->pReqQueue);
+        }
+
+        RTMemFree(pThis->pau16HeadsRestored);
+        pThis->pau16HeadsRestored = NULL;
+        pThis->cHeadsRestored     = 0;
+        vpciCsLeave(&pThis->VPCI);
+    }
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnReset}
+ */
+static DECLCALLBACK(void) vblkR3Reset(PPDMDEVINS pDevIns)
+{
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+
+    RTMemFree(pThis->pau16HeadsRestored);
+    pThis->pau16HeadsRestored = NULL;
+    pThis->cHeadsRestored     = 0;
+    vblkIoCb_Reset(pThis);
+}
+
+/**
+ * Queries the medium properties and updates the configuration space.
+ *
+ * @param   pThis       The device state structure.
+ */
+static void vblkR3UpdateMediumInfo(PVBLKSTATE pThis)
+{
+    uint32_t fFeatures = VBLK_F_SEG_MAX | VBLK_F_FLUSH | VBLK_F_WRITE_ZEROES;
+
+    pThis->cbMedium  = 0;
+    pThis->fReadOnly = false;
+    if (pThis->pDrvMedia)
+    {
+        pThis->cbMedium  = pThis->pDrvMedia->pfnGetSize(pThis->pDrvMedia);
+        pThis->fReadOnly = pThis->pDrvMedia->pfnIsReadOnly(pThis->pDrvMedia);
+
+        uint32_t cbSector = pThis->pDrvMedia->pfnGetSectorSize(pThis->pDrvMedia);
+        if (cbSector > VBLK_SECTOR_SIZE && RT_IS_POWER_OF_TWO(cbSector))
+        {
+            fFeatures |= VBLK_F_BLK_SIZE;
+            pThis->config.cbBlk = cbSector;
+        }
+
+        uint32_t fMediaExFeatures = 0;
+        int rc = pThis->pDrvMediaEx->pfnQueryFeatures(pThis->pDrvMediaEx, &fMediaExFeatures);
+        if (RT_SUCCESS(rc) && (fMediaExFeatures & PDMIMEDIAEX_FEATURE_F_DISCARD))
+            fFeatures |= VBLK_F_DISCARD;
+    }
+    if (pThis->fReadOnly)
+        fFeatures = (fFeatures & ~(VBLK_F_WRITE_ZEROES | VBLK_F_DISCARD)) | VBLK_F_RO;
+
+    pThis->fHostFeatures                 = fFeatures;
+    pThis->config.uCapacity              = pThis->cbMedium / VBLK_SECTOR_SIZE;
+    pThis->config.cSegMax                = VBLK_SEG_MAX;
+    pThis->config.cMaxDiscardSectors     = VBLK_MAX_DISCARD_SECTORS;
+    pThis->config.cMaxDiscardSeg         = VBLK_MAX_DISCARD_SEG;
+    pThis->config.cDiscardSectorAlign    = RT_MAX(pThis->config.cbBlk, VBLK_SECTOR_SIZE) / VBLK_SECTOR_SIZE;
+    pThis->config.cMaxWriteZeroesSectors = VBLK_MAX_WRITE_ZEROES_SECTORS;
+    pThis->config.cMaxWriteZeroesSeg     = 1;
+    pThis->config.fWriteZeroesMayUnmap   = 0;
+}
+
+/**
+ * Attaches the medium driver at LUN#0 and queries its interfaces.
+ *
+ * @returns VBox status code.
+ * @param   pDevIns     The device instance.
+ * @param   pThis       The device state structure.
+ */
+static int vblkR3AttachMedium(PPDMDEVINS pDevIns, PVBLKSTATE pThis)
+{
+    int rc = PDMDevHlpDriverAttach(pDevIns, 0, &pThis->VPCI.IBase, &pThis->pDrvBase, "Block Port");
+    if (RT_SUCCESS(rc))
+    {
+        pThis->pDrvMedia = PDMIBASE_QUERY_INTERFACE(pThis->pDrvBase, PDMIMEDIA);
+        AssertMsgReturn(VALID_PTR(pThis->pDrvMedia),
+                        ("%s configuration error: LUN#0 misses the basic media interface!\n", INSTANCE(pThis)),
+                        VERR_PDM_MISSING_INTERFACE);
+
+        pThis->pDrvMediaEx = PDMIBASE_QUERY_INTERFACE(pThis->pDrvBase, PDMIMEDIAEX);
+        AssertMsgReturn(VALID_PTR(pThis->pDrvMediaEx),
+                        ("%s configuration error: LUN#0 misses the extended media interface!\n", INSTANCE(pThis)),
+                        VERR_PDM_MISSING_INTERFACE);
+
+        rc = pThis->pDrvMediaEx->pfnIoReqAllocSizeSet(pThis->pDrvMediaEx, sizeof(VBLKREQ));
+        AssertMsgRCReturn(rc, ("%s configuration error: Failed to set I/O request size!\n", INSTANCE(pThis)), rc);
+    }
+    else if (   rc == VERR_PDM_NO_ATTACHED_DRIVER
+             || rc == VERR_PDM_CFG_MISSING_DRIVER_NAME)
+    {
+        Log(("%s No medium attached\n", INSTANCE(pThis)));
+        pThis->pDrvBase    = NULL;
+        pThis->pDrvMedia   = NULL;
+        pThis->pDrvMediaEx = NULL;
+        rc = VINF_SUCCESS;
+    }
+
+    vblkR3UpdateMediumInfo(pThis);
+    return rc;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnDetach}
+ */
+static DECLCALLBACK(void) vblkR3Detach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t fFlags)
+{
+    RT_NOREF(fFlags);
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    Log(("%s vblkR3Detach:\n", INSTANCE(pThis)));
+
+    AssertLogRelReturnVoid(iLUN == 0);
+    AssertMsg(fFlags & PDM_TACH_FLAGS_NOT_HOT_PLUG, ("VirtioBlk: Device does not support hotplugging\n"));
+
+    /*
+     * Zero some important members.
+     */
+    pThis->pDrvBase    = NULL;
+    pThis->pDrvMedia   = NULL;
+    pThis->pDrvMediaEx = NULL;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnAttach}
+ */
+static DECLCALLBACK(int) vblkR3Attach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t fFlags)
+{
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    LogFlow(("%s vblkR3Attach:\n", INSTANCE(pThis)));
+
+    AssertLogRelReturn(iLUN == 0, VERR_PDM_NO_SUCH_LUN);
+    AssertMsgReturn(fFlags & PDM_TACH_FLAGS_NOT_HOT_PLUG,
+                    ("VirtioBlk: Device does not support hotplugging\n"),
+                    VERR_INVALID_PARAMETER);
+
+    /* the usual paranoia */
+    AssertRelease(!pThis->pDrvBase);
+    AssertRelease(!pThis->pDrvMedia);
+    AssertRelease(!pThis->pDrvMediaEx);
+
+    int rc = vblkR3AttachMedium(pDevIns, pThis);
+    if (RT_SUCCESS(rc))
+        vpciRaiseInterrupt(&pThis->VPCI, VERR_SEM_BUSY, VPCI_ISR_CONFIG);
+    return rc;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnRelocate}
+ */
+static DECLCALLBACK(void) vblkR3Relocate(PPDMDEVINS pDevIns, RTGCINTPTR offDelta)
+{
+    vpciRelocate(pDevIns, offDelta);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnDestruct}
+ */
+static DECLCALLBACK(int) vblkR3Destruct(PPDMDEVINS pDevIns)
+{
+    PDMDEV_CHECK_VERSIONS_RETURN_QUIET(pDevIns);
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+
+    Log(("%s Destroying instance\n", INSTANCE(pThis)));
+    RTMemFree(pThis->pau16HeadsRestored);
+    pThis->pau16HeadsRestored = NULL;
+    pThis->cHeadsRestored     = 0;
+
+    return vpciDestruct(&pThis->VPCI);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnConstruct}
+ */
+static DECLCALLBACK(int) vblkR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFGMNODE pCfg)
+{
+    PDMDEV_CHECK_VERSIONS_RETURN(pDevIns);
+    PVBLKSTATE pThis = PDMINS_2_DATA(pDevIns, PVBLKSTATE);
+    int        rc;
+
+    /* Do our own locking. */
+    rc = PDMDevHlpSetDeviceCritSect(pDevIns, PDMDevHlpCritSectGetNop(pDevIns));
+    AssertRCReturn(rc, rc);
+
+    /* Initialize PCI part. */
+    pThis->VPCI.IBase.pfnQueryInterface = vblkQueryInterface;
+    rc = vpciConstruct(pDevIns, &pThis->VPCI, iInstance,
+                       VBLK_NAME_FMT, VIRTIO_BLK_ID,
+                       VBLK_PCI_CLASS, VBLK_N_QUEUES);
+    if (RT_FAILURE(rc))
+        return rc;
+    pThis->pReqQueue = vpciAddQueue(&pThis->VPCI, VBLK_QUEUE_SIZE, vblkR3QueueNotify, "REQ");
+
+    Log(("%s Constructing new instance\n", INSTANCE(pThis)));
+
+    /*
+     * Validate configuration.
+     */
+    if (!CFGMR3AreValuesValid(pCfg, "SerialNumber\0"))
+        return PDMDEV_SET_ERROR(pDevIns, VERR_PDM_DEVINS_UNKNOWN_CFG_VALUES, N_("Invalid configuration for VirtioBlk device"));
+
+    /** @cfgm{/Devices/virtio-blk/0/Config/SerialNumber, string, "VB-VBLK<instance>"}
+     * The identification string returned for VIRTIO_BLK_T_GET_ID, at most 20
+     * characters. */
+    char szDefSerial[sizeof(pThis->szSerial)];
+    RTStrPrintf(szDefSerial, sizeof(szDefSerial), "VB-VBLK%d", iInstance);
+    rc = CFGMR3QueryStringDef(pCfg, "SerialNumber", pThis->szSerial, sizeof(pThis->szSerial), szDefSerial);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc,
+                                N_("Configuration error: Failed to get the value of 'SerialNumber' (at most 20 characters)"));
+
+    /* Interfaces */
+    pThis->IMediaPort.pfnQueryDeviceLocation        = vblkR3QueryDeviceLocation;
+    pThis->IMediaPort.pfnQueryScsiInqStrings        = NULL;
+    pThis->IMediaExPort.pfnIoReqCompleteNotify      = vblkR3IoReqCompleteNotify;
+    pThis->IMediaExPort.pfnIoReqCopyFromBuf         = vblkR3IoReqCopyFromBuf;
+    pThis->IMediaExPort.pfnIoReqCopyToBuf           = vblkR3IoReqCopyToBuf;
+    pThis->IMediaExPort.pfnIoReqQueryBuf            = NULL;
+    pThis->IMediaExPort.pfnIoReqQueryDiscardRanges  = vblkR3IoReqQueryDiscardRanges;
+    pThis->IMediaExPort.pfnIoReqStateChanged        = vblkR3IoReqStateChanged;
+    pThis->IMediaExPort.pfnMediumEjected            = vblkR3MediumEjected;
+
+    rc = vpciConstructModern(pDevIns, &pThis->VPCI, &g_IOCallbacks, sizeof(struct VBlkPCIConfig), 0 /*fFlags*/);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* Map our ports to IO space. */
+    rc = PDMDevHlpPCIIORegionRegister(pDevIns, 0,
+                                      VPCI_CONFIG_MSIX + sizeof(struct VBlkPCIConfig),
+                                      PCI_ADDRESS_SPACE_IO, vblkMap);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* Register save/restore state handlers. */
+    rc = PDMDevHlpSSMRegisterEx(pDevIns, VIRTIO_SAVEDSTATE_VERSION, sizeof(VBLKSTATE), NULL,
+                                NULL,         vblkLiveExec, NULL,
+                                NULL,         vblkSaveExec, NULL,
+                                NULL,         vblkLoadExec, NULL);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    rc = vblkR3AttachMedium(pDevIns, pThis);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("Failed to attach the block device LUN"));
+
+    rc = vblkIoCb_Reset(pThis);
+    AssertRC(rc);
+
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatBytesRead,          STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,          "Amount of data read",                    "/Devices/VBlk%d/ReadBytes", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatBytesWritten,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_BYTES,          "Amount of data written",                 "/Devices/VBlk%d/WrittenBytes", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatKicks,              STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of queue notifications",          "/Devices/VBlk%d/Kicks", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqs,               STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of requests processed",           "/Devices/VBlk%d/Reqs/Total", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqsFlush,          STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of flush requests",               "/Devices/VBlk%d/Reqs/Flush", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqsDiscard,        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of discard requests",             "/Devices/VBlk%d/Reqs/Discard", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqsWriteZeroes,    STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of write zeroes requests",        "/Devices/VBlk%d/Reqs/WriteZeroes", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqsFailed,         STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Number of failed requests",              "/Devices/VBlk%d/Reqs/Failed", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCompletionsBatched, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,     "Completions published with a later notification", "/Devices/VBlk%d/Reqs/CompletionsBatched", iInstance);
+#if defined(VBOX_WITH_STATISTICS)
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatKick,               STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_CALL, "Profiling queue processing",             "/Devices/VBlk%d/Kick", iInstance);
+#endif /* VBOX_WITH_STATISTICS */
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * The device registration structure.
+ */
+const PDMDEVREG g_DeviceVirtioBlk =
+{
+    /* Structure version. PDM_DEVREG_VERSION defines the current version. */
+    PDM_DEVREG_VERSION,
+    /* Device name. */
+    "virtio-blk",
+    /* Name of guest context module (no path).
+     * Only evalutated if PDM_DEVREG_FLAGS_RC is set. */
+    "",
+    /* Name of ring-0 module (no path).
+     * Only evalutated if PDM_DEVREG_FLAGS_RC is set. */
+    "VBoxDDR0.r0",
+    /* The description of the device. The UTF-8 string pointed to shall, like this structure,
+     * remain unchanged from registration till VM destruction. */
+    "Virtio Block Device.\n",
+
+    /* Flags, combination of the PDM_DEVREG_FLAGS_* \#defines. */
+    PDM_DEVREG_FLAGS_DEFAULT_BITS | PDM_DEVREG_FLAGS_R0,
+    /* Device class(es), combination of the PDM_DEVREG_CLASS_* \#defines. */
+    PDM_DEVREG_CLASS_STORAGE,
+    /* Maximum number of instances (per VM). */
+    ~0U,
+    /* Size of the instance data. */
+    sizeof(VBLKSTATE),
+
+    /* pfnConstruct */
+    vblkR3Construct,
+    /* pfnDestruct */
+    vblkR3Destruct,
+    /* pfnRelocate */
+    vblkR3Relocate,
+    /* pfnMemSetup. */
+    NULL,
+    /* pfnPowerOn */
+    NULL,
+    /* pfnReset */
+    vblkR3Reset,
+    /* pfnSuspend */
+    vblkR3Suspend,
+    /* pfnResume */
+    vblkR3Resume,
+    /* pfnAttach */
+    vblkR3Attach,
+    /* pfnDetach */
+    vblkR3Detach,
+    /* pfnQueryInterface */
+    NULL,
+    /* pfnInitComplete */
+    NULL,
+    /* pfnPowerOff */
+    vblkR3PowerOff,
+    /* pfnSoftReset */
+    NULL,
+
+    /* u32VersionEnd */
+    PDM_DEVREG_VERSION
+};
+
+#endif /* IN_RING3 */
+#endif /* !VBOX_DEVICE_STRUCT_TESTCASE */
@@ -0,0 +1,1989 @@
+/* $Id: DevVirtioSCSI.cpp $ */
+/** @file
+ * DevVirtioSCSI - Virtio SCSI Host Bus Adapter
+ */
+
+/*
+ * Copyright (C) 2009-2019 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define LOG_GROUP LOG_GROUP_DEV_VIRTIO
+
+#include <VBox/vmm/pdmdev.h>
+#include <VBox/vmm/pdmstorageifs.h>
+#include <VBox/scsi.h>
+#include <iprt/asm.h>
+#include <iprt/string.h>
+#ifdef IN_RING3
+# include <iprt/mem.h>
+# include <iprt/sg.h>
+# include <iprt/uuid.h>
+#endif
+#include "VBoxDD.h"
+#include "../VirtIO/Virtio.h"
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+#ifndef VBOX_DEVICE_STRUCT_TESTCASE
+
+#define INSTANCE(pThis) pThis->VPCI.szInstance
+
+#ifdef IN_RING3
+
+#define VIOSCSI_PCI_CLASS               0x0100
+#define VIOSCSI_NAME_FMT                "VScsi%d"
+
+#endif /* IN_RING3 */
+
+#endif /* VBOX_DEVICE_STRUCT_TESTCASE */
+
+/** The saved state version. */
+#define VIOSCSI_SAVED_STATE_VERSION     2
+/** The saved state version before the virtio 1.0 transport was added. */
+#define VIOSCSI_SAVED_STATE_VERSION_LEGACY 1
+
+/** Index of the control queue. */
+#define VIOSCSI_QUEUE_CONTROL           0
+/** Index of the event queue. */
+#define VIOSCSI_QUEUE_EVENT             1
+/** Index of the first request queue. */
+#define VIOSCSI_QUEUE_REQ_FIRST         2
+/** Maximum number of request queues. */
+#define VIOSCSI_REQ_QUEUES_MAX          (VIRTIO_MAX_NQUEUES - VIOSCSI_QUEUE_REQ_FIRST)
+/** Size of each queue. */
+#define VIOSCSI_QUEUE_SIZE              128
+/** Maximum number of data segments in a request, the request header and
+ * response descriptors are not counted. */
+#define VIOSCSI_SEG_MAX                 (VIOSCSI_QUEUE_SIZE - 2)
+/** Maximum number of segments in a control or event queue chain. */
+#define VIOSCSI_CTRL_SEG_MAX            4
+/** Maximum CDB size supported. */
+#define VIOSCSI_CDB_SIZE_MAX            32
+/** Maximum sense buffer size supported. */
+#define VIOSCSI_SENSE_SIZE_MAX          96
+/** Maximum number of targets. */
+#define VIOSCSI_TARGETS_MAX             256
+/** Maximum LUN supported by the single level flat LUN addressing. */
+#define VIOSCSI_LUN_MAX                 16383
+/** Number of events kept while the guest has no event buffers posted. */
+#define VIOSCSI_EVENTS_MAX              16
+
+/** @name Virtio SCSI features
+ * @{  */
+#define VIRTIO_SCSI_F_INOUT             0x00000001  /**< Bidirectional requests. */
+#define VIRTIO_SCSI_F_HOTPLUG           0x00000002  /**< Hot-plug and hot-unplug events. */
+#define VIRTIO_SCSI_F_CHANGE            0x00000004  /**< Parameter change events. */
+#define VIRTIO_SCSI_F_T10_PI            0x00000008  /**< T10 protection information. */
+/** @} */
+
+/** @name Request response codes
+ * @{  */
+#define VIRTIO_SCSI_S_OK                0
+#define VIRTIO_SCSI_S_OVERRUN           1
+#define VIRTIO_SCSI_S_ABORTED           2
+#define VIRTIO_SCSI_S_BAD_TARGET        3
+#define VIRTIO_SCSI_S_RESET             4
+#define VIRTIO_SCSI_S_BUSY              5
+#define VIRTIO_SCSI_S_TRANSPORT_FAILURE 6
+#define VIRTIO_SCSI_S_TARGET_FAILURE    7
+#define VIRTIO_SCSI_S_NEXUS_FAILURE     8
+#define VIRTIO_SCSI_S_FAILURE           9
+#define VIRTIO_SCSI_S_FUNCTION_SUCCEEDED 10
+#define VIRTIO_SCSI_S_FUNCTION_REJECTED 11
+#define VIRTIO_SCSI_S_INCORRECT_LUN     12
+/** @} */
+
+/** @name Control queue request types
+ * @{  */
+#define VIRTIO_SCSI_T_TMF               0
+#define VIRTIO_SCSI_T_AN_QUERY          1
+#define VIRTIO_SCSI_T_AN_SUBSCRIBE      2
+/** @} */
+
+/** @name Task management function subtypes
+ * @{  */
+#define VIRTIO_SCSI_T_TMF_ABORT_TASK            0
+#define VIRTIO_SCSI_T_TMF_ABORT_TASK_SET        1
+#define VIRTIO_SCSI_T_TMF_CLEAR_ACA             2
+#define VIRTIO_SCSI_T_TMF_CLEAR_TASK_SET        3
+#define VIRTIO_SCSI_T_TMF_I_T_NEXUS_RESET       4
+#define VIRTIO_SCSI_T_TMF_LOGICAL_UNIT_RESET    5
+#define VIRTIO_SCSI_T_TMF_QUERY_TASK            6
+#define VIRTIO_SCSI_T_TMF_QUERY_TASK_SET        7
+/** @} */
+
+/** @name Events
+ * @{  */
+#define VIRTIO_SCSI_T_NO_EVENT          0
+#define VIRTIO_SCSI_T_TRANSPORT_RESET   1
+#define VIRTIO_SCSI_T_ASYNC_NOTIFY      2
+#define VIRTIO_SCSI_T_PARAM_CHANGE      3
+#define VIRTIO_SCSI_T_EVENTS_MISSED     UINT32_C(0x80000000)
+
+#define VIRTIO_SCSI_EVT_RESET_HARD      0
+#define VIRTIO_SCSI_EVT_RESET_RESCAN    1
+#define VIRTIO_SCSI_EVT_RESET_REMOVED   2
+/** @} */
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+#pragma pack(1)
+/**
+ * The device specific part of the configuration space.
+ */
+struct VirtioScsiConfig
+{
+    uint32_t cQueues;           /**< Number of request queues. */
+    uint32_t cSegMax;           /**< Maximum number of data segments in a request. */
+    uint32_t cMaxSectors;       /**< Maximum transfer size in 512 byte sectors. */
+    uint32_t cCmdPerLun;        /**< Maximum number of linked commands per LUN. */
+    uint32_t cbEventInfo;       /**< Size of the event structure. */
+    uint32_t cbSense;           /**< Sense buffer size, writable by the guest. */
+    uint32_t cbCdb;             /**< CDB size, writable by the guest. */
+    uint16_t uMaxChannel;       /**< Maximum channel number. */
+    uint16_t uMaxTarget;        /**< Maximum target number. */
+    uint32_t uMaxLun;           /**< Maximum LUN number. */
+};
+
+/**
+ * Request header, followed by the CDB of the configured size.
+ */
+typedef struct VirtioScsiReqCmd
+{
+    uint8_t  abLun[8];
+    uint64_t u64Id;
+    uint8_t  uTaskAttr;
+    uint8_t  uPrio;
+    uint8_t  uCrn;
+    uint8_t  abCdb[VIOSCSI_CDB_SIZE_MAX];
+} VIOSCSIREQCMD;
+
+/**
+ * Request response, followed by the sense data of the configured size.
+ */
+typedef struct VirtioScsiRespCmd
+{
+    uint32_t cbSense;
+    uint32_t cbResidual;
+    uint16_t uStatusQualifier;
+    uint8_t  uStatus;
+    uint8_t  uResponse;
+    uint8_t  abSense[VIOSCSI_SENSE_SIZE_MAX];
+} VIOSCSIRESPCMD;
+
+/**
+ * Task management function request.
+ */
+typedef struct VirtioScsiCtrlTmf
+{
+    uint32_t u32Type;
+    uint32_t u32Subtype;
+    uint8_t  abLun[8];
+    uint64_t u64Id;
+} VIOSCSICTRLTMF;
+
+/**
+ * Asynchronous notification query / subscribe request.
+ */
+typedef struct VirtioScsiCtrlAn
+{
+    uint32_t u32Type;
+    uint8_t  abLun[8];
+    uint32_t fEventsRequested;
+} VIOSCSICTRLAN;
+
+/**
+ * Asynchronous notification response.
+ */
+typedef struct VirtioScsiCtrlAnResp
+{
+    uint32_t fEventsActual;
+    uint8_t  uResponse;
+} VIOSCSICTRLANRESP;
+
+/**
+ * Event delivered through the event queue.
+ */
+typedef struct VirtioScsiEvent
+{
+    uint32_t u32Event;
+    uint8_t  abLun[8];
+    uint32_t u32Reason;
+} VIOSCSIEVENT;
+#pragma pack()
+AssertCompileSize(struct VirtioScsiConfig, 36);
+AssertCompileSize(VIOSCSIREQCMD, 19 + VIOSCSI_CDB_SIZE_MAX);
+AssertCompileSize(VIOSCSIRESPCMD, 12 + VIOSCSI_SENSE_SIZE_MAX);
+AssertCompileSize(VIOSCSICTRLTMF, 24);
+AssertCompileSize(VIOSCSICTRLAN, 16);
+AssertCompileSize(VIOSCSICTRLANRESP, 5);
+AssertCompileSize(VIOSCSIEVENT, 16);
+
+/**
+ * A guest memory segment of a descriptor chain.
+ */
+typedef struct VioScsiSeg
+{
+    /** Guest physical address of the segment. */
+    RTGCPHYS    GCPhys;
+    /** Size of the segment. */
+    uint32_t    cb;
+    /** Set if the segment is device writable. */
+    bool        fWrite;
+} VIOSCSISEG;
+/** Pointer to a descriptor chain segment. */
+typedef VIOSCSISEG *PVIOSCSISEG;
+/** Pointer to a const descriptor chain segment. */
+typedef const VIOSCSISEG *PCVIOSCSISEG;
+
+/** Pointer to the device state. */
+typedef struct VioScsiState *PVIOSCSISTATE;
+
+/**
+ * Target state, one for every PDM LUN.
+ *
+ * @implements  PDMIBASE
+ * @implements  PDMIMEDIAPORT
+ * @implements  PDMIMEDIAEXPORT
+ */
+typedef struct VioScsiTarget
+{
+    /** Pointer to the owning device instance. */
+    R3PTRTYPE(PVIOSCSISTATE)        pVioScsiR3;
+    /** The target number, also the PDM LUN. */
+    uint32_t                        iTarget;
+    /** Number of outstanding requests. */
+    volatile uint32_t               cReqsActive;
+    /** Our base interface. */
+    PDMIBASE                        IBase;
+    /** Media port interface. */
+    PDMIMEDIAPORT                   IMediaPort;
+    /** Extended media port interface. */
+    PDMIMEDIAEXPORT                 IMediaExPort;
+    /** Pointer to the attached driver's base interface. */
+    R3PTRTYPE(PPDMIBASE)            pDrvBase;
+    /** Pointer to the attached driver's media interface. */
+    R3PTRTYPE(PPDMIMEDIA)           pDrvMedia;
+    /** Pointer to the attached driver's extended media interface. */
+    R3PTRTYPE(PPDMIMEDIAEX)         pDrvMediaEx;
+} VIOSCSITARGET;
+/** Pointer to a target. */
+typedef VIOSCSITARGET *PVIOSCSITARGET;
+
+/**
+ * Request queue state.
+ *
+ * Each request queue is drained under its own lock by the EMT kicking it,
+ * the guest driver places one queue on every vCPU so submissions from
+ * different vCPUs do not serialize on the device lock.
+ */
+typedef struct VioScsiReqQueue
+{
+    /** Serializes consuming the available ring of the queue. */
+    PDMCRITSECT                     CritSect;
+    /** The virtio queue. */
+    R3PTRTYPE(PVQUEUE)              pQueue;
+    /** Set while the queue is processed, completions only add used elements
+     * and leave the guest notification to the end of the queue run then.
+     * Protected by the device lock. */
+    bool                            fProcessing;
+    /** Number of used elements not yet published to the guest.
+     * Protected by the device lock. */
+    uint16_t                        cUsedPending;
+    /** Number of queue notifications. */
+    STAMCOUNTER                     StatKicks;
+} VIOSCSIREQQUEUE;
+/** Pointer to a request queue state. */
+typedef VIOSCSIREQQUEUE *PVIOSCSIREQQUEUE;
+
+/**
+ * Virtio SCSI request, the I/O request allocator specific memory.
+ */
+typedef struct VioScsiReq
+{
+    /** The I/O request handle. */
+    PDMMEDIAEXIOREQ                 hIoReq;
+    /** The target the request is for. */
+    R3PTRTYPE(PVIOSCSITARGET)       pTarget;
+    /** Head descriptor index of the chain this request came from. */
+    uint16_t                        uHeadIdx;
+    /** Reset generation the request was submitted in. */
+    uint16_t                        uGen;
+    /** Index of the request queue. */
+    uint16_t                        iReqQueue;
+    /** The SCSI status returned by the driver. */
+    uint8_t                         u8ScsiSts;
+    /** Transfer direction. */
+    PDMMEDIAEXIOREQSCSITXDIR        enmTxDir;
+    /** Number of data bytes the guest provided for the transfer. */
+    uint32_t                        cbData;
+    /** Size of the request header for this request. */
+    uint32_t                        cbReqHdr;
+    /** Size of the response for this request. */
+    uint32_t                        cbResp;
+    /** The CDB. */
+    uint8_t                         abCdb[VIOSCSI_CDB_SIZE_MAX];
+    /** The sense buffer. */
+    uint8_t                         abSense[VIOSCSI_SENSE_SIZE_MAX];
+    /** Number of valid segments. */
+    uint32_t                        cSegs;
+    /** The chain segments. */
+    VIOSCSISEG                      aSegs[VIOSCSI_QUEUE_SIZE];
+} VIOSCSIREQ;
+/** Pointer to a virtio SCSI request. */
+typedef VIOSCSIREQ *PVIOSCSIREQ;
+
+/**
+ * Device state structure. Holds the current state of device.
+ *
+ * @extends     VPCISTATE
+ */
+typedef struct VioScsiState
+{
+    /* VPCISTATE must be the first member! */
+    VPCISTATE                       VPCI;
+
+    /** PCI config area holding the limits. */
+    struct VirtioScsiConfig         config;
+    /** Number of request queues. */
+    uint32_t                        cReqQueues;
+    /** Number of targets. */
+    uint32_t                        cTargets;
+    /** The targets. */
+    R3PTRTYPE(PVIOSCSITARGET)       paTargets;
+    /** The control queue. */
+    R3PTRTYPE(PVQUEUE)              pCtrlQueue;
+    /** The event queue. */
+    R3PTRTYPE(PVQUEUE)              pEventQueue;
+
+    /** Events waiting for the guest to post event buffers, protected by the
+     * device lock. */
+    VIOSCSIEVENT                    aEvents[VIOSCSI_EVENTS_MAX];
+    /** Index of the first pending event. */
+    uint32_t                        idxEventFirst;
+    /** Number of pending events. */
+    uint32_t                        cEvents;
+    /** Set if events were dropped because aEvents was full. */
+    bool                            fEventsMissed;
+    /** Indicates that PDMDevHlpAsyncNotificationCompleted should be called
+     * when the last active request completes. */
+    bool volatile                   fSignalIdle;
+    /** Reset generation, completions of requests from older generations
+     * are dropped. */
+    uint16_t                        uGen;
+    /** Number of active requests. */
+    uint32_t volatile               cReqsActive;
+
+    /** Queue/head pairs of suspended requests restored from a saved state,
+     * resubmitted on resume. */
+    R3PTRTYPE(uint32_t *)           pau32ReqsRestored;
+    /** Number of entries in pau32ReqsRestored. */
+    uint32_t                        cReqsRestored;
+
+    /** @name Statistic
+     * @{ */
+    STAMCOUNTER                     StatReqs;
+    STAMCOUNTER                     StatReqsFailed;
+    STAMCOUNTER                     StatReqsBadTarget;
+    STAMCOUNTER                     StatCompletionsBatched;
+    STAMCOUNTER                     StatTmf;
+    STAMCOUNTER                     StatEvents;
+    STAMCOUNTER                     StatEventsMissed;
+    /** @}  */
+
+    /** The request queues. */
+    VIOSCSIREQQUEUE                 aReqQueues[VIOSCSI_REQ_QUEUES_MAX];
+} VIOSCSISTATE;
+
+#ifndef VBOX_DEVICE_STRUCT_TESTCASE
+
+AssertCompileMemberOffset(VIOSCSISTATE, VPCI, 0);
+
+static DECLCALLBACK(uint32_t) vioscsiIoCb_GetHostFeatures(void *pvState)
+{
+    RT_NOREF(pvState);
+    return VIRTIO_SCSI_F_HOTPLUG;
+}
+
+static DECLCALLBACK(uint32_t) vioscsiIoCb_GetHostMinimalFeatures(void *pvState)
+{
+    RT_NOREF(pvState);
+    return 0;
+}
+
+static DECLCALLBACK(void) vioscsiIoCb_SetHostFeatures(void *pvState, uint32_t fFeatures)
+{
+    PVIOSCSISTATE pThis = (PVIOSCSISTATE)pvState;
+    LogFlow(("%s vioscsiIoCb_SetHostFeatures: uFeatures=%x\n", INSTANCE(pThis), fFeatures));
+    RT_NOREF2(pThis, fFeatures);
+}
+
+static DECLCALLBACK(int) vioscsiIoCb_GetConfig(void *pvState, uint32_t offCfg, uint32_t cb, void *data)
+{
+    PVIOSCSISTATE pThis = (PVIOSCSISTATE)pvState;
+    if (offCfg + cb > sizeof(struct VirtioScsiConfig))
+    {
+        Log(("%s vioscsiIoCb_GetConfig: Read beyond the config structure is attempted (offCfg=%#x cb=%x).\n", INSTANCE(pThis), offCfg, cb));
+        return VERR_IOM_IOPORT_UNUSED;
+    }
+    memcpy(data, (uint8_t *)&pThis->config + offCfg, cb);
+    return VINF_SUCCESS;
+}
+
+static DECLCALLBACK(int) vioscsiIoCb_SetConfig(void *pvState, uint32_t offCfg, uint32_t cb, void *data)
+{
+    PVIOSCSISTATE pThis = (PVIOSCSISTATE)pvState;
+
+    /* Only the sense and CDB sizes are writable, and only up to what we support. */
+    if (   cb == sizeof(uint32_t)
+        && (   offCfg == RT_UOFFSETOF(struct VirtioScsiConfig, cbSense)
+            || offCfg == RT_UOFFSETOF(struct VirtioScsiConfig, cbCdb)))
+    {
+        uint32_t u32 = *(uint32_t *)data;
+        if (offCfg == RT_UOFFSETOF(struct VirtioScsiConfig, cbSense))
+            pThis->config.cbSense = RT_MIN(u32, VIOSCSI_SENSE_SIZE_MAX);
+        else
+            pThis->config.cbCdb   = RT_MIN(u32, VIOSCSI_CDB_SIZE_MAX);
+    }
+    else
+        Log(("%s vioscsiIoCb_SetConfig: Ignoring write to the config structure (offCfg=%#x cb=%x).\n", INSTANCE(pThis), offCfg, cb));
+    return VINF_SUCCESS;
+}
+
+/**
+ * Hardware reset. Revert all registers to initial values.
+ *
+ * Requests still in flight belong to the previous generation and their
+ * completions will not touch the (re-initialized) queues.
+ *
+ * @param   pThis      The device state structure.
+ */
+static DECLCALLBACK(int) vioscsiIoCb_Reset(void *pvState)
+{
+#ifndef IN_RING3
+    RT_NOREF(pvState);
+    return VINF_IOM_R3_IOPORT_WRITE;
+#else
+    PVIOSCSISTATE pThis = (PVIOSCSISTATE)pvState;
+    Log(("%s Reset triggered\n", INSTANCE(pThis)));
+
+    /* Lock order: request queue locks before the device lock. */
+    for (uint32_t i = 0; i < pThis->cReqQueues; i++)
+        PDMCritSectEnter(&pThis->aReqQueues[i].CritSect, VERR_IGNORED);
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    if (RT_LIKELY(rc == VINF_SUCCESS))
+    {
+        pThis->uGen++;
+        for (uint32_t i = 0; i < pThis->cReqQueues; i++)
+            pThis->aReqQueues[i].cUsedPending = 0;
+        pThis->idxEventFirst = 0;
+        pThis->cEvents       = 0;
+        pThis->fEventsMissed = false;
+        pThis->config.cbSense = VIOSCSI_SENSE_SIZE_MAX;
+        pThis->config.cbCdb   = VIOSCSI_CDB_SIZE_MAX;
+        vpciReset(&pThis->VPCI);
+        vpciCsLeave(&pThis->VPCI);
+    }
+    else
+        LogRel(("vioscsiIoCb_Reset failed to enter critical section!\n"));
+    for (uint32_t i = pThis->cReqQueues; i > 0; i--)
+        PDMCritSectLeave(&pThis->aReqQueues[i - 1].CritSect);
+
+    if (RT_SUCCESS(rc) && pThis->cReqsActive)
+        for (uint32_t i = 0; i < pThis->cTargets; i++)
+            if (pThis->paTargets[i].pDrvMediaEx)
+                pThis->paTargets[i].pDrvMediaEx->pfnIoReqCancelAll(pThis->paTargets[i].pDrvMediaEx);
+    return rc;
+#endif
+}
+
+/**
+ * This function is called when the driver becomes ready.
+ *
+ * @param   pThis      The device state structure.
+ */
+static DECLCALLBACK(void) vioscsiIoCb_Ready(void *pvState)
+{
+    PVIOSCSISTATE pThis = (PVIOSCSISTATE)pvState;
+    Log(("%s Driver became ready\n", INSTANCE(pThis)));
+    RT_NOREF(pThis);
+}
+
+
+/**
+ * I/O port callbacks.
+ */
+static const VPCIIOCALLBACKS g_IOCallbacks =
+{
+     vioscsiIoCb_GetHostFeatures,
+     vioscsiIoCb_GetHostMinimalFeatures,
+     vioscsiIoCb_SetHostFeatures,
+     vioscsiIoCb_GetConfig,
+     vioscsiIoCb_SetConfig,
+     vioscsiIoCb_Reset,
+     vioscsiIoCb_Ready,
+};
+
+
+/**
+ * @callback_method_impl{FNIOMIOPORTIN}
+ */
+PDMBOTHCBDECL(int) vioscsiIOPortIn(PPDMDEVINS pDevIns, void *pvUser, RTIOPORT port, uint32_t *pu32, unsigned cb)
+{
+    return vpciIOPortIn(pDevIns, pvUser, port, pu32, cb, &g_IOCallbacks);
+}
+
+
+/**
+ * @callback_method_impl{FNIOMIOPORTOUT}
+ */
+PDMBOTHCBDECL(int) vioscsiIOPortOut(PPDMDEVINS pDevIns, void *pvUser, RTIOPORT port, uint32_t u32, unsigned cb)
+{
+    return vpciIOPortOut(pDevIns, pvUser, port, u32, cb, &g_IOCallbacks);
+}
+
+
+#ifdef IN_RING3
+
+/**
+ * Walks the descriptor chain starting at the given head and collects the
+ * segments.
+ *
+ * Device readable segments must all come before the device writable ones.
+ *
+ * @returns true if the chain is well formed, false otherwise.
+ * @param   pThis       The device state structure.
+ * @param   pQueue      The queue the chain belongs to.
+ * @param   uHeadIdx    Head descriptor index of the chain.
+ * @param   paSegs      Where to store the segments.
+ * @param   cSegsMax    Size of the segment array.
+ * @param   pcSegs      Where to return the number of segments.
+ */
+static bool vioscsiR3ChainParse(PVIOSCSISTATE pThis, PVQUEUE pQueue, uint16_t uHeadIdx,
+                                PVIOSCSISEG paSegs, uint32_t cSegsMax, uint32_t *pcSegs)
+{
+    VRINGDESC Desc;
+    uint32_t  cSegs  = 0;
+    uint32_t  cDescs = 0;
+    uint32_t  idx    = uHeadIdx;
+    bool      fValid = true;
+
+    do
+    {
+        /* Guard against descriptor loops, see vqueueGet. */
+        if (cDescs++ >= pQueue->VRing.uSize)
+        {
+            Log(("%s vioscsiR3ChainParse: Descriptor chain at %u loops\n", INSTANCE(pThis), uHeadIdx));
+            fValid = false;
+            break;
+        }
+        RT_UNTRUSTED_VALIDATED_FENCE();
+
+        vringReadDesc(&pThis->VPCI, &pQueue->VRing, idx, &Desc);
+        if (Desc.uLen)
+        {
+            bool fWrite = RT_BOOL(Desc.u16Flags & VRINGDESC_F_WRITE);
+            if (   cSegs >= cSegsMax
+                || (!fWrite && cSegs && paSegs[cSegs - 1].fWrite))
+                fValid = false;
+            else
+            {
+                paSegs[cSegs].GCPhys = Desc.u64Addr;
+                paSegs[cSegs].cb     = Desc.uLen;
+                paSegs[cSegs].fWrite = fWrite;
+                cSegs++;
+            }
+        }
+        idx = Desc.u16Next;
+    } while (Desc.u16Flags & VRINGDESC_F_NEXT);
+
+    *pcSegs = cSegs;
+    return fValid;
+}
+
+/**
+ * Returns the number of bytes in the device readable or writable part of a
+ * descriptor chain.
+ */
+static uint32_t vioscsiR3ChainSize(PCVIOSCSISEG paSegs, uint32_t cSegs, bool fWrite)
+{
+    uint32_t cb = 0;
+    for (uint32_t i = 0; i < cSegs; i++)
+        if (paSegs[i].fWrite == fWrite)
+            cb += paSegs[i].cb;
+    return cb;
+}
+
+/**
+ * Copies between the device readable or writable part of a descriptor chain
+ * and a host S/G buffer.
+ *
+ * @returns Number of bytes copied.
+ * @param   pThis       The device state structure.
+ * @param   paSegs      The chain segments.
+ * @param   cSegs       Number of chain segments.
+ * @param   offChain    Offset into the readable (fToGuest false) or writable
+ *                      (fToGuest true) part of the chain.
+ * @param   pSgBuf      The host S/G buffer.
+ * @param   cbCopy      How much to copy.
+ * @param   fToGuest    Direction, true if copying into guest memory.
+ */
+static size_t vioscsiR3ChainCopy(PVIOSCSISTATE pThis, PCVIOSCSISEG paSegs, uint32_t cSegs, size_t offChain,
+                                 PRTSGBUF pSgBuf, size_t cbCopy, bool fToGuest)
+{
+    PPDMDEVINS pDevIns = pThis->VPCI.CTX_SUFF(pDevIns);
+    size_t     cbDone  = 0;
+
+    for (uint32_t i = 0; i < cSegs && cbDone < cbCopy; i++)
+    {
+        if (paSegs[i].fWrite != fToGuest)
+            continue;
+        if (offChain >= paSegs[i].cb)
+        {
+            offChain -= paSegs[i].cb;
+            continue;
+        }
+
+        RTGCPHYS GCPhys = paSegs[i].GCPhys + offChain;
+        size_t   cbLeft = RT_MIN(paSegs[i].cb - offChain, cbCopy - cbDone);
+        offChain = 0;
+        while (cbLeft)
+        {
+            size_t cbSeg = cbLeft;
+            void *pvSeg = RTSgBufGetNextSegment(pSgBuf, &cbSeg);
+            if (!pvSeg)
+                return cbDone;
+
+            if (fToGuest)
+                PDMDevHlpPCIPhysWrite(pDevIns, GCPhys, pvSeg, cbSeg);
+            else
+                PDMDevHlpPhysRead(pDevIns, GCPhys, pvSeg, cbSeg);
+            GCPhys += cbSeg;
+            cbLeft -= cbSeg;
+            cbDone += cbSeg;
+        }
+    }
+
+    return cbDone;
+}
+
+/**
+ * Flat buffer wrapper around vioscsiR3ChainCopy.
+ */
+static size_t vioscsiR3ChainCopyBuf(PVIOSCSISTATE pThis, PCVIOSCSISEG paSegs, uint32_t cSegs, size_t offChain,
+                                    void *pvBuf, size_t cbBuf, bool fToGuest)
+{
+    RTSGSEG Seg;
+    RTSGBUF SgBuf;
+    Seg.pvSeg = pvBuf;
+    Seg.cbSeg = cbBuf;
+    RTSgBufInit(&SgBuf, &Seg, 1);
+    return vioscsiR3ChainCopy(pThis, paSegs, cSegs, offChain, &SgBuf, cbBuf, fToGuest);
+}
+
+/**
+ * Decodes the single level LUN structure used by virtio-scsi.
+ *
+ * @returns true if the address is valid, false otherwise.
+ * @param   pbLun       The 8 byte LUN structure.
+ * @param   piTarget    Where to return the target.
+ * @param   puLun       Where to return the LUN.
+ */
+static bool vioscsiR3DecodeLun(const uint8_t *pbLun, uint32_t *piTarget, uint32_t *puLun)
+{
+    if (pbLun[0] != 1)
+        return false;
+    *piTarget = pbLun[1];
+    *puLun    = ((uint32_t)(pbLun[2] & 0x3f) << 8) | pbLun[3];
+    return true;
+}
+
+/**
+ * Returns the target for the given LUN structure if it has a driver attached.
+ */
+static PVIOSCSITARGET vioscsiR3TargetFromLun(PVIOSCSISTATE pThis, const uint8_t *pbLun, uint32_t *puLun)
+{
+    uint32_t iTarget;
+    if (   vioscsiR3DecodeLun(pbLun, &iTarget, puLun)
+        && iTarget < pThis->cTargets
+        && pThis->paTargets[iTarget].pDrvBase)
+        return &pThis->paTargets[iTarget];
+    return NULL;
+}
+
+/**
+ * Puts a completed descriptor chain into the used ring of a request queue and
+ * notifies the guest.
+ *
+ * Completions arriving while the queue is processed are only added to the
+ * used ring, the guest gets a single notification at the end of the queue run.
+ *
+ * @param   pThis           The device state structure.
+ * @param   iReqQueue       Index of the request queue.
+ * @param   uHeadIdx        Head descriptor index of the chain.
+ * @param   uGen            Reset generation the chain was fetched in.
+ * @param   paSegs          The chain segments.
+ * @param   cSegs           Number of chain segments.
+ * @param   pResp           The response to write.
+ * @param   cbResp          Size of the response in the chain.
+ * @param   cbDataIn        Number of data bytes returned to the guest.
+ */
+static void vioscsiR3ReqChainComplete(PVIOSCSISTATE pThis, uint16_t iReqQueue, uint16_t uHeadIdx, uint16_t uGen,
+                                      PCVIOSCSISEG paSegs, uint32_t cSegs, VIOSCSIRESPCMD *pResp, uint32_t cbResp,
+                                      uint32_t cbDataIn)
+{
+    if (pResp->uResponse != VIRTIO_SCSI_S_OK)
+        STAM_REL_COUNTER_INC(&pThis->StatReqsFailed);
+
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    AssertRCReturnVoid(rc);
+
+    PVIOSCSIREQQUEUE pReqQueue = &pThis->aReqQueues[iReqQueue];
+    PVQUEUE          pQueue    = pReqQueue->pQueue;
+    if (   uGen == pThis->uGen
+        && vqueueIsReady(&pThis->VPCI, pQueue))
+    {
+        uint32_t cbUsed = 0;
+        if (vioscsiR3ChainSize(paSegs, cSegs, true /*fWrite*/) >= cbResp)
+        {
+            vioscsiR3ChainCopyBuf(pThis, paSegs, cSegs, 0, pResp, cbResp, true /*fToGuest*/);
+            cbUsed = cbResp + cbDataIn;
+        }
+        vringWriteUsedElem(&pThis->VPCI, &pQueue->VRing, pQueue->uNextUsedIndex++, uHeadIdx, cbUsed);
+        if (pReqQueue->fProcessing)
+        {
+            pReqQueue->cUsedPending++;
+            STAM_REL_COUNTER_INC(&pThis->StatCompletionsBatched);
+        }
+        else
+            vqueueSync(&pThis->VPCI, pQueue);
+    }
+    else
+        Log(("%s vioscsiR3ReqChainComplete: Dropping completion of stale chain %u\n", INSTANCE(pThis), uHeadIdx));
+
+    vpciCsLeave(&pThis->VPCI);
+}
+
+/**
+ * Completes a request, frees it and notifies the guest.
+ *
+ * @param   pThis       The device state structure.
+ * @param   pReq        The request to complete.
+ * @param   rcReq       The status code the request completed with.
+ */
+static void vioscsiR3ReqComplete(PVIOSCSISTATE pThis, PVIOSCSIREQ pReq, int rcReq)
+{
+    PVIOSCSITARGET pTarget = pReq->pTarget;
+    VIOSCSIRESPCMD Resp;
+    uint32_t       cbDataIn = 0;
+
+    RT_ZERO(Resp);
+    if (RT_SUCCESS(rcReq))
+    {
+        size_t cbResidual = 0;
+        int rc = pTarget->pDrvMediaEx->pfnIoReqQueryResidual(pTarget->pDrvMediaEx, pReq->hIoReq, &cbResidual);
+        if (RT_FAILURE(rc) || cbResidual > pReq->cbData)
+            cbResidual = 0;
+
+        Resp.uResponse  = VIRTIO_SCSI_S_OK;
+        Resp.uStatus    = pReq->u8ScsiSts;
+        Resp.cbResidual = (uint32_t)cbResidual;
+        if (pReq->enmTxDir == PDMMEDIAEXIOREQSCSITXDIR_FROM_DEVICE)
+            cbDataIn = pReq->cbData - (uint32_t)cbResidual;
+        if (pReq->u8ScsiSts == SCSI_STATUS_CHECK_CONDITION)
+        {
+            /* Fixed format sense data, the additional length says how much there is. */
+            uint32_t cbSense = RT_MIN(pReq->abSense[7] + 8U, pReq->cbResp - RT_UOFFSETOF(VIOSCSIRESPCMD, abSense));
+            memcpy(Resp.abSense, pReq->abSense, cbSense);
+            Resp.cbSense = cbSense;
+        }
+    }
+    else
+    {
+        Resp.uResponse  = VIRTIO_SCSI_S_FAILURE;
+        Resp.cbResidual = pReq->cbData;
+        LogRel(("%s: Request for target %u failed with %Rrc\n", INSTANCE(pThis), pTarget->iTarget, rcReq));
+    }
+
+    if (pReq->enmTxDir == PDMMEDIAEXIOREQSCSITXDIR_FROM_DEVICE)
+        vpciSetReadLed(&pThis->VPCI, false);
+    else if (pReq->enmTxDir == PDMMEDIAEXIOREQSCSITXDIR_TO_DEVICE)
+        vpciSetWriteLed(&pThis->VPCI, false);
+
+    vioscsiR3ReqChainComplete(pThis, pReq->iReqQueue, pReq->uHeadIdx, pReq->uGen, &pReq->aSegs[0], pReq->cSegs,
+                              &Resp, pReq->cbResp, cbDataIn);
+    pTarget->pDrvMediaEx->pfnIoReqFree(pTarget->pDrvMediaEx, pReq->hIoReq);
+
+    ASMAtomicDecU32(&pTarget->cReqsActive);
+    uint32_t cReqsActive = ASMAtomicDecU32(&pThis->cReqsActive);
+    if (!cReqsActive && pThis->fSignalIdle)
+        PDMDevHlpAsyncNotificationCompleted(pThis->VPCI.pDevInsR3);
+}
+
+/**
+ * Fetches the descriptor chain with the given head from a request queue,
+ * parses it and submits the command to the target.
+ *
+ * @param   pThis       The device state structure.
+ * @param   iReqQueue   Index of the request queue.
+ * @param   uHeadIdx    Head descriptor index of the chain.
+ */
+static void vioscsiR3ReqSubmit(PVIOSCSISTATE pThis, uint16_t iReqQueue, uint16_t uHeadIdx)
+{
+    PVQUEUE        pQueue = pThis->aReqQueues[iReqQueue].pQueue;
+    uint16_t const uGen   = pThis->uGen;
+    VIOSCSISEG     aSegs[VIOSCSI_QUEUE_SIZE];
+    uint32_t       cSegs  = 0;
+    VIOSCSIREQCMD  ReqHdr;
+    VIOSCSIRESPCMD Resp;
+
+    STAM_REL_COUNTER_INC(&pThis->StatReqs);
+    RT_ZERO(ReqHdr);
+    RT_ZERO(Resp);
+
+    /* Take the sizes the guest configured, the chain is laid out accordingly. */
+    uint32_t const cbReqHdr = RT_UOFFSETOF(VIOSCSIREQCMD, abCdb) + pThis->config.cbCdb;
+    uint32_t const cbResp   = RT_UOFFSETOF(VIOSCSIRESPCMD, abSense) + pThis->config.cbSense;
+
+    bool fValid = vioscsiR3ChainParse(pThis, pQueue, uHeadIdx, &aSegs[0], RT_ELEMENTS(aSegs), &cSegs);
+    uint32_t const cbOut = vioscsiR3ChainSize(&aSegs[0], cSegs, false /*fWrite*/);
+    uint32_t const cbIn  = vioscsiR3ChainSize(&aSegs[0], cSegs, true /*fWrite*/);
+    if (   !fValid
+        || cbOut < cbReqHdr
+        || cbIn < cbResp)
+    {
+        Log(("%s vioscsiR3ReqSubmit: Malformed request at %u\n", INSTANCE(pThis), uHeadIdx));
+        Resp.uResponse = VIRTIO_SCSI_S_FAILURE;
+        vioscsiR3ReqChainComplete(pThis, iReqQueue, uHeadIdx, uGen, &aSegs[0], cSegs, &Resp, cbResp, 0);
+        return;
+    }
+    vioscsiR3ChainCopyBuf(pThis, &aSegs[0], cSegs, 0, &ReqHdr, cbReqHdr, false /*fToGuest*/);
+
+    uint32_t       uLun    = 0;
+    PVIOSCSITARGET pTarget = vioscsiR3TargetFromLun(pThis, &ReqHdr.abLun[0], &uLun);
+    if (!pTarget)
+    {
+        STAM_REL_COUNTER_INC(&pThis->StatReqsBadTarget);
+        Resp.uResponse  = VIRTIO_SCSI_S_BAD_TARGET;
+        Resp.cbResidual = RT_MAX(cbOut - cbReqHdr, cbIn - cbResp);
+        vioscsiR3ReqChainComplete(pThis, iReqQueue, uHeadIdx, uGen, &aSegs[0], cSegs, &Resp, cbResp, 0);
+        return;
+    }
+
+    /* Bidirectional commands are not offered (VIRTIO_SCSI_F_INOUT). */
+    if (cbOut > cbReqHdr && cbIn > cbResp)
+    {
+        Resp.uResponse = VIRTIO_SCSI_S_FAILURE;
+        vioscsiR3ReqChainComplete(pThis, iReqQueue, uHeadIdx, uGen, &aSegs[0], cSegs, &Resp, cbResp, 0);
+        return;
+    }
+
+    PDMMEDIAEXIOREQ hIoReq = NULL;
+    PVIOSCSIREQ     pReq   = NULL;
+    int rc = pTarget->pDrvMediaEx->pfnIoReqAlloc(pTarget->pDrvMediaEx, &hIoReq, (void **)&pReq,
+                                                 ((PDMMEDIAEXIOREQID)uGen << 32) | ((uint32_t)iReqQueue << 16) | uHeadIdx,
+                                                 PDMIMEDIAEX_F_SUSPEND_ON_RECOVERABLE_ERR);
+    if (RT_FAILURE(rc))
+    {
+        Resp.uResponse = VIRTIO_SCSI_S_BUSY;
+        vioscsiR3ReqChainComplete(pThis, iReqQueue, uHeadIdx, uGen, &aSegs[0], cSegs, &Resp, cbResp, 0);
+        return;
+    }
+
+    pReq->hIoReq    = hIoReq;
+    pReq->pTarget   = pTarget;
+    pReq->uHeadIdx  = uHeadIdx;
+    pReq->uGen      = uGen;
+    pReq->iReqQueue = iReqQueue;
+    pReq->u8ScsiSts = SCSI_STATUS_OK;
+    pReq->cbReqHdr  = cbReqHdr;
+    pReq->cbResp    = cbResp;
+    pReq->cSegs     = cSegs;
+    memcpy(&pReq->aSegs[0], &aSegs[0], cSegs * sizeof(aSegs[0]));
+    memcpy(&pReq->abCdb[0], &ReqHdr.abCdb[0], sizeof(pReq->abCdb));
+    RT_ZERO(pReq->abSense);
+
+    if (cbOut > cbReqHdr)
+    {
+        pReq->enmTxDir = PDMMEDIAEXIOREQSCSITXDIR_TO_DEVICE;
+        pReq->cbData   = cbOut - cbReqHdr;
+        vpciSetWriteLed(&pThis->VPCI, true);
+    }
+    else if (cbIn > cbResp)
+    {
+        pReq->enmTxDir = PDMMEDIAEXIOREQSCSITXDIR_FROM_DEVICE;
+        pReq->cbData   = cbIn - cbResp;
+        vpciSetReadLed(&pThis->VPCI, true);
+    }
+    else
+    {
+        pReq->enmTxDir = PDMMEDIAEXIOREQSCSITXDIR_NONE;
+        pReq->cbData   = 0;
+    }
+
+    ASMAtomicIncU32(&pThis->cReqsActive);
+    ASMAtomicIncU32(&pTarget->cReqsActive);
+    rc = pTarget->pDrvMediaEx->pfnIoReqSendScsiCmd(pTarget->pDrvMediaEx, hIoReq, uLun,
+                                                   &pReq->abCdb[0], pThis->config.cbCdb,
+                                                   pReq->enmTxDir, pReq->cbData,
+                                                   &pReq->abSense[0], cbResp - RT_UOFFSETOF(VIOSCSIRESPCMD, abSense),
+                                                   &pReq->u8ScsiSts, 30 * RT_MS_1SEC);
+    if (rc != VINF_PDM_MEDIAEX_IOREQ_IN_PROGRESS)
+        vioscsiR3ReqComplete(pThis, pReq, rc);
+}
+
+/**
+ * Leaves the processing state of a request queue and publishes the completions
+ * gathered meanwhile.
+ */
+static void vioscsiR3ReqQueueFlushUsed(PVIOSCSISTATE pThis, PVIOSCSIREQQUEUE pReqQueue)
+{
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    AssertRCReturnVoid(rc);
+    pReqQueue->fProcessing = false;
+    if (pReqQueue->cUsedPending)
+    {
+        pReqQueue->cUsedPending = 0;
+        vqueueSync(&pThis->VPCI, pReqQueue->pQueue);
+    }
+    vpciCsLeave(&pThis->VPCI);
+}
+
+/**
+ * @callback_method_impl{FNVPCIQUEUECALLBACK,
+ *      Processes all requests the guest made available in a request queue.}
+ *
+ * Runs on the EMT kicking the queue with only the queue lock held, notifications
+ * are disabled while the queue is drained.
+ */
+static DECLCALLBACK(void) vioscsiR3ReqQueueNotify(void *pvState, PVQUEUE pQueue)
+{
+    PVIOSCSISTATE    pThis     = (PVIOSCSISTATE)pvState;
+    uint16_t const   iReqQueue = (uint16_t)(pQueue - &pThis->VPCI.Queues[VIOSCSI_QUEUE_REQ_FIRST]);
+    AssertReturnVoid(iReqQueue < pThis->cReqQueues);
+    PVIOSCSIREQQUEUE pReqQueue = &pThis->aReqQueues[iReqQueue];
+
+    int rc = PDMCritSectEnter(&pReqQueue->CritSect, VERR_SEM_BUSY);
+    AssertRCReturnVoid(rc);
+    STAM_REL_COUNTER_INC(&pReqQueue->StatKicks);
+
+    rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    if (RT_SUCCESS(rc))
+    {
+        pReqQueue->fProcessing = true;
+        vpciCsLeave(&pThis->VPCI);
+
+        vringSetNotification(&pThis->VPCI, &pQueue->VRing, false);
+        for (;;)
+        {
+            while (!vqueueIsEmpty(&pThis->VPCI, pQueue))
+            {
+                uint16_t uHeadIdx = vringReadAvail(&pThis->VPCI, &pQueue->VRing, pQueue->uNextAvailIndex++);
+                vioscsiR3ReqSubmit(pThis, iReqQueue, uHeadIdx);
+            }
+
+            /* Re-enable notifications and check again to close the race with the guest. */
+            vringSetNotification(&pThis->VPCI, &pQueue->VRing, true);
+            if (vqueueIsEmpty(&pThis->VPCI, pQueue))
+                break;
+            vringSetNotification(&pThis->VPCI, &pQueue->VRing, false);
+        }
+
+        vioscsiR3ReqQueueFlushUsed(pThis, pReqQueue);
+    }
+
+    PDMCritSectLeave(&pReqQueue->CritSect);
+}
+
+/**
+ * Delivers pending events to the guest as long as there are event buffers.
+ *
+ * @param   pThis       The device state structure.
+ * @remarks Caller must hold the device lock.
+ */
+static void vioscsiR3EventFlush(PVIOSCSISTATE pThis)
+{
+    PVQUEUE pQueue = pThis->pEventQueue;
+    bool    fSync  = false;
+
+    if (!vqueueIsReady(&pThis->VPCI, pQueue))
+        return;
+
+    while (   (pThis->cEvents || pThis->fEventsMissed)
+           && !vqueueIsEmpty(&pThis->VPCI, pQueue))
+    {
+        uint16_t   uHeadIdx = vringReadAvail(&pThis->VPCI, &pQueue->VRing, pQueue->uNextAvailIndex++);
+        VIOSCSISEG aSegs[VIOSCSI_CTRL_SEG_MAX];
+        uint32_t   cSegs    = 0;
+        uint32_t   cbUsed   = 0;
+
+        /* Re-arm before the loop checks for more buffers so none slips by unnoticed. */
+        vringSetNotification(&pThis->VPCI, &pQueue->VRing, true);
+
+        if (   vioscsiR3ChainParse(pThis, pQueue, uHeadIdx, &aSegs[0], RT_ELEMENTS(aSegs), &cSegs)
+            && vioscsiR3ChainSize(&aSegs[0], cSegs, true /*fWrite*/) >= sizeof(VIOSCSIEVENT))
+        {
+            VIOSCSIEVENT Event;
+            if (pThis->cEvents)
+            {
+                Event = pThis->aEvents[pThis->idxEventFirst];
+                pThis->idxEventFirst = (pThis->idxEventFirst + 1) % RT_ELEMENTS(pThis->aEvents);
+                pThis->cEvents--;
+            }
+            else
+                RT_ZERO(Event);
+            if (pThis->fEventsMissed)
+            {
+                Event.u32Event |= VIRTIO_SCSI_T_EVENTS_MISSED;
+                pThis->fEventsMissed = false;
+            }
+
+            vioscsiR3ChainCopyBuf(pThis, &aSegs[0], cSegs, 0, &Event, sizeof(Event), true /*fToGuest*/);
+            cbUsed = sizeof(Event);
+        }
+
+        vringWriteUsedElem(&pThis->VPCI, &pQueue->VRing, pQueue->uNextUsedIndex++, uHeadIdx, cbUsed);
+        fSync = true;
+    }
+
+    if (fSync)
+        vqueueSync(&pThis->VPCI, pQueue);
+}
+
+/**
+ * Queues an event for the guest and tries to deliver it.
+ *
+ * @param   pThis       The device state structure.
+ * @param   u32Event    The event (VIRTIO_SCSI_T_XXX).
+ * @param   iTarget     The target the event is about.
+ * @param   u32Reason   Event specific reason.
+ */
+static void vioscsiR3EventPost(PVIOSCSISTATE pThis, uint32_t u32Event, uint32_t iTarget, uint32_t u32Reason)
+{
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    AssertRCReturnVoid(rc);
+
+    if (pThis->VPCI.uGuestFeatures & VIRTIO_SCSI_F_HOTPLUG)
+    {
+        STAM_REL_COUNTER_INC(&pThis->StatEvents);
+        if (pThis->cEvents < RT_ELEMENTS(pThis->aEvents))
+        {
+            VIOSCSIEVENT *pEvent = &pThis->aEvents[(pThis->idxEventFirst + pThis->cEvents) % RT_ELEMENTS(pThis->aEvents)];
+            RT_ZERO(*pEvent);
+            pEvent->u32Event  = u32Event;
+            pEvent->abLun[0]  = 1;
+            pEvent->abLun[1]  = (uint8_t)iTarget;
+            pEvent->u32Reason = u32Reason;
+            pThis->cEvents++;
+        }
+        else
+        {
+            STAM_REL_COUNTER_INC(&pThis->StatEventsMissed);
+            pThis->fEventsMissed = true;
+        }
+        vioscsiR3EventFlush(pThis);
+    }
+
+    vpciCsLeave(&pThis->VPCI);
+}
+
+/**
+ * @callback_method_impl{FNVPCIQUEUECALLBACK,
+ *      The guest posted new event buffers.}
+ */
+static DECLCALLBACK(void) vioscsiR3EventQueueNotify(void *pvState, PVQUEUE pQueue)
+{
+    RT_NOREF(pQueue);
+    PVIOSCSISTATE pThis = (PVIOSCSISTATE)pvState;
+
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    if (RT_UNLIKELY(rc != VINF_SUCCESS))
+        return;
+    vioscsiR3EventFlush(pThis);
+    vpciCsLeave(&pThis->VPCI);
+}
+
+/**
+ * Processes a task management function request.
+ *
+ * @returns The response code.
+ * @param   pThis       The device state structure.
+ * @param   pTmf        The request.
+ */
+static uint8_t vioscsiR3CtrlTmf(PVIOSCSISTATE pThis, const VIOSCSICTRLTMF *pTmf)
+{
+    STAM_REL_COUNTER_INC(&pThis->StatTmf);
+
+    uint32_t       uLun    = 0;
+    PVIOSCSITARGET pTarget = vioscsiR3TargetFromLun(pThis, &pTmf->abLun[0], &uLun);
+    if (!pTarget)
+        return VIRTIO_SCSI_S_BAD_TARGET;
+
+    switch (pTmf->u32Subtype)
+    {
+        case VIRTIO_SCSI_T_TMF_ABORT_TASK_SET:
+        case VIRTIO_SCSI_T_TMF_CLEAR_TASK_SET:
+        case VIRTIO_SCSI_T_TMF_I_T_NEXUS_RESET:
+        case VIRTIO_SCSI_T_TMF_LOGICAL_UNIT_RESET:
+            LogRel(("%s: Task management function %u for target %u, cancelling all requests\n",
+                    INSTANCE(pThis), pTmf->u32Subtype, pTarget->iTarget));
+            pTarget->pDrvMediaEx->pfnIoReqCancelAll(pTarget->pDrvMediaEx);
+            return VIRTIO_SCSI_S_OK;
+
+        case VIRTIO_SCSI_T_TMF_QUERY_TASK_SET:
+            return pTarget->cReqsActive ? VIRTIO_SCSI_S_FUNCTION_SUCCEEDED : VIRTIO_SCSI_S_OK;
+
+        case VIRTIO_SCSI_T_TMF_CLEAR_ACA:
+            return VIRTIO_SCSI_S_OK;
+
+        default:
+            /* Individual tasks cannot be addressed, the guest escalates to a LUN reset. */
+            return VIRTIO_SCSI_S_FUNCTION_REJECTED;
+    }
+}
+
+/**
+ * @callback_method_impl{FNVPCIQUEUECALLBACK,
+ *      Processes task management and asynchronous notification requests.}
+ */
+static DECLCALLBACK(void) vioscsiR3CtrlQueueNotify(void *pvState, PVQUEUE pQueue)
+{
+    PVIOSCSISTATE pThis = (PVIOSCSISTATE)pvState;
+
+    int rc = vpciCsEnter(&pThis->VPCI, VERR_SEM_BUSY);
+    if (RT_UNLIKELY(rc != VINF_SUCCESS))
+        return;
+
+    bool fSync = false;
+    while (!vqueueIsEmpty(&pThis->VPCI, pQueue))
+    {
+        uint16_t   uHeadIdx = vringReadAvail(&pThis->VPCI, &pQueue->VRing, pQueue->uNextAvailIndex++);
+        VIOSCSISEG aSegs[VIOSCSI_CTRL_SEG_MAX];
+        uint32_t   cSegs    = 0;
+        uint32_t   cbUsed   = 0;
+
+        /* Re-arm before the loop checks for more buffers so none slips by unnoticed. */
+        vringSetNotification(&pThis->VPCI, &pQueue->VRing, true);
+
+        if (vioscsiR3ChainParse(pThis, pQueue, uHeadIdx, &aSegs[0], RT_ELEMENTS(aSegs), &cSegs))
+        {
+            union
+            {
+                uint32_t        u32Type;
+                VIOSCSICTRLTMF  Tmf;
+                VIOSCSICTRLAN   An;
+            } uReq;
+            RT_ZERO(uReq);
+            size_t const cbReq = vioscsiR3ChainCopyBuf(pThis, &aSegs[0], cSegs, 0, &uReq, sizeof(uReq), false /*fToGuest*/);
+            uint32_t const cbIn = vioscsiR3ChainSize(&aSegs[0], cSegs, true /*fWrite*/);
+
+            if (uReq.u32Type == VIRTIO_SCSI_T_TMF)
+            {
+                uint8_t uResponse = cbReq >= sizeof(uReq.Tmf) ? vioscsiR3CtrlTmf(pThis, &uReq.Tmf) : VIRTIO_SCSI_S_FAILURE;
+                if (cbIn >= sizeof(uResponse))
+                {
+                    vioscsiR3ChainCopyBuf(pThis, &aSegs[0], cSegs, 0, &uResponse, sizeof(uResponse), true /*fToGuest*/);
+                    cbUsed = sizeof(uResponse);
+                }
+            }
+            else if (   uReq.u32Type == VIRTIO_SCSI_T_AN_QUERY
+                     || uReq.u32Type == VIRTIO_SCSI_T_AN_SUBSCRIBE)
+            {
+                /* No asynchronous notifications are supported. */
+                VIOSCSICTRLANRESP Resp;
+                Resp.fEventsActual = 0;
+                Resp.uResponse     = cbReq >= sizeof(uReq.An) ? VIRTIO_SCSI_S_OK : VIRTIO_SCSI_S_FAILURE;
+                if (cbIn >= sizeof(Resp))
+                {
+                    vioscsiR3ChainCopyBuf(pThis, &aSegs[0], cSegs, 0, &Resp, sizeof(Resp), true /*fToGuest*/);
+                    cbUsed = sizeof(Resp);
+                }
+            }
+            else
+                Log(("%s vioscsiR3CtrlQueueNotify: Unknown control request type %u\n", INSTANCE(pThis), uReq.u32Type));
+        }
+
+        vringWriteUsedElem(&pThis->VPCI, &pQueue->VRing, pQueue->uNextUsedIndex++, uHeadIdx, cbUsed);
+        fSync = true;
+    }
+
+    if (fSync)
+        vqueueSync(&pThis->VPCI, pQueue);
+    vpciCsLeave(&pThis->VPCI);
+}
+
+
+/* -=-=-=-=- PDMIMEDIAPORT / PDMIMEDIAEXPORT -=-=-=-=- */
+
+/**
+ * @interface_method_impl{PDMIMEDIAPORT,pfnQueryDeviceLocation}
+ */
+static DECLCALLBACK(int) vioscsiR3QueryDeviceLocation(PPDMIMEDIAPORT pInterface, const char **ppcszController,
+                                                      uint32_t *piInstance, uint32_t *piLUN)
+{
+    PVIOSCSITARGET pTarget = RT_FROM_MEMBER(pInterface, VIOSCSITARGET, IMediaPort);
+    PPDMDEVINS     pDevIns = pTarget->pVioScsiR3->VPCI.pDevInsR3;
+
+    AssertPtrReturn(ppcszController, VERR_INVALID_POINTER);
+    AssertPtrReturn(piInstance, VERR_INVALID_POINTER);
+    AssertPtrReturn(piLUN, VERR_INVALID_POINTER);
+
+    *ppcszController = pDevIns->pReg->szName;
+    *piInstance = pDevIns->iInstance;
+    *piLUN = pTarget->iTarget;
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCopyFromBuf}
+ */
+static DECLCALLBACK(int) vioscsiR3IoReqCopyFromBuf(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                   void *pvIoReqAlloc, uint32_t offDst, PRTSGBUF pSgBuf,
+                                                   size_t cbCopy)
+{
+    RT_NOREF1(hIoReq);
+    PVIOSCSITARGET pTarget = RT_FROM_MEMBER(pInterface, VIOSCSITARGET, IMediaExPort);
+    PVIOSCSIREQ    pReq    = (PVIOSCSIREQ)pvIoReqAlloc;
+
+    if (offDst + cbCopy > pReq->cbData)
+        return VERR_PDM_MEDIAEX_IOBUF_OVERFLOW;
+    size_t cbCopied = vioscsiR3ChainCopy(pTarget->pVioScsiR3, &pReq->aSegs[0], pReq->cSegs, pReq->cbResp + offDst,
+                                         pSgBuf, cbCopy, true /*fToGuest*/);
+    return cbCopied == cbCopy ? VINF_SUCCESS : VERR_PDM_MEDIAEX_IOBUF_OVERFLOW;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCopyToBuf}
+ */
+static DECLCALLBACK(int) vioscsiR3IoReqCopyToBuf(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                 void *pvIoReqAlloc, uint32_t offSrc, PRTSGBUF pSgBuf,
+                                                 size_t cbCopy)
+{
+    RT_NOREF1(hIoReq);
+    PVIOSCSITARGET pTarget = RT_FROM_MEMBER(pInterface, VIOSCSITARGET, IMediaExPort);
+    PVIOSCSIREQ    pReq    = (PVIOSCSIREQ)pvIoReqAlloc;
+
+    if (offSrc + cbCopy > pReq->cbData)
+        return VERR_PDM_MEDIAEX_IOBUF_UNDERRUN;
+    size_t cbCopied = vioscsiR3ChainCopy(pTarget->pVioScsiR3, &pReq->aSegs[0], pReq->cSegs, pReq->cbReqHdr + offSrc,
+                                         pSgBuf, cbCopy, false /*fToGuest*/);
+    return cbCopied == cbCopy ? VINF_SUCCESS : VERR_PDM_MEDIAEX_IOBUF_UNDERRUN;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqCompleteNotify}
+ */
+static DECLCALLBACK(int) vioscsiR3IoReqCompleteNotify(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                      void *pvIoReqAlloc, int rcReq)
+{
+    RT_NOREF(hIoReq);
+    PVIOSCSITARGET pTarget = RT_FROM_MEMBER(pInterface, VIOSCSITARGET, IMediaExPort);
+    vioscsiR3ReqComplete(pTarget->pVioScsiR3, (PVIOSCSIREQ)pvIoReqAlloc, rcReq);
+    return VINF_SUCCESS;
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnIoReqStateChanged}
+ */
+static DECLCALLBACK(void) vioscsiR3IoReqStateChanged(PPDMIMEDIAEXPORT pInterface, PDMMEDIAEXIOREQ hIoReq,
+                                                     void *pvIoReqAlloc, PDMMEDIAEXIOREQSTATE enmState)
+{
+    RT_NOREF2(hIoReq, pvIoReqAlloc);
+    PVIOSCSITARGET pTarget = RT_FROM_MEMBER(pInterface, VIOSCSITARGET, IMediaExPort);
+    PVIOSCSISTATE  pThis   = pTarget->pVioScsiR3;
+
+    switch (enmState)
+    {
+        case PDMMEDIAEXIOREQSTATE_SUSPENDED:
+        {
+            /* Make sure the request is not accounted for so the VM can suspend successfully. */
+            uint32_t cReqsActive = ASMAtomicDecU32(&pThis->cReqsActive);
+            if (!cReqsActive && pThis->fSignalIdle)
+                PDMDevHlpAsyncNotificationCompleted(pThis->VPCI.pDevInsR3);
+            break;
+        }
+        case PDMMEDIAEXIOREQSTATE_ACTIVE:
+            /* Make sure the request is accounted for so the VM suspends only when the request is complete. */
+            ASMAtomicIncU32(&pThis->cReqsActive);
+            break;
+        default:
+            AssertMsgFailed(("Invalid request state given %u\n", enmState));
+    }
+}
+
+/**
+ * @interface_method_impl{PDMIMEDIAEXPORT,pfnMediumEjected}
+ */
+static DECLCALLBACK(void) vioscsiR3MediumEjected(PPDMIMEDIAEXPORT pInterface)
+{
+    PVIOSCSITARGET pTarget = RT_FROM_MEMBER(pInterface, VIOSCSITARGET, IMediaExPort);
+    /* Let the guest rescan the target, the LUN itself reports the medium change through sense data. */
+    vioscsiR3EventPost(pTarget->pVioScsiR3, VIRTIO_SCSI_T_TRANSPORT_RESET, pTarget->iTarget, VIRTIO_SCSI_EVT_RESET_RESCAN);
+}
+
+/**
+ * @interface_method_impl{PDMIBASE,pfnQueryInterface, For targets.}
+ */
+static DECLCALLBACK(void *) vioscsiR3TargetQueryInterface(PPDMIBASE pInterface, const char *pszIID)
+{
+    PVIOSCSITARGET pTarget = RT_FROM_MEMBER(pInterface, VIOSCSITARGET, IBase);
+
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIBASE, &pTarget->IBase);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIMEDIAPORT, &pTarget->IMediaPort);
+    PDMIBASE_RETURN_INTERFACE(pszIID, PDMIMEDIAEXPORT, &pTarget->IMediaExPort);
+    return NULL;
+}
+
+
+/* -=-=-=-=- Saved State -=-=-=-=- */
+
+/**
+ * Saves the configuration.
+ *
+ * @param   pThis      The device state.
+ * @param   pSSM        The handle to the saved state.
+ */
+static void vioscsiR3SaveConfig(PVIOSCSISTATE pThis, PSSMHANDLE pSSM)
+{
+    SSMR3PutU32(pSSM, pThis->cReqQueues);
+    SSMR3PutU32(pSSM, pThis->cTargets);
+    for (uint32_t i = 0; i < pThis->cTargets; i++)
+        SSMR3PutBool(pSSM, pThis->paTargets[i].pDrvBase != NULL);
+}
+
+/**
+ * @callback_method_impl{FNSSMDEVLIVEEXEC}
+ */
+static DECLCALLBACK(int) vioscsiR3LiveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint32_t uPass)
+{
+    RT_NOREF(uPass);
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+    vioscsiR3SaveConfig(pThis, pSSM);
+    return VINF_SSM_DONT_CALL_AGAIN;
+}
+
+/**
+ * @callback_method_impl{FNSSMDEVSAVEEXEC}
+ */
+static DECLCALLBACK(int) vioscsiR3SaveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+
+    vioscsiR3SaveConfig(pThis, pSSM);
+
+    int rc = vpciSaveExec(&pThis->VPCI, pSSM);
+    AssertRCReturn(rc, rc);
+
+    SSMR3PutU32(pSSM, pThis->config.cbSense);
+    SSMR3PutU32(pSSM, pThis->config.cbCdb);
+
+    /* Pending events. */
+    SSMR3PutBool(pSSM, pThis->fEventsMissed);
+    SSMR3PutU32(pSSM, pThis->cEvents);
+    for (uint32_t i = 0; i < pThis->cEvents; i++)
+        SSMR3PutMem(pSSM, &pThis->aEvents[(pThis->idxEventFirst + i) % RT_ELEMENTS(pThis->aEvents)], sizeof(VIOSCSIEVENT));
+
+    /*
+     * Save the queue and head of the requests suspended because of a recoverable
+     * error, they are resubmitted from the still intact descriptor chains on resume.
+     */
+    uint32_t cReqsSuspended = pThis->cReqsRestored;
+    for (uint32_t i = 0; i < pThis->cTargets; i++)
+        if (pThis->paTargets[i].pDrvMediaEx)
+            cReqsSuspended += pThis->paTargets[i].pDrvMediaEx->pfnIoReqGetSuspendedCount(pThis->paTargets[i].pDrvMediaEx);
+    SSMR3PutU32(pSSM, cReqsSuspended);
+
+    for (uint32_t i = 0; i < pThis->cTargets; i++)
+    {
+        PPDMIMEDIAEX pDrvMediaEx = pThis->paTargets[i].pDrvMediaEx;
+        if (!pDrvMediaEx)
+            continue;
+
+        uint32_t cReqs = pDrvMediaEx->pfnIoReqGetSuspendedCount(pDrvMediaEx);
+        if (cReqs)
+        {
+            PDMMEDIAEXIOREQ hIoReq;
+            PVIOSCSIREQ     pReq;
+            rc = pDrvMediaEx->pfnIoReqQuerySuspendedStart(pDrvMediaEx, &hIoReq, (void **)&pReq);
+            AssertRCReturn(rc, rc);
+            for (;;)
+            {
+                SSMR3PutU32(pSSM, ((uint32_t)pReq->iReqQueue << 16) | pReq->uHeadIdx);
+                if (!--cReqs)
+                    break;
+                rc = pDrvMediaEx->pfnIoReqQuerySuspendedNext(pDrvMediaEx, hIoReq, &hIoReq, (void **)&pReq);
+                AssertRCReturn(rc, rc);
+            }
+        }
+    }
+    for (uint32_t i = 0; i < pThis->cReqsRestored; i++)
+        SSMR3PutU32(pSSM, pThis->pau32ReqsRestored[i]);
+
+    return SSMR3PutU32(pSSM, UINT32_MAX); /* terminator */
+}
+
+/**
+ * @callback_method_impl{FNSSMDEVLOADEXEC}
+ */
+static DECLCALLBACK(int) vioscsiR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t uPass)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+    int           rc;
+
+    if (   uVersion != VIOSCSI_SAVED_STATE_VERSION
+        && uVersion != VIOSCSI_SAVED_STATE_VERSION_LEGACY)
+        return VERR_SSM_UNSUPPORTED_DATA_UNIT_VERSION;
+
+    /* config checks */
+    uint32_t cReqQueues, cTargets;
+    rc = SSMR3GetU32(pSSM, &cReqQueues);
+    AssertRCReturn(rc, rc);
+    rc = SSMR3GetU32(pSSM, &cTargets);
+    AssertRCReturn(rc, rc);
+    if (cReqQueues != pThis->cReqQueues)
+        return SSMR3SetCfgError(pSSM, RT_SRC_POS, N_("Config mismatch - NumQueues: saved=%u config=%u"),
+                                cReqQueues, pThis->cReqQueues);
+    if (cTargets != pThis->cTargets)
+        return SSMR3SetCfgError(pSSM, RT_SRC_POS, N_("Config mismatch - NumTargets: saved=%u config=%u"),
+                                cTargets, pThis->cTargets);
+    for (uint32_t i = 0; i < pThis->cTargets; i++)
+    {
+        bool fPresent;
+        rc = SSMR3GetBool(pSSM, &fPresent);
+        AssertRCReturn(rc, rc);
+        if (fPresent != (pThis->paTargets[i].pDrvBase != NULL))
+            return SSMR3SetCfgError(pSSM, RT_SRC_POS, N_("Target %u config mismatch: config=%RTbool state=%RTbool"),
+                                    i, pThis->paTargets[i].pDrvBase != NULL, fPresent);
+    }
+
+    /* The virtio core saved state version is independent of ours. */
+    rc = vpciLoadExec(&pThis->VPCI, pSSM,
+                      uVersion == VIOSCSI_SAVED_STATE_VERSION ? VIRTIO_SAVEDSTATE_VERSION : VIRTIO_SAVEDSTATE_VERSION_LEGACY,
+                      uPass, VIOSCSI_QUEUE_REQ_FIRST + pThis->cReqQueues);
+    AssertRCReturn(rc, rc);
+
+    if (uPass == SSM_PASS_FINAL)
+    {
+        SSMR3GetU32(pSSM, &pThis->config.cbSense);
+        SSMR3GetU32(pSSM, &pThis->config.cbCdb);
+        pThis->config.cbSense = RT_MIN(pThis->config.cbSense, VIOSCSI_SENSE_SIZE_MAX);
+        pThis->config.cbCdb   = RT_MIN(pThis->config.cbCdb, VIOSCSI_CDB_SIZE_MAX);
+
+        SSMR3GetBool(pSSM, &pThis->fEventsMissed);
+        uint32_t cEvents;
+        rc = SSMR3GetU32(pSSM, &cEvents);
+        AssertRCReturn(rc, rc);
+        AssertLogRelMsgReturn(cEvents <= RT_ELEMENTS(pThis->aEvents), ("%u\n", cEvents), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+        pThis->idxEventFirst = 0;
+        pThis->cEvents       = cEvents;
+        for (uint32_t i = 0; i < cEvents; i++)
+            SSMR3GetMem(pSSM, &pThis->aEvents[i], sizeof(VIOSCSIEVENT));
+
+        uint32_t cReqs;
+        rc = SSMR3GetU32(pSSM, &cReqs);
+        AssertRCReturn(rc, rc);
+        AssertLogRelMsgReturn(cReqs <= VIOSCSI_QUEUE_SIZE * pThis->cReqQueues, ("%u\n", cReqs),
+                              VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+
+        RTMemFree(pThis->pau32ReqsRestored);
+        pThis->pau32ReqsRestored = NULL;
+        pThis->cReqsRestored     = 0;
+        if (cReqs)
+        {
+            pThis->pau32ReqsRestored = (uint32_t *)RTMemAllocZ(cReqs * sizeof(uint32_t));
+            if (!pThis->pau32ReqsRestored)
+                return VERR_NO_MEMORY;
+            for (uint32_t i = 0; i < cReqs; i++)
+            {
+                rc = SSMR3GetU32(pSSM, &pThis->pau32ReqsRestored[i]);
+                AssertRCReturn(rc, rc);
+                AssertLogRelMsgReturn((pThis->pau32ReqsRestored[i] >> 16) < pThis->cReqQueues,
+                                      ("%#x\n", pThis->pau32ReqsRestored[i]), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+            }
+            pThis->cReqsRestored = cReqs;
+        }
+
+        uint32_t u32;
+        rc = SSMR3GetU32(pSSM, &u32);
+        AssertRCReturn(rc, rc);
+        AssertLogRelMsgReturn(u32 == UINT32_MAX, ("%#x\n", u32), VERR_SSM_DATA_UNIT_FORMAT_CHANGED);
+    }
+
+    return rc;
+}
+
+
+/* -=-=-=-=- PCI Device -=-=-=-=- */
+
+/**
+ * @callback_method_impl{FNPCIIOREGIONMAP}
+ */
+static DECLCALLBACK(int) vioscsiR3Map(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, uint32_t iRegion,
+                                      RTGCPHYS GCPhysAddress, RTGCPHYS cb, PCIADDRESSSPACE enmType)
+{
+    RT_NOREF(pPciDev, iRegion);
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+    int           rc;
+
+    if (enmType != PCI_ADDRESS_SPACE_IO)
+    {
+        /* We should never get here */
+        AssertMsgFailed(("Invalid PCI address space param in map callback"));
+        return VERR_INTERNAL_ERROR;
+    }
+
+    pThis->VPCI.IOPortBase = (RTIOPORT)GCPhysAddress;
+    rc = PDMDevHlpIOPortRegister(pDevIns, pThis->VPCI.IOPortBase,
+                                 cb, 0, vioscsiIOPortOut, vioscsiIOPortIn,
+                                 NULL, NULL, "VirtioSCSI");
+    AssertRCReturn(rc, rc);
+    rc = PDMDevHlpIOPortRegisterR0(pDevIns, pThis->VPCI.IOPortBase,
+                                   cb, 0, "vioscsiIOPortOut", "vioscsiIOPortIn",
+                                   NULL, NULL, "VirtioSCSI");
+    AssertRC(rc);
+    return rc;
+}
+
+
+/* -=-=-=-=- PDMDEVREG -=-=-=-=- */
+
+/**
+ * Callback employed by vioscsiR3Suspend and vioscsiR3PowerOff.
+ *
+ * @returns true if we've quiesced, false if we're still working.
+ * @param   pDevIns     The device instance.
+ */
+static DECLCALLBACK(bool) vioscsiR3IsAsyncSuspendOrPowerOffDone(PPDMDEVINS pDevIns)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+    if (pThis->cReqsActive)
+        return false;
+
+    ASMAtomicWriteBool(&pThis->fSignalIdle, false);
+    return true;
+}
+
+/**
+ * Common worker for vioscsiR3Suspend and vioscsiR3PowerOff.
+ */
+static void vioscsiR3SuspendOrPowerOff(PPDMDEVINS pDevIns)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+
+    ASMAtomicWriteBool(&pThis->fSignalIdle, true);
+    if (pThis->cReqsActive)
+        PDMDevHlpSetAsyncNotification(pDevIns, vioscsiR3IsAsyncSuspendOrPowerOffDone);
+    else
+        ASMAtomicWriteBool(&pThis->fSignalIdle, false);
+
+    for (uint32_t i = 0; i < pThis->cTargets; i++)
+        if (pThis->paTargets[i].pDrvMediaEx)
+            pThis->paTargets[i].pDrvMediaEx->pfnNotifySuspend(pThis->paTargets[i].pDrvMediaEx);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnSuspend}
+ */
+static DECLCALLBACK(void) vioscsiR3Suspend(PPDMDEVINS pDevIns)
+{
+    Log(("vioscsiR3Suspend\n"));
+    vioscsiR3SuspendOrPowerOff(pDevIns);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnPowerOff}
+ */
+static DECLCALLBACK(void) vioscsiR3PowerOff(PPDMDEVINS pDevIns)
+{
+    Log(("vioscsiR3PowerOff\n"));
+    vioscsiR3SuspendOrPowerOff(pDevIns);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnResume}
+ */
+static DECLCALLBACK(void) vioscsiR3Resume(PPDMDEVINS pDevIns)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+
+    if (pThis->cReqsRestored)
+    {
+        Log(("%s Resubmitting %u restored requests\n", INSTANCE(pThis), pThis->cReqsRestored));
+        for (uint32_t i = 0; i < pThis->cReqsRestored; i++)
+        {
+            uint16_t const   iReqQueue = (uint16_t)(pThis->pau32ReqsRestored[i] >> 16);
+            PVIOSCSIREQQUEUE pReqQueue = &pThis->aReqQueues[iReqQueue];
+
+            PDMCritSectEnter(&pReqQueue->CritSect, VERR_IGNORED);
+            vioscsiR3ReqSubmit(pThis, iReqQueue, (uint16_t)pThis->pau32ReqsRestored[i]);
+            PDMCritSectLeave(&pReqQueue->CritSect);
+        }
+
+        RTMemFree(pThis->pau32ReqsRestored);
+        pThis->pau32ReqsRestored = NULL;
+        pThis->cReqsRestored     = 0;
+    }
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnReset}
+ */
+static DECLCALLBACK(void) vioscsiR3Reset(PPDMDEVINS pDevIns)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+
+    RTMemFree(pThis->pau32ReqsRestored);
+    pThis->pau32ReqsRestored = NULL;
+    pThis->cReqsRestored     = 0;
+    vioscsiIoCb_Reset(pThis);
+}
+
+/**
+ * Attaches the driver of a target and queries its interfaces.
+ *
+ * @returns VBox status code.
+ * @param   pDevIns     The device instance.
+ * @param   pTarget     The target.
+ * @param   pszDesc     Description of the LUN, NULL if hot-plugged.
+ */
+static int vioscsiR3TargetAttach(PPDMDEVINS pDevIns, PVIOSCSITARGET pTarget, const char *pszDesc)
+{
+    int rc = PDMDevHlpDriverAttach(pDevIns, pTarget->iTarget, &pTarget->IBase, &pTarget->pDrvBase, pszDesc);
+    if (RT_SUCCESS(rc))
+    {
+        pTarget->pDrvMedia = PDMIBASE_QUERY_INTERFACE(pTarget->pDrvBase, PDMIMEDIA);
+        AssertMsgReturn(VALID_PTR(pTarget->pDrvMedia),
+                        ("VirtioSCSI configuration error: LUN#%d misses the basic media interface!\n", pTarget->iTarget),
+                        VERR_PDM_MISSING_INTERFACE);
+
+        pTarget->pDrvMediaEx = PDMIBASE_QUERY_INTERFACE(pTarget->pDrvBase, PDMIMEDIAEX);
+        AssertMsgReturn(VALID_PTR(pTarget->pDrvMediaEx),
+                        ("VirtioSCSI configuration error: LUN#%d misses the extended media interface!\n", pTarget->iTarget),
+                        VERR_PDM_MISSING_INTERFACE);
+
+        rc = pTarget->pDrvMediaEx->pfnIoReqAllocSizeSet(pTarget->pDrvMediaEx, sizeof(VIOSCSIREQ));
+        AssertMsgRCReturn(rc, ("VirtioSCSI configuration error: LUN#%u: Failed to set I/O request size!\n", pTarget->iTarget),
+                          rc);
+    }
+
+    if (RT_FAILURE(rc))
+    {
+        pTarget->pDrvBase    = NULL;
+        pTarget->pDrvMedia   = NULL;
+        pTarget->pDrvMediaEx = NULL;
+    }
+    return rc;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnDetach}
+ *
+ * The guest learns about hot-unplugged targets through a transport reset event.
+ */
+static DECLCALLBACK(void) vioscsiR3Detach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t fFlags)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+    AssertReturnVoid(iLUN < pThis->cTargets);
+    PVIOSCSITARGET pTarget = &pThis->paTargets[iLUN];
+
+    Log(("%s vioscsiR3Detach: LUN#%u\n", INSTANCE(pThis), iLUN));
+
+    /*
+     * Zero some important members.
+     */
+    pTarget->pDrvBase    = NULL;
+    pTarget->pDrvMedia   = NULL;
+    pTarget->pDrvMediaEx = NULL;
+
+    if (!(fFlags & PDM_TACH_FLAGS_NOT_HOT_PLUG))
+        vioscsiR3EventPost(pThis, VIRTIO_SCSI_T_TRANSPORT_RESET, iLUN, VIRTIO_SCSI_EVT_RESET_REMOVED);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnAttach}
+ *
+ * The guest learns about hot-plugged targets through a transport reset event.
+ */
+static DECLCALLBACK(int) vioscsiR3Attach(PPDMDEVINS pDevIns, unsigned iLUN, uint32_t fFlags)
+{
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+    if (iLUN >= pThis->cTargets)
+        return VERR_PDM_LUN_NOT_FOUND;
+    PVIOSCSITARGET pTarget = &pThis->paTargets[iLUN];
+
+    LogFlow(("%s vioscsiR3Attach: LUN#%u\n", INSTANCE(pThis), iLUN));
+
+    /* the usual paranoia */
+    AssertRelease(!pTarget->pDrvBase);
+    AssertRelease(!pTarget->pDrvMedia);
+    AssertRelease(!pTarget->pDrvMediaEx);
+    Assert(pTarget->iTarget == iLUN);
+
+    int rc = vioscsiR3TargetAttach(pDevIns, pTarget, NULL);
+    if (   RT_SUCCESS(rc)
+        && !(fFlags & PDM_TACH_FLAGS_NOT_HOT_PLUG))
+        vioscsiR3EventPost(pThis, VIRTIO_SCSI_T_TRANSPORT_RESET, iLUN, VIRTIO_SCSI_EVT_RESET_RESCAN);
+    return rc;
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnRelocate}
+ */
+static DECLCALLBACK(void) vioscsiR3Relocate(PPDMDEVINS pDevIns, RTGCINTPTR offDelta)
+{
+    vpciRelocate(pDevIns, offDelta);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnDestruct}
+ */
+static DECLCALLBACK(int) vioscsiR3Destruct(PPDMDEVINS pDevIns)
+{
+    PDMDEV_CHECK_VERSIONS_RETURN_QUIET(pDevIns);
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+
+    Log(("%s Destroying instance\n", INSTANCE(pThis)));
+    for (uint32_t i = 0; i < pThis->cReqQueues; i++)
+        if (PDMCritSectIsInitialized(&pThis->aReqQueues[i].CritSect))
+            PDMR3CritSectDelete(&pThis->aReqQueues[i].CritSect);
+
+    RTMemFree(pThis->paTargets);
+    pThis->paTargets = NULL;
+    RTMemFree(pThis->pau32ReqsRestored);
+    pThis->pau32ReqsRestored = NULL;
+    pThis->cReqsRestored     = 0;
+
+    return vpciDestruct(&pThis->VPCI);
+}
+
+/**
+ * @interface_method_impl{PDMDEVREG,pfnConstruct}
+ */
+static DECLCALLBACK(int) vioscsiR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFGMNODE pCfg)
+{
+    PDMDEV_CHECK_VERSIONS_RETURN(pDevIns);
+    PVIOSCSISTATE pThis = PDMINS_2_DATA(pDevIns, PVIOSCSISTATE);
+    int           rc;
+
+    /*
+     * Validate and read configuration.
+     */
+    if (!CFGMR3AreValuesValid(pCfg, "NumCPUs\0" "NumQueues\0" "NumTargets\0"))
+        return PDMDEV_SET_ERROR(pDevIns, VERR_PDM_DEVINS_UNKNOWN_CFG_VALUES, N_("Invalid configuration for VirtioSCSI device"));
+
+    /** @cfgm{/Devices/virtio-scsi/0/Config/NumCPUs, uint32_t, 1}
+     * Number of guest CPUs, used as the default number of request queues. */
+    uint32_t cCpus;
+    rc = CFGMR3QueryU32Def(pCfg, "NumCPUs", &cCpus, 1);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("Configuration error: Querying \"NumCPUs\" as integer failed"));
+
+    /** @cfgm{/Devices/virtio-scsi/0/Config/NumQueues, uint32_t, NumCPUs}
+     * Number of request queues, the guest driver assigns one to every vCPU.
+     * Capped at 16. */
+    rc = CFGMR3QueryU32Def(pCfg, "NumQueues", &pThis->cReqQueues, RT_MIN(cCpus, VIOSCSI_REQ_QUEUES_MAX));
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("Configuration error: Querying \"NumQueues\" as integer failed"));
+    if (!pThis->cReqQueues || pThis->cReqQueues > VIOSCSI_REQ_QUEUES_MAX)
+        return PDMDevHlpVMSetError(pDevIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("Configuration error: \"NumQueues\" must be between 1 and %u"), VIOSCSI_REQ_QUEUES_MAX);
+
+    /** @cfgm{/Devices/virtio-scsi/0/Config/NumTargets, uint32_t, 16}
+     * Number of targets, each one is a LUN of the device instance. */
+    rc = CFGMR3QueryU32Def(pCfg, "NumTargets", &pThis->cTargets, 16);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("Configuration error: Querying \"NumTargets\" as integer failed"));
+    if (!pThis->cTargets || pThis->cTargets > VIOSCSI_TARGETS_MAX)
+        return PDMDevHlpVMSetError(pDevIns, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                   N_("Configuration error: \"NumTargets\" must be between 1 and %u"), VIOSCSI_TARGETS_MAX);
+
+    /* Do our own locking. */
+    rc = PDMDevHlpSetDeviceCritSect(pDevIns, PDMDevHlpCritSectGetNop(pDevIns));
+    AssertRCReturn(rc, rc);
+
+    /* Initialize PCI part. */
+    rc = vpciConstruct(pDevIns, &pThis->VPCI, iInstance,
+                       VIOSCSI_NAME_FMT, VIRTIO_SCSI_ID,
+                       VIOSCSI_PCI_CLASS, VIOSCSI_QUEUE_REQ_FIRST + pThis->cReqQueues);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    Log(("%s Constructing new instance\n", INSTANCE(pThis)));
+
+    pThis->pCtrlQueue  = vpciAddQueue(&pThis->VPCI, VIOSCSI_QUEUE_SIZE, vioscsiR3CtrlQueueNotify, "CTRL");
+    pThis->pEventQueue = vpciAddQueue(&pThis->VPCI, VIOSCSI_QUEUE_SIZE, vioscsiR3EventQueueNotify, "EVENT");
+    for (uint32_t i = 0; i < pThis->cReqQueues; i++)
+    {
+        PVIOSCSIREQQUEUE pReqQueue = &pThis->aReqQueues[i];
+        pReqQueue->pQueue = vpciAddQueue(&pThis->VPCI, VIOSCSI_QUEUE_SIZE, vioscsiR3ReqQueueNotify, "REQ");
+        AssertReturn(pReqQueue->pQueue == &pThis->VPCI.Queues[VIOSCSI_QUEUE_REQ_FIRST + i], VERR_INTERNAL_ERROR_3);
+
+        rc = PDMDevHlpCritSectInit(pDevIns, &pReqQueue->CritSect, RT_SRC_POS, "%s-REQ%u", INSTANCE(pThis), i);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
+    pThis->config.cQueues     = pThis->cReqQueues;
+    pThis->config.cSegMax     = VIOSCSI_SEG_MAX;
+    pThis->config.cMaxSectors = 0xffff;
+    pThis->config.cCmdPerLun  = VIOSCSI_QUEUE_SIZE;
+    pThis->config.cbEventInfo = sizeof(VIOSCSIEVENT);
+    pThis->config.cbSense     = VIOSCSI_SENSE_SIZE_MAX;
+    pThis->config.cbCdb       = VIOSCSI_CDB_SIZE_MAX;
+    pThis->config.uMaxChannel = 0;
+    pThis->config.uMaxTarget  = (uint16_t)(pThis->cTargets - 1);
+    pThis->config.uMaxLun     = VIOSCSI_LUN_MAX;
+
+    rc = vpciConstructModern(pDevIns, &pThis->VPCI, &g_IOCallbacks, sizeof(struct VirtioScsiConfig), 0 /*fFlags*/);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* Map our ports to IO space. */
+    rc = PDMDevHlpPCIIORegionRegister(pDevIns, 0,
+                                      VPCI_CONFIG_MSIX + sizeof(struct VirtioScsiConfig),
+                                      PCI_ADDRESS_SPACE_IO, vioscsiR3Map);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* Register save/restore state handlers. */
+    rc = PDMDevHlpSSMRegisterEx(pDevIns, VIOSCSI_SAVED_STATE_VERSION, sizeof(VIOSCSISTATE), NULL,
+                                NULL,         vioscsiR3LiveExec, NULL,
+                                NULL,         vioscsiR3SaveExec, NULL,
+                                NULL,         vioscsiR3LoadExec, NULL);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /*
+     * Create and attach the targets.
+     */
+    pThis->paTargets = (PVIOSCSITARGET)RTMemAllocZ(sizeof(VIOSCSITARGET) * pThis->cTargets);
+    if (!pThis->paTargets)
+        return PDMDEV_SET_ERROR(pDevIns, VERR_NO_MEMORY, N_("Failed to allocate memory for target states"));
+
+    for (uint32_t i = 0; i < pThis->cTargets; i++)
+    {
+        PVIOSCSITARGET pTarget = &pThis->paTargets[i];
+
+        pTarget->pVioScsiR3                              = pThis;
+        pTarget->iTarget                                 = i;
+        pTarget->IBase.pfnQueryInterface                 = vioscsiR3TargetQueryInterface;
+        pTarget->IMediaPort.pfnQueryDeviceLocation       = vioscsiR3QueryDeviceLocation;
+        pTarget->IMediaPort.pfnQueryScsiInqStrings       = NULL;
+        pTarget->IMediaExPort.pfnIoReqCompleteNotify     = vioscsiR3IoReqCompleteNotify;
+        pTarget->IMediaExPort.pfnIoReqCopyFromBuf        = vioscsiR3IoReqCopyFromBuf;
+        pTarget->IMediaExPort.pfnIoReqCopyToBuf          = vioscsiR3IoReqCopyToBuf;
+        pTarget->IMediaExPort.pfnIoReqQueryBuf           = NULL;
+        pTarget->IMediaExPort.pfnIoReqQueryDiscardRanges = NULL;
+        pTarget->IMediaExPort.pfnIoReqStateChanged       = vioscsiR3IoReqStateChanged;
+        pTarget->IMediaExPort.pfnMediumEjected           = vioscsiR3MediumEjected;
+
+        char *pszName;
+        if (RTStrAPrintf(&pszName, "Target%u", i) <= 0)
+            AssertLogRelFailedReturn(VERR_NO_MEMORY);
+
+        rc = vioscsiR3TargetAttach(pDevIns, pTarget, pszName);
+        if (rc == VERR_PDM_NO_ATTACHED_DRIVER)
+        {
+            Log(("%s: no driver attached to target %u\n", INSTANCE(pThis), i));
+            rc = VINF_SUCCESS;
+        }
+        else if (RT_FAILURE(rc))
+            return PDMDevHlpVMSetError(pDevIns, rc, RT_SRC_POS, N_("VirtioSCSI: Failed to attach target %u"), i);
+    }
+
+    rc = vioscsiIoCb_Reset(pThis);
+    AssertRC(rc);
+
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqs,               STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of requests processed",                    "/Devices/VScsi%d/Reqs/Total", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqsFailed,         STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of requests not completed with S_OK",      "/Devices/VScsi%d/Reqs/Failed", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatReqsBadTarget,      STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of requests for non-existing targets",     "/Devices/VScsi%d/Reqs/BadTarget", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatCompletionsBatched, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Completions published with a later notification", "/Devices/VScsi%d/Reqs/CompletionsBatched", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatTmf,                STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of task management functions",             "/Devices/VScsi%d/Tmf", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatEvents,             STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of events posted",                         "/Devices/VScsi%d/Events/Posted", iInstance);
+    PDMDevHlpSTAMRegisterF(pDevIns, &pThis->StatEventsMissed,       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of events dropped",                        "/Devices/VScsi%d/Events/Missed", iInstance);
+    for (uint32_t i = 0; i < pThis->cReqQueues; i++)
+        PDMDevHlpSTAMRegisterF(pDevIns, &pThis->aReqQueues[i].StatKicks, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Number of queue notifications", "/Devices/VScsi%d/Queue%u/Kicks", iInstance, i);
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * The device registration structure.
+ */
+const PDMDEVREG g_DeviceVirtioSCSI =
+{
+    /* Structure version. PDM_DEVREG_VERSION defines the current version. */
+    PDM_DEVREG_VERSION,
+    /* Device name. */
+    "virtio-scsi",
+    /* Name of guest context module (no path).
+     * Only evalutated if PDM_DEVREG_FLAGS_RC is set. */
+    "",
+    /* Name of ring-0 module (no path).
+     * Only evalutated if PDM_DEVREG_FLAGS_RC is set. */
+    "VBoxDDR0.r0",
+    /* The description of the device. The UTF-8 string pointed to shall, like this structure,
+     * remain unchanged from registration till VM destruction. */
+    "Virtio SCSI Host Bus Adapter.\n",
+
+    /* Flags, combination of the PDM_DEVREG_FLAGS_* \#defines. */
+    PDM_DEVREG_FLAGS_DEFAULT_BITS | PDM_DEVREG_FLAGS_R0,
+    /* Device class(es), combination of the PDM_DEVREG_CLASS_* \#defines. */
+    PDM_DEVREG_CLASS_STORAGE,
+    /* Maximum number of instances (per VM). */
+    ~0U,
+    /* Size of the instance data. */
+    sizeof(VIOSCSISTATE),
+
+    /* pfnConstruct */
+    vioscsiR3Construct,
+    /* pfnDestruct */
+    vioscsiR3Destruct,
+    /* pfnRelocate */
+    vioscsiR3Relocate,
+    /* pfnMemSetup. */
+    NULL,
+    /* pfnPowerOn */
+    NULL,
+    /* pfnReset */
+    vioscsiR3Reset,
+    /* pfnSuspend */
+    vioscsiR3Suspend,
+    /* pfnResume */
+    vioscsiR3Resume,
+    /* pfnAttach */
+    vioscsiR3Attach,
+    /* pfnDetach */
+    vioscsiR3Detach,
+    /* pfnQueryInterface */
+    NULL,
+    /* pfnInitComplete */
+    NULL,
+    /* pfnPowerOff */
+    vioscsiR3PowerOff,
+    /* pfnSoftReset */
+    NULL,
+
+    /* u32VersionEnd */
+    PDM_DEVREG_VERSION
+};
+
+#endif /* IN_RING3 */
+#endif /* !VBOX_DEVICE_STRUCT_TESTCASE */
@@ -22,6 +22,7 @@
 #define LOG_GROUP LOG_GROUP_DEV_VIRTIO
 
 #include <iprt/param.h>
+#include <iprt/string.h>
 #include <iprt/uuid.h>
 #include <VBox/vmm/pdmdev.h>
 #include "Virtio.h"
@@ -34,6 +35,41 @@
 #endif
 
 
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+#pragma pack(1)
+/**
+ * The common configuration structure of the modern transport
+ * (virtio_pci_common_cfg).
+ */
+typedef struct VPCICOMMONCFG
+{
+    uint32_t uDeviceFeatureSelect;
+    uint32_t uDeviceFeature;
+    uint32_t uDriverFeatureSelect;
+    uint32_t uDriverFeature;
+    uint16_t uMsixConfig;
+    uint16_t cQueues;
+    uint8_t  uDeviceStatus;
+    uint8_t  uConfigGeneration;
+    uint16_t uQueueSelect;
+    uint16_t uQueueSize;
+    uint16_t uQueueMsixVector;
+    uint16_t uQueueEnable;
+    uint16_t uQueueNotifyOff;
+    uint64_t GCPhysQueueDesc;
+    uint64_t GCPhysQueueDriver;
+    uint64_t GCPhysQueueDevice;
+} VPCICOMMONCFG;
+#pragma pack()
+AssertCompileSize(VPCICOMMONCFG, VPCI_COMMON_SIZE);
+AssertCompileMemberOffset(VPCICOMMONCFG, uDeviceStatus, VPCI_COMMON_DEVICE_STATUS);
+AssertCompileMemberOffset(VPCICOMMONCFG, uQueueSelect, VPCI_COMMON_QUEUE_SELECT);
+AssertCompileMemberOffset(VPCICOMMONCFG, GCPhysQueueDesc, VPCI_COMMON_QUEUE_DESC);
+AssertCompileMemberOffset(VPCICOMMONCFG, GCPhysQueueDevice, VPCI_COMMON_QUEUE_DEVICE);
+
+
 
 #ifndef VBOX_DEVICE_STRUCT_TESTCASE
 
@@ -49,6 +85,12 @@ static void vqueueReset(PVQUEUE pQueue)
     pQueue->uNextAvailIndex       = 0;
     pQueue->uNextUsedIndex        = 0;
     pQueue->uPageNumber           = 0;
+    pQueue->VRing.uSize           = pQueue->uMaxSize;
+    pQueue->uMsixVector           = VPCI_MSIX_NO_VECTOR;
+    pQueue->fSignalledUsedValid   = false;
+    pQueue->fEnabled              = false;
+    pQueue->fAvailWrap            = true;
+    pQueue->fUsedWrap             = true;
 }
 
 static void vqueueInit(PVQUEUE pQueue, uint32_t uPageNumber)
@@ -61,6 +103,22 @@ static void vqueueInit(PVQUEUE pQueue, uint32_t uPageNumber)
         PAGE_SIZE); /* The used ring must start from the next page. */
     pQueue->uNextAvailIndex       = 0;
     pQueue->uNextUsedIndex        = 0;
+    pQueue->fSignalledUsedValid   = false;
+    pQueue->fEnabled              = true;
+}
+
+/**
+ * Enables a queue set up through the modern transport, the ring addresses
+ * have already been written by the guest.
+ */
+static void vqueueEnable(PVQUEUE pQueue)
+{
+    pQueue->uNextAvailIndex       = 0;
+    pQueue->uNextUsedIndex        = 0;
+    pQueue->fSignalledUsedValid   = false;
+    pQueue->fAvailWrap            = true;
+    pQueue->fUsedWrap             = true;
+    pQueue->fEnabled              = true;
 }
 
 // void vqueueElemFree(PVQUEUEELEM pElem)
@@ -95,10 +153,44 @@ uint16_t vringReadAvailFlags(PVPCISTATE pState, PVRING pVRing)
     return tmp;
 }
 
+/**
+ * Publishes the next available index we are going to consume as avail_event,
+ * so the guest kicks us once it makes that element available.
+ *
+ * Only meaningful for split rings when VPCI_F_RING_EVENT_IDX was negotiated.
+ */
+static void vringWriteAvailEvent(PVPCISTATE pState, PVQUEUE pQueue)
+{
+    uint16_t tmp = pQueue->uNextAvailIndex;
+    PDMDevHlpPCIPhysWrite(pState->CTX_SUFF(pDevIns),
+                          pQueue->VRing.addrUsed + RT_UOFFSETOF_DYN(VRINGUSED, aRing[pQueue->VRing.uSize]),
+                          &tmp, sizeof(tmp));
+}
+
 void vringSetNotification(PVPCISTATE pState, PVRING pVRing, bool fEnabled)
 {
     uint16_t tmp;
 
+    if (vpciIsRingPacked(pState))
+    {
+        tmp = fEnabled ? VRINGPACKED_EVENT_F_ENABLE : VRINGPACKED_EVENT_F_DISABLE;
+        PDMDevHlpPCIPhysWrite(pState->CTX_SUFF(pDevIns),
+                              pVRing->addrUsed + RT_UOFFSETOF(VRINGPACKEDEVENT, u16Flags),
+                              &tmp, sizeof(tmp));
+        return;
+    }
+
+    if (pState->uGuestFeatures & VPCI_F_RING_EVENT_IDX)
+    {
+        /*
+         * The guest kicks us only when it makes the element at avail_event
+         * available. Leaving avail_event behind is enough to suppress kicks.
+         */
+        if (fEnabled)
+            vringWriteAvailEvent(pState, RT_FROM_MEMBER(pVRing, VQUEUE, VRing));
+        return;
+    }
+
     PDMDevHlpPhysRead(pState->CTX_SUFF(pDevIns),
                       pVRing->addrUsed + RT_UOFFSETOF(VRINGUSED, uFlags),
                       &tmp, sizeof(tmp));
@@ -113,19 +205,176 @@ void vringSetNotification(PVPCISTATE pState, PVRING pVRing, bool fEnabled)
                           &tmp, sizeof(tmp));
 }
 
+/**
+ * Reads the flags of a packed ring descriptor.
+ */
+static uint16_t vringPackedReadDescFlags(PVPCISTATE pState, PVRING pVRing, uint16_t uIndex)
+{
+    uint16_t tmp;
+
+    PDMDevHlpPhysRead(pState->CTX_SUFF(pDevIns),
+                      pVRing->addrDescriptors + sizeof(VRINGPACKEDDESC) * uIndex
+                      + RT_UOFFSETOF(VRINGPACKEDDESC, u16Flags),
+                      &tmp, sizeof(tmp));
+    return tmp;
+}
+
+/**
+ * Checks whether a packed ring descriptor has been made available by the
+ * driver in the current pass over the ring.
+ */
+DECLINLINE(bool) vringPackedIsDescAvail(uint16_t fFlags, bool fWrap)
+{
+    return RT_BOOL(fFlags & VRINGDESC_F_AVAIL) == fWrap
+        && RT_BOOL(fFlags & VRINGDESC_F_USED)  != fWrap;
+}
+
+/**
+ * Advances a packed ring position, flipping the wrap counter when wrapping
+ * around.
+ */
+DECLINLINE(void) vringPackedAdvance(PVRING pVRing, uint16_t *puIndex, bool *pfWrap, uint16_t cDescs)
+{
+    uint32_t uIndex = *puIndex + cDescs;
+    while (uIndex >= pVRing->uSize)
+    {
+        uIndex -= pVRing->uSize;
+        *pfWrap = !*pfWrap;
+    }
+    *puIndex = (uint16_t)uIndex;
+}
+
+bool vqueuePackedIsEmpty(PVPCISTATE pState, PVQUEUE pQueue)
+{
+    return !vringPackedIsDescAvail(vringPackedReadDescFlags(pState, &pQueue->VRing, pQueue->uNextAvailIndex),
+                                   pQueue->fAvailWrap);
+}
+
+/**
+ * Returns the number of descriptors in the packed ring chain starting at the
+ * next available position.
+ */
+static uint16_t vqueuePackedChainLength(PVPCISTATE pState, PVQUEUE pQueue)
+{
+    uint16_t uIndex = pQueue->uNextAvailIndex;
+    bool     fWrap  = pQueue->fAvailWrap;
+    uint16_t cDescs = 0;
+
+    /* A chain cannot be longer than the ring. */
+    while (cDescs < pQueue->VRing.uSize)
+    {
+        uint16_t fFlags = vringPackedReadDescFlags(pState, &pQueue->VRing, uIndex);
+        cDescs++;
+        if (!(fFlags & VRINGDESC_F_NEXT))
+            break;
+        vringPackedAdvance(&pQueue->VRing, &uIndex, &fWrap, 1);
+    }
+    return cDescs;
+}
+
+/**
+ * vqueueGet worker for packed rings.
+ *
+ * Packed chains are made of consecutive descriptors, the buffer ID of the
+ * last one identifies the chain when it is returned.
+ */
+static bool vqueuePackedGet(PVPCISTATE pState, PVQUEUE pQueue, PVQUEUEELEM pElem, bool fRemove)
+{
+    if (vqueuePackedIsEmpty(pState, pQueue))
+        return false;
+
+    pElem->nIn = pElem->nOut = 0;
+
+    uint16_t        uIndex = pQueue->uNextAvailIndex;
+    bool            fWrap  = pQueue->fAvailWrap;
+    VRINGPACKEDDESC desc;
+    do
+    {
+        VQUEUESEG *pSeg;
+
+        if (pElem->nIn + pElem->nOut >= pQueue->VRing.uSize)
+        {
+            LogRel(("%s: packed descriptor chain longer than the ring.\n", INSTANCE(pState)));
+            break;
+        }
+        RT_UNTRUSTED_VALIDATED_FENCE();
+
+        PDMDevHlpPhysRead(pState->CTX_SUFF(pDevIns),
+                          pQueue->VRing.addrDescriptors + sizeof(VRINGPACKEDDESC) * uIndex,
+                          &desc, sizeof(desc));
+        if (desc.u16Flags & VRINGDESC_F_WRITE)
+            pSeg = &pElem->aSegsIn[pElem->nIn++];
+        else
+            pSeg = &pElem->aSegsOut[pElem->nOut++];
+
+        pSeg->addr = desc.u64Addr;
+        pSeg->cb   = desc.uLen;
+        pSeg->pv   = NULL;
+
+        pElem->uIndex = desc.u16Id;
+        vringPackedAdvance(&pQueue->VRing, &uIndex, &fWrap, 1);
+    } while (desc.u16Flags & VRINGDESC_F_NEXT);
+
+    if (fRemove)
+    {
+        pQueue->uNextAvailIndex = uIndex;
+        pQueue->fAvailWrap      = fWrap;
+    }
+
+    Log2(("%s vqueuePackedGet: %s id=%u nIn=%u nOut=%u\n", INSTANCE(pState),
+          QUEUENAME(pState, pQueue), pElem->uIndex, pElem->nIn, pElem->nOut));
+    return true;
+}
+
+/**
+ * Returns a chain of @a cDescs descriptors to the guest through a packed ring.
+ */
+static void vringPackedWriteUsed(PVPCISTATE pState, PVQUEUE pQueue, uint16_t uId, uint32_t uLen, uint16_t cDescs)
+{
+    RTGCPHYS GCPhysDesc = pQueue->VRing.addrDescriptors + sizeof(VRINGPACKEDDESC) * pQueue->uNextUsedIndex;
+    /* The length and buffer ID are adjacent in the descriptor. */
+    uint8_t abLenId[sizeof(uint32_t) + sizeof(uint16_t)];
+    memcpy(&abLenId[0], &uLen, sizeof(uLen));
+    memcpy(&abLenId[sizeof(uLen)], &uId, sizeof(uId));
+
+    /* The flags make the descriptor visible to the guest and go last. */
+    uint16_t fFlags = pQueue->fUsedWrap ? VRINGDESC_F_AVAIL | VRINGDESC_F_USED : 0;
+    if (uLen)
+        fFlags |= VRINGDESC_F_WRITE;
+    PDMDevHlpPCIPhysWrite(pState->CTX_SUFF(pDevIns), GCPhysDesc + RT_UOFFSETOF(VRINGPACKEDDESC, uLen),
+                          abLenId, sizeof(abLenId));
+    ASMCompilerBarrier();
+    PDMDevHlpPCIPhysWrite(pState->CTX_SUFF(pDevIns), GCPhysDesc + RT_UOFFSETOF(VRINGPACKEDDESC, u16Flags),
+                          &fFlags, sizeof(fFlags));
+
+    vringPackedAdvance(&pQueue->VRing, &pQueue->uNextUsedIndex, &pQueue->fUsedWrap, RT_MAX(cDescs, 1));
+}
+
 bool vqueueSkip(PVPCISTATE pState, PVQUEUE pQueue)
 {
     if (vqueueIsEmpty(pState, pQueue))
         return false;
 
+    if (vpciIsRingPacked(pState))
+    {
+        vringPackedAdvance(&pQueue->VRing, &pQueue->uNextAvailIndex, &pQueue->fAvailWrap,
+                           vqueuePackedChainLength(pState, pQueue));
+        return true;
+    }
+
     Log2(("%s vqueueSkip: %s avail_idx=%u\n", INSTANCE(pState),
           QUEUENAME(pState, pQueue), pQueue->uNextAvailIndex));
     pQueue->uNextAvailIndex++;
+    if (pState->uGuestFeatures & VPCI_F_RING_EVENT_IDX)
+        vringWriteAvailEvent(pState, pQueue);
     return true;
 }
 
 bool vqueueGet(PVPCISTATE pState, PVQUEUE pQueue, PVQUEUEELEM pElem, bool fRemove)
 {
+    if (vpciIsRingPacked(pState))
+        return vqueuePackedGet(pState, pQueue, pElem, fRemove);
+
     if (vqueueIsEmpty(pState, pQueue))
         return false;
 
@@ -137,7 +386,15 @@ bool vqueueGet(PVPCISTATE pState, PVQUEUE pQueue, PVQUEUEELEM pElem, bool fRemov
     VRINGDESC desc;
     uint16_t  idx = vringReadAvail(pState, &pQueue->VRing, pQueue->uNextAvailIndex);
     if (fRemove)
+    {
         pQueue->uNextAvailIndex++;
+        /*
+         * Keep avail_event in step with what we consume, not every device
+         * re-arms notifications on every queue it drains (control queues).
+         */
+        if (pState->uGuestFeatures & VPCI_F_RING_EVENT_IDX)
+            vringWriteAvailEvent(pState, pQueue);
+    }
     pElem->uIndex = idx;
     do
     {
@@ -192,6 +449,77 @@ bool vqueueGet(PVPCISTATE pState, PVQUEUE pQueue, PVQUEUEELEM pElem, bool fRemov
     return true;
 }
 
+/**
+ * Counts the available descriptor chains needed to provide @a cbNeeded bytes
+ * of guest writable buffer space, without taking them off the ring.
+ *
+ * This lets a device spreading data over several chains (mergeable RX
+ * buffers) find out up front whether it can complete the operation, so that
+ * it never has to return a partially filled set of chains.
+ *
+ * @returns Number of chains, 0 if the available ones are too small.
+ * @param   pState      The device state structure.
+ * @param   pQueue      The queue.
+ * @param   cbNeeded    The amount of writable space required.
+ */
+uint16_t vqueueCountAvailIn(PVPCISTATE pState, PVQUEUE pQueue, uint32_t cbNeeded)
+{
+    uint32_t cbAvail = 0;
+    uint16_t cChains = 0;
+
+    if (vpciIsRingPacked(pState))
+    {
+        uint16_t uIndex = pQueue->uNextAvailIndex;
+        bool     fWrap  = pQueue->fAvailWrap;
+        uint32_t cDescs = 0;
+        bool     fInChain = false;
+        /* Chains are counted when complete, so finish the one the space ran out in. */
+        while ((cbAvail < cbNeeded || fInChain) && cDescs < pQueue->VRing.uSize)
+        {
+            VRINGPACKEDDESC desc;
+            PDMDevHlpPhysRead(pState->CTX_SUFF(pDevIns),
+                              pQueue->VRing.addrDescriptors + sizeof(VRINGPACKEDDESC) * uIndex,
+                              &desc, sizeof(desc));
+            if (!vringPackedIsDescAvail(desc.u16Flags, fWrap))
+                break;
+            if (desc.u16Flags & VRINGDESC_F_WRITE)
+                cbAvail += desc.uLen;
+            fInChain = RT_BOOL(desc.u16Flags & VRINGDESC_F_NEXT);
+            if (!fInChain)
+                cChains++;
+            cDescs++;
+            vringPackedAdvance(&pQueue->VRing, &uIndex, &fWrap, 1);
+        }
+        if (fInChain)
+            return 0;
+    }
+    else
+    {
+        uint16_t const uAvailIndex = vringReadAvailIndex(pState, &pQueue->VRing);
+        for (uint16_t uNext = pQueue->uNextAvailIndex;
+             uNext != uAvailIndex && cbAvail < cbNeeded && cChains < pQueue->VRing.uSize;
+             uNext++)
+        {
+            uint16_t  idx = vringReadAvail(pState, &pQueue->VRing, uNext);
+            VRINGDESC desc;
+            unsigned  cDescs = 0;
+            do
+            {
+                /* Same loop protection as in vqueueGet. */
+                if (cDescs++ >= VRING_MAX_SIZE)
+                    break;
+                vringReadDesc(pState, &pQueue->VRing, idx, &desc);
+                if (desc.u16Flags & VRINGDESC_F_WRITE)
+                    cbAvail += desc.uLen;
+                idx = desc.u16Next;
+            } while (desc.u16Flags & VRINGDESC_F_NEXT);
+            cChains++;
+        }
+    }
+
+    return cbAvail >= cbNeeded ? cChains : 0;
+}
+
 uint16_t vringReadUsedIndex(PVPCISTATE pState, PVRING pVRing)
 {
     uint16_t tmp;
@@ -268,6 +596,16 @@ void vqueuePut(PVPCISTATE pState, PVQUEUE pQueue,
         cbLen -= cbSegLen;
     }
 
+    if (vpciIsRingPacked(pState))
+    {
+        Log2(("%s vqueuePut: %s used_pos=%u id=%u len=%u\n",
+              INSTANCE(pState), QUEUENAME(pState, pQueue),
+              pQueue->uNextUsedIndex, pElem->uIndex, uTotalLen));
+        vringPackedWriteUsed(pState, pQueue, (uint16_t)pElem->uIndex, uTotalLen,
+                             (uint16_t)(pElem->nIn + pElem->nOut));
+        return;
+    }
+
     Log2(("%s vqueuePut: %s"
           " used_idx=%u guest_used_idx=%u id=%u len=%u\n",
           INSTANCE(pState), QUEUENAME(pState, pQueue),
@@ -280,16 +618,91 @@ void vqueuePut(PVPCISTATE pState, PVQUEUE pQueue,
 }
 
 
+/**
+ * The event index test: did the used index move past the event index the
+ * guest asked for since the last notification?
+ */
+DECLINLINE(bool) vringNeedEvent(uint16_t uEventIdx, uint16_t uNew, uint16_t uOld)
+{
+    return (uint16_t)(uNew - uEventIdx - 1) < (uint16_t)(uNew - uOld);
+}
+
+/**
+ * Decides whether the guest wants an interrupt for the used elements
+ * published since the last notification.
+ *
+ * @returns true if the guest needs to be interrupted.
+ * @param   pState      The device state structure.
+ * @param   pQueue      The queue.
+ */
+static bool vqueueNeedNotify(PVPCISTATE pState, PVQUEUE pQueue)
+{
+    uint16_t const uOld   = pQueue->uSignalledUsed;
+    uint16_t const uNew   = pQueue->uNextUsedIndex;
+    bool const     fValid = pQueue->fSignalledUsedValid;
+    pQueue->uSignalledUsed      = uNew;
+    pQueue->fSignalledUsedValid = true;
+
+    if (vpciIsRingPacked(pState))
+    {
+        VRINGPACKEDEVENT Event;
+        PDMDevHlpPhysRead(pState->CTX_SUFF(pDevIns), pQueue->VRing.addrAvail, &Event, sizeof(Event));
+        if (Event.u16Flags == VRINGPACKED_EVENT_F_DISABLE)
+            return false;
+        if (   Event.u16Flags != VRINGPACKED_EVENT_F_DESC
+            || !(pState->uGuestFeatures & VPCI_F_RING_EVENT_IDX)
+            || !fValid)
+            return true;
+
+        /* The event offset is relative to the pass given by its wrap counter. */
+        uint16_t uEventIdx = Event.u16OffWrap & 0x7fff;
+        if (RT_BOOL(Event.u16OffWrap & 0x8000) != pQueue->fUsedWrap)
+            uEventIdx -= pQueue->VRing.uSize;
+        return vringNeedEvent(uEventIdx, uNew, uOld);
+    }
+
+    if (pState->uGuestFeatures & VPCI_F_RING_EVENT_IDX)
+    {
+        /* used_event lives right after the available ring. */
+        uint16_t uUsedEvent;
+        PDMDevHlpPhysRead(pState->CTX_SUFF(pDevIns),
+                          pQueue->VRing.addrAvail + RT_UOFFSETOF_DYN(VRINGAVAIL, auRing[pQueue->VRing.uSize]),
+                          &uUsedEvent, sizeof(uUsedEvent));
+        return !fValid || vringNeedEvent(uUsedEvent, uNew, uOld);
+    }
+
+    return !(vringReadAvailFlags(pState, &pQueue->VRing) & VRINGAVAIL_F_NO_INTERRUPT)
+        || ((pState->uGuestFeatures & VPCI_F_NOTIFY_ON_EMPTY) && vqueueIsEmpty(pState, pQueue));
+}
+
+/**
+ * Raises the used buffer interrupt of a queue, its own MSI-X vector if the
+ * guest enabled MSI-X.
+ *
+ * @param   pState      The device state structure.
+ * @param   pQueue      The queue.
+ */
+static int vpciRaiseQueueInterrupt(VPCISTATE *pState, PVQUEUE pQueue)
+{
+    if (vpciIsMsixEnabled(pState))
+    {
+        if (pQueue->uMsixVector != VPCI_MSIX_NO_VECTOR)
+        {
+            STAM_COUNTER_INC(&pState->StatIntsRaised);
+            PDMDevHlpPCISetIrq(pState->CTX_SUFF(pDevIns), pQueue->uMsixVector, PDM_IRQ_LEVEL_HIGH);
+        }
+        return VINF_SUCCESS;
+    }
+    return vpciRaiseInterrupt(pState, VERR_INTERNAL_ERROR, VPCI_ISR_QUEUE);
+}
+
 void vqueueNotify(PVPCISTATE pState, PVQUEUE pQueue)
 {
-    LogFlow(("%s vqueueNotify: %s availFlags=%x guestFeatures=%x vqueue is %sempty\n",
-             INSTANCE(pState), QUEUENAME(pState, pQueue),
-             vringReadAvailFlags(pState, &pQueue->VRing),
-             pState->uGuestFeatures, vqueueIsEmpty(pState, pQueue)?"":"not "));
-    if (!(vringReadAvailFlags(pState, &pQueue->VRing) & VRINGAVAIL_F_NO_INTERRUPT)
-        || ((pState->uGuestFeatures & VPCI_F_NOTIFY_ON_EMPTY) && vqueueIsEmpty(pState, pQueue)))
+    LogFlow(("%s vqueueNotify: %s guestFeatures=%x\n",
+             INSTANCE(pState), QUEUENAME(pState, pQueue), pState->uGuestFeatures));
+    if (vqueueNeedNotify(pState, pQueue))
     {
-        int rc = vpciRaiseInterrupt(pState, VERR_INTERNAL_ERROR, VPCI_ISR_QUEUE);
+        int rc = vpciRaiseQueueInterrupt(pState, pQueue);
         if (RT_FAILURE(rc))
             Log(("%s vqueueNotify: Failed to raise an interrupt (%Rrc).\n", INSTANCE(pState), rc));
     }
@@ -302,18 +715,26 @@ void vqueueNotify(PVPCISTATE pState, PVQUEUE pQueue)
 
 void vqueueSync(PVPCISTATE pState, PVQUEUE pQueue)
 {
-    Log2(("%s vqueueSync: %s old_used_idx=%u new_used_idx=%u\n", INSTANCE(pState),
-          QUEUENAME(pState, pQueue), vringReadUsedIndex(pState, &pQueue->VRing), pQueue->uNextUsedIndex));
-    vringWriteUsedIndex(pState, &pQueue->VRing, pQueue->uNextUsedIndex);
+    /* Packed rings have no used index, vqueuePut already made the elements visible. */
+    if (!vpciIsRingPacked(pState))
+    {
+        Log2(("%s vqueueSync: %s old_used_idx=%u new_used_idx=%u\n", INSTANCE(pState),
+              QUEUENAME(pState, pQueue), vringReadUsedIndex(pState, &pQueue->VRing), pQueue->uNextUsedIndex));
+        vringWriteUsedIndex(pState, &pQueue->VRing, pQueue->uNextUsedIndex);
+    }
     vqueueNotify(pState, pQueue);
 }
 
 void vpciReset(PVPCISTATE pState)
 {
-    pState->uGuestFeatures = 0;
-    pState->uQueueSelector = 0;
-    pState->uStatus        = 0;
-    pState->uISR           = 0;
+    pState->uGuestFeatures       = 0;
+    pState->uQueueSelector       = 0;
+    pState->uStatus              = 0;
+    pState->uISR                 = 0;
+    pState->uGuestFeaturesHi     = 0;
+    pState->uDeviceFeatureSelect = 0;
+    pState->uDriverFeatureSelect = 0;
+    pState->uMsixConfig          = VPCI_MSIX_NO_VECTOR;
 
     for (unsigned i = 0; i < pState->nQueues; i++)
         vqueueReset(&pState->Queues[i]);
@@ -334,10 +755,25 @@ int vpciRaiseInterrupt(VPCISTATE *pState, int rcBusy, uint8_t u8IntCause)
     // if (RT_UNLIKELY(rc != VINF_SUCCESS))
     //     return rc;
 
-    STAM_COUNTER_INC(&pState->StatIntsRaised);
     LogFlow(("%s vpciRaiseInterrupt: u8IntCause=%x\n",
              INSTANCE(pState), u8IntCause));
 
+    if (u8IntCause & (VPCI_ISR_CONFIG & ~VPCI_ISR_QUEUE))
+        pState->uConfigGeneration++;
+
+    /* With MSI-X only configuration changes come here, queues use their own vectors. */
+    if (vpciIsMsixEnabled(pState))
+    {
+        if (   (u8IntCause & (VPCI_ISR_CONFIG & ~VPCI_ISR_QUEUE))
+            && pState->uMsixConfig != VPCI_MSIX_NO_VECTOR)
+        {
+            STAM_COUNTER_INC(&pState->StatIntsRaised);
+            PDMDevHlpPCISetIrq(pState->CTX_SUFF(pDevIns), pState->uMsixConfig, PDM_IRQ_LEVEL_HIGH);
+        }
+        return VINF_SUCCESS;
+    }
+
+    STAM_COUNTER_INC(&pState->StatIntsRaised);
     pState->uISR |= u8IntCause;
     PDMDevHlpPCISetIrq(pState->CTX_SUFF(pDevIns), 0, 1);
     // vpciCsLeave(pState);
@@ -359,9 +795,87 @@ DECLINLINE(uint32_t) vpciGetHostFeatures(PVPCISTATE pState,
                                          PFNGETHOSTFEATURES pfnGetHostFeatures)
 {
     return pfnGetHostFeatures(pState)
-        | VPCI_F_NOTIFY_ON_EMPTY;
+        | VPCI_F_NOTIFY_ON_EMPTY
+        | VPCI_F_RING_EVENT_IDX;
+}
+
+/**
+ * Returns an MSI-X vector the guest assigned if it is a valid one, otherwise
+ * VPCI_MSIX_NO_VECTOR telling the guest the assignment failed.
+ */
+DECLINLINE(uint16_t) vpciCheckMsixVector(PVPCISTATE pState, uint32_t uVector)
+{
+    return (uVector & 0xffff) < pState->cMsixVectors ? (uint16_t)uVector : VPCI_MSIX_NO_VECTOR;
+}
+
+/**
+ * Handles a write to the device status register of either transport.
+ *
+ * @returns VBox status code.
+ * @param   pState      The device state structure.
+ * @param   u8Status    The new status.
+ * @param   pCallbacks  Pointer to the callbacks.
+ */
+static int vpciSetStatus(PVPCISTATE pState, uint8_t u8Status, PCVPCIIOCALLBACKS pCallbacks)
+{
+    int  rc              = VINF_SUCCESS;
+    bool fHasBecomeReady = !(pState->uStatus & VPCI_STATUS_DRV_OK) && (u8Status & VPCI_STATUS_DRV_OK);
+    bool fFeaturesOk     = !(pState->uStatus & VPCI_STATUS_FEATURES_OK) && (u8Status & VPCI_STATUS_FEATURES_OK);
+    pState->uStatus = u8Status;
+    /* Writing 0 to the status port triggers device reset. */
+    if (u8Status == 0)
+        rc = pCallbacks->pfnReset(pState);
+    else
+    {
+        if (fFeaturesOk)
+        {
+            /* Only modern drivers set FEATURES_OK and they have to accept VIRTIO_F_VERSION_1. */
+            if (pState->uGuestFeaturesHi & VPCI_F_HI_VERSION_1)
+                pCallbacks->pfnSetHostFeatures(pState, pState->uGuestFeatures);
+            else
+            {
+                Log(("%s Driver did not accept VIRTIO_F_VERSION_1\n", INSTANCE(pState)));
+                pState->uStatus &= ~VPCI_STATUS_FEATURES_OK;
+            }
+        }
+        if (fHasBecomeReady)
+        {
+            /* Older hypervisors were lax and did not enforce bus mastering. Older guests
+             * (Linux prior to 2.6.34, NetBSD 6.x) were lazy and did not enable bus mastering.
+             * We automagically enable bus mastering on driver initialization to make existing
+             * drivers work.
+             */
+            PDMPciDevSetCommand(&pState->pciDevice, PDMPciDevGetCommand(&pState->pciDevice) | PCI_COMMAND_BUSMASTER);
+
+            pCallbacks->pfnReady(pState);
+        }
+    }
+    return rc;
 }
 
+#ifdef IN_RING3
+/**
+ * Handles a queue notification (kick) from the guest through either transport.
+ *
+ * @param   pState      The device state structure.
+ * @param   uQueue      The queue index the guest wrote.
+ */
+static void vpciR3QueueNotify(PVPCISTATE pState, uint32_t uQueue)
+{
+    if (uQueue < pState->nQueues)
+    {
+        RT_UNTRUSTED_VALIDATED_FENCE();
+        if (vqueueIsReady(pState, &pState->Queues[uQueue]))
+            pState->Queues[uQueue].pfnCallback(pState, &pState->Queues[uQueue]);
+        else
+            Log(("%s The queue (#%d) being notified has not been initialized.\n",
+                 INSTANCE(pState), uQueue));
+    }
+    else
+        Log(("%s Invalid queue number (%d)\n", INSTANCE(pState), uQueue));
+}
+#endif /* IN_RING3 */
+
 /**
  * Port I/O Handler for IN operations.
  *
@@ -443,8 +957,19 @@ int vpciIOPortIn(PPDMDEVINS         pDevIns,
             break;
 
         default:
-            if (Port >= VPCI_CONFIG)
-                rc = pCallbacks->pfnGetConfig(pState, Port - VPCI_CONFIG, cb, pu32);
+            if (vpciIsMsixEnabled(pState) && Port < VPCI_CONFIG_MSIX && Port >= VPCI_CONFIG)
+            {
+                Assert(cb == 2);
+                if (Port == VPCI_CONFIG_VECTOR)
+                    *(uint16_t*)pu32 = pState->uMsixConfig;
+                else
+                    *(uint16_t*)pu32 = pState->Queues[pState->uQueueSelector].uMsixVector;
+            }
+            else if (Port >= VPCI_CONFIG)
+            {
+                RTIOPORT offConfig = vpciIsMsixEnabled(pState) ? VPCI_CONFIG_MSIX : VPCI_CONFIG;
+                rc = pCallbacks->pfnGetConfig(pState, Port - offConfig, cb, pu32);
+            }
             else
             {
                 *pu32 = 0xFFFFFFFF;
@@ -482,7 +1007,6 @@ int vpciIOPortOut(PPDMDEVINS                pDevIns,
 {
     VPCISTATE  *pState = PDMINS_2_DATA(pDevIns, VPCISTATE *);
     int         rc     = VINF_SUCCESS;
-    bool        fHasBecomeReady;
     STAM_PROFILE_ADV_START(&pState->CTX_SUFF(StatIOWrite), a);
     RT_NOREF_PV(pvUser);
 
@@ -550,24 +1074,7 @@ int vpciIOPortOut(PPDMDEVINS                pDevIns,
 #ifdef IN_RING3
             Assert(cb == 2);
             u32 &= 0xFFFF;
-            if (u32 < pState->nQueues)
-            {
-                RT_UNTRUSTED_VALIDATED_FENCE();
-                if (pState->Queues[u32].VRing.addrDescriptors)
-                {
-                    // rc = vpciCsEnter(pState, VERR_SEM_BUSY);
-                    // if (RT_LIKELY(rc == VINF_SUCCESS))
-                    // {
-                        pState->Queues[u32].pfnCallback(pState, &pState->Queues[u32]);
-                    //     vpciCsLeave(pState);
-                    // }
-                }
-                else
-                    Log(("%s The queue (#%d) being notified has not been initialized.\n",
-                         INSTANCE(pState), u32));
-            }
-            else
-                Log(("%s Invalid queue number (%d)\n", INSTANCE(pState), u32));
+            vpciR3QueueNotify(pState, u32);
 #else
             rc = VINF_IOM_R3_IOPORT_WRITE;
 #endif
@@ -575,28 +1082,23 @@ int vpciIOPortOut(PPDMDEVINS                pDevIns,
 
         case VPCI_STATUS:
             Assert(cb == 1);
-            u32 &= 0xFF;
-            fHasBecomeReady = !(pState->uStatus & VPCI_STATUS_DRV_OK) && (u32 & VPCI_STATUS_DRV_OK);
-            pState->uStatus = u32;
-            /* Writing 0 to the status port triggers device reset. */
-            if (u32 == 0)
-                rc = pCallbacks->pfnReset(pState);
-            else if (fHasBecomeReady)
-            {
-                /* Older hypervisors were lax and did not enforce bus mastering. Older guests
-                 * (Linux prior to 2.6.34, NetBSD 6.x) were lazy and did not enable bus mastering.
-                 * We automagically enable bus mastering on driver initialization to make existing
-                 * drivers work.
-                 */
-                PDMPciDevSetCommand(&pState->pciDevice, PDMPciDevGetCommand(&pState->pciDevice) | PCI_COMMAND_BUSMASTER);
-
-                pCallbacks->pfnReady(pState);
-            }
+            rc = vpciSetStatus(pState, (uint8_t)u32, pCallbacks);
             break;
 
         default:
-            if (Port >= VPCI_CONFIG)
-                rc = pCallbacks->pfnSetConfig(pState, Port - VPCI_CONFIG, cb, &u32);
+            if (vpciIsMsixEnabled(pState) && Port < VPCI_CONFIG_MSIX && Port >= VPCI_CONFIG)
+            {
+                Assert(cb == 2);
+                if (Port == VPCI_CONFIG_VECTOR)
+                    pState->uMsixConfig = vpciCheckMsixVector(pState, u32);
+                else
+                    pState->Queues[pState->uQueueSelector].uMsixVector = vpciCheckMsixVector(pState, u32);
+            }
+            else if (Port >= VPCI_CONFIG)
+            {
+                RTIOPORT offConfig = vpciIsMsixEnabled(pState) ? VPCI_CONFIG_MSIX : VPCI_CONFIG;
+                rc = pCallbacks->pfnSetConfig(pState, Port - offConfig, cb, &u32);
+            }
             else
                 rc = PDMDevHlpDBGFStop(pDevIns, RT_SRC_POS, "%s vpciIOPortOut: no valid port at offset Port=%RTiop cb=%08x\n",
                                        INSTANCE(pState), Port, cb);
@@ -766,6 +1268,40 @@ int vpciSaveExec(PVPCISTATE pState, PSSMHANDLE pSSM)
         AssertRCReturn(rc, rc);
     }
 
+    /* Modern transport state (VIRTIO_SAVEDSTATE_VERSION). */
+    rc = SSMR3PutU32(pSSM, pState->uGuestFeaturesHi);
+    AssertRCReturn(rc, rc);
+    rc = SSMR3PutU32(pSSM, pState->uDeviceFeatureSelect);
+    AssertRCReturn(rc, rc);
+    rc = SSMR3PutU32(pSSM, pState->uDriverFeatureSelect);
+    AssertRCReturn(rc, rc);
+    rc = SSMR3PutU16(pSSM, pState->uMsixConfig);
+    AssertRCReturn(rc, rc);
+    rc = SSMR3PutU8( pSSM, pState->uConfigGeneration);
+    AssertRCReturn(rc, rc);
+    for (unsigned i = 0; i < pState->nQueues; i++)
+    {
+        PVQUEUE pQueue = &pState->Queues[i];
+        rc = SSMR3PutBool(pSSM, pQueue->fEnabled);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutU16( pSSM, pQueue->uMsixVector);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutGCPhys(pSSM, pQueue->VRing.addrDescriptors);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutGCPhys(pSSM, pQueue->VRing.addrAvail);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutGCPhys(pSSM, pQueue->VRing.addrUsed);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutBool(pSSM, pQueue->fAvailWrap);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutBool(pSSM, pQueue->fUsedWrap);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutU16( pSSM, pQueue->uSignalledUsed);
+        AssertRCReturn(rc, rc);
+        rc = SSMR3PutBool(pSSM, pQueue->fSignalledUsedValid);
+        AssertRCReturn(rc, rc);
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -822,6 +1358,45 @@ int vpciLoadExec(PVPCISTATE pState, PSSMHANDLE pSSM, uint32_t uVersion, uint32_t
             rc = SSMR3GetU16(pSSM, &pState->Queues[i].uNextUsedIndex);
             AssertRCReturn(rc, rc);
         }
+
+        if (uVersion >= VIRTIO_SAVEDSTATE_VERSION)
+        {
+            rc = SSMR3GetU32(pSSM, &pState->uGuestFeaturesHi);
+            AssertRCReturn(rc, rc);
+            rc = SSMR3GetU32(pSSM, &pState->uDeviceFeatureSelect);
+            AssertRCReturn(rc, rc);
+            rc = SSMR3GetU32(pSSM, &pState->uDriverFeatureSelect);
+            AssertRCReturn(rc, rc);
+            rc = SSMR3GetU16(pSSM, &pState->uMsixConfig);
+            AssertRCReturn(rc, rc);
+            rc = SSMR3GetU8(pSSM, &pState->uConfigGeneration);
+            AssertRCReturn(rc, rc);
+            for (unsigned i = 0; i < pState->nQueues; i++)
+            {
+                PVQUEUE pQueue = &pState->Queues[i];
+                rc = SSMR3GetBool(pSSM, &pQueue->fEnabled);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetU16( pSSM, &pQueue->uMsixVector);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetGCPhys(pSSM, &pQueue->VRing.addrDescriptors);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetGCPhys(pSSM, &pQueue->VRing.addrAvail);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetGCPhys(pSSM, &pQueue->VRing.addrUsed);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetBool(pSSM, &pQueue->fAvailWrap);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetBool(pSSM, &pQueue->fUsedWrap);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetU16( pSSM, &pQueue->uSignalledUsed);
+                AssertRCReturn(rc, rc);
+                rc = SSMR3GetBool(pSSM, &pQueue->fSignalledUsedValid);
+                AssertRCReturn(rc, rc);
+                AssertLogRelMsgReturn(pQueue->VRing.uSize <= pQueue->uMaxSize,
+                                      ("queue %u: uSize=%u uMaxSize=%u\n", i, pQueue->VRing.uSize, pQueue->uMaxSize),
+                                      VERR_SSM_LOAD_CONFIG_MISMATCH);
+            }
+        }
     }
 
     vpciDumpState(pState, "vpciLoadExec");
@@ -845,7 +1420,8 @@ static DECLCALLBACK(void) vpciConfigure(PDMPCIDEV& pci,
     PCIDevSetVendorId(&pci, DEVICE_PCI_VENDOR_ID);
     PCIDevSetDeviceId(&pci, DEVICE_PCI_BASE_ID + uDeviceId);
     PDMPciDevSetWord(&pci,  VBOX_PCI_SUBSYSTEM_VENDOR_ID, DEVICE_PCI_SUBSYSTEM_VENDOR_ID);
-    PDMPciDevSetWord(&pci,  VBOX_PCI_SUBSYSTEM_ID, DEVICE_PCI_SUBSYSTEM_BASE_ID + uDeviceId);
+    /* The legacy subsystem ID is the virtio device type which only matches the PCI device ID offset for net and blk. */
+    PDMPciDevSetWord(&pci,  VBOX_PCI_SUBSYSTEM_ID, uDeviceId == VIRTIO_SCSI_ID ? 8 : DEVICE_PCI_SUBSYSTEM_BASE_ID + uDeviceId);
 
     /* ABI version, must be equal 0 as of 2.6.30 kernel. */
     PDMPciDevSetByte(&pci,  VBOX_PCI_REVISION_ID,          0x00);
@@ -854,11 +1430,6 @@ static DECLCALLBACK(void) vpciConfigure(PDMPCIDEV& pci,
     PDMPciDevSetWord(&pci,  VBOX_PCI_CLASS_DEVICE,         uClass);
     /* Interrupt Pin: INTA# */
     PDMPciDevSetByte(&pci,  VBOX_PCI_INTERRUPT_PIN,        0x01);
-
-#ifdef VBOX_WITH_MSI_DEVICES
-    PCIDevSetCapabilityList(&pci, 0x80);
-    PCIDevSetStatus( &pci,  VBOX_PCI_STATUS_CAP_LIST);
-#endif
 }
 
 #ifdef VBOX_WITH_STATISTICS
@@ -904,23 +1475,6 @@ int vpciConstruct(PPDMDEVINS pDevIns, VPCISTATE *pState,
     if (RT_FAILURE(rc))
         return rc;
 
-#ifdef VBOX_WITH_MSI_DEVICES
-#if 0
-    {
-        PDMMSIREG aMsiReg;
-
-        RT_ZERO(aMsiReg);
-        aMsiReg.cMsixVectors = 1;
-        aMsiReg.iMsixCapOffset = 0x80;
-        aMsiReg.iMsixNextOffset = 0x0;
-        aMsiReg.iMsixBar = 0;
-        rc = PDMDevHlpPCIRegisterMsi(pDevIns, &aMsiReg);
-        if (RT_FAILURE (rc))
-            PCIDevSetCapabilityList(&pState->pciDevice, 0x0);
-    }
-#endif
-#endif
-
     /* Status driver */
     PPDMIBASE pBase;
     rc = PDMDevHlpDriverAttach(pDevIns, PDM_STATUS_LUN, &pState->IBase, &pBase, "Status Port");
@@ -928,7 +1482,8 @@ int vpciConstruct(PPDMDEVINS pDevIns, VPCISTATE *pState,
         return PDMDEV_SET_ERROR(pDevIns, rc, N_("Failed to attach the status LUN"));
     pState->pLedsConnector = PDMIBASE_QUERY_INTERFACE(pBase, PDMILEDCONNECTORS);
 
-    pState->nQueues = nQueues;
+    pState->nQueues     = nQueues;
+    pState->uMsixConfig = VPCI_MSIX_NO_VECTOR;
 
 #if defined(VBOX_WITH_STATISTICS)
     PDMDevHlpSTAMRegisterF(pDevIns, &pState->StatIOReadR3,           STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_CALL, "Profiling IO reads in R3",      vpciCounter(pcszNameFmt, "IO/ReadR3"), iInstance);
@@ -947,6 +1502,334 @@ int vpciConstruct(PPDMDEVINS pDevIns, VPCISTATE *pState,
     return rc;
 }
 
+/**
+ * Writes a virtio vendor specific capability (virtio_pci_cap) into the PCI
+ * configuration space.
+ */
+static void vpciR3SetCap(PPDMPCIDEV pPciDev, uint8_t offCap, uint8_t offNext, uint8_t cbCap,
+                         uint8_t uCfgType, uint8_t iBar, uint32_t offBar, uint32_t cbBar)
+{
+    PDMPciDevSetByte(pPciDev,  offCap + 0,  VBOX_PCI_CAP_ID_VNDR);
+    PDMPciDevSetByte(pPciDev,  offCap + 1,  offNext);
+    PDMPciDevSetByte(pPciDev,  offCap + 2,  cbCap);
+    PDMPciDevSetByte(pPciDev,  offCap + 3,  uCfgType);
+    PDMPciDevSetByte(pPciDev,  offCap + 4,  iBar);
+    PDMPciDevSetDWord(pPciDev, offCap + 8,  offBar);
+    PDMPciDevSetDWord(pPciDev, offCap + 12, cbBar);
+}
+
+/**
+ * Returns the modern feature bits offered in the given 32-bit feature word.
+ */
+static uint32_t vpciR3GetModernFeatures(PVPCISTATE pState, uint32_t uSelect)
+{
+    switch (uSelect)
+    {
+        case 0:
+            /* NOTIFY_ON_EMPTY is a legacy only feature. */
+            return vpciGetHostFeatures(pState, pState->pCallbacksR3->pfnGetHostFeatures) & ~VPCI_F_NOTIFY_ON_EMPTY;
+        case 1:
+            return VPCI_F_HI_VERSION_1
+                 | (pState->fModernFlags & VPCI_MODERN_F_RING_PACKED ? VPCI_F_HI_RING_PACKED : 0)
+                 | pState->uHostFeaturesHi;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Reads from the common configuration structure of the modern transport.
+ */
+static void vpciR3CommonRead(PVPCISTATE pState, uint32_t off, void *pv, unsigned cb)
+{
+    PVQUEUE       pQueue = &pState->Queues[pState->uQueueSelector];
+    VPCICOMMONCFG Cfg;
+
+    Cfg.uDeviceFeatureSelect = pState->uDeviceFeatureSelect;
+    Cfg.uDeviceFeature       = vpciR3GetModernFeatures(pState, pState->uDeviceFeatureSelect);
+    Cfg.uDriverFeatureSelect = pState->uDriverFeatureSelect;
+    Cfg.uDriverFeature       = pState->uDriverFeatureSelect == 0 ? pState->uGuestFeatures
+                             : pState->uDriverFeatureSelect == 1 ? pState->uGuestFeaturesHi : 0;
+    Cfg.uMsixConfig          = pState->uMsixConfig;
+    Cfg.cQueues              = (uint16_t)pState->nQueues;
+    Cfg.uDeviceStatus        = pState->uStatus;
+    Cfg.uConfigGeneration    = pState->uConfigGeneration;
+    Cfg.uQueueSelect         = pState->uQueueSelector;
+    Cfg.uQueueSize           = pQueue->VRing.uSize;
+    Cfg.uQueueMsixVector     = pQueue->uMsixVector;
+    Cfg.uQueueEnable         = pQueue->fEnabled;
+    Cfg.uQueueNotifyOff      = pState->uQueueSelector;
+    Cfg.GCPhysQueueDesc      = pQueue->VRing.addrDescriptors;
+    Cfg.GCPhysQueueDriver    = pQueue->VRing.addrAvail;
+    Cfg.GCPhysQueueDevice    = pQueue->VRing.addrUsed;
+
+    if (off + cb <= sizeof(Cfg))
+        memcpy(pv, (uint8_t *)&Cfg + off, cb);
+    else
+        memset(pv, 0xff, cb);
+}
+
+/**
+ * Replaces the low or high half of a queue address.
+ */
+DECLINLINE(void) vpciR3SetAddrHalf(RTGCPHYS *pGCPhys, uint32_t off, uint32_t u32)
+{
+    if (off & 4)
+        *pGCPhys = (*pGCPhys & UINT32_MAX) | ((RTGCPHYS)u32 << 32);
+    else
+        *pGCPhys = (*pGCPhys & ~(RTGCPHYS)UINT32_MAX) | u32;
+}
+
+/**
+ * Writes to the common configuration structure of the modern transport.
+ */
+static int vpciR3CommonWrite(PVPCISTATE pState, uint32_t off, uint32_t u32, unsigned cb)
+{
+    PVQUEUE pQueue = &pState->Queues[pState->uQueueSelector];
+    int     rc     = VINF_SUCCESS;
+
+    switch (off)
+    {
+        case VPCI_COMMON_DEVICE_FEATURE_SELECT:
+            pState->uDeviceFeatureSelect = u32;
+            break;
+        case VPCI_COMMON_DRIVER_FEATURE_SELECT:
+            pState->uDriverFeatureSelect = u32;
+            break;
+        case VPCI_COMMON_DRIVER_FEATURE:
+            /* Features are locked once the driver set FEATURES_OK. */
+            if (pState->uStatus & VPCI_STATUS_FEATURES_OK)
+                break;
+            if (pState->uDriverFeatureSelect == 0)
+                pState->uGuestFeatures   = u32 & vpciR3GetModernFeatures(pState, 0);
+            else if (pState->uDriverFeatureSelect == 1)
+                pState->uGuestFeaturesHi = u32 & vpciR3GetModernFeatures(pState, 1);
+            break;
+        case VPCI_COMMON_MSIX_CONFIG:
+            pState->uMsixConfig = vpciCheckMsixVector(pState, u32);
+            break;
+        case VPCI_COMMON_DEVICE_STATUS:
+            rc = vpciSetStatus(pState, (uint8_t)u32, pState->pCallbacksR3);
+            break;
+        case VPCI_COMMON_QUEUE_SELECT:
+            if ((u32 & 0xffff) < pState->nQueues)
+                pState->uQueueSelector = (uint16_t)u32;
+            else
+                Log(("%s vpciR3CommonWrite: Invalid queue selected: %#06x\n", INSTANCE(pState), u32));
+            break;
+        case VPCI_COMMON_QUEUE_SIZE:
+        {
+            uint16_t uSize = (uint16_t)u32;
+            if (   !pQueue->fEnabled
+                && uSize
+                && uSize <= pQueue->uMaxSize
+                && (vpciIsRingPacked(pState) || RT_IS_POWER_OF_TWO(uSize)))
+                pQueue->VRing.uSize = uSize;
+            else
+                Log(("%s vpciR3CommonWrite: Invalid queue size %u for queue %s\n", INSTANCE(pState), uSize, pQueue->pcszName));
+            break;
+        }
+        case VPCI_COMMON_QUEUE_MSIX_VECTOR:
+            pQueue->uMsixVector = vpciCheckMsixVector(pState, u32);
+            break;
+        case VPCI_COMMON_QUEUE_ENABLE:
+            /* Queues can only be disabled by a device reset. */
+            if ((u32 & 0xffff) == 1 && !pQueue->fEnabled)
+                vqueueEnable(pQueue);
+            break;
+        case VPCI_COMMON_QUEUE_DESC:
+        case VPCI_COMMON_QUEUE_DESC + 4:
+            if (!pQueue->fEnabled)
+                vpciR3SetAddrHalf(&pQueue->VRing.addrDescriptors, off, u32);
+            break;
+        case VPCI_COMMON_QUEUE_DRIVER:
+        case VPCI_COMMON_QUEUE_DRIVER + 4:
+            if (!pQueue->fEnabled)
+                vpciR3SetAddrHalf(&pQueue->VRing.addrAvail, off, u32);
+            break;
+        case VPCI_COMMON_QUEUE_DEVICE:
+        case VPCI_COMMON_QUEUE_DEVICE + 4:
+            if (!pQueue->fEnabled)
+                vpciR3SetAddrHalf(&pQueue->VRing.addrUsed, off, u32);
+            break;
+        default:
+            Log(("%s vpciR3CommonWrite: Ignoring write to read-only offset %#x cb=%u\n", INSTANCE(pState), off, cb));
+            break;
+    }
+    return rc;
+}
+
+/**
+ * @callback_method_impl{FNIOMMMIOREAD, The modern transport BAR.}
+ */
+static DECLCALLBACK(int) vpciR3MmioRead(PPDMDEVINS pDevIns, void *pvUser, RTGCPHYS GCPhysAddr, void *pv, unsigned cb)
+{
+    PVPCISTATE pState = (PVPCISTATE)pvUser;
+    uint32_t   off    = (uint32_t)(GCPhysAddr - pState->GCPhysModern);
+    int        rc     = VINF_SUCCESS;
+    RT_NOREF(pDevIns);
+    STAM_PROFILE_ADV_START(&pState->CTX_SUFF(StatIORead), a);
+
+    if (off < VPCI_MODERN_OFF_COMMON + VPCI_COMMON_SIZE)
+        vpciR3CommonRead(pState, off - VPCI_MODERN_OFF_COMMON, pv, cb);
+    else if (off == VPCI_MODERN_OFF_ISR)
+    {
+        /* Reading the ISR clears it, as with the legacy port. */
+        memset(pv, 0, cb);
+        *(uint8_t *)pv = pState->uISR;
+        pState->uISR = 0;
+        vpciLowerInterrupt(pState);
+    }
+    else if (off >= VPCI_MODERN_OFF_DEVICE && off < VPCI_MODERN_OFF_DEVICE + pState->cbConfig)
+    {
+        uint32_t u32 = 0;
+        rc = pState->pCallbacksR3->pfnGetConfig(pState, off - VPCI_MODERN_OFF_DEVICE, cb, &u32);
+        if (RT_SUCCESS(rc))
+            memcpy(pv, &u32, RT_MIN(cb, sizeof(u32)));
+        else
+        {
+            memset(pv, 0xff, cb);
+            rc = VINF_SUCCESS;
+        }
+    }
+    else
+        memset(pv, 0, cb);
+
+    Log3(("%s vpciR3MmioRead: off=%#x cb=%u rc=%Rrc\n", INSTANCE(pState), off, cb, rc));
+    STAM_PROFILE_ADV_STOP(&pState->CTX_SUFF(StatIORead), a);
+    return rc;
+}
+
+/**
+ * @callback_method_impl{FNIOMMMIOWRITE, The modern transport BAR.}
+ */
+static DECLCALLBACK(int) vpciR3MmioWrite(PPDMDEVINS pDevIns, void *pvUser, RTGCPHYS GCPhysAddr, void const *pv, unsigned cb)
+{
+    PVPCISTATE pState = (PVPCISTATE)pvUser;
+    uint32_t   off    = (uint32_t)(GCPhysAddr - pState->GCPhysModern);
+    int        rc     = VINF_SUCCESS;
+    RT_NOREF(pDevIns);
+    STAM_PROFILE_ADV_START(&pState->CTX_SUFF(StatIOWrite), a);
+
+    if (off < VPCI_MODERN_OFF_COMMON + VPCI_COMMON_SIZE)
+    {
+        uint64_t u64 = 0;
+        memcpy(&u64, pv, RT_MIN(cb, sizeof(u64)));
+        if (cb == 8)
+        {
+            /* 64-bit accesses to the queue addresses are split up like the spec allows. */
+            rc = vpciR3CommonWrite(pState, off, (uint32_t)u64, 4);
+            if (RT_SUCCESS(rc))
+                rc = vpciR3CommonWrite(pState, off + 4, (uint32_t)(u64 >> 32), 4);
+        }
+        else
+            rc = vpciR3CommonWrite(pState, off, (uint32_t)u64, cb);
+    }
+    else if (off >= VPCI_MODERN_OFF_DEVICE && off < VPCI_MODERN_OFF_DEVICE + pState->cbConfig)
+    {
+        uint32_t u32 = 0;
+        memcpy(&u32, pv, RT_MIN(cb, sizeof(u32)));
+        rc = pState->pCallbacksR3->pfnSetConfig(pState, off - VPCI_MODERN_OFF_DEVICE, cb, &u32);
+    }
+    else if (off >= VPCI_MODERN_OFF_NOTIFY)
+    {
+        /* The queue index is implied by the offset, the written value is the same index. */
+        vpciR3QueueNotify(pState, (off - VPCI_MODERN_OFF_NOTIFY) / VPCI_NOTIFY_OFF_MULTIPLIER);
+    }
+    else
+        Log(("%s vpciR3MmioWrite: Ignoring write to off=%#x cb=%u\n", INSTANCE(pState), off, cb));
+
+    Log3(("%s vpciR3MmioWrite: off=%#x cb=%u rc=%Rrc\n", INSTANCE(pState), off, cb, rc));
+    STAM_PROFILE_ADV_STOP(&pState->CTX_SUFF(StatIOWrite), a);
+    return rc;
+}
+
+/**
+ * @callback_method_impl{FNPCIIOREGIONMAP, The modern transport BAR.}
+ */
+static DECLCALLBACK(int) vpciR3ModernMap(PPDMDEVINS pDevIns, PPDMPCIDEV pPciDev, uint32_t iRegion,
+                                         RTGCPHYS GCPhysAddress, RTGCPHYS cb, PCIADDRESSSPACE enmType)
+{
+    RT_NOREF(pPciDev, iRegion, enmType);
+    VPCISTATE *pState = PDMINS_2_DATA(pDevIns, VPCISTATE *);
+
+    pState->GCPhysModern = GCPhysAddress;
+    return PDMDevHlpMMIORegister(pDevIns, GCPhysAddress, cb, pState,
+                                 IOMMMIO_FLAGS_READ_PASSTHRU | IOMMMIO_FLAGS_WRITE_PASSTHRU,
+                                 vpciR3MmioWrite, vpciR3MmioRead, "VirtIO-Modern");
+}
+
+/**
+ * Adds the virtio 1.0 (modern) transport to a device constructed by
+ * vpciConstruct, making it a transitional device.
+ *
+ * The modern transport lives in a memory BAR described by vendor specific
+ * capabilities. Each queue gets its own MSI-X vector, plus one for
+ * configuration changes, if the chipset supports MSI-X; otherwise the device
+ * keeps using INTx and the ISR.
+ *
+ * @returns VBox status code.
+ * @param   pDevIns     The device instance.
+ * @param   pState      The device state structure.
+ * @param   pCallbacks  The device callbacks, must stay valid.
+ * @param   cbConfig    The size of the device specific configuration.
+ * @param   fFlags      VPCI_MODERN_F_XXX.
+ */
+int vpciConstructModern(PPDMDEVINS pDevIns, VPCISTATE *pState, PCVPCIIOCALLBACKS pCallbacks,
+                        uint32_t cbConfig, uint32_t fFlags)
+{
+    AssertReturn(cbConfig <= VPCI_MODERN_OFF_NOTIFY - VPCI_MODERN_OFF_DEVICE, VERR_INVALID_PARAMETER);
+    AssertReturn(pState->nQueues * VPCI_NOTIFY_OFF_MULTIPLIER <= VPCI_MODERN_BAR_SIZE - VPCI_MODERN_OFF_NOTIFY,
+                 VERR_INVALID_PARAMETER);
+
+    pState->fModern      = true;
+    pState->fModernFlags = fFlags;
+    pState->cbConfig     = cbConfig;
+    pState->pCallbacksR3 = pCallbacks;
+    pState->uMsixConfig  = VPCI_MSIX_NO_VECTOR;
+
+    PPDMPCIDEV pPciDev = &pState->pciDevice;
+    vpciR3SetCap(pPciDev, VPCI_CAP_OFF_COMMON, VPCI_CAP_OFF_NOTIFY, 16, VPCI_CAP_COMMON_CFG,
+                 VPCI_MODERN_BAR, VPCI_MODERN_OFF_COMMON, VPCI_COMMON_SIZE);
+    vpciR3SetCap(pPciDev, VPCI_CAP_OFF_NOTIFY, VPCI_CAP_OFF_ISR, 20, VPCI_CAP_NOTIFY_CFG,
+                 VPCI_MODERN_BAR, VPCI_MODERN_OFF_NOTIFY, pState->nQueues * VPCI_NOTIFY_OFF_MULTIPLIER);
+    PDMPciDevSetDWord(pPciDev, VPCI_CAP_OFF_NOTIFY + 16, VPCI_NOTIFY_OFF_MULTIPLIER);
+    vpciR3SetCap(pPciDev, VPCI_CAP_OFF_ISR, VPCI_CAP_OFF_DEVICE, 16, VPCI_CAP_ISR_CFG,
+                 VPCI_MODERN_BAR, VPCI_MODERN_OFF_ISR, 1);
+    vpciR3SetCap(pPciDev, VPCI_CAP_OFF_DEVICE, 0, 16, VPCI_CAP_DEVICE_CFG,
+                 VPCI_MODERN_BAR, VPCI_MODERN_OFF_DEVICE, cbConfig);
+    PDMPciDevSetCapabilityList(pPciDev, VPCI_CAP_OFF_COMMON);
+    PDMPciDevSetStatus(pPciDev, PDMPciDevGetStatus(pPciDev) | VBOX_PCI_STATUS_CAP_LIST);
+
+    int rc = PDMDevHlpPCIIORegionRegister(pDevIns, VPCI_MODERN_BAR, VPCI_MODERN_BAR_SIZE,
+                                          PCI_ADDRESS_SPACE_MEM, vpciR3ModernMap);
+    if (RT_FAILURE(rc))
+        return PDMDEV_SET_ERROR(pDevIns, rc, N_("Failed to register the VirtIO modern transport BAR"));
+
+#ifdef VBOX_WITH_MSI_DEVICES
+    PDMMSIREG MsiReg;
+    RT_ZERO(MsiReg);
+    MsiReg.cMsixVectors    = pState->nQueues + 1;
+    MsiReg.iMsixCapOffset  = VPCI_CAP_OFF_MSIX;
+    MsiReg.iMsixNextOffset = 0;
+    MsiReg.iMsixBar        = VPCI_MSIX_BAR;
+    rc = PDMDevHlpPCIRegisterMsi(pDevIns, &MsiReg);
+    if (RT_SUCCESS(rc))
+    {
+        pState->cMsixVectors = MsiReg.cMsixVectors;
+        PDMPciDevSetByte(pPciDev, VPCI_CAP_OFF_DEVICE + 1, VPCI_CAP_OFF_MSIX);
+    }
+    else
+    {
+        /* PIIX3 has no MSI-X support, the device works fine with INTx. */
+        LogRel(("%s: MSI-X not available, using INTx (%Rrc)\n", INSTANCE(pState), rc));
+        rc = VINF_SUCCESS;
+    }
+#endif
+
+    return rc;
+}
+
 /**
  * Destruct PCI-related part of device.
  *
@@ -1008,9 +1891,8 @@ PVQUEUE vpciAddQueue(VPCISTATE* pState, unsigned uSize, PFNVPCIQUEUECALLBACK pfn
     }
     else
     {
-        pQueue->VRing.uSize = uSize;
-        pQueue->VRing.addrDescriptors = 0;
-        pQueue->uPageNumber = 0;
+        pQueue->uMaxSize = uSize;
+        vqueueReset(pQueue);
         pQueue->pfnCallback = pfnCallback;
         pQueue->pcszName = pcszName;
     }
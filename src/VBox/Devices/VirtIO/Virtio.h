@@ -22,6 +22,7 @@
 #endif
 
 #include <iprt/ctype.h>
+#include <VBox/msi.h>
 
 
 /** @name Saved state versions.
@@ -31,7 +32,8 @@
  * for example.
  */
 #define VIRTIO_SAVEDSTATE_VERSION_3_1_BETA1 1
-#define VIRTIO_SAVEDSTATE_VERSION           2
+#define VIRTIO_SAVEDSTATE_VERSION_LEGACY    2
+#define VIRTIO_SAVEDSTATE_VERSION           3
 /** @} */
 
 #define DEVICE_PCI_VENDOR_ID                0x1AF4
@@ -39,7 +41,9 @@
 #define DEVICE_PCI_SUBSYSTEM_VENDOR_ID      0x1AF4
 #define DEVICE_PCI_SUBSYSTEM_BASE_ID       1
 
-#define VIRTIO_MAX_NQUEUES                  3
+/** Maximum number of queues a device can have, enough for a control queue
+ * plus a queue pair (or request queue) for every vCPU of large guests. */
+#define VIRTIO_MAX_NQUEUES                  64
 
 #define VPCI_HOST_FEATURES                  0x0
 #define VPCI_GUEST_FEATURES                 0x4
@@ -50,6 +54,13 @@
 #define VPCI_STATUS                         0x12
 #define VPCI_ISR                            0x13
 #define VPCI_CONFIG                         0x14
+/** @name Legacy registers present while MSI-X is enabled, the device
+ * specific configuration moves to VPCI_CONFIG_MSIX then.
+ * @{ */
+#define VPCI_CONFIG_VECTOR                  0x14
+#define VPCI_QUEUE_VECTOR                   0x16
+#define VPCI_CONFIG_MSIX                    0x18
+/** @} */
 
 #define VPCI_ISR_QUEUE                      0x1
 #define VPCI_ISR_CONFIG                     0x3
@@ -57,18 +68,90 @@
 #define VPCI_STATUS_ACK                     0x01
 #define VPCI_STATUS_DRV                     0x02
 #define VPCI_STATUS_DRV_OK                  0x04
+#define VPCI_STATUS_FEATURES_OK             0x08
+#define VPCI_STATUS_NEEDS_RESET             0x40
 #define VPCI_STATUS_FAILED                  0x80
 
+/** MSI-X vector value meaning no vector is assigned. */
+#define VPCI_MSIX_NO_VECTOR                 0xffff
+
 #define VPCI_F_NOTIFY_ON_EMPTY              0x01000000
 #define VPCI_F_ANY_LAYOUT                   0x08000000
 #define VPCI_F_RING_INDIRECT_DESC           0x10000000
 #define VPCI_F_RING_EVENT_IDX               0x20000000
 #define VPCI_F_BAD_FEATURE                  0x40000000
 
+/** @name Feature bits 32 thru 63, only negotiable through the modern transport.
+ * @{ */
+#define VPCI_F_HI_VERSION_1                 0x00000001  /**< VIRTIO_F_VERSION_1 (bit 32). */
+#define VPCI_F_HI_RING_PACKED               0x00000004  /**< VIRTIO_F_RING_PACKED (bit 34). */
+/** @} */
+
+/** @name Virtio 1.0 PCI transport (vendor specific capabilities).
+ * @{ */
+#define VPCI_CAP_COMMON_CFG                 1
+#define VPCI_CAP_NOTIFY_CFG                 2
+#define VPCI_CAP_ISR_CFG                    3
+#define VPCI_CAP_DEVICE_CFG                 4
+
+/** Offset of the first capability in PCI config space. */
+#define VPCI_CAP_OFF_COMMON                 0x40
+#define VPCI_CAP_OFF_NOTIFY                 0x50
+#define VPCI_CAP_OFF_ISR                    0x64
+#define VPCI_CAP_OFF_DEVICE                 0x74
+#define VPCI_CAP_OFF_MSIX                   0x84
+
+/** The BAR holding the MSI-X table. */
+#define VPCI_MSIX_BAR                       2
+/** The BAR holding the modern transport structures. */
+#define VPCI_MODERN_BAR                     4
+/** Layout of the modern BAR, one page per structure. */
+#define VPCI_MODERN_OFF_COMMON              0x0000
+#define VPCI_MODERN_OFF_ISR                 0x1000
+#define VPCI_MODERN_OFF_DEVICE              0x2000
+#define VPCI_MODERN_OFF_NOTIFY              0x3000
+#define VPCI_MODERN_BAR_SIZE                0x4000
+/** Distance between the notification addresses of two queues. */
+#define VPCI_NOTIFY_OFF_MULTIPLIER          4
+
+/** Registers of the common configuration structure (virtio_pci_common_cfg).
+ * @{ */
+#define VPCI_COMMON_DEVICE_FEATURE_SELECT   0x00
+#define VPCI_COMMON_DEVICE_FEATURE          0x04
+#define VPCI_COMMON_DRIVER_FEATURE_SELECT   0x08
+#define VPCI_COMMON_DRIVER_FEATURE          0x0c
+#define VPCI_COMMON_MSIX_CONFIG             0x10
+#define VPCI_COMMON_NUM_QUEUES              0x12
+#define VPCI_COMMON_DEVICE_STATUS           0x14
+#define VPCI_COMMON_CONFIG_GENERATION       0x15
+#define VPCI_COMMON_QUEUE_SELECT            0x16
+#define VPCI_COMMON_QUEUE_SIZE              0x18
+#define VPCI_COMMON_QUEUE_MSIX_VECTOR       0x1a
+#define VPCI_COMMON_QUEUE_ENABLE            0x1c
+#define VPCI_COMMON_QUEUE_NOTIFY_OFF        0x1e
+#define VPCI_COMMON_QUEUE_DESC              0x20
+#define VPCI_COMMON_QUEUE_DRIVER            0x28
+#define VPCI_COMMON_QUEUE_DEVICE            0x30
+#define VPCI_COMMON_SIZE                    0x38
+/** @} */
+
+/** @name Flags for vpciConstructModern.
+ * @{ */
+/** The device accesses its queues through the vqueueXxx API only and can
+ * therefore offer packed rings. */
+#define VPCI_MODERN_F_RING_PACKED           RT_BIT_32(0)
+/** @} */
+/** @} */
+
 #define VRINGDESC_MAX_SIZE                  (2 * 1024 * 1024)
 #define VRINGDESC_F_NEXT                    0x01
 #define VRINGDESC_F_WRITE                   0x02
 #define VRINGDESC_F_INDIRECT                0x04
+/** @name Packed ring descriptor flags.
+ * @{ */
+#define VRINGDESC_F_AVAIL                   0x0080
+#define VRINGDESC_F_USED                    0x8000
+/** @} */
 
 typedef struct VRingDesc
 {
@@ -104,8 +187,40 @@ typedef struct VRingUsed
 } VRINGUSED;
 typedef VRINGUSED *PVRINGUSED;
 
+/**
+ * Packed ring descriptor, used for both directions.
+ */
+typedef struct VRingPackedDesc
+{
+    uint64_t u64Addr;
+    uint32_t uLen;
+    uint16_t u16Id;
+    uint16_t u16Flags;
+} VRINGPACKEDDESC;
+typedef VRINGPACKEDDESC *PVRINGPACKEDDESC;
+
+#define VRINGPACKED_EVENT_F_ENABLE          0x0
+#define VRINGPACKED_EVENT_F_DISABLE         0x1
+#define VRINGPACKED_EVENT_F_DESC            0x2
+
+/**
+ * Packed ring event suppression structure, the driver area holds the one
+ * written by the driver, the device area the one written by us.
+ */
+typedef struct VRingPackedEvent
+{
+    uint16_t u16OffWrap;
+    uint16_t u16Flags;
+} VRINGPACKEDEVENT;
+
 #define VRING_MAX_SIZE 1024
 
+/**
+ * Guest ring location.
+ *
+ * With packed rings addrAvail is the driver and addrUsed the device event
+ * suppression area.
+ */
 typedef struct VRing
 {
     uint16_t   uSize;
@@ -129,9 +244,25 @@ typedef FNVPCIQUEUECALLBACK *PFNVPCIQUEUECALLBACK;
 typedef struct VQueue
 {
     VRING    VRing;
+    /** Next available element; with packed rings the position in the ring. */
     uint16_t uNextAvailIndex;
+    /** Next used element; with packed rings the position in the ring. */
     uint16_t uNextUsedIndex;
     uint32_t uPageNumber;
+    /** Queue size set up by the device, the guest may only lower it. */
+    uint16_t uMaxSize;
+    /** MSI-X vector for used buffer notifications. */
+    uint16_t uMsixVector;
+    /** uNextUsedIndex at the last guest notification (event index). */
+    uint16_t uSignalledUsed;
+    /** Whether uSignalledUsed is valid, cleared whenever the ring is set up. */
+    bool     fSignalledUsedValid;
+    /** Set when the ring is set up by the guest. */
+    bool     fEnabled;
+    /** Packed ring: wrap counter for uNextAvailIndex. */
+    bool     fAvailWrap;
+    /** Packed ring: wrap counter for uNextUsedIndex. */
+    bool     fUsedWrap;
     R3PTRTYPE(PFNVPCIQUEUECALLBACK) pfnCallback;
     R3PTRTYPE(const char *)         pcszName;
 } VQUEUE;
@@ -159,6 +290,7 @@ enum VirtioDeviceType
 {
     VIRTIO_NET_ID = 0,
     VIRTIO_BLK_ID = 1,
+    VIRTIO_SCSI_ID = 4,     /**< Transitional device 0x1004, subsystem ID is the virtio type (8). */
     VIRTIO_32BIT_HACK = 0x7fffffff
 };
 
@@ -207,9 +339,24 @@ typedef struct VPCIState_st
     uint8_t                uStatus; /**< Device Status (bits are device-specific). */
     uint8_t                uISR;                   /**< Interrupt Status Register. */
 
-#if HC_ARCH_BITS != 64
-    uint32_t               padding3;
-#endif
+    /** @name Modern transport, see vpciConstructModern.
+     * @{ */
+    uint32_t               uGuestFeaturesHi;       /**< Negotiated feature bits 32 thru 63. */
+    uint32_t               uDeviceFeatureSelect;   /**< Selects the device feature word to read. */
+    uint32_t               uDriverFeatureSelect;   /**< Selects the driver feature word to write. */
+    uint16_t               uMsixConfig;            /**< MSI-X vector for configuration changes. */
+    uint16_t               cMsixVectors;           /**< Number of MSI-X vectors, 0 if MSI-X is unavailable. */
+    uint8_t                uConfigGeneration;      /**< Bumped whenever the device configuration changes. */
+    bool                   fModern;                /**< Whether the modern transport is exposed. */
+    uint16_t               padding4;
+    uint32_t               fModernFlags;           /**< VPCI_MODERN_F_XXX. */
+    uint32_t               cbConfig;               /**< Size of the device specific configuration. */
+    RTGCPHYS               GCPhysModern;           /**< Where the modern BAR is mapped. */
+    /** The device callbacks, for the ring-3 only modern BAR handlers. */
+    R3PTRTYPE(const struct VPCIIOCALLBACKS *) pCallbacksR3;
+    /** Device specific feature bits 32 thru 63, only offered by the modern transport. */
+    uint32_t               uHostFeaturesHi;
+    /** @} */
 
     uint32_t               nQueues;       /**< Actual number of queues used. */
     VQUEUE                 Queues[VIRTIO_MAX_NQUEUES];
@@ -274,9 +421,28 @@ int   vpciConstruct(PPDMDEVINS pDevIns, VPCISTATE *pState, int iInstance, const
 int   vpciDestruct(VPCISTATE* pState);
 void  vpciRelocate(PPDMDEVINS pDevIns, RTGCINTPTR offDelta);
 void  vpciReset(PVPCISTATE pState);
+int   vpciConstructModern(PPDMDEVINS pDevIns, VPCISTATE *pState, PCVPCIIOCALLBACKS pCallbacks, uint32_t cbConfig,
+                          uint32_t fFlags);
 void *vpciQueryInterface(struct PDMIBASE *pInterface, const char *pszIID);
 PVQUEUE vpciAddQueue(VPCISTATE* pState, unsigned uSize, PFNVPCIQUEUECALLBACK pfnCallback, const char *pcszName);
 
+/**
+ * Checks whether the guest enabled MSI-X for the device.
+ */
+DECLINLINE(bool) vpciIsMsixEnabled(VPCISTATE *pState)
+{
+    return pState->cMsixVectors
+        && (PDMPciDevGetWord(&pState->pciDevice, VPCI_CAP_OFF_MSIX + VBOX_MSIX_CAP_MESSAGE_CONTROL) & VBOX_PCI_MSIX_FLAGS_ENABLE);
+}
+
+/**
+ * Checks whether the guest negotiated packed rings.
+ */
+DECLINLINE(bool) vpciIsRingPacked(VPCISTATE *pState)
+{
+    return RT_BOOL(pState->uGuestFeaturesHi & VPCI_F_HI_RING_PACKED);
+}
+
 #define VPCI_CS
 DECLINLINE(int) vpciCsEnter(VPCISTATE *pState, int rcBusy)
 {
@@ -298,6 +464,11 @@ DECLINLINE(void) vpciCsLeave(VPCISTATE *pState)
 }
 
 void vringSetNotification(PVPCISTATE pState, PVRING pVRing, bool fEnabled);
+/* The following raw ring accessors only handle split rings, devices using them
+   must not pass VPCI_MODERN_F_RING_PACKED to vpciConstructModern. */
+void vringReadDesc(PVPCISTATE pState, PVRING pVRing, uint32_t uIndex, PVRINGDESC pDesc);
+uint16_t vringReadAvail(PVPCISTATE pState, PVRING pVRing, uint32_t uIndex);
+void vringWriteUsedElem(PVPCISTATE pState, PVRING pVRing, uint32_t uIndex, uint32_t uId, uint32_t uLen);
 
 DECLINLINE(uint16_t) vringReadAvailIndex(PVPCISTATE pState, PVRING pVRing)
 {
@@ -309,8 +480,10 @@ DECLINLINE(uint16_t) vringReadAvailIndex(PVPCISTATE pState, PVRING pVRing)
     return tmp;
 }
 
+bool vqueuePackedIsEmpty(PVPCISTATE pState, PVQUEUE pQueue);
 bool vqueueSkip(PVPCISTATE pState, PVQUEUE pQueue);
 bool vqueueGet(PVPCISTATE pState, PVQUEUE pQueue, PVQUEUEELEM pElem, bool fRemove = true);
+uint16_t vqueueCountAvailIn(PVPCISTATE pState, PVQUEUE pQueue, uint32_t cbNeeded);
 void vqueuePut(PVPCISTATE pState, PVQUEUE pQueue, PVQUEUEELEM pElem, uint32_t uLen, uint32_t uReserved = 0);
 void vqueueNotify(PVPCISTATE pState, PVQUEUE pQueue);
 void vqueueSync(PVPCISTATE pState, PVQUEUE pQueue);
@@ -323,11 +496,13 @@ DECLINLINE(bool) vqueuePeek(PVPCISTATE pState, PVQUEUE pQueue, PVQUEUEELEM pElem
 DECLINLINE(bool) vqueueIsReady(PVPCISTATE pState, PVQUEUE pQueue)
 {
     NOREF(pState);
-    return !!pQueue->VRing.addrAvail;
+    return pQueue->fEnabled;
 }
 
 DECLINLINE(bool) vqueueIsEmpty(PVPCISTATE pState, PVQUEUE pQueue)
 {
+    if (vpciIsRingPacked(pState))
+        return vqueuePackedIsEmpty(pState, pQueue);
     return (vringReadAvailIndex(pState, &pQueue->VRing) == pQueue->uNextAvailIndex);
 }
 
@@ -55,6 +55,8 @@ extern const PDMDEVREG g_DeviceE1000;
 #endif
 #ifdef VBOX_WITH_VIRTIO
 extern const PDMDEVREG g_DeviceVirtioNet;
+extern const PDMDEVREG g_DeviceVirtioBlk;
+extern const PDMDEVREG g_DeviceVirtioSCSI;
 #endif
 #ifdef VBOX_WITH_INIP
 extern const PDMDEVREG g_DeviceINIP;
@@ -128,6 +128,12 @@
 # undef LOG_GROUP
 # include "../Storage/DevNVMe.cpp"
 #endif
+#ifdef VBOX_WITH_VIRTIO
+# undef LOG_GROUP
+# include "../Storage/DevVirtioBlk.cpp"
+# undef LOG_GROUP
+# include "../Storage/DevVirtioSCSI.cpp"
+#endif
 
 #ifdef VBOX_WITH_PCI_PASSTHROUGH_IMPL
 # undef LOG_GROUP
@@ -345,6 +351,19 @@ int main()
 #endif
 #ifdef VBOX_WITH_VIRTIO
     CHECK_MEMBER_ALIGNMENT(VNETSTATE, StatReceiveBytes, 8);
+    CHECK_MEMBER_ALIGNMENT(VNETSTATE, aPairs, 8);
+    CHECK_MEMBER_ALIGNMENT(VNETQUEUEPAIR, CritSectRx, 8);
+    CHECK_MEMBER_ALIGNMENT(VNETQUEUEPAIR, StatReceivePackets, 8);
+    CHECK_MEMBER_ALIGNMENT(VBLKSTATE, StatBytesRead, 8);
+    CHECK_MEMBER_ALIGNMENT(VIOSCSISTATE, StatReqs, 8);
+    CHECK_MEMBER_ALIGNMENT(VIOSCSISTATE, aReqQueues, 8);
+#endif
+#ifdef VBOX_WITH_NVME_IMPL
+    CHECK_MEMBER_ALIGNMENT(NVME, aQueuesSubm, 8);
+    CHECK_MEMBER_ALIGNMENT(NVME, aQueuesComp, 8);
+    CHECK_MEMBER_ALIGNMENT(NVME, CritSectAsyncEvtReqs, 8);
+    CHECK_MEMBER_ALIGNMENT(NVME, CritSectIntx, 8);
+    CHECK_MEMBER_ALIGNMENT(NVME, StatDoorbellWritesSq, 8);
 #endif
     //CHECK_MEMBER_ALIGNMENT(E1KSTATE, csTx, 8);
 #ifdef VBOX_WITH_USB
@@ -1580,7 +1580,6 @@ int main()
     GEN_CHECK_OFF(VPCISTATE, Queues);
     GEN_CHECK_OFF(VPCISTATE, Queues[VIRTIO_MAX_NQUEUES]);
     GEN_CHECK_OFF(VNETSTATE, VPCI);
-    GEN_CHECK_OFF(VNETSTATE, INetworkDown);
     GEN_CHECK_OFF(VNETSTATE, INetworkConfig);
     GEN_CHECK_OFF(VNETSTATE, pDrvBase);
     GEN_CHECK_OFF(VNETSTATE, pCanRxQueueR3);
@@ -1598,11 +1597,19 @@ int main()
     GEN_CHECK_OFF(VNETSTATE, u32PktNo);
     GEN_CHECK_OFF(VNETSTATE, fPromiscuous);
     GEN_CHECK_OFF(VNETSTATE, fAllMulti);
-    GEN_CHECK_OFF(VNETSTATE, pRxQueue);
-    GEN_CHECK_OFF(VNETSTATE, pTxQueue);
     GEN_CHECK_OFF(VNETSTATE, pCtlQueue);
-    GEN_CHECK_OFF(VNETSTATE, fMaybeOutOfSpace);
-    GEN_CHECK_OFF(VNETSTATE, hEventMoreRxDescAvail);
+    GEN_CHECK_OFF(VNETSTATE, cPairs);
+    GEN_CHECK_OFF(VNETSTATE, cActivePairs);
+    GEN_CHECK_OFF(VNETSTATE, Rss);
+    GEN_CHECK_OFF(VNETSTATE, aPairs);
+    GEN_CHECK_OFF(VNETSTATE, aPairs[1]);
+    GEN_CHECK_SIZE(VNETQUEUEPAIR);
+    GEN_CHECK_OFF(VNETQUEUEPAIR, CritSectRx);
+    GEN_CHECK_OFF(VNETQUEUEPAIR, pRxQueue);
+    GEN_CHECK_OFF(VNETQUEUEPAIR, pTxQueue);
+    GEN_CHECK_OFF(VNETQUEUEPAIR, INetworkDown);
+    GEN_CHECK_OFF(VNETQUEUEPAIR, hEventMoreRxDescAvail);
+    GEN_CHECK_OFF(VNETQUEUEPAIR, fMaybeOutOfSpace);
 #endif /* VBOX_WITH_VIRTIO */
 
 #ifdef VBOX_WITH_SCSI
@@ -2045,32 +2052,38 @@ int main()
 #ifdef VBOX_WITH_NVME_IMPL
     GEN_CHECK_SIZE(NVMEQUEUEHDR);
     GEN_CHECK_OFF(NVMEQUEUEHDR, u16Id);
+    GEN_CHECK_OFF(NVMEQUEUEHDR, fPhysCont);
     GEN_CHECK_OFF(NVMEQUEUEHDR, cEntries);
     GEN_CHECK_OFF(NVMEQUEUEHDR, enmState);
+    GEN_CHECK_OFF(NVMEQUEUEHDR, enmType);
     GEN_CHECK_OFF(NVMEQUEUEHDR, GCPhysBase);
     GEN_CHECK_OFF(NVMEQUEUEHDR, cbEntry);
     GEN_CHECK_OFF(NVMEQUEUEHDR, idxHead);
     GEN_CHECK_OFF(NVMEQUEUEHDR, idxTail);
-    GEN_CHECK_OFF(NVMEQUEUEHDR, fPhysCont);
-    GEN_CHECK_OFF(NVMEQUEUEHDR, enmType);
 
     GEN_CHECK_SIZE(NVMEQUEUESUBM);
     GEN_CHECK_OFF(NVMEQUEUESUBM, Hdr);
     GEN_CHECK_OFF(NVMEQUEUESUBM, u16CompletionQueueId);
     GEN_CHECK_OFF(NVMEQUEUESUBM, enmPriority);
+    GEN_CHECK_OFF(NVMEQUEUESUBM, uGen);
+    GEN_CHECK_OFF(NVMEQUEUESUBM, cReqsActive);
     GEN_CHECK_OFF(NVMEQUEUESUBM, hEvtProcess);
     GEN_CHECK_OFF(NVMEQUEUESUBM, pWrkThrdR3);
     GEN_CHECK_OFF(NVMEQUEUESUBM, NdLstWrkThrdAssgnd);
-    GEN_CHECK_OFF(NVMEQUEUESUBM, cReqsActive);
+    GEN_CHECK_OFF(NVMEQUEUESUBM, StatCmds);
 
     GEN_CHECK_SIZE(NVMEQUEUECOMP);
     GEN_CHECK_OFF(NVMEQUEUECOMP, Hdr);
     GEN_CHECK_OFF(NVMEQUEUECOMP, fIntrEnabled);
+    GEN_CHECK_OFF(NVMEQUEUECOMP, fPhase);
+    GEN_CHECK_OFF(NVMEQUEUECOMP, fIntrPending);
     GEN_CHECK_OFF(NVMEQUEUECOMP, u32IntrVec);
     GEN_CHECK_OFF(NVMEQUEUECOMP, cSubmQueuesRef);
+    GEN_CHECK_OFF(NVMEQUEUECOMP, cSubmQueuesProcessing);
     GEN_CHECK_OFF(NVMEQUEUECOMP, cWaiters);
     GEN_CHECK_OFF(NVMEQUEUECOMP, LstCompletionsWaiting);
     GEN_CHECK_OFF(NVMEQUEUECOMP, hMtx);
+    GEN_CHECK_OFF(NVMEQUEUECOMP, StatIntrs);
 
     GEN_CHECK_SIZE(NVME);
     GEN_CHECK_OFF(NVME, PciDev);
@@ -2082,56 +2095,68 @@ int main()
     GEN_CHECK_OFF(NVME, pLedsConnector);
     GEN_CHECK_OFF(NVME, pSupDrvSession);
     GEN_CHECK_OFF(NVME, GCPhysMMIO);
-    GEN_CHECK_OFF(NVME, IOPortBase);
     GEN_CHECK_OFF(NVME, cQueuesSubmMax);
     GEN_CHECK_OFF(NVME, cQueuesCompMax);
     GEN_CHECK_OFF(NVME, cQueueEntriesMax);
     GEN_CHECK_OFF(NVME, cTimeoutMax);
     GEN_CHECK_OFF(NVME, cWrkThrdsMax);
-    GEN_CHECK_OFF(NVME, cCompQueuesWaitersMax);
     GEN_CHECK_OFF(NVME, cNamespaces);
+    GEN_CHECK_OFF(NVME, cMsixVectors);
+    GEN_CHECK_OFF(NVME, cQueuesSubmGranted);
+    GEN_CHECK_OFF(NVME, cQueuesCompGranted);
     GEN_CHECK_OFF(NVME, szSerialNumber);
     GEN_CHECK_OFF(NVME, szModelNumber);
     GEN_CHECK_OFF(NVME, szFirmwareRevision);
-    GEN_CHECK_OFF(NVME, fRCEnabled);
     GEN_CHECK_OFF(NVME, fR0Enabled);
+    GEN_CHECK_OFF(NVME, fSignalIdle);
     GEN_CHECK_OFF(NVME, enmState);
+    GEN_CHECK_OFF(NVME, u64RegCap);
     GEN_CHECK_OFF(NVME, u32IntrMask);
-    GEN_CHECK_OFF(NVME, aIntrVecs);
-    GEN_CHECK_OFF(NVME, u32IoCompletionQueueEntrySize);
-    GEN_CHECK_OFF(NVME, u32IoSubmissionQueueEntrySize);
-    GEN_CHECK_OFF(NVME, uShutdwnNotifierLast);
-    GEN_CHECK_OFF(NVME, uAmsSet);
-    GEN_CHECK_OFF(NVME, uMpsSet);
-    GEN_CHECK_OFF(NVME, uCssSet);
-    GEN_CHECK_OFF(NVME, u32RegIdx);
+    GEN_CHECK_OFF(NVME, u32RegCc);
+    GEN_CHECK_OFF(NVME, u32RegCsts);
+    GEN_CHECK_OFF(NVME, u32RegAqa);
+    GEN_CHECK_OFF(NVME, u64RegAsq);
+    GEN_CHECK_OFF(NVME, u64RegAcq);
     GEN_CHECK_OFF(NVME, cbPage);
-    GEN_CHECK_OFF(NVME, paQueuesSubmR3);
-    GEN_CHECK_OFF(NVME, paQueuesCompR3);
-    GEN_CHECK_OFF(NVME, paQueuesSubmR0);
-    GEN_CHECK_OFF(NVME, paQueuesCompR0);
-    GEN_CHECK_OFF(NVME, paQueuesSubmRC);
-    GEN_CHECK_OFF(NVME, paQueuesCompRC);
-    GEN_CHECK_OFF(NVME, pvCtrlMemBufR3);
-    GEN_CHECK_OFF(NVME, GCPhysCtrlMemBuf);
-    GEN_CHECK_OFF(NVME, cbCtrlMemBuf);
-    GEN_CHECK_OFF(NVME, u32CtrlMemBufSz);
-    GEN_CHECK_OFF(NVME, pWakeQueueR3);
-    GEN_CHECK_OFF(NVME, pWakeQueueR0);
-    GEN_CHECK_OFF(NVME, pWakeQueueRC);
-    GEN_CHECK_OFF(NVME, cAsyncEvtReqsMax);
+    GEN_CHECK_OFF(NVME, GCPhysDbBufShadow);
+    GEN_CHECK_OFF(NVME, GCPhysDbBufEvtIdx);
+    GEN_CHECK_OFF(NVME, u32FeatArbitration);
+    GEN_CHECK_OFF(NVME, u32FeatTempThreshold);
+    GEN_CHECK_OFF(NVME, u32FeatErrRecovery);
+    GEN_CHECK_OFF(NVME, u32FeatVolatileWc);
+    GEN_CHECK_OFF(NVME, u32FeatIntrCoalescing);
+    GEN_CHECK_OFF(NVME, u32FeatWriteAtomicity);
+    GEN_CHECK_OFF(NVME, u32FeatAsyncEvtCfg);
+    GEN_CHECK_OFF(NVME, aQueuesSubm);
+    GEN_CHECK_OFF(NVME, aQueuesSubm[1]);
+    GEN_CHECK_OFF(NVME, aQueuesComp);
+    GEN_CHECK_OFF(NVME, aQueuesComp[1]);
     GEN_CHECK_OFF(NVME, CritSectAsyncEvtReqs);
-    GEN_CHECK_OFF(NVME, paAsyncEvtReqCids);
+    GEN_CHECK_OFF(NVME, CritSectIntx);
+    GEN_CHECK_OFF(NVME, cAsyncEvtReqs);
+    GEN_CHECK_OFF(NVME, aAsyncEvtReqCids);
+    GEN_CHECK_OFF(NVME, fAsyncEvtNsChangedPending);
+    GEN_CHECK_OFF(NVME, fAsyncEvtNsChangedMasked);
+    GEN_CHECK_OFF(NVME, bmNsChanged);
     GEN_CHECK_OFF(NVME, paNamespaces);
-    GEN_CHECK_OFF(NVME, cWrkThrdsCur);
+    GEN_CHECK_OFF(NVME, paWrkThrds);
     GEN_CHECK_OFF(NVME, cWrkThrdsActive);
-    GEN_CHECK_OFF(NVME, LstWrkThrds);
-    GEN_CHECK_OFF(NVME, CritSectWrkThrds);
-    GEN_CHECK_OFF(NVME, fSignalIdle);
-# ifdef VBOX_WITH_STATISTICS
-    GEN_CHECK_OFF(NVME, aStatMemXfer[0]);
-    GEN_CHECK_OFF(NVME, aStatMemXfer[NVME_CMBSZ_SUPP_BIT_IDX_MAX]);
-# endif
+    GEN_CHECK_OFF(NVME, cCmdsRestored);
+    GEN_CHECK_OFF(NVME, paCmdsRestored);
+    GEN_CHECK_OFF(NVME, StatDoorbellWritesSq);
+    GEN_CHECK_OFF(NVME, StatDoorbellWritesCq);
+    GEN_CHECK_OFF(NVME, StatDoorbellWritesCqR3);
+    GEN_CHECK_OFF(NVME, StatCmdsAdmin);
+    GEN_CHECK_OFF(NVME, StatCmdsRead);
+    GEN_CHECK_OFF(NVME, StatCmdsWrite);
+    GEN_CHECK_OFF(NVME, StatCmdsFlush);
+    GEN_CHECK_OFF(NVME, StatCmdsDsm);
+    GEN_CHECK_OFF(NVME, StatCmdsWriteZeroes);
+    GEN_CHECK_OFF(NVME, StatCmdsFailed);
+    GEN_CHECK_OFF(NVME, StatBytesRead);
+    GEN_CHECK_OFF(NVME, StatBytesWritten);
+    GEN_CHECK_OFF(NVME, StatCqFull);
+    GEN_CHECK_OFF(NVME, StatIntrsBatched);
 #endif
 
     return (0);
@@ -25,6 +25,10 @@
 
 #include "VBoxWatchdogInternal.h"
 #include <iprt/system.h>
+#ifdef RT_OS_LINUX
+# include <iprt/file.h>
+# include <iprt/string.h>
+#endif
 
 using namespace com;
 
@@ -46,15 +50,23 @@ enum GETOPTDEF_BALLOONCTRL
     GETOPTDEF_BALLOONCTRL_BALLOONMAX,
     GETOPTDEF_BALLOONCTRL_BALLOONSAFETY,
     GETOPTDEF_BALLOONCTRL_TIMEOUTMS,
-    GETOPTDEF_BALLOONCTRL_GROUPS
+    GETOPTDEF_BALLOONCTRL_GROUPS,
+    GETOPTDEF_BALLOONCTRL_ADAPTIVE,
+    GETOPTDEF_BALLOONCTRL_HOSTFREELOW,
+    GETOPTDEF_BALLOONCTRL_HOSTFREEHIGH,
+    GETOPTDEF_BALLOONCTRL_HOSTPSIHIGH
 };
 
 /**
  * The module's command line arguments.
  */
 static const RTGETOPTDEF g_aBalloonOpts[] = {
+    { "--balloon-adaptive",       GETOPTDEF_BALLOONCTRL_ADAPTIVE,          RTGETOPT_REQ_NOTHING },
     { "--balloon-dec",            GETOPTDEF_BALLOONCTRL_BALLOONDEC,        RTGETOPT_REQ_UINT32 },
     { "--balloon-groups",         GETOPTDEF_BALLOONCTRL_GROUPS,            RTGETOPT_REQ_STRING },
+    { "--balloon-host-free-high", GETOPTDEF_BALLOONCTRL_HOSTFREEHIGH,      RTGETOPT_REQ_UINT32 },
+    { "--balloon-host-free-low",  GETOPTDEF_BALLOONCTRL_HOSTFREELOW,       RTGETOPT_REQ_UINT32 },
+    { "--balloon-host-psi-high",  GETOPTDEF_BALLOONCTRL_HOSTPSIHIGH,       RTGETOPT_REQ_UINT32 },
     { "--balloon-inc",            GETOPTDEF_BALLOONCTRL_BALLOONINC,        RTGETOPT_REQ_UINT32 },
     { "--balloon-interval",       GETOPTDEF_BALLOONCTRL_TIMEOUTMS,         RTGETOPT_REQ_UINT32 },
     { "--balloon-lower-limit",    GETOPTDEF_BALLOONCTRL_BALLOONLOWERLIMIT, RTGETOPT_REQ_UINT32 },
@@ -71,6 +83,41 @@ typedef struct VBOXWATCHDOG_BALLOONCTRL_PAYLOAD
     uint32_t cMbBalloonReqLast;
 } VBOXWATCHDOG_BALLOONCTRL_PAYLOAD, *PVBOXWATCHDOG_BALLOONCTRL_PAYLOAD;
 
+/**
+ * The host memory pressure state used by the adaptive ballooning policy.
+ *
+ * The state only changes when crossing the low or high watermark, so
+ * that the policy does not oscillate while the host is in between.
+ */
+typedef enum BALLOONHOSTSTATE
+{
+    /** Neither inflate nor deflate, keep balloons as they are. */
+    BALLOONHOSTSTATE_HOLD = 0,
+    /** The host is low on memory, inflate balloons. */
+    BALLOONHOSTSTATE_RECLAIM,
+    /** The host has plenty of memory, give it back to the guests. */
+    BALLOONHOSTSTATE_RELEASE
+} BALLOONHOSTSTATE;
+
+/**
+ * Per-VM working data of one adaptive ballooning pass.
+ */
+typedef struct BALLOONADAPTIVEVM
+{
+    /** The machine. */
+    PVBOXWATCHDOG_MACHINE pMachine;
+    /** Free guest memory (MB). */
+    uint32_t              cMbGuestMemFree;
+    /** The current balloon size (MB). */
+    uint32_t              cMbBalloonCur;
+    /** The maximum balloon size (MB), 0 if unlimited. */
+    uint32_t              cMbBalloonMax;
+    /** Memory (MB) which can be reclaimed from the guest without going
+     *  below the lower limit. */
+    uint32_t              cMbReclaimable;
+} BALLOONADAPTIVEVM;
+typedef std::vector<BALLOONADAPTIVEVM> vecAdaptiveVMs;
+
 
 /*********************************************************************************************************************************
 *   Globals                                                                                                                      *
@@ -83,7 +130,21 @@ static uint32_t g_cMbMemoryBalloonDecrement  = 128;
  *  no global limit is set. See balloonGetMaxSize() for more information. */
 static uint32_t g_cMbMemoryBalloonMax        = 0;
 static uint32_t g_cMbMemoryBalloonLowerLimit = 128;
-static uint32_t g_cbMemoryBalloonSafety     = 1024;
+static uint32_t g_cMbMemoryBalloonSafety     = 1024;
+/** Command line: Whether the adaptive (host pressure driven) policy is used
+ *  instead of the static per-VM balloon sizes. */
+static bool     g_fMemoryBalloonAdaptive     = false;
+/** Adaptive policy: Start reclaiming guest memory when the available host
+ *  memory drops below this value (MB). */
+static uint32_t g_cMbHostMemFreeLow          = 0;
+/** Adaptive policy: Start releasing ballooned memory when the available host
+ *  memory exceeds this value (MB). Must be above the low watermark. */
+static uint32_t g_cMbHostMemFreeHigh         = 0;
+/** Adaptive policy: Reclaim when the host memory pressure stall information
+ *  ("some avg10", in 1/100 percent) exceeds this value. 0 disables. */
+static uint32_t g_uHostMemPsiHigh            = 1000;
+/** Adaptive policy: The current host state. */
+static BALLOONHOSTSTATE g_enmHostState       = BALLOONHOSTSTATE_HOLD;
 
 
 /*********************************************************************************************************************************
@@ -150,7 +211,7 @@ static int32_t balloonGetDelta(PVBOXWATCHDOG_MACHINE pMachine, uint32_t cMbGuest
      * If anything fails clamp the delta to 0. */
     if (cMbBalloonDelta < 0)
     {
-        uint64_t cbSafety = (uint64_t)g_cbMemoryBalloonSafety * _1M;
+        uint64_t cbSafety = (uint64_t)g_cMbMemoryBalloonSafety * _1M;
         uint64_t cbHostRamAvail = 0;
         int vrc = RTSystemQueryAvailableRam(&cbHostRamAvail);
         if (RT_SUCCESS(vrc))
@@ -504,6 +565,273 @@ static int balloonMachineUpdate(PVBOXWATCHDOG_MACHINE pMachine)
     return vrc;
 }
 
+/**
+ * Queries the host memory pressure stall information (PSI).
+ *
+ * @return  IPRT status code. VERR_NOT_SUPPORTED if not available on this host.
+ * @param   puPsiSome               Where to store the "some avg10" value in 1/100 percent.
+ */
+static int balloonQueryHostPsi(uint32_t *puPsiSome)
+{
+#ifdef RT_OS_LINUX
+    void  *pvFile;
+    size_t cbFile;
+    int vrc = RTFileReadAll("/proc/pressure/memory", &pvFile, &cbFile);
+    if (RT_FAILURE(vrc))
+        return vrc;
+
+    /* Format: "some avg10=1.23 avg60=0.50 avg300=0.10 total=12345\nfull ..." */
+    char szBuf[256];
+    RTStrCopyEx(szBuf, sizeof(szBuf), (const char *)pvFile, cbFile);
+    RTFileReadAllFree(pvFile, cbFile);
+
+    vrc = VERR_PARSE_ERROR;
+    const char *psz = RTStrStr(szBuf, "some avg10=");
+    if (psz)
+    {
+        char *pszNext = NULL;
+        uint32_t uInt = 0;
+        uint32_t uFrac = 0;
+        vrc = RTStrToUInt32Ex(psz + sizeof("some avg10=") - 1, &pszNext, 10, &uInt);
+        if (   RT_SUCCESS(vrc)
+            && pszNext
+            && *pszNext == '.')
+            vrc = RTStrToUInt32Ex(pszNext + 1, &pszNext, 10, &uFrac);
+        if (RT_SUCCESS(vrc))
+        {
+            *puPsiSome = uInt * 100 + RT_MIN(uFrac, 99);
+            vrc = VINF_SUCCESS;
+        }
+        else
+            vrc = VERR_PARSE_ERROR;
+    }
+    return vrc;
+#else
+    RT_NOREF(puPsiSome);
+    return VERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Updates the host memory pressure state of the adaptive policy.
+ *
+ * The state only changes when a watermark is crossed (hysteresis).
+ *
+ * @return  IPRT status code.
+ * @param   pcMbHostMemAvail        Where to store the available host memory (MB).
+ */
+static int balloonAdaptiveUpdateHostState(uint32_t *pcMbHostMemAvail)
+{
+    uint64_t cbHostMemAvail = 0;
+    int vrc = RTSystemQueryAvailableRam(&cbHostMemAvail);
+    if (RT_FAILURE(vrc))
+        return vrc;
+
+    uint32_t cMbHostMemAvail = (uint32_t)RT_MIN(cbHostMemAvail / _1M, UINT32_MAX);
+    *pcMbHostMemAvail = cMbHostMemAvail;
+
+    uint32_t uPsiSome = 0;
+    bool fPsiHigh = false;
+    if (   g_uHostMemPsiHigh
+        && RT_SUCCESS(balloonQueryHostPsi(&uPsiSome)))
+        fPsiHigh = uPsiSome >= g_uHostMemPsiHigh;
+
+    BALLOONHOSTSTATE enmState = g_enmHostState;
+    if (   cMbHostMemAvail < g_cMbHostMemFreeLow
+        || fPsiHigh)
+        enmState = BALLOONHOSTSTATE_RECLAIM;
+    else if (cMbHostMemAvail > g_cMbHostMemFreeHigh)
+        enmState = BALLOONHOSTSTATE_RELEASE;
+    else if (   enmState == BALLOONHOSTSTATE_RECLAIM
+             && cMbHostMemAvail >= (g_cMbHostMemFreeLow + g_cMbHostMemFreeHigh) / 2)
+        enmState = BALLOONHOSTSTATE_HOLD; /* Recovered half-way into the band, stop reclaiming. */
+    else if (   enmState == BALLOONHOSTSTATE_RELEASE
+             && cMbHostMemAvail <= g_cMbHostMemFreeHigh)
+        enmState = BALLOONHOSTSTATE_HOLD;
+
+    if (enmState != g_enmHostState)
+        serviceLog("Adaptive ballooning: host state %s -> %s (available %RU32MB, PSI some avg10 %RU32.%02RU32%%)\n",
+                   g_enmHostState == BALLOONHOSTSTATE_RECLAIM ? "reclaim" : g_enmHostState == BALLOONHOSTSTATE_RELEASE ? "release" : "hold",
+                   enmState       == BALLOONHOSTSTATE_RECLAIM ? "reclaim" : enmState       == BALLOONHOSTSTATE_RELEASE ? "release" : "hold",
+                   cMbHostMemAvail, uPsiSome / 100, uPsiSome % 100);
+    g_enmHostState = enmState;
+    return VINF_SUCCESS;
+}
+
+/**
+ * Gathers the ballooning data of a machine for an adaptive ballooning pass.
+ *
+ * @return  IPRT status code. VERR_NOT_AVAILABLE if the guest does not report
+ *          its statistics (yet).
+ * @param   pMachine                Pointer to the machine's internal structure.
+ * @param   pVM                     Where to store the data.
+ */
+static int balloonAdaptiveQueryMachine(PVBOXWATCHDOG_MACHINE pMachine, BALLOONADAPTIVEVM *pVM)
+{
+    LONG cKbGuestMemFree;
+    uint32_t cMbBalloonCur = 0;
+    int vrc = getMetric(pMachine, L"Guest/RAM/Usage/Free", &cKbGuestMemFree);
+    if (RT_SUCCESS(vrc))
+        vrc = balloonGetCurrentSize(pMachine, &cMbBalloonCur);
+    if (RT_FAILURE(vrc))
+        return vrc;
+
+    /* If guest statistics are not up and running yet, leave the machine alone. */
+    if (cKbGuestMemFree <= 0)
+        return VERR_NOT_AVAILABLE;
+
+    pVM->pMachine        = pMachine;
+    pVM->cMbGuestMemFree = (ULONG)cKbGuestMemFree / 1024;
+    pVM->cMbBalloonCur   = cMbBalloonCur;
+    pVM->cMbBalloonMax   = balloonGetRequestedSize(pMachine);
+    if (!pVM->cMbBalloonMax)
+        pVM->cMbBalloonMax = balloonGetMaxSize(pMachine);
+
+    pVM->cMbReclaimable  = pVM->cMbGuestMemFree > g_cMbMemoryBalloonLowerLimit
+                         ? pVM->cMbGuestMemFree - g_cMbMemoryBalloonLowerLimit : 0;
+    if (pVM->cMbBalloonMax)
+        pVM->cMbReclaimable = RT_MIN(pVM->cMbReclaimable,
+                                     pVM->cMbBalloonMax > cMbBalloonCur ? pVM->cMbBalloonMax - cMbBalloonCur : 0);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Calculates the balloon delta of one machine for the adaptive policy.
+ *
+ * Memory to reclaim is distributed across the machines proportionally to
+ * their reclaimable free memory, memory to release proportionally to their
+ * current balloon size. Each step is limited by the increment/decrement.
+ *
+ * @return  Delta (MB) of the balloon to be deflated (<0) or inflated (>0).
+ * @param   pVM                     The machine's data.
+ * @param   cMbTarget               Total amount (MB) to reclaim or release.
+ * @param   cMbTotal                Sum of the reclaimable memory resp. the balloon
+ *                                  sizes of all machines.
+ */
+static int32_t balloonAdaptiveGetDelta(const BALLOONADAPTIVEVM *pVM, uint32_t cMbTarget, uint64_t cMbTotal)
+{
+    /* Guest protection comes first, whatever the host state. */
+    if (pVM->cMbGuestMemFree < g_cMbMemoryBalloonLowerLimit)
+        return -(int32_t)RT_MIN(g_cMbMemoryBalloonDecrement, pVM->cMbBalloonCur);
+
+    if (!cMbTotal)
+        return 0;
+
+    switch (g_enmHostState)
+    {
+        case BALLOONHOSTSTATE_RECLAIM:
+        {
+            uint64_t cMbShare = (uint64_t)cMbTarget * pVM->cMbReclaimable / cMbTotal;
+            /* Small targets (e.g. PSI only pressure) split across many machines
+               would round down to nothing, so take at least 1MB from each. */
+            if (!cMbShare && cMbTarget)
+                cMbShare = 1;
+            cMbShare = RT_MIN(cMbShare, pVM->cMbReclaimable);
+            return (int32_t)RT_MIN(cMbShare, g_cMbMemoryBalloonIncrement);
+        }
+
+        case BALLOONHOSTSTATE_RELEASE:
+        {
+            uint64_t cMbShare = (uint64_t)cMbTarget * pVM->cMbBalloonCur / cMbTotal;
+            cMbShare = RT_MIN(cMbShare, pVM->cMbBalloonCur);
+            return -(int32_t)RT_MIN(cMbShare, g_cMbMemoryBalloonDecrement);
+        }
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+/**
+ * Does one pass of the adaptive ballooning policy over all running machines.
+ *
+ * @return  IPRT status code.
+ */
+static int balloonAdaptiveUpdate(void)
+{
+    uint32_t cMbHostMemAvail = 0;
+    int vrc = balloonAdaptiveUpdateHostState(&cMbHostMemAvail);
+    if (RT_FAILURE(vrc))
+    {
+        serviceLog("Adaptive ballooning: Unable to query host memory, rc=%Rrc\n", vrc);
+        return VINF_SUCCESS; /* Try again next time. */
+    }
+
+    /*
+     * Gather the data of all machines first, as the amount to reclaim or
+     * release is distributed among them.
+     */
+    vecAdaptiveVMs vecVMs;
+    uint64_t cMbReclaimableTotal = 0;
+    uint64_t cMbBalloonTotal     = 0;
+    /** @todo Provide API for enumerating/working w/ machines inside a module! */
+    for (mapVMIter it = g_mapVM.begin(); it != g_mapVM.end(); ++it)
+    {
+        PVBOXWATCHDOG_MACHINE pMachine = &it->second;
+        if (   !balloonIsPossible(getMachineState(pMachine))
+            || !balloonIsEnabled(pMachine))
+            continue;
+
+        BALLOONADAPTIVEVM VM;
+        int vrc2 = balloonAdaptiveQueryMachine(pMachine, &VM);
+        if (RT_FAILURE(vrc2))
+        {
+            if (vrc2 != VERR_NOT_AVAILABLE)
+                serviceLog("[%ls] Error retrieving metrics, rc=%Rrc\n", pMachine->strName.raw(), vrc2);
+            continue;
+        }
+
+        cMbReclaimableTotal += VM.cMbReclaimable;
+        cMbBalloonTotal     += VM.cMbBalloonCur;
+        vecVMs.push_back(VM);
+    }
+
+    uint32_t cMbTarget = 0;
+    uint64_t cMbTotal  = 0;
+    if (g_enmHostState == BALLOONHOSTSTATE_RECLAIM)
+    {
+        /* Aim for the high watermark so we don't immediately fall below the low one again. */
+        cMbTarget = cMbHostMemAvail < g_cMbHostMemFreeHigh ? g_cMbHostMemFreeHigh - cMbHostMemAvail : 0;
+        if (!cMbTarget) /* Pressure reported by PSI only, reclaim one increment's worth. */
+            cMbTarget = g_cMbMemoryBalloonIncrement;
+        cMbTotal  = cMbReclaimableTotal;
+    }
+    else if (g_enmHostState == BALLOONHOSTSTATE_RELEASE)
+    {
+        /* Never hand out more than what keeps us above the high watermark. */
+        cMbTarget = cMbHostMemAvail > g_cMbHostMemFreeHigh ? cMbHostMemAvail - g_cMbHostMemFreeHigh : 0;
+        cMbTotal  = cMbBalloonTotal;
+    }
+
+    serviceLogVerbose(("Adaptive ballooning: %zu machine(s), host available %RU32MB, target %RU32MB, reclaimable %RU64MB, ballooned %RU64MB\n",
+                       vecVMs.size(), cMbHostMemAvail, cMbTarget, cMbReclaimableTotal, cMbBalloonTotal));
+
+    for (size_t i = 0; i < vecVMs.size(); i++)
+    {
+        const BALLOONADAPTIVEVM *pVM = &vecVMs[i];
+        int32_t cMbBalloonDelta = balloonAdaptiveGetDelta(pVM, cMbTarget, cMbTotal);
+        if (cMbBalloonDelta)
+        {
+            PVBOXWATCHDOG_BALLOONCTRL_PAYLOAD pData;
+            pData = (PVBOXWATCHDOG_BALLOONCTRL_PAYLOAD)payloadFrom(pVM->pMachine, VBOX_MOD_BALLOONING_NAME);
+            AssertPtr(pData);
+
+            uint32_t cMbBalloonNew = pVM->cMbBalloonCur + cMbBalloonDelta;
+            serviceLog("[%ls] Adaptive: %s balloon by %RU32MB to %RU32MB (guest free %RU32MB) ...\n",
+                       pVM->pMachine->strName.raw(), cMbBalloonDelta > 0 ? "Inflating" : "Deflating",
+                       RT_ABS(cMbBalloonDelta), cMbBalloonNew, pVM->cMbGuestMemFree);
+            int vrc2 = balloonSetSize(pVM->pMachine, cMbBalloonNew);
+            if (RT_SUCCESS(vrc2))
+                pData->cMbBalloonCurLast = cMbBalloonNew;
+            else
+                serviceLog("[%ls] Error setting balloon size, rc=%Rrc\n", pVM->pMachine->strName.raw(), vrc2);
+        }
+    }
+
+    return VINF_SUCCESS;
+}
+
 static int balloonSetSize(PVBOXWATCHDOG_MACHINE pMachine, uint32_t cMbBalloonCur)
 {
     int vrc = VINF_SUCCESS;
@@ -571,6 +899,22 @@ static DECLCALLBACK(int) VBoxModBallooningOption(int argc, char *argv[], int *pi
     {
         switch (c)
         {
+            case GETOPTDEF_BALLOONCTRL_ADAPTIVE:
+                g_fMemoryBalloonAdaptive = true;
+                break;
+
+            case GETOPTDEF_BALLOONCTRL_HOSTFREELOW:
+                g_cMbHostMemFreeLow = ValueUnion.u32;
+                break;
+
+            case GETOPTDEF_BALLOONCTRL_HOSTFREEHIGH:
+                g_cMbHostMemFreeHigh = ValueUnion.u32;
+                break;
+
+            case GETOPTDEF_BALLOONCTRL_HOSTPSIHIGH:
+                g_uHostMemPsiHigh = ValueUnion.u32;
+                break;
+
             case GETOPTDEF_BALLOONCTRL_BALLOONDEC:
                 g_cMbMemoryBalloonDecrement = ValueUnion.u32;
                 break;
@@ -592,7 +936,7 @@ static DECLCALLBACK(int) VBoxModBallooningOption(int argc, char *argv[], int *pi
                 break;
 
             case GETOPTDEF_BALLOONCTRL_BALLOONSAFETY:
-                g_cbMemoryBalloonSafety = ValueUnion.u32;
+                g_cMbMemoryBalloonSafety = ValueUnion.u32;
                 break;
 
             /** @todo This option is a common module option! Put
@@ -639,6 +983,36 @@ static DECLCALLBACK(int) VBoxModBallooningInit(void)
                        "VBoxInternal2/Watchdog/BalloonCtrl/BalloonLowerLimitMB", NULL /* Per-machine */,
                        &g_cMbMemoryBalloonLowerLimit, 128);
 
+    if (!g_fMemoryBalloonAdaptive)
+    {
+        uint32_t uAdaptive = 0;
+        cfgGetValueU32(g_pVirtualBox, NULL /* Machine */,
+                       "VBoxInternal2/Watchdog/BalloonCtrl/Adaptive", NULL /* Per-machine */,
+                       &uAdaptive, 0);
+        g_fMemoryBalloonAdaptive = RT_BOOL(uAdaptive);
+    }
+
+    if (g_fMemoryBalloonAdaptive)
+    {
+        /* Default watermarks are derived from the safety margin. */
+        if (!g_cMbHostMemFreeLow)
+            cfgGetValueU32(g_pVirtualBox, NULL /* Machine */,
+                           "VBoxInternal2/Watchdog/BalloonCtrl/HostFreeLowMB", NULL /* Per-machine */,
+                           &g_cMbHostMemFreeLow, g_cMbMemoryBalloonSafety);
+        if (!g_cMbHostMemFreeHigh)
+            cfgGetValueU32(g_pVirtualBox, NULL /* Machine */,
+                           "VBoxInternal2/Watchdog/BalloonCtrl/HostFreeHighMB", NULL /* Per-machine */,
+                           &g_cMbHostMemFreeHigh, g_cMbHostMemFreeLow * 2);
+        if (g_cMbHostMemFreeHigh <= g_cMbHostMemFreeLow)
+        {
+            serviceLog("Warning: Host free memory high watermark (%RU32MB) must be above the low watermark (%RU32MB), adjusting ...\n",
+                       g_cMbHostMemFreeHigh, g_cMbHostMemFreeLow);
+            g_cMbHostMemFreeHigh = g_cMbHostMemFreeLow + g_cMbMemoryBalloonIncrement;
+        }
+        serviceLog("Adaptive ballooning enabled: host free low=%RU32MB high=%RU32MB, PSI threshold=%RU32.%02RU32%%\n",
+                   g_cMbHostMemFreeLow, g_cMbHostMemFreeHigh, g_uHostMemPsiHigh / 100, g_uHostMemPsiHigh % 100);
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -656,6 +1030,13 @@ static DECLCALLBACK(int) VBoxModBallooningMain(void)
 
     int rc = VINF_SUCCESS;
 
+    if (g_fMemoryBalloonAdaptive)
+    {
+        rc = balloonAdaptiveUpdate();
+        s_msLast = RTTimeMilliTS();
+        return rc;
+    }
+
     /** @todo Provide API for enumerating/working w/ machines inside a module! */
     mapVMIter it = g_mapVM.begin();
     while (it != g_mapVM.end())
@@ -695,7 +1076,8 @@ static DECLCALLBACK(int) VBoxModBallooningOnMachineRegistered(const Bstr &strUui
     PVBOXWATCHDOG_BALLOONCTRL_PAYLOAD pData;
     int rc = payloadAlloc(pMachine, VBOX_MOD_BALLOONING_NAME,
                           sizeof(VBOXWATCHDOG_BALLOONCTRL_PAYLOAD), (void**)&pData);
-    if (RT_SUCCESS(rc))
+    if (   RT_SUCCESS(rc)
+        && !g_fMemoryBalloonAdaptive)
         rc = balloonMachineUpdate(pMachine);
 
     return rc;
@@ -722,6 +1104,10 @@ static DECLCALLBACK(int) VBoxModBallooningOnMachineStateChanged(const Bstr &strU
     if (!pMachine)
         return VINF_SUCCESS;
 
+    /* The adaptive policy considers all machines at once in the main loop. */
+    if (g_fMemoryBalloonAdaptive)
+        return VINF_SUCCESS;
+
     return balloonMachineUpdate(pMachine);
 }
 
@@ -747,10 +1133,20 @@ VBOXMODULE g_ModBallooning =
     /* pszUsage. */
     " [--balloon-dec=<MB>] [--balloon-groups=<string>] [--balloon-inc=<MB>]\n"
     " [--balloon-interval=<ms>] [--balloon-lower-limit=<MB>]\n"
-    " [--balloon-max=<MB>]\n",
+    " [--balloon-max=<MB>] [--balloon-adaptive]\n"
+    " [--balloon-host-free-low=<MB>] [--balloon-host-free-high=<MB>]\n"
+    " [--balloon-host-psi-high=<1/100 %>]\n",
     /* pszOptions. */
+    "--balloon-adaptive     Inflates/deflates the balloons of all VMs depending on\n"
+    "                       the host memory pressure instead of the per-VM sizes.\n"
     "--balloon-dec          Sets the ballooning decrement in MB (128 MB).\n"
     "--balloon-groups       Sets the VM groups for ballooning (all).\n"
+    "--balloon-host-free-high Adaptive: Deflate above this host free memory in MB\n"
+    "                       (twice the low watermark).\n"
+    "--balloon-host-free-low Adaptive: Inflate below this host free memory in MB\n"
+    "                       (safety margin).\n"
+    "--balloon-host-psi-high Adaptive: Inflate above this host memory pressure\n"
+    "                       (Linux PSI some avg10) in 1/100 percent (1000).\n"
     "--balloon-inc          Sets the ballooning increment in MB (256 MB).\n"
     "--balloon-interval     Sets the check interval in ms (30 seconds).\n"
     "--balloon-lower-limit  Sets the ballooning lower limit in MB (64 MB).\n"
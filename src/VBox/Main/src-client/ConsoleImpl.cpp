@@ -9470,8 +9470,21 @@ HRESULT Console::i_attachToTapInterface(INetworkAdapter *networkAdapter)
             /* If we are using a static TAP device then try to open it. */
             Utf8Str str(tapDeviceName);
             RTStrCopy(IfReq.ifr_name, sizeof(IfReq.ifr_name), str.c_str()); /** @todo bitch about names which are too long... */
-            IfReq.ifr_flags = IFF_TAP | IFF_NO_PI;
+            /* Ask for the virtio-net header so the driver can pass offloads through, and
+               for multiqueue so that additional queue pairs can attach to the device.
+               Persistent devices created without multiqueue support refuse the latter. */
+            IfReq.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
+#  ifdef IFF_MULTI_QUEUE
+            IfReq.ifr_flags |= IFF_MULTI_QUEUE;
             vrc = ioctl(RTFileToNative(maTapFD[slot]), TUNSETIFF, &IfReq);
+            if (vrc != 0 && errno == EINVAL)
+            {
+                IfReq.ifr_flags &= ~IFF_MULTI_QUEUE;
+                vrc = ioctl(RTFileToNative(maTapFD[slot]), TUNSETIFF, &IfReq);
+            }
+#  else
+            vrc = ioctl(RTFileToNative(maTapFD[slot]), TUNSETIFF, &IfReq);
+#  endif
             if (vrc != 0)
             {
                 LogRel(("Failed to open the host network interface %ls\n", tapDeviceName.raw()));
@@ -3266,6 +3266,12 @@ int Console::i_configConstructorInner(PUVM pUVM, PVM pVM, AutoWriteLock *pAlock)
             InsertConfigInteger(pCfg,  "ShowCpu", fShowCpu);
             InsertConfigInteger(pCfg,  "CpuHotPlug", fCpuHotPlug);
 
+            /* The guest NUMA topology is configured via extra data, the VMM and
+             * the SRAT/SLIT tables must agree on the node count. */
+            GetExtraDataBoth(virtualBox, pMachine, "VBoxInternal/NUMA/GuestNodes", &strTmp);
+            if (!strTmp.isEmpty())
+                InsertConfigInteger(pCfg,  "NumaNodes", strTmp.toUInt32());
+
             InsertConfigInteger(pCfg,  "Serial0IoPortBase", auSerialIoPortBase[0]);
             InsertConfigInteger(pCfg,  "Serial0Irq", auSerialIrq[0]);
 
@@ -262,13 +262,14 @@ fwudp_pmgr_pump(struct pollmgr_handler *handler, SOCKET fd, int revents)
 {
     struct fwudp *fwudp;
     struct sockaddr_storage ss;
-    socklen_t sslen = sizeof(ss);
+    socklen_t sslen;
     size_t beg, lim;
     struct fwudp_dgram *dgram;
     struct pbuf *p;
     ssize_t nread;
     int status;
     err_t error;
+    int ndgrams;
 
     fwudp = (struct fwudp *)handler->data;
 
@@ -278,72 +279,82 @@ fwudp_pmgr_pump(struct pollmgr_handler *handler, SOCKET fd, int revents)
     LWIP_UNUSED_ARG(fd);
     LWIP_UNUSED_ARG(revents);
 
+    /*
+     * Read what has queued up on the non-blocking socket (within
+     * reason) instead of taking a trip through poll for each datagram.
+     */
+    for (ndgrams = 0; ndgrams < POLLMGR_UDP_BATCH; ++ndgrams) {
+        sslen = sizeof(ss);
 #ifdef RT_OS_WINDOWS
-    nread = recvfrom(fwudp->sock, (char *)pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0,
-                     (struct sockaddr *)&ss, &sslen);
+        nread = recvfrom(fwudp->sock, (char *)pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0,
+                         (struct sockaddr *)&ss, &sslen);
 #else
-    nread = recvfrom(fwudp->sock, pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0,
-                     (struct sockaddr *)&ss, &sslen);
+        nread = recvfrom(fwudp->sock, pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0,
+                         (struct sockaddr *)&ss, &sslen);
 #endif
-    if (nread < 0) {
-        DPRINTF(("%s: %R[sockerr]\n", __func__, SOCKERRNO()));
-        return POLLIN;
-    }
+        if (nread < 0) {
+            int sockerr = SOCKERRNO();
+            if (ndgrams == 0 || !proxy_error_is_transient(sockerr)) {
+                DPRINTF(("%s: %R[sockerr]\n", __func__, sockerr));
+            }
+            break;
+        }
 
-    /* Check that ring buffer is not full */
-    lim = fwudp->inbuf.unsent;
-    if (lim == 0) {
-        lim = fwudp->inbuf.bufsize - 1; /* guard slot at the end */
-    }
-    else {
-        --lim;
-    }
+        /* Check that ring buffer is not full */
+        lim = fwudp->inbuf.unsent;
+        if (lim == 0) {
+            lim = fwudp->inbuf.bufsize - 1; /* guard slot at the end */
+        }
+        else {
+            --lim;
+        }
 
-    beg = fwudp->inbuf.vacant;
-    if (beg == lim) { /* no vacant slot */
-        return POLLIN;
-    }
+        beg = fwudp->inbuf.vacant;
+        if (beg == lim) { /* no vacant slot */
+            break;
+        }
 
 
-    dgram = &fwudp->inbuf.buf[beg];
+        dgram = &fwudp->inbuf.buf[beg];
 
 
-    status = fwany_ipX_addr_set_src(&dgram->src_addr, (struct sockaddr *)&ss);
-    if (status == PXREMAP_FAILED) {
-        return POLLIN;
-    }
+        status = fwany_ipX_addr_set_src(&dgram->src_addr, (struct sockaddr *)&ss);
+        if (status == PXREMAP_FAILED) {
+            break;
+        }
 
-    if (ss.ss_family == AF_INET) {
-        const struct sockaddr_in *peer4 = (const struct sockaddr_in *)&ss;
-        dgram->src_port = htons(peer4->sin_port);
-    }
-    else { /* PF_INET6 */
-        const struct sockaddr_in6 *peer6 = (const struct sockaddr_in6 *)&ss;
-        dgram->src_port = htons(peer6->sin6_port);
-    }
+        if (ss.ss_family == AF_INET) {
+            const struct sockaddr_in *peer4 = (const struct sockaddr_in *)&ss;
+            dgram->src_port = htons(peer4->sin_port);
+        }
+        else { /* PF_INET6 */
+            const struct sockaddr_in6 *peer6 = (const struct sockaddr_in6 *)&ss;
+            dgram->src_port = htons(peer6->sin6_port);
+        }
 
-    p = pbuf_alloc(PBUF_RAW, nread, PBUF_RAM);
-    if (p == NULL) {
-        DPRINTF(("%s: pbuf_alloc(%d) failed\n", __func__, (int)nread));
-        return POLLIN;
-    }
+        p = pbuf_alloc(PBUF_RAW, nread, PBUF_RAM);
+        if (p == NULL) {
+            DPRINTF(("%s: pbuf_alloc(%d) failed\n", __func__, (int)nread));
+            break;
+        }
 
-    error = pbuf_take(p, pollmgr_udpbuf, nread);
-    if (error != ERR_OK) {
-        DPRINTF(("%s: pbuf_take(%d) failed\n", __func__, (int)nread));
-        pbuf_free(p);
-        return POLLIN;
-    }
+        error = pbuf_take(p, pollmgr_udpbuf, nread);
+        if (error != ERR_OK) {
+            DPRINTF(("%s: pbuf_take(%d) failed\n", __func__, (int)nread));
+            pbuf_free(p);
+            break;
+        }
 
-    dgram->p = p;
+        dgram->p = p;
 
-    ++beg;
-    if (beg == fwudp->inbuf.bufsize) {
-        beg = 0;
-    }
-    fwudp->inbuf.vacant = beg;
+        ++beg;
+        if (beg == fwudp->inbuf.bufsize) {
+            beg = 0;
+        }
+        fwudp->inbuf.vacant = beg;
 
-    proxy_lwip_post(&fwudp->msg_send);
+        proxy_lwip_post(&fwudp->msg_send);
+    }
 
     return POLLIN;
 }
@@ -34,6 +34,9 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef RT_OS_LINUX
+#include <sys/epoll.h>
+#endif
 #else
 #include <iprt/errcore.h>
 #include <stdlib.h>
@@ -41,12 +44,27 @@
 #include "winpoll.h"
 #endif
 
+#include <iprt/assert.h>
 #include <iprt/req.h>
 #include <iprt/errcore.h>
+#include <iprt/time.h>
 
 
 #define POLLMGR_GARBAGE (-1)
 
+/*
+ * On Linux use epoll(7) so that a wakeup costs in proportion to the
+ * number of ready sockets, not to the number of sockets we poll.  It
+ * is level-triggered to keep the poll(2) semantics callbacks expect.
+ */
+#ifdef RT_OS_LINUX
+# define POLLMGR_EPOLL 1
+# define POLLMGR_EPOLL_BATCH 64 /* max events per epoll_wait() */
+#endif
+
+/* how often to report the counters (ms) */
+#define POLLMGR_STATS_INTERVAL (60 * 1000)
+
 
 enum {
     POLLMGR_QUEUE = 0,
@@ -78,6 +96,21 @@ struct pollmgr {
     RTREQQUEUE queue;
     struct pollmgr_handler queue_handler;
     struct pollmgr_chan chan_handlers[POLLMGR_CHAN_COUNT];
+
+#ifdef POLLMGR_EPOLL
+    int epfd;                   /* -1 if we fell back to poll(2) */
+    int ndeleted;               /* slots killed since last g/c */
+    struct epoll_event epevents[POLLMGR_EPOLL_BATCH];
+#endif
+
+    /* counters, see pollmgr_stats_update() */
+    struct {
+        uint64_t wakeups;       /* poll returns with ready fds */
+        uint64_t events;        /* ready fds dispatched */
+        int nready_max;         /* largest wakeup since last report */
+        nfds_t nfds_max;        /* max number of slots in use */
+        uint64_t last_report;   /* RTTimeMilliTS() of last report */
+    } stats;
 } pollmgr;
 
 
@@ -85,6 +118,13 @@ static int pollmgr_queue_callback(struct pollmgr_handler *, SOCKET, int);
 static void pollmgr_chan_call_handler(int, void *);
 
 static void pollmgr_loop(void);
+#ifdef POLLMGR_EPOLL
+static void pollmgr_loop_epoll(void);
+static void pollmgr_epoll_ctl(int, int);
+#endif
+static int pollmgr_call_handler(int, SOCKET, int);
+static void pollmgr_compact(SOCKET);
+static void pollmgr_stats_update(int);
 
 static void pollmgr_add_at(int, struct pollmgr_handler *, SOCKET, int);
 static void pollmgr_refptr_delete(struct pollmgr_refptr *);
@@ -121,6 +161,10 @@ pollmgr_init(void)
     pollmgr.handlers = NULL;
     pollmgr.capacity = 0;
     pollmgr.nfds = 0;
+#ifdef POLLMGR_EPOLL
+    pollmgr.epfd = -1;
+    pollmgr.ndeleted = 0;
+#endif
 
     for (i = 0; i < POLLMGR_SLOT_STATIC_COUNT; ++i) {
         pollmgr.chan[i][POLLMGR_CHFD_RD] = INVALID_SOCKET;
@@ -193,6 +237,13 @@ pollmgr_init(void)
         pollmgr.fds[i].revents = 0;
     }
 
+#ifdef POLLMGR_EPOLL
+    pollmgr.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (pollmgr.epfd < 0) {
+        DPRINTF0(("epoll_create1: %R[sockerr], using poll\n", errno));
+    }
+#endif
+
     /* add request queue notification */
     pollmgr.queue_handler.callback = pollmgr_queue_callback;
     pollmgr.queue_handler.data = NULL;
@@ -453,6 +504,10 @@ pollmgr_add_at(int slot, struct pollmgr_handler *handler, SOCKET fd, int events)
     pollmgr.handlers[slot] = handler;
 
     handler->slot = slot;
+
+#ifdef POLLMGR_EPOLL
+    pollmgr_epoll_ctl(EPOLL_CTL_ADD, slot);
+#endif
 }
 
 
@@ -463,6 +518,9 @@ pollmgr_update_events(int slot, int events)
     LWIP_ASSERT1((nfds_t)slot < pollmgr.nfds);
 
     pollmgr.fds[slot].events = events;
+#ifdef POLLMGR_EPOLL
+    pollmgr_epoll_ctl(EPOLL_CTL_MOD, slot);
+#endif
 }
 
 
@@ -474,14 +532,60 @@ pollmgr_del_slot(int slot)
     DPRINTF2(("%s(%d): fd %d ! DELETED\n",
               __func__, slot, pollmgr.fds[slot].fd));
 
+#ifdef POLLMGR_EPOLL
+    if (pollmgr.epfd >= 0) {
+        pollmgr_epoll_ctl(EPOLL_CTL_DEL, slot);
+        ++pollmgr.ndeleted;
+    }
+#endif
     pollmgr.fds[slot].fd = INVALID_SOCKET; /* see poll loop */
 }
 
 
+#ifdef POLLMGR_EPOLL
+/*
+ * Mirror the slot's pollfd in the epoll set.  The slot index is
+ * passed back to us in epoll_event::data.
+ */
+static void
+pollmgr_epoll_ctl(int op, int slot)
+{
+    struct epoll_event ev;
+    SOCKET fd;
+    int status;
+
+    /* we pass poll(2) event masks to epoll(7) as is */
+    AssertCompile(POLLIN == EPOLLIN && POLLPRI == EPOLLPRI && POLLOUT == EPOLLOUT);
+    AssertCompile(POLLERR == EPOLLERR && POLLHUP == EPOLLHUP);
+
+    fd = pollmgr.fds[slot].fd;
+    if (pollmgr.epfd < 0 || fd == INVALID_SOCKET) {
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (uint32_t)pollmgr.fds[slot].events;
+    ev.data.u32 = (uint32_t)slot;
+
+    status = epoll_ctl(pollmgr.epfd, op, fd, &ev);
+    if (status < 0) {
+        DPRINTF0(("%s: op %d, fd %d: %R[sockerr]\n",
+                  __func__, op, fd, errno));
+    }
+}
+#endif /* POLLMGR_EPOLL */
+
+
 void
 pollmgr_thread(void *ignored)
 {
     LWIP_UNUSED_ARG(ignored);
+#ifdef POLLMGR_EPOLL
+    if (pollmgr.epfd >= 0) {
+        pollmgr_loop_epoll();
+        return;
+    }
+#endif
     pollmgr_loop();
 }
 
@@ -520,12 +624,12 @@ pollmgr_loop(void)
             continue;           /* - but be defensive */
         }
 
+        pollmgr_stats_update(nready);
 
         delfirst = INVALID_SOCKET;
         pdelprev = &delfirst;
 
         for (i = 0; (nfds_t)i < pollmgr.nfds && nready > 0; ++i) {
-            struct pollmgr_handler *handler;
             SOCKET fd;
             int revents, nevents;
 
@@ -552,38 +656,7 @@ pollmgr_loop(void)
             }
             --nready;
 
-            handler = pollmgr.handlers[i];
-
-            if (handler != NULL && handler->callback != NULL) {
-#ifdef LWIP_PROXY_DEBUG
-# if LWIP_PROXY_DEBUG /* DEBUG */
-                if (i < POLLMGR_SLOT_FIRST_DYNAMIC) {
-                    if (revents == POLLIN) {
-                        DPRINTF2(("%s: ch %d\n", __func__, i));
-                    }
-                    else {
-                        DPRINTF2(("%s: ch %d @ revents 0x%x!\n",
-                                  __func__, i, revents));
-                    }
-                }
-                else {
-                    DPRINTF2(("%s: fd %d @ revents 0x%x\n",
-                              __func__, fd, revents));
-                }
-# endif /* LWIP_PROXY_DEBUG / DEBUG */
-#endif
-                nevents = (*handler->callback)(handler, fd, revents);
-            }
-            else {
-                DPRINTF0(("%s: invalid handler for fd %d: ", __func__, fd));
-                if (handler == NULL) {
-                    DPRINTF0(("NULL\n"));
-                }
-                else {
-                    DPRINTF0(("%p (callback = NULL)\n", (void *)handler));
-                }
-                nevents = -1;   /* delete it */
-            }
+            nevents = pollmgr_call_handler(i, fd, revents);
 
           update_events:
             if (nevents >= 0) {
@@ -616,60 +689,252 @@ pollmgr_loop(void)
             }
         } /* processing loop */
 
+        pollmgr_compact(delfirst);
+    } /* poll loop */
+}
 
-        /*
-         * Garbage collect and compact the array.
-         *
-         * We overload pollfd::fd of garbage entries to store the
-         * index of the next garbage entry.  The garbage list is
-         * co-directional with the fds array.  The index of the first
-         * entry is in "delfirst", the last entry "points to"
-         * INVALID_SOCKET.
-         *
-         * See update_events code for nevents < 0 at the end of the
-         * processing loop above.
-         */
-        while (delfirst != INVALID_SOCKET) {
-            const int last = pollmgr.nfds - 1;
 
-            /*
-             * We want a live entry in the last slot to swap into the
-             * freed slot, so make sure we have one.
-             */
-            if (pollmgr.fds[last].events == POLLMGR_GARBAGE /* garbage */
-                || pollmgr.fds[last].fd == INVALID_SOCKET)  /* or killed */
-            {
-                /* drop garbage entry at the end of the array */
-                --pollmgr.nfds;
-
-                if (delfirst == (SOCKET)last) {
-                    /* congruent to delnext >= pollmgr.nfds test below */
-                    delfirst = INVALID_SOCKET; /* done */
-                }
+#ifdef POLLMGR_EPOLL
+/*
+ * Same as pollmgr_loop() but only visits the slots epoll reports as
+ * ready instead of scanning the whole array on every wakeup.
+ *
+ * Slot indices are stored in epoll_event::data, so they remain valid
+ * during the processing loop.  Deleted slots are only marked there
+ * and collected with a single ascending pass afterwards, since the
+ * garbage list threaded through pollfd::fd must be co-directional
+ * with the array (see pollmgr_compact()).
+ */
+static void
+pollmgr_loop_epoll(void)
+{
+    int nready;
+    SOCKET delfirst;
+    SOCKET *pdelprev;
+    int i, k;
+
+    for (;;) {
+        nready = epoll_wait(pollmgr.epfd, pollmgr.epevents,
+                            POLLMGR_EPOLL_BATCH, -1);
+
+        DPRINTF2(("%s: ready %d fd%s\n",
+                  __func__, nready, (nready == 1 ? "" : "s")));
+
+        if (nready < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-            else {
-                const SOCKET delnext = pollmgr.fds[delfirst].fd;
 
-                /* copy live entry at the end to the first slot being freed */
-                pollmgr.fds[delfirst] = pollmgr.fds[last]; /* struct copy */
-                pollmgr.handlers[delfirst] = pollmgr.handlers[last];
-                pollmgr.handlers[delfirst]->slot = (int)delfirst;
-                --pollmgr.nfds;
+            err(EXIT_FAILURE, "epoll_wait"); /* XXX: what to do on error? */
+            /* NOTREACHED*/
+        }
+        else if (nready == 0) { /* cannot happen, we wait forever (-1) */
+            continue;           /* - but be defensive */
+        }
+
+        pollmgr_stats_update(nready);
+
+        for (k = 0; k < nready; ++k) {
+            SOCKET fd;
+            int revents, nevents;
 
-                if ((nfds_t)delnext >= pollmgr.nfds) {
-                    delfirst = INVALID_SOCKET; /* done */
+            i = (int)pollmgr.epevents[k].data.u32;
+            if ((nfds_t)i >= pollmgr.nfds) {
+                continue;       /* be defensive */
+            }
+
+            /* deleted by pollmgr_del_slot() earlier in this batch */
+            fd = pollmgr.fds[i].fd;
+            if (fd == INVALID_SOCKET) {
+                continue;
+            }
+
+            revents = (int)pollmgr.epevents[k].events;
+            nevents = pollmgr_call_handler(i, fd, revents);
+
+            if (nevents >= 0) {
+                if (nevents != pollmgr.fds[i].events) {
+                    DPRINTF2(("%s: fd %d ! nevents 0x%x\n",
+                              __func__, fd, nevents));
+                    pollmgr.fds[i].events = nevents;
+                    pollmgr_epoll_ctl(EPOLL_CTL_MOD, i);
                 }
-                else {
-                    delfirst = delnext;
+            }
+            else {
+                DPRINTF2(("%s: fd %d ! DELETED%s\n", __func__, fd,
+                          i < POLLMGR_SLOT_FIRST_DYNAMIC ? " (channel)" : ""));
+                pollmgr_epoll_ctl(EPOLL_CTL_DEL, i);
+                pollmgr.fds[i].fd = INVALID_SOCKET;
+                pollmgr.fds[i].events = 0;
+                pollmgr.handlers[i] = NULL;
+                if (i >= POLLMGR_SLOT_FIRST_DYNAMIC) {
+                    ++pollmgr.ndeleted;
                 }
             }
+        } /* processing loop */
 
-            pollmgr.fds[last].fd = INVALID_SOCKET;
-            pollmgr.fds[last].events = 0;
-            pollmgr.fds[last].revents = 0;
-            pollmgr.handlers[last] = NULL;
+        if (pollmgr.ndeleted == 0) {
+            continue;
         }
-    } /* poll loop */
+
+        /* Don't garbage-collect channels. */
+        delfirst = INVALID_SOCKET;
+        pdelprev = &delfirst;
+        for (i = POLLMGR_SLOT_FIRST_DYNAMIC; (nfds_t)i < pollmgr.nfds; ++i) {
+            if (pollmgr.fds[i].fd != INVALID_SOCKET) {
+                continue;
+            }
+
+            *pdelprev = i;  /* make previous entry point to us */
+            pdelprev = &pollmgr.fds[i].fd;
+
+            pollmgr.fds[i].events = POLLMGR_GARBAGE;
+            pollmgr.fds[i].revents = 0;
+            pollmgr.handlers[i] = NULL;
+        }
+        pollmgr.ndeleted = 0;
+
+        pollmgr_compact(delfirst);
+    } /* epoll loop */
+}
+#endif /* POLLMGR_EPOLL */
+
+
+/*
+ * Invoke the handler registered for the slot.  Returns the new events
+ * mask, or -1 if the slot should be deleted.
+ */
+static int
+pollmgr_call_handler(int i, SOCKET fd, int revents)
+{
+    struct pollmgr_handler *handler;
+
+    RT_NOREF(fd);
+    handler = pollmgr.handlers[i];
+
+    if (handler != NULL && handler->callback != NULL) {
+#ifdef LWIP_PROXY_DEBUG
+# if LWIP_PROXY_DEBUG /* DEBUG */
+        if (i < POLLMGR_SLOT_FIRST_DYNAMIC) {
+            if (revents == POLLIN) {
+                DPRINTF2(("%s: ch %d\n", __func__, i));
+            }
+            else {
+                DPRINTF2(("%s: ch %d @ revents 0x%x!\n",
+                          __func__, i, revents));
+            }
+        }
+        else {
+            DPRINTF2(("%s: fd %d @ revents 0x%x\n",
+                      __func__, fd, revents));
+        }
+# endif /* LWIP_PROXY_DEBUG / DEBUG */
+#endif
+        return (*handler->callback)(handler, fd, revents);
+    }
+
+    DPRINTF0(("%s: invalid handler for fd %d: ", __func__, fd));
+    if (handler == NULL) {
+        DPRINTF0(("NULL\n"));
+    }
+    else {
+        DPRINTF0(("%p (callback = NULL)\n", (void *)handler));
+    }
+    return -1;                  /* delete it */
+}
+
+
+/*
+ * Garbage collect and compact the array.
+ *
+ * We overload pollfd::fd of garbage entries to store the index of the
+ * next garbage entry.  The garbage list is co-directional with the fds
+ * array.  The index of the first entry is in "delfirst", the last
+ * entry "points to" INVALID_SOCKET.
+ *
+ * See update_events code for nevents < 0 at the end of the processing
+ * loop in pollmgr_loop().
+ */
+static void
+pollmgr_compact(SOCKET delfirst)
+{
+    while (delfirst != INVALID_SOCKET) {
+        const int last = pollmgr.nfds - 1;
+
+        /*
+         * We want a live entry in the last slot to swap into the
+         * freed slot, so make sure we have one.
+         */
+        if (pollmgr.fds[last].events == POLLMGR_GARBAGE /* garbage */
+            || pollmgr.fds[last].fd == INVALID_SOCKET)  /* or killed */
+        {
+            /* drop garbage entry at the end of the array */
+            --pollmgr.nfds;
+
+            if (delfirst == (SOCKET)last) {
+                /* congruent to delnext >= pollmgr.nfds test below */
+                delfirst = INVALID_SOCKET; /* done */
+            }
+        }
+        else {
+            const SOCKET delnext = pollmgr.fds[delfirst].fd;
+
+            /* copy live entry at the end to the first slot being freed */
+            pollmgr.fds[delfirst] = pollmgr.fds[last]; /* struct copy */
+            pollmgr.handlers[delfirst] = pollmgr.handlers[last];
+            pollmgr.handlers[delfirst]->slot = (int)delfirst;
+#ifdef POLLMGR_EPOLL
+            /* the fd moved, update the slot index epoll reports */
+            pollmgr_epoll_ctl(EPOLL_CTL_MOD, (int)delfirst);
+#endif
+            --pollmgr.nfds;
+
+            if ((nfds_t)delnext >= pollmgr.nfds) {
+                delfirst = INVALID_SOCKET; /* done */
+            }
+            else {
+                delfirst = delnext;
+            }
+        }
+
+        pollmgr.fds[last].fd = INVALID_SOCKET;
+        pollmgr.fds[last].events = 0;
+        pollmgr.fds[last].revents = 0;
+        pollmgr.handlers[last] = NULL;
+    }
+}
+
+
+/*
+ * Account for a wakeup of the poll loop and report the counters
+ * every POLLMGR_STATS_INTERVAL milliseconds.
+ */
+static void
+pollmgr_stats_update(int nready)
+{
+    uint64_t now;
+
+    ++pollmgr.stats.wakeups;
+    pollmgr.stats.events += nready;
+    if (nready > pollmgr.stats.nready_max) {
+        pollmgr.stats.nready_max = nready;
+    }
+    if (pollmgr.nfds > pollmgr.stats.nfds_max) {
+        pollmgr.stats.nfds_max = pollmgr.nfds;
+    }
+
+    now = RTTimeMilliTS();
+    if (now - pollmgr.stats.last_report < POLLMGR_STATS_INTERVAL) {
+        return;
+    }
+    pollmgr.stats.last_report = now;
+
+    LogRel2(("NAT: pollmgr: %RU64 wakeups, %RU64 events, max %d ready, "
+             "%u slots in use (max %u)\n",
+             pollmgr.stats.wakeups, pollmgr.stats.events,
+             pollmgr.stats.nready_max,
+             (unsigned int)pollmgr.nfds, (unsigned int)pollmgr.stats.nfds_max));
+    pollmgr.stats.nready_max = 0;
 }
 
 
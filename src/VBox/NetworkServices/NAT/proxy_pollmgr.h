@@ -82,4 +82,7 @@ void pollmgr_thread(void *);
 /* buffer for callbacks to receive udp without worrying about truncation */
 extern u8_t pollmgr_udpbuf[64 * 1024];
 
+/* max datagrams udp callbacks read from a socket per wakeup */
+#define POLLMGR_UDP_BATCH 32
+
 #endif /* !VBOX_INCLUDED_SRC_NAT_proxy_pollmgr_h */
@@ -721,6 +721,7 @@ pxudp_pmgr_pump(struct pollmgr_handler *handler, SOCKET fd, int revents)
     struct pbuf *p;
     ssize_t nread;
     err_t error;
+    int ndgrams;
 
     pxudp = (struct pxudp *)handler->data;
     LWIP_ASSERT1(handler == &pxudp->pmhdl);
@@ -759,36 +760,45 @@ pxudp_pmgr_pump(struct pollmgr_handler *handler, SOCKET fd, int revents)
         return POLLIN;
     }
 
+    /*
+     * The socket is non-blocking, so read what has queued up (within
+     * reason) instead of taking a trip through poll for each datagram.
+     */
+    for (ndgrams = 0; ndgrams < POLLMGR_UDP_BATCH; ++ndgrams) {
 #ifdef RT_OS_WINDOWS
-    nread = recv(pxudp->sock, (char *)pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0);
+        nread = recv(pxudp->sock, (char *)pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0);
 #else
-    nread = recv(pxudp->sock, pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0);
+        nread = recv(pxudp->sock, pollmgr_udpbuf, sizeof(pollmgr_udpbuf), 0);
 #endif
-    if (nread == SOCKET_ERROR) {
-        DPRINTF(("%s: %R[sockerr]\n", __func__, SOCKERRNO()));
-        return POLLIN;
-    }
+        if (nread == SOCKET_ERROR) {
+            int sockerr = SOCKERRNO();
+            if (ndgrams == 0 || !proxy_error_is_transient(sockerr)) {
+                DPRINTF(("%s: %R[sockerr]\n", __func__, sockerr));
+            }
+            break;
+        }
 
-    p = pbuf_alloc(PBUF_RAW, (u16_t)nread, PBUF_RAM);
-    if (p == NULL) {
-        DPRINTF(("%s: pbuf_alloc(%d) failed\n", __func__, (int)nread));
-        return POLLIN;
-    }
+        p = pbuf_alloc(PBUF_RAW, (u16_t)nread, PBUF_RAM);
+        if (p == NULL) {
+            DPRINTF(("%s: pbuf_alloc(%d) failed\n", __func__, (int)nread));
+            break;
+        }
 
-    error = pbuf_take(p, pollmgr_udpbuf, (u16_t)nread);
-    if (error != ERR_OK) {
-        DPRINTF(("%s: pbuf_take(%d) failed\n", __func__, (int)nread));
-        pbuf_free(p);
-        return POLLIN;
-    }
+        error = pbuf_take(p, pollmgr_udpbuf, (u16_t)nread);
+        if (error != ERR_OK) {
+            DPRINTF(("%s: pbuf_take(%d) failed\n", __func__, (int)nread));
+            pbuf_free(p);
+            break;
+        }
 
-    error = sys_mbox_trypost(&pxudp->inmbox, p);
-    if (error != ERR_OK) {
-        pbuf_free(p);
-        return POLLIN;
-    }
+        error = sys_mbox_trypost(&pxudp->inmbox, p);
+        if (error != ERR_OK) {
+            pbuf_free(p);
+            break;
+        }
 
-    proxy_lwip_post(&pxudp->msg_inbound);
+        proxy_lwip_post(&pxudp->msg_inbound);
+    }
 
     return POLLIN;
 }
@@ -232,6 +232,19 @@ RTDECL(PRTCPUSET) RTMpGetOnlineSet(PRTCPUSET pSet)
 }
 
 
+RTDECL(PRTCPUSET) RTMpGetNodeOnlineSet(uint32_t idNode, PRTCPUSET pSet)
+{
+    /* Each CPU has a nodeN link to the node it belongs to. */
+    RTCpuSetEmpty(pSet);
+    RTCPUID cMax = rtMpLinuxMaxCpus();
+    for (RTCPUID idCpu = 0; idCpu < cMax; idCpu++)
+        if (   RTMpIsCpuOnline(idCpu)
+            && RTLinuxSysFsExists("devices/system/cpu/cpu%d/node%u", (int)idCpu, idNode))
+            RTCpuSetAdd(pSet, idCpu);
+    return RTCpuSetCount(pSet) > 0 ? pSet : NULL;
+}
+
+
 RTDECL(RTCPUID) RTMpGetOnlineCount(void)
 {
     RTCPUSET Set;
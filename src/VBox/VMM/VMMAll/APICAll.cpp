@@ -1206,6 +1206,104 @@ static int apicSetTprEx(PVMCPU pVCpu, uint32_t uTpr, bool fForceX2ApicBehaviour)
 }
 
 
+/**
+ * Syncs the KVM paravirtualized EOI state with the guest.
+ *
+ * If the guest has cleared the PV EOI flag, it has skipped the EOI write for the
+ * offered vector and we complete the EOI on its behalf.  Otherwise, the flag is
+ * taken back if another interrupt is pending or @a fRevoke is set, so the guest
+ * falls back to writing the EOI register.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure.
+ * @param   fRevoke     Whether to take back the flag even if nothing is
+ *                      pending.
+ */
+static void apicPvEoiSync(PVMCPU pVCpu, bool fRevoke)
+{
+    PAPICCPU pApicCpu = VMCPU_TO_APICCPU(pVCpu);
+    if (RT_LIKELY(!pApicCpu->fPvEoiPending))
+        return;
+
+    PVM        pVM        = pVCpu->CTX_SUFF(pVM);
+    PXAPICPAGE pXApicPage = VMCPU_TO_XAPICPAGE(pVCpu);
+    uint8_t    bFlag      = 0;
+    int rc = PGMPhysSimpleReadGCPhys(pVM, &bFlag, pApicCpu->GCPhysPvEoi, sizeof(bFlag));
+    if (   RT_SUCCESS(rc)
+        && (bFlag & APIC_PV_EOI_FLAG))
+    {
+        /* The guest is still servicing the interrupt. */
+        if (   !fRevoke
+            && apicGetHighestSetBitInReg(&pXApicPage->irr, -1 /* rcNotFound */) < 0)
+            return;
+
+        bFlag &= ~APIC_PV_EOI_FLAG;
+        PGMPhysSimpleWriteGCPhys(pVM, pApicCpu->GCPhysPvEoi, &bFlag, sizeof(bFlag));
+        pApicCpu->fPvEoiPending = false;
+        STAM_COUNTER_INC(&pApicCpu->StatPvEoiRevoked);
+        Log2(("APIC%u: apicPvEoiSync: Revoked PV EOI. uVector=%#x\n", pVCpu->idCpu, pApicCpu->uPvEoiVector));
+        return;
+    }
+
+    /*
+     * The guest signalled the EOI by clearing the flag.  Complete it the way
+     * apicSetEoi() would; only edge-triggered interrupts are ever offered.
+     */
+    pApicCpu->fPvEoiPending = false;
+    if (RT_SUCCESS(rc))
+    {
+        uint8_t const uVector = pApicCpu->uPvEoiVector;
+        Assert(!apicTestVectorInReg(&pXApicPage->tmr, uVector));
+        Log2(("APIC%u: apicPvEoiSync: Completing PV EOI. uVector=%#x\n", pVCpu->idCpu, uVector));
+        apicClearVectorInReg(&pXApicPage->isr, uVector);
+        apicUpdatePpr(pVCpu);
+        apicSignalNextPendingIntr(pVCpu);
+        STAM_COUNTER_INC(&pApicCpu->StatPvEoiCompleted);
+    }
+}
+
+
+/**
+ * Offers the guest to skip the EOI write for an interrupt just accepted, using
+ * the KVM paravirtualized EOI flag.
+ *
+ * This is only done when it's safe to do the EOI lazily: the interrupt is
+ * edge-triggered (no I/O APIC EOI broadcast), it's the only one in service and
+ * nothing else is pending.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure.
+ * @param   uVector     The vector just moved to the ISR.
+ */
+static void apicPvEoiOffer(PVMCPU pVCpu, uint8_t uVector)
+{
+    PAPICCPU pApicCpu = VMCPU_TO_APICCPU(pVCpu);
+    if (RT_LIKELY(pApicCpu->GCPhysPvEoi == NIL_RTGCPHYS))
+        return;
+    Assert(!pApicCpu->fPvEoiPending);
+
+    PCXAPICPAGE pXApicPage = VMCPU_TO_CXAPICPAGE(pVCpu);
+    if (   apicTestVectorInReg(&pXApicPage->tmr, uVector)
+        || apicGetHighestSetBitInReg(&pXApicPage->irr, -1 /* rcNotFound */) >= 0)
+        return;
+    for (size_t i = 0; i < RT_ELEMENTS(pXApicPage->isr.u); i++)
+    {
+        uint32_t uFragment = pXApicPage->isr.u[i].u32Reg;
+        if (i == uVector / 32)
+            uFragment &= ~RT_BIT_32(uVector % 32);
+        if (uFragment)
+            return;
+    }
+
+    uint8_t const bFlag = APIC_PV_EOI_FLAG;
+    int rc = PGMPhysSimpleWriteGCPhys(pVCpu->CTX_SUFF(pVM), pApicCpu->GCPhysPvEoi, &bFlag, sizeof(bFlag));
+    if (RT_SUCCESS(rc))
+    {
+        pApicCpu->uPvEoiVector  = uVector;
+        pApicCpu->fPvEoiPending = true;
+        STAM_COUNTER_INC(&pApicCpu->StatPvEoiOffered);
+    }
+}
+
+
 /**
  * Sets the End-Of-Interrupt (EOI) register.
  *
@@ -1224,6 +1322,9 @@ static VBOXSTRICTRC apicSetEoi(PVMCPU pVCpu, uint32_t uEoi, int rcBusy, bool fFo
     Log2(("APIC%u: apicSetEoi: uEoi=%#RX32\n", pVCpu->idCpu, uEoi));
     STAM_COUNTER_INC(&pVCpu->apic.s.StatEoiWrite);
 
+    /* A real EOI write means the guest isn't using the PV EOI flag for this one. */
+    apicPvEoiSync(pVCpu, true /* fRevoke */);
+
     bool const fX2ApicMode = XAPIC_IN_X2APIC_MODE(pVCpu) || fForceX2ApicBehaviour;
     if (   fX2ApicMode
         && (uEoi & ~XAPIC_EOI_WO_VALID))
@@ -2273,6 +2374,9 @@ void apicInitIpi(PVMCPU pVCpu)
     /* Clear the interrupt line states for LINT0 and LINT1 pins. */
     pApicCpu->fActiveLint0 = false;
     pApicCpu->fActiveLint1 = false;
+
+    /* The ISR is gone, so is any PV EOI we were waiting for. */
+    pApicCpu->fPvEoiPending = false;
 }
 
 
@@ -2320,7 +2424,10 @@ void apicResetCpu(PVMCPU pVCpu, bool fResetApicBaseMsr)
     /** @todo It isn't clear in the spec. where exactly the default base address
      *        is (re)initialized, atm we do it here in Reset. */
     if (fResetApicBaseMsr)
+    {
         apicResetBaseMsr(pVCpu);
+        VMCPU_TO_APICCPU(pVCpu)->GCPhysPvEoi = NIL_RTGCPHYS;
+    }
 
     /*
      * Initialize the APIC ID register to xAPIC format.
@@ -2851,6 +2958,8 @@ VMM_INT_DECL(int) APICGetInterrupt(PVMCPU pVCpu, uint8_t *pu8Vector, uint32_t *p
     if (   fApicHwEnabled
         && pXApicPage->svr.u.fApicSoftwareEnable)
     {
+        apicPvEoiSync(pVCpu, false /* fRevoke */);
+
         int const irrv = apicGetHighestSetBitInReg(&pXApicPage->irr, -1);
         if (RT_LIKELY(irrv >= 0))
         {
@@ -2893,6 +3002,8 @@ VMM_INT_DECL(int) APICGetInterrupt(PVMCPU pVCpu, uint8_t *pu8Vector, uint32_t *p
                 *puSrcTag = pApicCpu->auSrcTags[uVector];
                 pApicCpu->auSrcTags[uVector] = 0;
 
+                apicPvEoiOffer(pVCpu, uVector);
+
                 Log2(("APIC%u: apicGetInterrupt: Valid Interrupt. uVector=%#x\n", pVCpu->idCpu, uVector));
                 *pu8Vector = uVector;
                 return VINF_SUCCESS;
@@ -3346,6 +3457,9 @@ VMMDECL(void) APICUpdatePendingInterrupts(PVMCPU pVCpu)
         }
     }
 
+    /* Complete or take back a PV EOI before signalling, it may lower the PPR. */
+    apicPvEoiSync(pVCpu, false /* fRevoke */);
+
     STAM_PROFILE_STOP(&pApicCpu->StatUpdatePendingIntrs, a);
     Log3(("APIC%u: APICUpdatePendingInterrupts: fHasPendingIntrs=%RTbool\n", pVCpu->idCpu, fHasPendingIntrs));
 
@@ -3474,6 +3588,24 @@ VMM_INT_DECL(VBOXSTRICTRC) APICHvSetEoi(PVMCPU pVCpu, uint32_t uEoi)
 }
 
 
+/**
+ * Enables or disables the KVM paravirtualized EOI, KVM interface.
+ *
+ * @param   pVCpu           The cross context virtual CPU structure.
+ * @param   GCPhysPvEoi     Guest-physical address of the PV EOI flag,
+ *                          NIL_RTGCPHYS to disable.
+ */
+VMM_INT_DECL(void) APICKvmSetPvEoi(PVMCPU pVCpu, RTGCPHYS GCPhysPvEoi)
+{
+    Assert(pVCpu);
+    VMCPU_ASSERT_EMT_OR_NOT_RUNNING(pVCpu);
+
+    /* Don't leave a flag behind at the old location. */
+    apicPvEoiSync(pVCpu, true /* fRevoke */);
+    VMCPU_TO_APICCPU(pVCpu)->GCPhysPvEoi = GCPhysPvEoi;
+}
+
+
 /**
  * Gets the APIC page pointers for the specified VCPU.
  *
@@ -27,6 +27,7 @@
 #include <iprt/assert.h>
 #include <iprt/asm.h>
 #include <iprt/stdarg.h>
+#include <iprt/time.h>
 
 
 /*
@@ -38,6 +39,7 @@ AssertCompileMembersSameSizeAndOffset(VM, dbgf.s.bmSelectedEvents,      VM, dbgf
 AssertCompileMembersSameSizeAndOffset(VM, dbgf.s.cHardIntBreakpoints,   VM, dbgf.ro.cHardIntBreakpoints);
 AssertCompileMembersSameSizeAndOffset(VM, dbgf.s.cSoftIntBreakpoints,   VM, dbgf.ro.cSoftIntBreakpoints);
 AssertCompileMembersSameSizeAndOffset(VM, dbgf.s.cSelectedEvents,       VM, dbgf.ro.cSelectedEvents);
+AssertCompileMembersSameSizeAndOffset(VM, dbgf.s.fEvtTraceMask,         VM, dbgf.ro.fEvtTraceMask);
 
 
 /**
@@ -408,3 +410,43 @@ VMM_INT_DECL(VBOXSTRICTRC) DBGFEventGenericWithArgs(PVM pVM, PVMCPU pVCpu, DBGFE
     return VINF_SUCCESS;
 }
 
+
+/**
+ * Adds a record to the event tracer ring of the calling VCPU.
+ *
+ * The caller is expected to check DBGF_IS_EVT_TRACE_ENABLED() first so the
+ * disabled case stays cheap.  This is a no-op in raw-mode context.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure.
+ * @param   enmType     The record type.
+ * @param   u16Arg      Type specific 16-bit argument.
+ * @param   u32Arg      Type specific 32-bit argument.
+ * @param   u64Arg0     Type specific 64-bit argument \#0.
+ * @param   u64Arg1     Type specific 64-bit argument \#1.
+ *
+ * @thread  EMT(pVCpu)
+ */
+VMM_INT_DECL(void) DBGFEvtTraceAdd(PVMCPU pVCpu, DBGFEVTTRACETYPE enmType, uint16_t u16Arg, uint32_t u32Arg,
+                                   uint64_t u64Arg0, uint64_t u64Arg1)
+{
+#ifndef IN_RC
+    VMCPU_ASSERT_EMT(pVCpu);
+    PVM      pVM    = pVCpu->CTX_SUFF(pVM);
+    uint8_t *pbBase = pVM->dbgf.s.CTX_SUFF(pbEvtTrace);
+    if (RT_LIKELY(pbBase))
+    {
+        PDBGFEVTTRACERING pRing = (PDBGFEVTTRACERING)(pbBase + (uintptr_t)pVCpu->idCpu * pVM->dbgf.s.cbEvtTraceRing);
+        uint64_t const    idx   = pRing->idxNext;
+        PDBGFEVTTRACEREC  pRec  = &pRing->aRecs[idx & (pVM->dbgf.s.cEvtTraceEntries - 1)];
+        pRec->u64NanoTS = RTTimeNanoTS();
+        pRec->enmType   = (uint16_t)enmType;
+        pRec->u16Arg    = u16Arg;
+        pRec->u32Arg    = u32Arg;
+        pRec->u64Arg0   = u64Arg0;
+        pRec->u64Arg1   = u64Arg1;
+        ASMAtomicWriteU64(&pRing->idxNext, idx + 1); /* publish */
+    }
+#else
+    RT_NOREF(pVCpu, enmType, u16Arg, u32Arg, u64Arg0, u64Arg1);
+#endif
+}
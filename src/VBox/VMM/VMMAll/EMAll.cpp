@@ -22,6 +22,7 @@
 #define LOG_GROUP LOG_GROUP_EM
 #include <VBox/vmm/em.h>
 #include <VBox/vmm/mm.h>
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/selm.h>
 #include <VBox/vmm/patm.h>
 #include <VBox/vmm/pgm.h>
@@ -475,7 +476,21 @@ VMM_INT_DECL(VBOXSTRICTRC) EMHistoryExec(PVMCPU pVCpu, PCEMEXITREC pExitRec, uin
                 rcStrict = VINF_SUCCESS;
 
             if (ExecStats.cExits > 1)
+            {
                 STAM_REL_COUNTER_ADD(&pVCpu->em.s.StatHistoryExecSavedExits, ExecStats.cExits - 1);
+                ((PEMEXITREC)pExitRec)->cFruitlessExecs = 0;
+            }
+            else if (   RT_SUCCESS(rcStrict)
+                     && pVCpu->em.s.idxContinueExitRec == UINT16_MAX
+                     && ++((PEMEXITREC)pExitRec)->cFruitlessExecs >= EM_EXIT_MAX_FRUITLESS_EXECS)
+            {
+                /* The guest code around this exit no longer produces exits in
+                   close succession, so stop paying for IEM here. */
+                ((PEMEXITREC)pExitRec)->enmAction       = EMEXITACTION_NORMAL_PROBED;
+                ((PEMEXITREC)pExitRec)->cFruitlessExecs = 0;
+                LogFlow(("EMHistoryExec/EXEC_WITH_MAX: %RX64 -> PROBED (fruitless)\n", pExitRec->uFlatPC));
+                STAM_REL_COUNTER_INC(&pVCpu->em.s.StatHistoryExecDemoted);
+            }
             STAM_REL_COUNTER_ADD(&pVCpu->em.s.StatHistoryExecInstructions, ExecStats.cInstructions);
             STAM_REL_PROFILE_STOP(&pVCpu->em.s.StatHistoryExec, a);
             return rcStrict;
@@ -503,6 +518,7 @@ VMM_INT_DECL(VBOXSTRICTRC) EMHistoryExec(PVMCPU pVCpu, PCEMEXITREC pExitRec, uin
                 Assert(ExecStats.cMaxExitDistance > 0 && ExecStats.cMaxExitDistance <= 32);
                 pExitRecUnconst->cMaxInstructionsWithoutExit = ExecStats.cMaxExitDistance;
                 pExitRecUnconst->enmAction = EMEXITACTION_EXEC_WITH_MAX;
+                pExitRecUnconst->cFruitlessExecs = 0;
                 LogFlow(("EMHistoryExec/EXEC_PROBE: -> EXEC_WITH_MAX %u\n", ExecStats.cMaxExitDistance));
                 STAM_REL_COUNTER_INC(&pVCpu->em.s.StatHistoryProbedExecWithMax);
             }
@@ -549,7 +565,7 @@ DECL_FORCE_INLINE(PCEMEXITREC) emHistoryRecordInit(PEMEXITREC pExitRec, uint64_t
     pExitRec->uFlatPC                     = uFlatPC;
     pExitRec->uFlagsAndType               = uFlagsAndType;
     pExitRec->enmAction                   = EMEXITACTION_NORMAL;
-    pExitRec->bUnused                     = 0;
+    pExitRec->cFruitlessExecs             = 0;
     pExitRec->cMaxInstructionsWithoutExit = 64;
     pExitRec->uLastExitNo                 = uExitNo;
     pExitRec->cHits                       = 1;
@@ -711,7 +727,15 @@ static PCEMEXITREC emHistoryAddOrUpdateRecord(PVMCPU pVCpu, uint64_t uFlagsAndTy
         case EMEXITACTION_NORMAL:
         {
             uint64_t const cHits = ++pExitRec->cHits;
-            if (cHits < 256)
+            uint32_t const uType = uFlagsAndType & EMEXIT_F_TYPE_MASK;
+            if (   uType == EMEXITTYPE_IO_PORT_STR_READ
+                || uType == EMEXITTYPE_IO_PORT_STR_WRITE)
+            {
+                /* String I/O comes in bursts, get IEM to batch them up sooner. */
+                if (cHits < RT_MAX(pVCpu->em.s.cHistoryProbeMinHits >> EM_EXIT_STR_IO_PROBE_SHIFT, 1))
+                    return NULL;
+            }
+            else if (cHits < pVCpu->em.s.cHistoryProbeMinHits)
                 return NULL;
             LogFlow(("emHistoryAddOrUpdateRecord: [%#x] %#07x %16RX64: -> EXEC_PROBE\n", idxSlot, uFlagsAndType, uFlatPC));
             pExitRec->enmAction = EMEXITACTION_EXEC_PROBE;
@@ -719,8 +743,17 @@ static PCEMEXITREC emHistoryAddOrUpdateRecord(PVMCPU pVCpu, uint64_t uFlagsAndTy
         }
 
         case EMEXITACTION_NORMAL_PROBED:
-            pExitRec->cHits += 1;
-            return NULL;
+        {
+            /* Give it another go every now and then, the guest code around it
+               may be behaving differently by now (driver state changes, etc). */
+            uint64_t const cHits = ++pExitRec->cHits;
+            if (cHits & (EM_EXIT_REPROBE_INTERVAL - 1))
+                return NULL;
+            LogFlow(("emHistoryAddOrUpdateRecord: [%#x] %#07x %16RX64: -> EXEC_PROBE (re-probe)\n", idxSlot, uFlagsAndType, uFlatPC));
+            STAM_REL_COUNTER_INC(&pVCpu->em.s.StatHistoryReprobed);
+            pExitRec->enmAction = EMEXITACTION_EXEC_PROBE;
+            return pExitRec;
+        }
 
         default:
             pExitRec->cHits += 1;
@@ -769,6 +802,9 @@ VMM_INT_DECL(PCEMEXITREC) EMHistoryAddExit(PVMCPU pVCpu, uint32_t uFlagsAndType,
     pHistEntry->uFlagsAndType = uFlagsAndType;
     pHistEntry->idxSlot       = UINT32_MAX;
 
+    if (DBGF_IS_EVT_TRACE_ENABLED(pVCpu->CTX_SUFF(pVM), DBGFEVTTRACE_F_EXIT))
+        DBGFEvtTraceAdd(pVCpu, DBGFEVTTRACETYPE_EXIT, 0, uFlagsAndType, uFlatPC, 0);
+
 #ifndef IN_RC
     /*
      * If common exit type, we will insert/update the exit into the exit record hash table.
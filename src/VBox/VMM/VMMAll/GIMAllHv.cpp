@@ -33,12 +33,14 @@
 #include "GIMHvInternal.h"
 #include "GIMInternal.h"
 #include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmcpuset.h>
 
 #include <VBox/err.h>
 
 #include <iprt/asm-amd64-x86.h>
 #ifdef IN_RING3
 # include <iprt/mem.h>
+# include <iprt/thread.h>
 #endif
 
 
@@ -123,6 +125,132 @@ static int gimHvReadSlowHypercallParamsInOut(PVM pVM, PCPUMCTX pCtx, bool fIs64B
         rc = gimHvReadSlowHypercallParam(pVM, pCtx, fIs64BitMode, GIMHVHYPERCALLPARAM_OUT, prcHv);
     return rc;
 }
+
+
+/**
+ * Handles the HvFlushVirtualAddressSpace[Ex] and HvFlushVirtualAddressList[Ex]
+ * hypercalls.
+ *
+ * We don't track guest address spaces and HM turns remote page invalidations
+ * into full flushes anyway, so all four end up flushing the entire TLB of the
+ * target VCPUs.  Target VCPUs that aren't executing guest code aren't poked,
+ * they flush on their next VM-entry.
+ *
+ * @returns VBox status code.
+ * @param   pVCpu           The cross context virtual CPU structure.
+ * @param   pCtx            Pointer to the guest-CPU context.
+ * @param   fIs64BitMode    Whether the guest is currently in 64-bit mode or not.
+ * @param   uHyperOp        The hypercall operation code.
+ * @param   fHyperFast      Whether this is a fast (register based) hypercall.
+ * @param   prcHv           Where to store the Hyper-V status code. Only valid
+ *                          to the caller when this function returns
+ *                          VINF_SUCCESS.
+ */
+static int gimHvHypercallFlushVa(PVMCPU pVCpu, PCPUMCTX pCtx, bool fIs64BitMode, uint16_t uHyperOp, bool fHyperFast, int *prcHv)
+{
+    PVM       pVM    = pVCpu->CTX_SUFF(pVM);
+    PGIMHV    pHv    = &pVM->gim.s.u.Hv;
+    PGIMHVCPU pHvCpu = &pVCpu->gim.s.u.HvCpu;
+
+    if (!(pHv->uHyperHints & GIM_HV_HINT_HYPERCALL_FOR_TLB_SHOOTDOWN))
+    {
+        LogRelMax(1, ("GIM: HyperV: Denied TLB flush hypercall %#x when the feature is not exposed\n", uHyperOp));
+        *prcHv = GIM_HV_STATUS_ACCESS_DENIED;
+        return VINF_SUCCESS;
+    }
+
+    /* We don't advertise XMM hypercall input, so the input doesn't fit in registers. */
+    if (fHyperFast)
+    {
+        *prcHv = GIM_HV_STATUS_INVALID_HYPERCALL_INPUT;
+        return VINF_SUCCESS;
+    }
+
+    int rc = gimHvReadSlowHypercallParam(pVM, pCtx, fIs64BitMode, GIMHVHYPERCALLPARAM_IN, prcHv);
+    if (   RT_FAILURE(rc)
+        || *prcHv != GIM_HV_STATUS_SUCCESS)
+        return rc;
+
+    /*
+     * Figure out the target VCPUs.  The VP index is the VCPU ID, see MSR_GIM_HV_VP_INDEX.
+     */
+    VMCPUSET CpuSet;
+    VMCPUSET_EMPTY(&CpuSet);
+    uint64_t fFlags;
+    if (   uHyperOp == GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE
+        || uHyperOp == GIM_HV_HYPERCALL_OP_FLUSH_VA_LIST)
+    {
+        PGIMHVFLUSHVAIN pIn = (PGIMHVFLUSHVAIN)pHv->pbHypercallIn;
+        fFlags = pIn->fFlags;
+        if (fFlags & GIM_HV_FLUSH_ALL_PROCESSORS)
+            VMCPUSET_FILL(&CpuSet);
+        else
+        {
+            for (VMCPUID idCpu = 0; idCpu < RT_MIN(pVM->cCpus, 64); idCpu++)
+                if (pIn->u64ProcessorMask & RT_BIT_64(idCpu))
+                    VMCPUSET_ADD(&CpuSet, idCpu);
+        }
+    }
+    else
+    {
+        Assert(   uHyperOp == GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE_EX
+               || uHyperOp == GIM_HV_HYPERCALL_OP_FLUSH_VA_LIST_EX);
+        PGIMHVFLUSHVAEXIN pIn = (PGIMHVFLUSHVAEXIN)pHv->pbHypercallIn;
+        fFlags = pIn->fFlags;
+        if (   (fFlags & GIM_HV_FLUSH_ALL_PROCESSORS)
+            || pIn->u64VpSetFormat == GIM_HV_GENERIC_SET_ALL)
+            VMCPUSET_FILL(&CpuSet);
+        else if (pIn->u64VpSetFormat == GIM_HV_GENERIC_SET_SPARSE_4K)
+        {
+            /* One qword of bank contents per valid bank, 64 banks at most so it all fits in the page. */
+            uint64_t const *pau64Banks = (uint64_t const *)(pIn + 1);
+            unsigned        idxContent = 0;
+            for (unsigned idxBank = 0; idxBank < 64; idxBank++)
+            {
+                if (!(pIn->u64ValidBankMask & RT_BIT_64(idxBank)))
+                    continue;
+                uint64_t const fBank = pau64Banks[idxContent++];
+                for (unsigned iBit = 0; iBit < 64; iBit++)
+                {
+                    VMCPUID const idCpu = idxBank * 64 + iBit;
+                    if (idCpu >= pVM->cCpus)
+                        break;
+                    if (fBank & RT_BIT_64(iBit))
+                        VMCPUSET_ADD(&CpuSet, idCpu);
+                }
+            }
+        }
+        else
+        {
+            *prcHv = GIM_HV_STATUS_INVALID_PARAMETER;
+            return VINF_SUCCESS;
+        }
+    }
+
+    if (fFlags & ~GIM_HV_FLUSH_VALID_MASK)
+    {
+        *prcHv = GIM_HV_STATUS_INVALID_PARAMETER;
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * Do the flushing.
+     */
+    if (   uHyperOp == GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE
+        || uHyperOp == GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE_EX)
+        STAM_REL_COUNTER_INC(&pHvCpu->StatFlushVaSpace);
+    else
+        STAM_REL_COUNTER_INC(&pHvCpu->StatFlushVaList);
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+        if (   idCpu != pVCpu->idCpu
+            && VMCPUSET_IS_PRESENT(&CpuSet, idCpu))
+            STAM_REL_COUNTER_INC(&pHvCpu->StatFlushVaRemoteCpus);
+
+    /* Returns only once no target executes guest code with stale entries. */
+    HMFlushTlbOnVCpus(pVM, &CpuSet);
+    *prcHv = GIM_HV_STATUS_SUCCESS;
+    return VINF_SUCCESS;
+}
 #endif
 
 
@@ -186,8 +314,8 @@ VMM_INT_DECL(VBOXSTRICTRC) gimHvHypercall(PVMCPU pVCpu, PCPUMCTX pCtx)
     const uint16_t   idxHyperRepStart = GIM_HV_HYPERCALL_IN_REP_START_IDX(uHyperIn);
     uint64_t         cHyperRepsDone   = 0;
 
-    /* Currently no repeating hypercalls are supported. */
-    RT_NOREF2(cHyperReps, idxHyperRepStart);
+    /* The only rep hypercalls we support complete all reps in one go. */
+    RT_NOREF(idxHyperRepStart);
 
     int rc     = VINF_SUCCESS;
     int rcHv   = GIM_HV_STATUS_OPERATION_DENIED;
@@ -336,6 +464,40 @@ VMM_INT_DECL(VBOXSTRICTRC) gimHvHypercall(PVMCPU pVCpu, PCPUMCTX pCtx)
                 break;
             }
 
+            case GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE:        /* Non-rep, memory IO. */
+            case GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE_EX:
+            {
+                rc = gimHvHypercallFlushVa(pVCpu, pCtx, fIs64BitMode, uHyperOp, fHyperFast, &rcHv);
+                break;
+            }
+
+            case GIM_HV_HYPERCALL_OP_FLUSH_VA_LIST:         /* Rep, memory IO. */
+            case GIM_HV_HYPERCALL_OP_FLUSH_VA_LIST_EX:
+            {
+                rc = gimHvHypercallFlushVa(pVCpu, pCtx, fIs64BitMode, uHyperOp, fHyperFast, &rcHv);
+                if (   RT_SUCCESS(rc)
+                    && rcHv == GIM_HV_STATUS_SUCCESS)
+                    cHyperRepsDone = cHyperReps;
+                break;
+            }
+
+            case GIM_HV_HYPERCALL_OP_NOTIFY_LONG_SPIN_WAIT: /* Non-rep, fast (register IO). */
+            {
+                if (pHv->fLongSpinWaitNotify)
+                {
+                    /*
+                     * The guest has been spinning on a lock held by a VCPU that probably isn't
+                     * running, give the host a chance to schedule it.
+                     */
+                    STAM_REL_COUNTER_INC(&pVCpu->gim.s.u.HvCpu.StatLongSpinWait);
+                    RTThreadYield();
+                    rcHv = GIM_HV_STATUS_SUCCESS;
+                }
+                else
+                    rcHv = GIM_HV_STATUS_INVALID_HYPERCALL_CODE;
+                break;
+            }
+
             case GIM_HV_EXT_HYPERCALL_OP_QUERY_CAP:              /* Non-rep, extended hypercall. */
             {
                 if (pHv->uPartFlags & GIM_HV_PART_FLAGS_EXTENDED_HYPERCALLS)
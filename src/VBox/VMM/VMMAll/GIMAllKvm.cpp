@@ -27,6 +27,7 @@
 #include <VBox/vmm/pgm.h>
 #include <VBox/vmm/pdmdev.h>
 #include <VBox/vmm/pdmapi.h>
+#include <VBox/vmm/apic.h>
 #include "GIMKvmInternal.h"
 #include "GIMInternal.h"
 #include <VBox/vmm/vm.h>
@@ -103,6 +104,7 @@ VMM_INT_DECL(VBOXSTRICTRC) gimKvmHypercall(PVMCPU pVCpu, PCPUMCTX pCtx)
             if (uHyperArg1 < pVM->cCpus)
             {
                 PVMCPU pVCpuDst = &pVM->aCpus[uHyperArg1];   /* ASSUMES pVCpu index == ApicId of the VCPU. */
+                STAM_REL_COUNTER_INC(&pVCpuDst->gim.s.u.KvmCpu.StatKickCpu);
                 EMUnhaltAndWakeUp(pVM, pVCpuDst);
                 uHyperRet = KVM_HYPERCALL_RET_SUCCESS;
             }
@@ -198,6 +200,14 @@ VMM_INT_DECL(VBOXSTRICTRC) gimKvmReadMsr(PVMCPU pVCpu, uint32_t idMsr, PCCPUMMSR
             *puValue = pKvm->u64WallClockMsr;
             return VINF_SUCCESS;
 
+        case MSR_GIM_KVM_STEAL_TIME:
+            *puValue = pKvmCpu->u64StealTimeMsr;
+            return VINF_SUCCESS;
+
+        case MSR_GIM_KVM_EOI:
+            *puValue = pKvmCpu->u64PvEoiMsr;
+            return VINF_SUCCESS;
+
         default:
         {
 #ifdef IN_RING3
@@ -312,6 +322,60 @@ VMM_INT_DECL(VBOXSTRICTRC) gimKvmWriteMsr(PVMCPU pVCpu, uint32_t idMsr, PCCPUMMS
 #endif /* IN_RING3 */
         }
 
+        case MSR_GIM_KVM_STEAL_TIME:
+        {
+            if (uRawValue & MSR_GIM_KVM_STEAL_TIME_RSVD_MASK)
+                return VERR_CPUM_RAISE_GP_0;
+#ifndef IN_RING3
+            return VINF_CPUM_R3_MSR_WRITE;
+#else
+            if (!MSR_GIM_KVM_STEAL_TIME_IS_ENABLED(uRawValue))
+            {
+                pKvmCpu->u64StealTimeMsr = uRawValue;
+                return VINF_SUCCESS;
+            }
+
+            /* Enable and populate the steal-time struct. */
+            pKvmCpu->u64StealTimeMsr      = uRawValue;
+            pKvmCpu->GCPhysStealTime      = MSR_GIM_KVM_STEAL_TIME_GUEST_GPA(uRawValue);
+            pKvmCpu->u32StealTimeVersion += 2;
+            int rc = gimR3KvmEnableStealTime(pVM, pVCpu);
+            if (RT_FAILURE(rc))
+            {
+                pKvmCpu->u64StealTimeMsr = 0;
+                return VERR_CPUM_RAISE_GP_0;
+            }
+            return VINF_SUCCESS;
+#endif /* IN_RING3 */
+        }
+
+        case MSR_GIM_KVM_EOI:
+        {
+            if (uRawValue & MSR_GIM_KVM_EOI_RSVD_MASK)
+                return VERR_CPUM_RAISE_GP_0;
+#ifndef IN_RING3
+            return VINF_CPUM_R3_MSR_WRITE;
+#else
+            if (!MSR_GIM_KVM_EOI_IS_ENABLED(uRawValue))
+            {
+                APICKvmSetPvEoi(pVCpu, NIL_RTGCPHYS);
+                pKvmCpu->u64PvEoiMsr = uRawValue;
+                return VINF_SUCCESS;
+            }
+
+            /* Only advertised when we can honour it, see gimR3KvmInit(). */
+            PGIMKVM pKvm = &pVM->gim.s.u.Kvm;
+            RTGCPHYS const GCPhysPvEoi = MSR_GIM_KVM_EOI_GUEST_GPA(uRawValue);
+            if (   !(pKvm->uBaseFeat & GIM_KVM_BASE_FEAT_PV_EOI)
+                || !PGMPhysIsGCPhysNormal(pVM, GCPhysPvEoi))
+                return VERR_CPUM_RAISE_GP_0;
+
+            APICKvmSetPvEoi(pVCpu, GCPhysPvEoi);
+            pKvmCpu->u64PvEoiMsr = uRawValue;
+            return VINF_SUCCESS;
+#endif /* IN_RING3 */
+        }
+
         default:
         {
 #ifdef IN_RING3
@@ -25,6 +25,7 @@
 #include <VBox/vmm/pgm.h>
 #include "HMInternal.h"
 #include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmcpuset.h>
 #include <VBox/vmm/hm_vmx.h>
 #include <VBox/vmm/hm_svm.h>
 #include <iprt/errcore.h>
@@ -562,6 +563,64 @@ VMM_INT_DECL(int) HMFlushTlbOnAllVCpus(PVM pVM)
 }
 
 
+/**
+ * Pokes an EMT for a TLB flush and waits until it is no longer executing guest
+ * code with the TLB state it had before VMCPU_FF_TLB_FLUSH was set.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the EMT to
+ *                      poke.  VMCPU_FF_TLB_FLUSH must already be set.
+ */
+static void hmPokeCpuForTlbFlushAndWait(PVMCPU pVCpu)
+{
+#ifdef IN_RING0
+    /* Ring-0 pokes already wait for the world switch, see hmR0PokeCpu. */
+    hmPokeCpuForTlbFlush(pVCpu, true /* fAccountFlushStat */);
+#else
+    /* The ring-3 poke is asynchronous, so spin until the VCPU has switched back. */
+    uint32_t const cWorldSwitchExits = ASMAtomicUoReadU32(&pVCpu->hm.s.cWorldSwitchExits);
+    hmPokeCpuForTlbFlush(pVCpu, true /* fAccountFlushStat */);
+    while (   ASMAtomicUoReadBool(&pVCpu->hm.s.fCheckedTLBFlush)
+           && cWorldSwitchExits == ASMAtomicUoReadU32(&pVCpu->hm.s.cWorldSwitchExits))
+        ASMNopPause();
+#endif
+}
+
+
+/**
+ * Flush the TLBs of a set of VCPUs.
+ *
+ * Only VCPUs currently executing guest code are poked, the others (halted or
+ * busy in ring-3) simply pick up the flush on their next VM-entry.  This does
+ * not return before every poked VCPU has left guest mode, so that the caller
+ * can tell the guest the flush is complete.
+ *
+ * @returns VBox status code.
+ * @param   pVM       The cross context VM structure.
+ * @param   pCpuSet   The set of VCPUs to flush.
+ */
+VMM_INT_DECL(int) HMFlushTlbOnVCpus(PVM pVM, PCVMCPUSET pCpuSet)
+{
+    VMCPUID idThisCpu = VMMGetCpuId(pVM);
+
+    STAM_COUNTER_INC(&pVM->aCpus[idThisCpu].hm.s.StatFlushTlb);
+
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        if (!VMCPUSET_IS_PRESENT(pCpuSet, idCpu))
+            continue;
+
+        /* A flush already pending may have been requested without waiting
+           (HMFlushTlbOnAllVCpus), so always poke and wait for active VCPUs. */
+        PVMCPU pVCpu = &pVM->aCpus[idCpu];
+        VMCPU_FF_SET(pVCpu, VMCPU_FF_TLB_FLUSH);
+        if (idThisCpu != idCpu)
+            hmPokeCpuForTlbFlushAndWait(pVCpu);
+    }
+
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Invalidates a guest page by physical address.
  *
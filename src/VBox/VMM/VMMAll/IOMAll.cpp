@@ -23,6 +23,7 @@
 #include <VBox/vmm/iom.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/param.h>
+#include <VBox/vmm/dbgf.h>
 #include "IOMInternal.h"
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/vmm.h>
@@ -131,12 +132,13 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint32
 #endif
         void           *pvUser    = pRange->pvUser;
         PPDMDEVINS      pDevIns   = pRange->pDevIns;
+        PPDMCRITSECT    pCritSect = pRange->pCritSect ? pRange->pCritSect : pDevIns->CTX_SUFF(pCritSectRo);
         IOM_UNLOCK_SHARED(pVM);
 
         /*
          * Call the device.
          */
-        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_IOPORT_READ);
+        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pCritSect, VINF_IOM_R3_IOPORT_READ);
         if (rcStrict == VINF_SUCCESS)
         { /* likely */ }
         else
@@ -154,7 +156,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint32
         else
 #endif
             rcStrict = pfnInCallback(pDevIns, pvUser, Port, pu32Value, (unsigned)cbValue);
-        PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+        PDMCritSectLeave(pCritSect);
 
 #ifdef VBOX_WITH_STATISTICS
         if (rcStrict == VINF_SUCCESS && pStats)
@@ -178,6 +180,9 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint32
                     return VERR_IOM_INVALID_IOPORT_SIZE;
             }
         }
+        if (   DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_IOPORT)
+            && rcStrict == VINF_SUCCESS)
+            DBGFEvtTraceAdd(pVCpu, DBGFEVTTRACETYPE_IOPORT_READ, Port, *pu32Value, cbValue, 0);
         Log3(("IOMIOPortRead: Port=%RTiop *pu32=%08RX32 cb=%d rc=%Rrc\n", Port, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rcStrict)));
         return rcStrict;
     }
@@ -301,12 +306,13 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortReadString(PVM pVM, PVMCPU pVCpu, RTIOPORT u
 #endif
         void           *pvUser    = pRange->pvUser;
         PPDMDEVINS      pDevIns   = pRange->pDevIns;
+        PPDMCRITSECT    pCritSect = pRange->pCritSect ? pRange->pCritSect : pDevIns->CTX_SUFF(pCritSectRo);
         IOM_UNLOCK_SHARED(pVM);
 
         /*
          * Call the device.
          */
-        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_IOPORT_READ);
+        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pCritSect, VINF_IOM_R3_IOPORT_READ);
         if (rcStrict == VINF_SUCCESS)
         { /* likely */ }
         else
@@ -371,7 +377,7 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortReadString(PVM pVM, PVMCPU pVCpu, RTIOPORT u
             } while (   *pcTransfers > 0
                      && rcStrict == VINF_SUCCESS);
         }
-        PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+        PDMCritSectLeave(pCritSect);
 
 #ifdef VBOX_WITH_STATISTICS
         if (rcStrict == VINF_SUCCESS && pStats)
@@ -516,12 +522,13 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint3
 #endif
         void           *pvUser    = pRange->pvUser;
         PPDMDEVINS      pDevIns   = pRange->pDevIns;
+        PPDMCRITSECT    pCritSect = pRange->pCritSect ? pRange->pCritSect : pDevIns->CTX_SUFF(pCritSectRo);
         IOM_UNLOCK_SHARED(pVM);
 
         /*
          * Call the device.
          */
-        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_IOPORT_WRITE);
+        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pCritSect, VINF_IOM_R3_IOPORT_WRITE);
         if (rcStrict == VINF_SUCCESS)
         { /* likely */ }
         else
@@ -543,7 +550,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint3
         else
 #endif
             rcStrict = pfnOutCallback(pDevIns, pvUser, Port, u32Value, (unsigned)cbValue);
-        PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+        PDMCritSectLeave(pCritSect);
 
 #ifdef VBOX_WITH_STATISTICS
         if (rcStrict == VINF_SUCCESS && pStats)
@@ -553,6 +560,9 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint3
             STAM_COUNTER_INC(&pStats->OutRZToR3);
 # endif
 #endif
+        if (   DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_IOPORT)
+            && rcStrict == VINF_SUCCESS)
+            DBGFEvtTraceAdd(pVCpu, DBGFEVTTRACETYPE_IOPORT_WRITE, Port, u32Value, cbValue, 0);
         Log3(("IOMIOPortWrite: Port=%RTiop u32=%08RX32 cb=%d rc=%Rrc\n", Port, u32Value, cbValue, VBOXSTRICTRC_VAL(rcStrict)));
 #ifndef IN_RING3
         if (rcStrict == VINF_IOM_R3_IOPORT_WRITE)
@@ -671,12 +681,13 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortWriteString(PVM pVM, PVMCPU pVCpu, RTIOPORT
 #endif
         void           *pvUser    = pRange->pvUser;
         PPDMDEVINS      pDevIns   = pRange->pDevIns;
+        PPDMCRITSECT    pCritSect = pRange->pCritSect ? pRange->pCritSect : pDevIns->CTX_SUFF(pCritSectRo);
         IOM_UNLOCK_SHARED(pVM);
 
         /*
          * Call the device.
          */
-        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_IOPORT_WRITE);
+        VBOXSTRICTRC rcStrict = PDMCritSectEnter(pCritSect, VINF_IOM_R3_IOPORT_WRITE);
         if (rcStrict == VINF_SUCCESS)
         { /* likely */ }
         else
@@ -735,7 +746,7 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortWriteString(PVM pVM, PVMCPU pVCpu, RTIOPORT
                      && rcStrict == VINF_SUCCESS);
         }
 
-        PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+        PDMCritSectLeave(pCritSect);
 
 #ifdef VBOX_WITH_STATISTICS
         if (rcStrict == VINF_SUCCESS && pStats)
@@ -29,6 +29,7 @@
 #include <VBox/vmm/pgm.h>
 #include <VBox/vmm/trpm.h>
 #include <VBox/vmm/iem.h>
+#include <VBox/vmm/dbgf.h>
 #include "IOMInternal.h"
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/vmm.h>
@@ -47,6 +48,27 @@
 
 
 
+/**
+ * Gets the critical section serializing the callbacks of a MMIO range.
+ *
+ * @returns Pointer to the range specific critical section if the device set
+ *          one, otherwise the device critical section.  NULL if there is
+ *          no device instance in the current context.
+ * @param   pRange      The MMIO range.
+ */
+DECLINLINE(PPDMCRITSECT) iomMmioGetCritSect(PIOMMMIORANGE pRange)
+{
+    PPDMCRITSECT pCritSect = pRange->CTX_SUFF(pCritSect);
+    if (!pCritSect)
+    {
+        PPDMDEVINS pDevIns = pRange->CTX_SUFF(pDevIns);
+        if (pDevIns)
+            pCritSect = pDevIns->CTX_SUFF(pCritSectRo);
+    }
+    return pCritSect;
+}
+
+
 #ifndef IN_RING3
 /**
  * Defers a pending MMIO write to ring-3.
@@ -299,6 +321,23 @@ static VBOXSTRICTRC iomMMIODoComplicatedWrite(PVM pVM, PVMCPU pVCpu, PIOMMMIORAN
 
 
 
+/**
+ * Records a completed MMIO access with the DBGF event tracer.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   enmType     DBGFEVTTRACETYPE_MMIO_READ or DBGFEVTTRACETYPE_MMIO_WRITE.
+ * @param   GCPhys      The physical address of the access.
+ * @param   pvValue     The value read or written.
+ * @param   cbValue     The access size.
+ */
+static void iomMmioEvtTrace(PVMCPU pVCpu, DBGFEVTTRACETYPE enmType, RTGCPHYS GCPhys, void const *pvValue, unsigned cbValue)
+{
+    uint64_t u64Value = 0;
+    memcpy(&u64Value, pvValue, RT_MIN(cbValue, sizeof(u64Value)));
+    DBGFEvtTraceAdd(pVCpu, enmType, (uint16_t)cbValue, 0, GCPhys, u64Value);
+}
+
+
 /**
  * Wrapper which does the write and updates range statistics when such are enabled.
  * @warning RT_SUCCESS(rc=VINF_IOM_R3_MMIO_WRITE) is TRUE!
@@ -335,6 +374,9 @@ static VBOXSTRICTRC iomMMIODoWrite(PVM pVM, PVMCPU pVCpu, PIOMMMIORANGE pRange,
     }
     else
         rcStrict = VINF_SUCCESS;
+    if (   DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_MMIO)
+        && rcStrict == VINF_SUCCESS)
+        iomMmioEvtTrace(pVCpu, DBGFEVTTRACETYPE_MMIO_WRITE, GCPhysFault, pvData, cb);
 
     STAM_PROFILE_STOP(&pStats->CTX_SUFF_Z(ProfWrite), a);
     STAM_COUNTER_INC(&pStats->Accesses);
@@ -565,6 +607,9 @@ DECLINLINE(VBOXSTRICTRC) iomMMIODoRead(PVM pVM, PVMCPU pVCpu, PIOMMMIORANGE pRan
             case VINF_IOM_MMIO_UNUSED_00: rcStrict = iomMMIODoRead00s(pvValue, cbValue); break;
         }
     }
+    if (   DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_MMIO)
+        && rcStrict == VINF_SUCCESS)
+        iomMmioEvtTrace(pVCpu, DBGFEVTTRACETYPE_MMIO_READ, GCPhys, pvValue, cbValue);
 
     STAM_PROFILE_STOP(&pStats->CTX_SUFF_Z(ProfRead), a);
     STAM_COUNTER_INC(&pStats->Accesses);
@@ -653,8 +698,8 @@ static VBOXSTRICTRC iomMmioCommonPfHandler(PVM pVM, PVMCPU pVCpu, uint32_t uErro
     /*
      * Retain the range and do locking.
      */
-    PPDMDEVINS pDevIns = pRange->CTX_SUFF(pDevIns);
-    rc = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_MMIO_READ_WRITE);
+    PPDMCRITSECT pCritSect = iomMmioGetCritSect(pRange);
+    rc = PDMCritSectEnter(pCritSect, VINF_IOM_R3_MMIO_READ_WRITE);
     if (rc != VINF_SUCCESS)
     {
         iomMmioReleaseRange(pVM, pRange);
@@ -668,7 +713,7 @@ static VBOXSTRICTRC iomMmioCommonPfHandler(PVM pVM, PVMCPU pVCpu, uint32_t uErro
 
     NOREF(pCtxCore); NOREF(GCPhysFault);
     STAM_PROFILE_STOP(&pVM->iom.s.StatRZMMIOHandler, a);
-    PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+    PDMCritSectLeave(pCritSect);
     iomMmioReleaseRange(pVM, pRange);
     if (RT_SUCCESS(rcStrict))
         return rcStrict;
@@ -779,12 +824,13 @@ PGM_ALL_CB2_DECL(VBOXSTRICTRC) iomMmioHandler(PVM pVM, PVMCPU pVCpu, RTGCPHYS GC
      * Perform locking.
      */
     iomMmioRetainRange(pRange);
-    PPDMDEVINS pDevIns = pRange->CTX_SUFF(pDevIns);
+    PPDMCRITSECT pCritSect = iomMmioGetCritSect(pRange);
     IOM_UNLOCK_SHARED(pVM);
 #ifdef IN_RING3
-    VBOXSTRICTRC rcStrict = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_MMIO_READ_WRITE);
+    VBOXSTRICTRC rcStrict = PDMCritSectEnter(pCritSect, VINF_IOM_R3_MMIO_READ_WRITE);
 #else
-    VBOXSTRICTRC rcStrict = pDevIns ? PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_MMIO_READ_WRITE)
+    PPDMDEVINS pDevIns = pRange->CTX_SUFF(pDevIns);
+    VBOXSTRICTRC rcStrict = pDevIns ? PDMCritSectEnter(pCritSect, VINF_IOM_R3_MMIO_READ_WRITE)
                           : VINF_IOM_R3_MMIO_READ_WRITE;
 #endif
     if (rcStrict == VINF_SUCCESS)
@@ -824,7 +870,7 @@ PGM_ALL_CB2_DECL(VBOXSTRICTRC) iomMmioHandler(PVM pVM, PVMCPU pVCpu, RTGCPHYS GC
 #endif
 
         iomMmioReleaseRange(pVM, pRange);
-        PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+        PDMCritSectLeave(pCritSect);
     }
 #ifdef IN_RING3
     else
@@ -906,8 +952,8 @@ VMMDECL(VBOXSTRICTRC) IOMMMIORead(PVM pVM, PVMCPU pVCpu, RTGCPHYS GCPhys, uint32
         /*
          * Perform locking.
          */
-        PPDMDEVINS pDevIns = pRange->CTX_SUFF(pDevIns);
-        rc = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_MMIO_WRITE);
+        PPDMCRITSECT pCritSect = iomMmioGetCritSect(pRange);
+        rc = PDMCritSectEnter(pCritSect, VINF_IOM_R3_MMIO_WRITE);
         if (rc != VINF_SUCCESS)
         {
             iomMmioReleaseRange(pVM, pRange);
@@ -930,7 +976,7 @@ VMMDECL(VBOXSTRICTRC) IOMMMIORead(PVM pVM, PVMCPU pVCpu, RTGCPHYS GCPhys, uint32
         {
             case VINF_SUCCESS:
                 Log4(("IOMMMIORead: GCPhys=%RGp *pu32=%08RX32 cb=%d rc=VINF_SUCCESS\n", GCPhys, *pu32Value, cbValue));
-                PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+                PDMCritSectLeave(pCritSect);
                 iomMmioReleaseRange(pVM, pRange);
                 return rc;
 #ifndef IN_RING3
@@ -940,21 +986,21 @@ VMMDECL(VBOXSTRICTRC) IOMMMIORead(PVM pVM, PVMCPU pVCpu, RTGCPHYS GCPhys, uint32
 #endif
             default:
                 Log4(("IOMMMIORead: GCPhys=%RGp *pu32=%08RX32 cb=%d rc=%Rrc\n", GCPhys, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rc)));
-                PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+                PDMCritSectLeave(pCritSect);
                 iomMmioReleaseRange(pVM, pRange);
                 return rc;
 
             case VINF_IOM_MMIO_UNUSED_00:
                 iomMMIODoRead00s(pu32Value, cbValue);
                 Log4(("IOMMMIORead: GCPhys=%RGp *pu32=%08RX32 cb=%d rc=%Rrc\n", GCPhys, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rc)));
-                PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+                PDMCritSectLeave(pCritSect);
                 iomMmioReleaseRange(pVM, pRange);
                 return VINF_SUCCESS;
 
             case VINF_IOM_MMIO_UNUSED_FF:
                 iomMMIODoReadFFs(pu32Value, cbValue);
                 Log4(("IOMMMIORead: GCPhys=%RGp *pu32=%08RX32 cb=%d rc=%Rrc\n", GCPhys, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rc)));
-                PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+                PDMCritSectLeave(pCritSect);
                 iomMmioReleaseRange(pVM, pRange);
                 return VINF_SUCCESS;
         }
@@ -1036,8 +1082,8 @@ VMMDECL(VBOXSTRICTRC) IOMMMIOWrite(PVM pVM, PVMCPU pVCpu, RTGCPHYS GCPhys, uint3
         /*
          * Perform locking.
          */
-        PPDMDEVINS pDevIns = pRange->CTX_SUFF(pDevIns);
-        rc = PDMCritSectEnter(pDevIns->CTX_SUFF(pCritSectRo), VINF_IOM_R3_MMIO_READ);
+        PPDMCRITSECT pCritSect = iomMmioGetCritSect(pRange);
+        rc = PDMCritSectEnter(pCritSect, VINF_IOM_R3_MMIO_READ);
         if (rc != VINF_SUCCESS)
         {
             iomMmioReleaseRange(pVM, pRange);
@@ -1063,7 +1109,7 @@ VMMDECL(VBOXSTRICTRC) IOMMMIOWrite(PVM pVM, PVMCPU pVCpu, RTGCPHYS GCPhys, uint3
 #endif
         Log4(("IOMMMIOWrite: GCPhys=%RGp u32=%08RX32 cb=%d rc=%Rrc\n", GCPhys, u32Value, cbValue, VBOXSTRICTRC_VAL(rc)));
         iomMmioReleaseRange(pVM, pRange);
-        PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+        PDMCritSectLeave(pCritSect);
         return rc;
     }
 #ifndef IN_RING3
@@ -23,6 +23,7 @@
 #include "PDMInternal.h"
 #include <VBox/vmm/pdm.h>
 #include <VBox/vmm/mm.h>
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/err.h>
 #include <VBox/vmm/apic.h>
@@ -66,7 +67,11 @@ VMMDECL(int) PDMGetInterrupt(PVMCPU pVCpu, uint8_t *pu8Interrupt)
         if (RT_SUCCESS(rc))
         {
             if (rc == VINF_SUCCESS)
+            {
                 VBOXVMM_PDM_IRQ_GET(pVCpu, RT_LOWORD(uTagSrc), RT_HIWORD(uTagSrc), *pu8Interrupt);
+                if (DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_INTERRUPT))
+                    DBGFEvtTraceAdd(pVCpu, DBGFEVTTRACETYPE_INTERRUPT, *pu8Interrupt, uTagSrc, 0, 0);
+            }
             return rc;
         }
         /* else if it's masked by TPR/PPR/whatever, go ahead checking the PIC. Such masked
@@ -91,6 +96,8 @@ VMMDECL(int) PDMGetInterrupt(PVMCPU pVCpu, uint8_t *pu8Interrupt)
             pdmUnlock(pVM);
             *pu8Interrupt = (uint8_t)i;
             VBOXVMM_PDM_IRQ_GET(pVCpu, RT_LOWORD(uTagSrc), RT_HIWORD(uTagSrc), i);
+            if (DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_INTERRUPT))
+                DBGFEvtTraceAdd(pVCpu, DBGFEVTTRACETYPE_INTERRUPT, (uint16_t)i, uTagSrc, 0, 0);
             return VINF_SUCCESS;
         }
     }
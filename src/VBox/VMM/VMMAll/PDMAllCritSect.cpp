@@ -24,6 +24,7 @@
 #include <VBox/vmm/pdmcritsect.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/vmm.h>
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/err.h>
 #include <VBox/vmm/hm.h>
@@ -32,6 +33,7 @@
 #include <iprt/asm.h>
 #include <iprt/asm-amd64-x86.h>
 #include <iprt/assert.h>
+#include <iprt/time.h>
 #ifdef IN_RING3
 # include <iprt/lockvalidator.h>
 # include <iprt/semaphore.h>
@@ -51,6 +53,19 @@
 /** The number loops to spin for in the raw-mode context. */
 #define PDMCRITSECT_SPIN_COUNT_RC       256
 
+/** The max average hold time (TSC ticks) for which we'll keep on spinning
+ * after the fixed spin count in ring-3.  Blocking and waking up in ring-3 costs
+ * a couple of context switches, so it pays to spin a little longer here. */
+#define PDMCRITSECT_SPIN_MAX_TICKS_R3   _32K
+/** The max average hold time (TSC ticks) for adaptive spinning in ring-0. */
+#define PDMCRITSECT_SPIN_MAX_TICKS_R0   _8K
+/** The max average hold time (TSC ticks) for adaptive spinning in the
+ * raw-mode context. */
+#define PDMCRITSECT_SPIN_MAX_TICKS_RC   _8K
+/** Hold times above this are clamped before being averaged, so a single
+ * long hold cannot overflow the average. */
+#define PDMCRITSECT_HOLD_TICKS_CLAMP    _16M
+
 
 /** Skips some of the overly paranoid atomic updates.
  * Makes some assumptions about cache coherence, though not brave enough not to
@@ -112,11 +127,37 @@ DECL_FORCE_INLINE(int) pdmCritSectEnterFirst(PPDMCRITSECT pCritSect, RTNATIVETHR
     NOREF(pSrcPos);
 # endif
 
+    PPDMCRITSECTPROF pProf = PDMCRITSECT_PROF(&pCritSect->s);
+    if (RT_LIKELY(!pProf))
+        pCritSect->s.u32EnterTick = (uint32_t)ASMReadTSC();
+    else
+    {
+        pProf->u64EnterTick = ASMReadTSC();
+        pCritSect->s.u32EnterTick = (uint32_t)pProf->u64EnterTick;
+    }
+
     STAM_PROFILE_ADV_START(&pCritSect->s.StatLocked, l);
     return VINF_SUCCESS;
 }
 
 
+/**
+ * Updates the average hold time used for adaptive spinning.
+ *
+ * Must be called by the owner before it gives up ownership.
+ *
+ * @param   pCritSect       The critical section.
+ */
+DECL_FORCE_INLINE(void) pdmCritSectUpdateAvgHold(PPDMCRITSECT pCritSect)
+{
+    uint32_t cTicksHeld = (uint32_t)ASMReadTSC() - pCritSect->s.u32EnterTick;
+    if (cTicksHeld > PDMCRITSECT_HOLD_TICKS_CLAMP)
+        cTicksHeld = PDMCRITSECT_HOLD_TICKS_CLAMP;
+    int32_t const cTicksAvg = (int32_t)pCritSect->s.cTicksAvgHold;
+    pCritSect->s.cTicksAvgHold = (uint32_t)(cTicksAvg + ((int32_t)cTicksHeld - cTicksAvg) / 8);
+}
+
+
 #if defined(IN_RING3) || defined(IN_RING0)
 /**
  * Deals with the contended case in ring-3 and ring-0.
@@ -144,8 +185,12 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
     /*
      * The wait loop.
      */
-    PSUPDRVSESSION  pSession    = pCritSect->s.CTX_SUFF(pVM)->pSession;
-    SUPSEMEVENT     hEvent      = (SUPSEMEVENT)pCritSect->s.Core.EventSem;
+    PSUPDRVSESSION   pSession    = pCritSect->s.CTX_SUFF(pVM)->pSession;
+    SUPSEMEVENT      hEvent      = (SUPSEMEVENT)pCritSect->s.Core.EventSem;
+    PPDMCRITSECTPROF pProf       = PDMCRITSECT_PROF(&pCritSect->s);
+    uint64_t const   uStartTick  = pProf ? ASMReadTSC() : 0;
+    uint64_t const   uEvtTraceNs = DBGF_IS_EVT_TRACE_ENABLED(pCritSect->s.CTX_SUFF(pVM), DBGFEVTTRACE_F_CRITSECT)
+                                 ? RTTimeNanoTS() : 0;
 # ifdef IN_RING3
 #  ifdef PDMCRITSECT_STRICT
     RTTHREAD        hThreadSelf = RTThreadSelfAutoAdopt();
@@ -190,7 +235,20 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
         if (RT_UNLIKELY(pCritSect->s.Core.u32Magic != RTCRITSECT_MAGIC))
             return VERR_SEM_DESTROYED;
         if (rc == VINF_SUCCESS)
+        {
+            if (pProf)
+                pdmCritSectProfWait(pProf, ASMReadTSC() - uStartTick, pSrcPos);
+            if (uEvtTraceNs)
+            {
+                /* Only EMTs have a ring to record into. */
+                PVM    pVM   = pCritSect->s.CTX_SUFF(pVM);
+                PVMCPU pVCpu = VMMGetCpu(pVM);
+                if (pVCpu)
+                    DBGFEvtTraceAdd(pVCpu, DBGFEVTTRACETYPE_CRITSECT_WAIT, 0, 0,
+                                    (uintptr_t)MMHyperCCToR3(pVM, pCritSect), RTTimeNanoTS() - uEvtTraceNs);
+            }
             return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+        }
         AssertMsg(rc == VERR_INTERRUPTED, ("rc=%Rrc\n", rc));
 
 # ifdef IN_RING0
@@ -280,6 +338,24 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
            wanted. */
     }
 
+    /*
+     * If the section is usually only held for a short while, keep spinning for
+     * up to twice the average hold time as that is cheaper than blocking.
+     * Sections which haven't been timed yet or are held for long are left to
+     * the slow path right away.
+     */
+    uint32_t const cTicksAvgHold = pCritSect->s.cTicksAvgHold;
+    if (cTicksAvgHold - 1 < (uint32_t)CTX_SUFF(PDMCRITSECT_SPIN_MAX_TICKS_))
+    {
+        uint32_t const uSpinStart = (uint32_t)ASMReadTSC();
+        do
+        {
+            if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
+                return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+            ASMNopPause();
+        } while ((uint32_t)ASMReadTSC() - uSpinStart < cTicksAvgHold * 2);
+    }
+
 #ifdef IN_RING3
     /*
      * Take the slow path.
@@ -371,9 +447,10 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
  */
 VMMDECL(int) PDMCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy)
 {
-#ifndef PDMCRITSECT_STRICT
+#if !defined(PDMCRITSECT_STRICT) && !defined(IN_RING3)
     return pdmCritSectEnter(pCritSect, rcBusy, NULL);
 #else
+    /* Note! Also used by the contention profiler in ring-3 to identify the caller. */
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
     return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos);
 #endif
@@ -400,7 +477,7 @@ VMMDECL(int) PDMCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy)
  */
 VMMDECL(int) PDMCritSectEnterDebug(PPDMCRITSECT pCritSect, int rcBusy, RTHCUINTPTR uId, RT_SRC_POS_DECL)
 {
-#ifdef PDMCRITSECT_STRICT
+#if defined(PDMCRITSECT_STRICT) || defined(IN_RING3)
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
     return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos);
 #else
@@ -610,6 +687,12 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
         /* update members. */
         SUPSEMEVENT hEventToSignal  = pCritSect->s.hEventToSignal;
         pCritSect->s.hEventToSignal = NIL_SUPSEMEVENT;
+        pdmCritSectUpdateAvgHold(pCritSect);
+        PPDMCRITSECTPROF pProf      = PDMCRITSECT_PROF(&pCritSect->s);
+        if (RT_LIKELY(!pProf))
+        { /* likely */ }
+        else
+            pdmCritSectProfHold(pProf, ASMReadTSC() - pProf->u64EnterTick);
 # ifdef IN_RING3
 #  if defined(PDMCRITSECT_STRICT)
         if (pCritSect->s.Core.pValidatorRec->hThread != NIL_RTTHREAD)
@@ -673,10 +756,21 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
             RTNATIVETHREAD hNativeThread = pCritSect->s.Core.NativeThreadOwner;
             ASMAtomicAndU32(&pCritSect->s.Core.fFlags, ~PDMCRITSECT_FLAGS_PENDING_UNLOCK);
             STAM_PROFILE_ADV_STOP(&pCritSect->s.StatLocked, l);
+            pdmCritSectUpdateAvgHold(pCritSect); /* harmless if someone races us below */
+            PPDMCRITSECTPROF pProf      = PDMCRITSECT_PROF(&pCritSect->s);
+            uint64_t const   cTicksHeld = pProf ? ASMReadTSC() - pProf->u64EnterTick : 0;
 
             ASMAtomicWriteHandle(&pCritSect->s.Core.NativeThreadOwner, NIL_RTNATIVETHREAD);
             if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, -1, 0))
+            {
+# ifdef IN_RING0
+                if (pProf)
+                    pdmCritSectProfHold(pProf, cTicksHeld);
+# else
+                RT_NOREF(cTicksHeld);
+# endif
                 return VINF_SUCCESS;
+            }
 
             /* darn, someone raced in on us. */
             ASMAtomicWriteHandle(&pCritSect->s.Core.NativeThreadOwner, hNativeThread);
@@ -29,6 +29,9 @@
 #include <VBox/log.h>
 #include <iprt/assert.h>
 #include <iprt/asm.h>
+#ifdef IN_RING3
+# include <iprt/lockvalidator.h>
+#endif
 
 
 #if defined(IN_RING3) || defined(IN_RING0)
@@ -95,3 +98,95 @@ VMM_INT_DECL(void) PDMCritSectBothFF(PVMCPU pVCpu)
 }
 #endif /* IN_RING3 || IN_RING0 */
 
+
+#if defined(IN_RING3) || defined(IN_RING0)
+/**
+ * Adds a sample to a STAMPROFILE that may be updated concurrently.
+ *
+ * @param   pProfile    The profile sample.
+ * @param   cTicks      The number of ticks to add.
+ */
+static void pdmCritSectProfAddPeriod(PSTAMPROFILE pProfile, uint64_t cTicks)
+{
+    ASMAtomicIncU64(&pProfile->cPeriods);
+    ASMAtomicAddU64(&pProfile->cTicks, cTicks);
+
+    uint64_t cTicksMax = ASMAtomicReadU64(&pProfile->cTicksMax);
+    while (   cTicks > cTicksMax
+           && !ASMAtomicCmpXchgExU64(&pProfile->cTicksMax, cTicks, cTicksMax, &cTicksMax))
+    { /* retry */ }
+
+    uint64_t cTicksMin = ASMAtomicReadU64(&pProfile->cTicksMin);
+    while (   cTicks < cTicksMin
+           && !ASMAtomicCmpXchgExU64(&pProfile->cTicksMin, cTicks, cTicksMin, &cTicksMin))
+    { /* retry */ }
+}
+
+
+/**
+ * Records the hold time of an exclusive owner of a profiled critical section.
+ *
+ * @param   pProf       The profiling data of the section.
+ * @param   cTicks      The hold time in TSC ticks.
+ */
+void pdmCritSectProfHold(PPDMCRITSECTPROF pProf, uint64_t cTicks)
+{
+    pdmCritSectProfAddPeriod(&pProf->StatHold, cTicks);
+
+    unsigned iBucket = ASMBitLastSetU64(cTicks);
+    if (iBucket >= RT_ELEMENTS(pProf->acHoldHist))
+        iBucket = RT_ELEMENTS(pProf->acHoldHist) - 1;
+    ASMAtomicIncU64(&pProf->acHoldHist[iBucket]);
+}
+
+
+/**
+ * Records a contended wait on a profiled critical section.
+ *
+ * @param   pProf       The profiling data of the section.
+ * @param   cTicks      The time spent waiting in TSC ticks.
+ * @param   pSrcPos     The source position of the waiter.  Only used in
+ *                      ring-3 where the strings are accessible to the
+ *                      debugger info handler.  Can be NULL.
+ */
+void pdmCritSectProfWait(PPDMCRITSECTPROF pProf, uint64_t cTicks, PCRTLOCKVALSRCPOS pSrcPos)
+{
+    pdmCritSectProfAddPeriod(&pProf->StatWait, cTicks);
+
+# ifdef IN_RING3
+    /*
+     * Account it to the caller.  The table is open addressed on the caller
+     * ID and slots are never freed, so a slot we find or claim stays ours.
+     */
+    if (!pSrcPos || !pSrcPos->uId)
+        return;
+    uint64_t const    uId   = pSrcPos->uId;
+    unsigned          iSlot = (unsigned)((uId >> 4) ^ (uId >> 12)) % RT_ELEMENTS(pProf->aCallers);
+    for (unsigned cLeft = RT_ELEMENTS(pProf->aCallers); cLeft > 0; cLeft--)
+    {
+        PPDMCRITSECTPROFCALLER pCaller = &pProf->aCallers[iSlot];
+        uint64_t uSlotId = ASMAtomicReadU64(&pCaller->uId);
+        if (   uSlotId == 0
+            && ASMAtomicCmpXchgU64(&pCaller->uId, uId, 0))
+        {
+            pCaller->pszFile     = pSrcPos->pszFile;
+            pCaller->pszFunction = pSrcPos->pszFunction;
+            pCaller->iLine       = pSrcPos->uLine;
+            uSlotId = uId;
+        }
+        else if (uSlotId == 0)
+            uSlotId = ASMAtomicReadU64(&pCaller->uId);
+        if (uSlotId == uId)
+        {
+            ASMAtomicIncU32(&pCaller->cContentions);
+            ASMAtomicAddU64(&pCaller->cTicksWaited, cTicks);
+            return;
+        }
+        iSlot = (iSlot + 1) % RT_ELEMENTS(pProf->aCallers);
+    }
+    ASMAtomicIncU32(&pProf->cCallersLost);
+# else
+    RT_NOREF(pSrcPos);
+# endif
+}
+#endif /* IN_RING3 || IN_RING0 */
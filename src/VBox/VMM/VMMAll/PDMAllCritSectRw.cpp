@@ -274,6 +274,8 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
 
                 if (ASMAtomicCmpXchgU64(&pThis->s.Core.u64State, u64State, u64OldState))
                 {
+                    PPDMCRITSECTPROF pProf      = PDMCRITSECT_PROF(&pThis->s);
+                    uint64_t const   uStartTick = pProf ? ASMReadTSC() : 0;
                     for (uint32_t iLoop = 0; ; iLoop++)
                     {
                         int rc;
@@ -362,6 +364,8 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
                     if (!fNoVal)
                         RTLockValidatorRecSharedAddOwner(pThis->s.Core.pValidatorRead, hThreadSelf, pSrcPos);
 # endif
+                    if (pProf)
+                        pdmCritSectProfWait(pProf, ASMReadTSC() - uStartTick, pSrcPos);
                     break;
                 }
             }
@@ -425,7 +429,7 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
  */
 VMMDECL(int) PDMCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy)
 {
-#if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
+#ifndef IN_RING3 /* ring-3 always passes the position on for the contention profiler. */
     return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, NULL,    false /*fNoVal*/);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
@@ -457,7 +461,7 @@ VMMDECL(int) PDMCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy)
 VMMDECL(int) PDMCritSectRwEnterSharedDebug(PPDMCRITSECTRW pThis, int rcBusy, RTHCUINTPTR uId, RT_SRC_POS_DECL)
 {
     NOREF(uId); NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
-#if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
+#ifndef IN_RING3 /* ring-3 always passes the position on for the contention profiler. */
     return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, NULL,    false /*fNoVal*/);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
@@ -833,6 +837,8 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
             /*
              * Wait for our turn.
              */
+            PPDMCRITSECTPROF pProf      = PDMCRITSECT_PROF(&pThis->s);
+            uint64_t const   uStartTick = pProf ? ASMReadTSC() : 0;
             for (uint32_t iLoop = 0; ; iLoop++)
             {
                 int rc;
@@ -892,6 +898,8 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
                 }
                 AssertMsg(iLoop < 1000, ("%u\n", iLoop)); /* may loop a few times here... */
             }
+            if (pProf)
+                pdmCritSectProfWait(pProf, ASMReadTSC() - uStartTick, pSrcPos);
 
         }
         else
@@ -944,6 +952,11 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
 #endif
     STAM_REL_COUNTER_INC(&pThis->s.CTX_MID_Z(Stat,EnterExcl));
     STAM_PROFILE_ADV_START(&pThis->s.StatWriteLocked, swl);
+    PPDMCRITSECTPROF pProf = PDMCRITSECT_PROF(&pThis->s);
+    if (RT_LIKELY(!pProf))
+    { /* likely */ }
+    else
+        pProf->u64EnterTick = ASMReadTSC();
 
     return VINF_SUCCESS;
 }
@@ -970,7 +983,7 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
  */
 VMMDECL(int) PDMCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy)
 {
-#if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
+#ifndef IN_RING3 /* ring-3 always passes the position on for the contention profiler. */
     return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, NULL,    false /*fNoVal*/);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
@@ -1003,7 +1016,7 @@ VMMDECL(int) PDMCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy)
 VMMDECL(int) PDMCritSectRwEnterExclDebug(PPDMCRITSECTRW pThis, int rcBusy, RTHCUINTPTR uId, RT_SRC_POS_DECL)
 {
     NOREF(uId); NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
-#if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
+#ifndef IN_RING3 /* ring-3 always passes the position on for the contention profiler. */
     return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, NULL,    false /*fNoVal*/);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
@@ -1139,6 +1152,11 @@ static int pdmCritSectRwLeaveExclWorker(PPDMCRITSECTRW pThis, bool fNoVal)
         {
             ASMAtomicWriteU32(&pThis->s.Core.cWriteRecursions, 0);
             STAM_PROFILE_ADV_STOP(&pThis->s.StatWriteLocked, swl);
+            PPDMCRITSECTPROF pProf = PDMCRITSECT_PROF(&pThis->s);
+            if (RT_LIKELY(!pProf))
+            { /* likely */ }
+            else
+                pdmCritSectProfHold(pProf, ASMReadTSC() - pProf->u64EnterTick);
             ASMAtomicWriteHandle(&pThis->s.Core.hNativeWriter, NIL_RTNATIVETHREAD);
 
             for (;;)
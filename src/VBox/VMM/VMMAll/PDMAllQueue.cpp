@@ -32,7 +32,14 @@
 #include <iprt/errcore.h>
 #include <VBox/log.h>
 #include <iprt/asm.h>
+#include <iprt/asm-amd64-x86.h>
 #include <iprt/assert.h>
+#ifdef IN_RING0
+# include <iprt/mp.h>
+#endif
+#ifdef IN_RING3
+# include <iprt/thread.h>
+#endif
 
 
 /**
@@ -86,6 +93,32 @@ static void pdmQueueSetFF(PPDMQUEUE pQueue)
 }
 
 
+/**
+ * Picks the pending list for the calling thread.
+ *
+ * EMTs use the list of their virtual CPU in ring-3 and the one of the host CPU
+ * in ring-0, other threads are spread by their native handle.
+ *
+ * @returns Index into PDMQUEUE::aPending.
+ * @param   pVM         The cross context VM structure.
+ */
+DECLINLINE(uint32_t) pdmQueuePendingListIndex(PVM pVM)
+{
+#if defined(IN_RING3)
+    VMCPUID idCpu = VMR3GetVMCPUId(pVM);
+    if (idCpu != NIL_VMCPUID)
+        return idCpu % PDMQUEUE_PENDING_LISTS;
+    return (uint32_t)((uintptr_t)RTThreadNativeSelf() >> 7) % PDMQUEUE_PENDING_LISTS;
+#elif defined(IN_RING0)
+    NOREF(pVM);
+    return (uint32_t)RTMpCpuId() % PDMQUEUE_PENDING_LISTS;
+#else
+    NOREF(pVM);
+    return 0;
+#endif
+}
+
+
 /**
  * Queue an item.
  * The item must have been obtained using PDMQueueAlloc(). Once the item
@@ -100,21 +133,30 @@ VMMDECL(void) PDMQueueInsert(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem)
     Assert(VALID_PTR(pQueue) && pQueue->CTX_SUFF(pVM));
     Assert(VALID_PTR(pItem));
 
-#if 0 /* the paranoid android version: */
-    void *pvNext;
-    do
+    /*
+     * Stamp it so the flusher can restore the insertion order, then push it
+     * onto our pending list.
+     */
+    pItem->u32Seq = ASMAtomicIncU32(&pQueue->u32InsertSeq);
+    uint32_t const    iList    = pdmQueuePendingListIndex(pQueue->CTX_SUFF(pVM));
+    PPDMQUEUEPENDING  pPending = &pQueue->aPending[iList];
+    PPDMQUEUEITEMCORE pNext    = pPending->CTX_SUFF(pPending);
+    pItem->CTX_SUFF(pNext) = pNext;
+    if (RT_UNLIKELY(!ASMAtomicCmpXchgPtr(&pPending->CTX_SUFF(pPending), pItem, pNext)))
     {
-        pvNext = ASMAtomicUoReadPtr((void * volatile *)&pQueue->CTX_SUFF(pPending));
-        ASMAtomicUoWritePtr((void * volatile *)&pItem->CTX_SUFF(pNext), pvNext);
-    } while (!ASMAtomicCmpXchgPtr(&pQueue->CTX_SUFF(pPending), pItem, pvNext));
-#else
-    PPDMQUEUEITEMCORE pNext;
-    do
-    {
-        pNext = pQueue->CTX_SUFF(pPending);
-        pItem->CTX_SUFF(pNext) = pNext;
-    } while (!ASMAtomicCmpXchgPtr(&pQueue->CTX_SUFF(pPending), pItem, pNext));
-#endif
+        STAM_REL_COUNTER_INC(&pQueue->StatInsertContention);
+        do
+        {
+            pNext = pPending->CTX_SUFF(pPending);
+            pItem->CTX_SUFF(pNext) = pNext;
+        } while (!ASMAtomicCmpXchgPtr(&pPending->CTX_SUFF(pPending), pItem, pNext));
+    }
+
+    /* Tell the flusher (must be done after the push, see pdmR3QueueFlush). */
+    if (!(ASMAtomicUoReadU32(&pQueue->fPendingLists) & RT_BIT_32(iList)))
+        ASMAtomicOrU32(&pQueue->fPendingLists, RT_BIT_32(iList));
+    if (!ASMAtomicUoReadU64(&pQueue->u64FirstInsertTick))
+        ASMAtomicCmpXchgU64(&pQueue->u64FirstInsertTick, ASMReadTSC(), 0);
 
     if (!pQueue->pTimer)
         pdmQueueSetFF(pQueue);
@@ -202,9 +244,7 @@ VMMDECL(R0PTRTYPE(PPDMQUEUE)) PDMQueueR0Ptr(PPDMQUEUE pQueue)
 VMMDECL(bool) PDMQueueFlushIfNecessary(PPDMQUEUE pQueue)
 {
     AssertPtr(pQueue);
-    if (   pQueue->pPendingR3 != NIL_RTR3PTR
-        || pQueue->pPendingR0 != NIL_RTR0PTR
-        || pQueue->pPendingRC != NIL_RTRCPTR)
+    if (ASMAtomicUoReadU32(&pQueue->fPendingLists))
     {
         pdmQueueSetFF(pQueue);
         return false;
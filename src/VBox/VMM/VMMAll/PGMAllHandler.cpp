@@ -852,6 +852,29 @@ static void pgmHandlerPhysicalResetRamFlags(PVM pVM, PPGMPHYSHANDLER pCur)
         pgmHandlerPhysicalRecalcPageState(pVM, pCur->Core.Key - 1, false /* fAbove */, &pRamHint);
     if ((pCur->Core.KeyLast & PAGE_OFFSET_MASK) != PAGE_OFFSET_MASK)
         pgmHandlerPhysicalRecalcPageState(pVM, pCur->Core.KeyLast + 1, true /* fAbove */, &pRamHint);
+
+#ifdef PGM_WITH_LARGE_PAGES
+    /*
+     * When backing RAM by large pages, try restore the large pages the handler
+     * broke up right away instead of waiting for the next PDE sync to notice.
+     */
+    if (   pVM->pgm.s.fLargePageRam
+        && pVM->pgm.s.cLargePagesDisabled
+        && !VM_IS_NEM_ENABLED(pVM))
+    {
+        RTGCPHYS GCPhysBase = pCur->Core.Key & X86_PDE2M_PAE_PG_MASK;
+        for (;;)
+        {
+            PPGMPAGE pLargePage;
+            if (   RT_SUCCESS(pgmPhysGetPageWithHintEx(pVM, GCPhysBase, &pLargePage, &pRamHint))
+                && PGM_PAGE_GET_PDE_TYPE(pLargePage) == PGM_PAGE_PDE_TYPE_PDE_DISABLED)
+                pgmPhysRecheckLargePage(pVM, GCPhysBase, pLargePage);
+            if (GCPhysBase >= (pCur->Core.KeyLast & X86_PDE2M_PAE_PG_MASK))
+                break;
+            GCPhysBase += _2M;
+        }
+    }
+#endif
 }
 
 
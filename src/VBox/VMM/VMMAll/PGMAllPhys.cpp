@@ -989,10 +989,12 @@ int pgmPhysAllocLargePage(PVM pVM, RTGCPHYS GCPhys)
                 return VINF_SUCCESS;
             }
 
-            /* If we fail once, it most likely means the host's memory is too
-               fragmented; don't bother trying again. */
+            /* If we fail, it most likely means the host's memory is too
+               fragmented; don't bother trying again after the configured
+               number of failures (once, unless in LargePageRam mode). */
             LogFlow(("pgmPhysAllocLargePage failed with %Rrc\n", rc));
-            PGMSetLargePageUsage(pVM, false);
+            if (++pVM->pgm.s.cLargePageAllocFailures >= pVM->pgm.s.cMaxLargePageAllocFailures)
+                PGMSetLargePageUsage(pVM, false);
             return rc;
         }
     }
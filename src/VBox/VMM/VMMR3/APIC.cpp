@@ -37,7 +37,9 @@
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
 /** The current APIC saved state version. */
-#define APIC_SAVED_STATE_VERSION                  5
+#define APIC_SAVED_STATE_VERSION                  6
+/** Pre KVM paravirtualized EOI. */
+#define APIC_SAVED_STATE_VERSION_PRE_PV_EOI       5
 /** VirtualBox 5.1 beta2 - pre fActiveLintX. */
 #define APIC_SAVED_STATE_VERSION_VBOX_51_BETA2    4
 /** The saved state version used by VirtualBox 5.0 and
@@ -698,6 +700,7 @@ static void apicR3DumpState(PVMCPU pVCpu, const char *pszPrefix, uint32_t uVersi
     switch (uVersion)
     {
         case APIC_SAVED_STATE_VERSION:
+        case APIC_SAVED_STATE_VERSION_PRE_PV_EOI:
         case APIC_SAVED_STATE_VERSION_VBOX_51_BETA2:
         {
             /* The auxiliary state. */
@@ -978,6 +981,11 @@ static DECLCALLBACK(int) apicR3SaveExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM)
         SSMR3PutBool(pSSM, pApicCpu->fActiveLint0);
         SSMR3PutBool(pSSM, pApicCpu->fActiveLint1);
 
+        /* Save the paravirtualized EOI state. */
+        SSMR3PutGCPhys(pSSM, pApicCpu->GCPhysPvEoi);
+        SSMR3PutU8(pSSM, pApicCpu->uPvEoiVector);
+        SSMR3PutBool(pSSM, pApicCpu->fPvEoiPending);
+
 #if defined(APIC_FUZZY_SSM_COMPAT_TEST) || defined(DEBUG_ramshankar)
         apicR3DumpState(pVCpu, "Saved state", APIC_SAVED_STATE_VERSION);
 #endif
@@ -1006,6 +1014,7 @@ static DECLCALLBACK(int) apicR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uin
 
     /* Weed out invalid versions. */
     if (   uVersion != APIC_SAVED_STATE_VERSION
+        && uVersion != APIC_SAVED_STATE_VERSION_PRE_PV_EOI
         && uVersion != APIC_SAVED_STATE_VERSION_VBOX_51_BETA2
         && uVersion != APIC_SAVED_STATE_VERSION_VBOX_50
         && uVersion != APIC_SAVED_STATE_VERSION_VBOX_30
@@ -1068,6 +1077,19 @@ static DECLCALLBACK(int) apicR3LoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uin
                 SSMR3GetBool(pSSM, (bool *)&pApicCpu->fActiveLint0);
                 SSMR3GetBool(pSSM, (bool *)&pApicCpu->fActiveLint1);
             }
+
+            /* Load the paravirtualized EOI state. */
+            if (uVersion > APIC_SAVED_STATE_VERSION_PRE_PV_EOI)
+            {
+                SSMR3GetGCPhys(pSSM, &pApicCpu->GCPhysPvEoi);
+                SSMR3GetU8(pSSM, &pApicCpu->uPvEoiVector);
+                SSMR3GetBool(pSSM, &pApicCpu->fPvEoiPending);
+            }
+            else
+            {
+                pApicCpu->GCPhysPvEoi   = NIL_RTGCPHYS;
+                pApicCpu->fPvEoiPending = false;
+            }
         }
         else
         {
@@ -1664,6 +1686,12 @@ static DECLCALLBACK(int) apicR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFG
                          "/Devices/APIC/%u/IcrHiWrite");
         APIC_REG_COUNTER(&pApicCpu->StatIcrFullWrite,  "Number of times the ICR full (send IPI, x2APIC) is written.",
                          "/Devices/APIC/%u/IcrFullWrite");
+        APIC_REG_COUNTER(&pApicCpu->StatPvEoiOffered,  "Number of times the guest was allowed to skip an EOI write.",
+                         "/Devices/APIC/%u/PvEoiOffered");
+        APIC_REG_COUNTER(&pApicCpu->StatPvEoiCompleted, "Number of EOIs signalled through the PV EOI flag.",
+                         "/Devices/APIC/%u/PvEoiCompleted");
+        APIC_REG_COUNTER(&pApicCpu->StatPvEoiRevoked,  "Number of times the PV EOI flag was taken back.",
+                         "/Devices/APIC/%u/PvEoiRevoked");
     }
 # undef APIC_PROF_COUNTER
 # undef APIC_REG_ACCESS_COUNTER
@@ -20,20 +20,29 @@
 *   Header Files                                                                                                                 *
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_DBGF
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/em.h>
+#include <VBox/vmm/hm.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/pdmapi.h>
 #include "DBGFInternal.h"
 #include <VBox/vmm/vm.h>
+#include <VBox/vmm/uvm.h>
 #include "VMMTracing.h"
 
 #include <VBox/err.h>
 #include <VBox/log.h>
 #include <VBox/param.h>
 
+#include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/ctype.h>
+#include <iprt/mem.h>
+#include <iprt/process.h>
+#include <iprt/stream.h>
+#include <iprt/string.h>
 #include <iprt/trace.h>
 
 
@@ -41,6 +50,7 @@
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
 static DECLCALLBACK(void) dbgfR3TraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
+static DECLCALLBACK(void) dbgfR3EvtTraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 
 
 /*********************************************************************************************************************************
@@ -65,6 +75,29 @@ static const struct
 };
 
 
+/**
+ * Event tracer event class name table.
+ */
+static const struct
+{
+    /** The class name. */
+    const char *pszName;
+    /** The name length. */
+    uint32_t    cchName;
+    /** The DBGFEVTTRACE_F_XXX mask. */
+    uint32_t    fMask;
+}   g_aEvtTraceClasses[] =
+{
+    {  RT_STR_TUPLE("exit"),      DBGFEVTTRACE_F_EXIT },
+    {  RT_STR_TUPLE("io"),        DBGFEVTTRACE_F_IOPORT },
+    {  RT_STR_TUPLE("mmio"),      DBGFEVTTRACE_F_MMIO },
+    {  RT_STR_TUPLE("int"),       DBGFEVTTRACE_F_INTERRUPT },
+    {  RT_STR_TUPLE("timer"),     DBGFEVTTRACE_F_TIMER },
+    {  RT_STR_TUPLE("critsect"),  DBGFEVTTRACE_F_CRITSECT },
+    {  RT_STR_TUPLE("all"),       DBGFEVTTRACE_F_ALL },
+};
+
+
 /**
  * Initializes the tracing.
  *
@@ -132,6 +165,75 @@ static int dbgfR3TraceEnable(PVM pVM, uint32_t cbEntry, uint32_t cEntries)
 }
 
 
+/**
+ * Allocates the event tracer rings if configured.
+ *
+ * This must be done while the VM is being created as we need a big chunk of
+ * hyper memory that is also visible in ring-0.
+ *
+ * @returns VBox status code
+ * @param   pVM         The cross context VM structure.
+ * @param   pDbgfNode   The DBGF CFGM node, can be NULL.
+ */
+static int dbgfR3EvtTraceInit(PVM pVM, PCFGMNODE pDbgfNode)
+{
+    pVM->dbgf.s.fEvtTraceMask    = 0;
+    pVM->dbgf.s.pbEvtTraceR3     = NULL;
+    pVM->dbgf.s.pbEvtTraceR0     = NIL_RTR0PTR;
+    pVM->dbgf.s.cbEvtTraceRing   = 0;
+    pVM->dbgf.s.cEvtTraceEntries = 0;
+
+    /** @cfgm{/DBGF/EvtTraceEnabled, bool, false}
+     * Whether to allocate the per-VCPU event tracer rings.  The event tracer
+     * can only be used at runtime if this is set. */
+    bool fEnabled;
+    int rc = CFGMR3QueryBoolDef(pDbgfNode, "EvtTraceEnabled", &fEnabled, false);
+    AssertRCReturn(rc, rc);
+    if (!fEnabled)
+        return VINF_SUCCESS;
+
+    /** @cfgm{/DBGF/EvtTraceEntries, uint32_t, 16384}
+     * The number of records in each per-VCPU event tracer ring.  Rounded up to
+     * a power of two, range 256 to 1M. */
+    uint32_t cEntries;
+    rc = CFGMR3QueryU32Def(pDbgfNode, "EvtTraceEntries", &cEntries, _16K);
+    AssertRCReturn(rc, rc);
+    if (cEntries < 256 || cEntries > _1M)
+        return VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                          "DBGF/EvtTraceEntries=%u is out of range (256 to 1M)", cEntries);
+    if (!RT_IS_POWER_OF_TWO(cEntries))
+        cEntries = RT_BIT_32(ASMBitLastSetU32(cEntries));
+
+    /** @cfgm{/DBGF/EvtTraceEvents, uint32_t, DBGFEVTTRACE_F_ALL}
+     * The event classes to start recording right away, DBGFEVTTRACE_F_XXX.
+     * Use zero to only allocate the rings and enable the event classes later
+     * via DBGFR3EvtTraceSetEvents or the 'evttrace' info handler. */
+    uint32_t fEvents;
+    rc = CFGMR3QueryU32Def(pDbgfNode, "EvtTraceEvents", &fEvents, DBGFEVTTRACE_F_ALL);
+    AssertRCReturn(rc, rc);
+    if (fEvents & ~DBGFEVTTRACE_F_ALL)
+        return VMSetError(pVM, VERR_INVALID_FLAGS, RT_SRC_POS, "DBGF/EvtTraceEvents=%#x has unknown bits", fEvents);
+
+    /*
+     * Allocate the rings in one go.
+     */
+    uint32_t const cbRing  = RT_UOFFSETOF_DYN(DBGFEVTTRACERING, aRecs[cEntries]);
+    size_t   const cbBlock = RT_ALIGN_Z((size_t)cbRing * pVM->cCpus, PAGE_SIZE);
+    void *pvBlock;
+    rc = MMR3HyperAllocOnceNoRel(pVM, cbBlock, PAGE_SIZE, MM_TAG_DBGF, &pvBlock);
+    if (RT_FAILURE(rc))
+        return VMSetError(pVM, rc, RT_SRC_POS, "Failed to allocate %zu bytes for the event tracer rings", cbBlock);
+
+    pVM->dbgf.s.pbEvtTraceR3     = (uint8_t *)pvBlock;
+    pVM->dbgf.s.pbEvtTraceR0     = MMHyperR3ToR0(pVM, pvBlock);
+    pVM->dbgf.s.cbEvtTraceRing   = cbRing;
+    pVM->dbgf.s.cEvtTraceEntries = cEntries;
+    ASMAtomicWriteU32(&pVM->dbgf.s.fEvtTraceMask, fEvents);
+    LogRel(("DBGF: Event tracer: %u entries per VCPU (%zu bytes), events %#x\n", cEntries, cbBlock, fEvents));
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Initializes the tracing.
  *
@@ -188,11 +290,22 @@ int dbgfR3TraceInit(PVM pVM)
         }
     }
 
+    /*
+     * The per-VCPU event tracer.
+     */
+    if (RT_SUCCESS(rc))
+        rc = dbgfR3EvtTraceInit(pVM, pDbgfNode);
+
     /*
      * Register a debug info item that will dump the trace buffer content.
      */
     if (RT_SUCCESS(rc))
         rc = DBGFR3InfoRegisterInternal(pVM, "tracebuf", "Display the trace buffer content. No arguments.", dbgfR3TraceInfo);
+    if (RT_SUCCESS(rc))
+        rc = DBGFR3InfoRegisterInternal(pVM, "evttrace",
+                                        "Event tracer control. Arguments: [on [classes] | off | export <file.json>]. "
+                                        "Classes: exit, io, mmio, int, timer, critsect, all.",
+                                        dbgfR3EvtTraceInfo);
 
     return rc;
 }
@@ -205,8 +318,8 @@ int dbgfR3TraceInit(PVM pVM)
  */
 void dbgfR3TraceTerm(PVM pVM)
 {
-    /* nothing to do */
-    NOREF(pVM);
+    /* Stop recording, the rings are hyper memory and go away with the VM. */
+    ASMAtomicWriteU32(&pVM->dbgf.s.fEvtTraceMask, 0);
 }
 
 
@@ -448,3 +561,346 @@ static DECLCALLBACK(void) dbgfR3TraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const cha
     NOREF(pszArgs);
 }
 
+
+
+/**
+ * Changes the event classes the event tracer is recording.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_DBGF_NO_TRACE_BUFFER if the event tracer rings weren't
+ *          allocated (DBGF/EvtTraceEnabled).
+ *
+ * @param   pUVM            The user mode VM handle.
+ * @param   fEvtClasses     The event classes to record, DBGFEVTTRACE_F_XXX.
+ *                          Zero stops the recording.
+ */
+VMMR3DECL(int) DBGFR3EvtTraceSetEvents(PUVM pUVM, uint32_t fEvtClasses)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    PVM pVM = pUVM->pVM;
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertReturn(!(fEvtClasses & ~DBGFEVTTRACE_F_ALL), VERR_INVALID_FLAGS);
+    if (!pVM->dbgf.s.pbEvtTraceR3)
+        return VERR_DBGF_NO_TRACE_BUFFER;
+
+    ASMAtomicWriteU32(&pVM->dbgf.s.fEvtTraceMask, fEvtClasses);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Gets the event classes the event tracer is currently recording.
+ *
+ * @returns DBGFEVTTRACE_F_XXX, 0 if disabled or on invalid input.
+ * @param   pUVM            The user mode VM handle.
+ */
+VMMR3DECL(uint32_t) DBGFR3EvtTraceGetEvents(PUVM pUVM)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, 0);
+    PVM pVM = pUVM->pVM;
+    VM_ASSERT_VALID_EXT_RETURN(pVM, 0);
+    return ASMAtomicReadU32(&pVM->dbgf.s.fEvtTraceMask);
+}
+
+
+/**
+ * Takes a consistent snapshot of one event tracer ring.
+ *
+ * @returns Number of valid records copied to @a paRecs, oldest first.
+ * @param   pVM         The cross context VM structure.
+ * @param   idCpu       The VCPU which ring to copy.
+ * @param   paRecs      Where to copy the records, DBGF::cEvtTraceEntries
+ *                      entries big.
+ */
+static uint32_t dbgfR3EvtTraceSnapshot(PVM pVM, VMCPUID idCpu, PDBGFEVTTRACEREC paRecs)
+{
+    PDBGFEVTTRACERING pRing    = (PDBGFEVTTRACERING)(pVM->dbgf.s.pbEvtTraceR3 + (uintptr_t)idCpu * pVM->dbgf.s.cbEvtTraceRing);
+    uint32_t const    cEntries = pVM->dbgf.s.cEvtTraceEntries;
+
+    uint64_t const idxEnd   = ASMAtomicReadU64(&pRing->idxNext);
+    uint64_t       idxFirst = idxEnd > cEntries ? idxEnd - cEntries : 0;
+    for (uint64_t idx = idxFirst; idx < idxEnd; idx++)
+        paRecs[idx - idxFirst] = pRing->aRecs[idx & (cEntries - 1)];
+
+    /*
+     * The EMT may have lapped us while copying.  The slot of record idx is
+     * being rewritten as soon as idxNext reaches idx + cEntries, so drop those.
+     */
+    uint64_t const idxNow = ASMAtomicReadU64(&pRing->idxNext);
+    if (idxNow >= cEntries && idxNow - cEntries + 1 > idxFirst)
+    {
+        uint64_t const idxValid = RT_MIN(idxNow - cEntries + 1, idxEnd);
+        memmove(paRecs, &paRecs[idxValid - idxFirst], (size_t)(idxEnd - idxValid) * sizeof(paRecs[0]));
+        idxFirst = idxValid;
+    }
+    return (uint32_t)(idxEnd - idxFirst);
+}
+
+
+/**
+ * Formats the name of an exit recorded by EMHistoryAddExit.
+ *
+ * @returns pszBuf.
+ * @param   uFlagsAndType   The EM exit flags and type.
+ * @param   pszBuf          The output buffer.
+ * @param   cbBuf           The size of the output buffer.
+ */
+static const char *dbgfR3EvtTraceExitName(uint32_t uFlagsAndType, char *pszBuf, size_t cbBuf)
+{
+    uint32_t const uType = uFlagsAndType & EMEXIT_F_TYPE_MASK;
+    const char    *pszName;
+    switch (uFlagsAndType & EMEXIT_F_KIND_MASK)
+    {
+        case EMEXIT_F_KIND_VMX:
+            pszName = HMGetVmxExitName(uType);
+            if (pszName)
+                RTStrPrintf(pszBuf, cbBuf, "VMX/%s", pszName);
+            else
+                RTStrPrintf(pszBuf, cbBuf, "VMX/%#x", uType);
+            break;
+        case EMEXIT_F_KIND_SVM:
+            pszName = HMGetSvmExitName(uType);
+            if (pszName)
+                RTStrPrintf(pszBuf, cbBuf, "SVM/%s", pszName);
+            else
+                RTStrPrintf(pszBuf, cbBuf, "SVM/%#x", uType);
+            break;
+        case EMEXIT_F_KIND_NEM:     RTStrPrintf(pszBuf, cbBuf, "NEM/%#x", uType); break;
+        case EMEXIT_F_KIND_XCPT:    RTStrPrintf(pszBuf, cbBuf, "XCPT/%#x", uType); break;
+        default:                    RTStrPrintf(pszBuf, cbBuf, "EM/%#x", uType); break;
+    }
+    return pszBuf;
+}
+
+
+/**
+ * Writes one event tracer record as a Chrome trace event.
+ *
+ * @param   pStrm       The output stream.
+ * @param   uPid        The process ID to use.
+ * @param   idCpu       The VCPU the record belongs to (used as thread ID).
+ * @param   pRec        The record.
+ */
+static void dbgfR3EvtTraceExportRec(PRTSTREAM pStrm, RTPROCESS uPid, VMCPUID idCpu, PCDBGFEVTTRACEREC pRec)
+{
+    char szName[64];
+    switch (pRec->enmType)
+    {
+        case DBGFEVTTRACETYPE_EXIT:
+            RTStrmPrintf(pStrm,
+                         ",\n{\"name\":\"%s\",\"cat\":\"exit\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%RU64.%03u,\"pid\":%RU32,\"tid\":%u,"
+                         "\"args\":{\"pc\":\"%#RX64\",\"type\":\"%#x\"}}",
+                         dbgfR3EvtTraceExitName(pRec->u32Arg, szName, sizeof(szName)),
+                         pRec->u64NanoTS / RT_NS_1US, (unsigned)(pRec->u64NanoTS % RT_NS_1US), uPid, idCpu,
+                         pRec->u64Arg0, pRec->u32Arg);
+            break;
+
+        case DBGFEVTTRACETYPE_IOPORT_READ:
+        case DBGFEVTTRACETYPE_IOPORT_WRITE:
+            RTStrmPrintf(pStrm,
+                         ",\n{\"name\":\"%s %#x\",\"cat\":\"io\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%RU64.%03u,\"pid\":%RU32,\"tid\":%u,"
+                         "\"args\":{\"value\":\"%#RX32\",\"cb\":%RU64}}",
+                         pRec->enmType == DBGFEVTTRACETYPE_IOPORT_READ ? "in" : "out", pRec->u16Arg,
+                         pRec->u64NanoTS / RT_NS_1US, (unsigned)(pRec->u64NanoTS % RT_NS_1US), uPid, idCpu,
+                         pRec->u32Arg, pRec->u64Arg0);
+            break;
+
+        case DBGFEVTTRACETYPE_MMIO_READ:
+        case DBGFEVTTRACETYPE_MMIO_WRITE:
+            RTStrmPrintf(pStrm,
+                         ",\n{\"name\":\"%s %RGp\",\"cat\":\"mmio\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%RU64.%03u,\"pid\":%RU32,\"tid\":%u,"
+                         "\"args\":{\"value\":\"%#RX64\",\"cb\":%u}}",
+                         pRec->enmType == DBGFEVTTRACETYPE_MMIO_READ ? "mmio-read" : "mmio-write", (RTGCPHYS)pRec->u64Arg0,
+                         pRec->u64NanoTS / RT_NS_1US, (unsigned)(pRec->u64NanoTS % RT_NS_1US), uPid, idCpu,
+                         pRec->u64Arg1, pRec->u16Arg);
+            break;
+
+        case DBGFEVTTRACETYPE_INTERRUPT:
+            RTStrmPrintf(pStrm,
+                         ",\n{\"name\":\"int %#04x\",\"cat\":\"int\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%RU64.%03u,\"pid\":%RU32,\"tid\":%u}",
+                         pRec->u16Arg, pRec->u64NanoTS / RT_NS_1US, (unsigned)(pRec->u64NanoTS % RT_NS_1US), uPid, idCpu);
+            break;
+
+        case DBGFEVTTRACETYPE_TIMER:
+        case DBGFEVTTRACETYPE_CRITSECT_WAIT:
+        {
+            /* Complete events; the record timestamp marks the end. */
+            uint64_t const cNsDur   = pRec->u64Arg1;
+            uint64_t const uStartNs = pRec->u64NanoTS - RT_MIN(cNsDur, pRec->u64NanoTS);
+            RTStrmPrintf(pStrm,
+                         ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%RU64.%03u,\"dur\":%RU64.%03u,\"pid\":%RU32,\"tid\":%u,"
+                         "\"args\":{\"object\":\"%#RX64\"",
+                         pRec->enmType == DBGFEVTTRACETYPE_TIMER ? "timer" : "critsect-wait",
+                         pRec->enmType == DBGFEVTTRACETYPE_TIMER ? "timer" : "critsect",
+                         uStartNs / RT_NS_1US, (unsigned)(uStartNs % RT_NS_1US),
+                         cNsDur / RT_NS_1US, (unsigned)(cNsDur % RT_NS_1US), uPid, idCpu, pRec->u64Arg0);
+            if (pRec->enmType == DBGFEVTTRACETYPE_TIMER)
+                RTStrmPrintf(pStrm, ",\"clock\":%u", pRec->u16Arg);
+            RTStrmPrintf(pStrm, "}}");
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+/**
+ * Exports the content of the event tracer rings in the Chrome trace event
+ * format (JSON object format).
+ *
+ * The resulting file can be loaded into chrome://tracing or the Perfetto UI.
+ * Each VCPU is presented as a thread of the VM process.  Recording continues
+ * while exporting, records overwritten during the export are dropped.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_DBGF_NO_TRACE_BUFFER if the event tracer rings weren't
+ *          allocated (DBGF/EvtTraceEnabled).
+ *
+ * @param   pUVM            The user mode VM handle.
+ * @param   pszFilename     The output filename.  Will be overwritten.
+ */
+VMMR3DECL(int) DBGFR3EvtTraceExportChromeJson(PUVM pUVM, const char *pszFilename)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    PVM pVM = pUVM->pVM;
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertPtrReturn(pszFilename, VERR_INVALID_POINTER);
+    AssertReturn(*pszFilename, VERR_INVALID_PARAMETER);
+    if (!pVM->dbgf.s.pbEvtTraceR3)
+        return VERR_DBGF_NO_TRACE_BUFFER;
+
+    PDBGFEVTTRACEREC paRecs = (PDBGFEVTTRACEREC)RTMemAlloc(pVM->dbgf.s.cEvtTraceEntries * sizeof(DBGFEVTTRACEREC));
+    if (!paRecs)
+        return VERR_NO_MEMORY;
+
+    PRTSTREAM pStrm;
+    int rc = RTStrmOpen(pszFilename, "w", &pStrm);
+    if (RT_SUCCESS(rc))
+    {
+        RTPROCESS const uPid = RTProcSelf();
+        RTStrmPrintf(pStrm, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%RU32,\"args\":{\"name\":\"VM\"}}",
+                     uPid);
+        for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+        {
+            RTStrmPrintf(pStrm, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%RU32,\"tid\":%u,\"args\":{\"name\":\"EMT-%u\"}}",
+                         uPid, idCpu, idCpu);
+
+            uint32_t const cRecs = dbgfR3EvtTraceSnapshot(pVM, idCpu, paRecs);
+            for (uint32_t i = 0; i < cRecs; i++)
+                dbgfR3EvtTraceExportRec(pStrm, uPid, idCpu, &paRecs[i]);
+        }
+        RTStrmPrintf(pStrm, "\n]}\n");
+
+        rc = RTStrmError(pStrm);
+        int rc2 = RTStrmClose(pStrm);
+        if (RT_SUCCESS(rc))
+            rc = rc2;
+    }
+    RTMemFree(paRecs);
+    return rc;
+}
+
+
+/**
+ * Parses event tracer class names for the info handler.
+ *
+ * @returns DBGFEVTTRACE_F_XXX, UINT32_MAX on unknown name.
+ * @param   psz         The space separated class names.  An empty string
+ *                      means all classes.
+ */
+static uint32_t dbgfR3EvtTraceParseClasses(const char *psz)
+{
+    uint32_t fMask = 0;
+    for (;;)
+    {
+        psz = RTStrStripL(psz);
+        if (!*psz)
+            break;
+        size_t cchName = 0;
+        while (psz[cchName] && !RT_C_IS_SPACE(psz[cchName]))
+            cchName++;
+
+        uint32_t i = RT_ELEMENTS(g_aEvtTraceClasses);
+        while (i-- > 0)
+            if (   g_aEvtTraceClasses[i].cchName == cchName
+                && !strncmp(g_aEvtTraceClasses[i].pszName, psz, cchName))
+                break;
+        if (i == UINT32_MAX)
+            return UINT32_MAX;
+        fMask |= g_aEvtTraceClasses[i].fMask;
+        psz += cchName;
+    }
+    return fMask ? fMask : DBGFEVTTRACE_F_ALL;
+}
+
+
+/**
+ * @callback_method_impl{FNDBGFHANDLERINT, Info handler for controlling the event tracer.}
+ */
+static DECLCALLBACK(void) dbgfR3EvtTraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    if (!pVM->dbgf.s.pbEvtTraceR3)
+    {
+        pHlp->pfnPrintf(pHlp, "The event tracer is not available (set DBGF/EvtTraceEnabled)\n");
+        return;
+    }
+
+    int rc = VINF_SUCCESS;
+    const char *psz = pszArgs ? RTStrStripL(pszArgs) : "";
+    if (!strncmp(psz, "on", 2) && (!psz[2] || RT_C_IS_SPACE(psz[2])))
+    {
+        uint32_t const fMask = dbgfR3EvtTraceParseClasses(psz + 2);
+        if (fMask == UINT32_MAX)
+        {
+            pHlp->pfnPrintf(pHlp, "Unknown event class in '%s'\n", psz + 2);
+            return;
+        }
+        rc = DBGFR3EvtTraceSetEvents(pVM->pUVM, fMask);
+    }
+    else if (!strncmp(psz, "off", 3) && (!psz[3] || RT_C_IS_SPACE(psz[3])))
+        rc = DBGFR3EvtTraceSetEvents(pVM->pUVM, 0);
+    else if (!strncmp(psz, "export", 6) && RT_C_IS_SPACE(psz[6]))
+    {
+        char *pszFilename = RTStrDup(RTStrStripL(psz + 6));
+        if (pszFilename)
+        {
+            RTStrStripR(pszFilename);
+            rc = DBGFR3EvtTraceExportChromeJson(pVM->pUVM, pszFilename);
+            if (RT_SUCCESS(rc))
+                pHlp->pfnPrintf(pHlp, "Exported the event trace to '%s'\n", pszFilename);
+            RTStrFree(pszFilename);
+        }
+        else
+            rc = VERR_NO_STR_MEMORY;
+    }
+    else if (*psz)
+    {
+        pHlp->pfnPrintf(pHlp, "Unknown argument '%s'. Expected: on [classes] | off | export <file>\n", psz);
+        return;
+    }
+    if (RT_FAILURE(rc))
+    {
+        pHlp->pfnPrintf(pHlp, "Failed: %Rrc\n", rc);
+        return;
+    }
+
+    /*
+     * Status.
+     */
+    uint32_t const fMask = ASMAtomicReadU32(&pVM->dbgf.s.fEvtTraceMask);
+    pHlp->pfnPrintf(pHlp, "Event tracer: %u records per VCPU, recording:", pVM->dbgf.s.cEvtTraceEntries);
+    if (!fMask)
+        pHlp->pfnPrintf(pHlp, " nothing");
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_aEvtTraceClasses) - 1; i++)
+        if (fMask & g_aEvtTraceClasses[i].fMask)
+            pHlp->pfnPrintf(pHlp, " %s", g_aEvtTraceClasses[i].pszName);
+    pHlp->pfnPrintf(pHlp, "\n");
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PDBGFEVTTRACERING pRing = (PDBGFEVTTRACERING)(pVM->dbgf.s.pbEvtTraceR3 + (uintptr_t)idCpu * pVM->dbgf.s.cbEvtTraceRing);
+        pHlp->pfnPrintf(pHlp, "  VCPU %u: %'RU64 records added\n", idCpu, ASMAtomicReadU64(&pRing->idxNext));
+    }
+}
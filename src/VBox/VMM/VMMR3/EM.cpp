@@ -59,6 +59,7 @@
 #include <VBox/vmm/pdmcritsect.h>
 #include <VBox/vmm/pdmqueue.h>
 #include <VBox/vmm/hm.h>
+#include <VBox/vmm/gim.h>
 #include <VBox/vmm/patm.h>
 #include "EMInternal.h"
 #include <VBox/vmm/vm.h>
@@ -200,6 +201,15 @@ VMMR3_INT_DECL(int) EMR3Init(PVM pVM)
                            cHistoryProbeMinInstructions);
     AssertLogRelRCReturn(rc, rc);
 
+    /** @cfgm{/EM/HistoryProbeMinHits, integer, 16, 65535, 256}
+     * Number of times an exit must be hit before it is probed for close by
+     * exits.  String I/O exits are probed after a sixteenth of this. */
+    uint16_t cHistoryProbeMinHits = 256;
+    rc = CFGMR3QueryU16Def(pCfgEM, "HistoryProbeMinHits", &cHistoryProbeMinHits, cHistoryProbeMinHits);
+    AssertLogRelRCReturn(rc, rc);
+    if (cHistoryProbeMinHits < 16)
+        return VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS, "/EM/HistoryProbeMinHits value is too small, min 16");
+
     for (VMCPUID i = 0; i < pVM->cCpus; i++)
     {
         pVM->aCpus[i].em.s.fExitOptimizationEnabled                  = fExitOptimizationEnabled;
@@ -209,6 +219,7 @@ VMMR3_INT_DECL(int) EMR3Init(PVM pVM)
         pVM->aCpus[i].em.s.cHistoryExecMaxInstructions               = cHistoryExecMaxInstructions;
         pVM->aCpus[i].em.s.cHistoryProbeMinInstructions              = cHistoryProbeMinInstructions;
         pVM->aCpus[i].em.s.cHistoryProbeMaxInstructionsWithoutExit   = cHistoryProbeMaxInstructionsWithoutExit;
+        pVM->aCpus[i].em.s.cHistoryProbeMinHits                      = cHistoryProbeMinHits;
     }
 
 #ifdef VBOX_WITH_REM
@@ -370,6 +381,8 @@ VMMR3_INT_DECL(int) EMR3Init(PVM pVM)
         EM_REG_COUNTER(&pVCpu->em.s.StatHistoryProbedNormal,      "/EM/CPU%d/ExitOpt/ProbedNormal",      "Number of EMEXITACTION_NORMAL_PROBED results.");
         EM_REG_COUNTER(&pVCpu->em.s.StatHistoryProbedExecWithMax, "/EM/CPU%d/ExitOpt/ProbedExecWithMax", "Number of EMEXITACTION_EXEC_WITH_MAX results.");
         EM_REG_COUNTER(&pVCpu->em.s.StatHistoryProbedToRing3,     "/EM/CPU%d/ExitOpt/ProbedToRing3",     "Number of ring-3 probe continuations.");
+        EM_REG_COUNTER(&pVCpu->em.s.StatHistoryReprobed,          "/EM/CPU%d/ExitOpt/Reprobed",          "Number of EMEXITACTION_NORMAL_PROBED records probed again.");
+        EM_REG_COUNTER(&pVCpu->em.s.StatHistoryExecDemoted,       "/EM/CPU%d/ExitOpt/ExecDemoted",       "Number of fruitless EMEXITACTION_EXEC_WITH_MAX records demoted.");
     }
 
     emR3InitDbg(pVM);
@@ -2489,6 +2502,11 @@ VMMR3_INT_DECL(int) EMR3ExecuteVM(PVM pVM, PVMCPU pVCpu)
         STAM_REL_PROFILE_ADV_START(&pVCpu->em.s.StatTotal, x);
         for (;;)
         {
+            /*
+             * Let the guest know how much time we didn't give it (KVM steal time).
+             */
+            GIMR3UpdateStealTime(pVM, pVCpu);
+
             /*
              * Before we can schedule anything (we're here because
              * scheduling is required) we must service any pending
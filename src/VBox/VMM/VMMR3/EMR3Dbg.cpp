@@ -28,6 +28,37 @@
 #include <VBox/vmm/vm.h>
 #include <iprt/string.h>
 #include <iprt/ctype.h>
+#include <iprt/mem.h>
+#include <iprt/sort.h>
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * Exit record summed up over all the VCPUs, for the 'exittop' info handler.
+ */
+typedef struct EMR3TOPEXIT
+{
+    /** The flat PC of the exit. */
+    uint64_t            uFlatPC;
+    /** Number of hits, all VCPUs. */
+    uint64_t            cHits;
+    /** Flags and type, see EMEXIT_MAKE_FT. */
+    uint32_t            uFlagsAndType;
+    /** Number of VCPUs having a record for it. */
+    uint16_t            cCpus;
+    /** Max instructions without exit of the record with the most hits. */
+    uint16_t            cMaxInstructionsWithoutExit;
+    /** The action of the record with the most hits (EMEXITACTION). */
+    uint8_t             enmAction;
+    /** Explicit padding. */
+    uint8_t             abPadding[7];
+    /** The most hits seen for a single VCPU record (picks enmAction). */
+    uint64_t            cMaxCpuHits;
+} EMR3TOPEXIT;
+/** Pointer to a summed up exit record. */
+typedef EMR3TOPEXIT *PEMR3TOPEXIT;
 
 
 /** @callback_method_impl{FNDBGCCMD,
@@ -314,6 +345,169 @@ static DECLCALLBACK(void) emR3InfoExitHistory(PVM pVM, PCDBGFINFOHLP pHlp, const
 }
 
 
+/**
+ * @callback_method_impl{FNRTSORTCMP, Sorts EMR3TOPEXIT by PC and type.}
+ */
+static DECLCALLBACK(int) emR3TopExitCmpPcAndType(void const *pvElement1, void const *pvElement2, void *pvUser)
+{
+    EMR3TOPEXIT const *pLeft  = (EMR3TOPEXIT const *)pvElement1;
+    EMR3TOPEXIT const *pRight = (EMR3TOPEXIT const *)pvElement2;
+    RT_NOREF(pvUser);
+    if (pLeft->uFlatPC != pRight->uFlatPC)
+        return pLeft->uFlatPC < pRight->uFlatPC ? -1 : 1;
+    if (pLeft->uFlagsAndType != pRight->uFlagsAndType)
+        return pLeft->uFlagsAndType < pRight->uFlagsAndType ? -1 : 1;
+    return 0;
+}
+
+
+/**
+ * @callback_method_impl{FNRTSORTCMP, Sorts EMR3TOPEXIT by descending hits.}
+ */
+static DECLCALLBACK(int) emR3TopExitCmpHits(void const *pvElement1, void const *pvElement2, void *pvUser)
+{
+    EMR3TOPEXIT const *pLeft  = (EMR3TOPEXIT const *)pvElement1;
+    EMR3TOPEXIT const *pRight = (EMR3TOPEXIT const *)pvElement2;
+    RT_NOREF(pvUser);
+    if (pLeft->cHits != pRight->cHits)
+        return pLeft->cHits > pRight->cHits ? -1 : 1;
+    return 0;
+}
+
+
+/**
+ * Gets a short name for an exit record action.
+ *
+ * @returns Read-only name.
+ * @param   enmAction       The action (EMEXITACTION).
+ */
+static const char *emR3GetExitActionName(uint8_t enmAction)
+{
+    switch (enmAction)
+    {
+        case EMEXITACTION_FREE_RECORD:      return "free";
+        case EMEXITACTION_NORMAL:           return "normal";
+        case EMEXITACTION_NORMAL_PROBED:    return "probed";
+        case EMEXITACTION_EXEC_PROBE:       return "probing";
+        case EMEXITACTION_EXEC_WITH_MAX:    return "iem-exec";
+    }
+    return "bad";
+}
+
+
+/**
+ * Displays the hottest exits recorded in the exit records of all VCPUs.
+ *
+ * Only exits that EM keeps records for show up here, i.e. the ones HM, NEM and
+ * raw-mode have converted to EMEXIT_F_KIND_EM (I/O port, MMIO, MSR, CPUID,
+ * RDTSC, ...).  The tables are read without stopping the VCPUs, so the numbers
+ * are approximate.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pHlp        The info helper functions.
+ * @param   pszArgs     Number of entries to display (default 25).
+ */
+static DECLCALLBACK(void) emR3InfoTopExits(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    uint32_t cToShow = 25;
+    if (pszArgs)
+    {
+        pszArgs = RTStrStripL(pszArgs);
+        if (RT_C_IS_DIGIT(*pszArgs))
+        {
+            RTStrToUInt32Ex(pszArgs, NULL, 0, &cToShow);
+            if (!cToShow)
+                cToShow = 25;
+        }
+        else if (*pszArgs)
+            pHlp->pfnPrintf(pHlp, "Unknown option: %s\n", pszArgs);
+    }
+
+    /*
+     * Gather the records of all the VCPUs.
+     */
+    size_t const cMaxRecs = (size_t)pVM->cCpus * RT_ELEMENTS(pVM->aCpus[0].em.s.aExitRecords);
+    PEMR3TOPEXIT paRecs   = (PEMR3TOPEXIT)RTMemAllocZ(cMaxRecs * sizeof(paRecs[0]));
+    if (!paRecs)
+    {
+        pHlp->pfnPrintf(pHlp, "Out of memory\n");
+        return;
+    }
+
+    uint64_t cTotalExits = 0;
+    size_t   cRecs       = 0;
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PVMCPU pVCpu = &pVM->aCpus[idCpu];
+        cTotalExits += pVCpu->em.s.iNextExit;
+        for (uint32_t i = 0; i < RT_ELEMENTS(pVCpu->em.s.aExitRecords); i++)
+        {
+            PCEMEXITREC pExitRec = &pVCpu->em.s.aExitRecords[i];
+            if (pExitRec->enmAction != EMEXITACTION_FREE_RECORD)
+            {
+                PEMR3TOPEXIT pDst = &paRecs[cRecs++];
+                pDst->uFlatPC                     = pExitRec->uFlatPC;
+                pDst->cHits                       = pExitRec->cHits;
+                pDst->uFlagsAndType               = pExitRec->uFlagsAndType;
+                pDst->cCpus                       = 1;
+                pDst->cMaxInstructionsWithoutExit = pExitRec->cMaxInstructionsWithoutExit;
+                pDst->enmAction                   = pExitRec->enmAction;
+                pDst->cMaxCpuHits                 = pExitRec->cHits;
+            }
+        }
+    }
+
+    /*
+     * Merge the records for the same exit on different VCPUs, then rank them.
+     */
+    if (cRecs > 1)
+    {
+        RTSortShell(paRecs, cRecs, sizeof(paRecs[0]), emR3TopExitCmpPcAndType, NULL);
+        size_t iDst = 0;
+        for (size_t iSrc = 1; iSrc < cRecs; iSrc++)
+        {
+            if (   paRecs[iSrc].uFlatPC       == paRecs[iDst].uFlatPC
+                && paRecs[iSrc].uFlagsAndType == paRecs[iDst].uFlagsAndType)
+            {
+                paRecs[iDst].cHits += paRecs[iSrc].cHits;
+                paRecs[iDst].cCpus += 1;
+                if (paRecs[iSrc].cMaxCpuHits > paRecs[iDst].cMaxCpuHits)
+                {
+                    paRecs[iDst].cMaxCpuHits                 = paRecs[iSrc].cMaxCpuHits;
+                    paRecs[iDst].enmAction                   = paRecs[iSrc].enmAction;
+                    paRecs[iDst].cMaxInstructionsWithoutExit = paRecs[iSrc].cMaxInstructionsWithoutExit;
+                }
+            }
+            else
+                paRecs[++iDst] = paRecs[iSrc];
+        }
+        cRecs = iDst + 1;
+        RTSortShell(paRecs, cRecs, sizeof(paRecs[0]), emR3TopExitCmpHits, NULL);
+    }
+
+    /*
+     * Display them.
+     */
+    pHlp->pfnPrintf(pHlp,
+                    "Top exits (%'RU64 exits recorded by %u VCPU(s), %zu distinct sites):\n"
+                    "  #      Hits  Share  RIP (Flat)        CPUs Action   MaxDist Exit\n",
+                    cTotalExits, pVM->cCpus, cRecs);
+    for (size_t i = 0; i < RT_MIN(cRecs, cToShow); i++)
+    {
+        char        szExitName[16];
+        const char *pszExitName = emR3HistoryGetExitName(paRecs[i].uFlagsAndType, szExitName, sizeof(szExitName));
+        uint64_t const uPermille = cTotalExits ? paRecs[i].cHits * 1000 / cTotalExits : 0;
+        pHlp->pfnPrintf(pHlp, "%3zu %'11RU64 %3u.%u%% %016RX64 %4u %-8s %7u %s\n",
+                        i + 1, paRecs[i].cHits, (unsigned)(uPermille / 10), (unsigned)(uPermille % 10),
+                        paRecs[i].uFlatPC, paRecs[i].cCpus, emR3GetExitActionName(paRecs[i].enmAction),
+                        paRecs[i].enmAction == EMEXITACTION_EXEC_WITH_MAX ? paRecs[i].cMaxInstructionsWithoutExit : 0,
+                        pszExitName);
+    }
+
+    RTMemFree(paRecs);
+}
+
+
 int emR3InitDbg(PVM pVM)
 {
     /*
@@ -324,6 +518,9 @@ int emR3InitDbg(PVM pVM)
     AssertLogRelRCReturn(rc, rc);
     rc = DBGFR3InfoRegisterInternalEx(pVM, "exithistory", pszExitsDesc, emR3InfoExitHistory, DBGFINFO_FLAGS_ALL_EMTS);
     AssertLogRelRCReturn(rc, rc);
+    rc = DBGFR3InfoRegisterInternal(pVM, "exittop", "Displays the hottest exit sites of all VCPUs. Arguments: Number of entries.",
+                                    emR3InfoTopExits);
+    AssertLogRelRCReturn(rc, rc);
 
 #ifdef VBOX_WITH_DEBUGGER
     /*
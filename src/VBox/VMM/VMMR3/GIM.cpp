@@ -413,6 +413,25 @@ VMMR3_INT_DECL(void) GIMR3Reset(PVM pVM)
 }
 
 
+/**
+ * Updates the paravirtualized steal-time accounting of a VCPU, if the provider
+ * offers it and the guest has enabled it.
+ *
+ * This is called by EM every time the EMT passes through its outer loop, the
+ * provider decides whether an update is actually due.
+ *
+ * @param   pVM     The cross context VM structure.
+ * @param   pVCpu   The cross context virtual CPU structure.
+ * @thread  EMT(pVCpu)
+ */
+VMMR3_INT_DECL(void) GIMR3UpdateStealTime(PVM pVM, PVMCPU pVCpu)
+{
+    VMCPU_ASSERT_EMT(pVCpu);
+    if (pVM->gim.s.enmProviderId == GIMPROVIDERID_KVM)
+        gimR3KvmUpdateStealTime(pVM, pVCpu);
+}
+
+
 /**
  * Registers the GIM device with VMM.
  *
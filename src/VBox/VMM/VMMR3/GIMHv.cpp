@@ -214,7 +214,10 @@ VMMR3_INT_DECL(int) gimR3HvInit(PVM pVM, PCFGMNODE pGimCfg)
         int rc2 = CFGMR3ValidateConfig(pCfgHv, "/HyperV/",
                                   "VendorID"
                                   "|VSInterface"
-                                  "|HypercallDebugInterface",
+                                  "|HypercallDebugInterface"
+                                  "|TlbFlushHypercalls"
+                                  "|SpinlockRetries"
+                                  "|ApicMsrHint",
                                   "" /* pszValidNodes */, "GIM/HyperV" /* pszWho */, 0 /* uInstance */);
         if (RT_FAILURE(rc2))
             return rc2;
@@ -248,6 +251,28 @@ VMMR3_INT_DECL(int) gimR3HvInit(PVM pVM, PCFGMNODE pGimCfg)
     rc = CFGMR3QueryBoolDef(pCfgHv, "HypercallDebugInterface", &pHv->fDbgHypercallInterface, false);
     AssertLogRelRCReturn(rc, rc);
 
+    /** @cfgm{/GIM/HyperV/TlbFlushHypercalls, bool, true}
+     * Whether to recommend the HvFlushVirtualAddressSpace/List[Ex] hypercalls
+     * for remote TLB flushes instead of IPIs.  Only honoured with HM. */
+    bool fTlbFlushHypercalls;
+    rc = CFGMR3QueryBoolDef(pCfgHv, "TlbFlushHypercalls", &fTlbFlushHypercalls, true);
+    AssertLogRelRCReturn(rc, rc);
+
+    /** @cfgm{/GIM/HyperV/SpinlockRetries, uint32_t, 0xfff}
+     * The number of spinlock retries after which the guest should notify us via
+     * HvNotifyLongSpinWait.  0xffffffff means never notify. */
+    uint32_t cSpinlockRetries;
+    rc = CFGMR3QueryU32Def(pCfgHv, "SpinlockRetries", &cSpinlockRetries, 0xfff);
+    AssertLogRelRCReturn(rc, rc);
+    pHv->fLongSpinWaitNotify = cSpinlockRetries != UINT32_MAX;
+
+    /** @cfgm{/GIM/HyperV/ApicMsrHint, bool, false}
+     * Whether to recommend the synthetic APIC MSRs (EOI, ICR, TPR) over MMIO
+     * accesses to the guest. */
+    bool fApicMsrHint;
+    rc = CFGMR3QueryBoolDef(pCfgHv, "ApicMsrHint", &fApicMsrHint, false);
+    AssertLogRelRCReturn(rc, rc);
+
     /*
      * Determine interface capabilities based on the version.
      */
@@ -284,6 +309,13 @@ VMMR3_INT_DECL(int) gimR3HvInit(PVM pVM, PCFGMNODE pGimCfg)
                          | GIM_HV_HINT_RELAX_TIME_CHECKS
                          | GIM_HV_HINT_X2APIC_MSRS
                          ;
+        if (fApicMsrHint)
+            pHv->uHyperHints |= GIM_HV_HINT_MSR_FOR_APIC_ACCESS;
+        /* Remote flushes go through HM's TLB shootdown which doesn't poke halted VCPUs. */
+        if (   fTlbFlushHypercalls
+            && VM_IS_HM_ENABLED(pVM))
+            pHv->uHyperHints |= GIM_HV_HINT_HYPERCALL_FOR_TLB_SHOOTDOWN
+                             |  GIM_HV_HINT_EX_PROC_MASKS_INTERFACE;
 
         /* Partition features. */
         pHv->uPartFlags |= GIM_HV_PART_FLAGS_EXTENDED_HYPERCALLS;
@@ -409,7 +441,7 @@ VMMR3_INT_DECL(int) gimR3HvInit(PVM pVM, PCFGMNODE pGimCfg)
 
     HyperLeaf.uLeaf        = UINT32_C(0x40000004);
     HyperLeaf.uEax         = pHv->uHyperHints;
-    HyperLeaf.uEbx         = 0xffffffff;
+    HyperLeaf.uEbx         = cSpinlockRetries;
     HyperLeaf.uEcx         = 0;
     HyperLeaf.uEdx         = 0;
     rc = CPUMR3CpuIdInsert(pVM, &HyperLeaf);
@@ -529,6 +561,19 @@ VMMR3_INT_DECL(int) gimR3HvInit(PVM pVM, PCFGMNODE pGimCfg)
                                      "/GIM/HyperV/%u/Stimer%u_Fired", idCpu, idxStimer);
             AssertLogRelRCReturn(rc2, rc2);
         }
+
+        rc = STAMR3RegisterF(pVM, &pHvCpu->StatFlushVaSpace, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                             "Number of HvFlushVirtualAddressSpace[Ex] hypercalls.", "/GIM/HyperV/%u/FlushVaSpace", idCpu);
+        AssertLogRelRCReturn(rc, rc);
+        rc = STAMR3RegisterF(pVM, &pHvCpu->StatFlushVaList, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                             "Number of HvFlushVirtualAddressList[Ex] hypercalls.", "/GIM/HyperV/%u/FlushVaList", idCpu);
+        AssertLogRelRCReturn(rc, rc);
+        rc = STAMR3RegisterF(pVM, &pHvCpu->StatFlushVaRemoteCpus, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                             "Number of remote VCPUs targeted by TLB flush hypercalls.", "/GIM/HyperV/%u/FlushVaRemoteCpus", idCpu);
+        AssertLogRelRCReturn(rc, rc);
+        rc = STAMR3RegisterF(pVM, &pHvCpu->StatLongSpinWait, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                             "Number of HvNotifyLongSpinWait hypercalls.", "/GIM/HyperV/%u/LongSpinWait", idCpu);
+        AssertLogRelRCReturn(rc, rc);
     }
 
     return VINF_SUCCESS;
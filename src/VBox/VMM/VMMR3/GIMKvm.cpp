@@ -26,6 +26,8 @@
 #include <VBox/vmm/pdmapi.h>
 #include <VBox/vmm/ssm.h>
 #include <VBox/vmm/em.h>
+#include <VBox/vmm/stam.h>
+#include <VBox/vmm/tm.h>
 #include "GIMInternal.h"
 #include <VBox/vmm/vm.h>
 
@@ -37,6 +39,8 @@
 #include <iprt/assert.h>
 #include <iprt/string.h>
 #include <iprt/mem.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
 
 
 
@@ -47,7 +51,9 @@
 /**
  * GIM KVM saved-state version.
  */
-#define GIM_KVM_SAVED_STATE_VERSION         UINT32_C(1)
+#define GIM_KVM_SAVED_STATE_VERSION         UINT32_C(2)
+/** Saved state version prior to steal time and PV EOI. */
+#define GIM_KVM_SAVED_STATE_VERSION_PRE_STEAL_TIME  UINT32_C(1)
 
 /**
  * VBox internal struct. to passback to EMT rendezvous callback while enabling
@@ -110,10 +116,15 @@ VMMR3_INT_DECL(int) gimR3KvmInit(PVM pVM)
                         //|  GIM_KVM_BASE_FEAT_MMU_OP
                         | GIM_KVM_BASE_FEAT_CLOCK
                         //| GIM_KVM_BASE_FEAT_ASYNC_PF
-                        //| GIM_KVM_BASE_FEAT_STEAL_TIME
-                        //| GIM_KVM_BASE_FEAT_PV_EOI
+                        | GIM_KVM_BASE_FEAT_STEAL_TIME
+                        | GIM_KVM_BASE_FEAT_PV_EOI
                         | GIM_KVM_BASE_FEAT_PV_UNHALT
                         ;
+
+        /* The PV EOI flag is consulted by the APIC in guest memory, which we
+           don't bother doing from raw-mode context. */
+        if (VM_IS_RAW_MODE_ENABLED(pVM))
+            pKvm->uBaseFeat &= ~GIM_KVM_BASE_FEAT_PV_EOI;
         /* Rest of the features are determined in gimR3KvmInitCompleted(). */
     }
 
@@ -168,6 +179,20 @@ VMMR3_INT_DECL(int) gimR3KvmInit(PVM pVM)
     AssertLogRelReturn(cbHypercall == sizeof(pKvm->abOpcodeNative), VERR_GIM_IPE_1);
     pKvm->fTrapXcptUD = pKvm->uOpcodeNative != OP_VMCALL || VM_IS_RAW_MODE_ENABLED(pVM);
 
+    /*
+     * Statistics.
+     */
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PGIMKVMCPU pKvmCpu = &pVM->aCpus[idCpu].gim.s.u.KvmCpu;
+        rc = STAMR3RegisterF(pVM, &pKvmCpu->StatStealTimeUpdates, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                             "Number of steal-time struct. updates.", "/GIM/KVM/CPU%u/StealTimeUpdates", idCpu);
+        AssertLogRelRCReturn(rc, rc);
+        rc = STAMR3RegisterF(pVM, &pKvmCpu->StatKickCpu, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,
+                             "Number of KVM_HC_KICK_CPU hypercalls targeting this VCPU.", "/GIM/KVM/CPU%u/KickCpu", idCpu);
+        AssertLogRelRCReturn(rc, rc);
+    }
+
     return VINF_SUCCESS;
 }
 
@@ -248,6 +273,12 @@ VMMR3_INT_DECL(void) gimR3KvmReset(PVM pVM)
         pKvmCpu->GCPhysSystemTime = 0;
         pKvmCpu->uTsc = 0;
         pKvmCpu->uVirtNanoTS = 0;
+        pKvmCpu->u64StealTimeMsr = 0;
+        pKvmCpu->GCPhysStealTime = 0;
+        pKvmCpu->u32StealTimeVersion = 0;
+        pKvmCpu->cNsSteal = 0;
+        /* The APIC resets its PV EOI state by itself. */
+        pKvmCpu->u64PvEoiMsr = 0;
     }
 }
 
@@ -280,6 +311,11 @@ VMMR3_INT_DECL(int) gimR3KvmSave(PVM pVM, PSSMHANDLE pSSM)
         SSMR3PutGCPhys(pSSM, pKvmCpu->GCPhysSystemTime);
         SSMR3PutU32(pSSM, pKvmCpu->u32SystemTimeVersion);
         SSMR3PutU8(pSSM, pKvmCpu->fSystemTimeFlags);
+        SSMR3PutU64(pSSM, pKvmCpu->u64StealTimeMsr);
+        SSMR3PutGCPhys(pSSM, pKvmCpu->GCPhysStealTime);
+        SSMR3PutU32(pSSM, pKvmCpu->u32StealTimeVersion);
+        SSMR3PutU64(pSSM, pKvmCpu->cNsSteal);
+        SSMR3PutU64(pSSM, pKvmCpu->u64PvEoiMsr);
     }
 
     /*
@@ -305,7 +341,8 @@ VMMR3_INT_DECL(int) gimR3KvmLoad(PVM pVM, PSSMHANDLE pSSM)
     uint32_t uKvmSavedStatVersion;
     int rc = SSMR3GetU32(pSSM, &uKvmSavedStatVersion);
     AssertRCReturn(rc, rc);
-    if (uKvmSavedStatVersion != GIM_KVM_SAVED_STATE_VERSION)
+    if (   uKvmSavedStatVersion != GIM_KVM_SAVED_STATE_VERSION
+        && uKvmSavedStatVersion != GIM_KVM_SAVED_STATE_VERSION_PRE_STEAL_TIME)
         return SSMR3SetLoadError(pSSM, VERR_SSM_UNSUPPORTED_DATA_UNIT_VERSION, RT_SRC_POS,
                                  N_("Unsupported KVM saved-state version %u (expected %u)."),
                                  uKvmSavedStatVersion, GIM_KVM_SAVED_STATE_VERSION);
@@ -331,6 +368,15 @@ VMMR3_INT_DECL(int) gimR3KvmLoad(PVM pVM, PSSMHANDLE pSSM)
         SSMR3GetU32(pSSM, &pKvmCpu->u32SystemTimeVersion);
         rc = SSMR3GetU8(pSSM, &pKvmCpu->fSystemTimeFlags);
         AssertRCReturn(rc, rc);
+        if (uKvmSavedStatVersion > GIM_KVM_SAVED_STATE_VERSION_PRE_STEAL_TIME)
+        {
+            SSMR3GetU64(pSSM, &pKvmCpu->u64StealTimeMsr);
+            SSMR3GetGCPhys(pSSM, &pKvmCpu->GCPhysStealTime);
+            SSMR3GetU32(pSSM, &pKvmCpu->u32StealTimeVersion);
+            SSMR3GetU64(pSSM, &pKvmCpu->cNsSteal);
+            rc = SSMR3GetU64(pSSM, &pKvmCpu->u64PvEoiMsr);
+            AssertRCReturn(rc, rc);
+        }
 
         /* Enable the system-time struct. if necessary. */
         /** @todo update guest struct only if cTscTicksPerSecond doesn't match host
@@ -341,6 +387,11 @@ VMMR3_INT_DECL(int) gimR3KvmLoad(PVM pVM, PSSMHANDLE pSSM)
             Assert(!TMCpuTickIsTicking(pVCpu));
             gimR3KvmEnableSystemTime(pVM, pVCpu);
         }
+
+        /* Re-establish the steal-time base point, the host times don't survive restore.
+           The PV EOI state is part of the APIC saved state. */
+        if (MSR_GIM_KVM_STEAL_TIME_IS_ENABLED(pKvmCpu->u64StealTimeMsr))
+            gimR3KvmEnableStealTime(pVM, pVCpu);
     }
 
     /*
@@ -447,6 +498,160 @@ VMMR3_INT_DECL(int) gimR3KvmDisableSystemTime(PVM pVM)
 }
 
 
+/**
+ * Queries the halted and executing times of a VCPU used for estimating steal
+ * time.
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure.
+ * @param   pcNsHalted  Where to return the time (in nanoseconds) the VCPU
+ *                      spent halted.
+ * @param   pcNsCpu     Where to return the CPU time (in nanoseconds) the EMT
+ *                      has consumed on the host.
+ * @thread  EMT(pVCpu)
+ */
+static int gimR3KvmQueryStealTimeSample(PVM pVM, PVMCPU pVCpu, uint64_t *pcNsHalted, uint64_t *pcNsCpu)
+{
+    uint64_t cMsKernel;
+    uint64_t cMsUser;
+    int rc = RTThreadGetExecutionTimeMilli(&cMsKernel, &cMsUser);
+    if (RT_SUCCESS(rc))
+    {
+        uint64_t cNsTotal, cNsExecuting, cNsOther;
+        rc = TMR3GetCpuLoadTimes(pVM, pVCpu->idCpu, &cNsTotal, &cNsExecuting, pcNsHalted, &cNsOther);
+        if (RT_SUCCESS(rc))
+            *pcNsCpu = (cMsKernel + cMsUser) * RT_NS_1MS;
+    }
+    return rc;
+}
+
+
+/**
+ * Enables the KVM VCPU steal-time structure.
+ *
+ * This establishes the base point from which steal time is accounted and
+ * writes the struct. with the steal time reported so far.
+ *
+ * @returns VBox status code.
+ * @param   pVM                The cross context VM structure.
+ * @param   pVCpu              The cross context virtual CPU structure.
+ *
+ * @remarks Don't do any release assertions here, these can be triggered by
+ *          guest R0 code.
+ * @thread  EMT(pVCpu)
+ */
+VMMR3_INT_DECL(int) gimR3KvmEnableStealTime(PVM pVM, PVMCPU pVCpu)
+{
+    PGIMKVMCPU pKvmCpu = &pVCpu->gim.s.u.KvmCpu;
+
+    /*
+     * Validate the mapping address first.
+     */
+    if (!PGMPhysIsGCPhysNormal(pVM, pKvmCpu->GCPhysStealTime))
+    {
+        LogRel(("GIM: KVM: VCPU%3d: Invalid physical addr requested for mapping steal-time struct. GCPhysStealTime=%#RGp\n",
+               pVCpu->idCpu, pKvmCpu->GCPhysStealTime));
+        return VERR_GIM_OPERATION_FAILED;
+    }
+
+    /*
+     * Establish the base point.  Hosts where we cannot query the EMT CPU time
+     * simply always report the same steal time.
+     */
+    pKvmCpu->cNsStealBase       = pKvmCpu->cNsSteal;
+    pKvmCpu->uStealBaseNS       = RTTimeNanoTS();
+    pKvmCpu->uStealNextUpdateNS = pKvmCpu->uStealBaseNS + GIM_KVM_STEAL_TIME_UPDATE_INTERVAL_NS;
+    int rc = gimR3KvmQueryStealTimeSample(pVM, pVCpu, &pKvmCpu->cNsHaltedBase, &pKvmCpu->cNsCpuBase);
+    if (RT_FAILURE(rc))
+    {
+        LogRel(("GIM: KVM: VCPU%3d: Cannot query EMT execution time, steal time will not advance. rc=%Rrc\n",
+                pVCpu->idCpu, rc));
+        pKvmCpu->uStealNextUpdateNS = UINT64_MAX;
+    }
+
+    /*
+     * Update guest memory with the steal-time struct.
+     */
+    GIMKVMSTEALTIME StealTime;
+    RT_ZERO(StealTime);
+    StealTime.u32Version = pKvmCpu->u32StealTimeVersion;
+    StealTime.u64Steal   = pKvmCpu->cNsSteal;
+    Assert(!(StealTime.u32Version & UINT32_C(1)));
+    rc = PGMPhysSimpleWriteGCPhys(pVM, pKvmCpu->GCPhysStealTime, &StealTime, sizeof(StealTime));
+    if (RT_SUCCESS(rc))
+        LogRel(("GIM: KVM: VCPU%3d: Enabled steal-time struct. at %#RGp - uVersion=%#RU32 cNsSteal=%RU64\n",
+                pVCpu->idCpu, pKvmCpu->GCPhysStealTime, StealTime.u32Version, StealTime.u64Steal));
+    else
+        LogRel(("GIM: KVM: VCPU%3d: Failed to write steal-time struct. at %#RGp. rc=%Rrc\n",
+                pVCpu->idCpu, pKvmCpu->GCPhysStealTime, rc));
+    return rc;
+}
+
+
+/**
+ * Updates the KVM VCPU steal-time structure if it's enabled and due.
+ *
+ * Steal time is the wall-clock time elapsed since the base point less the time
+ * the VCPU was halted and the CPU time the EMT actually got from the host.
+ * This means time the EMT spends blocked on things other than halting (e.g.
+ * waiting for a lock or a synchronous I/O) is also reported as stolen, which
+ * is what the guest scheduler wants to know anyway.  The value reported to the
+ * guest never decreases.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure.
+ * @thread  EMT(pVCpu)
+ */
+VMMR3_INT_DECL(void) gimR3KvmUpdateStealTime(PVM pVM, PVMCPU pVCpu)
+{
+    PGIMKVMCPU pKvmCpu = &pVCpu->gim.s.u.KvmCpu;
+    if (!MSR_GIM_KVM_STEAL_TIME_IS_ENABLED(pKvmCpu->u64StealTimeMsr))
+        return;
+
+    uint64_t const uNowNS = RTTimeNanoTS();
+    if (uNowNS < pKvmCpu->uStealNextUpdateNS)
+        return;
+    pKvmCpu->uStealNextUpdateNS = uNowNS + GIM_KVM_STEAL_TIME_UPDATE_INTERVAL_NS;
+
+    uint64_t cNsHalted;
+    uint64_t cNsCpu;
+    int rc = gimR3KvmQueryStealTimeSample(pVM, pVCpu, &cNsHalted, &cNsCpu);
+    AssertRCReturnVoid(rc);
+
+    int64_t const cNsDelta = (int64_t)(uNowNS    - pKvmCpu->uStealBaseNS)
+                           - (int64_t)(cNsHalted - pKvmCpu->cNsHaltedBase)
+                           - (int64_t)(cNsCpu    - pKvmCpu->cNsCpuBase);
+    if (   cNsDelta <= 0
+        || pKvmCpu->cNsStealBase + (uint64_t)cNsDelta <= pKvmCpu->cNsSteal)
+        return;
+    pKvmCpu->cNsSteal = pKvmCpu->cNsStealBase + (uint64_t)cNsDelta;
+
+    /*
+     * Other VCPUs may be reading the struct. while we update it, so do it the
+     * way the guest expects: odd version, steal time, even version.
+     */
+    RTGCPHYS const GCPhysVersion = pKvmCpu->GCPhysStealTime + RT_UOFFSETOF(GIMKVMSTEALTIME, u32Version);
+    uint32_t       uVersion      = pKvmCpu->u32StealTimeVersion + 1;
+    rc = PGMPhysSimpleWriteGCPhys(pVM, GCPhysVersion, &uVersion, sizeof(uVersion));
+    if (RT_SUCCESS(rc))
+    {
+        rc = PGMPhysSimpleWriteGCPhys(pVM, pKvmCpu->GCPhysStealTime + RT_UOFFSETOF(GIMKVMSTEALTIME, u64Steal),
+                                      &pKvmCpu->cNsSteal, sizeof(pKvmCpu->cNsSteal));
+        pKvmCpu->u32StealTimeVersion += 2;
+        uVersion = pKvmCpu->u32StealTimeVersion;
+        int rc2 = PGMPhysSimpleWriteGCPhys(pVM, GCPhysVersion, &uVersion, sizeof(uVersion));
+        if (RT_SUCCESS(rc))
+            rc = rc2;
+    }
+    if (RT_SUCCESS(rc))
+        STAM_REL_COUNTER_INC(&pKvmCpu->StatStealTimeUpdates);
+    else
+        LogRelMax(20, ("GIM: KVM: VCPU%3d: Failed to update steal-time struct. at %#RGp. rc=%Rrc\n",
+                       pVCpu->idCpu, pKvmCpu->GCPhysStealTime, rc));
+}
+
+
 /**
  * @callback_method_impl{PFNVMMEMTRENDEZVOUS,
  *      Worker for gimR3KvmEnableWallClock}
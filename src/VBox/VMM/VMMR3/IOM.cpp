@@ -367,6 +367,8 @@ static DECLCALLBACK(int) iomR3RelocateIOPortCallback(PAVLROIOPORTNODECORE pNode,
         pRange->pfnInStrCallback    += offDelta;
     if (pRange->pvUser > _64K)
         pRange->pvUser              += offDelta;
+    if (pRange->pCritSect)
+        pRange->pCritSect           += offDelta;
     return 0;
 }
 
@@ -394,6 +396,8 @@ static DECLCALLBACK(int) iomR3RelocateMMIOCallback(PAVLROGCPHYSNODECORE pNode, v
         pRange->pfnFillCallbackRC   += offDelta;
     if (pRange->pvUserRC > _64K)
         pRange->pvUserRC            += offDelta;
+    if (pRange->pCritSectRC)
+        pRange->pCritSectRC         += offDelta;
 
     return 0;
 }
@@ -1180,6 +1184,125 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
 }
 
 
+/**
+ * Changes the critical section serializing the callbacks of I/O port ranges.
+ *
+ * By default all I/O port callbacks of a device are called while owning the
+ * device critical section.  Devices with independent register blocks (e.g. one
+ * per port or queue) can use this to give each block its own section so that
+ * accesses to different blocks no longer serialize on a single lock.
+ *
+ * This affects the R3, R0 and RC ranges within the given interval.  The
+ * ranges must have been registered by the same device and must be completely
+ * covered by the interval.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_IOM_IOPORT_RANGE_NOT_FOUND if nothing is registered there.
+ * @retval  VERR_IOM_NOT_IOPORT_RANGE_OWNER if a range belongs to someone else.
+ *
+ * @param   pVM                 The cross context VM structure.
+ * @param   pDevIns             The device instance associated with the ranges.
+ * @param   PortStart           First port number in the interval.
+ * @param   cPorts              Number of ports in the interval.
+ * @param   pCritSect           The critical section to use.  Must be allocated
+ *                              in the device instance data so it is accessible
+ *                              from all contexts the ranges are registered in.
+ *                              NULL to revert to the device critical section.
+ *
+ * @remarks Must be called while the VM isn't executing code, i.e. during
+ *          construction or from a PCI region map callback.
+ */
+VMMR3_INT_DECL(int) IOMR3IOPortSetCritSect(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT PortStart, RTUINT cPorts, PPDMCRITSECT pCritSect)
+{
+    LogFlow(("IOMR3IOPortSetCritSect: pDevIns=%p PortStart=%#x cPorts=%#x pCritSect=%p\n", pDevIns, PortStart, cPorts, pCritSect));
+
+    /*
+     * Validate input.
+     */
+    if (    (RTUINT)PortStart + cPorts <= (RTUINT)PortStart
+        ||  (RTUINT)PortStart + cPorts > 0x10000)
+    {
+        AssertMsgFailed(("Invalid port range %#x-%#x!\n", PortStart, (unsigned)PortStart + cPorts - 1));
+        return VERR_IOM_INVALID_IOPORT_RANGE;
+    }
+    AssertReturn(!pCritSect || PDMCritSectIsInitialized(pCritSect), VERR_INVALID_PARAMETER);
+
+    IOM_LOCK_EXCL(pVM);
+
+    /*
+     * Check ownership of the ring-3 ranges, they are a superset of the others.
+     */
+    RTIOPORT const PortLast = PortStart + (cPorts - 1);
+    unsigned       cRanges  = 0;
+    RTIOPORT       Port     = PortStart;
+    while (Port <= PortLast && Port >= PortStart)
+    {
+        PIOMIOPORTRANGER3 pRange = (PIOMIOPORTRANGER3)RTAvlroIOPortRangeGet(&pVM->iom.s.pTreesR3->IOPortTreeR3, Port);
+        if (pRange)
+        {
+            AssertMsgReturnStmt(pRange->pDevIns == pDevIns,
+                                ("Not owner! %#x-%#x (%s)\n", pRange->Core.Key, pRange->Core.KeyLast, pRange->pszDesc),
+                                IOM_UNLOCK_EXCL(pVM),
+                                VERR_IOM_NOT_IOPORT_RANGE_OWNER);
+            AssertMsgReturnStmt(pRange->Core.Key >= PortStart && pRange->Core.KeyLast <= PortLast,
+                                ("Incomplete range! %#x-%#x (%s)\n", pRange->Core.Key, pRange->Core.KeyLast, pRange->pszDesc),
+                                IOM_UNLOCK_EXCL(pVM),
+                                VERR_IOM_INVALID_IOPORT_RANGE);
+            cRanges++;
+            Port = pRange->Core.KeyLast;
+        }
+        Port++;
+    }
+    if (!cRanges)
+    {
+        IOM_UNLOCK_EXCL(pVM);
+        return VERR_IOM_IOPORT_RANGE_NOT_FOUND;
+    }
+
+    /*
+     * Update the ranges in all contexts.
+     */
+    Port = PortStart;
+    while (Port <= PortLast && Port >= PortStart)
+    {
+        PIOMIOPORTRANGER3 pRangeR3 = (PIOMIOPORTRANGER3)RTAvlroIOPortRangeGet(&pVM->iom.s.pTreesR3->IOPortTreeR3, Port);
+        if (pRangeR3)
+        {
+            pRangeR3->pCritSect = pCritSect;
+            Port = pRangeR3->Core.KeyLast;
+        }
+        Port++;
+    }
+
+    Port = PortStart;
+    while (Port <= PortLast && Port >= PortStart)
+    {
+        PIOMIOPORTRANGER0 pRangeR0 = (PIOMIOPORTRANGER0)RTAvlroIOPortRangeGet(&pVM->iom.s.pTreesR3->IOPortTreeR0, Port);
+        if (pRangeR0)
+        {
+            pRangeR0->pCritSect = pCritSect ? MMHyperR3ToR0(pVM, pCritSect) : NIL_RTR0PTR;
+            Port = pRangeR0->Core.KeyLast;
+        }
+        Port++;
+    }
+
+    Port = PortStart;
+    while (Port <= PortLast && Port >= PortStart)
+    {
+        PIOMIOPORTRANGERC pRangeRC = (PIOMIOPORTRANGERC)RTAvlroIOPortRangeGet(&pVM->iom.s.pTreesR3->IOPortTreeRC, Port);
+        if (pRangeRC)
+        {
+            pRangeRC->pCritSect = pCritSect ? MMHyperR3ToRC(pVM, pCritSect) : NIL_RTRCPTR;
+            Port = pRangeRC->Core.KeyLast;
+        }
+        Port++;
+    }
+
+    IOM_UNLOCK_EXCL(pVM);
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Dummy Port I/O Handler for IN operations.
  *
@@ -1652,6 +1775,99 @@ VMMR3_INT_DECL(int) IOMR3MmioDeregister(PVM pVM, PPDMDEVINS pDevIns, RTGCPHYS GC
 }
 
 
+/**
+ * Changes the critical section serializing the callbacks of MMIO ranges.
+ *
+ * This is the MMIO counterpart to IOMR3IOPortSetCritSect.  The ranges must
+ * have been registered by the same device and be completely covered by the
+ * interval.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_IOM_MMIO_RANGE_NOT_FOUND if nothing is registered there.
+ * @retval  VERR_IOM_NOT_MMIO_RANGE_OWNER if a range belongs to someone else.
+ *
+ * @param   pVM                 The cross context VM structure.
+ * @param   pDevIns             Device instance which the MMIO region is registered.
+ * @param   GCPhysStart         First physical address (GC) in the interval.
+ * @param   cbRange             Size of the interval.
+ * @param   pCritSect           The critical section to use.  Must be allocated
+ *                              in the device instance data.  NULL to revert to
+ *                              the device critical section.
+ *
+ * @remarks Must be called while the VM isn't executing code, i.e. during
+ *          construction or from a PCI region map callback.
+ */
+VMMR3_INT_DECL(int) IOMR3MmioSetCritSect(PVM pVM, PPDMDEVINS pDevIns, RTGCPHYS GCPhysStart, RTGCPHYS cbRange,
+                                         PPDMCRITSECT pCritSect)
+{
+    LogFlow(("IOMR3MmioSetCritSect: pDevIns=%p GCPhysStart=%RGp cbRange=%RGp pCritSect=%p\n",
+             pDevIns, GCPhysStart, cbRange, pCritSect));
+
+    /*
+     * Validate input.
+     */
+    RTGCPHYS const GCPhysLast = GCPhysStart + (cbRange - 1);
+    if (!cbRange || GCPhysLast < GCPhysStart)
+    {
+        AssertMsgFailed(("Wrapped! %#x LB %RGp\n", GCPhysStart, cbRange));
+        return VERR_IOM_INVALID_MMIO_RANGE;
+    }
+    AssertReturn(!pCritSect || PDMCritSectIsInitialized(pCritSect), VERR_INVALID_PARAMETER);
+    PVMCPU pVCpu = VMMGetCpu(pVM); Assert(pVCpu);
+
+    RTR0PTR const pCritSectR0 = pCritSect ? MMHyperR3ToR0(pVM, pCritSect) : NIL_RTR0PTR;
+    RTRCPTR const pCritSectRC = pCritSect ? MMHyperR3ToRC(pVM, pCritSect) : NIL_RTRCPTR;
+
+    IOM_LOCK_EXCL(pVM);
+
+    /*
+     * Check ownership and such for the entire area before changing anything.
+     */
+    RTGCPHYS GCPhys = GCPhysStart;
+    while (GCPhys <= GCPhysLast && GCPhys >= GCPhysStart)
+    {
+        PIOMMMIORANGE pRange = iomMmioGetRange(pVM, pVCpu, GCPhys);
+        if (!pRange)
+        {
+            IOM_UNLOCK_EXCL(pVM);
+            return VERR_IOM_MMIO_RANGE_NOT_FOUND;
+        }
+        AssertMsgReturnStmt(pRange->pDevInsR3 == pDevIns,
+                            ("Not owner! GCPhys=%RGp %RGp LB %RGp %s\n", GCPhys, GCPhysStart, cbRange, pRange->pszDesc),
+                            IOM_UNLOCK_EXCL(pVM),
+                            VERR_IOM_NOT_MMIO_RANGE_OWNER);
+        AssertMsgReturnStmt(pRange->Core.KeyLast <= GCPhysLast,
+                            ("Incomplete R3 range! GCPhys=%RGp %RGp LB %RGp %s\n", GCPhys, GCPhysStart, cbRange, pRange->pszDesc),
+                            IOM_UNLOCK_EXCL(pVM),
+                            VERR_IOM_INCOMPLETE_MMIO_RANGE);
+        AssertMsgReturnStmt(!pCritSect || !pRange->pDevInsR0 || pCritSectR0 != NIL_RTR0PTR,
+                            ("%s: critsect %p not accessible from ring-0\n", pRange->pszDesc, pCritSect),
+                            IOM_UNLOCK_EXCL(pVM),
+                            VERR_INVALID_PARAMETER);
+
+        /* next */
+        Assert(GCPhys <= pRange->Core.KeyLast);
+        GCPhys = pRange->Core.KeyLast + 1;
+    }
+
+    /*
+     * Update them.
+     */
+    GCPhys = GCPhysStart;
+    while (GCPhys <= GCPhysLast && GCPhys >= GCPhysStart)
+    {
+        PIOMMMIORANGE pRange = iomMmioGetRange(pVM, pVCpu, GCPhys);
+        pRange->pCritSectR3 = pCritSect;
+        pRange->pCritSectR0 = pRange->pDevInsR0 ? pCritSectR0 : NIL_RTR0PTR;
+        pRange->pCritSectRC = pRange->pDevInsRC ? pCritSectRC : NIL_RTRCPTR;
+        GCPhys = pRange->Core.KeyLast + 1;
+    }
+
+    IOM_UNLOCK_EXCL(pVM);
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Pre-Registers a MMIO region.
  *
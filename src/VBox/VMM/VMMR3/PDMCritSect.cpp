@@ -24,6 +24,8 @@
 #include <VBox/vmm/pdmcritsect.h>
 #include <VBox/vmm/pdmcritsectrw.h>
 #include <VBox/vmm/mm.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/uvm.h>
 
@@ -32,6 +34,7 @@
 #include <VBox/sup.h>
 #include <iprt/asm.h>
 #include <iprt/assert.h>
+#include <iprt/ctype.h>
 #include <iprt/lockvalidator.h>
 #include <iprt/string.h>
 #include <iprt/thread.h>
@@ -42,6 +45,7 @@
 *********************************************************************************************************************************/
 static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect, PPDMCRITSECTINT pPrev, bool fFinal);
 static int pdmR3CritSectRwDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTRWINT pCritSect, PPDMCRITSECTRWINT pPrev, bool fFinal);
+static FNDBGFHANDLERINT pdmR3CritSectInfo;
 
 
 
@@ -56,10 +60,60 @@ int pdmR3CritSectBothInitStats(PVM pVM)
     RT_NOREF_PV(pVM);
     STAM_REG(pVM, &pVM->pdm.s.StatQueuedCritSectLeaves, STAMTYPE_COUNTER, "/PDM/QueuedCritSectLeaves", STAMUNIT_OCCURENCES,
              "Number of times a critical section leave request needed to be queued for ring-3 execution.");
+    DBGFR3InfoRegisterInternal(pVM, "critsects",
+                               "Displays the critical section contention profiles (/PDM/CritSectProfiling). "
+                               "Arguments: [all] [name-pattern]",
+                               pdmR3CritSectInfo);
     return VINF_SUCCESS;
 }
 
 
+/**
+ * Allocates the contention profiling data for a critical section if
+ * profiling is enabled.
+ *
+ * @returns Pointer to the ring-3 mapping of the profiling data, NULL if not
+ *          profiling.
+ * @param   pVM         The cross context VM structure.
+ * @param   pszPrefix   The statistics prefix ("/PDM/CritSects" or
+ *                      "/PDM/CritSectsRw").
+ * @param   pszName     The critical section name.
+ */
+static PPDMCRITSECTPROF pdmR3CritSectProfCreate(PVM pVM, const char *pszPrefix, const char *pszName)
+{
+    /** @cfgm{/PDM/CritSectProfiling, bool, false}
+     * Enables the lock contention profiler for all PDM critical sections and
+     * read/write critical sections.  It records exclusive hold time histograms,
+     * contended wait times and the callers that had to wait the most.  The
+     * results are available through the 'critsects' info item and the Prof*
+     * statistics of each section. */
+    bool fEnabled = false;
+    int rc = CFGMR3QueryBoolDef(CFGMR3GetChild(CFGMR3GetRoot(pVM), "PDM"), "CritSectProfiling", &fEnabled, false);
+    AssertLogRelRC(rc);
+    if (!fEnabled)
+        return NULL;
+
+    PPDMCRITSECTPROF pProf;
+    rc = MMHyperAlloc(pVM, sizeof(*pProf), 64, MM_TAG_PDM, (void **)&pProf);
+    if (RT_FAILURE(rc))
+    {
+        LogRel(("PDM: Failed to allocate contention profiling data for '%s': %Rrc\n", pszName, rc));
+        return NULL;
+    }
+    pProf->StatHold.cTicksMin = UINT64_MAX;
+    pProf->StatWait.cTicksMin = UINT64_MAX;
+
+    STAMR3RegisterF(pVM, &pProf->StatHold, STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_OCCURENCE,
+                    "Exclusive hold time.", "%s/%s/ProfHold", pszPrefix, pszName);
+    STAMR3RegisterF(pVM, &pProf->StatWait, STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_OCCURENCE,
+                    "Contended wait time.", "%s/%s/ProfWait", pszPrefix, pszName);
+    for (unsigned i = 0; i < RT_ELEMENTS(pProf->acHoldHist); i++)
+        STAMR3RegisterF(pVM, (void *)&pProf->acHoldHist[i], STAMTYPE_U64, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                        "Exclusive holds shorter than 2^N ticks.", "%s/%s/ProfHoldHist/%02u", pszPrefix, pszName, i);
+    return pProf;
+}
+
+
 /**
  * Relocates all the critical sections.
  *
@@ -185,6 +239,8 @@ static int pdmR3CritSectInitOne(PVM pVM, PPDMCRITSECTINT pCritSect, void *pvKey,
                 pCritSect->fUsedByTimerOrSimilar     = false;
                 pCritSect->hEventToSignal            = NIL_SUPSEMEVENT;
                 pCritSect->pszName                   = pszName;
+                pCritSect->pProfR3                   = pdmR3CritSectProfCreate(pVM, "/PDM/CritSects", pszName);
+                pCritSect->pProfR0                   = pCritSect->pProfR3 ? MMHyperR3ToR0(pVM, pCritSect->pProfR3) : NIL_RTR0PTR;
 
                 STAMR3RegisterF(pVM, &pCritSect->StatContentionRZLock,  STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,          NULL, "/PDM/CritSects/%s/ContentionRZLock", pCritSect->pszName);
                 STAMR3RegisterF(pVM, &pCritSect->StatContentionRZUnlock,STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,          NULL, "/PDM/CritSects/%s/ContentionRZUnlock", pCritSect->pszName);
@@ -279,6 +335,8 @@ static int pdmR3CritSectRwInitOne(PVM pVM, PPDMCRITSECTRWINT pCritSect, void *pv
                     pCritSect->pVMRC                     = pVM->pVMRC;
                     pCritSect->pvKey                     = pvKey;
                     pCritSect->pszName                   = pszName;
+                    pCritSect->pProfR3                   = pdmR3CritSectProfCreate(pVM, "/PDM/CritSectsRw", pszName);
+                    pCritSect->pProfR0                   = pCritSect->pProfR3 ? MMHyperR3ToR0(pVM, pCritSect->pProfR3) : NIL_RTR0PTR;
 
                     STAMR3RegisterF(pVM, &pCritSect->StatContentionRZEnterExcl,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,          NULL, "/PDM/CritSectsRw/%s/ContentionRZEnterExcl", pCritSect->pszName);
                     STAMR3RegisterF(pVM, &pCritSect->StatContentionRZLeaveExcl,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,          NULL, "/PDM/CritSectsRw/%s/ContentionRZLeaveExcl", pCritSect->pszName);
@@ -533,7 +591,13 @@ static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect,
     pCritSect->pVMR0   = NIL_RTR0PTR;
     pCritSect->pVMRC   = NIL_RTRCPTR;
     if (!fFinal)
+    {
         STAMR3DeregisterF(pVM->pUVM, "/PDM/CritSects/%s/*", pCritSect->pszName);
+        if (pCritSect->pProfR3)
+            MMHyperFree(pVM, pCritSect->pProfR3);
+    }
+    pCritSect->pProfR3 = NULL;
+    pCritSect->pProfR0 = NIL_RTR0PTR;
     RTStrFree((char *)pCritSect->pszName);
     pCritSect->pszName = NULL;
     return rc;
@@ -604,7 +668,13 @@ static int pdmR3CritSectRwDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTRWINT pCritS
     pCritSect->pVMR0   = NIL_RTR0PTR;
     pCritSect->pVMRC   = NIL_RTRCPTR;
     if (!fFinal)
+    {
         STAMR3DeregisterF(pVM->pUVM, "/PDM/CritSectsRw/%s/*", pCritSect->pszName);
+        if (pCritSect->pProfR3)
+            MMHyperFree(pVM, pCritSect->pProfR3);
+    }
+    pCritSect->pProfR3 = NULL;
+    pCritSect->pProfR0 = NIL_RTR0PTR;
     RTStrFree((char *)pCritSect->pszName);
     pCritSect->pszName = NULL;
 
@@ -1076,3 +1146,112 @@ VMMR3DECL(RCPTRTYPE(PPDMCRITSECT))  PDMR3CritSectGetNopRC(PVM pVM)
     return MMHyperR3ToRC(pVM, &pVM->pdm.s.NopCritSect);
 }
 
+
+/**
+ * Displays the contention profile of one critical section.
+ *
+ * @param   pHlp        The info helpers.
+ * @param   pszType     The section type ("" or "RW ").
+ * @param   pszName     The section name.
+ * @param   pProf       The profiling data.
+ */
+static void pdmR3CritSectInfoOne(PCDBGFINFOHLP pHlp, const char *pszType, const char *pszName, PPDMCRITSECTPROF pProf)
+{
+    uint64_t const cHolds  = pProf->StatHold.cPeriods;
+    uint64_t const cWaits  = pProf->StatWait.cPeriods;
+    pHlp->pfnPrintf(pHlp, "%s%s:\n", pszType, pszName);
+    pHlp->pfnPrintf(pHlp, "    holds: %'RU64  avg %'RU64  max %'RU64 ticks\n",
+                    cHolds, cHolds ? pProf->StatHold.cTicks / cHolds : 0, pProf->StatHold.cTicksMax);
+    pHlp->pfnPrintf(pHlp, "    waits: %'RU64  avg %'RU64  max %'RU64  total %'RU64 ticks\n",
+                    cWaits, cWaits ? pProf->StatWait.cTicks / cWaits : 0, pProf->StatWait.cTicksMax, pProf->StatWait.cTicks);
+
+    /* The hold time histogram, skipping empty buckets. */
+    for (unsigned i = 0; i < RT_ELEMENTS(pProf->acHoldHist); i++)
+        if (pProf->acHoldHist[i])
+            pHlp->pfnPrintf(pHlp, "    hold %s 2^%-2u ticks: %'RU64\n",
+                            i + 1 < RT_ELEMENTS(pProf->acHoldHist) ? "< " : ">=", i + 1 < RT_ELEMENTS(pProf->acHoldHist) ? i : i - 1,
+                            pProf->acHoldHist[i]);
+
+    /* The contended callers, sorted by the time they spent waiting. */
+    uint8_t  aidxSorted[PDMCRITSECTPROF_CALLERS];
+    unsigned cCallers = 0;
+    for (unsigned i = 0; i < RT_ELEMENTS(pProf->aCallers); i++)
+        if (pProf->aCallers[i].uId)
+        {
+            unsigned j = cCallers++;
+            while (j > 0 && pProf->aCallers[aidxSorted[j - 1]].cTicksWaited < pProf->aCallers[i].cTicksWaited)
+            {
+                aidxSorted[j] = aidxSorted[j - 1];
+                j--;
+            }
+            aidxSorted[j] = (uint8_t)i;
+        }
+    for (unsigned i = 0; i < cCallers; i++)
+    {
+        PPDMCRITSECTPROFCALLER pCaller = &pProf->aCallers[aidxSorted[i]];
+        if (pCaller->pszFile)
+            pHlp->pfnPrintf(pHlp, "    %'12RU64 ticks %'8u waits  %s(%u) %s\n", pCaller->cTicksWaited, pCaller->cContentions,
+                            pCaller->pszFile, pCaller->iLine, pCaller->pszFunction ? pCaller->pszFunction : "");
+        else
+            pHlp->pfnPrintf(pHlp, "    %'12RU64 ticks %'8u waits  %RX64\n", pCaller->cTicksWaited, pCaller->cContentions,
+                            pCaller->uId);
+    }
+    if (pProf->cCallersLost)
+        pHlp->pfnPrintf(pHlp, "    (%u contentions by untracked callers)\n", pProf->cCallersLost);
+}
+
+
+/**
+ * @callback_method_impl{FNDBGFHANDLERINT,
+ *      Displays the contention profiles of the critical sections.}
+ */
+static DECLCALLBACK(void) pdmR3CritSectInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    /*
+     * Parse the arguments: 'all' includes uncontended sections, anything else
+     * is taken as a name pattern.
+     */
+    bool        fAll       = false;
+    const char *pszPattern = NULL;
+    if (pszArgs)
+    {
+        pszArgs = RTStrStripL(pszArgs);
+        if (!strncmp(pszArgs, "all", 3) && (!pszArgs[3] || RT_C_IS_SPACE(pszArgs[3])))
+        {
+            fAll = true;
+            pszArgs = RTStrStripL(pszArgs + 3);
+        }
+        if (*pszArgs)
+            pszPattern = pszArgs;
+    }
+
+    pHlp->pfnPrintf(pHlp, "TSC frequency: %'RU64 Hz\n", SUPGetCpuHzFromGip(g_pSUPGlobalInfoPage));
+
+    PUVM     pUVM      = pVM->pUVM;
+    unsigned cProfiled = 0;
+    RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+
+    for (PPDMCRITSECTINT pCur = pUVM->pdm.s.pCritSects; pCur; pCur = pCur->pNext)
+        if (   pCur->pProfR3
+            && (fAll || pCur->pProfR3->StatWait.cPeriods)
+            && (!pszPattern || RTStrSimplePatternMatch(pszPattern, pCur->pszName)))
+        {
+            pdmR3CritSectInfoOne(pHlp, "", pCur->pszName, pCur->pProfR3);
+            cProfiled++;
+        }
+
+    for (PPDMCRITSECTRWINT pCur = pUVM->pdm.s.pRwCritSects; pCur; pCur = pCur->pNext)
+        if (   pCur->pProfR3
+            && (fAll || pCur->pProfR3->StatWait.cPeriods)
+            && (!pszPattern || RTStrSimplePatternMatch(pszPattern, pCur->pszName)))
+        {
+            pdmR3CritSectInfoOne(pHlp, "RW ", pCur->pszName, pCur->pProfR3);
+            cProfiled++;
+        }
+
+    RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+
+    if (!cProfiled)
+        pHlp->pfnPrintf(pHlp, "No %scritical sections profiled.  Set /PDM/CritSectProfiling to enable.\n",
+                        fAll ? "" : "contended ");
+}
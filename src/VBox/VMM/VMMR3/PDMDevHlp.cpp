@@ -686,6 +686,37 @@ static DECLCALLBACK(int) pdmR3DevHlp_MMIOExChangeRegionNo(PPDMDEVINS pDevIns, PP
 }
 
 
+/** @interface_method_impl{PDMDEVHLPR3,pfnIOPortSetCritSect} */
+static DECLCALLBACK(int) pdmR3DevHlp_IOPortSetCritSect(PPDMDEVINS pDevIns, RTIOPORT Port, RTIOPORT cPorts, PPDMCRITSECT pCritSect)
+{
+    PDMDEV_ASSERT_DEVINS(pDevIns);
+    VM_ASSERT_EMT(pDevIns->Internal.s.pVMR3);
+    LogFlow(("pdmR3DevHlp_IOPortSetCritSect: caller='%s'/%d: Port=%#x cPorts=%#x pCritSect=%p\n",
+             pDevIns->pReg->szName, pDevIns->iInstance, Port, cPorts, pCritSect));
+
+    int rc = IOMR3IOPortSetCritSect(pDevIns->Internal.s.pVMR3, pDevIns, Port, cPorts, pCritSect);
+
+    LogFlow(("pdmR3DevHlp_IOPortSetCritSect: caller='%s'/%d: returns %Rrc\n", pDevIns->pReg->szName, pDevIns->iInstance, rc));
+    return rc;
+}
+
+
+/** @interface_method_impl{PDMDEVHLPR3,pfnMMIOSetCritSect} */
+static DECLCALLBACK(int) pdmR3DevHlp_MMIOSetCritSect(PPDMDEVINS pDevIns, RTGCPHYS GCPhysStart, RTGCPHYS cbRange,
+                                                     PPDMCRITSECT pCritSect)
+{
+    PDMDEV_ASSERT_DEVINS(pDevIns);
+    VM_ASSERT_EMT(pDevIns->Internal.s.pVMR3);
+    LogFlow(("pdmR3DevHlp_MMIOSetCritSect: caller='%s'/%d: GCPhysStart=%RGp cbRange=%RGp pCritSect=%p\n",
+             pDevIns->pReg->szName, pDevIns->iInstance, GCPhysStart, cbRange, pCritSect));
+
+    int rc = IOMR3MmioSetCritSect(pDevIns->Internal.s.pVMR3, pDevIns, GCPhysStart, cbRange, pCritSect);
+
+    LogFlow(("pdmR3DevHlp_MMIOSetCritSect: caller='%s'/%d: returns %Rrc\n", pDevIns->pReg->szName, pDevIns->iInstance, rc));
+    return rc;
+}
+
+
 /** @interface_method_impl{PDMDEVHLPR3,pfnROMRegister} */
 static DECLCALLBACK(int) pdmR3DevHlp_ROMRegister(PPDMDEVINS pDevIns, RTGCPHYS GCPhysStart, uint32_t cbRange,
                                                  const void *pvBinary, uint32_t cbBinary, uint32_t fFlags, const char *pszDesc)
@@ -1841,9 +1872,9 @@ static DECLCALLBACK(void) pdmR3DevHlp_PCISetIrq(PPDMDEVINS pDevIns, PPDMPCIDEV p
              pDevIns->pReg->szName, pDevIns->iInstance, pPciDev, pPciDev->uDevFn, iIrq, iLevel));
 
     /*
-     * Validate input.
+     * Validate input.  MSI-X capable devices pass the vector number as IRQ.
      */
-    Assert(iIrq == 0);
+    Assert(iIrq == 0 || (pPciDev->Int.s.fFlags & PCIDEV_FLAG_MSIX_CAPABLE));
     Assert((uint32_t)iLevel <= PDM_IRQ_LEVEL_FLIP_FLOP);
 
     /*
@@ -3818,8 +3849,8 @@ const PDMDEVHLPR3 g_pdmR3DevHlpTrusted =
     pdmR3DevHlp_PhysBulkGCPhys2CCPtrReadOnly,
     pdmR3DevHlp_PhysBulkReleasePageMappingLocks,
     pdmR3DevHlp_MMIOExChangeRegionNo,
-    0,
-    0,
+    pdmR3DevHlp_IOPortSetCritSect,
+    pdmR3DevHlp_MMIOSetCritSect,
     0,
     0,
     0,
@@ -4088,8 +4119,8 @@ const PDMDEVHLPR3 g_pdmR3DevHlpUnTrusted =
     pdmR3DevHlp_PhysBulkGCPhys2CCPtrReadOnly,
     pdmR3DevHlp_PhysBulkReleasePageMappingLocks,
     pdmR3DevHlp_MMIOExChangeRegionNo,
-    0,
-    0,
+    pdmR3DevHlp_IOPortSetCritSect,
+    pdmR3DevHlp_MMIOSetCritSect,
     0,
     0,
     0,
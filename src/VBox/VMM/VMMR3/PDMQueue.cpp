@@ -32,6 +32,7 @@
 
 #include <VBox/log.h>
 #include <iprt/asm.h>
+#include <iprt/asm-amd64-x86.h>
 #include <iprt/assert.h>
 #include <iprt/thread.h>
 
@@ -94,9 +95,12 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
     //pQueue->pTimer = NULL;
     pQueue->cbItem = (uint32_t)cbItem;
     pQueue->cItems = cItems;
-    //pQueue->pPendingR3 = NULL;
-    //pQueue->pPendingR0 = NULL;
-    //pQueue->pPendingRC = NULL;
+    //pQueue->fPendingLists = 0;
+    //pQueue->u32InsertSeq = 0;
+    //pQueue->u64FirstInsertTick = 0;
+    //pQueue->aPending[*].pPendingR3 = NULL;
+    //pQueue->aPending[*].pPendingR0 = NULL;
+    //pQueue->aPending[*].pPendingRC = NULL;
     pQueue->iFreeHead = cItems;
     //pQueue->iFreeTail = 0;
     PPDMQUEUEITEMCORE pItem = (PPDMQUEUEITEMCORE)((char *)pQueue + RT_ALIGN_Z(RT_UOFFSETOF_DYN(PDMQUEUE, aFreeItems[cItems + PDMQUEUE_FREE_SLACK]), 16));
@@ -178,6 +182,8 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
     STAMR3RegisterF(pVM, &pQueue->StatInsert,           STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Calls to PDMQueueInsert.",         "/PDM/Queue/%s/Insert",         pQueue->pszName);
     STAMR3RegisterF(pVM, &pQueue->StatFlush,            STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Calls to pdmR3QueueFlush.",        "/PDM/Queue/%s/Flush",          pQueue->pszName);
     STAMR3RegisterF(pVM, &pQueue->StatFlushLeftovers,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,   "Left over items after flush.",     "/PDM/Queue/%s/FlushLeftovers", pQueue->pszName);
+    STAMR3RegisterF(pVM, &pQueue->StatInsertContention, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,   "Pending list insert CAS retries.", "/PDM/Queue/%s/InsertContention", pQueue->pszName);
+    STAMR3RegisterF(pVM, &pQueue->StatFlushLatency,     STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS_PER_OCCURENCE, "Oldest insert to flush latency.", "/PDM/Queue/%s/FlushLatency", pQueue->pszName);
 #ifdef VBOX_WITH_STATISTICS
     STAMR3RegisterF(pVM, &pQueue->StatFlushPrf,         STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Profiling pdmR3QueueFlush.",       "/PDM/Queue/%s/FlushPrf",       pQueue->pszName);
     STAMR3RegisterF(pVM, (void *)&pQueue->cStatPending, STAMTYPE_U32,     STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,        "Pending items.",                   "/PDM/Queue/%s/Pending",        pQueue->pszName);
@@ -595,16 +601,17 @@ void pdmR3QueueRelocate(PVM pVM, RTGCINTPTR offDelta)
                 pQueue->pVMRC = pVM->pVMRC;
 
                 /* Pending RC items. */
-                if (pQueue->pPendingRC)
-                {
-                    pQueue->pPendingRC += offDelta;
-                    PPDMQUEUEITEMCORE pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, pQueue->pPendingRC);
-                    while (pCur->pNextRC)
+                for (unsigned iList = 0; iList < RT_ELEMENTS(pQueue->aPending); iList++)
+                    if (pQueue->aPending[iList].pPendingRC)
                     {
-                        pCur->pNextRC += offDelta;
-                        pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, pCur->pNextRC);
+                        pQueue->aPending[iList].pPendingRC += offDelta;
+                        PPDMQUEUEITEMCORE pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, pQueue->aPending[iList].pPendingRC);
+                        while (pCur->pNextRC)
+                        {
+                            pCur->pNextRC += offDelta;
+                            pCur = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pVM, pCur->pNextRC);
+                        }
                     }
-                }
 
                 /* The free items. */
                 uint32_t i = pQueue->iFreeTail;
@@ -653,9 +660,7 @@ VMMR3_INT_DECL(void) PDMR3QueueFlushAll(PVM pVM)
         ASMAtomicBitClear(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_PENDING_BIT);
 
         for (PPDMQUEUE pCur = pVM->pUVM->pdm.s.pQueuesForced; pCur; pCur = pCur->pNext)
-            if (    pCur->pPendingR3
-                ||  pCur->pPendingR0
-                ||  pCur->pPendingRC)
+            if (pCur->fPendingLists)
                 pdmR3QueueFlush(pCur);
 
         ASMAtomicBitClear(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_ACTIVE_BIT);
@@ -669,6 +674,37 @@ VMMR3_INT_DECL(void) PDMR3QueueFlushAll(PVM pVM)
 }
 
 
+/**
+ * Merges two item lists ordered by insertion sequence number.
+ *
+ * @returns The merged list.
+ * @param   pItems1     The first list (linked by pNextR3).
+ * @param   pItems2     The second list (linked by pNextR3).
+ */
+static PPDMQUEUEITEMCORE pdmR3QueueMergeItems(PPDMQUEUEITEMCORE pItems1, PPDMQUEUEITEMCORE pItems2)
+{
+    PPDMQUEUEITEMCORE  pHead  = NULL;
+    PPDMQUEUEITEMCORE *ppTail = &pHead;
+    while (pItems1 && pItems2)
+    {
+        /* The sequence number wraps around, so compare the difference. */
+        if ((int32_t)(pItems2->u32Seq - pItems1->u32Seq) < 0)
+        {
+            *ppTail = pItems2;
+            pItems2 = pItems2->pNextR3;
+        }
+        else
+        {
+            *ppTail = pItems1;
+            pItems1 = pItems1->pNextR3;
+        }
+        ppTail = &(*ppTail)->pNextR3;
+    }
+    *ppTail = pItems1 ? pItems1 : pItems2;
+    return pHead;
+}
+
+
 /**
  * Process pending items in one queue.
  *
@@ -679,55 +715,76 @@ VMMR3_INT_DECL(void) PDMR3QueueFlushAll(PVM pVM)
 static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
 {
     STAM_PROFILE_START(&pQueue->StatFlushPrf,p);
+    STAM_REL_COUNTER_INC(&pQueue->StatFlush);
 
     /*
-     * Get the lists.
+     * Grab the bitmap of non-empty pending lists before the lists themselves,
+     * so that an insert racing us will set its bit again and we'll get called
+     * again (see PDMQueueInsert).  Same goes for the first insert timestamp.
      */
-    PPDMQUEUEITEMCORE pItems   = ASMAtomicXchgPtrT(&pQueue->pPendingR3, NULL, PPDMQUEUEITEMCORE);
-    RTRCPTR           pItemsRC = ASMAtomicXchgRCPtr(&pQueue->pPendingRC, NIL_RTRCPTR);
-    RTR0PTR           pItemsR0 = ASMAtomicXchgR0Ptr(&pQueue->pPendingR0, NIL_RTR0PTR);
-
-    AssertMsgReturn(   pItemsR0
-                    || pItemsRC
-                    || pItems,
-                    ("Someone is racing us? This shouldn't happen!\n"),
-                    true);
+    uint32_t       fLists          = ASMAtomicXchgU32(&pQueue->fPendingLists, 0);
+    uint64_t const u64FirstInsert  = ASMAtomicXchgU64(&pQueue->u64FirstInsertTick, 0);
+    if (u64FirstInsert)
+        STAM_REL_PROFILE_ADD_PERIOD(&pQueue->StatFlushLatency, ASMReadTSC() - u64FirstInsert);
 
     /*
-     * Reverse the list (it's inserted in LIFO order to avoid semaphores, remember).
+     * Drain all the non-empty pending lists in one go.  Each per list and
+     * context chain is in LIFO order to avoid semaphores, so reverse it into a
+     * FIFO chain and merge that into pItems by insertion sequence number.
+     * This restores the global insertion order across virtual CPUs and
+     * contexts, which consumers like the PCI IRQ level changes rely on.
      */
-    PPDMQUEUEITEMCORE pCur = pItems;
-    pItems = NULL;
-    while (pCur)
+    PPDMQUEUEITEMCORE pItems = NULL;
+    PPDMQUEUEITEMCORE pCur;
+    for (unsigned iList = 0; iList < PDMQUEUE_PENDING_LISTS; iList++)
     {
-        PPDMQUEUEITEMCORE pInsert = pCur;
-        pCur = pCur->pNextR3;
-        pInsert->pNextR3 = pItems;
-        pItems = pInsert;
-    }
+        if (!(fLists & RT_BIT_32(iList)))
+            continue;
+        PPDMQUEUEPENDING  pPending = &pQueue->aPending[iList];
+        PPDMQUEUEITEMCORE pChain;
 
-    /*
-     * Do the same for any pending RC items.
-     */
-    while (pItemsRC)
-    {
-        PPDMQUEUEITEMCORE pInsert = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pQueue->pVMR3, pItemsRC);
-        pItemsRC = pInsert->pNextRC;
-        pInsert->pNextRC = NIL_RTRCPTR;
-        pInsert->pNextR3 = pItems;
-        pItems = pInsert;
+        pChain = NULL;
+        pCur = ASMAtomicXchgPtrT(&pPending->pPendingR3, NULL, PPDMQUEUEITEMCORE);
+        while (pCur)
+        {
+            PPDMQUEUEITEMCORE pInsert = pCur;
+            pCur = pCur->pNextR3;
+            pInsert->pNextR3 = pChain;
+            pChain = pInsert;
+        }
+        pItems = pdmR3QueueMergeItems(pItems, pChain);
+
+        pChain = NULL;
+        RTRCPTR pItemsRC = ASMAtomicXchgRCPtr(&pPending->pPendingRC, NIL_RTRCPTR);
+        while (pItemsRC)
+        {
+            PPDMQUEUEITEMCORE pInsert = (PPDMQUEUEITEMCORE)MMHyperRCToR3(pQueue->pVMR3, pItemsRC);
+            pItemsRC = pInsert->pNextRC;
+            pInsert->pNextRC = NIL_RTRCPTR;
+            pInsert->pNextR3 = pChain;
+            pChain = pInsert;
+        }
+        pItems = pdmR3QueueMergeItems(pItems, pChain);
+
+        pChain = NULL;
+        RTR0PTR pItemsR0 = ASMAtomicXchgR0Ptr(&pPending->pPendingR0, NIL_RTR0PTR);
+        while (pItemsR0)
+        {
+            PPDMQUEUEITEMCORE pInsert = (PPDMQUEUEITEMCORE)MMHyperR0ToR3(pQueue->pVMR3, pItemsR0);
+            pItemsR0 = pInsert->pNextR0;
+            pInsert->pNextR0 = NIL_RTR0PTR;
+            pInsert->pNextR3 = pChain;
+            pChain = pInsert;
+        }
+        pItems = pdmR3QueueMergeItems(pItems, pChain);
     }
 
-    /*
-     * Do the same for any pending R0 items.
-     */
-    while (pItemsR0)
+    /* An insert may have set its bit after we drained the list it pushed to
+       in a previous round, so an empty result is perfectly fine. */
+    if (!pItems)
     {
-        PPDMQUEUEITEMCORE pInsert = (PPDMQUEUEITEMCORE)MMHyperR0ToR3(pQueue->pVMR3, pItemsR0);
-        pItemsR0 = pInsert->pNextR0;
-        pInsert->pNextR0 = NIL_RTR0PTR;
-        pInsert->pNextR3 = pItems;
-        pItems = pInsert;
+        STAM_PROFILE_STOP(&pQueue->StatFlushPrf,p);
+        return true;
     }
 
     /*
@@ -804,13 +861,15 @@ static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
         }
 
         /*
-         * Insert the list at the tail of the pending list.
+         * Insert the list at the tail of the first pending list.  The items
+         * keep their sequence numbers, so they get merged back into place on
+         * the next flush.
          */
         for (;;)
         {
-            if (ASMAtomicCmpXchgPtr(&pQueue->pPendingR3, pItems, NULL))
+            if (ASMAtomicCmpXchgPtr(&pQueue->aPending[0].pPendingR3, pItems, NULL))
                 break;
-            PPDMQUEUEITEMCORE pPending = ASMAtomicXchgPtrT(&pQueue->pPendingR3, NULL, PPDMQUEUEITEMCORE);
+            PPDMQUEUEITEMCORE pPending = ASMAtomicXchgPtrT(&pQueue->aPending[0].pPendingR3, NULL, PPDMQUEUEITEMCORE);
             if (pPending)
             {
                 pCur = pPending;
@@ -820,6 +879,7 @@ static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
                 pItems = pPending;
             }
         }
+        ASMAtomicOrU32(&pQueue->fPendingLists, RT_BIT_32(0));
 
         STAM_REL_COUNTER_INC(&pQueue->StatFlushLeftovers);
         STAM_PROFILE_STOP(&pQueue->StatFlushPrf,p);
@@ -870,9 +930,7 @@ static DECLCALLBACK(void) pdmR3QueueTimer(PVM pVM, PTMTIMER pTimer, void *pvUser
     PPDMQUEUE pQueue = (PPDMQUEUE)pvUser;
     Assert(pTimer == pQueue->pTimer); NOREF(pTimer); NOREF(pVM);
 
-    if (   pQueue->pPendingR3
-        || pQueue->pPendingR0
-        || pQueue->pPendingRC)
+    if (pQueue->fPendingLists)
         pdmR3QueueFlush(pQueue);
     int rc = TMTimerSetMillies(pQueue->pTimer, pQueue->cMilliesInterval);
     AssertRC(rc);
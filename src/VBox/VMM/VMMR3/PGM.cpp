@@ -885,6 +885,22 @@ VMMR3DECL(int) PGMR3Init(PVM pVM)
     rc = CFGMR3QueryBoolDef(pCfgPGM, "ZeroRamPagesOnReset", &pVM->pgm.s.fZeroRamPagesOnReset, true);
     AssertLogRelRCReturn(rc, rc);
 
+    /** @cfgm{/PGM/LargePageRam, boolean, false}
+     * Whether to back guest RAM with 2 MB host pages wherever possible.  Large
+     * page usage itself is still subject to HM (/HM/EnableLargePages + nested
+     * paging). */
+    rc = CFGMR3QueryBoolDef(pCfgPGM, "LargePageRam", &pVM->pgm.s.fLargePageRam, false);
+    AssertLogRelRCReturn(rc, rc);
+
+    /** @cfgm{/PGM/LargePageMaxAllocFailures, uint32_t, 16}
+     * The number of large page allocation failures tolerated in LargePageRam
+     * mode before falling back to 4 KB pages for good. */
+    rc = CFGMR3QueryU32Def(pCfgPGM, "LargePageMaxAllocFailures", &pVM->pgm.s.cMaxLargePageAllocFailures,
+                           pVM->pgm.s.fLargePageRam ? 16 : 1);
+    AssertLogRelRCReturn(rc, rc);
+    if (!pVM->pgm.s.cMaxLargePageAllocFailures)
+        pVM->pgm.s.cMaxLargePageAllocFailures = 1;
+
 #ifdef VBOX_WITH_STATISTICS
     /*
      * Allocate memory for the statistics before someone tries to use them.
@@ -1226,6 +1242,22 @@ static int pgmR3InitPaging(PVM pVM)
 }
 
 
+/**
+ * @callback_method_impl{FNSTAMR3CALLBACKPRINT,
+ * Prints the percentage of allocated RAM pages mapped by active large pages.}
+ */
+static DECLCALLBACK(void) pgmR3LargePageCoveragePrint(PVM pVM, void *pvSample, char *pszBuf, size_t cchBuf)
+{
+    RT_NOREF(pvSample);
+    uint32_t const cLargePages   = pVM->pgm.s.cLargePages;
+    uint32_t const cDisabled     = RT_MIN(pVM->pgm.s.cLargePagesDisabled, cLargePages);
+    uint32_t const cPrivatePages = pVM->pgm.s.cPrivatePages;
+    uint64_t const cCovered      = (uint64_t)(cLargePages - cDisabled) * (_2M / PAGE_SIZE);
+    uint32_t const uPct          = cPrivatePages ? (uint32_t)(RT_MIN(cCovered, cPrivatePages) * 100 / cPrivatePages) : 0;
+    RTStrPrintf(pszBuf, cchBuf, "%u", uPct);
+}
+
+
 /**
  * Init statistics
  * @returns VBox status code.
@@ -1262,6 +1294,10 @@ static int pgmR3InitStats(PVM pVM)
     STAM_REL_REG(pVM, &pPGM->StatLargePageReused,                STAMTYPE_COUNTER, "/PGM/LargePage/Reused",              STAMUNIT_OCCURENCES, "The number of times we've reused a large page.");
     STAM_REL_REG(pVM, &pPGM->StatLargePageRefused,               STAMTYPE_COUNTER, "/PGM/LargePage/Refused",             STAMUNIT_OCCURENCES, "The number of times we couldn't use a large page.");
     STAM_REL_REG(pVM, &pPGM->StatLargePageRecheck,               STAMTYPE_COUNTER, "/PGM/LargePage/Recheck",             STAMUNIT_OCCURENCES, "The number of times we've rechecked a disabled large page.");
+    STAM_REL_REG(pVM, &pPGM->cLargePageAllocFailures,            STAMTYPE_U32,     "/PGM/LargePage/AllocFailures",       STAMUNIT_COUNT,     "The number of failed large page allocations.");
+    rc = STAMR3RegisterCallback(pVM, pPGM, STAMVISIBILITY_ALWAYS, STAMUNIT_PCT, NULL, pgmR3LargePageCoveragePrint,
+                                "Percentage of the allocated RAM pages mapped by active large pages.", "/PGM/LargePage/Coverage");
+    AssertRC(rc);
 
     STAM_REL_REG(pVM, &pPGM->StatShModCheck,                     STAMTYPE_PROFILE, "/PGM/ShMod/Check",                   STAMUNIT_TICKS_PER_CALL, "Profiles the shared module checking.");
 
@@ -1784,6 +1820,8 @@ VMMR3DECL(int) PGMR3InitFinalize(PVM pVM)
      */
     if (pVM->pgm.s.fRamPreAlloc)
         rc = pgmR3PhysRamPreAllocate(pVM);
+    else if (pVM->pgm.s.fLargePageRam)
+        rc = pgmR3PhysRamPreAllocateLargePages(pVM); /* The full pre-allocation above prefers large pages already. */
 
     //pgmLogState(pVM);
     LogRel(("PGM: PGMR3InitFinalize: 4 MB PSE mask %RGp\n", pVM->pgm.s.GCPhys4MBPSEMask));
@@ -2638,6 +2638,7 @@ void pgmLogState(PVM pVM)
     LOG_PGM_MEMBER("#x",            cMmio2Regions);
     LOG_PGM_MEMBER("RTbool",        fRestoreRomPagesOnReset);
     LOG_PGM_MEMBER("RTbool",        fZeroRamPagesOnReset);
+    LOG_PGM_MEMBER("RTbool",        fLargePageRam);
     LOG_PGM_MEMBER("RTbool",        fFinalizedMappings);
     LOG_PGM_MEMBER("RTbool",        fMappingsFixed);
     LOG_PGM_MEMBER("RTbool",        fMappingsFixedRestored);
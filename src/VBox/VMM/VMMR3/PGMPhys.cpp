@@ -2111,6 +2111,67 @@ int pgmR3PhysRamPreAllocate(PVM pVM)
 }
 
 
+/**
+ * Worker called by PGMR3InitFinalize if we're configured to back RAM by large
+ * pages (/PGM/LargePageRam) but not to pre-allocate all of it.
+ *
+ * Only 2 MB ranges which are entirely RAM are allocated, everything else is
+ * left to the lazy allocation on first write.  Like pgmR3PhysRamPreAllocate
+ * this runs after ROM and MMIO ranges have been registered so that ranges
+ * sharing a 2 MB region with them are not wasted.
+ *
+ * @returns VBox status code.  Allocation failures are not fatal, we just stop
+ *          trying once large pages get disabled.
+ *
+ * @param   pVM     The cross context VM structure.
+ */
+int pgmR3PhysRamPreAllocateLargePages(PVM pVM)
+{
+    Assert(pVM->pgm.s.fLargePageRam);
+#ifdef PGM_WITH_LARGE_PAGES
+    if (   !PGMIsUsingLargePages(pVM)
+        || VM_IS_NEM_ENABLED(pVM))
+    {
+        LogRel(("PGM: LargePageRam: Large pages are not in use (requires /HM/EnableLargePages and nested paging), ignored\n"));
+        return VINF_SUCCESS;
+    }
+
+    uint32_t cLargePages = 0;
+    uint64_t NanoTS = RTTimeNanoTS();
+    pgmLock(pVM);
+    for (PPGMRAMRANGE pRam = pVM->pgm.s.pRamRangesXR3; pRam && PGMIsUsingLargePages(pVM); pRam = pRam->pNextR3)
+    {
+        RTGCPHYS GCPhys = RT_ALIGN_T(pRam->GCPhys, _2M, RTGCPHYS);
+        while (   GCPhys + _2M - 1 <= pRam->GCPhysLast
+               && GCPhys + _2M - 1 > GCPhys /* overflow */
+               && PGMIsUsingLargePages(pVM))
+        {
+            PPGMPAGE pPage = &pRam->aPages[(GCPhys - pRam->GCPhys) >> PAGE_SHIFT];
+            if (   PGM_PAGE_GET_TYPE(pPage)     == PGMPAGETYPE_RAM
+                && PGM_PAGE_GET_STATE(pPage)    == PGM_PAGE_STATE_ZERO
+                && PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_DONTCARE)
+            {
+                int rc = pgmPhysAllocLargePage(pVM, GCPhys);
+                if (rc == VINF_SUCCESS)
+                    cLargePages++;
+                else if (rc != VERR_PGM_INVALID_LARGE_PAGE_RANGE)
+                    LogRel(("PGM: LargePageRam: Failed to allocate large page at %RGp (in %s): %Rrc\n", GCPhys, pRam->pszDesc, rc));
+            }
+            GCPhys += _2M;
+        }
+    }
+    pgmUnlock(pVM);
+    NanoTS = RTTimeNanoTS() - NanoTS;
+
+    LogRel(("PGM: LargePageRam: Pre-allocated %u large pages in %llu ms%s\n", cLargePages, NanoTS / RT_NS_1MS,
+            PGMIsUsingLargePages(pVM) ? "" : " (large pages got disabled)"));
+#else
+    LogRel(("PGM: LargePageRam: Not supported by this build, ignored\n"));
+#endif
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Checks shared page checksums.
  *
@@ -5392,8 +5453,10 @@ VMMR3DECL(int) PGMR3PhysAllocateLargeHandyPage(PVM pVM, RTGCPHYS GCPhys)
         if (u64TimeStampDelta > 100)
         {
             STAM_COUNTER_INC(&pVM->pgm.s.CTX_SUFF(pStats)->StatLargePageOverflow);
-            if (    ++cTimeOut > 10
-                ||  u64TimeStampDelta > 1000 /* more than one second forces an early retirement from allocating large pages. */)
+            /* Slow allocations are accepted when explicitly asked to back RAM by large pages. */
+            if (   !pVM->pgm.s.fLargePageRam
+                && (   ++cTimeOut > 10
+                    || u64TimeStampDelta > 1000 /* more than one second forces an early retirement from allocating large pages. */))
             {
                 /* If repeated attempts to allocate a large page takes more than 100 ms, then we fall back to normal 4k pages.
                  * E.g. Vista 64 tries to move memory around, which takes a huge amount of time.
@@ -51,6 +51,8 @@
 #define LOG_GROUP LOG_GROUP_STAM
 #include <VBox/vmm/stam.h>
 #include "STAMInternal.h"
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/mm.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/uvm.h>
 #include <VBox/err.h>
@@ -59,9 +61,12 @@
 
 #include <iprt/assert.h>
 #include <iprt/asm.h>
+#include <iprt/file.h>
 #include <iprt/mem.h>
 #include <iprt/stream.h>
 #include <iprt/string.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
 
 
 /*********************************************************************************************************************************
@@ -119,6 +124,31 @@ typedef struct STAMR3SNAPSHOTONE
 } STAMR3SNAPSHOTONE, *PSTAMR3SNAPSHOTONE;
 
 
+/**
+ * The binary snapshot status structure.
+ * Argument package passed to stamR3SnapshotBinOne.
+ */
+typedef struct STAMR3SNAPSHOTBIN
+{
+    /** The sample records. */
+    PSTAMBINSAMPLE  paSamples;
+    /** The number of sample records. */
+    uint32_t        cSamples;
+    /** The number of sample records allocated. */
+    uint32_t        cSamplesAlloc;
+    /** The name table, NULL if not wanted. */
+    char           *pchNames;
+    /** The size of the name table. */
+    size_t          cbNames;
+    /** The number of bytes allocated for the name table. */
+    size_t          cbNamesAlloc;
+    /** Whether to produce the name table. */
+    bool            fWithNames;
+    /** The status code. */
+    int             rc;
+} STAMR3SNAPSHOTBIN, *PSTAMR3SNAPSHOTBIN;
+
+
 /**
  * Init record for a ring-0 statistic sample.
  */
@@ -152,6 +182,7 @@ static DECLCALLBACK(void)   stamR3EnumRelLogPrintf(PSTAMR3PRINTONEARGS pvArg, co
 static DECLCALLBACK(void)   stamR3EnumPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
 static int                  stamR3SnapshotOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3SnapshotPrintf(PSTAMR3SNAPSHOTONE pThis, const char *pszFormat, ...);
+static int                  stamR3SnapshotBinOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3PrintOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3EnumOne(PSTAMDESC pDesc, void *pvArg);
 static bool                 stamR3MultiMatch(const char * const *papszExpressions, unsigned cExpressions, unsigned *piExpression, const char *pszName);
@@ -288,6 +319,20 @@ VMMR3DECL(int) STAMR3InitUVM(PUVM pUVM)
 
     RTListInit(&pUVM->stam.s.List);
 
+    /*
+     * Allocate the name hash table.
+     */
+    pUVM->stam.s.papHashTab   = (PSTAMDESC *)RTMemAllocZ(sizeof(PSTAMDESC) * STAM_HASH_TAB_INITIAL_SIZE);
+    pUVM->stam.s.cHashTab     = STAM_HASH_TAB_INITIAL_SIZE;
+    pUVM->stam.s.cHashEntries = 0;
+    pUVM->stam.s.uGeneration  = 0;
+    if (!pUVM->stam.s.papHashTab)
+    {
+        RTSemRWDestroy(pUVM->stam.s.RWSem);
+        pUVM->stam.s.RWSem = NIL_RTSEMRW;
+        return VERR_NO_MEMORY;
+    }
+
 #ifdef STAM_WITH_LOOKUP_TREE
     /*
      * Initialize the root node.
@@ -295,6 +340,8 @@ VMMR3DECL(int) STAMR3InitUVM(PUVM pUVM)
     PSTAMLOOKUP pRoot = (PSTAMLOOKUP)RTMemAlloc(sizeof(STAMLOOKUP));
     if (!pRoot)
     {
+        RTMemFree(pUVM->stam.s.papHashTab);
+        pUVM->stam.s.papHashTab = NULL;
         RTSemRWDestroy(pUVM->stam.s.RWSem);
         pUVM->stam.s.RWSem = NIL_RTSEMRW;
         return VERR_NO_MEMORY;
@@ -335,6 +382,64 @@ VMMR3DECL(int) STAMR3InitUVM(PUVM pUVM)
 }
 
 
+/**
+ * Finalizes the STAM initialization.
+ *
+ * Starts the binary telemetry export if configured.
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ */
+VMMR3_INT_DECL(int) STAMR3InitFinalize(PVM pVM)
+{
+    /*
+     * Get the export configuration.
+     */
+    PCFGMNODE pCfgExport = CFGMR3GetChild(CFGMR3GetRoot(pVM), "STAM/Export");
+
+    /** @cfgm{/STAM/Export/File, string, none}
+     * The file (or FIFO) to stream the binary telemetry to.  No export is done
+     * if not specified.  See STAMEXPORTHDR for the format. */
+    char *pszFilename = NULL;
+    int rc = CFGMR3QueryStringAllocDef(pCfgExport, "File", &pszFilename, NULL);
+    AssertLogRelRCReturn(rc, rc);
+    if (!pszFilename || !*pszFilename)
+    {
+        MMR3HeapFree(pszFilename);
+        return VINF_SUCCESS;
+    }
+
+    /** @cfgm{/STAM/Export/Pattern, string, all}
+     * The statistics pattern selecting the samples to export. */
+    char *pszPat = NULL;
+    rc = CFGMR3QueryStringAllocDef(pCfgExport, "Pattern", &pszPat, NULL);
+    AssertLogRelRC(rc);
+
+    /** @cfgm{/STAM/Export/IntervalMs, uint32_t, 1000, 1, 3600000}
+     * The sampling interval in milliseconds. */
+    uint32_t cMsInterval = 1000;
+    if (RT_SUCCESS(rc))
+        rc = CFGMR3QueryU32Def(pCfgExport, "IntervalMs", &cMsInterval, 1000);
+    AssertLogRelRC(rc);
+    if (RT_SUCCESS(rc) && (cMsInterval < 1 || cMsInterval > RT_MS_1HOUR))
+        rc = VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                        N_("Configuration error: /STAM/Export/IntervalMs=%u is out of range (1..3600000)"), cMsInterval);
+
+    /*
+     * Start it.  Failing to open the output is not fatal.
+     */
+    if (RT_SUCCESS(rc))
+    {
+        int rc2 = STAMR3ExportStart(pVM->pUVM, pszFilename, pszPat && *pszPat ? pszPat : NULL, cMsInterval);
+        NOREF(rc2);
+    }
+
+    MMR3HeapFree(pszPat);
+    MMR3HeapFree(pszFilename);
+    return rc;
+}
+
+
 /**
  * Terminates the STAM.
  *
@@ -342,6 +447,12 @@ VMMR3DECL(int) STAMR3InitUVM(PUVM pUVM)
  */
 VMMR3DECL(void) STAMR3TermUVM(PUVM pUVM)
 {
+    /*
+     * Stop the telemetry export (normally done by vmR3Destroy already).
+     */
+    if (pUVM->stam.s.pExport)
+        STAMR3ExportStop(pUVM);
+
     /*
      * Free used memory and the RWLock.
      */
@@ -359,6 +470,11 @@ VMMR3DECL(void) STAMR3TermUVM(PUVM pUVM)
     pUVM->stam.s.pRoot = NULL;
 #endif
 
+    RTMemFree(pUVM->stam.s.papHashTab);
+    pUVM->stam.s.papHashTab   = NULL;
+    pUVM->stam.s.cHashTab     = 0;
+    pUVM->stam.s.cHashEntries = 0;
+
     Assert(pUVM->stam.s.RWSem != NIL_RTSEMRW);
     RTSemRWDestroy(pUVM->stam.s.RWSem);
     pUVM->stam.s.RWSem = NIL_RTSEMRW;
@@ -637,6 +753,113 @@ VMMR3DECL(int) STAMR3RegisterRefreshV(PUVM pUVM, void *pvSample, STAMTYPE enmTyp
 }
 
 
+/**
+ * Looks up a sample descriptor by its full name in the hash table.
+ *
+ * @returns Pointer to the sample descriptor, NULL if not found.
+ * @param   pUVM        Pointer to the user mode VM structure.
+ * @param   pszName     The name to lookup.
+ * @param   uHash       The name hash (RTStrHash1).
+ *
+ * @remarks Caller must own the STAM lock (read or write).
+ */
+static PSTAMDESC stamR3HashLookup(PUVM pUVM, const char *pszName, uint32_t uHash)
+{
+    PSTAMDESC pCur = pUVM->stam.s.papHashTab[uHash & (pUVM->stam.s.cHashTab - 1)];
+    while (pCur)
+    {
+        if (   pCur->uHash == uHash
+            && !strcmp(pCur->pszName, pszName))
+            return pCur;
+        pCur = pCur->pHashNext;
+    }
+    return NULL;
+}
+
+
+/**
+ * Doubles the size of the name hash table, rehashing all entries.
+ *
+ * Failure is ignored, the table will just have longer chains.
+ *
+ * @param   pUVM        Pointer to the user mode VM structure.
+ *
+ * @remarks Caller must own the STAM lock for writing.
+ */
+static void stamR3HashGrow(PUVM pUVM)
+{
+    uint32_t const cOld      = pUVM->stam.s.cHashTab;
+    uint32_t const cNew      = cOld * 2;
+    PSTAMDESC     *papOld    = pUVM->stam.s.papHashTab;
+    PSTAMDESC     *papNew    = (PSTAMDESC *)RTMemAllocZ(sizeof(PSTAMDESC) * cNew);
+    if (!papNew)
+        return;
+
+    for (uint32_t i = 0; i < cOld; i++)
+    {
+        PSTAMDESC pCur = papOld[i];
+        while (pCur)
+        {
+            PSTAMDESC pNext = pCur->pHashNext;
+            uint32_t  idx   = pCur->uHash & (cNew - 1);
+            pCur->pHashNext = papNew[idx];
+            papNew[idx]     = pCur;
+            pCur = pNext;
+        }
+    }
+
+    pUVM->stam.s.papHashTab = papNew;
+    pUVM->stam.s.cHashTab   = cNew;
+    RTMemFree(papOld);
+}
+
+
+/**
+ * Inserts a sample descriptor into the name hash table.
+ *
+ * @param   pUVM        Pointer to the user mode VM structure.
+ * @param   pDesc       The descriptor, uHash must be set.
+ *
+ * @remarks Caller must own the STAM lock for writing.
+ */
+static void stamR3HashInsert(PUVM pUVM, PSTAMDESC pDesc)
+{
+    if (pUVM->stam.s.cHashEntries >= pUVM->stam.s.cHashTab)
+        stamR3HashGrow(pUVM);
+
+    uint32_t idx = pDesc->uHash & (pUVM->stam.s.cHashTab - 1);
+    pDesc->pHashNext = pUVM->stam.s.papHashTab[idx];
+    pUVM->stam.s.papHashTab[idx] = pDesc;
+    pUVM->stam.s.cHashEntries++;
+}
+
+
+/**
+ * Removes a sample descriptor from the name hash table.
+ *
+ * @param   pUVM        Pointer to the user mode VM structure.
+ * @param   pDesc       The descriptor.
+ *
+ * @remarks Caller must own the STAM lock for writing.
+ */
+static void stamR3HashRemove(PUVM pUVM, PSTAMDESC pDesc)
+{
+    PSTAMDESC *ppCur = &pUVM->stam.s.papHashTab[pDesc->uHash & (pUVM->stam.s.cHashTab - 1)];
+    while (*ppCur)
+    {
+        if (*ppCur == pDesc)
+        {
+            *ppCur = pDesc->pHashNext;
+            pDesc->pHashNext = NULL;
+            pUVM->stam.s.cHashEntries--;
+            return;
+        }
+        ppCur = &(*ppCur)->pHashNext;
+    }
+    AssertMsgFailed(("%s\n", pDesc->pszName));
+}
+
+
 #ifdef VBOX_STRICT
 /**
  * Divide the strings into sub-strings using '/' as delimiter
@@ -912,33 +1135,6 @@ static PSTAMDESC stamR3LookupFindNextWithDesc(PSTAMLOOKUP pLookup)
 }
 
 
-/**
- * Look up a sample descriptor by name.
- *
- * @returns Pointer to a sample descriptor.
- * @param   pRoot               The root node.
- * @param   pszName             The name to lookup.
- */
-static PSTAMDESC stamR3LookupFindDesc(PSTAMLOOKUP pRoot, const char *pszName)
-{
-    Assert(!pRoot->pParent);
-    while (*pszName++ == '/')
-    {
-        const char *pszEnd = strchr(pszName, '/');
-        uint32_t    cch    = pszEnd ? pszEnd - pszName : (uint32_t)strlen(pszName);
-        PSTAMLOOKUP pChild = stamR3LookupFindChild(pRoot, pszName, cch, NULL);
-        if (!pChild)
-            break;
-        if (!pszEnd)
-            return pChild->pDesc;
-        pszName = pszEnd;
-        pRoot   = pChild;
-    }
-
-    return NULL;
-}
-
-
 /**
  * Finds the first sample descriptor for a given lookup range.
  *
@@ -1320,9 +1516,20 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
     AssertReturn(pszName[cchName - 1] != '/', VERR_INVALID_NAME);
     AssertReturn(memchr(pszName, '\\', cchName) == NULL, VERR_INVALID_NAME);
     AssertReturn(iRefreshGrp == STAM_REFRESH_GRP_NONE || iRefreshGrp < 64, VERR_INVALID_PARAMETER);
+    uint32_t const uHash = RTStrHash1N(pszName, cchName);
 
     STAM_LOCK_WR(pUVM);
 
+    /*
+     * Quick duplicate check using the hash table before walking the tree.
+     */
+    if (stamR3HashLookup(pUVM, pszName, uHash))
+    {
+        STAM_UNLOCK_WR(pUVM);
+        AssertMsgFailed(("Duplicate sample name: %s\n", pszName));
+        return VERR_ALREADY_EXISTS;
+    }
+
     /*
      * Look up the tree location, populating the lookup tree as we walk it.
      */
@@ -1462,6 +1669,8 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
     if (pNew)
     {
         pNew->pszName       = (char *)memcpy((char *)(pNew + 1), pszName, cchName + 1);
+        pNew->uHash         = uHash;
+        pNew->pHashNext     = NULL;
         pNew->enmType       = enmType;
         pNew->enmVisibility = enmVisibility;
         if (enmType != STAMTYPE_CALLBACK)
@@ -1488,6 +1697,8 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
         pLookup->pDesc      = pNew;
         stamR3LookupIncUsage(pLookup);
 #endif
+        stamR3HashInsert(pUVM, pNew);
+        ASMAtomicIncU32(&pUVM->stam.s.uGeneration);
 
         stamR3ResetOne(pNew, pUVM->pVM);
         rc = VINF_SUCCESS;
@@ -1504,11 +1715,14 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
  * Destroys the statistics descriptor, unlinking it and freeing all resources.
  *
  * @returns VINF_SUCCESS
+ * @param   pUVM        Pointer to the user mode VM structure.
  * @param   pCur        The descriptor to destroy.
  */
-static int stamR3DestroyDesc(PSTAMDESC pCur)
+static int stamR3DestroyDesc(PUVM pUVM, PSTAMDESC pCur)
 {
     RTListNodeRemove(&pCur->ListEntry);
+    stamR3HashRemove(pUVM, pCur);
+    ASMAtomicIncU32(&pUVM->stam.s.uGeneration);
 #ifdef STAM_WITH_LOOKUP_TREE
     pCur->pLookup->pDesc = NULL; /** @todo free lookup nodes once it's working. */
     stamR3LookupDecUsage(pCur->pLookup);
@@ -1550,7 +1764,7 @@ VMMR3DECL(int)  STAMR3DeregisterByAddr(PUVM pUVM, void *pvSample)
     RTListForEachSafe(&pUVM->stam.s.List, pCur, pNext, STAMDESC, ListEntry)
     {
         if (pCur->u.pv == pvSample)
-            rc = stamR3DestroyDesc(pCur);
+            rc = stamR3DestroyDesc(pUVM, pCur);
     }
 
     STAM_UNLOCK_WR(pUVM);
@@ -1583,7 +1797,7 @@ static int stamR3DeregisterByPattern(PUVM pUVM, const char *pszPat)
             PSTAMDESC pNext = RTListNodeGetNext(&pCur->ListEntry, STAMDESC, ListEntry);
 
             if (RTStrSimplePatternMatch(pszPat, pCur->pszName))
-                rc = stamR3DestroyDesc(pCur);
+                rc = stamR3DestroyDesc(pUVM, pCur);
 
             /* advance. */
             if (pCur == pLast)
@@ -2147,6 +2361,537 @@ VMMR3DECL(int)  STAMR3SnapshotFree(PUVM pUVM, char *pszSnapshot)
 }
 
 
+/**
+ * Gets the current sample registration generation.
+ *
+ * The generation is incremented whenever a sample is registered or
+ * deregistered, so sample indexes in binary snapshots are only comparable
+ * between snapshots of the same generation.
+ *
+ * @returns The generation number, UINT32_MAX on invalid handle.
+ * @param   pUVM            The user mode VM handle.
+ */
+VMMR3DECL(uint32_t) STAMR3GetGeneration(PUVM pUVM)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, UINT32_MAX);
+    return ASMAtomicReadU32(&pUVM->stam.s.uGeneration);
+}
+
+
+/**
+ * Get a binary snapshot of the statistics.
+ *
+ * Unlike STAMR3Snapshot this does no text formatting, the STAM lock is only
+ * held while the raw sample values are copied, so it is cheap enough to be
+ * polled at high frequency.  The format is described by STAMBINSNAPSHOTHDR
+ * and STAMBINSAMPLE.  Callback samples are not included.  The visibility
+ * setting is ignored so that the sample indexes only change with the
+ * generation.
+ *
+ * @returns VBox status code.
+ * @param   pUVM            The user mode VM handle.
+ * @param   pszPat          The name matching pattern. See somewhere_where_this_is_described_in_detail.
+ *                          If NULL all samples are included.
+ * @param   uGenKnown       The generation of the name table the caller has.
+ *                          The name table is only included if the current
+ *                          generation differs.  Pass UINT32_MAX to always get it.
+ * @param   ppvSnapshot     Where to store the pointer to the snapshot data.
+ *                          The returned pointer must be freed by calling STAMR3SnapshotBinFree().
+ * @param   pcbSnapshot     Where to store the size of the snapshot data.
+ */
+VMMR3DECL(int) STAMR3SnapshotBin(PUVM pUVM, const char *pszPat, uint32_t uGenKnown, void **ppvSnapshot, size_t *pcbSnapshot)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    VM_ASSERT_VALID_EXT_RETURN(pUVM->pVM, VERR_INVALID_VM_HANDLE);
+    AssertPtrReturn(ppvSnapshot, VERR_INVALID_POINTER);
+    *ppvSnapshot = NULL;
+
+    /*
+     * Copy the samples.  If the registrations changed while we weren't
+     * holding the lock, the indexes may be inconsistent with the generation,
+     * so try again.
+     */
+    STAMR3SNAPSHOTBIN State;
+    uint32_t          uGeneration;
+    uint64_t          uNanoTS;
+    int               rc;
+    unsigned          cTries = 0;
+    for (;;)
+    {
+        RT_ZERO(State);
+        State.rc    = VINF_SUCCESS;
+        uGeneration = ASMAtomicReadU32(&pUVM->stam.s.uGeneration);
+        State.fWithNames = uGenKnown != uGeneration;
+
+        uNanoTS = RTTimeNanoTS();
+        rc = stamR3EnumU(pUVM, pszPat, true /* fUpdateRing0 */, stamR3SnapshotBinOne, &State);
+        if (RT_SUCCESS(rc))
+            rc = State.rc;
+        if (   RT_FAILURE(rc)
+            || uGeneration == ASMAtomicReadU32(&pUVM->stam.s.uGeneration)
+            || ++cTries >= 8)
+            break;
+
+        RTMemFree(State.paSamples);
+        RTMemFree(State.pchNames);
+    }
+
+    /*
+     * Assemble the snapshot.
+     */
+    if (RT_SUCCESS(rc))
+    {
+        size_t const cbSamples = State.cSamples * sizeof(STAMBINSAMPLE);
+        size_t const cbTotal   = sizeof(STAMBINSNAPSHOTHDR) + cbSamples + State.cbNames;
+        uint8_t *pbSnapshot = (uint8_t *)RTMemAlloc(cbTotal);
+        if (pbSnapshot)
+        {
+            PSTAMBINSNAPSHOTHDR pHdr = (PSTAMBINSNAPSHOTHDR)pbSnapshot;
+            pHdr->u32Magic    = STAMBINSNAPSHOT_MAGIC;
+            pHdr->uVersion    = STAMBINSNAPSHOT_VERSION;
+            pHdr->cbHdr       = sizeof(*pHdr);
+            pHdr->uGeneration = uGeneration;
+            pHdr->cSamples    = State.cSamples;
+            pHdr->uNanoTS     = uNanoTS;
+            pHdr->offNames    = State.fWithNames ? (uint32_t)(sizeof(*pHdr) + cbSamples) : 0;
+            pHdr->cbNames     = (uint32_t)State.cbNames;
+            if (cbSamples)
+                memcpy(pHdr + 1, State.paSamples, cbSamples);
+            if (State.cbNames)
+                memcpy(pbSnapshot + sizeof(*pHdr) + cbSamples, State.pchNames, State.cbNames);
+
+            *ppvSnapshot = pbSnapshot;
+            if (pcbSnapshot)
+                *pcbSnapshot = cbTotal;
+        }
+        else
+            rc = VERR_NO_MEMORY;
+    }
+
+    RTMemFree(State.paSamples);
+    RTMemFree(State.pchNames);
+    return rc;
+}
+
+
+/**
+ * stamR3EnumU callback employed by STAMR3SnapshotBin.
+ *
+ * @returns VBox status code, but it's interpreted as 0 == success / !0 == failure by enmR3Enum.
+ * @param   pDesc       The sample.
+ * @param   pvArg       The binary snapshot status structure.
+ */
+static int stamR3SnapshotBinOne(PSTAMDESC pDesc, void *pvArg)
+{
+    PSTAMR3SNAPSHOTBIN pThis = (PSTAMR3SNAPSHOTBIN)pvArg;
+    if (pDesc->enmType == STAMTYPE_CALLBACK)
+        return VINF_SUCCESS;
+
+    /*
+     * Make room.
+     */
+    if (pThis->cSamples >= pThis->cSamplesAlloc)
+    {
+        uint32_t       cNew = pThis->cSamplesAlloc ? pThis->cSamplesAlloc * 2 : 256;
+        PSTAMBINSAMPLE paNew = (PSTAMBINSAMPLE)RTMemRealloc(pThis->paSamples, cNew * sizeof(STAMBINSAMPLE));
+        if (!paNew)
+            return pThis->rc = VERR_NO_MEMORY;
+        pThis->paSamples     = paNew;
+        pThis->cSamplesAlloc = cNew;
+    }
+
+    PSTAMBINSAMPLE pSample = &pThis->paSamples[pThis->cSamples];
+    pSample->iSample     = pThis->cSamples;
+    pSample->enmType     = (uint8_t)pDesc->enmType;
+    pSample->enmUnit     = (uint8_t)pDesc->enmUnit;
+    pSample->u16Reserved = 0;
+    RT_ZERO(pSample->au64);
+
+    switch (pDesc->enmType)
+    {
+        case STAMTYPE_COUNTER:
+            pSample->au64[0] = pDesc->u.pCounter->c;
+            break;
+
+        case STAMTYPE_PROFILE:
+        case STAMTYPE_PROFILE_ADV:
+            pSample->au64[0] = pDesc->u.pProfile->cPeriods;
+            pSample->au64[1] = pDesc->u.pProfile->cTicks;
+            pSample->au64[2] = pDesc->u.pProfile->cTicksMax;
+            pSample->au64[3] = pDesc->u.pProfile->cTicksMin;
+            break;
+
+        case STAMTYPE_RATIO_U32:
+        case STAMTYPE_RATIO_U32_RESET:
+            pSample->au64[0] = pDesc->u.pRatioU32->u32A;
+            pSample->au64[1] = pDesc->u.pRatioU32->u32B;
+            break;
+
+        case STAMTYPE_U8:
+        case STAMTYPE_U8_RESET:
+        case STAMTYPE_X8:
+        case STAMTYPE_X8_RESET:
+            pSample->au64[0] = *pDesc->u.pu8;
+            break;
+
+        case STAMTYPE_U16:
+        case STAMTYPE_U16_RESET:
+        case STAMTYPE_X16:
+        case STAMTYPE_X16_RESET:
+            pSample->au64[0] = *pDesc->u.pu16;
+            break;
+
+        case STAMTYPE_U32:
+        case STAMTYPE_U32_RESET:
+        case STAMTYPE_X32:
+        case STAMTYPE_X32_RESET:
+            pSample->au64[0] = *pDesc->u.pu32;
+            break;
+
+        case STAMTYPE_U64:
+        case STAMTYPE_U64_RESET:
+        case STAMTYPE_X64:
+        case STAMTYPE_X64_RESET:
+            pSample->au64[0] = *pDesc->u.pu64;
+            break;
+
+        case STAMTYPE_BOOL:
+        case STAMTYPE_BOOL_RESET:
+            pSample->au64[0] = *pDesc->u.pf;
+            break;
+
+        default:
+            AssertMsgFailed(("enmType=%d\n", pDesc->enmType));
+            break;
+    }
+
+    /*
+     * The name table entry.
+     */
+    if (pThis->fWithNames)
+    {
+        size_t const cbName = strlen(pDesc->pszName) + 1;
+        if (pThis->cbNames + cbName > pThis->cbNamesAlloc)
+        {
+            size_t cbNew = RT_MAX(pThis->cbNamesAlloc * 2, pThis->cbNames + cbName + _4K);
+            char  *pchNew = (char *)RTMemRealloc(pThis->pchNames, cbNew);
+            if (!pchNew)
+                return pThis->rc = VERR_NO_MEMORY;
+            pThis->pchNames     = pchNew;
+            pThis->cbNamesAlloc = cbNew;
+        }
+        memcpy(&pThis->pchNames[pThis->cbNames], pDesc->pszName, cbName);
+        pThis->cbNames += cbName;
+    }
+
+    pThis->cSamples++;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Releases a binary statistics snapshot returned by STAMR3SnapshotBin().
+ *
+ * @returns VBox status code.
+ * @param   pUVM            The user mode VM handle.
+ * @param   pvSnapshot      The snapshot data pointer returned by STAMR3SnapshotBin().
+ *                          NULL is allowed.
+ */
+VMMR3DECL(int)  STAMR3SnapshotBinFree(PUVM pUVM, void *pvSnapshot)
+{
+    if (pvSnapshot)
+        RTMemFree(pvSnapshot);
+    NOREF(pUVM);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Writes a record to the export stream.
+ *
+ * @returns VBox status code.
+ * @param   pExport         The exporter instance.
+ * @param   uType           The record type (STAMEXPORTREC_XXX).
+ * @param   uGeneration     The registration generation.
+ * @param   cEntries        The number of entries in the payload.
+ * @param   uNanoTS         The sampling timestamp.
+ * @param   pvPayload       The payload.
+ * @param   cbPayload       The size of the payload.
+ */
+static int stamR3ExportWriteRecord(PSTAMEXPORT pExport, uint16_t uType, uint32_t uGeneration, uint32_t cEntries,
+                                   uint64_t uNanoTS, void const *pvPayload, size_t cbPayload)
+{
+    STAMEXPORTREC Rec;
+    Rec.uType       = uType;
+    Rec.u16Reserved = 0;
+    Rec.cbRecord    = (uint32_t)(sizeof(Rec) + cbPayload);
+    Rec.uGeneration = uGeneration;
+    Rec.cEntries    = cEntries;
+    Rec.uNanoTS     = uNanoTS;
+    int rc = RTFileWrite(pExport->hFile, &Rec, sizeof(Rec), NULL);
+    if (RT_SUCCESS(rc) && cbPayload)
+        rc = RTFileWrite(pExport->hFile, pvPayload, cbPayload, NULL);
+    if (RT_SUCCESS(rc))
+    {
+        pExport->cRecords++;
+        pExport->cbWritten += sizeof(Rec) + cbPayload;
+    }
+    return rc;
+}
+
+
+/**
+ * Takes one snapshot and writes the schema (if changed) and data records.
+ *
+ * @returns VBox status code.
+ * @param   pExport         The exporter instance.
+ */
+static int stamR3ExportOne(PSTAMEXPORT pExport)
+{
+    void  *pvSnapshot = NULL;
+    size_t cbSnapshot = 0;
+    int rc = STAMR3SnapshotBin(pExport->pUVM, pExport->pszPat, pExport->uGeneration, &pvSnapshot, &cbSnapshot);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    PCSTAMBINSNAPSHOTHDR pHdr      = (PCSTAMBINSNAPSHOTHDR)pvSnapshot;
+    PCSTAMBINSAMPLE      paSamples = (PCSTAMBINSAMPLE)(pHdr + 1);
+
+    /*
+     * Schema record if the registrations changed.  This invalidates the
+     * previous values since the indexes may have been reassigned.
+     */
+    if (pHdr->offNames)
+    {
+        rc = stamR3ExportWriteRecord(pExport, STAMEXPORTREC_SCHEMA, pHdr->uGeneration, pHdr->cSamples, pHdr->uNanoTS,
+                                     (uint8_t const *)pvSnapshot + pHdr->offNames, pHdr->cbNames);
+        pExport->uGeneration = pHdr->uGeneration;
+        pExport->cPrev       = 0;
+    }
+
+    /*
+     * Make sure the buffers are large enough.
+     */
+    if (RT_SUCCESS(rc) && pHdr->cSamples * sizeof(STAMBINSAMPLE) > pExport->cbRecAlloc)
+    {
+        size_t const   cbNew  = pHdr->cSamples * sizeof(STAMBINSAMPLE);
+        uint8_t       *pbNew  = (uint8_t *)RTMemRealloc(pExport->pbRec, cbNew);
+        if (pbNew)
+            pExport->pbRec = pbNew;
+        PSTAMBINSAMPLE paNew = (PSTAMBINSAMPLE)RTMemRealloc(pExport->paPrev, cbNew);
+        if (paNew)
+            pExport->paPrev = paNew;
+        if (pbNew && paNew)
+            pExport->cbRecAlloc = cbNew;
+        else
+            rc = VERR_NO_MEMORY;
+    }
+
+    /*
+     * Data record with the samples which changed.
+     */
+    if (RT_SUCCESS(rc))
+    {
+        PSTAMBINSAMPLE paOut    = (PSTAMBINSAMPLE)pExport->pbRec;
+        uint32_t       cChanged = 0;
+        for (uint32_t i = 0; i < pHdr->cSamples; i++)
+            if (   i >= pExport->cPrev
+                || memcmp(paSamples[i].au64, pExport->paPrev[i].au64, sizeof(paSamples[i].au64)) != 0)
+                paOut[cChanged++] = paSamples[i];
+
+        rc = stamR3ExportWriteRecord(pExport, STAMEXPORTREC_DATA, pHdr->uGeneration, cChanged, pHdr->uNanoTS,
+                                     paOut, cChanged * sizeof(STAMBINSAMPLE));
+        if (pHdr->cSamples)
+            memcpy(pExport->paPrev, paSamples, pHdr->cSamples * sizeof(STAMBINSAMPLE));
+        pExport->cPrev = pHdr->cSamples;
+    }
+
+    STAMR3SnapshotBinFree(pExport->pUVM, pvSnapshot);
+    return rc;
+}
+
+
+/**
+ * The binary telemetry export thread.
+ *
+ * @returns VINF_SUCCESS.
+ * @param   hThreadSelf     The thread handle.
+ * @param   pvUser          The exporter instance.
+ */
+static DECLCALLBACK(int) stamR3ExportThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PSTAMEXPORT pExport = (PSTAMEXPORT)pvUser;
+    RT_NOREF(hThreadSelf);
+
+    /*
+     * Open the output here as opening a FIFO blocks until a reader shows up.
+     * STAMR3ExportStop() unblocks us if nobody does (see there).
+     */
+    int rc = RTFileOpen(&pExport->hFile, pExport->pszFilename, RTFILE_O_WRITE | RTFILE_O_CREATE_REPLACE | RTFILE_O_DENY_NONE);
+    if (RT_FAILURE(rc))
+    {
+        pExport->hFile = NIL_RTFILE;
+        LogRel(("STAM: Failed to open '%s' for the telemetry export: %Rrc\n", pExport->pszFilename, rc));
+        return VINF_SUCCESS;
+    }
+    ASMAtomicWriteBool(&pExport->fOpened, true);
+    if (ASMAtomicReadBool(&pExport->fStop))
+        return VINF_SUCCESS;
+
+    STAMEXPORTHDR Hdr;
+    RTTIMESPEC    Now;
+    Hdr.u32Magic           = STAMEXPORT_MAGIC;
+    Hdr.uVersion           = STAMEXPORT_VERSION;
+    Hdr.cbHdr              = sizeof(Hdr);
+    Hdr.cMsInterval        = pExport->cMsInterval;
+    Hdr.u32Reserved        = 0;
+    Hdr.uStartNanoTS       = RTTimeNanoTS();
+    Hdr.i64StartUnixNanoTS = RTTimeSpecGetNano(RTTimeNow(&Now));
+    rc = RTFileWrite(pExport->hFile, &Hdr, sizeof(Hdr), NULL);
+    if (RT_FAILURE(rc))
+    {
+        LogRel(("STAM: Failed to write the telemetry export header to '%s': %Rrc\n", pExport->pszFilename, rc));
+        return VINF_SUCCESS;
+    }
+    pExport->cbWritten = sizeof(Hdr);
+
+    while (!ASMAtomicReadBool(&pExport->fStop))
+    {
+        rc = stamR3ExportOne(pExport);
+        if (RT_FAILURE(rc))
+        {
+            LogRel(("STAM: Telemetry export stopped after %RU64 records (%RU64 bytes): %Rrc\n",
+                    pExport->cRecords, pExport->cbWritten, rc));
+            break;
+        }
+        RTSemEventWait(pExport->hEvtStop, pExport->cMsInterval);
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Starts streaming the selected statistics to a file or FIFO in the binary
+ * telemetry format (see STAMEXPORTHDR).
+ *
+ * The exporter takes a binary snapshot every @a cMsInterval milliseconds on a
+ * dedicated thread and only writes the samples which changed, so it is cheap
+ * enough to run continuously.  Use the VBoxStamReader tool to decode the
+ * stream.
+ *
+ * The output is opened by the export thread, so a FIFO without a reader does
+ * not block the caller.  Failing to open or write the output is only logged.
+ *
+ * @returns VBox status code.
+ * @retval  VERR_ALREADY_EXISTS if an export is already active.
+ * @param   pUVM            The user mode VM handle.
+ * @param   pszFilename     The output file or FIFO.
+ * @param   pszPat          The name matching pattern. See somewhere_where_this_is_described_in_detail.
+ *                          If NULL all samples are exported.
+ * @param   cMsInterval     The sampling interval in milliseconds.
+ */
+VMMR3DECL(int) STAMR3ExportStart(PUVM pUVM, const char *pszFilename, const char *pszPat, uint32_t cMsInterval)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    VM_ASSERT_VALID_EXT_RETURN(pUVM->pVM, VERR_INVALID_VM_HANDLE);
+    AssertPtrReturn(pszFilename, VERR_INVALID_POINTER);
+    AssertPtrNullReturn(pszPat, VERR_INVALID_POINTER);
+    AssertReturn(cMsInterval >= 1 && cMsInterval <= RT_MS_1HOUR, VERR_OUT_OF_RANGE);
+    if (pUVM->stam.s.pExport)
+        return VERR_ALREADY_EXISTS;
+
+    PSTAMEXPORT pExport = (PSTAMEXPORT)RTMemAllocZ(sizeof(*pExport));
+    if (!pExport)
+        return VERR_NO_MEMORY;
+    pExport->pUVM        = pUVM;
+    pExport->hThread     = NIL_RTTHREAD;
+    pExport->hEvtStop    = NIL_RTSEMEVENT;
+    pExport->hFile       = NIL_RTFILE;
+    pExport->cMsInterval = cMsInterval;
+    pExport->uGeneration = UINT32_MAX;
+
+    int rc = VINF_SUCCESS;
+    pExport->pszFilename = RTStrDup(pszFilename);
+    if (!pExport->pszFilename)
+        rc = VERR_NO_STR_MEMORY;
+    if (pszPat && RT_SUCCESS(rc))
+    {
+        pExport->pszPat = RTStrDup(pszPat);
+        if (!pExport->pszPat)
+            rc = VERR_NO_STR_MEMORY;
+    }
+    if (RT_SUCCESS(rc))
+        rc = RTSemEventCreate(&pExport->hEvtStop);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTThreadCreate(&pExport->hThread, stamR3ExportThread, pExport, 0, RTTHREADTYPE_DEFAULT,
+                            RTTHREADFLAGS_WAITABLE, "StamExport");
+        if (RT_SUCCESS(rc))
+        {
+            pUVM->stam.s.pExport = pExport;
+            LogRel(("STAM: Exporting '%s' to '%s' every %u ms\n", pszPat ? pszPat : "*", pszFilename, cMsInterval));
+            return VINF_SUCCESS;
+        }
+    }
+
+    LogRel(("STAM: Failed to start telemetry export to '%s': %Rrc\n", pszFilename, rc));
+    RTSemEventDestroy(pExport->hEvtStop);
+    RTStrFree(pExport->pszPat);
+    RTStrFree(pExport->pszFilename);
+    RTMemFree(pExport);
+    return rc;
+}
+
+
+/**
+ * Stops the binary telemetry export started by STAMR3ExportStart().
+ *
+ * @returns VBox status code.
+ * @retval  VWRN_NOT_FOUND if no export is active.
+ * @param   pUVM            The user mode VM handle.
+ */
+VMMR3DECL(int) STAMR3ExportStop(PUVM pUVM)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    PSTAMEXPORT pExport = pUVM->stam.s.pExport;
+    if (!pExport)
+        return VWRN_NOT_FOUND;
+    pUVM->stam.s.pExport = NULL;
+
+    ASMAtomicWriteBool(&pExport->fStop, true);
+    RTSemEventSignal(pExport->hEvtStop);
+
+    /*
+     * If the thread is still waiting for a FIFO reader to show up, briefly
+     * become that reader so its open returns and it sees fStop.
+     */
+    RTFILE hFileRead = NIL_RTFILE;
+    if (!ASMAtomicReadBool(&pExport->fOpened))
+    {
+        int rc2 = RTFileOpen(&hFileRead, pExport->pszFilename,
+                             RTFILE_O_READ | RTFILE_O_OPEN | RTFILE_O_DENY_NONE | RTFILE_O_NON_BLOCK);
+        if (RT_FAILURE(rc2))
+            hFileRead = NIL_RTFILE;
+    }
+
+    int rc = RTThreadWait(pExport->hThread, 30000, NULL);
+    AssertRC(rc);
+    if (hFileRead != NIL_RTFILE)
+        RTFileClose(hFileRead);
+
+    LogRel(("STAM: Telemetry export done, %RU64 records (%RU64 bytes)\n", pExport->cRecords, pExport->cbWritten));
+    if (pExport->hFile != NIL_RTFILE)
+        RTFileClose(pExport->hFile);
+    RTSemEventDestroy(pExport->hEvtStop);
+    RTStrFree(pExport->pszFilename);
+    RTStrFree(pExport->pszPat);
+    RTMemFree(pExport->paPrev);
+    RTMemFree(pExport->pbRec);
+    RTMemFree(pExport);
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Dumps the selected statistics to the log.
  *
@@ -2696,10 +3441,9 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
     else if (!strchr(pszPat, '|'))
     {
         STAM_LOCK_RD(pUVM);
-#ifdef STAM_WITH_LOOKUP_TREE
         if (!stamR3IsPattern(pszPat))
         {
-            pCur = stamR3LookupFindDesc(pUVM->stam.s.pRoot, pszPat);
+            pCur = stamR3HashLookup(pUVM, pszPat, RTStrHash1(pszPat));
             if (pCur)
             {
                 if (fUpdateRing0)
@@ -2709,6 +3453,7 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
         }
         else
         {
+#ifdef STAM_WITH_LOOKUP_TREE
             PSTAMDESC pLast;
             pCur = stamR3LookupFindPatternDescRange(pUVM->stam.s.pRoot, &pUVM->stam.s.List, pszPat, &pLast);
             if (pCur)
@@ -2731,21 +3476,20 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
             }
             else
                 Assert(!pLast);
-
-        }
 #else
-        RTListForEach(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
-        {
-            if (RTStrSimplePatternMatch(pszPat, pCur->pszName))
+            RTListForEach(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
             {
-                if (fUpdateRing0)
-                    stamR3Refresh(pUVM, pCur, &bmRefreshedGroups);
-                rc = pfnCallback(pCur, pvArg);
-                if (rc)
-                    break;
+                if (RTStrSimplePatternMatch(pszPat, pCur->pszName))
+                {
+                    if (fUpdateRing0)
+                        stamR3Refresh(pUVM, pCur, &bmRefreshedGroups);
+                    rc = pfnCallback(pCur, pvArg);
+                    if (rc)
+                        break;
+                }
             }
-        }
 #endif
+        }
         STAM_UNLOCK_RD(pUVM);
     }
 
@@ -2192,6 +2192,22 @@ VMMR3DECL(void) TMR3TimerQueuesDo(PVM pVM)
 //RT_C_DECLS_END
 
 
+/**
+ * Records a completed timer callback with the DBGF event tracer.
+ *
+ * @param   pVM             The cross context VM structure.
+ * @param   pTimer          The timer (only the address is recorded).
+ * @param   enmClock        The timer clock.
+ * @param   uStartNs        The RTTimeNanoTS value from before the callout.
+ */
+static void tmR3TimerEvtTrace(PVM pVM, PTMTIMER pTimer, TMCLOCK enmClock, uint64_t uStartNs)
+{
+    PVMCPU pVCpu = VMMGetCpu(pVM);
+    if (pVCpu)
+        DBGFEvtTraceAdd(pVCpu, DBGFEVTTRACETYPE_TIMER, (uint16_t)enmClock, 0, (uintptr_t)pTimer, RTTimeNanoTS() - uStartNs);
+}
+
+
 /**
  * Schedules and runs any pending times in the specified queue.
  *
@@ -2251,6 +2267,8 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
 
             /* fire */
             TM_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_DELIVER);
+            uint64_t const uEvtTraceStartNs = DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_TIMER) ? RTTimeNanoTS() : 0;
+            TMCLOCK const  enmClock         = pTimer->enmClock;
             switch (pTimer->enmType)
             {
                 case TMTIMERTYPE_DEV:       pTimer->u.Dev.pfnTimer(pTimer->u.Dev.pDevIns, pTimer, pTimer->pvUser); break;
@@ -2262,6 +2280,8 @@ static void tmR3TimerQueueRun(PVM pVM, PTMTIMERQUEUE pQueue)
                     AssertMsgFailed(("Invalid timer type %d (%s)\n", pTimer->enmType, pTimer->pszDesc));
                     break;
             }
+            if (uEvtTraceStartNs)
+                tmR3TimerEvtTrace(pVM, pTimer, enmClock, uEvtTraceStartNs);
 
             /* change the state if it wasn't changed already in the handler. */
             TM_TRY_SET_STATE(pTimer, TMTIMERSTATE_STOPPED, TMTIMERSTATE_EXPIRED_DELIVER, fRc);
@@ -2430,6 +2450,8 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
         /* Unlink it, change the state and do the callout. */
         tmTimerQueueUnlinkActive(pQueue, pTimer);
         TM_SET_STATE(pTimer, TMTIMERSTATE_EXPIRED_DELIVER);
+        uint64_t const uEvtTraceStartNs = DBGF_IS_EVT_TRACE_ENABLED(pVM, DBGFEVTTRACE_F_TIMER) ? RTTimeNanoTS() : 0;
+        TMCLOCK const  enmClock         = pTimer->enmClock;
         switch (pTimer->enmType)
         {
             case TMTIMERTYPE_DEV:       pTimer->u.Dev.pfnTimer(pTimer->u.Dev.pDevIns, pTimer, pTimer->pvUser); break;
@@ -2441,6 +2463,8 @@ static void tmR3TimerQueueRunVirtualSync(PVM pVM)
                 AssertMsgFailed(("Invalid timer type %d (%s)\n", pTimer->enmType, pTimer->pszDesc));
                 break;
         }
+        if (uEvtTraceStartNs)
+            tmR3TimerEvtTrace(pVM, pTimer, enmClock, uEvtTraceStartNs);
 
         /* Change the state if it wasn't changed already in the handler.
            Reset the Hz hint too since this is the same as TMTimerStop. */
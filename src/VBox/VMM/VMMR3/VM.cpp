@@ -86,7 +86,9 @@
 #include <iprt/assert.h>
 #include <iprt/alloc.h>
 #include <iprt/asm.h>
+#include <iprt/cpuset.h>
 #include <iprt/env.h>
+#include <iprt/mp.h>
 #include <iprt/string.h>
 #include <iprt/time.h>
 #include <iprt/semaphore.h>
@@ -841,6 +843,88 @@ static DECLCALLBACK(int) vmR3RegisterEMT(PVM pVM, VMCPUID idCpu)
 }
 
 
+/**
+ * Binds the calling EMT to the CPUs of a host NUMA node.
+ *
+ * This keeps the VCPU on the CPUs of the node.  Guest RAM is not placed per
+ * node, so the guest is only told about the VCPU distribution (see DevACPI).
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ * @param   idCpu       The Virtual CPU ID.
+ * @param   idHostNode  The host NUMA node.
+ */
+static DECLCALLBACK(int) vmR3NumaBindEMT(PVM pVM, VMCPUID idCpu, uint32_t idHostNode)
+{
+    Assert(VMMGetCpuId(pVM) == idCpu);
+
+    RTCPUSET CpuSet;
+    if (!RTMpGetNodeOnlineSet(idHostNode, &CpuSet))
+        return VMSetError(pVM, VERR_CPU_NOT_FOUND, RT_SRC_POS,
+                          N_("Host NUMA node %u does not exist or has no online CPUs (VCPU %u)"), idHostNode, idCpu);
+
+    int rc = RTThreadSetAffinity(&CpuSet);
+    if (RT_SUCCESS(rc))
+        LogRel(("VM: Bound EMT #%u to host NUMA node %u (%u CPUs)\n", idCpu, idHostNode, RTCpuSetCount(&CpuSet)));
+    else
+        LogRel(("VM: Failed to bind EMT #%u to host NUMA node %u: %Rrc (ignored)\n", idCpu, idHostNode, rc));
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Reads the NUMA configuration and binds the EMTs accordingly.
+ *
+ * The VCPUs are distributed evenly between the virtual NUMA nodes, VCPU N
+ * belonging to node N * cNodes / cCpus.  DevACPI uses the same distribution
+ * when describing the topology to the guest.
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ */
+static int vmR3NumaConfig(PVM pVM)
+{
+    PCFGMNODE pNumaNode = CFGMR3GetChild(CFGMR3GetRoot(pVM), "NUMA");
+
+    /** @cfgm{/NUMA/GuestNodes, uint32_t, 1, min(cCpus, VMM_MAX_NUMA_NODES), 1}
+     * Number of virtual NUMA nodes presented to the guest.  The VCPUs are split
+     * evenly between them (see DevACPI SRAT/SLIT). */
+    uint32_t cGuestNodes;
+    int rc = CFGMR3QueryU32Def(pNumaNode, "GuestNodes", &cGuestNodes, 1);
+    AssertLogRelRCReturn(rc, rc);
+    uint32_t const cMaxGuestNodes = RT_MIN(pVM->cCpus, VMM_MAX_NUMA_NODES);
+    if (cGuestNodes < 1 || cGuestNodes > cMaxGuestNodes)
+        return VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                          N_("Configuration error: /NUMA/GuestNodes=%u is out of range (1..%u)"), cGuestNodes, cMaxGuestNodes);
+
+    /** @cfgm{/NUMA/HostNode, uint32_t, none}
+     * The host NUMA node to bind all EMTs to. */
+    uint32_t idHostNodeDef;
+    rc = CFGMR3QueryU32Def(pNumaNode, "HostNode", &idHostNodeDef, UINT32_MAX);
+    AssertLogRelRCReturn(rc, rc);
+
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        uint32_t const idGuestNode = idCpu * cGuestNodes / pVM->cCpus;
+
+        /** @cfgm{/NUMA/Node\<n\>/HostNode, uint32_t, /NUMA/HostNode}
+         * The host NUMA node to bind the EMTs of virtual node n to. */
+        uint32_t idHostNode;
+        rc = CFGMR3QueryU32Def(CFGMR3GetChildF(pNumaNode, "Node%u", idGuestNode), "HostNode", &idHostNode, idHostNodeDef);
+        AssertLogRelRCReturn(rc, rc);
+        if (idHostNode != UINT32_MAX)
+        {
+            rc = VMR3ReqCallWait(pVM, idCpu, (PFNRT)vmR3NumaBindEMT, 3, pVM, idCpu, idHostNode);
+            if (RT_FAILURE(rc))
+                return rc;
+        }
+    }
+    if (cGuestNodes > 1)
+        LogRel(("VM: %u virtual NUMA nodes\n", cGuestNodes));
+    return VINF_SUCCESS;
+}
+
+
 /**
  * Initializes all R3 components of the VM
  */
@@ -858,6 +942,14 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
             return rc;
     }
 
+    /*
+     * Place the EMTs on the configured host NUMA nodes before anything
+     * sizable gets allocated.
+     */
+    rc = vmR3NumaConfig(pVM);
+    if (RT_FAILURE(rc))
+        return rc;
+
     /*
      * Register statistics.
      */
@@ -890,6 +982,16 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
         AssertRC(rc);
         rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltTimers,          STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_NS_PER_CALL, "Profiling halted state timer tasks.", "/PROF/CPU%d/VM/Halt/Timers", idCpu);
         AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollHit,         STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Time polled when polling caught the wake-up.", "/PROF/CPU%d/VM/Halt/PollHit", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollMiss,        STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Time polled in vain before blocking.", "/PROF/CPU%d/VM/Halt/PollMiss", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltWakeLatency,     STAMTYPE_PROFILE, STAMVISIBILITY_USED,   STAMUNIT_NS_PER_CALL, "Time from wake-up notification till the EMT resumed.", "/PROF/CPU%d/VM/Halt/WakeLatency", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollGrow,        STAMTYPE_COUNTER, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,  "Number of times the poll window was grown.", "/VM/CPU%d/Halt/PollGrow", idCpu);
+        AssertRC(rc);
+        rc = STAMR3RegisterF(pVM, &pUVM->aCpus[idCpu].vm.s.StatHaltPollShrink,      STAMTYPE_COUNTER, STAMVISIBILITY_USED,   STAMUNIT_OCCURENCES,  "Number of times the poll window was shrunk.", "/VM/CPU%d/Halt/PollShrink", idCpu);
+        AssertRC(rc);
     }
 
     STAM_REG(pVM, &pUVM->vm.s.StatReqAllocNew,   STAMTYPE_COUNTER,     "/VM/Req/AllocNew",       STAMUNIT_OCCURENCES,        "Number of VMR3ReqAlloc returning a new packet.");
@@ -900,6 +1002,11 @@ static int vmR3InitRing3(PVM pVM, PUVM pUVM)
     STAM_REG(pVM, &pUVM->vm.s.StatReqProcessed,  STAMTYPE_COUNTER,     "/VM/Req/Processed",      STAMUNIT_OCCURENCES,        "Number of processed requests (any queue).");
     STAM_REG(pVM, &pUVM->vm.s.StatReqMoreThan1,  STAMTYPE_COUNTER,     "/VM/Req/MoreThan1",      STAMUNIT_OCCURENCES,        "Number of times there are more than one request on the queue when processing it.");
     STAM_REG(pVM, &pUVM->vm.s.StatReqPushBackRaces, STAMTYPE_COUNTER,  "/VM/Req/PushBackRaces",  STAMUNIT_OCCURENCES,        "Number of push back races.");
+    STAM_REG(pVM, &pUVM->vm.s.StatReqBatches,    STAMTYPE_COUNTER,     "/VM/Req/Batches",        STAMUNIT_OCCURENCES,        "Number of request batches queued by VMR3ReqQueueBatch.");
+    STAM_REG(pVM, &pUVM->vm.s.StatReqBatchedReqs, STAMTYPE_COUNTER,    "/VM/Req/BatchedReqs",    STAMUNIT_OCCURENCES,        "Number of requests queued as part of a batch.");
+    STAM_REG(pVM, &pUVM->vm.s.StatReqWaitSpinHits, STAMTYPE_COUNTER,   "/VM/Req/WaitSpinHits",   STAMUNIT_OCCURENCES,        "Number of waits satisfied while spinning, without blocking.");
+    STAM_REG(pVM, &pUVM->vm.s.StatReqWaitBlocked, STAMTYPE_COUNTER,    "/VM/Req/WaitBlocked",    STAMUNIT_OCCURENCES,        "Number of waits that had to block on the event semaphore.");
+    STAM_REG(pVM, &pUVM->vm.s.StatReqSignalSkipped, STAMTYPE_COUNTER,  "/VM/Req/SignalSkipped",  STAMUNIT_OCCURENCES,        "Number of completions not requiring the event semaphore to be signalled.");
 
     /*
      * Init all R3 components, the order here might be important.
@@ -1179,6 +1286,8 @@ static int vmR3InitDoCompleted(PVM pVM, VMINITCOMPLETED enmWhat)
     }
     if (RT_SUCCESS(rc))
         rc = PDMR3InitCompleted(pVM, enmWhat);
+    if (RT_SUCCESS(rc) && enmWhat == VMINITCOMPLETED_RING3)
+        rc = STAMR3InitFinalize(pVM);
     return rc;
 }
 
@@ -2433,6 +2542,7 @@ DECLCALLBACK(int) vmR3Destroy(PVM pVM)
         STAMR3DumpToReleaseLog(pUVM, "*");
         LogRel(("********************* End of statistics **********************\n"));
 //#endif
+        STAMR3ExportStop(pUVM);
 
         /*
          * Destroy the VM components.
@@ -325,6 +325,7 @@ static const char *vmR3GetHaltMethodName(VMHALTMETHOD enmMethod)
         case VMHALTMETHOD_1:            return "method1";
         //case VMHALTMETHOD_2:            return "method2";
         case VMHALTMETHOD_GLOBAL_1:     return "global1";
+        case VMHALTMETHOD_ADAPTIVE_POLL: return "adaptivepoll";
         default:                        return "unknown";
     }
 }
@@ -889,6 +890,203 @@ static DECLCALLBACK(void) vmR3HaltGlobal1NotifyCpuFF(PUVMCPU pUVCpu, uint32_t fF
 }
 
 
+/**
+ * Initialize the adaptive poll halt method.
+ *
+ * @return VBox status code.
+ * @param   pUVM            Pointer to the user mode VM structure.
+ */
+static DECLCALLBACK(int) vmR3HaltAdaptivePollInit(PUVM pUVM)
+{
+    /*
+     * The blocking part is done by the global 1 method.
+     */
+    int rc = vmR3HaltGlobal1Init(pUVM);
+    AssertRCReturn(rc, rc);
+
+    /*
+     * The defaults (the same as KVM's halt_poll_ns defaults).
+     */
+    pUVM->vm.s.AdaptivePoll.cNsMaxPollCfg     = 200000;
+    pUVM->vm.s.AdaptivePoll.cNsGrowStartCfg   = 10000;
+    pUVM->vm.s.AdaptivePoll.uGrowFactorCfg    = 2;
+    pUVM->vm.s.AdaptivePoll.uShrinkDivisorCfg = 0;
+
+    /*
+     * Query overrides.
+     */
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetRoot(pUVM->pVM), "/VMM/HaltedAdaptivePoll");
+    if (pCfg)
+    {
+        /** @cfgm{/VMM/HaltedAdaptivePoll/MaxPollNs, uint32_t, 200000, 0, 10000000}
+         * The max time in nanoseconds to poll before blocking.  0 disables polling. */
+        rc = CFGMR3QueryU32Def(pCfg, "MaxPollNs", &pUVM->vm.s.AdaptivePoll.cNsMaxPollCfg, 200000);
+        AssertLogRelRCReturn(rc, rc);
+        AssertLogRelMsgReturn(pUVM->vm.s.AdaptivePoll.cNsMaxPollCfg <= 10000000,
+                              ("MaxPollNs=%u\n", pUVM->vm.s.AdaptivePoll.cNsMaxPollCfg), VERR_OUT_OF_RANGE);
+
+        /** @cfgm{/VMM/HaltedAdaptivePoll/GrowStartNs, uint32_t, 10000, 1, MaxPollNs}
+         * The poll window to start with when growing from zero. */
+        rc = CFGMR3QueryU32Def(pCfg, "GrowStartNs", &pUVM->vm.s.AdaptivePoll.cNsGrowStartCfg, 10000);
+        AssertLogRelRCReturn(rc, rc);
+        if (!pUVM->vm.s.AdaptivePoll.cNsGrowStartCfg)
+            pUVM->vm.s.AdaptivePoll.cNsGrowStartCfg = 1;
+
+        /** @cfgm{/VMM/HaltedAdaptivePoll/GrowFactor, uint32_t, 2, 1, 16}
+         * The factor to grow the poll window by. */
+        rc = CFGMR3QueryU32Def(pCfg, "GrowFactor", &pUVM->vm.s.AdaptivePoll.uGrowFactorCfg, 2);
+        AssertLogRelRCReturn(rc, rc);
+        AssertLogRelMsgReturn(pUVM->vm.s.AdaptivePoll.uGrowFactorCfg >= 1 && pUVM->vm.s.AdaptivePoll.uGrowFactorCfg <= 16,
+                              ("GrowFactor=%u\n", pUVM->vm.s.AdaptivePoll.uGrowFactorCfg), VERR_OUT_OF_RANGE);
+
+        /** @cfgm{/VMM/HaltedAdaptivePoll/ShrinkDivisor, uint32_t, 0, 0, 16}
+         * The divisor to shrink the poll window by, 0 resets it to zero. */
+        rc = CFGMR3QueryU32Def(pCfg, "ShrinkDivisor", &pUVM->vm.s.AdaptivePoll.uShrinkDivisorCfg, 0);
+        AssertLogRelRCReturn(rc, rc);
+        AssertLogRelMsgReturn(pUVM->vm.s.AdaptivePoll.uShrinkDivisorCfg <= 16,
+                              ("ShrinkDivisor=%u\n", pUVM->vm.s.AdaptivePoll.uShrinkDivisorCfg), VERR_OUT_OF_RANGE);
+    }
+    LogRel(("VMEmt: HaltedAdaptivePoll config: cNsMaxPollCfg=%u cNsGrowStartCfg=%u uGrowFactorCfg=%u uShrinkDivisorCfg=%u\n",
+            pUVM->vm.s.AdaptivePoll.cNsMaxPollCfg, pUVM->vm.s.AdaptivePoll.cNsGrowStartCfg,
+            pUVM->vm.s.AdaptivePoll.uGrowFactorCfg, pUVM->vm.s.AdaptivePoll.uShrinkDivisorCfg));
+
+    for (VMCPUID idCpu = 0; idCpu < pUVM->cCpus; idCpu++)
+        pUVM->aCpus[idCpu].vm.s.Halt.AdaptivePoll.cNsPollWindow = 0;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * The adaptive poll halt method - Poll for pending work for a while before
+ * blocking in ring-0 like the global 1 method.
+ *
+ * The poll window is tuned per virtual CPU: it grows when the halt ended
+ * within the max window but after the current one expired (we blocked for
+ * nothing), and shrinks when the halt lasted longer than the max window
+ * (polling was wasted).
+ */
+static DECLCALLBACK(int) vmR3HaltAdaptivePollHalt(PUVMCPU pUVCpu, const uint32_t fMask, uint64_t u64Now)
+{
+    PUVM    pUVM  = pUVCpu->pUVM;
+    PVMCPU  pVCpu = pUVCpu->pVCpu;
+    PVM     pVM   = pUVCpu->pVM;
+    Assert(VMMGetCpu(pVM) == pVCpu);
+
+    uint32_t const cNsPollWindow = pUVCpu->vm.s.Halt.AdaptivePoll.cNsPollWindow;
+    uint64_t const u64Start      = RTTimeNanoTS();
+    ASMAtomicWriteU64(&pUVCpu->vm.s.Halt.AdaptivePoll.u64WakeTS, 0);
+
+    /*
+     * Poll loop.
+     */
+    int  rc       = VINF_SUCCESS;
+    bool fPollHit = false;
+    if (cNsPollWindow)
+    {
+        ASMAtomicWriteBool(&pUVCpu->vm.s.Halt.AdaptivePoll.fPolling, true);
+        for (;;)
+        {
+            if (    VM_FF_IS_ANY_SET(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+                ||  VMCPU_FF_IS_ANY_SET(pVCpu, fMask))
+            {
+                fPollHit = true;
+                break;
+            }
+
+            /* Run the timers when one is due, this may set FFs. */
+            uint64_t u64Delta;
+            TMTimerPollGIP(pVM, pVCpu, &u64Delta);
+            if (!u64Delta)
+            {
+                uint64_t const u64StartTimers   = RTTimeNanoTS();
+                TMR3TimerQueuesDo(pVM);
+                uint64_t const cNsElapsedTimers = RTTimeNanoTS() - u64StartTimers;
+                STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltTimers, cNsElapsedTimers);
+            }
+
+            if (RTTimeNanoTS() - u64Start >= cNsPollWindow)
+                break;
+            ASMNopPause();
+        }
+
+        /* Make sure notifications wake us up from here on (vmR3HaltGlobal1Halt
+           checks the FFs again before blocking). */
+        ASMAtomicWriteBool(&pUVCpu->vm.s.fWait, true);
+        ASMAtomicWriteBool(&pUVCpu->vm.s.Halt.AdaptivePoll.fPolling, false);
+    }
+
+    uint64_t const cNsPolled = RTTimeNanoTS() - u64Start;
+    if (fPollHit)
+        STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollHit, cNsPolled);
+    else
+    {
+        if (cNsPollWindow)
+            STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollMiss, cNsPolled);
+
+        /*
+         * Block.
+         */
+        rc = vmR3HaltGlobal1Halt(pUVCpu, fMask, u64Now);
+    }
+
+    /*
+     * Wake-up latency and poll window adjustments.
+     */
+    uint64_t const u64End   = RTTimeNanoTS();
+    uint64_t const u64WakeTS = ASMAtomicReadU64(&pUVCpu->vm.s.Halt.AdaptivePoll.u64WakeTS);
+    if (u64WakeTS && u64End > u64WakeTS)
+        STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltWakeLatency, u64End - u64WakeTS);
+
+    uint32_t const cNsMaxPoll = pUVM->vm.s.AdaptivePoll.cNsMaxPollCfg;
+    uint64_t const cNsHalted  = u64End - u64Start;
+    if (cNsHalted <= cNsPollWindow)
+    { /* The window caught it, leave it be. */ }
+    else if (cNsHalted > cNsMaxPoll)
+    {
+        if (cNsPollWindow)
+        {
+            uint32_t const uDiv = pUVM->vm.s.AdaptivePoll.uShrinkDivisorCfg;
+            pUVCpu->vm.s.Halt.AdaptivePoll.cNsPollWindow = uDiv ? cNsPollWindow / uDiv : 0;
+            STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollShrink);
+        }
+    }
+    else if (cNsPollWindow < cNsMaxPoll)
+    {
+        uint64_t cNsNew = cNsPollWindow
+                        ? (uint64_t)cNsPollWindow * pUVM->vm.s.AdaptivePoll.uGrowFactorCfg
+                        : pUVM->vm.s.AdaptivePoll.cNsGrowStartCfg;
+        pUVCpu->vm.s.Halt.AdaptivePoll.cNsPollWindow = (uint32_t)RT_MIN(RT_MAX(cNsNew, cNsPollWindow + 1), cNsMaxPoll);
+        STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollGrow);
+    }
+
+    ASMAtomicUoWriteBool(&pUVCpu->vm.s.fWait, false);
+    return rc;
+}
+
+
+/**
+ * The adaptive poll halt method - VMR3NotifyFF() worker.
+ *
+ * @param   pUVCpu          Pointer to the user mode VMCPU structure.
+ * @param   fFlags          Notification flags, VMNOTIFYFF_FLAGS_*.
+ */
+static DECLCALLBACK(void) vmR3HaltAdaptivePollNotifyCpuFF(PUVMCPU pUVCpu, uint32_t fFlags)
+{
+    PVMCPU pVCpu = pUVCpu->pVCpu;
+    if (   pVCpu
+        && VMCPU_GET_STATE(pVCpu) == VMCPUSTATE_STARTED_HALTED)
+    {
+        if (!ASMAtomicUoReadU64(&pUVCpu->vm.s.Halt.AdaptivePoll.u64WakeTS))
+            ASMAtomicCmpXchgU64(&pUVCpu->vm.s.Halt.AdaptivePoll.u64WakeTS, RTTimeNanoTS(), 0);
+
+        /* The FF is set already, a polling EMT will see it without our help. */
+        if (ASMAtomicReadBool(&pUVCpu->vm.s.Halt.AdaptivePoll.fPolling))
+            return;
+    }
+    vmR3HaltGlobal1NotifyCpuFF(pUVCpu, fFlags);
+}
+
+
 /**
  * Bootstrap VMR3Wait() worker.
  *
@@ -1058,6 +1256,7 @@ static const struct VMHALTMETHODDESC
     { VMHALTMETHOD_OLD,       false, NULL,                NULL,   vmR3HaltOldDoHalt,   vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
     { VMHALTMETHOD_1,         false, vmR3HaltMethod1Init, NULL,   vmR3HaltMethod1Halt, vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
     { VMHALTMETHOD_GLOBAL_1,   true, vmR3HaltGlobal1Init, NULL,   vmR3HaltGlobal1Halt, vmR3HaltGlobal1Wait, vmR3HaltGlobal1NotifyCpuFF, NULL },
+    { VMHALTMETHOD_ADAPTIVE_POLL, false, vmR3HaltAdaptivePollInit, NULL, vmR3HaltAdaptivePollHalt, vmR3HaltGlobal1Wait, vmR3HaltAdaptivePollNotifyCpuFF, NULL },
 };
 
 
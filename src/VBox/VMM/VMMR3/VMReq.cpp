@@ -37,6 +37,27 @@
 #include <iprt/thread.h>
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** @name VMREQ::fWaitState values.
+ * @{ */
+/** Not completed and nobody is blocking on the event semaphore. */
+#define VMREQWAIT_IDLE                  UINT32_C(0)
+/** The waiter is blocking (or about to block) on the event semaphore. */
+#define VMREQWAIT_BLOCKING              UINT32_C(1)
+/** Completed before the waiter blocked, the event semaphore was not signalled. */
+#define VMREQWAIT_COMPLETED             UINT32_C(2)
+/** Completed and the event semaphore signalled, the waiter must consume it. */
+#define VMREQWAIT_COMPLETED_SIGNALLED   UINT32_C(3)
+/** @} */
+
+/** Number of pause iterations VMR3ReqWait does before blocking on the event
+ * semaphore.  Most requests are short, so when the EMT picks them up right
+ * away this saves the requester a sleep and the EMT a wakeup call. */
+#define VMREQ_WAIT_SPIN_COUNT           256
+
+
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
@@ -569,6 +590,26 @@ static void vmr3ReqJoinFree(PVMINTUSERPERVM pVMInt, PVMREQ pList)
 }
 
 
+/**
+ * Gets the index of the free list preferred by the calling thread.
+ *
+ * Hashing the native thread handle gives each requester thread its own free
+ * list most of the time, so the packets it frees (and their event semaphores)
+ * are the ones it gets back on its next allocation, and the threads don't all
+ * bang on the iReqFree cache line.
+ *
+ * @returns Index into VMINTUSERPERVM::apReqFree.
+ * @param   pUVM            Pointer to the user mode VM structure.
+ */
+DECLINLINE(uint32_t) vmR3ReqGetFreeListIdx(PUVM pUVM)
+{
+    uintptr_t uHash = (uintptr_t)RTThreadNativeSelf();
+    uHash ^= uHash >> 17;
+    uHash ^= uHash >> 9;
+    return (uint32_t)(uHash % RT_ELEMENTS(pUVM->vm.s.apReqFree));
+}
+
+
 /**
  * Allocates a request packet.
  *
@@ -604,12 +645,13 @@ VMMR3DECL(int) VMR3ReqAlloc(PUVM pUVM, PVMREQ *ppReq, VMREQTYPE enmType, VMCPUID
     /*
      * Try get a recycled packet.
      * While this could all be solved with a single list with a lock, it's a sport
-     * of mine to avoid locks.
+     * of mine to avoid locks.  The list of the calling thread is tried first.
      */
+    uint32_t idxFree = vmR3ReqGetFreeListIdx(pUVM);
     int cTries = RT_ELEMENTS(pUVM->vm.s.apReqFree) * 2;
     while (--cTries >= 0)
     {
-        PVMREQ volatile *ppHead = &pUVM->vm.s.apReqFree[ASMAtomicIncU32(&pUVM->vm.s.iReqFree) % RT_ELEMENTS(pUVM->vm.s.apReqFree)];
+        PVMREQ volatile *ppHead = &pUVM->vm.s.apReqFree[idxFree];
 #if 0 /* sad, but this won't work safely because the reading of pReq->pNext. */
         PVMREQ pNext = NULL;
         PVMREQ pReq = *ppHead;
@@ -672,6 +714,7 @@ VMMR3DECL(int) VMR3ReqAlloc(PUVM pUVM, PVMREQ *ppReq, VMREQTYPE enmType, VMCPUID
             ASMAtomicWriteNullPtr(&pReq->pNext);
             pReq->enmState = VMREQSTATE_ALLOCATED;
             pReq->iStatus  = VERR_VM_REQUEST_STATUS_STILL_PENDING;
+            pReq->fWaitState = VMREQWAIT_IDLE;
             pReq->fFlags   = VMREQFLAGS_VBOX_STATUS;
             pReq->enmType  = enmType;
             pReq->idDstCpu = idDstCpu;
@@ -681,6 +724,8 @@ VMMR3DECL(int) VMR3ReqAlloc(PUVM pUVM, PVMREQ *ppReq, VMREQTYPE enmType, VMCPUID
             LogFlow(("VMR3ReqAlloc: returns VINF_SUCCESS *ppReq=%p recycled\n", pReq));
             return VINF_SUCCESS;
         }
+
+        idxFree = ASMAtomicIncU32(&pUVM->vm.s.iReqFree) % RT_ELEMENTS(pUVM->vm.s.apReqFree);
     }
 
     /*
@@ -713,6 +758,7 @@ VMMR3DECL(int) VMR3ReqAlloc(PUVM pUVM, PVMREQ *ppReq, VMREQTYPE enmType, VMCPUID
     pReq->enmState = VMREQSTATE_ALLOCATED;
     pReq->iStatus  = VERR_VM_REQUEST_STATUS_STILL_PENDING;
     pReq->fEventSemClear = true;
+    pReq->fWaitState = VMREQWAIT_IDLE;
     pReq->fFlags   = VMREQFLAGS_VBOX_STATUS;
     pReq->enmType  = enmType;
     pReq->idDstCpu = idDstCpu;
@@ -766,7 +812,7 @@ VMMR3DECL(int) VMR3ReqFree(PVMREQ pReq)
     if (pUVM->vm.s.cReqFree < 128)
     {
         ASMAtomicIncU32(&pUVM->vm.s.cReqFree);
-        PVMREQ volatile *ppHead = &pUVM->vm.s.apReqFree[ASMAtomicIncU32(&pUVM->vm.s.iReqFree) % RT_ELEMENTS(pUVM->vm.s.apReqFree)];
+        PVMREQ volatile *ppHead = &pUVM->vm.s.apReqFree[vmR3ReqGetFreeListIdx(pUVM)];
         PVMREQ pNext;
         do
         {
@@ -874,6 +920,7 @@ VMMR3DECL(int) VMR3ReqQueue(PVMREQ pReq, RTMSINTERVAL cMillies)
          * Insert it.
          */
         volatile PVMREQ *ppQueueHead = pReq->fFlags & VMREQFLAGS_PRIORITY ? &pUVCpu->vm.s.pPriorityReqs : &pUVCpu->vm.s.pNormalReqs;
+        pReq->fWaitState = VMREQWAIT_IDLE;
         pReq->enmState = VMREQSTATE_QUEUED;
         PVMREQ pNext;
         do
@@ -909,6 +956,7 @@ VMMR3DECL(int) VMR3ReqQueue(PVMREQ pReq, RTMSINTERVAL cMillies)
          * Insert it.
          */
         volatile PVMREQ *ppQueueHead = pReq->fFlags & VMREQFLAGS_PRIORITY ? &pUVM->vm.s.pPriorityReqs : &pUVM->vm.s.pNormalReqs;
+        pReq->fWaitState = VMREQWAIT_IDLE;
         pReq->enmState = VMREQSTATE_QUEUED;
         PVMREQ pNext;
         do
@@ -939,6 +987,7 @@ VMMR3DECL(int) VMR3ReqQueue(PVMREQ pReq, RTMSINTERVAL cMillies)
         /*
          * The requester was an EMT, just execute it.
          */
+        pReq->fWaitState = VMREQWAIT_IDLE;
         pReq->enmState = VMREQSTATE_QUEUED;
         rc = vmR3ReqProcessOne(pReq);
         LogFlow(("VMR3ReqQueue: returns %Rrc (processed)\n", rc));
@@ -947,6 +996,170 @@ VMMR3DECL(int) VMR3ReqQueue(PVMREQ pReq, RTMSINTERVAL cMillies)
 }
 
 
+/**
+ * Queues a batch of requests for the same destination.
+ *
+ * This is cheaper than calling VMR3ReqQueue for each request: the whole batch
+ * is inserted into the queue with a single atomic operation, the EMT is
+ * notified once, and as the EMT processes the requests in order the caller
+ * will normally only block once, on the last request of the batch.
+ *
+ * The requests must be allocated using VMR3ReqAlloc() and contain all the
+ * required data.  They are processed in array order.  The caller frees them
+ * using VMR3ReqFree() afterwards, unless VMREQFLAGS_NO_WAIT is used.
+ *
+ * @returns VBox status code.
+ *          Will not return VERR_INTERRUPTED.
+ * @returns VERR_TIMEOUT if cMillies was reached without all the packets being
+ *          completed.
+ *
+ * @param   papReqs         The requests to queue.  They must all belong to the
+ *                          same VM and have the same destination (not
+ *                          VMCPUID_ALL or VMCPUID_ALL_REVERSE) as well as the
+ *                          same VMREQFLAGS_NO_WAIT, VMREQFLAGS_POKE and
+ *                          VMREQFLAGS_PRIORITY flags.
+ * @param   cReqs           Number of requests in the batch.
+ * @param   cMillies        Number of milliseconds to wait for the whole batch
+ *                          to be completed. Use RT_INDEFINITE_WAIT to only
+ *                          wait till it's completed.
+ */
+VMMR3DECL(int) VMR3ReqQueueBatch(PVMREQ *papReqs, uint32_t cReqs, RTMSINTERVAL cMillies)
+{
+    LogFlow(("VMR3ReqQueueBatch: papReqs=%p cReqs=%u cMillies=%d\n", papReqs, cReqs, cMillies));
+    AssertPtrReturn(papReqs, VERR_INVALID_POINTER);
+    AssertReturn(cReqs > 0, VERR_INVALID_PARAMETER);
+    if (cReqs == 1)
+        return VMR3ReqQueue(papReqs[0], cMillies);
+
+    /*
+     * Verify the supplied packages.
+     */
+    PVMREQ const    pFirst   = papReqs[0];
+    AssertPtrReturn(pFirst, VERR_INVALID_POINTER);
+    PUVM const      pUVM     = pFirst->pUVM;
+    VMCPUID const   idDstCpu = pFirst->idDstCpu;
+    unsigned const  fFlags   = pFirst->fFlags;
+    unsigned const  fSame    = VMREQFLAGS_NO_WAIT | VMREQFLAGS_POKE | VMREQFLAGS_PRIORITY;
+    AssertMsgReturn(VALID_PTR(pUVM), ("Invalid request package! Anyone cooking their own packages???\n"),
+                    VERR_VM_REQUEST_INVALID_PACKAGE);
+    AssertMsgReturn(idDstCpu != VMCPUID_ALL && idDstCpu != VMCPUID_ALL_REVERSE, ("idDstCpu=%#x\n", idDstCpu),
+                    VERR_INVALID_PARAMETER);
+    for (uint32_t i = 0; i < cReqs; i++)
+    {
+        PVMREQ pReq = papReqs[i];
+        AssertPtrReturn(pReq, VERR_INVALID_POINTER);
+        AssertMsgReturn(pReq->enmState == VMREQSTATE_ALLOCATED, ("#%u: %d\n", i, pReq->enmState), VERR_VM_REQUEST_STATE);
+        AssertMsgReturn(    pReq->pUVM == pUVM
+                        &&  !pReq->pNext
+                        &&  pReq->EventSem != NIL_RTSEMEVENT
+                        &&  pReq->enmType > VMREQTYPE_INVALID
+                        &&  pReq->enmType < VMREQTYPE_MAX,
+                        ("#%u: Invalid request package! Anyone cooking their own packages???\n", i),
+                        VERR_VM_REQUEST_INVALID_PACKAGE);
+        AssertMsgReturn(    pReq->idDstCpu == idDstCpu
+                        &&  (pReq->fFlags & fSame) == (fFlags & fSame),
+                        ("#%u: idDstCpu=%u fFlags=%#x, expected %u and %#x\n", i, pReq->idDstCpu, pReq->fFlags, idDstCpu, fFlags),
+                        VERR_INVALID_PARAMETER);
+    }
+
+    /*
+     * The requester is the EMT in question, just execute them in order.
+     */
+    PUVMCPU pUVCpu = (PUVMCPU)RTTlsGet(pUVM->vm.s.idxTLS);
+    if (    pUVCpu
+        &&  (   idDstCpu == VMCPUID_ANY
+             || idDstCpu == pUVCpu->idCpu))
+    {
+        int rc = VINF_SUCCESS;
+        for (uint32_t i = 0; i < cReqs; i++)
+        {
+            papReqs[i]->fWaitState = VMREQWAIT_IDLE;
+            papReqs[i]->enmState   = VMREQSTATE_QUEUED;
+            int rc2 = vmR3ReqProcessOne(papReqs[i]);
+            if (rc == VINF_SUCCESS)
+                rc = rc2;
+        }
+        LogFlow(("VMR3ReqQueueBatch: returns %Rrc (processed)\n", rc));
+        return rc;
+    }
+
+    /*
+     * Chain them up so that papReqs[0] is the oldest entry and thus the first
+     * to be processed, then insert the whole chain in one go.
+     */
+    for (uint32_t i = 0; i < cReqs; i++)
+    {
+        papReqs[i]->fWaitState = VMREQWAIT_IDLE;
+        papReqs[i]->enmState   = VMREQSTATE_QUEUED;
+        if (i > 0)
+            ASMAtomicWritePtr(&papReqs[i]->pNext, papReqs[i - 1]);
+    }
+    PVMREQ const pLast = papReqs[cReqs - 1];
+
+    bool const fPerCpu = idDstCpu != VMCPUID_ANY && idDstCpu != VMCPUID_ANY_QUEUE;
+    volatile PVMREQ *ppQueueHead;
+    if (fPerCpu)
+    {
+        Assert(idDstCpu < pUVM->cCpus);
+        pUVCpu = &pUVM->aCpus[idDstCpu];
+        ppQueueHead = fFlags & VMREQFLAGS_PRIORITY ? &pUVCpu->vm.s.pPriorityReqs : &pUVCpu->vm.s.pNormalReqs;
+    }
+    else
+        ppQueueHead = fFlags & VMREQFLAGS_PRIORITY ? &pUVM->vm.s.pPriorityReqs : &pUVM->vm.s.pNormalReqs;
+
+    PVMREQ pNext;
+    do
+    {
+        pNext = ASMAtomicUoReadPtrT(ppQueueHead, PVMREQ);
+        ASMAtomicWritePtr(&pFirst->pNext, pNext);
+        ASMCompilerBarrier();
+    } while (!ASMAtomicCmpXchgPtr(ppQueueHead, pLast, pNext));
+    STAM_COUNTER_INC(&pUVM->vm.s.StatReqBatches);
+    STAM_COUNTER_ADD(&pUVM->vm.s.StatReqBatchedReqs, cReqs);
+
+    /*
+     * Notify EMT(s).
+     */
+    if (fPerCpu)
+    {
+        if (pUVM->pVM)
+            VMCPU_FF_SET(&pUVM->pVM->aCpus[idDstCpu], VMCPU_FF_REQUEST);
+        VMR3NotifyCpuFFU(pUVCpu, fFlags & VMREQFLAGS_POKE ? VMNOTIFYFF_FLAGS_POKE : 0);
+    }
+    else
+    {
+        if (pUVM->pVM)
+            VM_FF_SET(pUVM->pVM, VM_FF_REQUEST);
+        VMR3NotifyGlobalFFU(pUVM, fFlags & VMREQFLAGS_POKE ? VMNOTIFYFF_FLAGS_POKE : 0);
+    }
+
+    /*
+     * Wait for the last request first, as it is normally the last one to
+     * complete, and then check off the others which usually doesn't block.
+     */
+    int rc = VINF_SUCCESS;
+    if (!(fFlags & VMREQFLAGS_NO_WAIT))
+    {
+        uint64_t const msStart = cMillies != RT_INDEFINITE_WAIT ? RTTimeMilliTS() : 0;
+        uint32_t i = cReqs;
+        while (i-- > 0)
+        {
+            RTMSINTERVAL cMsLeft = cMillies;
+            if (cMillies != RT_INDEFINITE_WAIT)
+            {
+                uint64_t const cMsElapsed = RTTimeMilliTS() - msStart;
+                cMsLeft = cMsElapsed < cMillies ? cMillies - (RTMSINTERVAL)cMsElapsed : 0;
+            }
+            rc = VMR3ReqWait(papReqs[i], cMsLeft);
+            if (RT_FAILURE(rc))
+                break;
+        }
+    }
+    LogFlow(("VMR3ReqQueueBatch: returns %Rrc\n", rc));
+    return rc;
+}
+
+
 /**
  * Wait for a request to be completed.
  *
@@ -980,28 +1193,54 @@ VMMR3DECL(int) VMR3ReqWait(PVMREQ pReq, RTMSINTERVAL cMillies)
                     VERR_VM_REQUEST_INVALID_TYPE);
 
     /*
-     * Check for deadlock condition
+     * Spin a little before blocking, the EMT is often busy with the request
+     * already and short requests complete within a few microseconds.
      */
     PUVM pUVM = pReq->pUVM;
-    NOREF(pUVM);
+    uint32_t fWaitState = ASMAtomicReadU32(&pReq->fWaitState);
+    if (    cMillies != 0
+        &&  fWaitState == VMREQWAIT_IDLE)
+    {
+        for (uint32_t cSpins = 0; cSpins < VMREQ_WAIT_SPIN_COUNT; cSpins++)
+        {
+            ASMNopPause();
+            fWaitState = ASMAtomicReadU32(&pReq->fWaitState);
+            if (fWaitState != VMREQWAIT_IDLE)
+                break;
+        }
+        if (fWaitState == VMREQWAIT_COMPLETED)
+            STAM_COUNTER_INC(&pUVM->vm.s.StatReqWaitSpinHits);
+    }
+
+    /*
+     * Tell the EMT we're going to block, unless it has completed the request
+     * in the meantime.  The EMT only signals the semaphore if we do this.
+     */
+    if (    fWaitState == VMREQWAIT_IDLE
+        &&  !ASMAtomicCmpXchgU32(&pReq->fWaitState, VMREQWAIT_BLOCKING, VMREQWAIT_IDLE))
+        fWaitState = ASMAtomicReadU32(&pReq->fWaitState);
 
     /*
      * Wait on the package.
      */
-    int rc;
-    if (cMillies != RT_INDEFINITE_WAIT)
-        rc = RTSemEventWait(pReq->EventSem, cMillies);
-    else
+    int rc = VINF_SUCCESS;
+    if (fWaitState != VMREQWAIT_COMPLETED)
     {
-        do
+        STAM_COUNTER_INC(&pUVM->vm.s.StatReqWaitBlocked);
+        if (cMillies != RT_INDEFINITE_WAIT)
+            rc = RTSemEventWait(pReq->EventSem, cMillies);
+        else
         {
-            rc = RTSemEventWait(pReq->EventSem, RT_INDEFINITE_WAIT);
-            Assert(rc != VERR_TIMEOUT);
-        } while (   pReq->enmState != VMREQSTATE_COMPLETED
-                 && pReq->enmState != VMREQSTATE_INVALID);
+            do
+            {
+                rc = RTSemEventWait(pReq->EventSem, RT_INDEFINITE_WAIT);
+                Assert(rc != VERR_TIMEOUT);
+            } while (   pReq->enmState != VMREQSTATE_COMPLETED
+                     && pReq->enmState != VMREQSTATE_INVALID);
+        }
+        if (RT_SUCCESS(rc))
+            ASMAtomicXchgSize(&pReq->fEventSemClear, true);
     }
-    if (RT_SUCCESS(rc))
-        ASMAtomicXchgSize(&pReq->fEventSemClear, true);
     if (pReq->enmState == VMREQSTATE_COMPLETED)
         rc = VINF_SUCCESS;
     LogFlow(("VMR3ReqWait: returns %Rrc\n", rc));
@@ -1316,16 +1555,35 @@ static int  vmR3ReqProcessOne(PVMREQ pReq)
     }
     else
     {
-        /* Notify the waiter and him free up the packet. */
-        LogFlow(("vmR3ReqProcessOne: Completed request %p: rcReq=%Rrc rcRet=%Rrc - notifying waiting thread\n",
-                 pReq, rcReq, rcRet));
-        ASMAtomicXchgSize(&pReq->fEventSemClear, false);
-        int rc2 = RTSemEventSignal(pReq->EventSem);
-        if (RT_FAILURE(rc2))
+        /*
+         * Notify the waiter and him free up the packet.  The semaphore is only
+         * signalled if the waiter went to sleep on it; a spinning waiter picks
+         * up the completion from fWaitState.  Mind that the waiter may free the
+         * packet as soon as fWaitState changes.
+         */
+        PUVM pUVM = pReq->pUVM;
+        if (ASMAtomicCmpXchgU32(&pReq->fWaitState, VMREQWAIT_COMPLETED, VMREQWAIT_IDLE))
+        {
+            LogFlow(("vmR3ReqProcessOne: Completed request %p: rcReq=%Rrc rcRet=%Rrc - waiter not blocking\n",
+                     pReq, rcReq, rcRet));
+            STAM_COUNTER_INC(&pUVM->vm.s.StatReqSignalSkipped);
+        }
+        else
         {
-            AssertRC(rc2);
-            rcRet = rc2;
+            LogFlow(("vmR3ReqProcessOne: Completed request %p: rcReq=%Rrc rcRet=%Rrc - notifying waiting thread\n",
+                     pReq, rcReq, rcRet));
+            Assert(pReq->fWaitState == VMREQWAIT_BLOCKING);
+            RTSEMEVENT const hEventSem = pReq->EventSem;
+            ASMAtomicXchgSize(&pReq->fEventSemClear, false);
+            ASMAtomicWriteU32(&pReq->fWaitState, VMREQWAIT_COMPLETED_SIGNALLED);
+            int rc2 = RTSemEventSignal(hEventSem);
+            if (RT_FAILURE(rc2))
+            {
+                AssertRC(rc2);
+                rcRet = rc2;
+            }
         }
+        NOREF(pUVM);
     }
 
     return rcRet;
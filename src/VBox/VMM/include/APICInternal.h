@@ -1133,6 +1133,10 @@ typedef enum XAPICDELIVERYMODE
  */
 #define APIC_CACHE_LINE_SIZE              128
 
+/** The KVM PV EOI flag bit in guest memory.  Set by us when the guest may skip
+ *  the EOI write, cleared by the guest in lieu of writing the EOI register. */
+#define APIC_PV_EOI_FLAG                  RT_BIT(0)
+
 /**
  * APIC Pending-Interrupt Bitmap (PIB).
  */
@@ -1333,6 +1337,18 @@ typedef struct APICCPU
     uint32_t                    uAlignment4;
     /** @} */
 
+    /** @name KVM paravirtualized EOI.
+     * @{ */
+    /** Guest-physical address of the PV EOI flag, NIL_RTGCPHYS when disabled. */
+    RTGCPHYS                    GCPhysPvEoi;
+    /** The vector the guest was allowed to skip the EOI write for. */
+    uint8_t                     uPvEoiVector;
+    /** Whether the PV EOI flag is set in guest memory. */
+    bool                        fPvEoiPending;
+    /** Alignment padding. */
+    uint8_t                     abAlignment5[6];
+    /** @} */
+
 #ifdef VBOX_WITH_STATISTICS
     /** @name APIC statistics.
      * @{ */
@@ -1383,6 +1399,12 @@ typedef struct APICCPU
     STAMCOUNTER                 StatIcrHiWrite;
     /** Number of times the full ICR (x2APIC send IPI) is written. */
     STAMCOUNTER                 StatIcrFullWrite;
+    /** Number of times the guest was allowed to skip an EOI write. */
+    STAMCOUNTER                 StatPvEoiOffered;
+    /** Number of EOIs the guest signalled through the PV EOI flag. */
+    STAMCOUNTER                 StatPvEoiCompleted;
+    /** Number of times the PV EOI flag had to be taken back. */
+    STAMCOUNTER                 StatPvEoiRevoked;
     /** @} */
 #endif
 } APICCPU;
@@ -1391,6 +1413,7 @@ typedef APICCPU *PAPICCPU;
 /** Pointer to a const APIC VMCPU instance data. */
 typedef APICCPU const *PCAPICCPU;
 AssertCompileMemberAlignment(APICCPU, uApicBaseMsr, 8);
+AssertCompileMemberAlignment(APICCPU, GCPhysPvEoi, 8);
 
 /**
  * APIC operating modes as returned by apicGetMode().
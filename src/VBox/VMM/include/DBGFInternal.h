@@ -193,6 +193,27 @@ typedef struct DBGFBPSEARCHOPT
 typedef DBGFBPSEARCHOPT *PDBGFBPSEARCHOPT;
 
 
+/**
+ * Event tracer ring (one per VCPU).
+ *
+ * Only EMT(idCpu) adds records, readers on other threads copy the records and
+ * then recheck idxNext to weed out the ones overwritten meanwhile.
+ */
+typedef struct DBGFEVTTRACERING
+{
+    /** The number of records ever added to the ring.  The next one goes into
+     * aRecs[idxNext & (DBGF::cEvtTraceEntries - 1)]. */
+    uint64_t volatile       idxNext;
+    /** Align the records on a cache line. */
+    uint8_t                 abPadding[56];
+    /** The records (variable size). */
+    DBGFEVTTRACEREC         aRecs[1];
+} DBGFEVTTRACERING;
+AssertCompileMemberOffset(DBGFEVTTRACERING, aRecs, 64);
+/** Pointer to an event tracer ring. */
+typedef DBGFEVTTRACERING *PDBGFEVTTRACERING;
+
+
 
 /**
  * DBGF Data (part of VM)
@@ -223,7 +244,9 @@ typedef struct DBGF
     /** The number of enabled INT3 breakpoints. */
     uint8_t                     cEnabledInt3Breakpoints;
     uint8_t                     abPadding; /**< Unused padding space up for grabs. */
-    uint32_t                    uPadding;
+    /** The event classes the event tracer is recording, DBGFEVTTRACE_F_XXX.
+     * Zero when the event tracer is disabled or has no buffers. */
+    uint32_t volatile           fEvtTraceMask;
 
     /** Debugger Attached flag.
      * Set if a debugger is attached, elsewise it's clear.
@@ -328,6 +351,18 @@ typedef struct DBGF
         /** The bug check parameters. */
         uint64_t                auParameters[4];
     } BugCheck;
+
+    /** @name Event tracer.
+     * @{ */
+    /** The event tracer rings, one per VCPU, cbEvtTraceRing apart (ring-3 ptr). */
+    R3PTRTYPE(uint8_t *)        pbEvtTraceR3;
+    /** The event tracer rings (ring-0 ptr). */
+    R0PTRTYPE(uint8_t *)        pbEvtTraceR0;
+    /** The size of each event tracer ring, header included. */
+    uint32_t                    cbEvtTraceRing;
+    /** The number of records in each event tracer ring (power of two). */
+    uint32_t                    cEvtTraceEntries;
+    /** @} */
 } DBGF;
 AssertCompileMemberAlignment(DBGF, DbgEvent, 8);
 AssertCompileMemberAlignment(DBGF, aHwBreakpoints, 8);
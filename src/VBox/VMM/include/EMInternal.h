@@ -61,6 +61,20 @@ RT_C_DECLS_BEGIN
 /** EM time slice in ms; used for capping execution time. */
 #define EM_TIME_SLICE                   100
 
+/** @name Exit history learning parameters.
+ * @{ */
+/** String I/O exits are probed after EMCPU::cHistoryProbeMinHits shifted right
+ * by this, as they typically come in long bursts (PIO disk and NIC transfers)
+ * which IEM can batch up. */
+#define EM_EXIT_STR_IO_PROBE_SHIFT      4
+/** Records found unsuitable by probing are probed again every this many hits
+ * (power of two), in case the guest code around them changed behaviour. */
+#define EM_EXIT_REPROBE_INTERVAL        _64K
+/** Number of consecutive fruitless EMEXITACTION_EXEC_WITH_MAX runs before the
+ * record is demoted to EMEXITACTION_NORMAL_PROBED. */
+#define EM_EXIT_MAX_FRUITLESS_EXECS     16
+/** @} */
+
 /**
  * Cli node structure
  */
@@ -343,7 +357,9 @@ typedef struct EMCPU
     uint16_t                cHistoryProbeMinInstructions;
     /** Max number of instructions to execute without an exit before giving up probe. */
     uint16_t                cHistoryProbeMaxInstructionsWithoutExit;
-    uint16_t                uPadding3;
+    /** Number of hits an exit record needs before it is probed.  String I/O
+     * exits use a fraction of this, see EM_EXIT_STR_IO_PROBE_SHIFT. */
+    uint16_t                cHistoryProbeMinHits;
     /** Number of exit records in use. */
     uint32_t                cExitRecordUsed;
     /** Profiling the EMHistoryExec when executing (not probing). */
@@ -363,6 +379,10 @@ typedef struct EMCPU
     STAMCOUNTER             StatHistoryProbedToRing3;
     /** Profiling the EMHistoryExec when probing.*/
     STAMPROFILE             StatHistoryProbe;
+    /** Number of times an EMEXITACTION_NORMAL_PROBED record was probed again. */
+    STAMCOUNTER             StatHistoryReprobed;
+    /** Number of times an EMEXITACTION_EXEC_WITH_MAX record was demoted. */
+    STAMCOUNTER             StatHistoryExecDemoted;
     /** Hit statistics for each lookup step. */
     STAMCOUNTER             aStatHistoryRecHits[16];
     /** Type change statistics for each lookup step. */
@@ -371,6 +391,7 @@ typedef struct EMCPU
     STAMCOUNTER             aStatHistoryRecReplaced[16];
     /** New record statistics for each lookup step. */
     STAMCOUNTER             aStatHistoryRecNew[16];
+    uint64_t                au64Padding5[2];
 
     /** Exit records (32KB). (Aligned on 32 byte boundrary.) */
     EMEXITREC               aExitRecords[1024];
@@ -580,6 +580,16 @@ typedef enum GIMHVHYPERCALLPARAM
 /** @name Hyper-V hypercall op codes.
  * @{
  */
+/** Flush the TLB of an address space on a set of processors. */
+#define GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE        0x02
+/** Flush a list of virtual addresses on a set of processors (rep). */
+#define GIM_HV_HYPERCALL_OP_FLUSH_VA_LIST         0x03
+/** Notify the hypervisor of a long spin-wait. */
+#define GIM_HV_HYPERCALL_OP_NOTIFY_LONG_SPIN_WAIT 0x08
+/** Flush the TLB of an address space, sparse processor set. */
+#define GIM_HV_HYPERCALL_OP_FLUSH_VA_SPACE_EX     0x13
+/** Flush a list of virtual addresses, sparse processor set (rep). */
+#define GIM_HV_HYPERCALL_OP_FLUSH_VA_LIST_EX      0x14
 /** Post message to hypervisor or VMs. */
 #define GIM_HV_HYPERCALL_OP_POST_MESSAGE          0x5C
 /** Post debug data to hypervisor. */
@@ -618,9 +628,9 @@ typedef enum GIMHVHYPERCALLPARAM
 /** Whether it's a fast (register based) hypercall or not (memory-based). */
 #define GIM_HV_HYPERCALL_IN_IS_FAST(a)           RT_BOOL((a) & RT_BIT_64(16))
 /** Total number of reps for a rep hypercall. */
-#define GIM_HV_HYPERCALL_IN_REP_COUNT(a)         (((a) << 32) & UINT64_C(0xfff))
+#define GIM_HV_HYPERCALL_IN_REP_COUNT(a)         (((a) >> 32) & UINT64_C(0xfff))
 /** Rep start index for a rep hypercall. */
-#define GIM_HV_HYPERCALL_IN_REP_START_IDX(a)     (((a) << 48) & UINT64_C(0xfff))
+#define GIM_HV_HYPERCALL_IN_REP_START_IDX(a)     (((a) >> 48) & UINT64_C(0xfff))
 /** Reserved bits range 1. */
 #define GIM_HV_HYPERCALL_IN_RSVD_1(a)            (((a) << 17) & UINT64_C(0x7fff))
 /** Reserved bits range 2. */
@@ -1009,6 +1019,61 @@ typedef struct GIMHVDEBUGRESETIN
 typedef GIMHVDEBUGRESETIN *PGIMHVDEBUGRESETIN;
 AssertCompileSize(GIMHVDEBUGRESETIN, 8);
 
+/** @name HvFlushVirtualAddressSpace/List flags.
+ * @{ */
+/** Flush on all processors, ignore the processor mask/set. */
+#define GIM_HV_FLUSH_ALL_PROCESSORS                 RT_BIT_64(0)
+/** Flush all address spaces, ignore the address space. */
+#define GIM_HV_FLUSH_ALL_VIRTUAL_ADDRESS_SPACES     RT_BIT_64(1)
+/** Only non-global mappings need flushing. */
+#define GIM_HV_FLUSH_NON_GLOBAL_MAPPINGS_ONLY       RT_BIT_64(2)
+/** The address list uses the extended (large page) range format. */
+#define GIM_HV_FLUSH_USE_EXTENDED_RANGE_FORMAT      RT_BIT_64(3)
+/** Mask of valid flags. */
+#define GIM_HV_FLUSH_VALID_MASK                     UINT64_C(0xf)
+/** @} */
+
+/** @name Hyper-V generic processor set formats (HV_GENERIC_SET_FORMAT).
+ * @{ */
+/** Sparse set of banks, 64 processors each. */
+#define GIM_HV_GENERIC_SET_SPARSE_4K                0
+/** All processors. */
+#define GIM_HV_GENERIC_SET_ALL                      1
+/** @} */
+
+/**
+ * HvFlushVirtualAddressSpace and HvFlushVirtualAddressList hypercall input.
+ *
+ * For the list variant, the rep list of GVA ranges follows.
+ */
+typedef struct GIMHVFLUSHVAIN
+{
+    uint64_t    uAddressSpace;
+    uint64_t    fFlags;
+    uint64_t    u64ProcessorMask;
+} GIMHVFLUSHVAIN;
+/** Pointer to a HvFlushVirtualAddressSpace/List input struct. */
+typedef GIMHVFLUSHVAIN *PGIMHVFLUSHVAIN;
+AssertCompileSize(GIMHVFLUSHVAIN, 24);
+
+/**
+ * HvFlushVirtualAddressSpaceEx and HvFlushVirtualAddressListEx hypercall input.
+ *
+ * The bank contents of the processor set (one qword per bit set in
+ * u64ValidBankMask) follow, and for the list variant, the rep list of GVA
+ * ranges after that.
+ */
+typedef struct GIMHVFLUSHVAEXIN
+{
+    uint64_t    uAddressSpace;
+    uint64_t    fFlags;
+    uint64_t    u64VpSetFormat;
+    uint64_t    u64ValidBankMask;
+} GIMHVFLUSHVAEXIN;
+/** Pointer to a HvFlushVirtualAddressSpaceEx/ListEx input struct. */
+typedef GIMHVFLUSHVAEXIN *PGIMHVFLUSHVAEXIN;
+AssertCompileSize(GIMHVFLUSHVAEXIN, 32);
+
 /**
  * HvPostDebugData hypercall input.
  */
@@ -1226,7 +1291,9 @@ typedef struct GIMHV
     bool                        fDbgEnabled;
     /** Whether we should suggest a hypercall-based debug interface to the guest. */
     bool                        fDbgHypercallInterface;
-    bool                        afAlignment0[4];
+    /** Whether HvNotifyLongSpinWait is handled (i.e. a retry count is advertised). */
+    bool                        fLongSpinWaitNotify;
+    bool                        afAlignment0[3];
     /** The action to take while sending replies. */
     GIMHVDEBUGREPLY             enmDbgReply;
     /** The IP address chosen by/assigned to the guest. */
@@ -1316,6 +1383,14 @@ typedef struct GIMHVCPU
     /** @name Statistics.
      * @{ */
     STAMCOUNTER                 aStatStimerFired[GIM_HV_STIMER_COUNT];
+    /** Number of HvFlushVirtualAddressSpace[Ex] hypercalls. */
+    STAMCOUNTER                 StatFlushVaSpace;
+    /** Number of HvFlushVirtualAddressList[Ex] hypercalls. */
+    STAMCOUNTER                 StatFlushVaList;
+    /** Number of remote VCPUs targeted by flush hypercalls. */
+    STAMCOUNTER                 StatFlushVaRemoteCpus;
+    /** Number of HvNotifyLongSpinWait hypercalls. */
+    STAMCOUNTER                 StatLongSpinWait;
     /** @} */
 } GIMHVCPU;
 /** Pointer to per-VCPU GIM Hyper-V instance data. */
@@ -122,6 +122,35 @@ AssertCompile(MSR_GIM_KVM_RANGE1_FIRST <= MSR_GIM_KVM_RANGE1_LAST);
 #define MSR_GIM_KVM_WALL_CLOCK_GUEST_GPA(a)        (a)
 /** @} */
 
+/** @name KVM MSR - Steal time (MSR_GIM_KVM_STEAL_TIME).
+ * @{
+ */
+/** The steal-time enable bit. */
+#define MSR_GIM_KVM_STEAL_TIME_ENABLE_BIT          RT_BIT_64(0)
+/** Whether the steal-time struct. is enabled or not. */
+#define MSR_GIM_KVM_STEAL_TIME_IS_ENABLED(a)       RT_BOOL((a) & MSR_GIM_KVM_STEAL_TIME_ENABLE_BIT)
+/** Reserved bits, must be zero. */
+#define MSR_GIM_KVM_STEAL_TIME_RSVD_MASK           UINT64_C(0x3e)
+/** Guest-physical address of the steal-time struct (64-byte aligned). */
+#define MSR_GIM_KVM_STEAL_TIME_GUEST_GPA(a)        ((a) & ~UINT64_C(0x3f))
+/** @} */
+
+/** @name KVM MSR - Paravirtualized EOI (MSR_GIM_KVM_EOI).
+ * @{
+ */
+/** The PV EOI enable bit. */
+#define MSR_GIM_KVM_EOI_ENABLE_BIT                 RT_BIT_64(0)
+/** Whether PV EOI is enabled or not. */
+#define MSR_GIM_KVM_EOI_IS_ENABLED(a)              RT_BOOL((a) & MSR_GIM_KVM_EOI_ENABLE_BIT)
+/** Reserved bits, must be zero. */
+#define MSR_GIM_KVM_EOI_RSVD_MASK                  UINT64_C(0x2)
+/** Guest-physical address of the PV EOI flag (4-byte aligned). */
+#define MSR_GIM_KVM_EOI_GUEST_GPA(a)               ((a) & ~UINT64_C(0x3))
+/** @} */
+
+/** The minimum interval between steal-time struct updates in nanoseconds. */
+#define GIM_KVM_STEAL_TIME_UPDATE_INTERVAL_NS      RT_NS_1MS
+
 
 /** @name KVM Hypercall operations.
  *  @{ */
@@ -189,6 +218,31 @@ typedef GIMKVMWALLCLOCK const *PCGIMKVMWALLCLOCK;
 AssertCompileSize(GIMKVMWALLCLOCK, 12);
 
 
+/**
+ * KVM per-VCPU steal-time structure.
+ */
+typedef struct GIMKVMSTEALTIME
+{
+    /** Time (in nanoseconds) the VCPU was runnable but not executing. */
+    uint64_t        u64Steal;
+    /** Version (sequence number), odd while being updated. */
+    uint32_t        u32Version;
+    /** Flags, currently unused. */
+    uint32_t        u32Flags;
+    /** Whether the VCPU was preempted. */
+    uint8_t         u8Preempted;
+    /** Alignment padding. */
+    uint8_t         abPadding0[3];
+    /** Reserved for future use. */
+    uint32_t        au32Reserved[11];
+} GIMKVMSTEALTIME;
+/** Pointer to KVM steal-time struct. */
+typedef GIMKVMSTEALTIME *PGIMKVMSTEALTIME;
+/** Pointer to a const KVM steal-time struct. */
+typedef GIMKVMSTEALTIME const *PCGIMKVMSTEALTIME;
+AssertCompileSize(GIMKVMSTEALTIME, 64);
+
+
 /**
  * GIM KVM VM instance data.
  * Changes to this must checked against the padding of the gim union in VM!
@@ -236,6 +290,35 @@ typedef struct GIMKVMCPU
     uint64_t                    uVirtNanoTS;
     /** The flags of the system-time struct. */
     uint8_t                     fSystemTimeFlags;
+    /** Alignment padding. */
+    uint8_t                     abPadding0[3];
+    /** The version (sequence number) of the steal-time struct. */
+    uint32_t                    u32StealTimeVersion;
+
+    /** Steal-time MSR. */
+    uint64_t                    u64StealTimeMsr;
+    /** The guest-physical address of the steal-time struct. */
+    RTGCPHYS                    GCPhysStealTime;
+    /** The steal time (in nanoseconds) last reported to the guest. */
+    uint64_t                    cNsSteal;
+    /** The steal time at the base point, see gimR3KvmEnableStealTime. */
+    uint64_t                    cNsStealBase;
+    /** Host nano timestamp at the base point. */
+    uint64_t                    uStealBaseNS;
+    /** The VCPU halted time (TMR3GetCpuLoadTimes) at the base point. */
+    uint64_t                    cNsHaltedBase;
+    /** The EMT CPU time (in nanoseconds) at the base point. */
+    uint64_t                    cNsCpuBase;
+    /** Host nano timestamp of the next steal-time struct update. */
+    uint64_t                    uStealNextUpdateNS;
+
+    /** Paravirtualized EOI MSR. */
+    uint64_t                    u64PvEoiMsr;
+
+    /** Number of steal-time struct updates. */
+    STAMCOUNTER                 StatStealTimeUpdates;
+    /** Number of KVM_HC_KICK_CPU hypercalls targeting this VCPU. */
+    STAMCOUNTER                 StatKickCpu;
 } GIMKVMCPU;
 /** Pointer to per-VCPU GIM KVM instance data. */
 typedef GIMKVMCPU *PGIMKVMCPU;
@@ -263,6 +346,8 @@ VMMR3_INT_DECL(int)             gimR3KvmLoad(PVM pVM, PSSMHANDLE pSSM);
 VMMR3_INT_DECL(int)             gimR3KvmDisableSystemTime(PVM pVM);
 VMMR3_INT_DECL(int)             gimR3KvmEnableSystemTime(PVM pVM, PVMCPU pVCpu);
 VMMR3_INT_DECL(int)             gimR3KvmEnableWallClock(PVM pVM, RTGCPHYS GCPhysSysTime);
+VMMR3_INT_DECL(int)             gimR3KvmEnableStealTime(PVM pVM, PVMCPU pVCpu);
+VMMR3_INT_DECL(void)            gimR3KvmUpdateStealTime(PVM pVM, PVMCPU pVCpu);
 #endif /* IN_RING3 */
 
 VMM_INT_DECL(bool)              gimKvmIsParavirtTscEnabled(PVM pVM);
@@ -70,6 +70,9 @@ typedef struct IOMMMIORANGE
     R0PTRTYPE(PFNIOMMMIOREAD)   pfnReadCallbackR0;
     /** Pointer to fill (memset) callback function - R0. */
     R0PTRTYPE(PFNIOMMMIOFILL)   pfnFillCallbackR0;
+    /** Critical section serializing the callbacks - R0.
+     * NULL if the device critical section is used (the default). */
+    R0PTRTYPE(PPDMCRITSECT)     pCritSectR0;
 
     /** Pointer to user argument - R3. */
     RTR3PTR                     pvUserR3;
@@ -81,6 +84,9 @@ typedef struct IOMMMIORANGE
     R3PTRTYPE(PFNIOMMMIOREAD)   pfnReadCallbackR3;
     /** Pointer to fill (memset) callback function - R3. */
     R3PTRTYPE(PFNIOMMMIOFILL)   pfnFillCallbackR3;
+    /** Critical section serializing the callbacks - R3.
+     * NULL if the device critical section is used (the default). */
+    R3PTRTYPE(PPDMCRITSECT)     pCritSectR3;
 
     /** Description / Name. For easing debugging. */
     R3PTRTYPE(const char *)     pszDesc;
@@ -95,10 +101,9 @@ typedef struct IOMMMIORANGE
     RCPTRTYPE(PFNIOMMMIOREAD)   pfnReadCallbackRC;
     /** Pointer to fill (memset) callback function - RC. */
     RCPTRTYPE(PFNIOMMMIOFILL)   pfnFillCallbackRC;
-#if HC_ARCH_BITS == 64
-    /** Padding structure length to multiple of 8 bytes. */
-    RTRCPTR                     RCPtrPadding;
-#endif
+    /** Critical section serializing the callbacks - RC.
+     * NIL_RTRCPTR if the device critical section is used (the default). */
+    RCPTRTYPE(PPDMCRITSECT)     pCritSectRC;
 } IOMMMIORANGE;
 /** Pointer to a MMIO range descriptor, R3 version. */
 typedef struct IOMMMIORANGE *PIOMMMIORANGE;
@@ -156,6 +161,9 @@ typedef struct IOMIOPORTRANGER3
     RTR3PTR                     pvUser;
     /** Pointer to the associated device instance. */
     R3PTRTYPE(PPDMDEVINS)       pDevIns;
+    /** Critical section serializing the callbacks, NULL if the device critical
+     * section is used (the default). */
+    R3PTRTYPE(PPDMCRITSECT)     pCritSect;
     /** Pointer to OUT callback function. */
     R3PTRTYPE(PFNIOMIOPORTOUT)  pfnOutCallback;
     /** Pointer to IN callback function. */
@@ -188,6 +196,9 @@ typedef struct IOMIOPORTRANGER0
     RTR0PTR                     pvUser;
     /** Pointer to the associated device instance. */
     R0PTRTYPE(PPDMDEVINS)       pDevIns;
+    /** Critical section serializing the callbacks, NULL if the device critical
+     * section is used (the default). */
+    R0PTRTYPE(PPDMCRITSECT)     pCritSect;
     /** Pointer to OUT callback function. */
     R0PTRTYPE(PFNIOMIOPORTOUT)  pfnOutCallback;
     /** Pointer to IN callback function. */
@@ -225,9 +236,10 @@ typedef struct IOMIOPORTRANGERC
     RCPTRTYPE(PFNIOMIOPORTOUTSTRING) pfnOutStrCallback;
     /** Pointer to string IN callback function. */
     RCPTRTYPE(PFNIOMIOPORTINSTRING) pfnInStrCallback;
-#if HC_ARCH_BITS == 64
-    RTRCPTR                     RCPtrAlignment; /**< pszDesc is 8 byte aligned. */
-#endif
+    /** Critical section serializing the callbacks, NIL_RTRCPTR if the device
+     * critical section is used (the default).
+     * @remarks Also makes pszDesc 8 byte aligned on 64-bit hosts. */
+    RCPTRTYPE(PPDMCRITSECT)     pCritSect;
     /** Description / Name. For easing debugging. */
     R3PTRTYPE(const char *)     pszDesc;
 } IOMIOPORTRANGERC;
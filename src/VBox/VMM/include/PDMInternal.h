@@ -266,6 +266,73 @@ typedef struct PDMDRVINSINT
 } PDMDRVINSINT;
 
 
+/** Number of hold time histogram buckets in PDMCRITSECTPROF.
+ * Bucket N counts hold times in the [2^(N-1), 2^N) TSC ticks range, the last
+ * one catching everything longer. */
+#define PDMCRITSECTPROF_HOLD_BUCKETS    32
+/** Number of contended caller slots in PDMCRITSECTPROF. */
+#define PDMCRITSECTPROF_CALLERS         16
+
+/**
+ * A contended caller of a profiled critical section.
+ */
+typedef struct PDMCRITSECTPROFCALLER
+{
+    /** The caller ID, typically the return address.  0 if the slot is free. */
+    uint64_t volatile               uId;
+    /** The source file (ring-3 string, optional). */
+    R3PTRTYPE(const char *)         pszFile;
+    /** The function (ring-3 string, optional). */
+    R3PTRTYPE(const char *)         pszFunction;
+    /** The source line. */
+    uint32_t                        iLine;
+    /** Number of times this caller had to wait. */
+    uint32_t volatile               cContentions;
+    /** Total number of TSC ticks this caller spent waiting. */
+    uint64_t volatile               cTicksWaited;
+} PDMCRITSECTPROFCALLER;
+/** Pointer to a contended caller entry. */
+typedef PDMCRITSECTPROFCALLER *PPDMCRITSECTPROFCALLER;
+
+/**
+ * Lock contention profiling data for a critical section (both types).
+ *
+ * This is allocated on the hyper heap when /PDM/CritSectProfiling is enabled,
+ * so it can be updated in ring-0 as well.  Raw-mode context doesn't profile.
+ */
+typedef struct PDMCRITSECTPROF
+{
+    /** The TSC when the current (exclusive) owner got the section. */
+    uint64_t                        u64EnterTick;
+    /** Number of callers dropped because all caller slots were taken. */
+    uint32_t volatile               cCallersLost;
+    uint32_t                        u32Padding;
+    /** Exclusive hold times. */
+    STAMPROFILE                     StatHold;
+    /** Contended wait times (all waiters, updated atomically). */
+    STAMPROFILE                     StatWait;
+    /** Exclusive hold time histogram, see PDMCRITSECTPROF_HOLD_BUCKETS. */
+    uint64_t volatile               acHoldHist[PDMCRITSECTPROF_HOLD_BUCKETS];
+    /** The contended callers, ring-3 only. */
+    PDMCRITSECTPROFCALLER           aCallers[PDMCRITSECTPROF_CALLERS];
+} PDMCRITSECTPROF;
+AssertCompileMemberAlignment(PDMCRITSECTPROF, StatHold, 8);
+/** Pointer to critical section profiling data. */
+typedef PDMCRITSECTPROF *PPDMCRITSECTPROF;
+
+/** @def PDMCRITSECT_PROF
+ * Gets the current context pointer to the profiling data of a critical
+ * section, NULL if not profiling (or in raw-mode context).
+ * @param   a_pInt      The internal critical section structure (either type). */
+#if defined(IN_RING3)
+# define PDMCRITSECT_PROF(a_pInt)       ((a_pInt)->pProfR3)
+#elif defined(IN_RING0)
+# define PDMCRITSECT_PROF(a_pInt)       ((a_pInt)->pProfR0)
+#else
+# define PDMCRITSECT_PROF(a_pInt)       ((PPDMCRITSECTPROF)NULL)
+#endif
+
+
 /**
  * Private critical section data.
  */
@@ -308,6 +375,16 @@ typedef struct PDMCRITSECTINT
     STAMCOUNTER                     StatContentionR3;
     /** Profiling the time the section is locked. */
     STAMPROFILEADV                  StatLocked;
+    /** Contention profiling data - R3 Ptr.  NULL if not profiling. */
+    R3PTRTYPE(PPDMCRITSECTPROF)     pProfR3;
+    /** Contention profiling data - R0 Ptr.  NIL if not profiling. */
+    R0PTRTYPE(PPDMCRITSECTPROF)     pProfR0;
+    /** The low 32 bits of the TSC when the section was last entered.
+     * Only valid while owned. */
+    uint32_t                        u32EnterTick;
+    /** Exponentially weighted average of the hold time in TSC ticks, used for
+     * adaptive spinning.  Updated by the owner when leaving. */
+    uint32_t volatile               cTicksAvgHold;
 } PDMCRITSECTINT;
 AssertCompileMemberAlignment(PDMCRITSECTINT, StatContentionRZLock, 8);
 /** Pointer to private critical section data. */
@@ -368,6 +445,10 @@ typedef struct PDMCRITSECTRWINT
     STAMCOUNTER                         StatR3EnterShared;
     /** Profiling the time the section is write locked. */
     STAMPROFILEADV                      StatWriteLocked;
+    /** Contention profiling data - R3 Ptr.  NULL if not profiling. */
+    R3PTRTYPE(PPDMCRITSECTPROF)         pProfR3;
+    /** Contention profiling data - R0 Ptr.  NIL if not profiling. */
+    R0PTRTYPE(PPDMCRITSECTPROF)         pProfR0;
 } PDMCRITSECTRWINT;
 AssertCompileMemberAlignment(PDMCRITSECTRWINT, StatContentionRZEnterExcl, 8);
 AssertCompileMemberAlignment(PDMCRITSECTRWINT, Core.u64State, 8);
@@ -733,6 +814,28 @@ typedef PDMMOD *PPDMMOD;
 
 /** Extra space in the free array. */
 #define PDMQUEUE_FREE_SLACK         16
+/** Number of pending item lists per queue (power of two, max 32).
+ * Inserters pick a list by virtual CPU (ring-3), host CPU (ring-0) or thread
+ * so that concurrent inserts don't fight over the same cache line. */
+#define PDMQUEUE_PENDING_LISTS      8
+
+/**
+ * A PDM queue pending item list (LIFO), padded to a cache line.
+ */
+typedef struct PDMQUEUEPENDING
+{
+    /** LIFO of pending items - R3. */
+    R3PTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingR3;
+    /** LIFO of pending items - R0. */
+    R0PTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingR0;
+    /** LIFO of pending items - GC. */
+    RCPTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingRC;
+    /** Padding. */
+    uint8_t                               abPadding[64 - sizeof(RTR3PTR) - sizeof(RTR0PTR) - sizeof(RTRCPTR)];
+} PDMQUEUEPENDING;
+AssertCompileSize(PDMQUEUEPENDING, 64);
+/** Pointer to a PDM queue pending item list. */
+typedef PDMQUEUEPENDING *PPDMQUEUEPENDING;
 
 /**
  * Queue type.
@@ -803,18 +906,20 @@ typedef struct PDMQUEUE
     PTMTIMERR3                      pTimer;
     /** Pointer to the VM - R3. */
     PVMR3                           pVMR3;
-    /** LIFO of pending items - R3. */
-    R3PTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingR3;
     /** Pointer to the VM - R0. */
     PVMR0                           pVMR0;
-    /** LIFO of pending items - R0. */
-    R0PTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingR0;
     /** Pointer to the GC VM and indicator for GC enabled queue.
      * If this is NULL, the queue cannot be used in GC.
      */
     PVMRC                           pVMRC;
-    /** LIFO of pending items - GC. */
-    RCPTRTYPE(PPDMQUEUEITEMCORE) volatile pPendingRC;
+    /** Bitmap of aPending entries which may have items (bit set after the
+     * insert, cleared by the flusher before taking the list). */
+    uint32_t volatile               fPendingLists;
+    /** Sequence number source for PDMQUEUEITEMCORE::u32Seq, used to restore
+     * the insertion order when merging the pending lists. */
+    uint32_t volatile               u32InsertSeq;
+    /** ASMReadTSC() of the first insert since the last flush, 0 if none. */
+    uint64_t volatile               u64FirstInsertTick;
 
     /** Item size (bytes). */
     uint32_t                        cbItem;
@@ -838,6 +943,10 @@ typedef struct PDMQUEUE
     STAMCOUNTER                     StatFlush;
     /** Stat: Queue flushes with pending items left over. */
     STAMCOUNTER                     StatFlushLeftovers;
+    /** Stat: Inserts which had to retry because of a concurrent insert. */
+    STAMCOUNTER                     StatInsertContention;
+    /** Stat: Time from the first insert till the flush picked it up. */
+    STAMPROFILE                     StatFlushLatency;
 #ifdef VBOX_WITH_STATISTICS
     /** State: Profiling the flushing. */
     STAMPROFILE                     StatFlushPrf;
@@ -846,6 +955,9 @@ typedef struct PDMQUEUE
     uint32_t volatile               cAlignment;
 #endif
 
+    /** The pending item lists, see PDMQUEUE_PENDING_LISTS. */
+    PDMQUEUEPENDING                 aPending[PDMQUEUE_PENDING_LISTS];
+
     /** Array of pointers to free items. Variable size. */
     struct PDMQUEUEFREEITEM
     {
@@ -1313,6 +1425,8 @@ void        pdmUnlock(PVM pVM);
 #if defined(IN_RING3) || defined(IN_RING0)
 void        pdmCritSectRwLeaveSharedQueued(PPDMCRITSECTRW pThis);
 void        pdmCritSectRwLeaveExclQueued(PPDMCRITSECTRW pThis);
+void        pdmCritSectProfHold(PPDMCRITSECTPROF pProf, uint64_t cTicks);
+void        pdmCritSectProfWait(PPDMCRITSECTPROF pProf, uint64_t cTicks, PCRTLOCKVALSRCPOS pSrcPos);
 #endif
 
 /** @} */
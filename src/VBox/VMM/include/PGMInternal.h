@@ -3378,8 +3378,14 @@ typedef struct PGM
     bool                            fRestoreRomPagesOnReset;
     /** Whether to automatically clear all RAM pages on reset. */
     bool                            fZeroRamPagesOnReset;
+    /** @cfgm{/PGM/LargePageRam, boolean, false}
+     * Whether guest RAM should be backed by 2 MB host pages wherever possible.
+     * This pre-allocates large pages at init, tolerates a number of large page
+     * allocation failures before falling back to 4 KB pages and eagerly
+     * re-validates large pages when access handlers are removed. */
+    bool                            fLargePageRam;
     /** Alignment padding. */
-    bool                            afAlignment3[7];
+    bool                            afAlignment3[6];
 
     /** Indicates that PGMR3FinalizeMappings has been called and that further
      * PGMR3MapIntermediate calls will be rejected. */
@@ -3704,7 +3710,11 @@ typedef struct PGM
     uint32_t                        cUnmappedChunks;        /**< Number of times we unmapped a chunk. */
     uint32_t                        cLargePages;            /**< The number of large pages. */
     uint32_t                        cLargePagesDisabled;    /**< The number of disabled large pages. */
-/*    uint32_t                        aAlignment4[1]; */
+    uint32_t                        cLargePageAllocFailures; /**< The number of failed large page allocations. */
+    /** @cfgm{/PGM/LargePageMaxAllocFailures, uint32_t, 16}
+     * The number of large page allocation failures tolerated in LargePageRam
+     * mode before large pages are disabled (without LargePageRam it's 1). */
+    uint32_t                        cMaxLargePageAllocFailures;
 
     /** The number of times we were forced to change the hypervisor region location. */
     STAMCOUNTER                     cRelocations;
@@ -4259,6 +4269,7 @@ int             pgmPhysGetPageAndRangeExSlow(PVM pVM, RTGCPHYS GCPhys, PPPGMPAGE
 #ifdef IN_RING3
 void            pgmR3PhysRelinkRamRanges(PVM pVM);
 int             pgmR3PhysRamPreAllocate(PVM pVM);
+int             pgmR3PhysRamPreAllocateLargePages(PVM pVM);
 int             pgmR3PhysRamReset(PVM pVM);
 int             pgmR3PhysRomReset(PVM pVM);
 int             pgmR3PhysRamZeroAll(PVM pVM);
@@ -43,6 +43,9 @@ RT_C_DECLS_BEGIN
  * This is an optimization for speeding up registration as well as query. */
 #define STAM_WITH_LOOKUP_TREE
 
+/** The initial size of the sample name hash table (power of two). */
+#define STAM_HASH_TAB_INITIAL_SIZE  1024
+
 
 /** Pointer to sample descriptor. */
 typedef struct STAMDESC    *PSTAMDESC;
@@ -84,6 +87,10 @@ typedef struct STAMDESC
     RTLISTNODE          ListEntry;
     /** Pointer to our lookup node. */
     PSTAMLOOKUP         pLookup;
+    /** Next sample in the same name hash table bucket. */
+    PSTAMDESC           pHashNext;
+    /** The name hash (RTStrHash1). */
+    uint32_t            uHash;
     /** Sample name. */
     const char         *pszName;
     /** Sample type. */
@@ -133,6 +140,48 @@ typedef struct STAMDESC
 } STAMDESC;
 
 
+/**
+ * Binary telemetry exporter instance (STAMR3ExportStart).
+ */
+typedef struct STAMEXPORT
+{
+    /** The user mode VM handle. */
+    PUVM                    pUVM;
+    /** The export thread. */
+    RTTHREAD                hThread;
+    /** Event semaphore for waking up the thread when stopping. */
+    RTSEMEVENT              hEvtStop;
+    /** Set when the thread should stop. */
+    bool volatile           fStop;
+    /** The sampling interval in milliseconds. */
+    uint32_t                cMsInterval;
+    /** Set by the thread once the output has been opened. */
+    bool volatile           fOpened;
+    /** The output filename. */
+    char                   *pszFilename;
+    /** The output file (regular file or FIFO), opened by the thread. */
+    RTFILE                  hFile;
+    /** The sample pattern, NULL for all samples. */
+    char                   *pszPat;
+    /** The generation of the last schema record written, UINT32_MAX if none. */
+    uint32_t                uGeneration;
+    /** The number of entries in paPrev. */
+    uint32_t                cPrev;
+    /** The sample values of the previous data record. */
+    PSTAMBINSAMPLE          paPrev;
+    /** The data record buffer. */
+    uint8_t                *pbRec;
+    /** The size of the data record buffer. */
+    size_t                  cbRecAlloc;
+    /** The number of records written. */
+    uint64_t                cRecords;
+    /** The number of bytes written. */
+    uint64_t                cbWritten;
+} STAMEXPORT;
+/** Pointer to a binary telemetry exporter instance. */
+typedef STAMEXPORT *PSTAMEXPORT;
+
+
 /**
  * STAM data kept in the UVM.
  */
@@ -146,6 +195,21 @@ typedef struct STAMUSERPERVM
     /** RW Lock for the list and tree. */
     RTSEMRW                 RWSem;
 
+    /** The sample name hash table (cHashTab entries), for exact name lookups. */
+    PSTAMDESC              *papHashTab;
+    /** The size of the hash table (power of two). */
+    uint32_t                cHashTab;
+    /** The number of samples in the hash table. */
+    uint32_t                cHashEntries;
+    /** The registration generation, incremented on every sample registration
+     *  and deregistration.  Used by binary snapshot readers to detect that
+     *  their name table is out of date. */
+    uint32_t volatile       uGeneration;
+    /** Explicit alignment padding. */
+    uint32_t                uAlignment0;
+    /** The binary telemetry exporter, NULL if not active. */
+    struct STAMEXPORT      *pExport;
+
     /** The copy of the GVMM statistics. */
     GVMMSTATS               GVMMStats;
     /** The number of registered host CPU leaves. */
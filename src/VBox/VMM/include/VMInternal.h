@@ -144,6 +144,8 @@ typedef enum
     VMHALTMETHOD_1,
     /** The first go at a more global approach. */
     VMHALTMETHOD_GLOBAL_1,
+    /** Adaptive poll-before-block on top of the global approach. */
+    VMHALTMETHOD_ADAPTIVE_POLL,
     /** The end of valid methods. (not inclusive of course) */
     VMHALTMETHOD_END,
     /** The usual 32-bit max value. */
@@ -225,6 +227,16 @@ typedef struct VMINTUSERPERVM
     /** Number of times we've raced someone when pushing the other requests back
      * onto the list. */
     STAMCOUNTER                     StatReqPushBackRaces;
+    /** Number of VMR3ReqQueueBatch calls queuing more than one request. */
+    STAMCOUNTER                     StatReqBatches;
+    /** Number of requests queued by VMR3ReqQueueBatch. */
+    STAMCOUNTER                     StatReqBatchedReqs;
+    /** Number of times VMR3ReqWait found the request completed while spinning. */
+    STAMCOUNTER                     StatReqWaitSpinHits;
+    /** Number of times VMR3ReqWait had to block on the event semaphore. */
+    STAMCOUNTER                     StatReqWaitBlocked;
+    /** Number of completed requests not needing the event semaphore signalled. */
+    STAMCOUNTER                     StatReqSignalSkipped;
 # endif
 
     /** Pointer to the support library session.
@@ -317,6 +329,22 @@ typedef struct VMINTUSERPERVM
         }                           Global1;
     }                               Halt;
 
+    /**
+     * Adaptive poll configuration.  This is kept outside the Halt union as the
+     * method blocks the same way as Global1 and needs its settings as well.
+     */
+    struct
+    {
+        /** The max poll window (ns). */
+        uint32_t                    cNsMaxPollCfg;
+        /** The first non-zero poll window (ns) when growing. */
+        uint32_t                    cNsGrowStartCfg;
+        /** The factor to grow the poll window by. */
+        uint32_t                    uGrowFactorCfg;
+        /** The divisor to shrink the poll window by, 0 for resetting it. */
+        uint32_t                    uShrinkDivisorCfg;
+    }                               AdaptivePoll;
+
     /** Pointer to the DBGC instance data. */
     void                           *pvDBGC;
 
@@ -409,6 +437,24 @@ typedef struct VMINTUSERPERVMCPU
             uint64_t                u64StartSpinTS;
         }                           Method12;
 
+       /**
+        * Adaptive poll - Poll for pending work for a self-tuning window before
+        * blocking in ring-0 like Global1.  The window grows when a halt ended
+        * shortly after the window expired and shrinks when halts are long.
+        */
+        struct
+        {
+            /** When the first wake-up notification for this halt arrived
+             *  (RTTimeNanoTS), 0 if none yet. */
+            uint64_t volatile       u64WakeTS;
+            /** The current poll window (ns). */
+            uint32_t                cNsPollWindow;
+            /** Set while polling, notifications need not wake us up then. */
+            bool volatile           fPolling;
+            /** Align the structure size. */
+            bool                    afAlignment[3];
+        }                           AdaptivePoll;
+
 # if 0
        /**
         * Method 3 & 4 - Same as method 1 & 2 respectivly, except that we
@@ -454,6 +500,20 @@ typedef struct VMINTUSERPERVMCPU
     STAMPROFILE                     StatHaltTimers;
     STAMPROFILE                     StatHaltPoll;
     /** @} */
+
+    /** Adaptive poll halt method statistics.
+     * @{ */
+    /** Time polled when the poll caught the wake-up. */
+    STAMPROFILE                     StatHaltPollHit;
+    /** Time polled in vain before blocking. */
+    STAMPROFILE                     StatHaltPollMiss;
+    /** Time from the first wake-up notification till the EMT resumed. */
+    STAMPROFILE                     StatHaltWakeLatency;
+    /** Number of times the poll window was grown. */
+    STAMCOUNTER                     StatHaltPollGrow;
+    /** Number of times the poll window was shrunk. */
+    STAMCOUNTER                     StatHaltPollShrink;
+    /** @} */
 } VMINTUSERPERVMCPU;
 AssertCompileMemberAlignment(VMINTUSERPERVMCPU, u64HaltsStartTS, 8);
 AssertCompileMemberAlignment(VMINTUSERPERVMCPU, Halt.Method12.cNSBlockedTooLongAvg, 8);
@@ -208,6 +208,88 @@ static DECLCALLBACK(int) Thread(RTTHREAD hThreadSelf, void *pvUser)
     return VINF_SUCCESS;
 }
 
+/**
+ * The no-op request used for the round-trip benchmarks.
+ */
+static DECLCALLBACK(int) NopCallback(uintptr_t uArg)
+{
+    RT_NOREF(uArg);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Measures the round-trip latency of synchronous requests to EMT(0), one by
+ * one and in batches using VMR3ReqQueueBatch.
+ */
+static void Benchmark(PUVM pUVM)
+{
+    /*
+     * One by one.
+     */
+    uint32_t const cRoundTrips = 20000;
+    uint64_t       u64StartTS  = RTTimeNanoTS();
+    for (uint32_t i = 0; i < cRoundTrips; i++)
+    {
+        int rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)NopCallback, 1, (uintptr_t)i);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf(TESTCASE ": VMR3ReqCallWaitU failed, i=%u rc=%Rrc\n", i, rc);
+            g_cErrors++;
+            return;
+        }
+    }
+    uint64_t u64ElapsedTS = RTTimeNanoTS() - u64StartTS;
+    RTPrintf(TESTCASE ": %u single requests: %llu ns/round-trip\n", cRoundTrips, u64ElapsedTS / cRoundTrips);
+
+    /*
+     * Batched.
+     */
+    PVMREQ   apReqs[16];
+    uint32_t const cBatches = cRoundTrips / RT_ELEMENTS(apReqs);
+    u64StartTS = RTTimeNanoTS();
+    for (uint32_t iBatch = 0; iBatch < cBatches; iBatch++)
+    {
+        for (uint32_t iReq = 0; iReq < RT_ELEMENTS(apReqs); iReq++)
+        {
+            int rc = VMR3ReqAlloc(pUVM, &apReqs[iReq], VMREQTYPE_INTERNAL, 0 /*idDstCpu*/);
+            if (RT_FAILURE(rc))
+            {
+                RTPrintf(TESTCASE ": VMR3ReqAlloc failed, iBatch=%u iReq=%u rc=%Rrc\n", iBatch, iReq, rc);
+                g_cErrors++;
+                while (iReq-- > 0)
+                    VMR3ReqFree(apReqs[iReq]);
+                return;
+            }
+            apReqs[iReq]->u.Internal.pfn      = (PFNRT)NopCallback;
+            apReqs[iReq]->u.Internal.cArgs    = 1;
+            apReqs[iReq]->u.Internal.aArgs[0] = iReq;
+        }
+
+        int rc = VMR3ReqQueueBatch(apReqs, RT_ELEMENTS(apReqs), RT_INDEFINITE_WAIT);
+        if (RT_FAILURE(rc))
+        {
+            RTPrintf(TESTCASE ": VMR3ReqQueueBatch failed, iBatch=%u rc=%Rrc\n", iBatch, rc);
+            g_cErrors++;
+        }
+        for (uint32_t iReq = 0; iReq < RT_ELEMENTS(apReqs); iReq++)
+        {
+            if (RT_SUCCESS(rc) && apReqs[iReq]->iStatus != VINF_SUCCESS)
+            {
+                RTPrintf(TESTCASE ": iBatch=%u iReq=%u: iStatus=%Rrc\n", iBatch, iReq, apReqs[iReq]->iStatus);
+                g_cErrors++;
+            }
+            VMR3ReqFree(apReqs[iReq]);
+        }
+        if (RT_FAILURE(rc))
+            return;
+    }
+    u64ElapsedTS = RTTimeNanoTS() - u64StartTS;
+    RTPrintf(TESTCASE ": %u batches of %u requests: %llu ns/request\n",
+             cBatches, (unsigned)RT_ELEMENTS(apReqs), u64ElapsedTS / (cBatches * RT_ELEMENTS(apReqs)));
+    RTStrmFlush(g_pStdOut);
+}
+
 static DECLCALLBACK(int)
 tstVMREQConfigConstructor(PUVM pUVM, PVM pVM, void *pvUser)
 {
@@ -279,6 +361,12 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
         RTPrintf(TESTCASE  ": %llu ns elapsed\n", u64ElapsedTS);
         RTStrmFlush(g_pStdOut);
 
+        /*
+         * Round-trip benchmark.
+         */
+        RTPrintf(TESTCASE ": round-trip benchmark...\n"); RTStrmFlush(g_pStdOut);
+        Benchmark(pUVM);
+
         /*
          * Print stats.
          */
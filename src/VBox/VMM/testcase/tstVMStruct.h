@@ -279,6 +279,11 @@
     GEN_CHECK_OFF(DBGF, Mmio);
     GEN_CHECK_OFF(DBGF, PortIo);
     GEN_CHECK_OFF(DBGF, Int3);
+    GEN_CHECK_OFF(DBGF, fEvtTraceMask);
+    GEN_CHECK_OFF(DBGF, pbEvtTraceR3);
+    GEN_CHECK_OFF(DBGF, pbEvtTraceR0);
+    GEN_CHECK_OFF(DBGF, cbEvtTraceRing);
+    GEN_CHECK_OFF(DBGF, cEvtTraceEntries);
     //GEN_CHECK_OFF(DBGF, hAsDbLock);
     //GEN_CHECK_OFF(DBGF, hRegDbLock);
     //GEN_CHECK_OFF(DBGF, RegSetSpace);
@@ -376,16 +381,19 @@
     GEN_CHECK_OFF(IOMMMIORANGE, pfnWriteCallbackR3);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnReadCallbackR3);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnFillCallbackR3);
+    GEN_CHECK_OFF(IOMMMIORANGE, pCritSectR3);
     GEN_CHECK_OFF(IOMMMIORANGE, pvUserR0);
     GEN_CHECK_OFF(IOMMMIORANGE, pDevInsR0);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnWriteCallbackR0);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnReadCallbackR0);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnFillCallbackR0);
+    GEN_CHECK_OFF(IOMMMIORANGE, pCritSectR0);
     GEN_CHECK_OFF(IOMMMIORANGE, pvUserRC);
     GEN_CHECK_OFF(IOMMMIORANGE, pDevInsRC);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnWriteCallbackRC);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnReadCallbackRC);
     GEN_CHECK_OFF(IOMMMIORANGE, pfnFillCallbackRC);
+    GEN_CHECK_OFF(IOMMMIORANGE, pCritSectRC);
 
     GEN_CHECK_SIZE(IOMMMIOSTATS);
     GEN_CHECK_OFF(IOMMMIOSTATS, Accesses);
@@ -396,6 +404,7 @@
     GEN_CHECK_OFF(IOMIOPORTRANGER0, cPorts);
     GEN_CHECK_OFF(IOMIOPORTRANGER0, pvUser);
     GEN_CHECK_OFF(IOMIOPORTRANGER0, pDevIns);
+    GEN_CHECK_OFF(IOMIOPORTRANGER0, pCritSect);
     GEN_CHECK_OFF(IOMIOPORTRANGER0, pszDesc);
 
     GEN_CHECK_SIZE(IOMIOPORTRANGERC);
@@ -403,6 +412,7 @@
     GEN_CHECK_OFF(IOMIOPORTRANGERC, cPorts);
     GEN_CHECK_OFF(IOMIOPORTRANGERC, pvUser);
     GEN_CHECK_OFF(IOMIOPORTRANGERC, pDevIns);
+    GEN_CHECK_OFF(IOMIOPORTRANGERC, pCritSect);
     GEN_CHECK_OFF(IOMIOPORTRANGERC, pszDesc);
 
     GEN_CHECK_SIZE(IOMIOPORTSTATS);
@@ -598,6 +608,10 @@
     GEN_CHECK_OFF(PDMCRITSECTINT, StatContentionRZUnlock);
     GEN_CHECK_OFF(PDMCRITSECTINT, StatContentionR3);
     GEN_CHECK_OFF(PDMCRITSECTINT, StatLocked);
+    GEN_CHECK_OFF(PDMCRITSECTINT, pProfR3);
+    GEN_CHECK_OFF(PDMCRITSECTINT, pProfR0);
+    GEN_CHECK_OFF(PDMCRITSECTINT, u32EnterTick);
+    GEN_CHECK_OFF(PDMCRITSECTINT, cTicksAvgHold);
     GEN_CHECK_SIZE(PDMCRITSECT);
     GEN_CHECK_SIZE(PDMCRITSECTRWINT);
     GEN_CHECK_OFF(PDMCRITSECTRWINT, Core);
@@ -609,6 +623,8 @@
     GEN_CHECK_OFF(PDMCRITSECTRWINT, pszName);
     GEN_CHECK_OFF(PDMCRITSECTRWINT, StatContentionRZEnterExcl);
     GEN_CHECK_OFF(PDMCRITSECTRWINT, StatWriteLocked);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pProfR3);
+    GEN_CHECK_OFF(PDMCRITSECTRWINT, pProfR0);
     GEN_CHECK_SIZE(PDMCRITSECTRW);
     GEN_CHECK_SIZE(PDMQUEUE);
     GEN_CHECK_OFF(PDMQUEUE, pNext);
@@ -628,9 +644,14 @@
     GEN_CHECK_OFF(PDMQUEUE, pTimer);
     GEN_CHECK_OFF(PDMQUEUE, cbItem);
     GEN_CHECK_OFF(PDMQUEUE, cItems);
-    GEN_CHECK_OFF(PDMQUEUE, pPendingR3);
-    GEN_CHECK_OFF(PDMQUEUE, pPendingR0);
-    GEN_CHECK_OFF(PDMQUEUE, pPendingRC);
+    GEN_CHECK_OFF(PDMQUEUE, fPendingLists);
+    GEN_CHECK_OFF(PDMQUEUE, u32InsertSeq);
+    GEN_CHECK_OFF(PDMQUEUE, u64FirstInsertTick);
+    GEN_CHECK_OFF(PDMQUEUE, aPending);
+    GEN_CHECK_OFF(PDMQUEUE, aPending[1]);
+    GEN_CHECK_OFF_DOT(PDMQUEUE, aPending[0].pPendingR3);
+    GEN_CHECK_OFF_DOT(PDMQUEUE, aPending[0].pPendingR0);
+    GEN_CHECK_OFF_DOT(PDMQUEUE, aPending[0].pPendingRC);
     GEN_CHECK_OFF(PDMQUEUE, iFreeHead);
     GEN_CHECK_OFF(PDMQUEUE, iFreeTail);
     GEN_CHECK_OFF(PDMQUEUE, pszName);
@@ -638,6 +659,8 @@
     GEN_CHECK_OFF(PDMQUEUE, StatInsert);
     GEN_CHECK_OFF(PDMQUEUE, StatFlush);
     GEN_CHECK_OFF(PDMQUEUE, StatFlushLeftovers);
+    GEN_CHECK_OFF(PDMQUEUE, StatInsertContention);
+    GEN_CHECK_OFF(PDMQUEUE, StatFlushLatency);
     GEN_CHECK_OFF(PDMQUEUE, aFreeItems);
     GEN_CHECK_OFF(PDMQUEUE, aFreeItems[1]);
     GEN_CHECK_OFF_DOT(PDMQUEUE, aFreeItems[0].pItemR3);
@@ -1408,6 +1431,9 @@
     GEN_CHECK_OFF(APICCPU, pTimerR3);
     GEN_CHECK_OFF(APICCPU, pTimerRC);
     GEN_CHECK_OFF(APICCPU, TimerCritSect);
+    GEN_CHECK_OFF(APICCPU, GCPhysPvEoi);
+    GEN_CHECK_OFF(APICCPU, uPvEoiVector);
+    GEN_CHECK_OFF(APICCPU, fPvEoiPending);
 
     GEN_CHECK_SIZE(VM);
     GEN_CHECK_OFF(VM, enmVMState);
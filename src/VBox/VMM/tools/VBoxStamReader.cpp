@@ -0,0 +1,437 @@
+/* $Id: VBoxStamReader.cpp $ */
+/** @file
+ * VBoxStamReader - Decodes the STAM binary telemetry stream.
+ */
+
+/*
+ * Copyright (C) 2012-2019 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/buildconfig.h>
+#include <iprt/file.h>
+#include <iprt/getopt.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/message.h>
+#include <iprt/stream.h>
+#include <iprt/string.h>
+
+#include <VBox/vmm/stam.h>
+#include <VBox/err.h>
+#include <VBox/version.h>
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The sample name pattern (RTStrSimplePatternMultiMatch), NULL for all. */
+static const char  *g_pszPattern = NULL;
+/** Whether to produce CSV output. */
+static bool         g_fCsv = false;
+/** Whether to print samples which did not change in the interval. */
+static bool         g_fAll = false;
+
+/** The name table of the current generation. */
+static char        *g_pchNames = NULL;
+/** Pointers into g_pchNames, one per sample index. */
+static const char **g_papszNames = NULL;
+/** Whether the sample at the index matches g_pszPattern. */
+static bool        *g_pafSelected = NULL;
+/** The last values seen, one per sample index. */
+static STAMBINSAMPLE *g_paLast = NULL;
+/** Whether g_paLast holds a value for the sample index. */
+static bool        *g_pafHaveLast = NULL;
+/** The number of samples in the current generation. */
+static uint32_t     g_cSamples = 0;
+/** The current generation. */
+static uint32_t     g_uGeneration = UINT32_MAX;
+/** The timestamp of the previous data record. */
+static uint64_t     g_uLastNanoTS = 0;
+
+
+/**
+ * Reads exactly @a cb bytes from the stream.
+ *
+ * @returns IPRT status code, VERR_EOF at the end of the stream.
+ * @param   hFile       The stream.
+ * @param   pv          Where to return the data.
+ * @param   cb          The number of bytes to read.
+ */
+static int ReadExact(RTFILE hFile, void *pv, size_t cb)
+{
+    uint8_t *pb = (uint8_t *)pv;
+    while (cb > 0)
+    {
+        size_t cbRead = 0;
+        int rc = RTFileRead(hFile, pb, cb, &cbRead);
+        if (RT_FAILURE(rc))
+            return rc;
+        if (!cbRead)
+            return VERR_EOF;
+        pb += cbRead;
+        cb -= cbRead;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Gets the unit name, the same strings as STAMR3GetUnit() returns.
+ *
+ * @returns Read-only unit name.
+ * @param   enmUnit     The unit.
+ */
+static const char *GetUnitName(STAMUNIT enmUnit)
+{
+    switch (enmUnit)
+    {
+        case STAMUNIT_NONE:                 return "";
+        case STAMUNIT_CALLS:                return "calls";
+        case STAMUNIT_COUNT:                return "count";
+        case STAMUNIT_BYTES:                return "bytes";
+        case STAMUNIT_PAGES:                return "pages";
+        case STAMUNIT_ERRORS:               return "errors";
+        case STAMUNIT_OCCURENCES:           return "times";
+        case STAMUNIT_TICKS:                return "ticks";
+        case STAMUNIT_TICKS_PER_CALL:       return "ticks/call";
+        case STAMUNIT_TICKS_PER_OCCURENCE:  return "ticks/time";
+        case STAMUNIT_GOOD_BAD:             return "good:bad";
+        case STAMUNIT_MEGABYTES:            return "megabytes";
+        case STAMUNIT_KILOBYTES:            return "kilobytes";
+        case STAMUNIT_NS:                   return "ns";
+        case STAMUNIT_NS_PER_CALL:          return "ns/call";
+        case STAMUNIT_NS_PER_OCCURENCE:     return "ns/time";
+        case STAMUNIT_PCT:                  return "%";
+        case STAMUNIT_HZ:                   return "Hz";
+        default:                            return "(?unit?)";
+    }
+}
+
+
+/**
+ * Processes a schema record, replacing the current name table.
+ *
+ * @returns RTEXITCODE_SUCCESS on success.
+ * @param   pRec        The record header.
+ * @param   pvPayload   The payload (name table).  Ownership is taken.
+ * @param   cbPayload   The payload size.
+ */
+static RTEXITCODE ProcessSchema(PCSTAMEXPORTREC pRec, void *pvPayload, size_t cbPayload)
+{
+    const char   **papszNames  = (const char **)RTMemAllocZ(sizeof(papszNames[0]) * (pRec->cEntries + 1));
+    bool          *pafSelected = (bool *)RTMemAllocZ(sizeof(bool) * (pRec->cEntries + 1));
+    bool          *pafHaveLast = (bool *)RTMemAllocZ(sizeof(bool) * (pRec->cEntries + 1));
+    STAMBINSAMPLE *paLast      = (STAMBINSAMPLE *)RTMemAllocZ(sizeof(STAMBINSAMPLE) * (pRec->cEntries + 1));
+    if (!papszNames || !pafSelected || !pafHaveLast || !paLast)
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Out of memory (%u samples)", pRec->cEntries);
+
+    const char *pch    = (const char *)pvPayload;
+    const char *pchEnd = pch + cbPayload;
+    for (uint32_t i = 0; i < pRec->cEntries; i++)
+    {
+        const char *pszEnd = (const char *)memchr(pch, '\0', pchEnd - pch);
+        if (!pszEnd)
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Malformed schema record (generation %u, entry %u)",
+                                  pRec->uGeneration, i);
+        papszNames[i]  = pch;
+        pafSelected[i] = !g_pszPattern || RTStrSimplePatternMultiMatch(g_pszPattern, RTSTR_MAX, pch, RTSTR_MAX, NULL);
+        pch = pszEnd + 1;
+    }
+
+    RTMemFree(g_pchNames);
+    RTMemFree(g_papszNames);
+    RTMemFree(g_pafSelected);
+    RTMemFree(g_pafHaveLast);
+    RTMemFree(g_paLast);
+    g_pchNames     = (char *)pvPayload;
+    g_papszNames   = papszNames;
+    g_pafSelected  = pafSelected;
+    g_pafHaveLast  = pafHaveLast;
+    g_paLast       = paLast;
+    g_cSamples     = pRec->cEntries;
+    g_uGeneration  = pRec->uGeneration;
+    return RTEXITCODE_SUCCESS;
+}
+
+
+/**
+ * Prints one sample of a data record.
+ *
+ * @param   pSample     The new sample values.
+ * @param   pLast       The previous values, NULL if none.
+ * @param   cMsInterval The interval length in milliseconds, 0 if unknown.
+ * @param   uNanoTS     The record timestamp relative to the start.
+ */
+static void PrintSample(PCSTAMBINSAMPLE pSample, PCSTAMBINSAMPLE pLast, uint64_t cMsInterval, uint64_t uNanoTS)
+{
+    const char *pszName = g_papszNames[pSample->iSample];
+    const char *pszUnit = GetUnitName((STAMUNIT)pSample->enmUnit);
+    uint64_t    uValue  = pSample->au64[0];
+    uint64_t    uDelta  = pLast ? pSample->au64[0] - pLast->au64[0] : 0;
+    char        szExtra[96];
+    szExtra[0] = '\0';
+
+    switch (pSample->enmType)
+    {
+        case STAMTYPE_COUNTER:
+            if (pLast && cMsInterval > 0)
+            {
+                /* IPRT has no floating point formatting, so use tenths. */
+                uint64_t const cTenthsPerSec = uDelta <= UINT64_MAX / (RT_MS_1SEC * 10)
+                                             ? uDelta * (RT_MS_1SEC * 10) / cMsInterval
+                                             : uDelta / cMsInterval * (RT_MS_1SEC * 10);
+                RTStrPrintf(szExtra, sizeof(szExtra), "%RU64.%RU64/s", cTenthsPerSec / 10, cTenthsPerSec % 10);
+            }
+            break;
+
+        case STAMTYPE_PROFILE:
+        case STAMTYPE_PROFILE_ADV:
+        {
+            uint64_t const cPeriods = pLast ? uDelta : pSample->au64[0];
+            uint64_t const cTicks   = pLast ? pSample->au64[1] - pLast->au64[1] : pSample->au64[1];
+            RTStrPrintf(szExtra, sizeof(szExtra), "%RU64 %s (max %RU64, min %RU64)",
+                        cPeriods ? cTicks / cPeriods : 0, pszUnit, pSample->au64[2],
+                        pSample->au64[3] != UINT64_MAX ? pSample->au64[3] : 0);
+            pszUnit = "periods";
+            break;
+        }
+
+        case STAMTYPE_RATIO_U32:
+        case STAMTYPE_RATIO_U32_RESET:
+            RTStrPrintf(szExtra, sizeof(szExtra), "%RU64:%RU64", pSample->au64[0], pSample->au64[1]);
+            break;
+
+        default:
+            /* Plain values, the delta is of little use. */
+            uDelta = uValue;
+            break;
+    }
+
+    if (g_fCsv)
+        RTPrintf("%RU64,%s,%RU64,%RU64,%s,\"%s\"\n", uNanoTS, pszName, uValue, uDelta, pszUnit, szExtra);
+    else
+        RTPrintf("%-60s %14RU64 %12RU64 %-16s %s\n", pszName, uValue, uDelta, pszUnit, szExtra);
+}
+
+
+/**
+ * Processes a data record.
+ *
+ * @returns RTEXITCODE_SUCCESS on success.
+ * @param   pRec        The record header.
+ * @param   paSamples   The changed samples.
+ * @param   uStartTS    The stream start timestamp.
+ */
+static RTEXITCODE ProcessData(PCSTAMEXPORTREC pRec, PCSTAMBINSAMPLE paSamples, uint64_t uStartTS)
+{
+    if (pRec->uGeneration != g_uGeneration)
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Data record for generation %u without schema (have %u)",
+                              pRec->uGeneration, g_uGeneration);
+
+    uint64_t const cMsInterval = g_uLastNanoTS ? (pRec->uNanoTS - g_uLastNanoTS) / RT_NS_1MS : 0;
+    uint64_t const uRelTS      = pRec->uNanoTS - uStartTS;
+    g_uLastNanoTS = pRec->uNanoTS;
+
+    if (!g_fCsv)
+        RTPrintf("--- %RU64.%03RU64s (+%u changed) ---\n", uRelTS / RT_NS_1SEC, uRelTS % RT_NS_1SEC / RT_NS_1MS,
+                 pRec->cEntries);
+
+    for (uint32_t i = 0; i < pRec->cEntries; i++)
+    {
+        uint32_t const iSample = paSamples[i].iSample;
+        if (iSample >= g_cSamples)
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Sample index %u out of range (%u samples)", iSample, g_cSamples);
+        if (g_pafSelected[iSample])
+            PrintSample(&paSamples[i], g_pafHaveLast[iSample] ? &g_paLast[iSample] : NULL, cMsInterval, uRelTS);
+        g_paLast[iSample]      = paSamples[i];
+        g_pafHaveLast[iSample] = true;
+    }
+
+    if (g_fAll)
+        for (uint32_t iSample = 0; iSample < g_cSamples; iSample++)
+            if (g_pafSelected[iSample] && g_pafHaveLast[iSample])
+            {
+                bool fChanged = false;
+                for (uint32_t i = 0; i < pRec->cEntries && !fChanged; i++)
+                    fChanged = paSamples[i].iSample == iSample;
+                if (!fChanged)
+                    PrintSample(&g_paLast[iSample], &g_paLast[iSample], cMsInterval, uRelTS);
+            }
+    return RTEXITCODE_SUCCESS;
+}
+
+
+/**
+ * Decodes the stream.
+ *
+ * @returns RTEXITCODE_SUCCESS on success.
+ * @param   hFile       The stream.
+ */
+static RTEXITCODE ProcessStream(RTFILE hFile)
+{
+    STAMEXPORTHDR Hdr;
+    int rc = ReadExact(hFile, &Hdr, sizeof(Hdr));
+    if (RT_FAILURE(rc))
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to read the stream header: %Rrc", rc);
+    if (Hdr.u32Magic != STAMEXPORT_MAGIC || Hdr.uVersion != STAMEXPORT_VERSION || Hdr.cbHdr < sizeof(Hdr))
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Not a STAM telemetry stream or unsupported version (magic=%#x version=%u)",
+                              Hdr.u32Magic, Hdr.uVersion);
+    for (uint32_t cbSkip = Hdr.cbHdr - sizeof(Hdr); cbSkip > 0; cbSkip--)
+    {
+        uint8_t b;
+        rc = ReadExact(hFile, &b, 1);
+        if (RT_FAILURE(rc))
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to read the stream header: %Rrc", rc);
+    }
+
+    if (g_fCsv)
+        RTPrintf("ns,name,value,delta,unit,extra\n");
+    else
+    {
+        RTTIMESPEC Start;
+        char       szStart[64];
+        RTTimeSpecToString(RTTimeSpecSetNano(&Start, Hdr.i64StartUnixNanoTS), szStart, sizeof(szStart));
+        RTPrintf("STAM telemetry stream started %s, interval %u ms\n", szStart, Hdr.cMsInterval);
+    }
+
+    for (;;)
+    {
+        STAMEXPORTREC Rec;
+        rc = ReadExact(hFile, &Rec, sizeof(Rec));
+        if (rc == VERR_EOF)
+            return RTEXITCODE_SUCCESS;
+        if (RT_FAILURE(rc))
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Read error: %Rrc", rc);
+        if (Rec.cbRecord < sizeof(Rec) || Rec.cbRecord > _256M)
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Bad record size: %#x", Rec.cbRecord);
+
+        size_t const cbPayload = Rec.cbRecord - sizeof(Rec);
+        void *pvPayload = RTMemAlloc(RT_MAX(cbPayload, 1));
+        if (!pvPayload)
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Out of memory (%zu bytes)", cbPayload);
+        rc = ReadExact(hFile, pvPayload, cbPayload);
+        if (RT_FAILURE(rc))
+        {
+            RTMemFree(pvPayload);
+            return RTMsgErrorExit(RTEXITCODE_FAILURE, "Truncated record: %Rrc", rc);
+        }
+
+        RTEXITCODE rcExit;
+        switch (Rec.uType)
+        {
+            case STAMEXPORTREC_SCHEMA:
+                rcExit = ProcessSchema(&Rec, pvPayload, cbPayload);
+                pvPayload = NULL;
+                break;
+
+            case STAMEXPORTREC_DATA:
+                if (cbPayload != (size_t)Rec.cEntries * sizeof(STAMBINSAMPLE))
+                    rcExit = RTMsgErrorExit(RTEXITCODE_FAILURE, "Bad data record: %u entries in %zu bytes",
+                                            Rec.cEntries, cbPayload);
+                else
+                    rcExit = ProcessData(&Rec, (PCSTAMBINSAMPLE)pvPayload, Hdr.uStartNanoTS);
+                break;
+
+            default:
+                /* Skip unknown record types for forward compatibility. */
+                rcExit = RTEXITCODE_SUCCESS;
+                break;
+        }
+        RTMemFree(pvPayload);
+        if (rcExit != RTEXITCODE_SUCCESS)
+            return rcExit;
+        RTStrmFlush(g_pStdOut);
+    }
+}
+
+
+/**
+ * Main entry point.
+ */
+int main(int argc, char **argv)
+{
+    int rc = RTR3InitExe(argc, &argv, 0);
+    if (RT_FAILURE(rc))
+        return RTMsgInitFailure(rc);
+
+    static const RTGETOPTDEF s_aOptions[] =
+    {
+        { "--pattern",  'p', RTGETOPT_REQ_STRING  },
+        { "--csv",      'c', RTGETOPT_REQ_NOTHING },
+        { "--all",      'a', RTGETOPT_REQ_NOTHING },
+    };
+
+    const char     *pszInput = NULL;
+    int             ch;
+    RTGETOPTUNION   ValueUnion;
+    RTGETOPTSTATE   GetState;
+    RTGetOptInit(&GetState, argc, argv, s_aOptions, RT_ELEMENTS(s_aOptions), 1, 0 /* fFlags */);
+    while ((ch = RTGetOpt(&GetState, &ValueUnion)))
+    {
+        switch (ch)
+        {
+            case 'p':
+                g_pszPattern = ValueUnion.psz;
+                break;
+
+            case 'c':
+                g_fCsv = true;
+                break;
+
+            case 'a':
+                g_fAll = true;
+                break;
+
+            case VINF_GETOPT_NOT_OPTION:
+                if (pszInput)
+                    return RTMsgErrorExit(RTEXITCODE_SYNTAX, "Only one input stream can be given");
+                pszInput = ValueUnion.psz;
+                break;
+
+            case 'h':
+                RTPrintf(VBOX_PRODUCT " STAM Telemetry Reader Version " VBOX_VERSION_STRING
+                         "(C) 2005-" VBOX_C_YEAR " " VBOX_VENDOR "\n"
+                         "All rights reserved.\n"
+                         "\n"
+                         "Usage: VBoxStamReader [-hV] [-a|--all] [-c|--csv] [-p|--pattern <pat>] <file|fifo|->\n"
+                         "\n"
+                         "Decodes the stream written by the VM when /STAM/Export/File is configured,\n"
+                         "e.g. VBoxManage setextradata <vm> VBoxInternal/STAM/Export/File /tmp/vm.stam\n");
+                return RTEXITCODE_SUCCESS;
+
+            case 'V':
+                RTPrintf("%sr%s\n", RTBldCfgVersion(), RTBldCfgRevisionStr());
+                return RTEXITCODE_SUCCESS;
+
+            default:
+                return RTGetOptPrintError(ch, &ValueUnion);
+        }
+    }
+    if (!pszInput)
+        return RTMsgErrorExit(RTEXITCODE_SYNTAX, "No input stream given");
+
+    RTFILE hFile;
+    if (!strcmp(pszInput, "-"))
+        rc = RTFileFromNative(&hFile, RTFILE_NATIVE_STDIN);
+    else
+        rc = RTFileOpen(&hFile, pszInput, RTFILE_O_READ | RTFILE_O_OPEN | RTFILE_O_DENY_NONE);
+    if (RT_FAILURE(rc))
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Failed to open '%s': %Rrc", pszInput, rc);
+
+    RTEXITCODE rcExit = ProcessStream(hFile);
+    if (strcmp(pszInput, "-"))
+        RTFileClose(hFile);
+    return rcExit;
+}